@@ -0,0 +1,397 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref CoalescingHttpEngine class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef COALESCING_HTTP_ENGINE_H
+#define COALESCING_HTTP_ENGINE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QNetworkRequest>
+#include <QSslCertificate>
+
+#include "http_engine.h"
+
+class ThreadMetrics;
+
+/**
+ * HTTP engine that merges identical requests started at nearly the same time into a single fetch.  Requests are
+ * identical if they have the same URL, verb, headers, transfer timeout and body.  The response is fanned out to
+ * every client so each monitor still performs its own content checks, SSL checks and latency reporting.
+ *
+ * A request only joins a fetch started within the last \ref coalescingWindow milliseconds that has not yet received
+ * its response headers.  Monitors polled in the same scheduling slot start within a few milliseconds of one another
+ * so the latency each monitor measures differs from the shared fetch by at most a small fraction of the window.
+ */
+class CoalescingHttpEngine:public HttpEngine {
+    public:
+        /**
+         * The window, in milliseconds, over which identical requests are merged.
+         */
+        static constexpr qint64 coalescingWindow = 250;
+
+        /**
+         * Constructor
+         *
+         * \param[in] engine        The engine used to perform the shared fetches.
+         *
+         * \param[in] threadMetrics The thread metrics used to count merged requests.
+         */
+        CoalescingHttpEngine(HttpEngine* engine, ThreadMetrics* threadMetrics);
+
+        /**
+         * Destructor.  All requests created by the engine must be deleted before the engine is deleted.
+         */
+        ~CoalescingHttpEngine() override;
+
+        /**
+         * Method you can use to change the engine used for new shared fetches.  Fetches already in flight complete
+         * on their original engine.
+         *
+         * \param[in] engine The new engine.
+         */
+        void setEngine(HttpEngine* engine);
+
+        /**
+         * Method you can use to obtain the engine used for new shared fetches.
+         *
+         * \return Returns the underlying engine.
+         */
+        HttpEngine* engine() const;
+
+        /**
+         * Method you can use to obtain the backend implemented by this engine.
+         *
+         * \return Returns the backend of the underlying engine.
+         */
+        Backend backend() const override;
+
+        /**
+         * Method you can use to start a request.  The client is never called from within this method.
+         *
+         * \param[in] client         The client to be notified of request events.
+         *
+         * \param[in] request        The request URL, headers and transfer timeout.
+         *
+         * \param[in] verb           The HTTP verb.
+         *
+         * \param[in] body           The request body.  An empty array indicates no body.
+         *
+         * \param[in] reportProgress If true, the client is told when the connection is established and when the
+         *                           response headers arrive.  A request that joins a fetch after the connection
+         *                           was established is only told when the headers arrive.
+         *
+         * \return Returns the newly created request.  The caller takes ownership of the request.
+         */
+        Request* startRequest(
+            Client*                client,
+            const QNetworkRequest& request,
+            const QByteArray&      verb,
+            const QByteArray&      body,
+            bool                   reportProgress
+        ) override;
+
+    private:
+        class SharedFetch;
+
+        /**
+         * Request tied to a shared fetch.  Deleting the request detaches it from the fetch.  The fetch is aborted
+         * once every request tied to it has been deleted.
+         */
+        class CoalescedRequest:public Request {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] client         The client to be notified of request events.
+                 *
+                 * \param[in] fetch          The shared fetch that services this request.
+                 *
+                 * \param[in] reportProgress If true, the client is told when the connection is established and when
+                 *                           the response headers arrive.
+                 */
+                CoalescedRequest(Client* client, SharedFetch* fetch, bool reportProgress);
+
+                ~CoalescedRequest() override;
+
+                /**
+                 * Method you can use to obtain the HTTP status code of the response.
+                 *
+                 * \return Returns the HTTP status code.  A value of 0 is returned if no response was received.
+                 */
+                int statusCode() const override;
+
+                /**
+                 * Method you can use to obtain a response header.
+                 *
+                 * \param[in] headerName The header name.  The name is matched without regard to case.
+                 *
+                 * \return Returns the header value.  An empty array is returned if the header is not present.
+                 */
+                QByteArray rawHeader(const QByteArray& headerName) const override;
+
+                /**
+                 * Method you can use to obtain the advertised length of the response body.
+                 *
+                 * \return Returns the content length, in bytes.  A negative value is returned if the length is not
+                 *         known.
+                 */
+                long long contentLength() const override;
+
+                /**
+                 * Method you can use to read the response body data this request has not yet read.
+                 *
+                 * \return Returns the available data.
+                 */
+                QByteArray readAll() override;
+
+                /**
+                 * Method you can use to determine if the request failed.
+                 *
+                 * \return Returns true if the shared fetch failed.
+                 */
+                bool failed() const override;
+
+                /**
+                 * Method you can use to obtain a description of the failure.
+                 *
+                 * \return Returns the shared fetch's error string.
+                 */
+                QString errorString() const override;
+
+                /**
+                 * Method you can use to obtain the certificate presented by the remote host.
+                 *
+                 * \return Returns the peer certificate.  A null certificate is returned for insecure connections.
+                 */
+                QSslCertificate peerCertificate() const override;
+
+                /**
+                 * Method you can use to determine if a TLS handshake was performed for this request.
+                 *
+                 * \return Returns true if a TLS handshake was performed.  Returns false for insecure connections and
+                 *         for requests sent over a reused connection.
+                 */
+                bool newHandshake() const override;
+
+                /**
+                 * Method you can use to obtain the TLS session ticket issued by the remote host.  The ticket can be
+                 * supplied to later requests through QSslConfiguration::setSessionTicket.
+                 *
+                 * \return Returns the session ticket.  An empty array is returned if no ticket was issued or if the
+                 *         engine maintains its own session cache.
+                 */
+                QByteArray sslSessionTicket() const override;
+
+                /**
+                 * Method you can use to obtain the time since the shared fetch was started.
+                 *
+                 * \return Returns the time since the shared fetch was started, in nanoseconds.
+                 */
+                unsigned long long elapsedNanoseconds() const override;
+
+                /**
+                 * Method you can use to obtain the times at which the shared fetch completed each phase.
+                 *
+                 * \return Returns the phase times of the shared fetch.
+                 */
+                PhaseTimes phaseTimes() const override;
+
+                /**
+                 * The shared fetch that services this request.
+                 */
+                SharedFetch* fetch;
+
+                /**
+                 * Flag indicating if the client wants connection and header events.
+                 */
+                bool reportProgress;
+
+                /**
+                 * The offset into the shared fetch's body buffer of the first byte this request has not read.
+                 */
+                int readOffset;
+        };
+
+        /**
+         * Class that performs a single fetch on behalf of one or more requests.
+         */
+        class SharedFetch:public Client {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] engine The engine that owns this fetch.
+                 *
+                 * \param[in] key    The key used to locate this fetch.
+                 */
+                SharedFetch(CoalescingHttpEngine* engine, const QByteArray& key);
+
+                ~SharedFetch() override;
+
+                /**
+                 * Method you can use to determine if new requests can still join this fetch.
+                 *
+                 * \return Returns true if new requests can join this fetch.
+                 */
+                bool joinable() const;
+
+                /**
+                 * Method you can use to detach a request from this fetch.  The fetch is deleted once it has no
+                 * requests.
+                 *
+                 * \param[in] coalescedRequest The request to be detached.
+                 */
+                void detach(CoalescedRequest* coalescedRequest);
+
+                /**
+                 * Method that is called when a new connection has been established for the fetch.
+                 *
+                 * \param[in] request The underlying request.
+                 */
+                void requestConnected(Request* request) override;
+
+                /**
+                 * Method that is called when the final response headers are received.
+                 *
+                 * \param[in] request The underlying request.
+                 */
+                void requestHeadersReceived(Request* request) override;
+
+                /**
+                 * Method that is called when response body data is available.
+                 *
+                 * \param[in] request The underlying request.
+                 */
+                void requestDataAvailable(Request* request) override;
+
+                /**
+                 * Method that is called when the fetch completes or fails.
+                 *
+                 * \param[in] request The underlying request.
+                 */
+                void requestFinished(Request* request) override;
+
+                /**
+                 * The engine that owns this fetch.
+                 */
+                CoalescingHttpEngine* engine;
+
+                /**
+                 * The key used to locate this fetch.
+                 */
+                QByteArray key;
+
+                /**
+                 * The underlying request.
+                 */
+                Request* request;
+
+                /**
+                 * The requests serviced by this fetch.
+                 */
+                QList<CoalescedRequest*> coalescedRequests;
+
+                /**
+                 * Response body data not yet read by every request.
+                 */
+                QByteArray buffer;
+
+                /**
+                 * Timer started when the fetch is started.
+                 */
+                QElapsedTimer age;
+
+                /**
+                 * Flag indicating the connection has been established.
+                 */
+                bool connected;
+
+                /**
+                 * Flag indicating the response headers have been received.
+                 */
+                bool headersReceived;
+
+                /**
+                 * Flag indicating that events are being dispatched to the requests.  The fetch is not deleted while
+                 * it is dispatching events.
+                 */
+                bool dispatching;
+
+            private:
+                /**
+                 * Type of pointer to a client method.
+                 */
+                typedef void (Client::*ClientMethod)(Request*);
+
+                /**
+                 * Method that dispatches an event to the requests serviced by this fetch.  The fetch may be deleted
+                 * by this method.
+                 *
+                 * \param[in] method           The client method to be called.
+                 *
+                 * \param[in] progressOnly     If true, only requests that report progress receive the event.
+                 *
+                 * \return Returns true if the fetch still exists.  Returns false if the fetch was deleted.
+                 */
+                bool dispatch(ClientMethod method, bool progressOnly);
+        };
+
+        /**
+         * Method that builds the key used to locate identical requests.
+         *
+         * \param[in] request The request URL, headers and transfer timeout.
+         *
+         * \param[in] verb    The HTTP verb.
+         *
+         * \param[in] body    The request body.
+         *
+         * \return Returns the key.
+         */
+        static QByteArray fetchKey(const QNetworkRequest& request, const QByteArray& verb, const QByteArray& body);
+
+        /**
+         * Method that stops new requests from joining a fetch.
+         *
+         * \param[in] fetch The fetch to be closed.
+         */
+        void closeFetch(SharedFetch* fetch);
+
+        /**
+         * The engine used for new shared fetches.
+         */
+        HttpEngine* currentEngine;
+
+        /**
+         * The thread metrics used to count merged requests.
+         */
+        ThreadMetrics* currentThreadMetrics;
+
+        /**
+         * Joinable fetches by key.
+         */
+        QHash<QByteArray, SharedFetch*> fetchesByKey;
+};
+
+#endif
@@ -27,7 +27,6 @@
 #include <QTimer>
 #include <QString>
 #include <QHash>
-#include <QMutex>
 
 #include <cstdint>
 
@@ -37,7 +36,9 @@
 class HttpServiceThread;
 
 /**
- * Class that tracks all the host/scheme instances for a customer.
+ * Class that tracks all the host/scheme instances for a customer.  Once added to a \ref HttpServiceThread, a customer
+ * is only modified from within that thread.  Changes requested from other threads are posted to the thread by the
+ * \ref HttpServiceThread.
  */
 class Customer:public QObject {
     Q_OBJECT
@@ -56,6 +57,38 @@ class Customer:public QObject {
          */
         typedef QHash<HostScheme::HostSchemeId, HostScheme*> HostSchemesByHostSchemeId;
 
+        /**
+         * The default delay before a failed monitor is rechecked to confirm the failure, in seconds.
+         */
+        static constexpr unsigned defaultConfirmationDelay = 5;
+
+        /**
+         * The default ceiling on the interval between rechecks of a failed monitor, in seconds.
+         */
+        static constexpr unsigned defaultMaximumRecheckInterval = 300;
+
+        /**
+         * Enumeration of customer priority tiers.  When a service thread can not keep up, host/schemes belonging to
+         * lower priority customers have their polling cadence reduced first.
+         */
+        enum class Priority {
+            /**
+             * Indicates a latency sensitive customer.  Host/schemes are serviced at their full cadence whenever
+             * possible, ahead of late lower priority host/schemes.
+             */
+            HIGH,
+
+            /**
+             * Indicates a customer with standard service.
+             */
+            NORMAL,
+
+            /**
+             * Indicates a best-effort customer.  These host/schemes are the first to be slowed when load is shed.
+             */
+            BEST_EFFORT
+        };
+
         /**
          * Constructor.
          *
@@ -72,6 +105,12 @@ class Customer:public QObject {
          *
          * \pmara[in] supportsMultiRegionTesting    If true, latency measurements are done across regions.
          *
+         * \param[in] supportsLatencyPhases         If true, latency measurements should include a per-phase
+         *                                          breakdown for this customer.
+         *
+         * \param[in] supportsLatencyAggregation    If true, latency measurements for this customer are reported as
+         *                                          per-monitor window summaries rather than individual samples.
+         *
          * \param[in] pollingInterval               The polling interval to use for this customer, in seconds.
          *
          * \param[in] serviceThread                 Pointer to the service thread owning this customer instance.
@@ -82,6 +121,8 @@ class Customer:public QObject {
             bool               supportsSslExpirationChecking,
             bool               supportsLatencyMeasurements,
             bool               supportsMultiRegionTesting,
+            bool               supportsLatencyPhases,
+            bool               supportsLatencyAggregation,
             unsigned           pollingInterval,
             HttpServiceThread* serviceThread = nullptr
         );
@@ -214,6 +255,39 @@ class Customer:public QObject {
          */
         void setSupportsMultiRegionTesting(bool nowSupported);
 
+        /**
+         * Method that indicates if latency measurements for this customer should include a per-phase breakdown.
+         *
+         * \return Returns true if per-phase latency should be collected.  Returns false if only the total latency
+         *         should be collected.
+         */
+        bool supportsLatencyPhases() const;
+
+        /**
+         * Method you can use to indicate if latency measurements for this customer should include a per-phase
+         * breakdown.  The setting is ignored if latency measurements are not enabled.
+         *
+         * \param[in] nowSupported If true, then per-phase latency should be collected.
+         */
+        void setSupportsLatencyPhases(bool nowSupported);
+
+        /**
+         * Method that indicates if latency measurements for this customer should be aggregated into per-monitor
+         * window summaries on the polling server.
+         *
+         * \return Returns true if latency should be aggregated.  Returns false if individual samples should be
+         *         reported.
+         */
+        bool supportsLatencyAggregation() const;
+
+        /**
+         * Method you can use to indicate if latency measurements for this customer should be aggregated into
+         * per-monitor window summaries.  The setting is ignored if latency measurements are not enabled.
+         *
+         * \param[in] nowSupported If true, then latency should be aggregated.
+         */
+        void setSupportsLatencyAggregation(bool nowSupported);
+
         /**
          * Method you can use to determine the current polling interval for this customer.
          *
@@ -242,6 +316,71 @@ class Customer:public QObject {
          */
         void setPaused(bool nowPaused = true);
 
+        /**
+         * Method you can use to determine the delay before a failed monitor is first rechecked.  Rechecks are in
+         * addition to the monitor's regular checks.
+         *
+         * \return Returns the confirmation delay, in seconds.
+         */
+        unsigned confirmationDelay() const;
+
+        /**
+         * Method you can use to set the delay before a failed monitor is first rechecked.  Each later recheck
+         * doubles the delay up to \ref maximumRecheckInterval.  A value of 0 rechecks failed monitors every time
+         * their host/scheme is serviced.
+         *
+         * \param[in] newConfirmationDelay The new confirmation delay, in seconds.
+         */
+        void setConfirmationDelay(unsigned newConfirmationDelay);
+
+        /**
+         * Method you can use to determine the ceiling on the interval between rechecks of a failed monitor.
+         *
+         * \return Returns the maximum recheck interval, in seconds.
+         */
+        unsigned maximumRecheckInterval() const;
+
+        /**
+         * Method you can use to set the ceiling on the interval between rechecks of a failed monitor.
+         *
+         * \param[in] newMaximumRecheckInterval The new maximum recheck interval, in seconds.
+         */
+        void setMaximumRecheckInterval(unsigned newMaximumRecheckInterval);
+
+        /**
+         * Method you can use to determine this customer's priority tier.
+         *
+         * \return Returns the customer's priority tier.
+         */
+        Priority priority() const;
+
+        /**
+         * Method you can use to set this customer's priority tier.
+         *
+         * \param[in] newPriority The new priority tier.
+         */
+        void setPriority(Priority newPriority);
+
+        /**
+         * Method you can use to convert a priority tier name to a priority tier.
+         *
+         * \param[in]  name The priority tier name, "high", "normal", or "best_effort".
+         *
+         * \param[out] ok   Optional pointer to a flag set to false if the name is not recognized.
+         *
+         * \return Returns the priority tier.  \ref Priority::NORMAL is returned for unrecognized names.
+         */
+        static Priority toPriority(const QString& name, bool* ok = nullptr);
+
+        /**
+         * Method you can use to convert a priority tier to a string.
+         *
+         * \param[in] priority The priority tier to be converted.
+         *
+         * \return Returns the priority tier as a string.
+         */
+        static QString toString(Priority priority);
+
         /**
          * Method that returns the number of host/scheme instances under this customer.
          *
@@ -249,6 +388,16 @@ class Customer:public QObject {
          */
         unsigned numberHostSchemes() const;
 
+        /**
+         * Method that estimates the rate at which host/schemes under this customer are serviced.
+         *
+         * \param[in] numberRegions The number of polling server regions.  Multi-region customers are polled by each
+         *                          region in turn.
+         *
+         * \return Returns the estimated number of host/schemes per second serviced for this customer.
+         */
+        double serviceRate(unsigned numberRegions) const;
+
         /**
          * Method that returns the number of monitors under this customer.
          *
@@ -256,6 +405,26 @@ class Customer:public QObject {
          */
         unsigned numberMonitors() const;
 
+        /**
+         * Method that discards every in-flight check under this customer without changing any monitor status.  This
+         * method must be called from the customer's thread and is used before the customer is moved to a different
+         * thread.
+         */
+        void cancelPendingChecks();
+
+        /**
+         * Method you can use to update this customer to match a newly received description of the same customer.
+         * Unchanged host/schemes and monitors keep their state and their scheduling.  Changed objects are updated in
+         * place, new objects are taken from the provided customer, and objects that no longer exist are removed.
+         *
+         * The polling interval and multi-region setting must match as they determine which host/scheme timer services
+         * this customer.  This method must be called from the customer's thread and the provided customer must live
+         * in the same thread.  The provided customer should be deleted afterwards.
+         *
+         * \param[in] customer The customer holding the new settings.
+         */
+        void updateFrom(Customer* customer);
+
     private:
         /**
          * Method that is called by the host/scheme when a monitor has been added.
@@ -325,25 +494,40 @@ class Customer:public QObject {
          */
         bool currentSupportsMultiRegionTesting;
 
+        /**
+         * Holds true if latency measurements for this customer should include a per-phase breakdown.
+         */
+        bool currentSupportsLatencyPhases;
+
+        /**
+         * Holds true if latency measurements for this customer should be aggregated on the polling server.
+         */
+        bool currentSupportsLatencyAggregation;
+
         /**
          * Holds the polling interval to use for this customer.
          */
         unsigned currentPollingInterval;
 
         /**
-         * Mutex used to protect our host/scheme hash table.
+         * The delay before a failed monitor is first rechecked, in seconds.
          */
-        mutable QMutex hostSchemeMutex;
+        unsigned currentConfirmationDelay;
 
         /**
-         * Hash table of host/schemes by host/scheme ID.
+         * The ceiling on the interval between rechecks of a failed monitor, in seconds.
          */
-        HostSchemesByHostSchemeId hostSchemesByHostSchemeId;
+        unsigned currentMaximumRecheckInterval;
 
         /**
-         * Mutex used to protect our monitors hash table.
+         * The customer's priority tier.
          */
-        mutable QMutex monitorMutex;
+        Priority currentPriority;
+
+        /**
+         * Hash table of host/schemes by host/scheme ID.
+         */
+        HostSchemesByHostSchemeId hostSchemesByHostSchemeId;
 
         /**
          * Hash table of monitors under this customer.
@@ -25,11 +25,14 @@
 
 #include <QObject>
 #include <QVector>
+#include <QList>
 #include <QByteArray>
+#include <QHash>
 #include <QMutex>
 #include <QTimer>
 
 #include <cstdint>
+#include <atomic>
 
 #include <rest_api_out_v1_server.h>
 #include <rest_api_out_v1_inesonic_binary_rest_handler.h>
@@ -38,9 +41,13 @@
 #include "metatypes.h"
 #include "host_scheme.h"
 #include "monitor.h"
+#include "latency_sketch.h"
 
 class ServiceThreadTracker;
 class EventReporter;
+class LatencyRing;
+class LatencySpill;
+class LatencyBatch;
 
 /**
  * Class that collects data from each monitor, including latency information and error reports.
@@ -91,11 +98,200 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
          */
         static const QString latencyRecordPath;
 
+        /**
+         * The default maximum number of latency reports that can be in flight at once.
+         */
+        static constexpr unsigned defaultMaximumInFlightReports = 4;
+
+        /**
+         * Class used to hold the per-phase breakdown of a single latency measurement.  All values are in
+         * microseconds.  A phase that could not be measured, such as connection setup on a reused connection, is
+         * reported as zero.
+         */
+        class LatencyPhases {
+            public:
+                /**
+                 * Default constructor.  Creates an instance indicating that no breakdown is available.
+                 */
+                constexpr LatencyPhases():
+                    currentValid(false),
+                    currentDnsMicroseconds(0),
+                    currentConnectMicroseconds(0),
+                    currentTlsMicroseconds(0),
+                    currentFirstByteMicroseconds(0),
+                    currentTransferMicroseconds(0) {}
+
+                /**
+                 * Constructor
+                 *
+                 * \param[in] dnsMicroseconds       The time spent resolving the host name.
+                 *
+                 * \param[in] connectMicroseconds   The time spent establishing the TCP connection.
+                 *
+                 * \param[in] tlsMicroseconds       The time spent performing the TLS handshake.
+                 *
+                 * \param[in] firstByteMicroseconds The time between the connection being available and the response
+                 *                                  headers being received.
+                 *
+                 * \param[in] transferMicroseconds  The time spent receiving the response body.
+                 */
+                constexpr LatencyPhases(
+                        LatencyMicroseconds dnsMicroseconds,
+                        LatencyMicroseconds connectMicroseconds,
+                        LatencyMicroseconds tlsMicroseconds,
+                        LatencyMicroseconds firstByteMicroseconds,
+                        LatencyMicroseconds transferMicroseconds
+                    ):currentValid(
+                        true
+                    ),currentDnsMicroseconds(
+                        dnsMicroseconds
+                    ),currentConnectMicroseconds(
+                        connectMicroseconds
+                    ),currentTlsMicroseconds(
+                        tlsMicroseconds
+                    ),currentFirstByteMicroseconds(
+                        firstByteMicroseconds
+                    ),currentTransferMicroseconds(
+                        transferMicroseconds
+                    ) {}
+
+                ~LatencyPhases() = default;
+
+                /**
+                 * Method you can use to determine if this instance holds a breakdown.
+                 *
+                 * \return Returns true if this instance holds a breakdown.  Returns false if no breakdown is
+                 *         available.
+                 */
+                inline bool isValid() const {
+                    return currentValid;
+                }
+
+                /**
+                 * Method you can use to obtain the time spent resolving the host name.
+                 *
+                 * \return Returns the DNS resolution time, in microseconds.
+                 */
+                inline LatencyMicroseconds dnsMicroseconds() const {
+                    return currentDnsMicroseconds;
+                }
+
+                /**
+                 * Method you can use to obtain the time spent establishing the TCP connection.  Engines that can not
+                 * observe the TCP connection separately report the TLS handshake as part of this time.
+                 *
+                 * \return Returns the connection setup time, in microseconds.
+                 */
+                inline LatencyMicroseconds connectMicroseconds() const {
+                    return currentConnectMicroseconds;
+                }
+
+                /**
+                 * Method you can use to obtain the time spent performing the TLS handshake.
+                 *
+                 * \return Returns the TLS handshake time, in microseconds.
+                 */
+                inline LatencyMicroseconds tlsMicroseconds() const {
+                    return currentTlsMicroseconds;
+                }
+
+                /**
+                 * Method you can use to obtain the time to the first byte of the response, measured from the point
+                 * the connection was available.
+                 *
+                 * \return Returns the time to first byte, in microseconds.
+                 */
+                inline LatencyMicroseconds firstByteMicroseconds() const {
+                    return currentFirstByteMicroseconds;
+                }
+
+                /**
+                 * Method you can use to obtain the time spent receiving the response body.
+                 *
+                 * \return Returns the transfer time, in microseconds.
+                 */
+                inline LatencyMicroseconds transferMicroseconds() const {
+                    return currentTransferMicroseconds;
+                }
+
+            private:
+                /**
+                 * Flag indicating if this instance holds a breakdown.
+                 */
+                bool currentValid;
+
+                /**
+                 * The DNS resolution time, in microseconds.
+                 */
+                LatencyMicroseconds currentDnsMicroseconds;
+
+                /**
+                 * The connection setup time, in microseconds.
+                 */
+                LatencyMicroseconds currentConnectMicroseconds;
+
+                /**
+                 * The TLS handshake time, in microseconds.
+                 */
+                LatencyMicroseconds currentTlsMicroseconds;
+
+                /**
+                 * The time to first byte, in microseconds.
+                 */
+                LatencyMicroseconds currentFirstByteMicroseconds;
+
+                /**
+                 * The body transfer time, in microseconds.
+                 */
+                LatencyMicroseconds currentTransferMicroseconds;
+        };
+
         /**
          * Class used to track a single latency entry.
          */
         class LatencyEntry {
             public:
+                /**
+                 * Default constructor.  Creates an empty entry.
+                 */
+                constexpr LatencyEntry():
+                    currentMonitorId(0),
+                    currentTimestamp(0),
+                    currentLatencyMicroseconds(0),
+                    currentAggregated(false) {}
+
+                /**
+                 * Constructor
+                 *
+                 * \param[in] monitorId           The ID of the monitor that took this measurement.
+                 *
+                 * \param[in] unixTimestamp       The Unix timestamp.
+                 *
+                 * \param[in] latencyMicroseconds The latency measurement, in microseconds.
+                 *
+                 * \param[in] phases              The per-phase breakdown of the latency measurement.
+                 *
+                 * \param[in] aggregated          If true, the measurement should be folded into a window summary
+                 *                                rather than reported individually.
+                 */
+                constexpr LatencyEntry(
+                        MonitorId            monitorId,
+                        unsigned long long   unixTimestamp,
+                        LatencyMicroseconds  latencyMicroseconds,
+                        const LatencyPhases& phases,
+                        bool                 aggregated = false
+                    ):currentMonitorId(
+                        monitorId
+                    ),currentTimestamp(
+                        unixTimestamp - startOfZoranEpoch
+                    ),currentLatencyMicroseconds(
+                        latencyMicroseconds
+                    ),currentPhases(
+                        phases
+                    ),currentAggregated(
+                        aggregated
+                    ) {}
+
                 /**
                  * Constructor
                  *
@@ -115,6 +311,8 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
                         unixTimestamp - startOfZoranEpoch
                     ),currentLatencyMicroseconds(
                         latencyMicroseconds
+                    ),currentAggregated(
+                        false
                     ) {}
 
                 /**
@@ -130,6 +328,10 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
                         other.currentTimestamp
                     ),currentLatencyMicroseconds(
                         other.currentLatencyMicroseconds
+                    ),currentPhases(
+                        other.currentPhases
+                    ),currentAggregated(
+                        other.currentAggregated
                     ) {}
 
                 ~LatencyEntry() = default;
@@ -179,6 +381,26 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
                     return currentLatencyMicroseconds / 1000000.0;
                 }
 
+                /**
+                 * Method you can use to obtain the per-phase breakdown of the latency value.
+                 *
+                 * \return Returns the per-phase breakdown.  The returned value will be invalid if no breakdown was
+                 *         collected.
+                 */
+                inline const LatencyPhases& phases() const {
+                    return currentPhases;
+                }
+
+                /**
+                 * Method you can use to determine if this entry should be folded into a window summary.
+                 *
+                 * \return Returns true if the entry should be aggregated.  Returns false if the entry should be
+                 *         reported individually.
+                 */
+                inline bool aggregated() const {
+                    return currentAggregated;
+                }
+
                 /**
                  * Assignment operator.
                  *
@@ -190,6 +412,8 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
                     currentMonitorId           = other.currentMonitorId;
                     currentTimestamp           = other.currentTimestamp;
                     currentLatencyMicroseconds = other.currentLatencyMicroseconds;
+                    currentPhases              = other.currentPhases;
+                    currentAggregated          = other.currentAggregated;
 
                     return *this;
                 }
@@ -231,6 +455,16 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
                  * The current latency value being tracked, in microseconds.
                  */
                 LatencyMicroseconds currentLatencyMicroseconds;
+
+                /**
+                 * The per-phase breakdown of the latency value.
+                 */
+                LatencyPhases currentPhases;
+
+                /**
+                 * Flag indicating that this entry should be folded into a window summary.
+                 */
+                bool currentAggregated;
         };
 
         /**
@@ -238,6 +472,97 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
          */
         typedef QVector<LatencyEntry> LatencyEntryList;
 
+        /**
+         * Class used to hold the latency summary of a single monitor over a single aggregation window.
+         */
+        class LatencySummary {
+            public:
+                /**
+                 * Default constructor.  Creates an empty summary.
+                 */
+                LatencySummary():currentMonitorId(0),currentWindowStart(0) {}
+
+                /**
+                 * Constructor
+                 *
+                 * \param[in] monitorId   The ID of the monitor being summarized.
+                 *
+                 * \param[in] windowStart The Zoran timestamp of the start of the aggregation window.
+                 */
+                LatencySummary(
+                        MonitorId      monitorId,
+                        ZoranTimeStamp windowStart
+                    ):currentMonitorId(
+                        monitorId
+                    ),currentWindowStart(
+                        windowStart
+                    ) {}
+
+                ~LatencySummary() = default;
+
+                /**
+                 * Method you can use to obtain the monitor ID.
+                 *
+                 * \return Returns the monitor ID.
+                 */
+                inline MonitorId monitorId() const {
+                    return currentMonitorId;
+                }
+
+                /**
+                 * Method you can use to obtain the start of the aggregation window.
+                 *
+                 * \return Returns the Zoran timestamp of the start of the window.
+                 */
+                inline ZoranTimeStamp windowStart() const {
+                    return currentWindowStart;
+                }
+
+                /**
+                 * Method you can use to obtain the latency sketch for the window.
+                 *
+                 * \return Returns a reference to the sketch.
+                 */
+                inline const LatencySketch& sketch() const {
+                    return currentSketch;
+                }
+
+                /**
+                 * Method you can use to obtain the latency sketch for the window.
+                 *
+                 * \return Returns a reference to the sketch.
+                 */
+                inline LatencySketch& sketch() {
+                    return currentSketch;
+                }
+
+            private:
+                /**
+                 * The monitor ID.
+                 */
+                MonitorId currentMonitorId;
+
+                /**
+                 * The Zoran timestamp of the start of the window.
+                 */
+                ZoranTimeStamp currentWindowStart;
+
+                /**
+                 * The latency sketch for the window.
+                 */
+                LatencySketch currentSketch;
+        };
+
+        /**
+         * Type used to contain a collection of latency summaries.
+         */
+        typedef QVector<LatencySummary> LatencySummaryList;
+
+        /**
+         * The length of a latency aggregation window, in seconds.
+         */
+        static constexpr unsigned aggregationWindowSeconds = 300;
+
         /**
          * Constructor.
          *
@@ -322,15 +647,131 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
         void setServerIdentifier(const QString& newServerIdentifier);
 
         /**
-         * Method that can be called by a thread to report new latency data.  This method is fully thread safe.
+         * Method you can use to set the maximum number of event batches that can be in flight at once.  This method
+         * must be called from the data aggregator's thread.
          *
-         * \param[in] monitorId The monitor ID of the monitor making the report.
+         * \param[in] newMaximumInFlightEventBatches The new maximum number of in-flight event batches.
+         */
+        void setMaximumInFlightEventBatches(unsigned newMaximumInFlightEventBatches);
+
+        /**
+         * Method you can use to set the maximum number of latency reports that can be in flight at once.  Only a
+         * single report is sent at a time unless the database controller accepts sequenced reports.  This method
+         * must be called from the data aggregator's thread.
+         *
+         * \param[in] newMaximumInFlightReports The new maximum number of in-flight latency reports.
+         */
+        void setMaximumInFlightReports(unsigned newMaximumInFlightReports);
+
+        /**
+         * Method you can use to determine the number of latency reports currently in flight.  This method is thread
+         * safe.
+         *
+         * \return Returns the number of in-flight latency reports.
+         */
+        unsigned numberInFlightReports() const;
+
+        /**
+         * Method you can use to set the file used to spill latency entries that can not be held in memory while the
+         * database controller is unreachable.  Entries left in the file by a previous run will be replayed.  This
+         * method must be called from the data aggregator's thread.
+         *
+         * \param[in] newFilename The path to the spill file.  An empty string disables spilling.  Without a spill
+         *                        file, the oldest entries are discarded once the in-memory backlog is full.
          *
-         * \param[in] timestamp The Unix timestamp indicating when the request was triggered.
+         * \return Returns true on success.  Returns false if the file could not be opened or mapped.
+         */
+        bool setLatencySpillFile(const QString& newFilename);
+
+        /**
+         * Method you can use to determine the number of latency entries that have been recorded but not yet
+         * acknowledged by the database controller, including spilled entries.  This method is thread safe.
+         *
+         * \return Returns the latency backlog, in entries.
+         */
+        unsigned long latencyBacklog() const;
+
+        /**
+         * Method you can use to determine the number of latency entries currently held in the spill file.  This
+         * method is thread safe.
+         *
+         * \return Returns the number of spilled latency entries.
+         */
+        unsigned long spilledLatencyEntries() const;
+
+        /**
+         * Method you can use to determine the number of latency entries discarded because the backlog was full.  This
+         * method is thread safe.
          *
-         * \param[in] latency   The reported latency, in microseconds.
+         * \return Returns the number of discarded latency entries.
          */
-        void recordLatency(Monitor::MonitorId monitorId, unsigned long long timestamp, LatencyMicroseconds latency);
+        unsigned long long droppedLatencyEntries() const;
+
+        /**
+         * Method you can use to determine the number of latency window summaries that have been started but not yet
+         * acknowledged by the database controller.  This method is thread safe.
+         *
+         * \return Returns the number of unacknowledged latency summaries.
+         */
+        unsigned long latencySummaryBacklog() const;
+
+        /**
+         * Method you can use to determine the number of events waiting to be sent.  This method is thread safe.
+         *
+         * \return Returns the number of queued events.
+         */
+        unsigned long numberQueuedEvents() const;
+
+        /**
+         * Method you can use to determine the number of event batches currently in flight.  This method is thread
+         * safe.
+         *
+         * \return Returns the number of in-flight event batches.
+         */
+        unsigned numberInFlightEventBatches() const;
+
+        /**
+         * Method you can use to create a latency ring for a service thread.  Each service thread should create its own
+         * ring and use it when calling \ref DataAggregator::recordLatency.  This method is fully thread safe.
+         *
+         * \return Returns a newly created latency ring.  The data aggregator retains ownership of the ring.
+         */
+        LatencyRing* createLatencyRing();
+
+        /**
+         * Method you can use to release a latency ring once its service thread has stopped.  Entries still held in
+         * the ring are reported before the ring is destroyed.  This method is fully thread safe.
+         *
+         * \param[in] latencyRing The ring to be released.  The ring must not be used after this call.
+         */
+        void releaseLatencyRing(LatencyRing* latencyRing);
+
+        /**
+         * Method that can be called by a thread to report new latency data.  This method is lock-free and does not
+         * allocate memory provided that each latency ring is only ever used by a single thread.
+         *
+         * \param[in] latencyRing The calling thread's latency ring.
+         *
+         * \param[in] monitorId   The monitor ID of the monitor making the report.
+         *
+         * \param[in] timestamp   The Unix timestamp indicating when the request was triggered.
+         *
+         * \param[in] latency     The reported latency, in microseconds.
+         *
+         * \param[in] phases      The per-phase breakdown of the reported latency.  Use the default value if no
+         *                        breakdown was collected.
+         *
+         * \param[in] aggregated  If true, the latency is folded into a per-monitor window summary when the database
+         *                        controller accepts summaries.
+         */
+        void recordLatency(
+            LatencyRing*         latencyRing,
+            Monitor::MonitorId   monitorId,
+            unsigned long long   timestamp,
+            LatencyMicroseconds  latency,
+            const LatencyPhases& phases = LatencyPhases(),
+            bool                 aggregated = false
+        );
 
         /**
          * Method that can be called to report an event.  This method is fully thread safe.
@@ -381,13 +822,6 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
          */
         void triggerReporting(unsigned long delay = 0);
 
-        /**
-         * Signal you can use to start a retrial of a pending transmission request across threads.
-         *
-         * \param[out] delay The desired delay, in milliseconds.
-         */
-        void triggerRetry(unsigned long delay = 0);
-
         /**
          * Signal that is emitted to report an event.
          *
@@ -436,6 +870,15 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
          */
         void sendReport();
 
+        /**
+         * Slot you can use to trigger the data aggregator to send a report at a random time within a window.
+         * Polling servers told to report at the same moment then spread their reports across the window.  You can
+         * call this method from any thread.
+         *
+         * \param[in] window The window, in milliseconds.
+         */
+        void sendReportWithin(unsigned long window);
+
     private slots:
         /**
          * Slot that is triggered to report an event.
@@ -477,35 +920,38 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
             unsigned long long newExpirationTimestamp
         );
 
-    protected:
-        /**
-         * Method you can overload to process a received response.  The default implementation will trigger the
-         * \ref responseReceived signal.
-         *
-         * \param[in] binaryData  The received binary response.
-         *
-         * \param[in] contentType The response content type, if reported.
-         */
-        void processResponse(const QByteArray& binaryData, const QString& contentType) override;
-
+    private slots:
         /**
-         * Method you can overload to process a failed transmisison attempt.  The default implementation will
-         * trigger the \ref requestFailed signal.
+         * Slot that is triggered to start the report timer.  An already running timer is only restarted if the new
+         * delay would cause the report to be sent sooner.
          *
-         * \param[in] errorString a string providing an error message.
+         * \param[in] delay The desired delay, in milliseconds.
          */
-        void processRequestFailed(const QString& errorString) override;
+        void startReportTimer(unsigned long delay);
 
-    private slots:
         /**
          * Slot that is triggered to start reporting latency data.
          */
         void startReportingLatencyData();
 
         /**
-         * Slot that is triggered to start a transmission re-attempt.
+         * Slot that is triggered when the database controller responds to a latency report.
+         *
+         * \param[in] batch               The batch that sent the report.
+         *
+         * \param[in] accepted            If true, the report was accepted.  If false, the batch will retry the
+         *                                report.
+         *
+         * \param[in] supportedVersion    The newest report version the database controller advertised.
+         *
+         * \param[in] compressionAccepted If true, the database controller accepts compressed reports.
          */
-        void startRetry();
+        void batchResponseReceived(
+            LatencyBatch* batch,
+            bool          accepted,
+            unsigned      supportedVersion,
+            bool          compressionAccepted
+        );
 
     private:
         /**
@@ -514,27 +960,73 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
         static constexpr unsigned long maximumReportDelayMilliseconds = 60 * 1000; // 5 * 60 * 1000;
 
         /**
-         * The maximum number of stale entries allowed before we start reporting.
+         * The maximum number of stale entries allowed in any one latency ring before we start reporting.
          */
         static constexpr unsigned long maximumNumberPendingEntries = 1000;
 
         /**
-         * The delay before retrying to send data, in seconds.
+         * The maximum number of latency entries held in memory waiting to be reported.  Older entries are spilled to
+         * disk, or discarded if there is no spill file, once the limit is reached.
+         */
+        static constexpr unsigned long maximumListedEntries = 500000;
+
+        /**
+         * The maximum number of latency entries sent in a single report.  Larger backlogs are replayed a report at a
+         * time.
+         */
+        static constexpr unsigned long maximumEntriesPerReport = 20000;
+
+        /**
+         * The nominal delay between reports while a backlog is being replayed, in milliseconds.
+         */
+        static constexpr unsigned long replayDelayMilliseconds = 1000;
+
+        /**
+         * The time allowed after an aggregation window ends for late samples to arrive, in seconds.  Samples are
+         * timestamped when the request starts so they can trail the window by up to the request timeout.
          */
-        static constexpr unsigned retryDelaySeconds = 60;
+        static constexpr unsigned aggregationGraceSeconds = 60;
+
+        /**
+         * The maximum number of closed latency summaries held in memory waiting to be reported.  The oldest
+         * summaries are discarded once the limit is reached.
+         */
+        static constexpr int maximumListedSummaries = 200000;
+
+        /**
+         * The maximum number of latency summaries sent in a single report.
+         */
+        static constexpr int maximumSummariesPerReport = 5000;
 
         /**
          * The server maximum identifier length, in bytes.
          */
         static constexpr unsigned maximumIdentifierLength = 48;
 
+        /**
+         * The smallest report body we will attempt to compress, in bytes.
+         */
+        static constexpr int minimumCompressionSize = 1024;
+
+        /**
+         * Header compression code indicating that the report body is not compressed.
+         */
+        static constexpr std::uint8_t noCompression = 0;
+
+        /**
+         * Header compression code indicating that the report body is deflate compressed using qCompress framing (a
+         * 32-bit big-endian uncompressed length followed by a zlib stream).
+         */
+        static constexpr std::uint8_t deflateCompression = 1;
+
         /**
          * Structure that defines our latency record header.  Note that this structure is also defined in the
          * db_controller project with a structure that must match this one.
          */
         struct Header {
             /**
-             * A header version code value.  Currently ignored and set to 0.
+             * A header version code value indicating how the report body is encoded.  See
+             * \ref LatencyReportEncoder for details.
              */
             std::uint16_t version;
 
@@ -565,30 +1057,26 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
             std::uint8_t serverStatusCode;
 
             /**
-             * Reserved for future use.  Fill with zeros.
+             * The compression applied to the report body.  Version 0 reports are never compressed.
              */
-            std::uint8_t spare[64 - (2 + maximumIdentifierLength + 4 + 2 + 2 + 1)];
-        } __attribute__((packed));
+            std::uint8_t compression;
 
-        /**
-         * Structure that defines our latency entry.  Note that this structure is also defined in the db_controller
-         * project with a structure that must match this one.
-         */
-        struct Entry {
             /**
-             * The monitor ID.
+             * The network loading reported as a value between 0 and 65535 where 0 is 0% and 65535 is 100% of the
+             * link capacity in the busier direction.
              */
-            std::uint32_t monitorId;
+            std::uint16_t networkLoading;
 
             /**
-             * The Zoran timestamp.
+             * The load shedding level.  A value of 0 indicates the server is not shedding load.  Higher values
+             * indicate lower priority customers are being polled less often, see \ref HostSchemeTimer.
              */
-            std::uint32_t timestamp;
+            std::uint8_t sheddingLevel;
 
             /**
-             * The latency in microseconds
+             * Reserved for future use.  Fill with zeros.
              */
-            std::uint32_t latencyMicroseconds;
+            std::uint8_t spare[64 - (2 + maximumIdentifierLength + 4 + 2 + 2 + 1 + 1 + 2 + 1)];
         } __attribute__((packed));
 
         /**
@@ -597,11 +1085,109 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
         void configure();
 
         /**
-         * Method that builds and sends a latency report.
+         * Method that moves all entries from the latency rings and the overflow list into the pending latency entry
+         * list.  This method must only be called from the data aggregator's thread.
+         */
+        void drainLatencyRings();
+
+        /**
+         * Method that folds newly drained entries that should be aggregated into their window summaries.  Entries are
+         * only aggregated once the database controller accepts summaries.  This method must only be called from
+         * the data aggregator's thread.
+         *
+         * \param[in] firstEntry The index of the first newly drained entry in the pending latency entry list.
+         */
+        void aggregateLatencyEntries(int firstEntry);
+
+        /**
+         * Method that moves summaries for windows that have ended into the pending summary list.  This method must
+         * only be called from the data aggregator's thread.
+         */
+        void closeLatencySummaries();
+
+        /**
+         * Method that determines if summaries are waiting and can be reported.  This method must only be called from
+         * the data aggregator's thread.
+         *
+         * \return Returns true if summaries can be reported.
+         */
+        bool summariesReportable() const;
+
+        /**
+         * Method that publishes the number of listed entries and summaries for other threads.  This method must
+         * only be called from the data aggregator's thread.
+         */
+        void publishBacklog();
+
+        /**
+         * Method that discards the open, pending, and in-flight latency summaries.  Summaries can not be converted
+         * back to latency entries so this method is used when the database controller stops accepting summaries.
+         * This method must only be called from the data aggregator's thread.
+         */
+        void discardLatencySummaries();
+
+        /**
+         * Method that enforces the limit on the number of latency entries held in memory by spilling or discarding
+         * the oldest entries.  This method must only be called from the data aggregator's thread.
+         */
+        void limitLatencyEntryList();
+
+        /**
+         * Method that determines if the backlog holds more entries than can be sent in a single report.  This method
+         * must only be called from the data aggregator's thread.
+         *
+         * \return Returns true if the backlog must be replayed over multiple reports.
+         */
+        bool replayingBacklog() const;
+
+        /**
+         * Method that determines the number of latency reports that may currently be in flight.
+         *
+         * \return Returns the size of the reporting window.
+         */
+        unsigned reportWindow() const;
+
+        /**
+         * Method that removes the next report's worth of latency entries and summaries from the backlog.  This method
+         * must only be called from the data aggregator's thread.
+         *
+         * \param[out] entries   The list to receive the entries.
+         *
+         * \param[out] summaries The list to receive the summaries.
+         */
+        void takeReportEntries(LatencyEntryList& entries, LatencySummaryList& summaries);
+
+        /**
+         * Method that obtains an idle latency batch, creating one if needed.
+         *
+         * \return Returns an idle batch.
+         */
+        LatencyBatch* idleBatch();
+
+        /**
+         * Method that determines the number of latency entries waiting to be reported.  This method must only be
+         * called from the data aggregator's thread.
+         *
+         * \return Returns the number of pending latency entries.
+         */
+        unsigned long numberPendingEntries() const;
+
+        /**
+         * Method that builds a latency report.
+         *
+         * \param[in] latencyEntryList   The list of latency entries to be sent.
          *
-         * \param[in] latencyEntryList The list of latency entries to be sent.
+         * \param[in] latencySummaryList The list of latency summaries to be sent.
+         *
+         * \param[in] sequenceNumber     The report sequence number.
+         *
+         * \return Returns the encoded report, including the header.
          */
-        void sendReport(const LatencyEntryList& latencyEntryList);
+        QByteArray buildReport(
+            const LatencyEntryList&   latencyEntryList,
+            const LatencySummaryList& latencySummaryList,
+            unsigned long long        sequenceNumber
+        );
 
         /**
          * Class used to report events.
@@ -620,29 +1206,127 @@ class DataAggregator:public RestApiOutV1::InesonicBinaryRestHandler {
         Header headerTemplate;
 
         /**
-         * Mutex used to guard the latency event list.
+         * Mutex used to guard the list of latency rings.  The mutex is only used when rings are created or drained.
+         */
+        mutable QMutex ringMutex;
+
+        /**
+         * The latency rings, one per service thread.
+         */
+        QList<LatencyRing*> latencyRings;
+
+        /**
+         * Latency rings released by stopped service threads.  The rings are destroyed after their final drain.
+         */
+        QList<LatencyRing*> releasedLatencyRings;
+
+        /**
+         * Mutex used to guard the overflow list.
+         */
+        mutable QMutex overflowMutex;
+
+        /**
+         * List of entries that could not be placed in a full latency ring.  This list should normally be empty.
+         */
+        LatencyEntryList overflowEntries;
+
+        /**
+         * Flag indicating that a report has been scheduled since the rings were last drained.
          */
-        QMutex listMutex;
+        std::atomic<bool> reportScheduled;
 
         /**
-         * The current incoming latency entry list.
+         * Flag indicating that an immediate report has been requested since the rings were last drained.
+         */
+        std::atomic<bool> immediateReportRequested;
+
+        /**
+         * The latency entries drained from the rings that are waiting to be reported.  This list is only accessed
+         * from the data aggregator's thread.
          */
         LatencyEntryList* latencyEntryList;
 
         /**
-         * The in-flight latency entry list.
+         * The batches with a latency report in flight, oldest first.
          */
-        LatencyEntryList* inFlightLatencyEntryList;
+        QList<LatencyBatch*> inFlightBatches;
 
         /**
-         * Timer used to report latency data at periodic intervals.
+         * Batches available for reuse.
          */
-        QTimer* reportTimer;
+        QList<LatencyBatch*> idleBatches;
+
+        /**
+         * The maximum number of latency reports that can be in flight at once.
+         */
+        unsigned currentMaximumInFlightReports;
+
+        /**
+         * The number of latency reports in flight, published for other threads.
+         */
+        std::atomic<unsigned> currentNumberInFlightReports;
+
+        /**
+         * The open latency summaries, keyed by monitor ID in the upper 32 bits and window start in the lower 32 bits.
+         */
+        QHash<std::uint64_t, LatencySummary> openSummaries;
+
+        /**
+         * The Unix timestamp when the earliest open summary can be closed.
+         */
+        unsigned long long nextSummaryCloseTimestamp;
+
+        /**
+         * The closed latency summaries waiting to be reported, oldest first.
+         */
+        LatencySummaryList pendingSummaries;
+
+        /**
+         * The number of open, pending and in-flight latency summaries, published for other threads.
+         */
+        std::atomic<unsigned long> currentNumberListedSummaries;
 
         /**
-         * Timer used to retry transmission of latency data.
+         * The session ID sent with sequenced reports.  The value is chosen at random when the data aggregator is
+         * created.
          */
-        QTimer* retryTimer;
+        std::uint32_t currentSessionId;
+
+        /**
+         * The sequence number to be assigned to the next report.
+         */
+        unsigned long long nextSequenceNumber;
+
+        /**
+         * The number of entries held in the pending and in-flight latency entry lists, published for other threads.
+         */
+        std::atomic<unsigned long> currentNumberListedEntries;
+
+        /**
+         * The number of latency entries discarded because the backlog was full.
+         */
+        std::atomic<unsigned long long> currentNumberDroppedEntries;
+
+        /**
+         * The spill file holding the oldest latency entries once the in-memory backlog is full.
+         */
+        LatencySpill* latencySpill;
+
+
+        /**
+         * The report version negotiated with the database controller.
+         */
+        unsigned currentReportVersion;
+
+        /**
+         * Flag indicating that the database controller accepts compressed reports.
+         */
+        bool currentCompressionAccepted;
+
+        /**
+         * Timer used to report latency data at periodic intervals.
+         */
+        QTimer* reportTimer;
 };
 
 #endif
@@ -0,0 +1,247 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref DnsCache class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QThreadPool>
+
+#include <cstdint>
+
+#include "timing_wheel.h"
+
+/**
+ * Class that provides a process wide, asynchronous DNS cache shared by all service threads.
+ *
+ * Host names are resolved on a small, dedicated thread pool so lookups never block a service thread's network stack.
+ * Each lookup also refreshes Qt's internal host information cache which is what QNetworkAccessManager consults when
+ * opening a connection.  Service threads call \ref DnsCache::prefetch each time a host is polled so that the host is
+ * resolved again shortly before its next poll whenever the cached entry would otherwise be stale.
+ *
+ * Failed lookups are cached for a shorter period so unresolvable hosts are not looked up on every poll.  Entries that
+ * are not used for an extended period are discarded.
+ *
+ * Qt does not expose the DNS record TTL so a fixed lifetime is used.  The lifetime is kept below the lifetime used by
+ * Qt's own cache so our entries never outlive the entries QNetworkAccessManager relies on.
+ *
+ * Other than the constructor and destructor, all public methods of this class are thread safe.
+ */
+class DnsCache:public QObject, public TimingWheel::Client {
+    Q_OBJECT
+
+    public:
+        /**
+         * The lifetime of a successful lookup, in milliseconds.  Qt's internal cache holds entries for 60 seconds.
+         */
+        static constexpr unsigned long long positiveTimeToLive = 55000;
+
+        /**
+         * The lifetime of a failed lookup, in milliseconds.
+         */
+        static constexpr unsigned long long negativeTimeToLive = 30000;
+
+        /**
+         * The amount of time before a poll that a stale host will be resolved, in milliseconds.
+         */
+        static constexpr unsigned long long prefetchLeadTime = 2000;
+
+        /**
+         * The time after which an unused entry is discarded, in milliseconds.
+         */
+        static constexpr unsigned long long idleTimeout = 600000;
+
+        /**
+         * The maximum number of lookups that can be performed concurrently.
+         */
+        static constexpr int maximumConcurrentLookups = 4;
+
+        /**
+         * Constructor
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        DnsCache(QObject* parent = nullptr);
+
+        ~DnsCache() override;
+
+        /**
+         * Method you can call when a host is polled to make certain the host will be resolved before its next poll.
+         * This method returns immediately and only crosses threads when a lookup needs to be scheduled.
+         *
+         * \param[in] hostName The host name to be resolved.
+         *
+         * \param[in] pollTime The time of the next poll of this host, in milliseconds since the Unix epoch.
+         */
+        void prefetch(const QString& hostName, unsigned long long pollTime);
+
+        /**
+         * Method you can use to obtain a cached address for a host.
+         *
+         * \param[in]  hostName The host name of interest.
+         *
+         * \param[out] address  The first address reported for the host.  The value is only updated on success.
+         *
+         * \return Returns true if a current address is cached for the host.  Returns false if the host is unknown,
+         *         could not be resolved, or the cached entry is stale.
+         */
+        bool lookup(const QString& hostName, QHostAddress& address) const;
+
+        /**
+         * Method you can use to determine if a host is known to be unresolvable.
+         *
+         * \param[in] hostName The host name of interest.
+         *
+         * \return Returns true if the most recent lookup of the host failed and the failure is still current.
+         */
+        bool isUnresolvable(const QString& hostName) const;
+
+        /**
+         * Method you can use to obtain the number of hosts being tracked.
+         *
+         * \return Returns the number of cached hosts.
+         */
+        unsigned long numberEntries() const;
+
+    signals:
+        /**
+         * Signal that is emitted when a refreshed lookup no longer reports the address previously cached for a host.
+         * Use \ref DnsCache::lookup to obtain the new address.
+         *
+         * \param[in] hostName The host name whose address changed.
+         */
+        void addressChanged(const QString& hostName);
+
+    private:
+        /**
+         * Class used to track a single cached host.
+         */
+        class HostEntry:public TimingWheel::Entry {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] dnsCache The DNS cache tracking this entry.
+                 *
+                 * \param[in] hostName The host name tied to this entry.
+                 */
+                HostEntry(DnsCache* dnsCache, const QString& hostName);
+
+                ~HostEntry() override;
+
+                /**
+                 * The host name tied to this entry.
+                 */
+                QString hostName;
+
+                /**
+                 * The resolved addresses.  The list is empty if the host could not be resolved.
+                 */
+                QList<QHostAddress> addresses;
+
+                /**
+                 * The time this entry becomes stale, in milliseconds since the Unix epoch.  A value of 0 indicates
+                 * that the host has never been resolved.
+                 */
+                unsigned long long expirationTime;
+
+                /**
+                 * The last time this entry was requested, in milliseconds since the Unix epoch.
+                 */
+                unsigned long long lastUsedTime;
+
+                /**
+                 * Flag indicating that a refresh has been requested and not yet completed.
+                 */
+                bool refreshPending;
+
+                /**
+                 * Flag indicating that a lookup is currently running for this entry.
+                 */
+                bool lookupRunning;
+        };
+
+        /**
+         * Class used to resolve a single host on the lookup thread pool.
+         */
+        class LookupTask;
+
+        /**
+         * Type used to track entries by host name.
+         */
+        typedef QHash<QString, HostEntry*> EntriesByHostName;
+
+        /**
+         * Method that is called by the timing wheel when an entry expires.
+         *
+         * \param[in] entry       The entry that expired.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
+         */
+        void timerExpired(TimingWheel::Entry* entry, unsigned long long currentTime) override;
+
+        /**
+         * Method that schedules a refresh of a host.  This method must be called from the DNS cache's thread.
+         *
+         * \param[in] hostName The host name to be refreshed.
+         *
+         * \param[in] pollTime The time of the next poll of this host, in milliseconds since the Unix epoch.
+         */
+        void scheduleRefresh(const QString& hostName, unsigned long long pollTime);
+
+        /**
+         * Method that is called when a lookup completes.  This method must be called from the DNS cache's thread.
+         *
+         * \param[in] hostName The host name that was resolved.
+         *
+         * \param[in] hostInfo The results of the lookup.
+         */
+        void lookupCompleted(const QString& hostName, const QHostInfo& hostInfo);
+
+        /**
+         * Mutex used to protect the cached entries.
+         */
+        mutable QMutex entryMutex;
+
+        /**
+         * The cached entries, by host name.
+         */
+        EntriesByHostName entriesByHostName;
+
+        /**
+         * Timing wheel used to schedule lookups and to discard unused entries.
+         */
+        TimingWheel* timingWheel;
+
+        /**
+         * Thread pool used to perform blocking lookups.
+         */
+        QThreadPool lookupThreadPool;
+};
+
+#endif
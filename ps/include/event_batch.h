@@ -0,0 +1,341 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref EventBatch class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef EVENT_BATCH_H
+#define EVENT_BATCH_H
+
+#include <QObject>
+#include <QTimer>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <rest_api_out_v1_server.h>
+#include <rest_api_out_v1_inesonic_rest_handler.h>
+
+#include "host_scheme.h"
+#include "monitor.h"
+
+/**
+ * Class that reports a batch of events to the database controller.  Instances are owned and reused by the
+ * \ref EventReporter class.  A batch will retry indefinitely if the database controller can not be reached.
+ */
+class EventBatch:public RestApiOutV1::InesonicRestHandler {
+    Q_OBJECT
+
+    public:
+        /**
+         * The endpoint we should report events to.
+         */
+        static const QString eventReportPath;
+
+        /**
+         * Type used to represent an event type.
+         */
+        typedef HostScheme::EventType EventType;
+
+        /**
+         * Type used to represent the status of a monitor.
+         */
+        typedef Monitor::MonitorStatus MonitorStatus;
+
+        /**
+         * Type used to represent a monitor ID.
+         */
+        typedef Monitor::MonitorId MonitorId;
+
+        /**
+         * Class that holds a single event.  Log messages for the event are only generated when needed.
+         */
+        class Event {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] monitorId     The monitor ID of the monitor that detected the event.
+                 *
+                 * \param[in] timestamp     A timestamp indicating the event.
+                 *
+                 * \param[in] eventType     The type of event detected.
+                 *
+                 * \param[in] monitorStatus The monitor status of the monitor when the event occurred.
+                 *
+                 * \param[in] hash          The cryptographic hash of the page or discovered keywords.
+                 *
+                 * \param[in] message       A brief description of the event.
+                 */
+                inline Event(
+                        MonitorId          monitorId,
+                        unsigned long long timestamp,
+                        EventType          eventType,
+                        MonitorStatus      monitorStatus,
+                        const QByteArray&  hash,
+                        const QString&     message
+                    ):currentMonitorId(
+                        monitorId
+                    ),currentTimestamp(
+                        timestamp
+                    ),currentEventType(
+                        eventType
+                    ),currentMonitorStatus(
+                        monitorStatus
+                    ),currentHash(
+                        hash
+                    ),currentMessage(
+                        message
+                    ) {}
+
+                /**
+                 * Copy constructor
+                 *
+                 * \param[in] other The instance to be copied.
+                 */
+                inline Event(
+                        const Event& other
+                    ):currentMonitorId(
+                        other.currentMonitorId
+                    ),currentTimestamp(
+                        other.currentTimestamp
+                    ),currentEventType(
+                        other.currentEventType
+                    ),currentMonitorStatus(
+                        other.currentMonitorStatus
+                    ),currentHash(
+                        other.currentHash
+                    ),currentMessage(
+                        other.currentMessage
+                    ) {}
+
+                ~Event() = default;
+
+                /**
+                 * Method you can use to obtain the monitor ID.
+                 *
+                 * \return Returns the monitor ID.
+                 */
+                inline MonitorId monitorId() const {
+                    return currentMonitorId;
+                }
+
+                /**
+                 * Method you can use to obtain the event timestamp.
+                 *
+                 * \return Returns the event timestamp.
+                 */
+                inline unsigned long long timestamp() const {
+                    return currentTimestamp;
+                }
+
+                /**
+                 * Method that builds the JSON representation of this event.
+                 *
+                 * \return Returns the event as a JSON object.
+                 */
+                QJsonObject toJson() const;
+
+                /**
+                 * Method that builds a description of this event, suitable for the log.
+                 *
+                 * \return Returns a description of this event.
+                 */
+                QString description() const;
+
+                /**
+                 * Assignment operator
+                 *
+                 * \param[in] other The instance to assign to this instance.
+                 *
+                 * \return Returns a reference to this instance.
+                 */
+                inline Event& operator=(const Event& other) {
+                    currentMonitorId     = other.currentMonitorId;
+                    currentTimestamp     = other.currentTimestamp;
+                    currentEventType     = other.currentEventType;
+                    currentMonitorStatus = other.currentMonitorStatus;
+                    currentHash          = other.currentHash;
+                    currentMessage       = other.currentMessage;
+
+                    return *this;
+                }
+
+            private:
+                /**
+                 * The monitor ID.
+                 */
+                MonitorId currentMonitorId;
+
+                /**
+                 * The event timestamp.
+                 */
+                unsigned long long currentTimestamp;
+
+                /**
+                 * The event type.
+                 */
+                EventType currentEventType;
+
+                /**
+                 * The monitor status.
+                 */
+                MonitorStatus currentMonitorStatus;
+
+                /**
+                 * The page or keyword hash.
+                 */
+                QByteArray currentHash;
+
+                /**
+                 * The event message.
+                 */
+                QString currentMessage;
+        };
+
+        /**
+         * Type used to represent a list of events.
+         */
+        typedef QList<Event> EventList;
+
+        /**
+         * Constructor
+         *
+         * \param[in] server The server instance this REST API will talk to.
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        EventBatch(RestApiOutV1::Server* server, QObject* parent = nullptr);
+
+        /**
+         * Constructor
+         *
+         * \param[in] secret The secret to be used by this REST API.
+         *
+         * \param[in] server The server instance this REST API will talk to.
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        EventBatch(const QByteArray& secret, RestApiOutV1::Server* server, QObject* parent = nullptr);
+
+        ~EventBatch() override;
+
+        /**
+         * Method you can use to start sending a batch of events.  The batch must be idle.
+         *
+         * \param[in] events               The events to be sent.
+         *
+         * \param[in] multipleEventPayload If true, the events will be sent as a single multi-event payload.  If
+         *                                 false, the batch must contain exactly one event which will be sent using
+         *                                 the original single event payload.
+         */
+        void send(const EventList& events, bool multipleEventPayload);
+
+        /**
+         * Method you can use to obtain the number of events in this batch.
+         *
+         * \return Returns the number of events in this batch.
+         */
+        unsigned long numberEvents() const;
+
+    signals:
+        /**
+         * Signal that is emitted when the database controller has responded to this batch.  The batch is idle and
+         * can be reused once this signal is emitted.
+         *
+         * \param[out] batch                  Pointer to this batch.
+         *
+         * \param[out] multipleEventsAccepted If true, the database controller indicated that it accepts multi-event
+         *                                    payloads.
+         */
+        void completed(EventBatch* batch, bool multipleEventsAccepted);
+
+    protected:
+        /**
+         * Method you can overload to process a received response.  The default implementation will trigger the
+         * \ref jsonResponse signal.
+         *
+         * \param[in] jsonData The received JSON response.
+         */
+        void processJsonResponse(const QJsonDocument& jsonData) override;
+
+        /**
+         * Method you can overload to process a failed transmisison attempt.  The default implementation will
+         * trigger the \ref requestFailed signal.
+         *
+         * \param[in] errorString a string providing an error message.
+         */
+        void processRequestFailed(const QString& errorString) override;
+
+    private slots:
+        /**
+         * Slot that is triggered to resend this batch.
+         */
+        void resend();
+
+    private:
+        /**
+         * The delay before retrying this batch.
+         */
+        static const unsigned retryDelayInSeconds = 60;
+
+        /**
+         * Method that converts an event type to a string.
+         *
+         * \param[in] eventType The event type to be converted.
+         *
+         * \return Returns the event type as a lower case string.
+         */
+        static QString toString(EventType eventType);
+
+        /**
+         * Method that converts monitor status to a string.
+         *
+         * \param[in] monitorStatus The monitor status to be converted.
+         *
+         * \return Returns the monitor status as a lower case string.
+         */
+        static QString toString(MonitorStatus eventType);
+
+        /**
+         * Method that logs the failure of every event in this batch.
+         *
+         * \param[in] reason The reason for the failure.
+         */
+        void logFailures(const QString& reason);
+
+        /**
+         * Timer used to retry sending this batch.
+         */
+        QTimer retryTimer;
+
+        /**
+         * The events in this batch.
+         */
+        EventList currentEvents;
+
+        /**
+         * The payload being sent.
+         */
+        QJsonDocument currentPayload;
+};
+
+#endif
@@ -0,0 +1,229 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref EventLoopLagProbe class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef EVENT_LOOP_LAG_PROBE_H
+#define EVENT_LOOP_LAG_PROBE_H
+
+#include <QObject>
+
+#include <atomic>
+#include <cstdint>
+
+class QTimer;
+
+/**
+ * Class that measures how long events wait in a thread's event loop.  A precise timer is armed at a fixed interval
+ * and the difference between when it was due and when it was delivered is recorded as the event loop lag.  The probe
+ * must live in the thread it measures.  All accessors are thread safe.
+ */
+class EventLoopLagProbe:public QObject {
+    Q_OBJECT
+
+    public:
+        /**
+         * The lag, in nanoseconds, beyond which the thread is considered saturated and latency samples taken during
+         * the lag are excluded.
+         */
+        static constexpr unsigned long long highLagNanoseconds = 25ULL * 1000 * 1000;
+
+        /**
+         * Class that holds lag statistics for one reporting window.
+         */
+        class LagData {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] averageLag           The average lag, in seconds.
+                 *
+                 * \param[in] maximumLag           The maximum lag, in seconds.
+                 *
+                 * \param[in] numberHighLagSamples The number of probes, since the probe was created, that exceeded
+                 *                                 \ref EventLoopLagProbe::highLagNanoseconds.
+                 */
+                LagData(
+                    double        averageLag = 0,
+                    double        maximumLag = 0,
+                    unsigned long numberHighLagSamples = 0
+                ):currentAverageLag(
+                    averageLag
+                ),currentMaximumLag(
+                    maximumLag
+                ),currentNumberHighLagSamples(
+                    numberHighLagSamples
+                ) {}
+
+                /**
+                 * Method you can use to obtain the average lag.
+                 *
+                 * \return Returns the average lag, in seconds.
+                 */
+                inline double averageLag() const {
+                    return currentAverageLag;
+                }
+
+                /**
+                 * Method you can use to obtain the maximum lag.
+                 *
+                 * \return Returns the maximum lag, in seconds.
+                 */
+                inline double maximumLag() const {
+                    return currentMaximumLag;
+                }
+
+                /**
+                 * Method you can use to obtain the number of high lag samples.
+                 *
+                 * \return Returns the number of high lag samples.
+                 */
+                inline unsigned long numberHighLagSamples() const {
+                    return currentNumberHighLagSamples;
+                }
+
+            private:
+                /**
+                 * The average lag, in seconds.
+                 */
+                double currentAverageLag;
+
+                /**
+                 * The maximum lag, in seconds.
+                 */
+                double currentMaximumLag;
+
+                /**
+                 * The number of high lag samples.
+                 */
+                unsigned long currentNumberHighLagSamples;
+        };
+
+        /**
+         * Constructor.  The probe starts when it receives its first event in its thread.
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        EventLoopLagProbe(QObject* parent = nullptr);
+
+        ~EventLoopLagProbe() override;
+
+        /**
+         * Method you can use to obtain the current monotonic time as used by the probe.
+         *
+         * \return Returns the current monotonic time, in nanoseconds.
+         */
+        static unsigned long long currentTime();
+
+        /**
+         * Method you can use to determine how far the probe is currently overdue.  A non-zero value means that
+         * events are queued in the thread's event loop right now.
+         *
+         * \return Returns the current lag, in nanoseconds.
+         */
+        unsigned long long currentLag() const;
+
+        /**
+         * Method you can use to determine whether the thread has been saturated since a given time.
+         *
+         * \param[in] startTime The start of the interval of interest, as reported by
+         *                      \ref EventLoopLagProbe::currentTime.
+         *
+         * \return Returns true if lag above \ref EventLoopLagProbe::highLagNanoseconds was seen since the start
+         *         time or is being seen now.
+         */
+        bool laggedSince(unsigned long long startTime) const;
+
+        /**
+         * Method you can use to obtain the lag statistics for the most recently completed reporting window.
+         *
+         * \return Returns the lag statistics.
+         */
+        LagData lagData() const;
+
+    private slots:
+        /**
+         * Slot that is triggered when the probe timer expires.
+         */
+        void probe();
+
+    private:
+        /**
+         * The probe interval, in milliseconds.
+         */
+        static constexpr unsigned probeIntervalMilliseconds = 50;
+
+        /**
+         * The reporting window, in nanoseconds.
+         */
+        static constexpr unsigned long long windowNanoseconds = 10ULL * 1000 * 1000 * 1000;
+
+        /**
+         * The probe timer.
+         */
+        QTimer* probeTimer;
+
+        /**
+         * The time the next probe is due, in nanoseconds.  A value of 0 indicates that the probe is not running.
+         */
+        std::atomic<unsigned long long> nextProbeTime;
+
+        /**
+         * The time of the most recent probe that saw high lag, in nanoseconds.
+         */
+        std::atomic<unsigned long long> lastHighLagTime;
+
+        /**
+         * The number of probes that saw high lag.
+         */
+        std::atomic<unsigned long> numberHighLagSamples;
+
+        /**
+         * The average lag for the last completed window, in nanoseconds.
+         */
+        std::atomic<unsigned long long> publishedAverageLag;
+
+        /**
+         * The maximum lag for the last completed window, in nanoseconds.
+         */
+        std::atomic<unsigned long long> publishedMaximumLag;
+
+        /**
+         * The start of the current window, in nanoseconds.
+         */
+        unsigned long long windowStartTime;
+
+        /**
+         * The sum of lags in the current window, in nanoseconds.
+         */
+        unsigned long long windowSumLag;
+
+        /**
+         * The maximum lag in the current window, in nanoseconds.
+         */
+        unsigned long long windowMaximumLag;
+
+        /**
+         * The number of probes in the current window.
+         */
+        unsigned long windowNumberSamples;
+};
+
+#endif
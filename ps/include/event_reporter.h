@@ -24,33 +24,34 @@
 #define EVENT_REPORTER_H
 
 #include <QObject>
-#include <QTimer>
 #include <QString>
 #include <QByteArray>
-#include <QJsonDocument>
-#include <QJsonObject>
+#include <QList>
+#include <QHash>
+#include <QSet>
+
+#include <atomic>
 
 #include <rest_api_out_v1_server.h>
-#include <rest_api_out_v1_inesonic_rest_handler.h>
 
 #include "host_scheme.h"
 #include "monitor.h"
+#include "event_batch.h"
 
 /**
- * Class that performs asynchronous reporting of an event.  This class is expected to be dynamically allocated and
- * will delete itself automatically upon successful event reporting.
+ * Class that performs asynchronous reporting of events.  Events are queued and sent to the database controller in
+ * batches.  Several batches can be in flight at once so a slow or failing request does not hold up later events.
+ *
+ * Events are sent one per request until the database controller indicates that it accepts multi-event payloads.
  *
- * To use, instantiate an instance and then call the \ref startReporting method (or trigger it).
+ * Events for a given monitor are always delivered in the order they were reported.  While a batch carrying a
+ * monitor's events is being sent or retried, later events for that monitor are held in the queue.  Events for other
+ * monitors can pass them.
  */
-class EventReporter:public RestApiOutV1::InesonicRestHandler {
+class EventReporter:public QObject {
     Q_OBJECT
 
     public:
-        /**
-         * The endpoint we should report events to.
-         */
-        static const QString eventReportPath;
-
         /**
          * Type used to represent an event type.
          */
@@ -66,6 +67,16 @@ class EventReporter:public RestApiOutV1::InesonicRestHandler {
          */
         typedef Monitor::MonitorId MonitorId;
 
+        /**
+         * The default maximum number of batches that can be in flight at once.
+         */
+        static constexpr unsigned defaultMaximumInFlightBatches = 4;
+
+        /**
+         * The maximum number of events placed in a single batch.
+         */
+        static constexpr unsigned maximumEventsPerBatch = 100;
+
         /**
          * Constructor
          *
@@ -86,6 +97,39 @@ class EventReporter:public RestApiOutV1::InesonicRestHandler {
          */
         EventReporter(const QByteArray& secret, RestApiOutV1::Server* server, QObject* parent = nullptr);
 
+        ~EventReporter() override;
+
+        /**
+         * Method you can use to obtain the maximum number of batches that can be in flight at once.
+         *
+         * \return Returns the maximum number of in-flight batches.
+         */
+        unsigned maximumInFlightBatches() const;
+
+        /**
+         * Method you can use to set the maximum number of batches that can be in flight at once.  Reducing the value
+         * does not affect batches already in flight.
+         *
+         * \param[in] newMaximumInFlightBatches The new maximum number of in-flight batches.  A value of 0 is treated
+         *                                      as 1.
+         */
+        void setMaximumInFlightBatches(unsigned newMaximumInFlightBatches);
+
+        /**
+         * Method you can use to determine the number of events waiting to be placed in a batch.  This method is
+         * thread safe.
+         *
+         * \return Returns the number of queued events.
+         */
+        unsigned long numberQueuedEvents() const;
+
+        /**
+         * Method you can use to determine the number of batches currently in flight.  This method is thread safe.
+         *
+         * \return Returns the number of in-flight batches.
+         */
+        unsigned numberInFlightBatches() const;
+
     public slots:
         /**
          * Slot you can trigger to initiate reporting.
@@ -112,200 +156,79 @@ class EventReporter:public RestApiOutV1::InesonicRestHandler {
             const QString&     message = QString()
         );
 
-    protected:
+    private slots:
         /**
-         * Method you can overload to process a received response.  The default implementation will trigger the
-         * \ref jsonResponse signal.
+         * Slot that is triggered when a batch completes.
+         *
+         * \param[in] batch                  The batch that completed.
          *
-         * \param[in] jsonData The received JSON response.
+         * \param[in] multipleEventsAccepted If true, the database controller accepts multi-event payloads.
+         */
+        void batchCompleted(EventBatch* batch, bool multipleEventsAccepted);
+
+    private:
+        /**
+         * Method that starts as many batches as allowed from the queued events.  Events for monitors that already
+         * have events in flight are left in the queue.
          */
-        void processJsonResponse(const QJsonDocument& jsonData) override;
+        void dispatch();
 
         /**
-         * Method you can overload to process a failed transmisison attempt.  The default implementation will
-         * trigger the \ref requestFailed signal.
+         * Method that obtains an idle batch, creating one if needed.
          *
-         * \param[in] errorString a string providing an error message.
+         * \return Returns an idle batch.
          */
-        void processRequestFailed(const QString& errorString) override;
+        EventBatch* idleBatch();
 
-    private slots:
         /**
-         * Slot that is triggered to resend this request.
+         * The server used to send events.
          */
-        void resend();
+        RestApiOutV1::Server* currentServer;
 
-    private:
         /**
-         * The delay before retrying this event.
+         * The secret used to send events.  An empty secret indicates that the server's default secret is used.
          */
-        static const unsigned retryDelayInSeconds = 60;
+        QByteArray currentSecret;
 
         /**
-         * Class that holds information about a pending message.
+         * The maximum number of in-flight batches.
          */
-        class Message {
-            public:
-                /**
-                 * Constructor
-                 *
-                 * \param[in] jsonMessage    The JSON message to be sent.
-                 *
-                 * \param[in] successMessage The message to show in the log on success.
-                 *
-                 * \param[in] failureMessage The message to show in the log on failure.
-                 */
-                inline Message(
-                        const QJsonDocument& jsonMessage,
-                        const QString&       successMessage,
-                        const QString&       failureMessage
-                    ):currentJsonMessage(
-                        jsonMessage
-                    ),currentSuccessMessage(
-                        successMessage
-                    ),currentFailureMessage(
-                        failureMessage
-                    ) {}
-
-                /**
-                 * Copy constructor
-                 *
-                 * \param[in] jsonMessage    The JSON message to be sent.
-                 *
-                 * \param[in] successMessage The message to show in the log on success.
-                 *
-                 * \param[in] failureMessage The message to show in the log on failure.
-                 */
-                inline Message(
-                        const Message& other
-                    ):currentJsonMessage(
-                        other.currentJsonMessage
-                    ),currentSuccessMessage(
-                        other.currentSuccessMessage
-                    ),currentFailureMessage(
-                        other.currentFailureMessage
-                    ) {}
-
-                /**
-                 * Copy constructor (move semantics)
-                 *
-                 * \param[in] jsonMessage    The JSON message to be sent.
-                 *
-                 * \param[in] successMessage The message to show in the log on success.
-                 *
-                 * \param[in] failureMessage The message to show in the log on failure.
-                 */
-                inline Message(
-                        Message&& other
-                    ):currentJsonMessage(
-                        other.currentJsonMessage
-                    ),currentSuccessMessage(
-                        other.currentSuccessMessage
-                    ),currentFailureMessage(
-                        other.currentFailureMessage
-                    ) {}
-
-                /**
-                 * Method that provides the current JSON encoded message.
-                 *
-                 * \return Returns the current JSON encoded message.
-                 */
-                inline const QJsonDocument& message() const {
-                    return currentJsonMessage;
-                }
-
-                /**
-                 * Method that provides the current success message.
-                 *
-                 * \return Returns the current success message.
-                 */
-                inline const QString& successMessage() const {
-                    return currentSuccessMessage;
-                }
-
-                /**
-                 * Method that provides the current failure message.
-                 *
-                 * \return Returns the current failure message.
-                 */
-                inline const QString& failureMessage() const {
-                    return currentFailureMessage;
-                }
-
-                /**
-                 * Assignment operator
-                 *
-                 * \param[in] other The instance to assign to this instance.
-                 *
-                 * \return Returns a reference to this instance.
-                 */
-                inline Message& operator=(const Message& other) {
-                    currentJsonMessage    = other.currentJsonMessage;
-                    currentSuccessMessage = other.currentSuccessMessage;
-                    currentFailureMessage = other.currentFailureMessage;
-
-                    return *this;
-                }
-
-                /**
-                 * Assignment operator (move semantics)
-                 *
-                 * \param[in] other The instance to assign to this instance.
-                 *
-                 * \return Returns a reference to this instance.
-                 */
-                inline Message& operator=(Message&& other) {
-                    currentJsonMessage    = other.currentJsonMessage;
-                    currentSuccessMessage = other.currentSuccessMessage;
-                    currentFailureMessage = other.currentFailureMessage;
-
-                    return *this;
-                }
-
-            private:
-                /**
-                 * The pending JSON message.
-                 */
-                QJsonDocument currentJsonMessage;
-
-                /**
-                 * The current success message.
-                 */
-                QString currentSuccessMessage;
-
-                /**
-                 * The current failure message.
-                 */
-                QString currentFailureMessage;
-        };
+        unsigned currentMaximumInFlightBatches;
 
         /**
-         * Method that converts an event type to a string.
-         *
-         * \param[in] eventType The event type to be converted.
-         *
-         * \return Returns the event type as a lower case string.
+         * The number of batches currently in flight.
          */
-        static QString toString(EventType eventType);
+        std::atomic<unsigned> currentNumberInFlightBatches;
 
         /**
-         * Method that converts monitor status to a string.
-         *
-         * \param[in] monitorStatus The monitor status to be converted.
-         *
-         * \return Returns the monitor status as a lower case string.
+         * The number of queued events, published for other threads.
+         */
+        std::atomic<unsigned long> currentNumberQueuedEvents;
+
+        /**
+         * Flag indicating that the database controller accepts multi-event payloads.
+         */
+        bool currentMultipleEventsAccepted;
+
+        /**
+         * Batches that are available for reuse.
+         */
+        QList<EventBatch*> idleBatches;
+
+        /**
+         * Events waiting to be placed in a batch.
          */
-        static QString toString(MonitorStatus eventType);
+        EventBatch::EventList queuedEvents;
 
         /**
-         * Timer used to retry sending requests.
+         * The monitors with events in flight.
          */
-        QTimer retryTimer;
+        QSet<MonitorId> inFlightMonitorIds;
 
         /**
-         * List of pending messages.
+         * The monitors carried by each in-flight batch.
          */
-        QList<Message> pendingMessages;
+        QHash<EventBatch*, QList<MonitorId>> monitorIdsByBatch;
 };
 
 #endif
@@ -26,18 +26,20 @@
 #include <QString>
 #include <QUrl>
 #include <QHash>
-#include <QMutex>
-#include <QSet>
+#include <QByteArray>
+#include <QSslConfiguration>
 
 #include <cstdint>
 
 #include <monitor.h>
 
-class QNetworkAccessManager;
+class HttpEngine;
 class Customer;
 
 /**
- * Class that manages a host/scheme, including background ping based polling and timing of monitor checks.
+ * Class that manages a host/scheme, including background ping based polling and timing of monitor checks.  A
+ * host/scheme, along with its monitors, is only ever used from within the thread servicing its customer.  Requests
+ * from other threads are posted to that thread by the \ref HttpServiceThread.
  */
 class HostScheme:public QObject {
     Q_OBJECT
@@ -96,11 +98,38 @@ class HostScheme:public QObject {
          */
         typedef QHash<Monitor::MonitorId, Monitor*> MonitorsByMonitorId;
 
+        /**
+         * Enumeration of outcomes for the recheck of non-responsive monitors performed when a host/scheme is
+         * serviced.
+         */
+        enum class RecheckOutcome {
+            /**
+             * Indicates that no monitor under this host/scheme is non-responsive.
+             */
+            NONE,
+
+            /**
+             * Indicates that a non-responsive monitor was rechecked.
+             */
+            PERFORMED,
+
+            /**
+             * Indicates that every non-responsive monitor is backing off so no recheck was performed.
+             */
+            DEFERRED
+        };
+
         /**
          * Value indicating an invalid or unknown SSL expiration timestamp.
          */
         static constexpr unsigned long long invalidSslExpirationTimestamp = 0;
 
+        /**
+         * The interval, in seconds, after which the SSL certificate is inspected even if no new TLS handshake has
+         * been performed.
+         */
+        static constexpr unsigned long long certificateRecheckInterval = 3600;
+
         /**
          * Constructor.
          *
@@ -115,18 +144,19 @@ class HostScheme:public QObject {
         ~HostScheme() override;
 
         /**
-         * Method you can use to determine the network access manager being used by monitors under this host/scheme.
+         * Method you can use to determine the HTTP engine being used by monitors under this host/scheme.
          *
-         * \return Returns the network access manager being used by this monitor.
+         * \return Returns the HTTP engine being used by this host/scheme.
          */
-        QNetworkAccessManager* networkAccessManager() const;
+        HttpEngine* httpEngine() const;
 
         /**
-         * Method you can use to set the network access manager to be used by monitors under this host/scheme.
+         * Method you can use to set the HTTP engine to be used by monitors under this host/scheme.  Checks already
+         * in flight complete on the engine that started them.
          *
-         * \param[in] newNetworkAccessManager The new network access manager to be used by this monitor.
+         * \param[in] newHttpEngine The new HTTP engine to be used by this host/scheme.
          */
-        void setNetworkAccessManager(QNetworkAccessManager* newNetworkAccessManager);
+        void setHttpEngine(HttpEngine* newHttpEngine);
 
         /**
          * Method you can use to add a monitor to this host/scheme.  Monitors are tracked by monitor ID.  If a monitor
@@ -219,44 +249,92 @@ class HostScheme:public QObject {
         void setSslExpirationTimestamp(unsigned long long newSslExpirationTimestamp);
 
         /**
-         * Method that determines the number of monitors under this host/scheme.
+         * Method you can use to determine if the SSL certificate should be inspected.  Certificates are inspected
+         * after each new TLS handshake and otherwise once every \ref certificateRecheckInterval seconds.
          *
-         * \return Returns the number of monitors under this host/scheme.
+         * \param[in] newHandshake If true, the response was received over a newly negotiated TLS session.
+         *
+         * \param[in] timestamp    The current Unix timestamp.
+         *
+         * \return Returns true if the certificate should be inspected.  The certificate is assumed to be inspected
+         *         whenever this method returns true.
          */
-        inline unsigned numberMonitors() const {
-            return static_cast<unsigned>(children().size());
-        }
+        bool certificateCheckNeeded(bool newHandshake, unsigned long long timestamp);
 
         /**
-         * Method you can use to trigger this monitor from a different thread.
+         * Method you can use to obtain the SSL configuration shared by this host/scheme's monitors.  The
+         * configuration carries the most recent TLS session ticket so new connections can resume the session.
+         *
+         * \return Returns the SSL configuration.
+         */
+        const QSslConfiguration& sslConfiguration() const;
+
+        /**
+         * Method you can use to obtain a value that changes each time the SSL configuration changes.
+         *
+         * \return Returns the SSL configuration generation.  The value is never 0.
          */
-        void startCheckFromDifferentThread();
+        unsigned sslSessionGeneration() const;
 
-    signals:
         /**
-         * Signal that is emitted when a request has been made to immediately check this host/scheme from anther
-         * thread.
+         * Method you can use to record a TLS session ticket issued by the remote host.
+         *
+         * \param[in] sessionTicket The session ticket.  Empty tickets are ignored.
+         */
+        void updateSslSession(const QByteArray& sessionTicket);
+
+        /**
+         * Method you can use to update this host/scheme to match a newly received description of the same host/scheme.
+         * Monitors that are unchanged keep their state.  Monitors that have changed are updated in place.  New
+         * monitors are taken from the provided host/scheme and monitors that no longer exist are removed.
+         *
+         * This method must be called from this host/scheme's thread and the provided host/scheme must live in the
+         * same thread.  The provided host/scheme should be deleted afterwards.
+         *
+         * \param[in] hostScheme The host/scheme holding the new settings.
          */
-        void startCheckRequested();
+        void updateFrom(HostScheme* hostScheme);
+
+        /**
+         * Method you can use to rebuild the set of non-responsive monitors from the current monitor status values.
+         * This method is used after monitor state has been restored.
+         */
+        void resetNonResponsiveMonitors();
+
+        /**
+         * Method that determines the number of monitors under this host/scheme.
+         *
+         * \return Returns the number of monitors under this host/scheme.
+         */
+        inline unsigned numberMonitors() const {
+            return static_cast<unsigned>(children().size());
+        }
 
     public slots:
         /**
          * Slot you can trigger to start servicing the next monitor under this host/scheme. This slot must be called
-         * from the same thread as the timer, if invoked directly.
+         * from the thread that owns this object.
+         *
+         * In addition to the next monitor, one non-responsive monitor whose recheck is due is checked.  The first
+         * recheck of a failed monitor is performed after the customer's confirmation delay.  The delay then doubles
+         * with each recheck, up to the customer's maximum recheck interval.
+         *
+         * \return Returns the outcome of the recheck of non-responsive monitors.
          */
-        void serviceNextMonitor();
+        RecheckOutcome serviceNextMonitor();
 
         /**
-         * Slot you can trigger to report that a monitor is non-responsive.  Timing for non-responsive monitors will
-         * be adjusted to detect their response more quickly.
+         * Slot you can trigger to report that a monitor is non-responsive.  The monitor will be rechecked after the
+         * customer's confirmation delay to quickly confirm the failure, and then with exponential backoff.
          *
          * \param monitor Pointer to the non-responsive monitor.
          */
         void monitorNonResponsive(Monitor* monitor);
 
         /**
-         * Slot you can trigger to report that a monitor is now responsive.  Timing for non-responsive monitors will
-         * be adjusted to detect their response more quickly.
+         * Slot you can trigger to report that a monitor is now responsive.  As other monitors under this host/scheme
+         * are likely to have recovered as well, the next non-responsive monitor whose recheck is due is checked
+         * immediately.
          *
          * This slot must either be triggered by a signal or called from the thread that owns this object.
          *
@@ -265,6 +343,77 @@ class HostScheme:public QObject {
         void monitorNowResponsive(Monitor* monitor);
 
     private:
+        /**
+         * Trivial class that tracks the recheck schedule of a non-responsive monitor.
+         */
+        class RecheckState {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] firstRecheckTime The time of the first recheck, in milliseconds since the Unix epoch.
+                 */
+                inline RecheckState(
+                        unsigned long long firstRecheckTime = 0
+                    ):numberRechecks(
+                        0
+                    ),nextRecheckTime(
+                        firstRecheckTime
+                    ) {}
+
+                /**
+                 * The number of rechecks performed since the monitor became non-responsive.
+                 */
+                unsigned numberRechecks;
+
+                /**
+                 * The time the next recheck is due, in milliseconds since the Unix epoch.
+                 */
+                unsigned long long nextRecheckTime;
+        };
+
+        /**
+         * Hash table of recheck state by non-responsive monitor.
+         */
+        typedef QHash<Monitor*, RecheckState> NonResponsiveMonitors;
+
+        /**
+         * Method that locates the next non-responsive monitor whose recheck is due and schedules its following
+         * recheck.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
+         *
+         * \return Returns the monitor to be rechecked.  A null pointer is returned if no recheck is due.
+         */
+        Monitor* dueNonResponsiveMonitor(unsigned long long currentTime);
+
+        /**
+         * Method that calculates the delay before a recheck of a non-responsive monitor using this host/scheme's
+         * customer settings.
+         *
+         * \param[in] numberRechecks The number of rechecks already performed.
+         *
+         * \return Returns the recheck delay, in milliseconds.
+         */
+        unsigned long long recheckDelay(unsigned numberRechecks) const;
+
+        /**
+         * Method that adds a monitor to the non-responsive monitors, or replaces its recheck state, keeping our
+         * iterator valid.
+         *
+         * \param[in] monitor      The non-responsive monitor.
+         *
+         * \param[in] recheckState The recheck state for the monitor.
+         */
+        void addNonResponsiveMonitor(Monitor* monitor, const RecheckState& recheckState);
+
+        /**
+         * Method that removes a monitor from the non-responsive monitors, keeping our iterator valid.
+         *
+         * \param[in] monitor The monitor to be removed.
+         */
+        void removeNonResponsiveMonitor(Monitor* monitor);
+
         /**
          * Method that is called by the host/scheme when a monitor has been added.
          *
@@ -289,9 +438,22 @@ class HostScheme:public QObject {
         void reportExistingMonitors(Customer* customer, bool adding);
 
         /**
-         * The current network access manager.
+         * Method that resets the SSL configuration and certificate check state.  Used when the host changes.
          */
-        QNetworkAccessManager* currentNetworkAccessManager;
+        void resetSslState();
+
+        /**
+         * Method that obtains the SSL configuration used before a session ticket has been issued.  Session
+         * persistence is enabled so the ticket can be recovered from the reply.
+         *
+         * \return Returns the initial SSL configuration.
+         */
+        static const QSslConfiguration& initialSslConfiguration();
+
+        /**
+         * The current HTTP engine.
+         */
+        HttpEngine* currentHttpEngine;
 
         /**
          * The host/scheme ID of this host scheme.
@@ -309,19 +471,29 @@ class HostScheme:public QObject {
         unsigned long long currentSslExpirationTimestamp;
 
         /**
-         * Mutex used to protect our monitor hash table.
+         * The Unix timestamp of the last SSL certificate inspection.
+         */
+        unsigned long long lastCertificateCheckTimestamp;
+
+        /**
+         * The SSL configuration shared by this host/scheme's monitors.
+         */
+        QSslConfiguration currentSslConfiguration;
+
+        /**
+         * The SSL configuration generation.
          */
-        QMutex monitorMutex;
+        unsigned currentSslSessionGeneration;
 
         /**
-         * Set of non-responsive monitors.
+         * Hash table of non-responsive monitors and their recheck state.
          */
-        QSet<Monitor*> nonResponsiveMonitors;
+        NonResponsiveMonitors nonResponsiveMonitors;
 
         /**
-         * Iterator into the set of non-responsive monitors.
+         * Iterator into the hash table of non-responsive monitors.
          */
-        QSet<Monitor*>::iterator nonResponsiveMonitorsIterator;
+        NonResponsiveMonitors::iterator nonResponsiveMonitorsIterator;
 
         /**
          * Hash table of monitors under this host/scheme.
@@ -24,24 +24,62 @@
 #define HOST_SCHEME_TIMER_H
 
 #include <QObject>
-#include <QMap>
-#include <QTimer>
+#include <QHash>
+#include <QMutex>
 #include <QPointer>
+#include <QString>
 
 #include <cstdint>
+#include <atomic>
 
 #include "monitor.h"
 #include "loading_data.h"
 #include "host_scheme.h"
 #include "customer.h"
+#include "timing_wheel.h"
+
+class DnsCache;
 
 /**
- * Class that manages timing of checks by host/scheme.
+ * Class that manages timing of checks by host/scheme.  Host/schemes are spread across the polling period by the
+ * bit-reversed host/scheme ID and are scheduled using the service thread's \ref TimingWheel instance.
+ *
+ * When timing marks are missed over several consecutive windows, the timer starts shedding load.  Host/schemes of
+ * lower priority customers are then polled on only some of their cycles, and late high priority host/schemes are
+ * serviced immediately instead of waiting for the overload policy.  The shedding level is raised or lowered one step
+ * at a time as the lateness persists or clears.
  */
-class HostSchemeTimer:public QObject {
+class HostSchemeTimer:public QObject, public TimingWheel::Client {
     Q_OBJECT
 
     public:
+        /**
+         * Enumeration of policies used when host/schemes are serviced well after their timing marks.
+         */
+        enum class OverloadPolicy {
+            /**
+             * Late host/schemes are spread across the following slots so that a stall does not turn into a burst of
+             * simultaneous requests.
+             */
+            SPREAD,
+
+            /**
+             * Late host/schemes skip the current cycle and are serviced at their next timing mark.
+             */
+            SKIP,
+
+            /**
+             * Late multi-region host/schemes, which other regions also cover, skip the current cycle.  Late
+             * single-region host/schemes are spread.
+             */
+            SHED
+        };
+
+        /**
+         * The highest load shedding level.
+         */
+        static constexpr unsigned maximumSheddingLevel = 2;
+
         /**
          * Constructor.
          *
@@ -56,34 +94,71 @@ class HostSchemeTimer:public QObject {
          *
          * \param[in] startActive   If true, then we're active. if false, then we're inactive.
          *
+         * \param[in] timingWheel   The timing wheel used to schedule our host/schemes.  The timing wheel must live in
+         *                          the same thread as this timer.
+         *
+         * \param[in] dnsCache      The DNS cache used to resolve hosts ahead of each poll.  A null pointer can be
+         *                          used to disable prefetching.
+         *
          * \param[in] parent        Pointer to the parent object.
          */
         HostSchemeTimer(
-            bool     multiRegion,
-            int      period,
-            unsigned regionIndex,
-            unsigned numberRegions,
-            bool     startActive,
-            QObject* parent = nullptr
+            bool         multiRegion,
+            int          period,
+            unsigned     regionIndex,
+            unsigned     numberRegions,
+            bool         startActive,
+            TimingWheel* timingWheel,
+            DnsCache*    dnsCache = nullptr,
+            QObject*     parent = nullptr
         );
 
         ~HostSchemeTimer() override;
 
         /**
          * Method you can use to obtain a service metric for this timer.  Returned value is in monitors per
-         * second.
+         * second.  This method is thread safe.
          *
          * \return Returns the current monitor service metric.
          */
         float monitorsPerSecond() const;
 
         /**
-         * Method you can use to obtain the current loading data for this host/scheme timer.
+         * Method you can use to obtain the current loading data for this host/scheme timer.  You must call this
+         * method from within the thread that owns this timer.
          *
          * \return Returns the loading data for this host/scheme timer.
          */
         LoadingData loadingData() const;
 
+        /**
+         * Method you can use to obtain loading data accumulated since this timer was created.  Unlike
+         * \ref HostSchemeTimer::loadingData, the values are updated on every poll so callers can compute loading over
+         * any interval by comparing successive snapshots.  This method is thread safe.
+         *
+         * \return Returns the cumulative loading data.  The polled host/scheme count holds the total number of polls
+         *         performed.
+         */
+        LoadingData cumulativeLoadingData() const;
+
+        /**
+         * Method you can use to obtain this timer's load shedding level.  This method is thread safe.
+         *
+         * \return Returns the load shedding level.  A value of 0 indicates load is not being shed.
+         */
+        unsigned sheddingLevel() const;
+
+        /**
+         * Method that determines how often a host/scheme is polled while load is being shed.
+         *
+         * \param[in] priority      The priority tier of the host/scheme's customer.
+         *
+         * \param[in] sheddingLevel The load shedding level.
+         *
+         * \return Returns the number of polling cycles per poll.  A value of 1 indicates every cycle is polled.
+         */
+        static unsigned cadenceDivisor(Customer::Priority priority, unsigned sheddingLevel);
+
         /**
          * Method you can use to add a host/scheme.  Host schemes are tracked by host scheme ID and also by customer
          * ID.  If a host/scheme is registered with the same host/scheme ID, the exsting host scheme will be replaced.
@@ -113,6 +188,58 @@ class HostSchemeTimer:public QObject {
          */
         QPointer<HostScheme> getHostScheme(HostScheme::HostSchemeId hostSchemeId) const;
 
+        /**
+         * Method you can use to set the overload policy used by all host/scheme timers.  This method is thread safe.
+         *
+         * \param[in] newOverloadPolicy The new overload policy.
+         */
+        static void setOverloadPolicy(OverloadPolicy newOverloadPolicy);
+
+        /**
+         * Method you can use to obtain the overload policy used by all host/scheme timers.  This method is thread
+         * safe.
+         *
+         * \return Returns the current overload policy.
+         */
+        static OverloadPolicy overloadPolicy();
+
+        /**
+         * Method you can use to convert a policy name to an overload policy.
+         *
+         * \param[in]  name The policy name, "spread", "skip", or "shed".
+         *
+         * \param[out] ok   Optional pointer to a flag set to false if the name is not recognized.
+         *
+         * \return Returns the overload policy.  \ref OverloadPolicy::SPREAD is returned for unrecognized names.
+         */
+        static OverloadPolicy toOverloadPolicy(const QString& name, bool* ok = nullptr);
+
+        /**
+         * Method you can use to set the number of polling cycles over which region changes are staged.  When
+         * staged, an active timer slides its region offset from the old value to the new value rather than
+         * rescheduling every host/scheme at once.  This method is thread safe.
+         *
+         * \param[in] numberCycles The number of polling cycles.  A value of 0 applies region changes immediately.
+         */
+        static void setRegionTransitionCycles(unsigned numberCycles);
+
+        /**
+         * Method you can use to obtain the number of polling cycles over which region changes are staged.  This
+         * method is thread safe.
+         *
+         * \return Returns the number of polling cycles.  A value of 0 indicates region changes are applied
+         *         immediately.
+         */
+        static unsigned regionTransitionCycles();
+
+    signals:
+        /**
+         * Signal that is emitted from this timer's thread when the load shedding level changes.
+         *
+         * \param[in] newSheddingLevel The new load shedding level.
+         */
+        void sheddingLevelChanged(unsigned newSheddingLevel);
+
     public slots:
         /**
          * Slot you can use to update the region settings.  Be sure to trigger this slot before setting this
@@ -134,60 +261,254 @@ class HostSchemeTimer:public QObject {
          */
         void goActive();
 
-    signals:
+    protected:
         /**
-         * Signal that is emitted to adjust the timer setting.  We use a signal because the QTimer class does not allow
-         * start or stop to be called across threads.
+         * Method that is called by the timing wheel when a host/scheme should be serviced.
+         *
+         * \param[in] entry       The timing wheel entry tied to the host/scheme.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
          */
-        void start();
+        void timerExpired(TimingWheel::Entry* entry, unsigned long long currentTime) override;
 
+    private:
         /**
-         * Signal that is emitted to stop the timer.
+         * Period used to look for missed timing marks, in milliseconds.
          */
-        void stop();
+        static const unsigned missedTimingMarkResetInterval = 2 * 1000 * 3600;
 
-    protected slots:
         /**
-         * Method that is triggered at period intervals to start the next check.
+         * The lateness, in milliseconds, beyond which the overload policy is applied.
          */
-        void startNextHostScheme();
+        static constexpr unsigned long long overloadThresholdMilliseconds = 100;
 
-    private slots:
         /**
-         * Method that starts the timers.
+         * The length of the windows used to decide if load should be shed, in milliseconds.
          */
-        void startTimer();
+        static constexpr unsigned long long sheddingWindowMilliseconds = 10000;
 
-    private:
         /**
-         * Period used to look for missed timing marks, in milliseconds.
+         * The minimum number of polls in a window before the window is used to change the shedding level.
          */
-        static const unsigned missedTimingMarkResetInterval = 2 * 1000 * 3600;
+        static constexpr unsigned long minimumSheddingWindowPolls = 20;
+
+        /**
+         * The fraction of polls that must be late, beyond \ref overloadThresholdMilliseconds, for a window to count
+         * as overloaded.
+         */
+        static constexpr double sheddingEngageFraction = 0.10;
+
+        /**
+         * The fraction of polls that may be late for a window to count as healthy.
+         */
+        static constexpr double sheddingReleaseFraction = 0.01;
+
+        /**
+         * The number of consecutive overloaded or healthy windows needed to raise or lower the shedding level.
+         */
+        static constexpr unsigned sheddingWindowsPerStep = 3;
+
+        /**
+         * Timing wheel entry used to track a single host/scheme.
+         */
+        class HostSchemeEntry:public TimingWheel::Entry {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] hostSchemeTimer The timer that owns this entry.
+                 *
+                 * \param[in] hostScheme      The host/scheme tied to this entry.
+                 */
+                HostSchemeEntry(HostSchemeTimer* hostSchemeTimer, HostScheme* hostScheme);
+
+                ~HostSchemeEntry() override;
+
+                /**
+                 * Method you can use to obtain the host/scheme tied to this entry.
+                 *
+                 * \return Returns the host/scheme tied to this entry.
+                 */
+                inline QPointer<HostScheme> hostScheme() const {
+                    return currentHostScheme;
+                }
+
+                /**
+                 * Method you can use to obtain the phase of this entry within the polling period.
+                 *
+                 * \return Returns the entry phase.  A value of 2^32 would represent a full polling period.
+                 */
+                inline std::uint32_t phase() const {
+                    return currentPhase;
+                }
+
+                /**
+                 * Method you can use to determine if this entry was deferred by the overload policy.
+                 *
+                 * \return Returns true if the entry was deferred.  Deferred entries are serviced when they next
+                 *         expire without further lateness checks.
+                 */
+                inline bool deferred() const {
+                    return currentDeferred;
+                }
+
+                /**
+                 * Method you can use to mark this entry as deferred.
+                 *
+                 * \param[in] nowDeferred If true, the entry is deferred.
+                 */
+                inline void setDeferred(bool nowDeferred) {
+                    currentDeferred = nowDeferred;
+                }
+
+                /**
+                 * Method you can use to count a polling cycle for this entry.  The count is used to select which
+                 * cycles are polled while load is being shed.
+                 *
+                 * \return Returns the number of counted cycles, including this one.
+                 */
+                inline unsigned long countCycle() {
+                    return ++currentCycleCount;
+                }
+
+            private:
+                /**
+                 * The host/scheme tied to this entry.
+                 */
+                QPointer<HostScheme> currentHostScheme;
+
+                /**
+                 * The entry phase.
+                 */
+                std::uint32_t currentPhase;
+
+                /**
+                 * Flag indicating that this entry was deferred by the overload policy.
+                 */
+                bool currentDeferred;
+
+                /**
+                 * The number of polling cycles counted while load was being shed.
+                 */
+                unsigned long currentCycleCount;
+        };
+
+        /**
+         * Type used to track host/scheme entries by host/scheme ID.
+         */
+        typedef QHash<HostScheme::HostSchemeId, HostSchemeEntry*> EntriesByHostSchemeId;
+
+        /**
+         * Method that recalculates our period and region offset.  This method must be called from this timer's
+         * thread.
+         *
+         * \param[in] regionIndex   The zero based region index for the region we're in.
+         *
+         * \param[in] numberRegions The number of regions we're in.
+         */
+        void applyRegionData(unsigned regionIndex, unsigned numberRegions);
+
+        /**
+         * Method that schedules or cancels every host/scheme.  This method must be called from this timer's thread.
+         *
+         * \param[in] nowActive If true, all host/schemes will be scheduled.  If false, all host/schemes will be
+         *                      removed from the timing wheel.
+         */
+        void scheduleAll(bool nowActive);
 
         /**
-         * Type used to track host/schemes in time order.
+         * Method that schedules a single host/scheme and asks the DNS cache to have the host resolved before the
+         * scheduled poll.  This method must be called from this timer's thread.
+         *
+         * \param[in] entry       The entry to be scheduled.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
          */
-        typedef QMap<std::uint32_t, QPointer<HostScheme>> HostSchemesByTimeOrder;
+        void scheduleEntry(HostSchemeEntry* entry, unsigned long long currentTime);
 
         /**
-         * Method that restarts the timing cycle.
+         * Method that calculates the region offset to apply at a given time.  The offset follows a straight line
+         * from the old offset to the new offset while a staged region transition is in progress.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
+         *
+         * \return Returns the region offset, in milliseconds.
          */
-        void restartTimingCycle();
+        unsigned long long regionOffset(unsigned long long currentTime) const;
 
         /**
-         * Method that schedules the next host/scheme.
+         * Method that applies the overload policy to a host/scheme that expired well after its timing mark.  This
+         * method must be called from this timer's thread.
+         *
+         * \param[in] entry       The late entry.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
+         *
+         * \return Returns true if the host/scheme should be serviced now.  Returns false if the entry was deferred or
+         *         skipped.
          */
-        void scheduleNextHostScheme();
+        bool applyOverloadPolicy(HostSchemeEntry* entry, unsigned long long currentTime);
 
         /**
-         * Timer used to trigger service operations.
+         * Method that decides if a host/scheme should be skipped this cycle to shed load.  Skipped host/schemes are
+         * rescheduled for their next timing mark.  This method must be called from this timer's thread.
+         *
+         * \param[in] entry       The entry being serviced.
+         *
+         * \param[in] hostScheme  The host/scheme tied to the entry.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
+         *
+         * \return Returns true if the host/scheme was skipped.
+         */
+        bool shedPoll(HostSchemeEntry* entry, HostScheme* hostScheme, unsigned long long currentTime);
+
+        /**
+         * Method that determines the priority tier of a host/scheme.  Host/schemes not yet tied to a customer are
+         * given the default, normal, priority tier.
+         *
+         * \param[in] hostScheme The host/scheme of interest.
+         *
+         * eturn Returns the priority tier of the host/scheme's customer.
          */
-        QTimer* serviceTimer;
+        static Customer::Priority priorityOf(const HostScheme* hostScheme);
 
         /**
-         * Flag indicating that the timer settings need to be recalculated.
+         * Method that closes the current shedding window and adjusts the shedding level.  This method must be called
+         * from this timer's thread.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
+         */
+        void updateSheddingLevel(unsigned long long currentTime);
+
+        /**
+         * Method that determines if we should be scheduling host/schemes.
+         *
+         * \return Returns true if we should be scheduling host/schemes.
          */
-        bool forceTimerResync;
+        bool schedulingEnabled() const;
+
+        /**
+         * Method that updates our reported timing mark data.
+         *
+         * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
+         */
+        void updateLoadingData(unsigned long long currentTime);
+
+        /**
+         * The timing wheel used to schedule our host/schemes.
+         */
+        TimingWheel* currentTimingWheel;
+
+        /**
+         * The DNS cache used to resolve hosts ahead of each poll.
+         */
+        DnsCache* currentDnsCache;
+
+        /**
+         * Flag indicating if we're active.
+         */
+        bool currentActive;
 
         /**
          * Flag indicating if this is a multi-region test.
@@ -220,24 +541,25 @@ class HostSchemeTimer:public QObject {
         unsigned long regionTimeOffsetMilliseconds;
 
         /**
-         * The time of thie current polling cycle to start, in milliseconds since the Unix epoch.
+         * The region offset, in milliseconds, at the start of the current staged region transition.
          */
-        unsigned long long pollingCycleStartTime;
+        unsigned long long transitionStartOffset;
 
         /**
-         * The time for the next service to be triggered, in milliseconds since the Unix epoch.
+         * The time the current staged region transition started, in milliseconds since the Unix epoch.
          */
-        unsigned long long nextMonitorStart;
+        unsigned long long transitionStartTime;
 
         /**
-         * The time when we should reset our missed timing mark calculation.
+         * The time the current staged region transition ends, in milliseconds since the Unix epoch.  No transition
+         * is in progress once this time has passed.
          */
-        unsigned long long nextTimingMarkReset;
+        unsigned long long transitionEndTime;
 
         /**
-         * Total number of polled hostSchemes.
+         * The time when we should reset our missed timing mark calculation.
          */
-        unsigned long numberPolledHostSchemes;
+        unsigned long long nextTimingMarkReset;
 
         /**
          * The number of times we've missed our timing window.
@@ -250,34 +572,117 @@ class HostSchemeTimer:public QObject {
         unsigned long long sumMillisecondsMissedTimingMarks;
 
         /**
-         * The last reported timing mark data.
+         * The number of rechecks of non-responsive monitors in the current window.
+         */
+        unsigned long numberRechecksWindow;
+
+        /**
+         * The number of deferred rechecks of non-responsive monitors in the current window.
+         */
+        unsigned long numberDeferredRechecksWindow;
+
+        /**
+         * The number of polls skipped to shed load in the current window.
+         */
+        unsigned long numberShedPollsWindow;
+
+        /**
+         * The time the current shedding window ends, in milliseconds since the Unix epoch.
+         */
+        unsigned long long sheddingWindowEnd;
+
+        /**
+         * The number of polls in the current shedding window.
+         */
+        unsigned long sheddingWindowPolls;
+
+        /**
+         * The number of polls in the current shedding window that missed their timing mark by more than
+         * \ref overloadThresholdMilliseconds.
+         */
+        unsigned long sheddingWindowLatePolls;
+
+        /**
+         * The number of consecutive overloaded shedding windows.
+         */
+        unsigned numberOverloadedWindows;
+
+        /**
+         * The number of consecutive healthy shedding windows.
+         */
+        unsigned numberHealthyWindows;
+
+        /**
+         * The earliest time at which the next late host/scheme can be serviced under \ref OverloadPolicy::SPREAD.
+         */
+        unsigned long long spreadCursor;
+
+        /**
+         * The last reported timing mark data.  Only used from within the thread that owns this timer.
          */
         LoadingData currentLoadingData;
 
         /**
-         * Mutex used to protect our host/scheme hash table.
+         * The total number of polls performed by this timer.
          */
-        mutable QMutex hostSchemeMutex;
+        std::atomic<unsigned long> totalNumberPolls;
 
         /**
-         * Hash table of host schemes by host/scheme ID.
+         * The total number of polls that missed their timing mark.
          */
-        HostSchemesByTimeOrder hostSchemesByTimeOrder;
+        std::atomic<unsigned long> totalNumberMissedTimingMarks;
+
+        /**
+         * The total amount of time by which polls missed their timing marks, in milliseconds.
+         */
+        std::atomic<unsigned long long> totalMillisecondsMissedTimingMarks;
+
+        /**
+         * The total number of rechecks of non-responsive monitors performed by this timer.
+         */
+        std::atomic<unsigned long> totalNumberRechecks;
+
+        /**
+         * The total number of rechecks of non-responsive monitors deferred by this timer.
+         */
+        std::atomic<unsigned long> totalNumberDeferredRechecks;
+
+        /**
+         * The total number of polls skipped by this timer to shed load.
+         */
+        std::atomic<unsigned long> totalNumberShedPolls;
+
+        /**
+         * The current load shedding level.
+         */
+        std::atomic<unsigned> currentSheddingLevel;
+
+        /**
+         * The number of entries in \ref entriesByHostSchemeId.  The count is kept separately so the polling path
+         * never needs the mutex.
+         */
+        std::atomic<unsigned long> currentNumberEntries;
+
+        /**
+         * Mutex used to protect our host/scheme hash table.  Note that the mutex is not used when host/schemes are
+         * serviced.
+         */
+        mutable QMutex hostSchemeMutex;
 
         /**
-         * Iterator used to walk our host/schemes in time order.
+         * Hash table of host/scheme entries by host/scheme ID.
          */
-        HostSchemesByTimeOrder::iterator hostSchemeIterator;
+        EntriesByHostSchemeId entriesByHostSchemeId;
 
         /**
-         * Hash table of monitors under this host/scheme.
+         * The overload policy used by all host/scheme timers.
          */
-        HostScheme::MonitorsByMonitorId monitorsByMonitorId;
+        static std::atomic<OverloadPolicy> currentOverloadPolicy;
 
         /**
-         * Current iterator into the monitor hash table.
+         * The number of polling cycles over which region changes are staged.
          */
-        HostScheme::MonitorsByMonitorId::iterator monitorIterator;
+        static std::atomic<unsigned> currentRegionTransitionCycles;
 };
 
 #endif
@@ -0,0 +1,429 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref HttpEngine class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef HTTP_ENGINE_H
+#define HTTP_ENGINE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QNetworkRequest>
+#include <QSslCertificate>
+
+class DnsCache;
+
+/**
+ * Pure virtual base class for the HTTP client used to perform monitor checks.  Each service thread owns its engines
+ * and all methods of an engine, and of the requests it creates, must be called from that thread.
+ *
+ * Two engines are provided.  The Qt engine wraps QNetworkAccessManager and is the default.  The native engine
+ * drives non-blocking sockets from a single epoll instance and only exists on Linux.
+ */
+class HttpEngine {
+    public:
+        class Request;
+
+        /**
+         * Enumeration of supported engine backends.
+         */
+        enum class Backend {
+            /**
+             * Indicates requests are serviced by QNetworkAccessManager.
+             */
+            QT,
+
+            /**
+             * Indicates requests are serviced by the native epoll based engine.
+             */
+            NATIVE
+        };
+
+        /**
+         * Verb used to send HTTP GET commands.
+         */
+        static const QByteArray getVerb;
+
+        /**
+         * Verb used to send HTTP HEAD commands.
+         */
+        static const QByteArray headVerb;
+
+        /**
+         * Verb used to send HTTP POST commands.
+         */
+        static const QByteArray postVerb;
+
+        /**
+         * Verb used to send HTTP PUT commands.
+         */
+        static const QByteArray putVerb;
+
+        /**
+         * Verb used to send HTTP DELETE commands.
+         */
+        static const QByteArray deleteVerb;
+
+        /**
+         * Verb used to send HTTP OPTIONS commands.
+         */
+        static const QByteArray optionsVerb;
+
+        /**
+         * Verb used to send HTTP PATCH commands.
+         */
+        static const QByteArray patchVerb;
+
+        /**
+         * Class used to report when a request completed each phase.  Times are in nanoseconds, measured from the
+         * start of the request.  A value of 0 indicates the phase was not performed, such as connection setup on a
+         * reused connection, or could not be observed by the engine.  Only the first connection used by a request is
+         * reported so the time to first byte includes any redirects that were followed.
+         */
+        class PhaseTimes {
+            public:
+                PhaseTimes():
+                    resolvedNanoseconds(0),
+                    connectedNanoseconds(0),
+                    handshakeNanoseconds(0),
+                    firstByteNanoseconds(0),
+                    completedNanoseconds(0) {}
+
+                /**
+                 * The time the host name was resolved.
+                 */
+                unsigned long long resolvedNanoseconds;
+
+                /**
+                 * The time the TCP connection was established.  Engines that can not observe the TCP connection
+                 * report the end of the TLS handshake here and leave \ref handshakeNanoseconds at 0.
+                 */
+                unsigned long long connectedNanoseconds;
+
+                /**
+                 * The time the TLS handshake completed.
+                 */
+                unsigned long long handshakeNanoseconds;
+
+                /**
+                 * The time the first byte of the final response was received.
+                 */
+                unsigned long long firstByteNanoseconds;
+
+                /**
+                 * The time the last byte of the final response was received.
+                 */
+                unsigned long long completedNanoseconds;
+        };
+
+        /**
+         * Pure virtual base class for objects that wish to receive request events.  A client may delete the request
+         * from within any of these methods.
+         */
+        class Client {
+            public:
+                virtual ~Client() = default;
+
+                /**
+                 * Method that is called when a new connection has been established for a request.  For secure
+                 * connections this method is called when the TLS handshake completes.  This method is only called
+                 * for requests that report progress.
+                 *
+                 * \param[in] request The request.
+                 */
+                virtual void requestConnected(Request* request) = 0;
+
+                /**
+                 * Method that is called when the final response headers are received.  This method is only called
+                 * for requests that report progress.
+                 *
+                 * \param[in] request The request.
+                 */
+                virtual void requestHeadersReceived(Request* request) = 0;
+
+                /**
+                 * Method that is called when response body data is available.  The client is expected to read the
+                 * data using \ref HttpEngine::Request::readAll.
+                 *
+                 * \param[in] request The request.
+                 */
+                virtual void requestDataAvailable(Request* request) = 0;
+
+                /**
+                 * Method that is called when a request completes or fails.  No further methods are called for the
+                 * request.
+                 *
+                 * \param[in] request The request.
+                 */
+                virtual void requestFinished(Request* request) = 0;
+        };
+
+        /**
+         * Class that represents a single in-flight request.  Deleting a request aborts it.
+         */
+        class Request {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] client The client to be notified of request events.
+                 */
+                Request(Client* client);
+
+                virtual ~Request();
+
+                /**
+                 * Method you can use to obtain the client tied to this request.
+                 *
+                 * \return Returns the client tied to this request.
+                 */
+                inline Client* client() const {
+                    return currentClient;
+                }
+
+                /**
+                 * Method you can use to obtain the HTTP status code of the response.
+                 *
+                 * \return Returns the HTTP status code.  A value of 0 is returned if no response was received.
+                 */
+                virtual int statusCode() const = 0;
+
+                /**
+                 * Method you can use to obtain a response header.
+                 *
+                 * \param[in] headerName The header name.  The name is matched without regard to case.
+                 *
+                 * \return Returns the header value.  An empty array is returned if the header is not present.
+                 */
+                virtual QByteArray rawHeader(const QByteArray& headerName) const = 0;
+
+                /**
+                 * Method you can use to obtain the advertised length of the response body.
+                 *
+                 * \return Returns the content length, in bytes.  A negative value is returned if the length is not
+                 *         known.
+                 */
+                virtual long long contentLength() const = 0;
+
+                /**
+                 * Method you can use to read all currently available response body data.
+                 *
+                 * \return Returns the available data.
+                 */
+                virtual QByteArray readAll() = 0;
+
+                /**
+                 * Method you can use to determine if the request failed.  Responses with an HTTP error status are
+                 * reported as failures.
+                 *
+                 * \return Returns true if the request failed.  Returns false if the request succeeded or has not
+                 *         finished.
+                 */
+                virtual bool failed() const = 0;
+
+                /**
+                 * Method you can use to obtain a description of the failure.
+                 *
+                 * \return Returns a description of the failure.
+                 */
+                virtual QString errorString() const = 0;
+
+                /**
+                 * Method you can use to obtain the certificate presented by the remote host.
+                 *
+                 * \return Returns the peer certificate.  A null certificate is returned for insecure connections.
+                 */
+                virtual QSslCertificate peerCertificate() const = 0;
+
+                /**
+                 * Method you can use to determine if a TLS handshake was performed for this request.
+                 *
+                 * \return Returns true if a TLS handshake was performed.  Returns false for insecure connections and
+                 *         for requests sent over a reused connection.
+                 */
+                virtual bool newHandshake() const = 0;
+
+                /**
+                 * Method you can use to obtain the TLS session ticket issued by the remote host.  The ticket can be
+                 * supplied to later requests through QSslConfiguration::setSessionTicket.
+                 *
+                 * \return Returns the session ticket.  An empty array is returned if no ticket was issued or if the
+                 *         engine maintains its own session cache.
+                 */
+                virtual QByteArray sslSessionTicket() const = 0;
+
+                /**
+                 * Method you can use to obtain the time since the request was started.
+                 *
+                 * \return Returns the time since the request was started, in nanoseconds.
+                 */
+                virtual unsigned long long elapsedNanoseconds() const;
+
+                /**
+                 * Method you can use to obtain the times at which the request completed each phase.
+                 *
+                 * \return Returns the phase times, relative to \ref elapsedNanoseconds.
+                 */
+                virtual PhaseTimes phaseTimes() const;
+
+                /**
+                 * Method used by engines to record that the host name was resolved.  Only the first call has any
+                 * effect.
+                 */
+                void recordResolved();
+
+                /**
+                 * Method used by engines to record that the TCP connection was established.  Only the first call has
+                 * any effect.
+                 */
+                void recordConnected();
+
+                /**
+                 * Method used by engines to record that the TLS handshake completed.  Only the first call has any
+                 * effect.
+                 */
+                void recordHandshake();
+
+                /**
+                 * Method used by engines to record that the first byte of the final response was received.  Only the
+                 * first call has any effect.
+                 *
+                 * \param[in] receiveDelayNanoseconds The time since the data arrived at the socket, in nanoseconds.
+                 *                                    Engines that can not timestamp received data use 0.
+                 */
+                void recordFirstByte(unsigned long long receiveDelayNanoseconds = 0);
+
+                /**
+                 * Method used by engines to record that the last byte of the final response was received.  Only the
+                 * first call has any effect.
+                 *
+                 * \param[in] receiveDelayNanoseconds The time since the data arrived at the socket, in nanoseconds.
+                 *                                    Engines that can not timestamp received data use 0.
+                 */
+                void recordCompleted(unsigned long long receiveDelayNanoseconds = 0);
+
+            private:
+                /**
+                 * Method that records the time for a phase, if the phase has not already been recorded.  A receive
+                 * delay that predates the request, which can happen if the system clock is stepped, is ignored.
+                 *
+                 * \param[in,out] phaseNanoseconds        The phase time to be updated.
+                 *
+                 * \param[in]     receiveDelayNanoseconds The time since the phase actually completed, in nanoseconds.
+                 */
+                inline void recordPhase(
+                        unsigned long long& phaseNanoseconds,
+                        unsigned long long  receiveDelayNanoseconds = 0
+                    ) {
+                    if (phaseNanoseconds == 0) {
+                        unsigned long long elapsed = static_cast<unsigned long long>(currentTimer.nsecsElapsed());
+                        phaseNanoseconds = (
+                              receiveDelayNanoseconds < elapsed
+                            ? elapsed - receiveDelayNanoseconds
+                            : elapsed
+                        );
+                    }
+                }
+
+                /**
+                 * The client tied to this request.
+                 */
+                Client* currentClient;
+
+                /**
+                 * Timer started when the request is created.
+                 */
+                QElapsedTimer currentTimer;
+
+                /**
+                 * The times at which the request completed each phase.
+                 */
+                PhaseTimes currentPhaseTimes;
+        };
+
+        virtual ~HttpEngine() = default;
+
+        /**
+         * Method you can use to create an engine.  You must call this method from the thread that will use the
+         * engine.
+         *
+         * \param[in] backend  The desired backend.
+         *
+         * \param[in] dnsCache The DNS cache the engine should consult, if it resolves hosts itself.
+         *
+         * \return Returns the newly created engine.  The caller takes ownership of the engine.  A null pointer is
+         *         returned if the backend is not supported on this platform or could not be initialized.
+         */
+        static HttpEngine* create(Backend backend, DnsCache* dnsCache);
+
+        /**
+         * Method you can use to convert a backend to a string.
+         *
+         * \param[in] backend The backend to be converted.
+         *
+         * \return Returns the backend as a string.
+         */
+        static QString toString(Backend backend);
+
+        /**
+         * Method you can use to convert a backend name to a backend.
+         *
+         * \param[in]  name The backend name, "qt" or "native".
+         *
+         * \param[out] ok   Optional pointer to a flag set to false if the name is not recognized.
+         *
+         * \return Returns the backend.  \ref Backend::QT is returned for unrecognized names.
+         */
+        static Backend toBackend(const QString& name, bool* ok = nullptr);
+
+        /**
+         * Method you can use to obtain the backend implemented by this engine.
+         *
+         * \return Returns the engine's backend.
+         */
+        virtual Backend backend() const = 0;
+
+        /**
+         * Method you can use to start a request.  The client is never called from within this method.
+         *
+         * \param[in] client         The client to be notified of request events.
+         *
+         * \param[in] request        The request URL, headers and transfer timeout.
+         *
+         * \param[in] verb           The HTTP verb.
+         *
+         * \param[in] body           The request body.  An empty array indicates no body.
+         *
+         * \param[in] reportProgress If true, the client is told when the connection is established and when the
+         *                           response headers arrive.
+         *
+         * \return Returns the newly created request.  The caller takes ownership of the request.
+         */
+        virtual Request* startRequest(
+            Client*                client,
+            const QNetworkRequest& request,
+            const QByteArray&      verb,
+            const QByteArray&      body,
+            bool                   reportProgress
+        ) = 0;
+};
+
+#endif
@@ -27,20 +27,37 @@
 #include <QPointer>
 #include <QHash>
 #include <QMultiMap>
+#include <QList>
+#include <QMutex>
 
 #include <cstdint>
+#include <atomic>
+#include <functional>
 
 #include "customer.h"
 #include "loading_data.h"
 #include "service_thread.h"
-
-class QNetworkAccessManager;
+#include "metrics.h"
+#include "thread_affinity.h"
+#include "http_engine.h"
+#include "coalescing_http_engine.h"
 
 class HostSchemeTimer;
 class DataAggregator;
+class DnsCache;
+class ObjectIndex;
+class StateSnapshot;
+class LatencyRing;
+class TimingWheel;
+class EventLoopLagProbe;
 
 /**
  * Class that manages an independent monitor service thread that performs HTTP status checks.
+ *
+ * The customers, host/schemes, and monitors serviced by this thread, along with this thread's own tables, are only
+ * modified from within this thread so monitors are serviced without taking any locks.  Requests made from other
+ * threads are appended to a command queue and applied from within this thread in batches.  Commands are applied in
+ * the order they were posted.
  */
 class HttpServiceThread:public ServiceThread {
     Q_OBJECT
@@ -58,9 +75,19 @@ class HttpServiceThread:public ServiceThread {
          *
          * \param[in] dataAggregator The data aggregator to be used by this thread.
          *
+         * \param[in] dnsCache       The DNS cache used to resolve hosts ahead of each poll.
+         *
+         * \param[in] objectIndex    The process-wide index this thread should register its customers, host/schemes,
+         *                           and monitors with.
+         *
          * \param[in] parent         Pointer to the parent object.
          */
-        HttpServiceThread(DataAggregator* dataAggregator, QObject* parent = nullptr);
+        HttpServiceThread(
+            DataAggregator* dataAggregator,
+            DnsCache*       dnsCache,
+            ObjectIndex*    objectIndex,
+            QObject*        parent = nullptr
+        );
 
         ~HttpServiceThread() override;
 
@@ -73,12 +100,30 @@ class HttpServiceThread:public ServiceThread {
         float hostSchemesPerSecond() const;
 
         /**
-         * Method you can use to obtain detailed loading data.
+         * Method you can use to obtain this thread's load shedding level.  The level is the highest level reported by
+         * the thread's host/scheme timers.  This method is thread safe.
+         *
+         * \return Returns the load shedding level.  A value of 0 indicates load is not being shed.
+         */
+        unsigned sheddingLevel() const;
+
+        /**
+         * Method you can use to obtain detailed loading data.  The data is collected from within this thread.  This
+         * method blocks until the data is collected and must not be called from this service thread.
          *
          * \return Returns a map of loading data instances.  The key is the polling interval, in seconds.  Negative
          *         values indicate single regions.  Positive values indicate multi-region polling.
          */
-        QMultiMap<int, LoadingData> loadingData() const;
+        QMultiMap<int, LoadingData> loadingData();
+
+        /**
+         * Method you can use to obtain loading data accumulated across all of this thread's host/scheme timers since
+         * the thread was created.  See \ref HostSchemeTimer::cumulativeLoadingData.  This method blocks until the
+         * data is collected and must not be called from this service thread.
+         *
+         * \return Returns the cumulative loading data for this thread.
+         */
+        LoadingData cumulativeLoadingData();
 
         /**
          * Method you can use to obtain the data aggregator being used by this thread.
@@ -90,26 +135,199 @@ class HttpServiceThread:public ServiceThread {
         }
 
         /**
-         * Method you can use to add a customer to this service thread.
+         * Method you can use to obtain the DNS cache being used by this thread.
+         *
+         * \return Returns the DNS cache being used by this thread.
+         */
+        inline DnsCache* dnsCache() const {
+            return currentDnsCache;
+        }
+
+        /**
+         * Method you can use to obtain the latency ring used to report latency data from this thread.  The ring must
+         * only be used from within this thread.
+         *
+         * \return Returns the latency ring tied to this thread.
+         */
+        inline LatencyRing* latencyRing() const {
+            return currentLatencyRing;
+        }
+
+        /**
+         * Method you can use to obtain the metrics maintained by this thread.  The metrics must only be updated from
+         * within this thread.
+         *
+         * \return Returns the metrics tied to this thread.
+         */
+        inline ThreadMetrics* threadMetrics() {
+            return &currentThreadMetrics;
+        }
+
+        /**
+         * Method you can use to obtain the metrics maintained by this thread.  This method can be called from any
+         * thread.
+         *
+         * \return Returns the metrics tied to this thread.
+         */
+        inline const ThreadMetrics* threadMetrics() const {
+            return &currentThreadMetrics;
+        }
+
+        /**
+         * Method you can use to obtain the probe measuring this thread's event loop lag.  This method can be called
+         * from any thread.
+         *
+         * \return Returns the event loop lag probe tied to this thread.
+         */
+        inline EventLoopLagProbe* eventLoopLagProbe() const {
+            return currentEventLoopLagProbe;
+        }
+
+        /**
+         * Method you can use to add a customer to this service thread.  The customer is indexed immediately and
+         * registered from within this thread by a queued command.
+         *
+         * The customer must live in the calling thread or in this thread.  This thread takes ownership of the
+         * customer.
          *
          * \param[in] customer The customer instance to be added.
          */
         void addCustomer(Customer* customer);
 
         /**
-         * Method you can use to remove a customer from this service thread.
+         * Method you can use to add a batch of customers to this service thread in a single hand-off.  All the
+         * customers are registered from within this thread so their host/schemes are scheduled directly rather than
+         * through one queued event per host/scheme.  Service metrics are updated once the batch is registered.
+         *
+         * This method blocks until every customer is registered and must not be called from this service thread.
+         * The customers must live in the calling thread.
+         *
+         * \param[in] customers The customer instances to be added.  This thread takes ownership of the instances.
+         */
+        void addCustomers(const QList<Customer*>& customers);
+
+        /**
+         * Method you can use to remove a customer from this service thread.  The customer is dropped from the index
+         * immediately and deleted from within this thread by a queued command.
          *
          * Note that you should always use this method rather than deleting the customer directly.
          *
          * \param[in] customerId The zero based ID of the customer to be removed.
+         */
+        void removeCustomer(Customer::CustomerId customerId);
+
+        /**
+         * Method you can use to update a customer managed by this thread in place.  The new customer is compared
+         * against the existing customer with the same ID and only the differences are applied.  See
+         * \ref Customer::updateFrom.
+         *
+         * This method blocks until the update is complete and must not be called from this service thread.  The new
+         * customer must live in the calling thread.
+         *
+         * \param[in] customer The customer instance holding the new settings.  On success, the instance is consumed
+         *                     and will be deleted.  On failure, the caller retains ownership.
+         *
+         * \return Returns true if the customer was updated.  Returns false if the customer is not managed by this
+         *         thread.
+         */
+        bool updateCustomer(Customer* customer);
+
+        /**
+         * Method you can use to move a customer, along with all of its host/schemes and monitors, to a different
+         * service thread.  Monitor state such as the last hash and monitor status is preserved.  Any in-flight checks
+         * for the customer are discarded and will be repeated on the new thread at the next scheduled poll.
+         *
+         * This method blocks until the customer is handed to the new thread and must not be called from either service
+         * thread.  The new thread registers the customer by a queued command.
+         *
+         * \param[in] customerId       The ID of the customer to be moved.
+         *
+         * \param[in] newServiceThread The service thread to receive the customer.
+         *
+         * \return Returns true if the customer was moved.  Returns false if the customer is not managed by this
+         *         thread.
+         */
+        bool migrateCustomer(Customer::CustomerId customerId, HttpServiceThread* newServiceThread);
+
+        /**
+         * Method you can use to record the restart state of every host/scheme and monitor managed by this thread.
+         * The state is collected from within this thread.  This method blocks until the state is recorded and must
+         * not be called from this service thread.
+         *
+         * \param[in] stateSnapshot The snapshot to record state into.
+         */
+        void captureState(StateSnapshot* stateSnapshot);
+
+        /**
+         * Method you can use to pin this thread to a set of CPUs.  The affinity is applied from within this thread.
+         *
+         * \param[in] cpus The CPUs this thread may run on.  An empty list allows the thread to run on any CPU.
+         */
+        void setCpuAffinity(const ThreadAffinity::CpuList& cpus);
+
+        /**
+         * Method you can use to select the HTTP engine used by this thread's monitors.  The engine is created, if
+         * needed, and applied from within this thread.  Checks already in flight complete on their original engine.
+         *
+         * \param[in] backend The desired HTTP engine backend.  The Qt engine is used if the backend is not available.
+         */
+        void setHttpEngineBackend(HttpEngine::Backend backend);
+
+        /**
+         * Method you can use to enable or disable coalescing of identical fetches across this thread's monitors.
+         * The setting is applied from within this thread.
+         *
+         * \param[in] nowEnabled If true, identical fetches started together share a single request.  If false,
+         *                       every monitor issues its own request.
+         */
+        void setFetchCoalescingEnabled(bool nowEnabled);
+
+        /**
+         * Method you can use to pause or resume a customer managed by this thread.  The change is applied from within
+         * this thread by a queued command.
+         *
+         * \param[in] customerId The ID of the customer of interest.
+         *
+         * \param[in] nowPaused  If true, the customer's polling should be paused.  If false, the customer's polling
+         *                       should be resumed.
+         */
+        void setPaused(Customer::CustomerId customerId, bool nowPaused);
+
+        /**
+         * Method you can use to determine if a customer managed by this thread is paused.  This method blocks until
+         * earlier commands are applied and must not be called from this service thread.
+         *
+         * \param[in] customerId The ID of the customer of interest.
          *
-         * \return Returns true if the customer is managed by this thread.  Returns false if the customer is not
+         * \return Returns true if the customer is paused.  Returns false if the customer is not paused or is not
          *         managed by this thread.
          */
-        bool removeCustomer(Customer::CustomerId customerId);
+        bool paused(Customer::CustomerId customerId);
+
+        /**
+         * Method you can use to obtain the customers managed by this thread.  This method blocks until earlier
+         * commands are applied and must not be called from this service thread.  The customers must only be modified
+         * from within this thread.
+         *
+         * \return Returns a list of customers managed by this thread.
+         */
+        QList<Customer*> customers();
 
         /**
-         * Method you can use to obtain a pointer to a customer by customer ID.
+         * Method you can use to obtain a snapshot of the service rate of each customer managed by this thread.  The
+         * rates are computed within this thread.  This method blocks until earlier commands are applied and must not
+         * be called from this service thread.
+         *
+         * \param[in] numberRegions The number of polling server regions.
+         *
+         * \return Returns the estimated service rate of each customer, in host/schemes per second, keyed by customer
+         *         ID.
+         */
+        QHash<Customer::CustomerId, double> customerServiceRates(unsigned numberRegions);
+
+        /**
+         * Method you can use to obtain a pointer to a customer by customer ID.  This method must be called from
+         * within this thread.
          *
          * \param[in] customerId The ID of the customer of interest.
          *
@@ -118,7 +336,8 @@ class HttpServiceThread:public ServiceThread {
         Customer* getCustomer(Customer::CustomerId customerId) const;
 
         /**
-         * Method you can use to obtain a pointer to a host/scheme by host/scheme ID.
+         * Method you can use to obtain a pointer to a host/scheme by host/scheme ID.  This method must be called from
+         * within this thread.
          *
          * \param[in] hostSchemeId The ID of the host/scheme of interest.
          *
@@ -127,7 +346,8 @@ class HttpServiceThread:public ServiceThread {
         HostScheme* getHostScheme(HostScheme::HostSchemeId hostSchemeId) const;
 
         /**
-         * Method you can use to obtain a pointer to a monitor by monitor ID.
+         * Method you can use to obtain a pointer to a monitor by monitor ID.  This method must be called from within
+         * this thread.
          *
          * \param[in] monitorId The ID of the monitor of interest.
          *
@@ -137,7 +357,8 @@ class HttpServiceThread:public ServiceThread {
 
     public slots:
         /**
-         * Slot you can trigger to request that a given host/scheme be checked immediately
+         * Slot you can trigger to request that a given host/scheme be checked immediately.  The check is started from
+         * within this thread by a queued command.
          *
          * \param[in] hostScheme The host/scheme instance to be checked.
          */
@@ -169,6 +390,41 @@ class HttpServiceThread:public ServiceThread {
         void run() override;
 
     private:
+        /**
+         * Type used to represent a command applied from within this thread.
+         */
+        typedef std::function<void()> Command;
+
+        /**
+         * Method that appends a command to this thread's command queue.  The queue is drained by a single queued
+         * event so commands posted together are applied together.  This method can be called from any thread.
+         *
+         * \param[in] command The command to be applied.
+         */
+        void postCommand(const Command& command);
+
+        /**
+         * Method that applies a command from within this thread after every command already posted.  This method
+         * blocks until the command completes and must not be called from this service thread.
+         *
+         * \param[in] command The command to be applied.
+         */
+        void executeCommand(const Command& command);
+
+        /**
+         * Method that applies every queued command.  Service metrics are updated once per batch.  This method must
+         * be called from within this thread.
+         */
+        void processCommands();
+
+        /**
+         * Method that registers a customer that has been moved to this thread.  This method must be called from
+         * within this thread.
+         *
+         * \param[in] customer The customer to be registered.
+         */
+        void registerCustomer(Customer* customer);
+
         /**
          * Method that is called by the host/scheme when a monitor has been added.
          *
@@ -217,9 +473,43 @@ class HttpServiceThread:public ServiceThread {
         void updateServiceMetrics();
 
         /**
-         * The current monitor service metric in host/schemes per second.
+         * Method that updates the reported load shedding level from our host/scheme timers.  This method must be
+         * called from within this thread.
+         */
+        void updateSheddingLevel();
+
+        /**
+         * Method that points the host/schemes at the selected HTTP engine, wrapped in the coalescing engine if fetch
+         * coalescing is enabled.  This method must be called from within this thread.
          */
-        float currentHostSchemesPerSecond;
+        void applyHttpEngine();
+
+        /**
+         * The current monitor service metric in host/schemes per second.  The metric is written from within this
+         * thread and can be read from any thread.
+         */
+        std::atomic<float> currentHostSchemesPerSecond;
+
+        /**
+         * The current load shedding level.  The level is written from within this thread and can be read from any
+         * thread.
+         */
+        std::atomic<unsigned> currentSheddingLevel;
+
+        /**
+         * Mutex used to protect our command queue.  The mutex is only taken to post or drain commands.
+         */
+        QMutex commandMutex;
+
+        /**
+         * The commands waiting to be applied.
+         */
+        QList<Command> pendingCommands;
+
+        /**
+         * Flag indicating that an event has been queued to drain the command queue.
+         */
+        bool commandsScheduled;
 
         /**
          * Object defined within the thread context.
@@ -232,19 +522,34 @@ class HttpServiceThread:public ServiceThread {
         DataAggregator* currentDataAggregator;
 
         /**
-         * Mutex used to protect our customer hash table.
+         * The DNS cache used by this thread.
          */
-        mutable QMutex customerMutex;
+        DnsCache* currentDnsCache;
 
         /**
-         * Hash table of customers by customer ID.
+         * The process-wide object index maintained by this thread.
          */
-        CustomersByCustomerId customersByCustomerId;
+        ObjectIndex* currentObjectIndex;
+
+        /**
+         * The latency ring used by this thread.  The ring is owned by the data aggregator.
+         */
+        LatencyRing* currentLatencyRing;
 
         /**
-         * Mutex used to protect our host/scheme hash table.
+         * The metrics maintained by this thread.
          */
-        mutable QMutex hostSchemeMutex;
+        ThreadMetrics currentThreadMetrics;
+
+        /**
+         * The probe measuring this thread's event loop lag.
+         */
+        EventLoopLagProbe* currentEventLoopLagProbe;
+
+        /**
+         * Hash table of customers by customer ID.
+         */
+        CustomersByCustomerId customersByCustomerId;
 
         /**
          * Map of host/scheme timer by polling interval.  Negative values are used to indicate single region monitors,
@@ -253,19 +558,45 @@ class HttpServiceThread:public ServiceThread {
         QMap<int, HostSchemeTimer*> hostSchemeTimers;
 
         /**
-         * Mutex used to protect our monitors hash table.
+         * Hash table of monitors under this host/scheme.
+         */
+        HostScheme::MonitorsByMonitorId monitorsByMonitorId;
+
+        /**
+         * The HTTP engine built on QNetworkAccessManager.
          */
-        mutable QMutex monitorMutex;
+        HttpEngine* qtHttpEngine;
 
         /**
-         * Hash table of monitors under this host/scheme.
+         * The native HTTP engine.  The engine is created the first time it's selected.
          */
-        HostScheme::MonitorsByMonitorId monitorsByMonitorId;
+        HttpEngine* nativeHttpEngine;
+
+        /**
+         * The engine used to coalesce identical fetches.  The engine is created the first time coalescing is
+         * enabled.
+         */
+        CoalescingHttpEngine* coalescingHttpEngine;
+
+        /**
+         * The engine selected by \ref HttpServiceThread::setHttpEngineBackend.
+         */
+        HttpEngine* selectedHttpEngine;
+
+        /**
+         * Flag indicating if fetch coalescing is enabled.
+         */
+        bool fetchCoalescingEnabled;
+
+        /**
+         * The HTTP engine assigned to new host/schemes.
+         */
+        std::atomic<HttpEngine*> currentHttpEngine;
 
         /**
-         * The network access manager for this thread.
+         * The timing wheel used to schedule all host/scheme checks performed by this thread.
          */
-        QNetworkAccessManager* networkAccessManager;
+        TimingWheel* timingWheel;
 
         /**
          * The current region index we're operating in.
@@ -281,6 +612,12 @@ class HttpServiceThread:public ServiceThread {
          * Flag indicating if we're active.
          */
         bool currentActive;
+
+        /**
+         * Flag indicating that a batch of customers or commands is being applied.  Service metrics updates are
+         * deferred while this flag is set.
+         */
+        bool bulkLoadInProgress;
 };
 
 #endif
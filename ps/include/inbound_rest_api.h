@@ -29,20 +29,27 @@
 #include <QMap>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QJsonArray>
 
 #include <rest_api_in_v1_server.h>
 #include <rest_api_in_v1_json_response.h>
 #include <rest_api_in_v1_inesonic_rest_handler.h>
 
 #include "loading_data.h"
+#include "metrics.h"
 #include "customer.h"
 #include "host_scheme.h"
 #include "monitor.h"
+#include "job_queue.h"
 
 class ServiceThreadTracker;
 
 /**
- * Class that support the polling server's inbound REST API.
+ * Class that support the polling server's inbound REST API.  Requests may be serviced by several threads at once.
+ * Changes are applied, in the order received, from within the thread that owns this object.  Customer additions and
+ * state and region changes are applied after the response is sent; customer additions report a job ID that can be
+ * polled using the job/status endpoint.  Removals and pause requests wait for their turn so their responses report
+ * the outcome.
  */
 class InboundRestApi:public QObject {
     Q_OBJECT
@@ -68,11 +75,21 @@ class InboundRestApi:public QObject {
          */
         static const QString loadingGetPath;
 
+        /**
+         * Path used to obtain request counters, queue depths, scheduler drift and latency histograms.
+         */
+        static const QString metricsGetPath;
+
         /**
          * Path used to add or change settings for a customer.
          */
         static const QString customerAddPath;
 
+        /**
+         * Path used to add or change settings for a large number of customers using a compact encoding.
+         */
+        static const QString customerBulkAddPath;
+
         /**
          * Path used to remove a customer.
          */
@@ -83,6 +100,11 @@ class InboundRestApi:public QObject {
          */
         static const QString customerPausePath;
 
+        /**
+         * Path used to obtain the status of a queued customer change.
+         */
+        static const QString jobStatusPath;
+
         /**
          * Constructor
          *
@@ -123,8 +145,10 @@ class InboundRestApi:public QObject {
                  * \param[in] secret               The secret to use for this handler.
                  *
                  * \param[in] serviceThreadTracker The service thread tracker.
+                 *
+                 * \param[in] jobQueue             The queue used to apply customer changes.
                  */
-                StateActive(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker);
+                StateActive(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker, JobQueue* jobQueue);
 
                 ~StateActive() override;
 
@@ -152,6 +176,11 @@ class InboundRestApi:public QObject {
                  * The current service thread tracker.
                  */
                 ServiceThreadTracker* currentServiceThreadTracker;
+
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
         };
 
         /**
@@ -165,8 +194,10 @@ class InboundRestApi:public QObject {
                  * \param[in] secret               The secret to use for this handler.
                  *
                  * \param[in] serviceThreadTracker The service thread tracker.
+                 *
+                 * \param[in] jobQueue             The queue used to apply customer changes.
                  */
-                StateInactive(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker);
+                StateInactive(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker, JobQueue* jobQueue);
 
                 ~StateInactive() override;
 
@@ -194,6 +225,11 @@ class InboundRestApi:public QObject {
                  * The current service thread tracker.
                  */
                 ServiceThreadTracker* currentServiceThreadTracker;
+
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
         };
 
         /**
@@ -207,8 +243,10 @@ class InboundRestApi:public QObject {
                  * \param[in] secret               The secret to use for this handler.
                  *
                  * \param[in] serviceThreadTracker The service thread tracker.
+                 *
+                 * \param[in] jobQueue             The queue used to apply customer changes.
                  */
-                RegionChange(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker);
+                RegionChange(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker, JobQueue* jobQueue);
 
                 ~RegionChange() override;
 
@@ -236,6 +274,11 @@ class InboundRestApi:public QObject {
                  * The current service thread tracker.
                  */
                 ServiceThreadTracker* currentServiceThreadTracker;
+
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
         };
 
         /**
@@ -290,7 +333,68 @@ class InboundRestApi:public QObject {
         };
 
         /**
-         * The customer/add handler.
+         * The metrics handler.
+         */
+        class MetricsGet:public RestApiInV1::InesonicRestHandler {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] secret               The secret to use for this handler.
+                 *
+                 * \param[in] serviceThreadTracker The service thread tracker.
+                 *
+                 * \param[in] jobQueue             The queue used to apply customer changes.
+                 */
+                MetricsGet(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker, JobQueue* jobQueue);
+
+                ~MetricsGet() override;
+
+            protected:
+                /**
+                 * Method you can overload to receive a request and send a return response.  This method will only be
+                 * triggered if the message meets the authentication requirements.
+                 *
+                 * \param[in] path     The request path.
+                 *
+                 * \param[in] request  The request data encoded as a JSON document.
+                 *
+                 * \param[in] threadId The ID used to uniquely identify this thread while in flight.
+                 *
+                 * \return The response to return, also encoded as a JSON document.
+                 */
+                RestApiInV1::JsonResponse processAuthenticatedRequest(
+                    const QString&       path,
+                    const QJsonDocument& request,
+                    unsigned             threadId
+                ) override;
+
+            private:
+                /**
+                 * Method that generates a JSON object from latency histogram counts.  Only non-empty buckets are
+                 * reported.
+                 *
+                 * \param[in] counts The histogram bucket counts.
+                 *
+                 * \return Returns a JSON object holding the summary statistics and non-empty buckets.
+                 */
+                static QJsonObject generateHistogram(const LatencyHistogram::Counts& counts);
+
+                /**
+                 * The current service thread tracker.
+                 */
+                ServiceThreadTracker* currentServiceThreadTracker;
+
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
+        };
+
+        /**
+         * The customer/add handler.  Customers that are already being serviced are updated in place.  The request is
+         * validated before the response is sent and applied afterwards.  The response reports a job ID that can be
+         * passed to the job/status endpoint.
          */
         class CustomerAdd:public RestApiInV1::InesonicRestHandler {
             public:
@@ -300,8 +404,10 @@ class InboundRestApi:public QObject {
                  * \param[in] secret               The secret to use for this handler.
                  *
                  * \param[in] serviceThreadTracker The service thread tracker.
+                 *
+                 * \param[in] jobQueue             The queue used to apply customer changes.
                  */
-                CustomerAdd(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker);
+                CustomerAdd(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker, JobQueue* jobQueue);
 
                 ~CustomerAdd() override;
 
@@ -394,10 +500,175 @@ class InboundRestApi:public QObject {
                  * The current service thread tracker.
                  */
                 ServiceThreadTracker* currentServiceThreadTracker;
+
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
         };
 
         /**
-         * The customer/remove handler.
+         * The customer/bulk_add handler.  This handler accepts a compact, positional encoding intended for loading
+         * an entire region at once.  The request is an object holding a single "customers" array.  Each customer is
+         * encoded as:
+         *
+         *     [customer_id, flags, polling_interval, [host_scheme, ...], confirmation_delay, maximum_recheck_interval,
+         *      priority]
+         *
+         * The flags value is a bit mask; bit 0 enables ping testing, bit 1 SSL expiration checking, bit 2 latency
+         * measurements, bit 3 multi-region testing, bit 4 per-phase latency, and bit 5 latency aggregation.  The
+         * confirmation delay and maximum recheck interval, in seconds, control how failed monitors are rechecked and
+         * can be omitted together to use the default values.  The optional priority is "high", "normal", or
+         * "best_effort" and requires both recheck settings.  As with customer/add, the customers are applied after
+         * the response is sent and the response reports a job ID.  Each host/scheme is encoded as:
+         *
+         *     [host_scheme_id, url, [monitor, ...]]
+         *
+         * Each monitor is encoded as shown below.  Only the monitor ID and URI are required.  Trailing entries can be
+         * omitted to use default values.  Keywords and post content are RFC4648 base64 encoded as for customer/add.
+         *
+         *     [monitor_id, uri, method, content_check_mode, post_content_type, [keyword, ...], post_user_agent,
+         *      post_content, maximum_body_size]
+         */
+        class CustomerBulkAdd:public RestApiInV1::InesonicRestHandler {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] secret               The secret to use for this handler.
+                 *
+                 * \param[in] serviceThreadTracker The service thread tracker.
+                 *
+                 * \param[in] jobQueue             The queue used to apply customer changes.
+                 */
+                CustomerBulkAdd(
+                    const QByteArray&     secret,
+                    ServiceThreadTracker* serviceThreadTracker,
+                    JobQueue*             jobQueue
+                );
+
+                ~CustomerBulkAdd() override;
+
+            protected:
+                /**
+                 * Method you can overload to receive a request and send a return response.  This method will only be
+                 * triggered if the message meets the authentication requirements.
+                 *
+                 * \param[in] path     The request path.
+                 *
+                 * \param[in] request  The request data encoded as a JSON document.
+                 *
+                 * \param[in] threadId The ID used to uniquely identify this thread while in flight.
+                 *
+                 * \return The response to return, also encoded as a JSON document.
+                 */
+                RestApiInV1::JsonResponse processAuthenticatedRequest(
+                    const QString&       path,
+                    const QJsonDocument& request,
+                    unsigned             threadId
+                ) override;
+
+            private:
+                /**
+                 * Flag bit indicating ping testing.
+                 */
+                static constexpr unsigned pingFlag = 0x01;
+
+                /**
+                 * Flag bit indicating SSL expiration checking.
+                 */
+                static constexpr unsigned sslExpirationFlag = 0x02;
+
+                /**
+                 * Flag bit indicating latency measurements.
+                 */
+                static constexpr unsigned latencyFlag = 0x04;
+
+                /**
+                 * Flag bit indicating multi-region testing.
+                 */
+                static constexpr unsigned multiRegionFlag = 0x08;
+
+                /**
+                 * Flag bit indicating per-phase latency measurements.
+                 */
+                static constexpr unsigned latencyPhasesFlag = 0x10;
+
+                /**
+                 * Flag bit indicating latency aggregation on the polling server.
+                 */
+                static constexpr unsigned latencyAggregationFlag = 0x20;
+
+                /**
+                 * Method that parses a compact customer entry.
+                 *
+                 * \param[in,out] success      Flag that is set to false if an error is found.
+                 *
+                 * \param[in,out] statusString A string that is updated with status information if an error is found.
+                 *
+                 * \param[in]     jsonArray    The array holding the customer entry.
+                 *
+                 * \return Returns a pointer to a Customer instance.  A null pointer may or may not be returned on
+                 *         error.  You are responsible for disposing of the returned data.
+                 */
+                static Customer* generateCustomer(bool& success, QString& statusString, const QJsonArray& jsonArray);
+
+                /**
+                 * Method that parses a compact host/scheme entry.
+                 *
+                 * \param[in,out] success      Flag that is set to false if an error is found.
+                 *
+                 * \param[in,out] statusString A string that is updated with status information if an error is found.
+                 *
+                 * \param[in]     jsonArray    The array holding the host/scheme entry.
+                 *
+                 * \return Returns a pointer to a \ref HostScheme instance.  A null pointer may or may not be returned
+                 *         on error.  You are responsible for disposing of the returned data.
+                 */
+                static HostScheme* generateHostScheme(
+                    bool&             success,
+                    QString&          statusString,
+                    const QJsonArray& jsonArray
+                );
+
+                /**
+                 * Method that parses a compact monitor entry.
+                 *
+                 * \param[in,out] success      Flag that is set to false if an error is found.
+                 *
+                 * \param[in,out] statusString A string that is updated with status information if an error is found.
+                 *
+                 * \param[in]     jsonArray    The array holding the monitor entry.
+                 *
+                 * \return Returns a pointer to a \ref Monitor instance.  A null pointer is returned on error.  You
+                 *         are responsible for disposing of the returned data.
+                 */
+                static Monitor* generateMonitor(bool& success, QString& statusString, const QJsonArray& jsonArray);
+
+                /**
+                 * Method that decodes an RFC4648 base64 encoded JSON string.
+                 *
+                 * \param[in,out] success Flag that is set to false if an error is found.
+                 *
+                 * \param[in]     value   The JSON value to be decoded.
+                 *
+                 * \return Returns the decoded value.
+                 */
+                static QByteArray decodeBase64(bool& success, const QJsonValue& value);
+
+                /**
+                 * The current service thread tracker.
+                 */
+                ServiceThreadTracker* currentServiceThreadTracker;
+
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
+        };
+
+        /**
+         * The customer/remove handler.  The removal is applied after any customer changes received before it.
          */
         class CustomerRemove:public RestApiInV1::InesonicRestHandler {
             public:
@@ -407,8 +678,14 @@ class InboundRestApi:public QObject {
                  * \param[in] secret               The secret to use for this handler.
                  *
                  * \param[in] serviceThreadTracker The service thread tracker.
+                 *
+                 * \param[in] jobQueue             The queue used to apply customer changes.
                  */
-                CustomerRemove(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker);
+                CustomerRemove(
+                    const QByteArray&     secret,
+                    ServiceThreadTracker* serviceThreadTracker,
+                    JobQueue*             jobQueue
+                );
 
                 ~CustomerRemove() override;
 
@@ -436,10 +713,15 @@ class InboundRestApi:public QObject {
                  * The current service thread tracker.
                  */
                 ServiceThreadTracker* currentServiceThreadTracker;
+
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
         };
 
         /**
-         * The customer/pause handler.
+         * The customer/pause handler.  The change is applied after any customer changes received before it.
          */
         class CustomerPause:public RestApiInV1::InesonicRestHandler {
             public:
@@ -449,8 +731,10 @@ class InboundRestApi:public QObject {
                  * \param[in] secret               The secret to use for this handler.
                  *
                  * \param[in] serviceThreadTracker The service thread tracker.
+                 *
+                 * \param[in] jobQueue             The queue used to apply customer changes.
                  */
-                CustomerPause(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker);
+                CustomerPause(const QByteArray& secret, ServiceThreadTracker* serviceThreadTracker, JobQueue* jobQueue);
 
                 ~CustomerPause() override;
 
@@ -478,8 +762,61 @@ class InboundRestApi:public QObject {
                  * The current service thread tracker.
                  */
                 ServiceThreadTracker* currentServiceThreadTracker;
+
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
         };
 
+        /**
+         * The job/status handler.  The request holds a single "job_id" value.  The response reports the job's
+         * status and, once the job has completed, a "job_result" of "succeeded" or "failed".
+         */
+        class JobStatusGet:public RestApiInV1::InesonicRestHandler {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] secret   The secret to use for this handler.
+                 *
+                 * \param[in] jobQueue The queue used to apply customer changes.
+                 */
+                JobStatusGet(const QByteArray& secret, JobQueue* jobQueue);
+
+                ~JobStatusGet() override;
+
+            protected:
+                /**
+                 * Method you can overload to receive a request and send a return response.  This method will only be
+                 * triggered if the message meets the authentication requirements.
+                 *
+                 * \param[in] path     The request path.
+                 *
+                 * \param[in] request  The request data encoded as a JSON document.
+                 *
+                 * \param[in] threadId The ID used to uniquely identify this thread while in flight.
+                 *
+                 * \return The response to return, also encoded as a JSON document.
+                 */
+                RestApiInV1::JsonResponse processAuthenticatedRequest(
+                    const QString&       path,
+                    const QJsonDocument& request,
+                    unsigned             threadId
+                ) override;
+
+            private:
+                /**
+                 * The queue used to apply customer changes.
+                 */
+                JobQueue* currentJobQueue;
+        };
+
+        /**
+         * The queue used to apply customer changes.  The queue is declared ahead of the handlers that use it.
+         */
+        JobQueue jobQueue;
+
         /**
          * The state/active handler.
          */
@@ -500,11 +837,21 @@ class InboundRestApi:public QObject {
          */
         LoadingGet loadingGet;
 
+        /**
+         * The metrics handler.
+         */
+        MetricsGet metricsGet;
+
         /**
          * The customer/add handler.
          */
         CustomerAdd customerAdd;
 
+        /**
+         * The customer/bulk_add handler.
+         */
+        CustomerBulkAdd customerBulkAdd;
+
         /**
          * The customer/remove handler.
          */
@@ -514,6 +861,11 @@ class InboundRestApi:public QObject {
          * The customer/pause handler.
          */
         CustomerPause customerPause;
+
+        /**
+         * The job/status handler.
+         */
+        JobStatusGet jobStatusGet;
 };
 
 #endif
@@ -0,0 +1,215 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref JobQueue class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef JOB_QUEUE_H
+#define JOB_QUEUE_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+#include <cstdint>
+#include <functional>
+
+/**
+ * Class that applies work in submission order from within the thread that owns the queue.  The inbound REST API
+ * uses this class so that large customer changes can be accepted immediately and applied after the response is
+ * sent.  Each submitted job is assigned an ID that can be used to poll the job's status and, once the job has
+ * completed, whether it succeeded.
+ *
+ * All public methods of this class are thread safe.
+ */
+class JobQueue:public QObject {
+    Q_OBJECT
+
+    public:
+        /**
+         * Type used to represent a job ID.  A value of 0 is never assigned to a job.
+         */
+        typedef std::uint32_t JobId;
+
+        /**
+         * Type used to represent a job.  The job returns true if it succeeded or false if it failed.
+         */
+        typedef std::function<bool()> Job;
+
+        /**
+         * Enumeration of job statuses.
+         */
+        enum class JobStatus {
+            /**
+             * Indicates the job ID is not known.  Completed jobs are forgotten after
+             * \ref JobQueue::maximumRetainedJobs newer jobs have completed.
+             */
+            UNKNOWN,
+
+            /**
+             * Indicates the job is waiting behind earlier jobs.
+             */
+            QUEUED,
+
+            /**
+             * Indicates the job is being applied.
+             */
+            RUNNING,
+
+            /**
+             * Indicates the job has been applied.  See \ref JobQueue::succeeded for the outcome.
+             */
+            COMPLETED
+        };
+
+        /**
+         * The number of completed jobs whose status is retained.
+         */
+        static constexpr unsigned maximumRetainedJobs = 4096;
+
+        /**
+         * Constructor
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        JobQueue(QObject* parent = nullptr);
+
+        ~JobQueue() override;
+
+        /**
+         * Method you can use to queue a job.  The job is run from within the thread that owns this queue, after
+         * every job submitted before it.
+         *
+         * \param[in] job The job to be run.
+         *
+         * \return Returns the ID assigned to the job.
+         */
+        JobId submit(const Job& job);
+
+        /**
+         * Method you can use to run a job and wait for it to complete.  The job is run after every job submitted
+         * before it.  Jobs run this way are not assigned an ID.
+         *
+         * \param[in] job The job to be run.
+         *
+         * \return Returns the value returned by the job.
+         */
+        bool execute(const Job& job);
+
+        /**
+         * Method you can use to obtain the status of a job.
+         *
+         * \param[in]  jobId     The ID of the job of interest.
+         *
+         * \param[out] succeeded Optional pointer to a flag set to the job's outcome.  The flag is only updated if the
+         *                       job has completed.
+         *
+         * \return Returns the job's status.
+         */
+        JobStatus status(JobId jobId, bool* succeeded = nullptr) const;
+
+        /**
+         * Method you can use to obtain the number of submitted jobs that have not completed.
+         *
+         * \return Returns the number of queued or running jobs.
+         */
+        unsigned long numberPendingJobs() const;
+
+        /**
+         * Method you can use to convert a job status to a string.
+         *
+         * \param[in] jobStatus The job status to be converted.
+         *
+         * \return Returns the job status as a string.
+         */
+        static QString toString(JobStatus jobStatus);
+
+    private:
+        /**
+         * Class used to track a single job.
+         */
+        class JobRecord {
+            public:
+                JobRecord():status(JobStatus::UNKNOWN),succeeded(false) {}
+
+                /**
+                 * Constructor
+                 *
+                 * \param[in] jobStatus    The job's status.
+                 *
+                 * \param[in] jobSucceeded Flag indicating if the job succeeded.
+                 */
+                JobRecord(
+                        JobStatus jobStatus,
+                        bool      jobSucceeded = false
+                    ):status(
+                        jobStatus
+                    ),succeeded(
+                        jobSucceeded
+                    ) {}
+
+                /**
+                 * The job's status.
+                 */
+                JobStatus status;
+
+                /**
+                 * Flag indicating if the job succeeded.  The value is only meaningful once the job has completed.
+                 */
+                bool succeeded;
+        };
+
+        /**
+         * Method that runs a submitted job.
+         *
+         * \param[in] jobId The ID of the job.
+         *
+         * \param[in] job   The job to be run.
+         */
+        void runJob(JobId jobId, const Job& job);
+
+        /**
+         * Mutex used to guard the job statuses.
+         */
+        mutable QMutex jobMutex;
+
+        /**
+         * The last assigned job ID.
+         */
+        JobId lastJobId;
+
+        /**
+         * The record of each queued, running and recently completed job, by job ID.
+         */
+        QHash<JobId, JobRecord> jobRecords;
+
+        /**
+         * The IDs of recently completed jobs, oldest first.
+         */
+        QList<JobId> completedJobIds;
+
+        /**
+         * The number of queued or running jobs.
+         */
+        unsigned long currentNumberPendingJobs;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref KeywordMatcher class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef KEYWORD_MATCHER_H
+#define KEYWORD_MATCHER_H
+
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QVector>
+
+#include <cstdint>
+
+/**
+ * Class that finds a set of keywords in a single pass over a body of text.  The keywords are compiled into an
+ * Aho-Corasick automaton that is flattened into a deterministic state machine operating on byte classes.  Bytes that
+ * do not appear in any keyword share a single class which keeps the transition table small.
+ *
+ * The matcher is immutable once constructed and can be shared across threads.  Scanning state is held by the caller
+ * so a body can be scanned incrementally as it arrives.
+ */
+class KeywordMatcher {
+    public:
+        /**
+         * Type used to represent a list of keywords.
+         */
+        typedef QByteArrayList KeywordList;
+
+        /**
+         * Type used to represent a matcher state.
+         */
+        typedef std::uint32_t State;
+
+        /**
+         * The state to use at the start of a body.
+         */
+        static constexpr State startState = 0;
+
+        /**
+         * Constructor
+         *
+         * \param[in] keywords The keywords to be matched.
+         */
+        KeywordMatcher(const KeywordList& keywords);
+
+        ~KeywordMatcher();
+
+        /**
+         * Method you can use to obtain the number of keywords.
+         *
+         * \return Returns the number of keywords.
+         */
+        unsigned numberKeywords() const;
+
+        /**
+         * Method you can use to obtain the number of automaton states.
+         *
+         * \return Returns the number of states.
+         */
+        unsigned numberStates() const;
+
+        /**
+         * Method you can use to determine which keywords are empty.  Empty keywords match every body, including an
+         * empty one.
+         *
+         * \param[in,out] found       Flags indicating which keywords were found.  Must hold one entry per keyword.
+         *
+         * \param[in,out] numberFound The number of keywords found.  Updated as new keywords are found.
+         */
+        void markEmptyKeywords(QVector<bool>& found, unsigned& numberFound) const;
+
+        /**
+         * Method you can use to scan a block of data.
+         *
+         * \param[in]     state             The state at the start of the block.
+         *
+         * \param[in]     data              Pointer to the data to be scanned.
+         *
+         * \param[in]     length            The number of bytes to be scanned.
+         *
+         * \param[in,out] found             Flags indicating which keywords were found.  Must hold one entry per
+         *                                  keyword.
+         *
+         * \param[in,out] numberFound       The number of keywords found.  Updated as new keywords are found.
+         *
+         * \param[in]     targetNumberFound Scanning stops early once this many keywords have been found.
+         *
+         * \return Returns the state at the end of the block.
+         */
+        State scan(
+            State          state,
+            const char*    data,
+            unsigned long  length,
+            QVector<bool>& found,
+            unsigned&      numberFound,
+            unsigned       targetNumberFound
+        ) const;
+
+    private:
+        /**
+         * Value used to mark a missing trie edge during construction.
+         */
+        static constexpr State noState = static_cast<State>(-1);
+
+        /**
+         * The number of keywords.
+         */
+        unsigned currentNumberKeywords;
+
+        /**
+         * The number of byte classes.  Class 0 is used for bytes that do not appear in any keyword.
+         */
+        unsigned currentNumberClasses;
+
+        /**
+         * Table mapping each byte value to its byte class.
+         */
+        std::uint16_t byteClasses[256];
+
+        /**
+         * The transition table, indexed by state times the number of classes plus the byte class.
+         */
+        QVector<State> transitions;
+
+        /**
+         * Offsets into the output table for each state.  Holds one extra entry marking the end of the last state.
+         */
+        QVector<std::uint32_t> outputOffsets;
+
+        /**
+         * The keywords ending at each state, including keywords that are suffixes of longer keywords.
+         */
+        QVector<std::uint32_t> outputs;
+};
+
+#endif
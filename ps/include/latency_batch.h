@@ -0,0 +1,248 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref LatencyBatch class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef LATENCY_BATCH_H
+#define LATENCY_BATCH_H
+
+#include <QObject>
+#include <QTimer>
+#include <QString>
+#include <QByteArray>
+
+#include <cstdint>
+#include <functional>
+
+#include <rest_api_out_v1_server.h>
+#include <rest_api_out_v1_inesonic_binary_rest_handler.h>
+
+#include "data_aggregator.h"
+
+/**
+ * Class that sends a single latency report to the database controller, retrying with backoff and jitter until the
+ * report is accepted.  Each batch carries its own sequence number and retry state so several reports can be in flight
+ * at once.
+ *
+ * The report is encoded again for every attempt so a retry always uses the report version the database controller
+ * most recently advertised.  A controller that is rolled back while a report is being retried will still accept it.
+ */
+class LatencyBatch:public RestApiOutV1::InesonicBinaryRestHandler {
+    Q_OBJECT
+
+    public:
+        /**
+         * The delay before the first attempt to resend a report, in seconds.  The delay doubles with each
+         * consecutive failure.
+         */
+        static constexpr unsigned minimumRetryDelaySeconds = 15;
+
+        /**
+         * The maximum delay between attempts to resend a report, in seconds.
+         */
+        static constexpr unsigned maximumRetryDelaySeconds = 600;
+
+        /**
+         * Type of function used to encode a report.  The function receives the latency entries, the latency
+         * summaries and the sequence number of the report and returns the encoded report, including the header.
+         */
+        typedef std::function<
+            QByteArray(
+                const DataAggregator::LatencyEntryList&,
+                const DataAggregator::LatencySummaryList&,
+                unsigned long long
+            )
+        > ReportBuilder;
+
+        /**
+         * Constructor.
+         *
+         * \param[in] reportBuilder The function used to encode the report for each attempt.
+         *
+         * \param[in] server        The server instance this REST API will talk to.
+         *
+         * \param[in] parent        Pointer to the parent object.
+         */
+        LatencyBatch(const ReportBuilder& reportBuilder, RestApiOutV1::Server* server, QObject* parent = nullptr);
+
+        /**
+         * Constructor
+         *
+         * \param[in] reportBuilder The function used to encode the report for each attempt.
+         *
+         * \param[in] secret        The secret to be used by this REST API.
+         *
+         * \param[in] server        The server instance this REST API will talk to.
+         *
+         * \param[in] parent        Pointer to the parent object.
+         */
+        LatencyBatch(
+            const ReportBuilder&  reportBuilder,
+            const QByteArray&     secret,
+            RestApiOutV1::Server* server,
+            QObject*              parent = nullptr
+        );
+
+        ~LatencyBatch() override;
+
+        /**
+         * Method you can use to send a report.  The batch must be idle.
+         *
+         * \param[in] entries        The latency entries carried by the report.
+         *
+         * \param[in] summaries      The latency summaries carried by the report.
+         *
+         * \param[in] sequenceNumber The report sequence number.
+         */
+        void send(
+            const DataAggregator::LatencyEntryList&   entries,
+            const DataAggregator::LatencySummaryList& summaries,
+            unsigned long long                        sequenceNumber
+        );
+
+        /**
+         * Method you can use to obtain the latency entries carried by the current report.
+         *
+         * \return Returns the latency entries.
+         */
+        const DataAggregator::LatencyEntryList& entries() const;
+
+        /**
+         * Method you can use to determine the number of latency entries carried by the current report.
+         *
+         * \return Returns the number of latency entries.
+         */
+        unsigned long numberEntries() const;
+
+        /**
+         * Method you can use to determine the number of latency summaries carried by the current report.
+         *
+         * \return Returns the number of latency summaries.
+         */
+        unsigned long numberSummaries() const;
+
+        /**
+         * Method you can use to remove the latency summaries from the current report.  Retries of the report will only
+         * carry the latency entries.
+         *
+         * \return Returns the number of latency entries covered by the removed summaries.
+         */
+        unsigned long discardSummaries();
+
+        /**
+         * Method you can use to obtain the sequence number of the current report.
+         *
+         * \return Returns the report sequence number.
+         */
+        unsigned long long sequenceNumber() const;
+
+        /**
+         * Method that applies random jitter to a delay so that polling servers recovering from the same outage don't
+         * report in lock step.
+         *
+         * \param[in] delay The nominal delay.
+         *
+         * \return Returns a random delay between half and all of the nominal delay.
+         */
+        static unsigned long jitter(unsigned long delay);
+
+    signals:
+        /**
+         * Signal that is emitted when the database controller responds to the report.
+         *
+         * \param[out] batch               This batch.
+         *
+         * \param[out] accepted            If true, the report was accepted and the batch is idle.  If false, the
+         *                                 batch will retry the report.
+         *
+         * \param[out] supportedVersion    The newest report version the database controller advertised.
+         *
+         * \param[out] compressionAccepted If true, the database controller accepts compressed reports.
+         */
+        void responseReceived(
+            LatencyBatch* batch,
+            bool          accepted,
+            unsigned      supportedVersion,
+            bool          compressionAccepted
+        );
+
+    protected:
+        /**
+         * Method you can overload to process a received response.
+         *
+         * \param[in] binaryData  The received binary response.
+         *
+         * \param[in] contentType The response content type, if reported.
+         */
+        void processResponse(const QByteArray& binaryData, const QString& contentType) override;
+
+        /**
+         * Method you can overload to process a failed transmisison attempt.
+         *
+         * \param[in] errorString a string providing an error message.
+         */
+        void processRequestFailed(const QString& errorString) override;
+
+    private slots:
+        /**
+         * Slot that is triggered to encode and send the report.
+         */
+        void resend();
+
+    private:
+        /**
+         * Method that schedules a retry of the current report.
+         *
+         * \param[in] reason A description of why the report failed.
+         */
+        void scheduleRetry(const QString& reason);
+
+        /**
+         * The function used to encode the report.
+         */
+        ReportBuilder currentReportBuilder;
+
+        /**
+         * Timer used to trigger retries.
+         */
+        QTimer retryTimer;
+
+        /**
+         * The latency entries carried by the current report.
+         */
+        DataAggregator::LatencyEntryList currentEntries;
+
+        /**
+         * The latency summaries carried by the current report.
+         */
+        DataAggregator::LatencySummaryList currentSummaries;
+
+        /**
+         * The sequence number of the current report.
+         */
+        unsigned long long currentSequenceNumber;
+
+        /**
+         * The number of consecutive failed attempts to send the current report.
+         */
+        unsigned currentNumberFailures;
+};
+
+#endif
@@ -0,0 +1,306 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref LatencyReportEncoder class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef LATENCY_REPORT_ENCODER_H
+#define LATENCY_REPORT_ENCODER_H
+
+#include <QByteArray>
+
+#include <cstdint>
+
+#include "data_aggregator.h"
+
+/**
+ * Class that encodes the body of a latency report.  Note that the encodings are also decoded by the db_controller
+ * project and must match.
+ *
+ * Version 0 reports contain fixed size, packed entries holding a 32-bit monitor ID, a 32-bit Zoran timestamp and a
+ * 32-bit latency value, in that order, in native byte order.
+ *
+ * Version 1 reports sort the entries by monitor ID and then by timestamp and encode them using unsigned LEB128 varints
+ * as follows:
+ *
+ *     varint  number of entries
+ *     varint  base Zoran timestamp (the smallest timestamp in the report)
+ *     for each monitor:
+ *         varint  monitor ID minus the previous monitor ID (the first is relative to 0)
+ *         varint  number of entries for this monitor
+ *         for each entry:
+ *             varint  timestamp minus the previous timestamp for this monitor (the first is relative to the base)
+ *             varint  latency in microseconds
+ *
+ * Version 2 reports use the version 1 layout except that each latency value is shifted left by one bit with the
+ * least significant bit set if the entry carries a per-phase breakdown.  Entries with a breakdown are followed by
+ * four varints holding the DNS, connection setup, time to first byte and transfer times, in microseconds.
+ *
+ * Version 3 reports prefix the version 2 layout with two varints holding a session ID, chosen at random when the
+ * polling server starts, and a report sequence number that starts at 1 for each session.  A report that is retried
+ * keeps its sequence number so the database controller can discard duplicates when several reports are in flight.
+ *
+ * Version 4 reports use the version 3 layout followed by per-monitor window summaries for customers that aggregate
+ * latency on the polling server.  Summaries are sorted by monitor ID and then by window start and are encoded as:
+ *
+ *     varint  number of summaries
+ *     varint  window length, in seconds
+ *     varint  base Zoran timestamp (the earliest window start in the report)
+ *     for each summary:
+ *         varint  monitor ID minus the previous monitor ID (the first is relative to 0)
+ *         varint  window start minus the base timestamp
+ *         varint  number of samples
+ *         varint  minimum latency in microseconds
+ *         varint  maximum latency in microseconds
+ *         varint  sum of the latencies in microseconds
+ *         varint  number of non-empty histogram buckets
+ *         for each bucket:
+ *             varint  bucket index minus the previous bucket index (the first is relative to 0)
+ *             varint  number of samples in the bucket
+ *
+ * Bucket indexes are those reported by \ref LatencyHistogram::bucketIndex.  A window may be summarized more than
+ * once if samples arrive after the summary was sent.  Summaries for the same window can be merged by adding them.
+ *
+ * Version 5 reports use the version 4 layout except that entries with a breakdown are followed by five varints holding
+ * the DNS, TCP connection setup, TLS handshake, time to first byte and transfer times, in microseconds.  Earlier
+ * versions report the TLS handshake as part of the connection setup time.
+ */
+class LatencyReportEncoder {
+    public:
+        /**
+         * Type used to represent a list of latency entries.
+         */
+        typedef DataAggregator::LatencyEntryList LatencyEntryList;
+
+        /**
+         * The highest report version supported by this encoder.
+         */
+        static constexpr unsigned maximumSupportedVersion = 5;
+
+        /**
+         * The first report version that carries a sequence number.
+         */
+        static constexpr unsigned firstSequencedVersion = 3;
+
+        /**
+         * The first report version that carries latency summaries.
+         */
+        static constexpr unsigned firstAggregatedVersion = 4;
+
+        /**
+         * The first report version that reports the TLS handshake separately from connection setup.
+         */
+        static constexpr unsigned firstTlsPhaseVersion = 5;
+
+        /**
+         * Type used to represent a list of latency summaries.
+         */
+        typedef DataAggregator::LatencySummaryList LatencySummaryList;
+
+        /**
+         * Method that encodes latency entries using fixed size records (version 0).
+         *
+         * \param[in]     latencyEntryList The list of latency entries to be encoded.
+         *
+         * \param[in,out] buffer           The buffer to append the encoded entries to.
+         */
+        static void encodeFixed(const LatencyEntryList& latencyEntryList, QByteArray& buffer);
+
+        /**
+         * Method that encodes latency entries using sorted, delta and varint encoded records (version 1).
+         *
+         * \param[in]     latencyEntryList The list of latency entries to be encoded.
+         *
+         * \param[in,out] buffer           The buffer to append the encoded entries to.
+         */
+        static void encodeCompact(const LatencyEntryList& latencyEntryList, QByteArray& buffer);
+
+        /**
+         * Method that encodes latency entries using sorted, delta and varint encoded records with optional per-phase
+         * breakdowns (version 2).
+         *
+         * \param[in]     latencyEntryList The list of latency entries to be encoded.
+         *
+         * \param[in,out] buffer           The buffer to append the encoded entries to.
+         */
+        static void encodePhased(const LatencyEntryList& latencyEntryList, QByteArray& buffer);
+
+        /**
+         * Method that encodes latency entries using the version 2 layout preceded by a session ID and report
+         * sequence number (version 3).
+         *
+         * \param[in]     latencyEntryList The list of latency entries to be encoded.
+         *
+         * \param[in]     sessionId        The session ID of this polling server.
+         *
+         * \param[in]     sequenceNumber   The sequence number of the report.
+         *
+         * \param[in,out] buffer           The buffer to append the encoded entries to.
+         */
+        static void encodeSequenced(
+            const LatencyEntryList& latencyEntryList,
+            std::uint32_t           sessionId,
+            std::uint64_t           sequenceNumber,
+            QByteArray&             buffer
+        );
+
+        /**
+         * Method that encodes latency entries and latency summaries using the version 3 layout followed by the
+         * summaries (version 4).
+         *
+         * \param[in]     latencyEntryList   The list of latency entries to be encoded.
+         *
+         * \param[in]     latencySummaryList The list of latency summaries to be encoded.
+         *
+         * \param[in]     windowSeconds      The length of the aggregation window, in seconds.
+         *
+         * \param[in]     sessionId          The session ID of this polling server.
+         *
+         * \param[in]     sequenceNumber     The sequence number of the report.
+         *
+         * \param[in,out] buffer             The buffer to append the encoded entries to.
+         */
+        static void encodeAggregated(
+            const LatencyEntryList&   latencyEntryList,
+            const LatencySummaryList& latencySummaryList,
+            unsigned                  windowSeconds,
+            std::uint32_t             sessionId,
+            std::uint64_t             sequenceNumber,
+            QByteArray&               buffer
+        );
+
+        /**
+         * Method that encodes latency entries and latency summaries using the version 4 layout with the TLS handshake
+         * reported as a separate phase (version 5).
+         *
+         * \param[in]     latencyEntryList   The list of latency entries to be encoded.
+         *
+         * \param[in]     latencySummaryList The list of latency summaries to be encoded.
+         *
+         * \param[in]     windowSeconds      The length of the aggregation window, in seconds.
+         *
+         * \param[in]     sessionId          The session ID of this polling server.
+         *
+         * \param[in]     sequenceNumber     The sequence number of the report.
+         *
+         * \param[in,out] buffer             The buffer to append the encoded entries to.
+         */
+        static void encodeDetailed(
+            const LatencyEntryList&   latencyEntryList,
+            const LatencySummaryList& latencySummaryList,
+            unsigned                  windowSeconds,
+            std::uint32_t             sessionId,
+            std::uint64_t             sequenceNumber,
+            QByteArray&               buffer
+        );
+
+        /**
+         * Method that appends an unsigned LEB128 varint to a buffer.
+         *
+         * \param[in,out] buffer The buffer to append the value to.
+         *
+         * \param[in]     value  The value to be appended.
+         */
+        static inline void appendVarint(QByteArray& buffer, std::uint64_t value) {
+            char     encoded[10];
+            unsigned length = 0;
+
+            while (value >= 0x80) {
+                encoded[length] = static_cast<char>((value & 0x7F) | 0x80);
+                value >>= 7;
+                ++length;
+            }
+
+            encoded[length] = static_cast<char>(value);
+            buffer.append(encoded, static_cast<int>(length + 1));
+        }
+
+    private:
+        /**
+         * Enumeration of per-phase breakdown encodings.
+         */
+        enum class PhaseEncoding {
+            /**
+             * Indicates no breakdown is sent (version 1).
+             */
+            NONE,
+
+            /**
+             * Indicates four phases are sent with the TLS handshake folded into connection setup (versions 2 - 4).
+             */
+            FOUR_PHASES,
+
+            /**
+             * Indicates five phases are sent with the TLS handshake reported separately (version 5).
+             */
+            FIVE_PHASES
+        };
+
+        /**
+         * Method that encodes latency entries using sorted, delta and varint encoded records.
+         *
+         * \param[in]     latencyEntryList The list of latency entries to be encoded.
+         *
+         * \param[in,out] buffer           The buffer to append the encoded entries to.
+         *
+         * \param[in]     phaseEncoding    The per-phase breakdown encoding to be used.
+         */
+        static void encodeSorted(
+            const LatencyEntryList& latencyEntryList,
+            QByteArray&             buffer,
+            PhaseEncoding           phaseEncoding
+        );
+
+        /**
+         * Method that encodes latency summaries using the version 4 layout.
+         *
+         * \param[in]     latencySummaryList The list of latency summaries to be encoded.
+         *
+         * \param[in]     windowSeconds      The length of the aggregation window, in seconds.
+         *
+         * \param[in,out] buffer             The buffer to append the encoded summaries to.
+         */
+        static void encodeSummaries(
+            const LatencySummaryList& latencySummaryList,
+            unsigned                  windowSeconds,
+            QByteArray&               buffer
+        );
+
+        /**
+         * The fixed size record used by version 0 reports.
+         */
+        struct FixedEntry {
+            /**
+             * The monitor ID.
+             */
+            std::uint32_t monitorId;
+
+            /**
+             * The Zoran timestamp.
+             */
+            std::uint32_t timestamp;
+
+            /**
+             * The latency in microseconds
+             */
+            std::uint32_t latencyMicroseconds;
+        } __attribute__((packed));
+};
+
+#endif
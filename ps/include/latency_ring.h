@@ -0,0 +1,142 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref LatencyRing class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef LATENCY_RING_H
+#define LATENCY_RING_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "data_aggregator.h"
+
+/**
+ * Class that provides a preallocated, lock-free, single-producer/single-consumer ring buffer of latency entries.  Each
+ * service thread owns one ring and is the only producer.  The data aggregator is the only consumer.
+ */
+class LatencyRing {
+    public:
+        /**
+         * Type used to represent a latency entry.
+         */
+        typedef DataAggregator::LatencyEntry LatencyEntry;
+
+        /**
+         * Type used to represent a list of latency entries.
+         */
+        typedef DataAggregator::LatencyEntryList LatencyEntryList;
+
+        /**
+         * The number of entries held by each ring.  Value must be a power of 2.
+         */
+        static constexpr unsigned long capacity = 8192;
+
+        /**
+         * Constructor
+         */
+        LatencyRing():head(0),tail(0) {}
+
+        ~LatencyRing() = default;
+
+        /**
+         * Method you can use to append an entry to the ring.  This method must only be called by the producer
+         * thread and never allocates or blocks.
+         *
+         * \param[in] entry The entry to be appended.
+         *
+         * \return Returns true on success.  Returns false if the ring is full.
+         */
+        inline bool append(const LatencyEntry& entry) {
+            bool          success;
+            unsigned long currentTail = tail.load(std::memory_order_relaxed);
+            unsigned long currentHead = head.load(std::memory_order_acquire);
+
+            if (currentTail - currentHead < capacity) {
+                entries[currentTail & mask] = entry;
+                tail.store(currentTail + 1, std::memory_order_release);
+
+                success = true;
+            } else {
+                success = false;
+            }
+
+            return success;
+        }
+
+        /**
+         * Method you can use to determine the number of entries currently held in the ring.  The value is
+         * approximate if called while the producer or consumer is active.
+         *
+         * \return Returns the number of entries in the ring.
+         */
+        inline unsigned long size() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Method you can use to move all entries in the ring to a list.  This method must only be called by the
+         * consumer thread.
+         *
+         * \param[in,out] list The list to receive the entries.  Entries are appended to the list.
+         *
+         * \return Returns the number of entries moved.
+         */
+        inline unsigned long drain(LatencyEntryList& list) {
+            unsigned long currentHead = head.load(std::memory_order_relaxed);
+            unsigned long currentTail = tail.load(std::memory_order_acquire);
+            unsigned long count       = currentTail - currentHead;
+
+            for (unsigned long index=currentHead ; index!=currentTail ; ++index) {
+                list.append(entries[index & mask]);
+            }
+
+            head.store(currentTail, std::memory_order_release);
+            return count;
+        }
+
+    private:
+        /**
+         * Mask used to convert an index into a ring position.
+         */
+        static constexpr unsigned long mask = capacity - 1;
+
+        /**
+         * Size of a cache line.  Used to keep the producer and consumer indexes from sharing a cache line.
+         */
+        static constexpr unsigned cacheLineSize = 64;
+
+        /**
+         * The consumer index.
+         */
+        alignas(cacheLineSize) std::atomic<unsigned long> head;
+
+        /**
+         * The producer index.
+         */
+        alignas(cacheLineSize) std::atomic<unsigned long> tail;
+
+        /**
+         * The ring storage.
+         */
+        alignas(cacheLineSize) LatencyEntry entries[capacity];
+};
+
+#endif
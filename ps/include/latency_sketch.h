@@ -0,0 +1,185 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref LatencySketch class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef LATENCY_SKETCH_H
+#define LATENCY_SKETCH_H
+
+#include <QVector>
+
+#include <cstdint>
+
+/**
+ * Class that maintains a sparse latency sketch.  Samples are counted using the same log-linear buckets as
+ * \ref LatencyHistogram, roughly 3% relative precision, but only non-empty buckets are stored.  A sketch holding a
+ * handful of samples costs a handful of bytes rather than a few kilobytes.
+ *
+ * The sketch also tracks the exact sample count, minimum, maximum and sum.
+ */
+class LatencySketch {
+    public:
+        /**
+         * Class used to hold a single non-empty bucket.
+         */
+        class Bucket {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] index The bucket index, as reported by \ref LatencyHistogram::bucketIndex.
+                 *
+                 * \param[in] count The number of samples in the bucket.
+                 */
+                constexpr Bucket(
+                        std::uint16_t index = 0,
+                        std::uint32_t count = 0
+                    ):currentIndex(
+                        index
+                    ),currentCount(
+                        count
+                    ) {}
+
+                /**
+                 * Method you can use to obtain the bucket index.
+                 *
+                 * \return Returns the bucket index.
+                 */
+                inline std::uint16_t index() const {
+                    return currentIndex;
+                }
+
+                /**
+                 * Method you can use to obtain the number of samples in the bucket.
+                 *
+                 * \return Returns the bucket count.
+                 */
+                inline std::uint32_t count() const {
+                    return currentCount;
+                }
+
+                /**
+                 * Method you can use to add a sample to the bucket.
+                 */
+                inline void increment() {
+                    ++currentCount;
+                }
+
+            private:
+                /**
+                 * The bucket index.
+                 */
+                std::uint16_t currentIndex;
+
+                /**
+                 * The number of samples in the bucket.
+                 */
+                std::uint32_t currentCount;
+        };
+
+        /**
+         * Type used to hold the non-empty buckets, in increasing index order.
+         */
+        typedef QVector<Bucket> Buckets;
+
+        LatencySketch();
+
+        ~LatencySketch() = default;
+
+        /**
+         * Method you can use to add a sample to the sketch.
+         *
+         * \param[in] microseconds The sample value, in microseconds.
+         */
+        void record(std::uint32_t microseconds);
+
+        /**
+         * Method you can use to obtain the number of samples.
+         *
+         * \return Returns the number of samples recorded.
+         */
+        inline std::uint32_t count() const {
+            return currentCount;
+        }
+
+        /**
+         * Method you can use to obtain the smallest sample.
+         *
+         * \return Returns the smallest sample, in microseconds.  The value is 0 if the sketch is empty.
+         */
+        inline std::uint32_t minimum() const {
+            return currentMinimum;
+        }
+
+        /**
+         * Method you can use to obtain the largest sample.
+         *
+         * \return Returns the largest sample, in microseconds.
+         */
+        inline std::uint32_t maximum() const {
+            return currentMaximum;
+        }
+
+        /**
+         * Method you can use to obtain the sum of the samples.
+         *
+         * \return Returns the sum of every sample, in microseconds.
+         */
+        inline std::uint64_t sum() const {
+            return currentSum;
+        }
+
+        /**
+         * Method you can use to obtain the non-empty buckets.
+         *
+         * \return Returns the non-empty buckets in increasing index order.
+         */
+        inline const Buckets& buckets() const {
+            return currentBuckets;
+        }
+
+    private:
+        /**
+         * The number of samples.
+         */
+        std::uint32_t currentCount;
+
+        /**
+         * The smallest sample.
+         */
+        std::uint32_t currentMinimum;
+
+        /**
+         * The largest sample.
+         */
+        std::uint32_t currentMaximum;
+
+        /**
+         * The sum of the samples.
+         */
+        std::uint64_t currentSum;
+
+        /**
+         * The non-empty buckets.
+         */
+        Buckets currentBuckets;
+};
+
+#endif
@@ -0,0 +1,327 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref LatencySpill class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef LATENCY_SPILL_H
+#define LATENCY_SPILL_H
+
+#include <QString>
+#include <QFile>
+
+#include <cstdint>
+#include <atomic>
+
+#include "data_aggregator.h"
+
+/**
+ * Class that maintains an optional, memory-mapped spill file for latency entries that could not be held in memory
+ * while the database controller is unreachable.  Entries are kept in first-in, first-out order and are replayed, a
+ * report at a time, once the database controller recovers.
+ *
+ * The queue indexes live in the mapped file header so spilled entries survive process restarts and are replayed
+ * after the restart.  The file is bounded.  If it fills, the oldest entries are discarded to make room for new ones.
+ * Files written in the version 1 format, which did not report the TLS handshake separately, are converted when
+ * opened.  Files in any other format are discarded.
+ *
+ * With the exception of \ref LatencySpill::size, this class must only be used from the data aggregator's thread.
+ */
+class LatencySpill {
+    public:
+        /**
+         * The maximum number of entries held in the spill file.  Dead records are only reclaimed once they make up
+         * half the file so the limit caps the file at roughly 1 GiB.
+         */
+        static constexpr unsigned long maximumEntries = 16UL * 1024UL * 1024UL;
+
+        LatencySpill();
+
+        ~LatencySpill();
+
+        /**
+         * Method you can use to set the spill file.  Entries left in the file by a previous run will be replayed.
+         * Setting the same file again has no effect.
+         *
+         * \param[in] newFilename The path to the spill file.  An empty string disables spilling.
+         *
+         * \return Returns true on success.  Returns false if the file could not be opened or mapped.
+         */
+        bool setFilename(const QString& newFilename);
+
+        /**
+         * Method you can use to obtain the current spill file.
+         *
+         * \return Returns the path to the spill file.  An empty string is returned if spilling is disabled.
+         */
+        QString filename() const;
+
+        /**
+         * Method you can use to determine if spilling is enabled.
+         *
+         * \return Returns true if spilling is enabled.
+         */
+        bool isEnabled() const;
+
+        /**
+         * Method you can use to determine the number of entries held in the spill file.  This method is thread safe.
+         *
+         * \return Returns the number of spilled entries.
+         */
+        unsigned long size() const;
+
+        /**
+         * Method you can use to append entries to the end of the spill file.
+         *
+         * \param[in] entries       The list holding the entries to be spilled.
+         *
+         * \param[in] numberEntries The number of entries, from the front of the list, to be spilled.
+         *
+         * \return Returns the number of entries that were discarded, either older entries removed to make room or
+         *         new entries that could not be written.
+         */
+        unsigned long append(const DataAggregator::LatencyEntryList& entries, unsigned long numberEntries);
+
+        /**
+         * Method you can use to remove the oldest entries from the spill file.
+         *
+         * \param[in,out] entries              The list to receive the entries.  Entries are appended to the list.
+         *
+         * \param[in]     maximumNumberEntries The maximum number of entries to be removed.
+         */
+        void take(DataAggregator::LatencyEntryList& entries, unsigned long maximumNumberEntries);
+
+    private:
+        /**
+         * Value used to identify a spill file.  Holds "PSL1".
+         */
+        static constexpr std::uint32_t spillMagic = 0x314C5350;
+
+        /**
+         * The spill file format version.
+         */
+        static constexpr std::uint32_t spillVersion = 2;
+
+        /**
+         * The previous spill file format version.  Version 1 entry records have no TLS handshake time.
+         */
+        static constexpr std::uint32_t legacySpillVersion = 1;
+
+        /**
+         * The granularity used when growing the spill file, in bytes.
+         */
+        static constexpr qint64 fileGrowthQuantum = 1024 * 1024;
+
+        /**
+         * Structure of the spill file header.
+         */
+        struct FileHeader {
+            /**
+             * Value identifying the file.
+             */
+            std::uint32_t magic;
+
+            /**
+             * The file format version.
+             */
+            std::uint32_t version;
+
+            /**
+             * The index of the oldest entry record.
+             */
+            std::uint64_t head;
+
+            /**
+             * The index one past the newest entry record.
+             */
+            std::uint64_t tail;
+        } __attribute__((packed));
+
+        /**
+         * Structure of a single entry record.  Entry records immediately follow the header.
+         */
+        struct EntryRecord {
+            /**
+             * The monitor ID.
+             */
+            std::uint32_t monitorId;
+
+            /**
+             * The timestamp, in Zoran time.
+             */
+            std::uint32_t timestamp;
+
+            /**
+             * The latency, in microseconds.
+             */
+            std::uint32_t latency;
+
+            /**
+             * Non-zero if the phase breakdown is valid.
+             */
+            std::uint32_t phasesValid;
+
+            /**
+             * The DNS resolution time, in microseconds.
+             */
+            std::uint32_t dns;
+
+            /**
+             * The connection setup time, in microseconds.
+             */
+            std::uint32_t connect;
+
+            /**
+             * The TLS handshake time, in microseconds.
+             */
+            std::uint32_t tls;
+
+            /**
+             * The time to first byte, in microseconds.
+             */
+            std::uint32_t firstByte;
+
+            /**
+             * The body transfer time, in microseconds.
+             */
+            std::uint32_t transfer;
+        } __attribute__((packed));
+
+        /**
+         * Structure of a version 1 entry record.
+         */
+        struct LegacyEntryRecord {
+            /**
+             * The monitor ID.
+             */
+            std::uint32_t monitorId;
+
+            /**
+             * The timestamp, in Zoran time.
+             */
+            std::uint32_t timestamp;
+
+            /**
+             * The latency, in microseconds.
+             */
+            std::uint32_t latency;
+
+            /**
+             * Non-zero if the phase breakdown is valid.
+             */
+            std::uint32_t phasesValid;
+
+            /**
+             * The DNS resolution time, in microseconds.
+             */
+            std::uint32_t dns;
+
+            /**
+             * The connection setup time, including any TLS handshake, in microseconds.
+             */
+            std::uint32_t connect;
+
+            /**
+             * The time to first byte, in microseconds.
+             */
+            std::uint32_t firstByte;
+
+            /**
+             * The body transfer time, in microseconds.
+             */
+            std::uint32_t transfer;
+        } __attribute__((packed));
+
+        /**
+         * Method that obtains a pointer to the header in the mapped file.
+         *
+         * \return Returns a pointer to the file header.
+         */
+        FileHeader* fileHeader() const;
+
+        /**
+         * Method that determines the number of entry records the current mapping can hold.
+         *
+         * \return Returns the record capacity of the mapping.
+         */
+        unsigned long long capacity() const;
+
+        /**
+         * Method that obtains a pointer to an entry record in the mapped file.
+         *
+         * \param[in] index The record index.
+         *
+         * \return Returns a pointer to the requested record.
+         */
+        EntryRecord* record(unsigned long long index) const;
+
+        /**
+         * Method that makes room for additional records at the end of the file.  The live records are moved to the
+         * start of the file once at least half the records are dead.  The file is grown as needed.
+         *
+         * \param[in] numberRecords The number of records to make room for.
+         *
+         * \return Returns true on success.  Returns false if the file could not be grown.
+         */
+        bool reserve(unsigned long long numberRecords);
+
+        /**
+         * Method that converts a mapped version 1 spill file to the current format.  The TLS handshake time of each
+         * converted entry is left in the connection setup time.
+         *
+         * \return Returns true on success.  Returns false if the file could not be grown.
+         */
+        bool upgradeLegacyFile();
+
+        /**
+         * Method that maps the spill file, resizing the file to the requested size.
+         *
+         * \param[in] size The size of the mapping, in bytes.
+         *
+         * \return Returns true on success.  Returns false on error.
+         */
+        bool mapFile(qint64 size);
+
+        /**
+         * Method that unmaps and closes the spill file.
+         */
+        void closeFile();
+
+        /**
+         * The spill file.
+         */
+        QFile spillFile;
+
+        /**
+         * The mapped file data.
+         */
+        uchar* mappedData;
+
+        /**
+         * The size of the mapped region, in bytes.
+         */
+        qint64 mappedSize;
+
+        /**
+         * The number of spilled entries, published for other threads.
+         */
+        std::atomic<unsigned long> currentSize;
+};
+
+#endif
@@ -36,7 +36,11 @@ class LoadingData {
         constexpr LoadingData():
             currentNumberPolledHostSchemes(0),
             currentNumberMissedTimingMarks(0),
-            currentAverageTimingError(0) {}
+            currentAverageTimingError(0),
+            currentNumberRechecks(0),
+            currentNumberDeferredRechecks(0),
+            currentNumberShedPolls(0),
+            currentSheddingLevel(0) {}
 
         /**
          * Constructor
@@ -46,17 +50,38 @@ class LoadingData {
          * \param[in] numberMissedTimingMarks The number of times we've missed a timing mark.
          *
          * \param[in] averageTimingError      The average induced timing error.
+         *
+         * \param[in] numberRechecks          The number of rechecks of non-responsive monitors.
+         *
+         * \param[in] numberDeferredRechecks  The number of times a recheck was skipped because every non-responsive
+         *                                    monitor was backing off.
+         *
+         * \param[in] numberShedPolls         The number of polls of lower priority host/schemes skipped to shed load.
+         *
+         * \param[in] sheddingLevel           The load shedding level.  A value of 0 indicates load is not being shed.
          */
         constexpr LoadingData(
                 unsigned long numberPolledHostSchemes,
                 unsigned long numberMissedTimingMarks,
-                double        averageTimingError
+                double        averageTimingError,
+                unsigned long numberRechecks = 0,
+                unsigned long numberDeferredRechecks = 0,
+                unsigned long numberShedPolls = 0,
+                unsigned      sheddingLevel = 0
             ):currentNumberPolledHostSchemes(
                 numberPolledHostSchemes
             ),currentNumberMissedTimingMarks(
                 numberMissedTimingMarks
             ),currentAverageTimingError(
                 averageTimingError
+            ),currentNumberRechecks(
+                numberRechecks
+            ),currentNumberDeferredRechecks(
+                numberDeferredRechecks
+            ),currentNumberShedPolls(
+                numberShedPolls
+            ),currentSheddingLevel(
+                sheddingLevel
             ) {}
 
         /**
@@ -72,6 +97,14 @@ class LoadingData {
                 other.currentNumberMissedTimingMarks
             ),currentAverageTimingError(
                 other.currentAverageTimingError
+            ),currentNumberRechecks(
+                other.currentNumberRechecks
+            ),currentNumberDeferredRechecks(
+                other.currentNumberDeferredRechecks
+            ),currentNumberShedPolls(
+                other.currentNumberShedPolls
+            ),currentSheddingLevel(
+                other.currentSheddingLevel
             ) {}
 
         ~LoadingData() = default;
@@ -103,6 +136,43 @@ class LoadingData {
             return currentAverageTimingError;
         }
 
+        /**
+         * Method you can use to get the number of rechecks of non-responsive monitors.
+         *
+         * \return Returns the number of rechecks.
+         */
+        inline unsigned long numberRechecks() const {
+            return currentNumberRechecks;
+        }
+
+        /**
+         * Method you can use to get the number of times a recheck was skipped because every non-responsive monitor
+         * was backing off.
+         *
+         * \return Returns the number of deferred rechecks.
+         */
+        inline unsigned long numberDeferredRechecks() const {
+            return currentNumberDeferredRechecks;
+        }
+
+        /**
+         * Method you can use to get the number of polls of lower priority host/schemes skipped to shed load.
+         *
+         * \return Returns the number of shed polls.
+         */
+        inline unsigned long numberShedPolls() const {
+            return currentNumberShedPolls;
+        }
+
+        /**
+         * Method you can use to get the load shedding level.
+         *
+         * \return Returns the load shedding level.  A value of 0 indicates load is not being shed.
+         */
+        inline unsigned sheddingLevel() const {
+            return currentSheddingLevel;
+        }
+
         /**
          * Assignment operator.
          *
@@ -114,6 +184,10 @@ class LoadingData {
             currentNumberPolledHostSchemes = other.currentNumberPolledHostSchemes;
             currentNumberMissedTimingMarks = other.currentNumberMissedTimingMarks;
             currentAverageTimingError      = other.currentAverageTimingError;
+            currentNumberRechecks          = other.currentNumberRechecks;
+            currentNumberDeferredRechecks  = other.currentNumberDeferredRechecks;
+            currentNumberShedPolls         = other.currentNumberShedPolls;
+            currentSheddingLevel           = other.currentSheddingLevel;
 
             return *this;
         }
@@ -133,6 +207,26 @@ class LoadingData {
          * The average timing error.
          */
         double currentAverageTimingError;
+
+        /**
+         * The number of rechecks of non-responsive monitors.
+         */
+        unsigned long currentNumberRechecks;
+
+        /**
+         * The number of deferred rechecks.
+         */
+        unsigned long currentNumberDeferredRechecks;
+
+        /**
+         * The number of shed polls.
+         */
+        unsigned long currentNumberShedPolls;
+
+        /**
+         * The load shedding level.
+         */
+        unsigned currentSheddingLevel;
 };
 
 #endif
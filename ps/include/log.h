@@ -15,7 +15,7 @@
 ********************************************************************************************************************//**
 * \file
 *
-* This header defines the \ref logWrite function.
+* This header defines the \ref logWrite function and related logging functions.
 ***********************************************************************************************************************/
 
 /* .. sphinx-project polling_server */
@@ -26,7 +26,33 @@
 #include <QString>
 
 /**
- * Function you can use to write a log entry.
+ * Enumeration of log severity levels.
+ */
+enum class LogLevel {
+    /**
+     * Indicates detailed diagnostic messages.
+     */
+    DEBUG = 0,
+
+    /**
+     * Indicates normal informational messages.
+     */
+    INFO = 1,
+
+    /**
+     * Indicates a recoverable problem.
+     */
+    WARNING = 2,
+
+    /**
+     * Indicates an error.
+     */
+    ERROR = 3
+};
+
+/**
+ * Function you can use to write a log entry.  Entries are queued to a per-thread lock-free buffer and written by a
+ * dedicated writer thread.  The calling thread never blocks on I/O or on other logging threads.
  *
  * \param[in] message The log message.
  *
@@ -34,4 +60,46 @@
  */
 void logWrite(const QString& message, bool error = false);
 
+/**
+ * Function you can use to write a log entry with an explicit severity level.
+ *
+ * \param[in] level   The message severity level.
+ *
+ * \param[in] message The log message.
+ */
+void logMessage(LogLevel level, const QString& message);
+
+/**
+ * Function you can use to determine if messages at a given level will be written.  Use this function to skip
+ * formatting messages that would be discarded.
+ *
+ * \param[in] level The message severity level.
+ *
+ * \return Returns true if messages at the level are written.  Returns false if they are discarded.
+ */
+bool logEnabled(LogLevel level);
+
+/**
+ * Function you can use to set the minimum severity level that is written.
+ *
+ * \param[in] level The new minimum severity level.
+ */
+void setLogLevel(LogLevel level);
+
+/**
+ * Function you can use to convert a level name, such as "debug" or "warning", to a log level.
+ *
+ * \param[in]  name The level name.  The name is not case sensitive.
+ *
+ * \param[out] ok   Optional pointer to a flag set to true if the name is valid.
+ *
+ * \return Returns the log level.  The value \ref LogLevel::INFO is returned if the name is invalid.
+ */
+LogLevel toLogLevel(const QString& name, bool* ok = nullptr);
+
+/**
+ * Function you can use to block until every queued log entry has been written.
+ */
+void logFlush();
+
 #endif
@@ -0,0 +1,341 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref LatencyHistogram and \ref ThreadMetrics classes.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QVector>
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Class that provides a fixed size, log-linear latency histogram in the style of an HDR histogram.  Values are
+ * recorded with roughly 3% relative precision from 1 microsecond to a little over an hour.  The histogram has a
+ * single writer.  Any thread can read it without locking.
+ */
+class LatencyHistogram {
+    public:
+        /**
+         * The number of bits used for the linear sub-buckets within each power of 2.
+         */
+        static constexpr unsigned subBucketBits = 5;
+
+        /**
+         * The number of significant bits in the largest recordable value.  Larger values are clamped.
+         */
+        static constexpr unsigned valueBits = 32;
+
+        /**
+         * The number of buckets in the histogram.
+         */
+        static constexpr unsigned numberBuckets = (valueBits - subBucketBits + 1) * (1U << (subBucketBits - 1))
+                                                  + (1U << (subBucketBits - 1));
+
+        /**
+         * Type used to hold a copy of the bucket counts.
+         */
+        typedef QVector<std::uint64_t> Counts;
+
+        LatencyHistogram();
+
+        ~LatencyHistogram() = default;
+
+        /**
+         * Method you can use to record a value.  This method must only be called by the owning thread.  It never
+         * blocks or allocates.
+         *
+         * \param[in] microseconds The value to record, in microseconds.
+         */
+        inline void record(unsigned long long microseconds) {
+            std::atomic<std::uint64_t>& bucket = buckets[bucketIndex(microseconds)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        /**
+         * Method you can use to add this histogram's bucket counts to a set of counts.  This method can be called
+         * from any thread.
+         *
+         * \param[in,out] counts The counts to be updated.  The vector is resized to \ref numberBuckets if needed.
+         */
+        void addTo(Counts& counts) const;
+
+        /**
+         * Method that determines the bucket holding a value.
+         *
+         * \param[in] value The value of interest.
+         *
+         * \return Returns the zero based bucket index.
+         */
+        static inline unsigned bucketIndex(unsigned long long value) {
+            if (value >= (1ULL << valueBits)) {
+                value = (1ULL << valueBits) - 1;
+            }
+
+            unsigned shift = 0;
+            if (value >= (1ULL << subBucketBits)) {
+                shift = static_cast<unsigned>(63 - __builtin_clzll(value)) - (subBucketBits - 1);
+            }
+
+            return shift * (1U << (subBucketBits - 1)) + static_cast<unsigned>(value >> shift);
+        }
+
+        /**
+         * Method that determines the smallest value held by a bucket.
+         *
+         * \param[in] index The zero based bucket index.
+         *
+         * \return Returns the lower bound of the bucket.
+         */
+        static unsigned long long lowerBound(unsigned index);
+
+        /**
+         * Method that determines the largest value held by a bucket.
+         *
+         * \param[in] index The zero based bucket index.
+         *
+         * \return Returns the upper bound of the bucket.
+         */
+        static unsigned long long upperBound(unsigned index);
+
+        /**
+         * Method that determines the total number of values in a set of counts.
+         *
+         * \param[in] counts The bucket counts.
+         *
+         * \return Returns the total count.
+         */
+        static unsigned long long totalCount(const Counts& counts);
+
+        /**
+         * Method that estimates a percentile from a set of counts.
+         *
+         * \param[in] counts   The bucket counts.
+         *
+         * \param[in] fraction The desired percentile as a fraction between 0 and 1.
+         *
+         * \return Returns the upper bound of the bucket holding the percentile.  A value of 0 is returned if the
+         *         counts are empty.
+         */
+        static unsigned long long percentile(const Counts& counts, double fraction);
+
+    private:
+        /**
+         * The bucket counts.
+         */
+        std::atomic<std::uint64_t> buckets[numberBuckets];
+};
+
+/**
+ * Class that holds counters, gauges and a latency histogram maintained by a single service thread.  The owning
+ * thread updates the values with relaxed atomic operations.  Any thread can read them.
+ */
+class ThreadMetrics {
+    public:
+        /**
+         * Class used to accumulate metrics across threads.
+         */
+        class Totals {
+            public:
+                Totals():
+                    requestsStarted(0),
+                    requestsSucceeded(0),
+                    requestsFailed(0),
+                    latencySamplesExcluded(0),
+                    responsesNotModified(0),
+                    requestsCoalesced(0),
+                    repliesInFlight(0) {}
+
+                /**
+                 * The number of requests started.
+                 */
+                unsigned long long requestsStarted;
+
+                /**
+                 * The number of requests that completed with a response.
+                 */
+                unsigned long long requestsSucceeded;
+
+                /**
+                 * The number of requests that failed.
+                 */
+                unsigned long long requestsFailed;
+
+                /**
+                 * The number of successful requests whose latency was excluded due to local event loop lag.
+                 */
+                unsigned long long latencySamplesExcluded;
+
+                /**
+                 * The number of conditional requests answered with a not modified response.
+                 */
+                unsigned long long responsesNotModified;
+
+                /**
+                 * The number of requests serviced by a fetch shared with another monitor.
+                 */
+                unsigned long long requestsCoalesced;
+
+                /**
+                 * The number of network replies currently in flight.
+                 */
+                long long repliesInFlight;
+
+                /**
+                 * The combined latency histogram counts.
+                 */
+                LatencyHistogram::Counts latency;
+        };
+
+        ThreadMetrics();
+
+        ~ThreadMetrics() = default;
+
+        /**
+         * Method you can call when a request is started.
+         */
+        inline void requestStarted() {
+            increment(currentRequestsStarted);
+            increment(currentRepliesInFlight);
+        }
+
+        /**
+         * Method you can call when a request completes with a response.
+         *
+         * \param[in] microseconds The request latency, in microseconds.
+         */
+        inline void requestSucceeded(unsigned long long microseconds) {
+            increment(currentRequestsSucceeded);
+            decrement(currentRepliesInFlight);
+            currentLatency.record(microseconds);
+        }
+
+        /**
+         * Method you can call when a request completes with a response but the latency was excluded because the
+         * thread was saturated while the request was in flight.
+         */
+        inline void requestSucceededWithoutLatency() {
+            increment(currentRequestsSucceeded);
+            increment(currentLatencySamplesExcluded);
+            decrement(currentRepliesInFlight);
+        }
+
+        /**
+         * Method you can call when a conditional request is answered with a not modified response.  The request must
+         * also be reported as succeeded.
+         */
+        inline void responseNotModified() {
+            increment(currentResponsesNotModified);
+        }
+
+        /**
+         * Method you can call when a request joins a fetch shared with another monitor.  The request must also be
+         * reported as started.
+         */
+        inline void requestCoalesced() {
+            increment(currentRequestsCoalesced);
+        }
+
+        /**
+         * Method you can call when a request fails.
+         */
+        inline void requestFailed() {
+            increment(currentRequestsFailed);
+            decrement(currentRepliesInFlight);
+        }
+
+        /**
+         * Method you can call when a request is abandoned without completing.
+         */
+        inline void requestAbandoned() {
+            decrement(currentRepliesInFlight);
+        }
+
+        /**
+         * Method you can use to add this thread's metrics to a set of totals.  This method can be called from any
+         * thread.
+         *
+         * \param[in,out] totals The totals to be updated.
+         */
+        void addTo(Totals& totals) const;
+
+    private:
+        /**
+         * Method that increments a single writer counter.
+         *
+         * \param[in,out] counter The counter to increment.
+         */
+        template<typename T> static inline void increment(std::atomic<T>& counter) {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        /**
+         * Method that decrements a single writer counter.
+         *
+         * \param[in,out] counter The counter to decrement.
+         */
+        template<typename T> static inline void decrement(std::atomic<T>& counter) {
+            counter.store(counter.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        }
+
+        /**
+         * The number of requests started.
+         */
+        std::atomic<unsigned long long> currentRequestsStarted;
+
+        /**
+         * The number of requests that completed with a response.
+         */
+        std::atomic<unsigned long long> currentRequestsSucceeded;
+
+        /**
+         * The number of requests that failed.
+         */
+        std::atomic<unsigned long long> currentRequestsFailed;
+
+        /**
+         * The number of latency samples excluded due to local event loop lag.
+         */
+        std::atomic<unsigned long long> currentLatencySamplesExcluded;
+
+        /**
+         * The number of conditional requests answered with a not modified response.
+         */
+        std::atomic<unsigned long long> currentResponsesNotModified;
+
+        /**
+         * The number of requests serviced by a fetch shared with another monitor.
+         */
+        std::atomic<unsigned long long> currentRequestsCoalesced;
+
+        /**
+         * The number of network replies currently in flight.
+         */
+        std::atomic<long long> currentRepliesInFlight;
+
+        /**
+         * The latency histogram.
+         */
+        LatencyHistogram currentLatency;
+};
+
+#endif
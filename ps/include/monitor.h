@@ -26,23 +26,29 @@
 #include <QObject>
 #include <QString>
 #include <QByteArray>
-#include <QElapsedTimer>
 #include <QList>
 #include <QMap>
-#include <QSslConfiguration>
+#include <QHash>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QMutex>
+#include <QNetworkRequest>
+#include <QSslCertificate>
 
 #include <cstdint>
 #include <chrono>
+#include <atomic>
 
-class QNetworkAccessManager;
-class QNetworkReply;
+#include "http_engine.h"
 
 class HostScheme;
+class ResponseBodyProcessor;
+class KeywordMatcher;
 
 /**
  * Class used to manage traffic related to tracking a single monitor.
  */
-class Monitor:public QObject {
+class Monitor:public QObject, public HttpEngine::Client {
     Q_OBJECT
 
     public:
@@ -192,6 +198,17 @@ class Monitor:public QObject {
          */
         static constexpr unsigned long maximumAllowedLatencyMicroseconds = 1000 * transferTimeout;
 
+        /**
+         * The default maximum number of response body bytes used for content checks.
+         */
+        static constexpr unsigned long defaultMaximumBodySize = 8 * 1024 * 1024;
+
+        /**
+         * The maximum time, in seconds, a monitor will rely on conditional requests before forcing a full fetch.  The
+         * full fetch guards against servers that report stale validators.
+         */
+        static constexpr unsigned long long conditionalRefreshSeconds = 3600;
+
         /**
          * Constructor.
          *
@@ -211,6 +228,8 @@ class Monitor:public QObject {
          *
          * \param[in] postContent          An array of byte data to be sent as the post message.
          *
+         * \param[in] maximumBodySize      The maximum number of response body bytes used for content checks.
+         *
          * \param[in] hostScheme           The host/scheme that monitor is related to.
          */
         Monitor(
@@ -222,6 +241,7 @@ class Monitor:public QObject {
             ContentType            contentType,
             const QString&         userAgent,
             const QByteArray&      postContent,
+            unsigned long          maximumBodySize = defaultMaximumBodySize,
             HostScheme*            hostScheme = nullptr
         );
 
@@ -234,6 +254,23 @@ class Monitor:public QObject {
          */
         MonitorStatus monitorStatus() const;
 
+        /**
+         * Method you can use to obtain the hash of the last content received for content change checks.
+         *
+         * \return Returns the last content hash.  An empty value is returned if no baseline has been established.
+         */
+        const QByteArray& contentHash() const;
+
+        /**
+         * Method you can use to restore state saved before this server was restarted.  This method must be called
+         * before the monitor is first checked.
+         *
+         * \param[in] monitorStatus The saved monitor status.
+         *
+         * \param[in] contentHash   The saved content hash.
+         */
+        void restoreState(MonitorStatus monitorStatus, const QByteArray& contentHash);
+
         /**
          * Method you can use to obtain the monitor ID.
          *
@@ -306,7 +343,8 @@ class Monitor:public QObject {
         const KeywordList& keywords() const;
 
         /**
-         * Method you can use to change the content check keyword list.
+         * Method you can use to change the content check keyword list.  The keywords are compiled into a matcher when
+         * this method is called.
          *
          * \param[in] newKeywordList The new list of content check keywords.
          */
@@ -354,6 +392,32 @@ class Monitor:public QObject {
          */
         void setPostContent(const QByteArray& newPostContent);
 
+        /**
+         * Method you can use to obtain the maximum number of response body bytes used for content checks.
+         *
+         * \return Returns the maximum body size, in bytes.
+         */
+        unsigned long maximumBodySize() const;
+
+        /**
+         * Method you can use to change the maximum number of response body bytes used for content checks.  Body
+         * data beyond this limit is discarded as it arrives.
+         *
+         * \param[in] newMaximumBodySize The new maximum body size, in bytes.
+         */
+        void setMaximumBodySize(unsigned long newMaximumBodySize);
+
+        /**
+         * Method you can use to update this monitor to match a newly received description of the same monitor.  The
+         * monitor status is retained.  The last content hash is discarded only if the settings that determine the
+         * content being compared have changed.
+         *
+         * \param[in] monitor The monitor holding the new settings.
+         *
+         * \return Returns true if any setting changed.  Returns false if the monitor was already up to date.
+         */
+        bool updateFrom(const Monitor* monitor);
+
         /**
          * Method you can use to convert a method value to a string.
          *
@@ -415,12 +479,8 @@ class Monitor:public QObject {
         static ContentType toContentType(const QString& str, bool* ok = nullptr);
 
         /**
-         * Method you can use to trigger this monitor from a different thread.
-         */
-        void startCheckFromDifferentThread();
-
-        /**
-         * Method you can use to specify a list of standard headers to include in all HTTP requests.
+         * Method you can use to specify a list of standard headers to include in all HTTP requests.  This method is
+         * thread safe.  Every monitor rebuilds its request template on its next check.
          *
          * \param[in] headers A set of key/value header pairs to include in every request.
          */
@@ -433,11 +493,45 @@ class Monitor:public QObject {
          */
         static Headers defaultHeaders();
 
-    signals:
         /**
-         * Signal that is emitted when a request has been made to start this monitor from another thread.
+         * Method you can use to enable or disable conditional requests.  When enabled, GET monitors using content
+         * match or smart content match remember the ETag and Last-Modified validators from the last full response
+         * and issue conditional requests.  A 304 response is treated as unchanged content.  This method is thread
+         * safe.
+         *
+         * \param[in] nowEnabled If true, conditional requests will be used.
+         */
+        static void setConditionalRequestsEnabled(bool nowEnabled);
+
+        /**
+         * Method you can use to determine if conditional requests are enabled.
+         *
+         * \return Returns true if conditional requests are enabled.
          */
-        void startCheckRequested();
+        static bool conditionalRequestsEnabled();
+
+        /**
+         * Method you can use to enable or disable headers-only fetches.  When enabled, monitors that perform no
+         * content check complete as soon as a successful status line and headers are received.  The latency is
+         * measured to the headers and the remainder of the body is either drained or, for large or unknown bodies,
+         * the transfer is aborted.  This method is thread safe.
+         *
+         * \param[in] nowEnabled If true, headers-only fetches will be used.
+         */
+        static void setHeadersOnlyFetchEnabled(bool nowEnabled);
+
+        /**
+         * Method you can use to determine if headers-only fetches are enabled.
+         *
+         * \return Returns true if headers-only fetches are enabled.
+         */
+        static bool headersOnlyFetchEnabled();
+
+        /**
+         * Method you can use to force this monitor to rebuild its request template on its next check.  You should
+         * call this method if the host/scheme URL changes.
+         */
+        void invalidateRequestTemplate();
 
     public slots:
         /**
@@ -450,33 +544,145 @@ class Monitor:public QObject {
          */
         void abort();
 
-    private slots:
         /**
-         * Slot that is triggered when a response or timeout is received.
+         * Slot you can trigger to discard any in-flight check without changing the monitor status.  This slot must
+         * be called from the monitor's thread.
          */
-        void responseReceived();
+        void cancelCheck();
 
     private:
         /**
-         * Verb used to send HTTP OPTIONS command.
+         * The HTTP status code indicating that a conditionally requested resource has not changed.
+         */
+        static constexpr int notModifiedStatusCode = 304;
+
+        /**
+         * The lowest HTTP status code reported as an error.
+         */
+        static constexpr int firstErrorStatusCode = 400;
+
+        /**
+         * The largest remaining body, in bytes, that a headers-only fetch will drain rather than abort.  Aborting
+         * closes the connection so small bodies are cheaper to read and discard.
+         */
+        static constexpr qlonglong maximumDrainedBodySize = 64 * 1024;
+
+        /**
+         * The ETag response header name.
+         */
+        static const QByteArray entityTagHeader;
+
+        /**
+         * The Last-Modified response header name.
+         */
+        static const QByteArray lastModifiedHeader;
+
+        /**
+         * The If-None-Match request header name.
+         */
+        static const QByteArray ifNoneMatchHeader;
+
+        /**
+         * The If-Modified-Since request header name.
+         */
+        static const QByteArray ifModifiedSinceHeader;
+
+        /**
+         * Type used to hold default headers in the form used by QNetworkRequest.
+         */
+        typedef QMap<QByteArray, QByteArray> RawHeaders;
+
+        /**
+         * Type used to share keyword matchers between monitors with identical keyword lists.
+         */
+        typedef QHash<KeywordList, QWeakPointer<const KeywordMatcher>> KeywordMatchersByKeywords;
+
+        /**
+         * Method that obtains a keyword matcher for a keyword list, sharing the matcher with any other monitor using
+         * the same keywords.  This method is thread safe.
+         *
+         * \param[in] keywords The keywords to be matched.
+         *
+         * \return Returns the shared keyword matcher.  A null pointer is returned if the keyword list is empty.
+         */
+        static QSharedPointer<const KeywordMatcher> sharedKeywordMatcher(const KeywordList& keywords);
+
+        /**
+         * Method that builds the request template used to dispatch checks.
+         *
+         * \param[in] hostScheme The host/scheme this monitor is tied to.
+         */
+        void buildRequestTemplate(const HostScheme* hostScheme);
+
+        /**
+         * Method that determines if the next check can be issued as a conditional request.
+         *
+         * \param[in] now The current Unix timestamp.
+         *
+         * \return Returns true if the next check should be a conditional request.
+         */
+        bool conditionalRequestAllowed(unsigned long long now) const;
+
+        /**
+         * Method that records the validators from a full response.
+         */
+        void updateValidators();
+
+        /**
+         * Method that discards any recorded validators so the next check performs a full fetch.
+         */
+        void clearValidators();
+
+        /**
+         * Method that is called by the HTTP engine when a new connection is established.  Connection setup is timed
+         * by the HTTP engine so this method does nothing.
+         *
+         * \param[in] request The pending request.
+         */
+        void requestConnected(HttpEngine::Request* request) override;
+
+        /**
+         * Method that is called by the HTTP engine when the response headers are received.  Used to complete
+         * headers-only fetches if the server's response indicates success.
+         *
+         * \param[in] request The pending request.
          */
-        static const QByteArray optionsVerb;
+        void requestHeadersReceived(HttpEngine::Request* request) override;
 
         /**
-         * Verb used to send HTTP PATCH command.
+         * Method that is called by the HTTP engine when response body data is available.
+         *
+         * \param[in] request The pending request.
          */
-        static const QByteArray patchVerb;
+        void requestDataAvailable(HttpEngine::Request* request) override;
+
+        /**
+         * Method that is called by the HTTP engine when a response or timeout is received.
+         *
+         * \param[in] request The pending request.
+         */
+        void requestFinished(HttpEngine::Request* request) override;
+
+        /**
+         * Method that reads any available response body data.
+         */
+        void readResponseData();
 
         /**
          * Method that is called when a valid response is received.
          *
          * \param[in] elapsedTimeNanoseconds The elapsed time, in nanoseconds.
          *
-         * \param[in] sslConfiguration       The SSL configuration.
+         * \param[in] request                The request that received the response.
+         *
+         * \param[in] latencyValid           If true, the elapsed time reflects the remote host.  If false, local
+         *                                   event loop lag may have inflated the elapsed time and no latency sample
+         *                                   is recorded.
          */
         void processValidResponse(
-            unsigned long long       elapsedTimeNanoseconds,
-            const QSslConfiguration& sslConfiguration
+            unsigned long long   elapsedTimeNanoseconds,
+            HttpEngine::Request* request,
+            bool                 latencyValid
         );
 
         /**
@@ -484,33 +690,54 @@ class Monitor:public QObject {
          */
         void processErrorResponse();
 
+        /**
+         * Method that records a successful request in the thread metrics.
+         *
+         * \param[in] elapsedTimeNanoseconds The elapsed time, in nanoseconds.
+         *
+         * \return Returns true if the elapsed time reflects the remote host.  Returns false if local event loop lag
+         *         may have inflated the elapsed time.
+         */
+        bool recordRequestSucceeded(unsigned long long elapsedTimeNanoseconds);
+
+        /**
+         * Method that converts a time in nanoseconds to microseconds, rounding to the nearest microsecond.
+         *
+         * \param[in] nanoseconds The time, in nanoseconds.
+         *
+         * \return Returns the time, in microseconds.
+         */
+        static inline std::uint32_t toMicroseconds(unsigned long long nanoseconds) {
+            return static_cast<std::uint32_t>((nanoseconds + 500) / 1000);
+        }
+
         /**
          * Method that is called to check for content change.
          *
-         * \param[in] receivedData The received payload data.
+         * \param[in] bodyProcessor The processor holding the results for the received payload.
          */
-        void checkContentChange(const QByteArray& receivedData);
+        void checkContentChange(const ResponseBodyProcessor& bodyProcessor);
 
         /**
          * Method that is called to check for any keyword.
          *
-         * \param[in] receivedData The received payload data.
+         * \param[in] bodyProcessor The processor holding the results for the received payload.
          */
-        void checkAnyKeywordMatch(const QByteArray& receivedData);
+        void checkAnyKeywordMatch(ResponseBodyProcessor& bodyProcessor);
 
         /**
          * Method that is called to check for all keywords match.
          *
-         * \param[in] receivedData The received payload data.
+         * \param[in] bodyProcessor The processor holding the results for the received payload.
          */
-        void checkAllKeywordMatch(const QByteArray& receivedData);
+        void checkAllKeywordMatch(ResponseBodyProcessor& bodyProcessor);
 
         /**
          * Method that is called to check for content change using smart content checking.
          *
-         * \param[in] receivedData The received payload data.
+         * \param[in] bodyProcessor The processor holding the buffered payload.
          */
-        void checkContentChangeSmart(const QByteArray& receivedData);
+        void checkContentChangeSmart(const ResponseBodyProcessor& bodyProcessor);
 
         /**
          * String indicating text content.
@@ -527,10 +754,40 @@ class Monitor:public QObject {
          */
         static const QByteArray applicationXmlContentType;
 
+        /**
+         * Mutex used to guard the default headers.
+         */
+        static QMutex defaultHeadersMutex;
+
         /**
          * Static header key/value pairs.
          */
-        static QMap<QByteArray, QByteArray> currentDefaultHeaders;
+        static QSharedPointer<const RawHeaders> currentDefaultHeaders;
+
+        /**
+         * Generation number for the default headers.  The value is incremented each time the headers change.
+         */
+        static std::atomic<unsigned> currentDefaultHeadersGeneration;
+
+        /**
+         * Flag indicating if conditional requests are enabled.
+         */
+        static std::atomic<bool> currentConditionalRequestsEnabled;
+
+        /**
+         * Flag indicating if headers-only fetches are enabled.
+         */
+        static std::atomic<bool> currentHeadersOnlyFetchEnabled;
+
+        /**
+         * Mutex used to guard the shared keyword matchers.
+         */
+        static QMutex keywordMatchersMutex;
+
+        /**
+         * Keyword matchers currently in use, by keyword list.
+         */
+        static KeywordMatchersByKeywords keywordMatchersByKeywords;
 
         /**
          * The monitor ID of this monitor.
@@ -557,6 +814,11 @@ class Monitor:public QObject {
          */
         KeywordList currentKeywords;
 
+        /**
+         * The matcher compiled from the content check keywords.  A null pointer is used if there are no keywords.
+         */
+        QSharedPointer<const KeywordMatcher> currentKeywordMatcher;
+
         /**
          * The current content type for this POST.
          */
@@ -572,6 +834,28 @@ class Monitor:public QObject {
          */
         QByteArray currentPostContent;
 
+        /**
+         * The maximum number of response body bytes used for content checks.
+         */
+        unsigned long currentMaximumBodySize;
+
+        /**
+         * The request used to dispatch checks.  Built on demand and reused until invalidated.
+         */
+        QNetworkRequest currentRequestTemplate;
+
+        /**
+         * The default header generation the request template was built from.  A value of 0 indicates that the
+         * template must be rebuilt.
+         */
+        unsigned requestTemplateGeneration;
+
+        /**
+         * The host/scheme SSL configuration generation applied to the request template.  A value of 0 indicates
+         * that the configuration must be applied.
+         */
+        unsigned sslSessionGeneration;
+
         /**
          * The last recorded monitor status.
          */
@@ -583,9 +867,35 @@ class Monitor:public QObject {
         QByteArray lastHash;
 
         /**
-         * Time point indicating the start of the current request.
+         * The ETag reported with the last full response.  The value is empty if no ETag was reported.
          */
-        QElapsedTimer elapsedTimer;
+        QByteArray validatorEntityTag;
+
+        /**
+         * The Last-Modified value reported with the last full response.  The value is empty if none was reported.
+         */
+        QByteArray validatorLastModified;
+
+        /**
+         * The Unix timestamp of the last full response that supplied validators.
+         */
+        unsigned long long validatorTimestamp;
+
+        /**
+         * Flag indicating if the pending request is a conditional request.
+         */
+        bool conditionalRequestPending;
+
+        /**
+         * Flag indicating that the pending request is a headers-only fetch.
+         */
+        bool headersOnlyCheck;
+
+        /**
+         * Flag indicating that the pending request was completed when its headers arrived and the response is only
+         * being drained.
+         */
+        bool checkCompletedAtHeaders;
 
         /**
          * The timestamp when this last request was started.
@@ -593,9 +903,19 @@ class Monitor:public QObject {
         unsigned long long startTimestamp;
 
         /**
-         * The current pending network reply.
+         * The event loop lag probe time when the current request was started.
+         */
+        unsigned long long lagProbeStartTime;
+
+        /**
+         * The current pending request.
+         */
+        HttpEngine::Request* pendingRequest;
+
+        /**
+         * The processor for the pending reply's body.  A null pointer is used when no content check is performed.
          */
-        QNetworkReply* pendingReply;
+        ResponseBodyProcessor* bodyProcessor;
 };
 
 #endif
@@ -0,0 +1,972 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref NativeHttpEngine class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef NATIVE_HTTP_ENGINE_H
+#define NATIVE_HTTP_ENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QHash>
+#include <QSet>
+#include <QUrl>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QNetworkRequest>
+#include <QSslCertificate>
+
+#include <openssl/ssl.h>
+
+#include "http_engine.h"
+
+class QSocketNotifier;
+class QTimer;
+
+class DnsCache;
+
+struct msghdr;
+
+/**
+ * HTTP/1.1 engine that drives non-blocking sockets from a single epoll instance.  TLS is provided by OpenSSL.
+ *
+ * Connections are kept alive and pooled by scheme, host and port.  TLS sessions are cached by the same key so new
+ * connections to a host can resume the previous session rather than performing a full handshake.  Hosts are
+ * resolved using the DNS cache, falling back to QHostInfo if the cache has no current entry.
+ *
+ * Redirects are followed unless they would move a secure request to an insecure scheme.  Responses are requested
+ * without content encoding.  This engine is only available on Linux.
+ *
+ * Sockets request kernel receive timestamps so the time to first byte and the completion time reflect when response
+ * data arrived rather than when the event loop got to it.  Connection setup and the TLS handshake are timed when
+ * their events are processed.
+ */
+class NativeHttpEngine:public QObject, public HttpEngine {
+    Q_OBJECT
+
+    public:
+        /**
+         * The maximum number of idle connections kept for a single scheme, host and port.
+         */
+        static constexpr int maximumIdleConnectionsPerHost = 4;
+
+        /**
+         * The time an idle connection is kept open, in milliseconds.
+         */
+        static constexpr unsigned long long idleConnectionTimeout = 30000;
+
+        /**
+         * The maximum number of TLS sessions cached.
+         */
+        static constexpr int maximumCachedSessions = 4096;
+
+        /**
+         * The maximum number of redirects followed by a single request.
+         */
+        static constexpr unsigned maximumRedirects = 50;
+
+        /**
+         * The time a request can go without any progress before it is failed, in milliseconds.  Used for requests
+         * that do not specify their own transfer timeout.
+         */
+        static constexpr unsigned long long defaultTransferTimeout = 60000;
+
+        /**
+         * Constructor
+         *
+         * \param[in] dnsCache The DNS cache used to resolve hosts.  A null pointer causes every host to be resolved
+         *                     using QHostInfo.
+         *
+         * \param[in] parent   Pointer to the parent object.
+         */
+        NativeHttpEngine(DnsCache* dnsCache, QObject* parent = nullptr);
+
+        /**
+         * Destructor.  All requests created by this engine must be deleted before the engine.
+         */
+        ~NativeHttpEngine() override;
+
+        /**
+         * Method you can use to determine if the engine was initialized successfully.
+         *
+         * \return Returns true if the engine can be used.
+         */
+        bool isValid() const;
+
+        /**
+         * Method you can use to obtain the backend implemented by this engine.
+         *
+         * \return Returns \ref HttpEngine::Backend::NATIVE.
+         */
+        Backend backend() const override;
+
+        /**
+         * Method you can use to start a request.  The client is never called from within this method.
+         *
+         * \param[in] client         The client to be notified of request events.
+         *
+         * \param[in] request        The request URL, headers and transfer timeout.
+         *
+         * \param[in] verb           The HTTP verb.
+         *
+         * \param[in] body           The request body.  An empty array indicates no body.
+         *
+         * \param[in] reportProgress If true, the client is told when the connection is established and when the
+         *                           response headers arrive.
+         *
+         * \return Returns the newly created request.  The caller takes ownership of the request.
+         */
+        Request* startRequest(
+            Client*                client,
+            const QNetworkRequest& request,
+            const QByteArray&      verb,
+            const QByteArray&      body,
+            bool                   reportProgress
+        ) override;
+
+    private slots:
+        /**
+         * Slot that is triggered when the epoll instance reports events.
+         */
+        void processEvents();
+
+        /**
+         * Slot that is triggered to dispatch newly started requests.
+         */
+        void processStartQueue();
+
+        /**
+         * Slot that is triggered to continue reading connections that exhausted their read budget.
+         */
+        void processPendingReads();
+
+        /**
+         * Slot that is triggered when a host lookup completes.
+         *
+         * \param[in] hostInfo The results of the lookup.
+         */
+        void hostLookedUp(const QHostInfo& hostInfo);
+
+        /**
+         * Slot that is triggered periodically to expire stalled requests and idle connections.
+         */
+        void sweep();
+
+        /**
+         * Slot that is triggered to delete closed connections.
+         */
+        void reapConnections();
+
+    private:
+        class NativeRequest;
+
+        /**
+         * The maximum number of events processed per call to epoll_wait.
+         */
+        static constexpr int maximumEvents = 64;
+
+        /**
+         * The size of each socket read, in bytes.
+         */
+        static constexpr int readChunkSize = 16384;
+
+        /**
+         * The maximum number of bytes read from a single connection before other connections are serviced.
+         */
+        static constexpr int readBudget = 4 * readChunkSize;
+
+        /**
+         * The maximum size of the response status line and headers, in bytes.
+         */
+        static constexpr int maximumHeaderSize = 64 * 1024;
+
+        /**
+         * The interval between sweeps for stalled requests and idle connections, in milliseconds.
+         */
+        static constexpr int sweepInterval = 1000;
+
+        /**
+         * Value returned by \ref NativeHttpEngine::receiveData when no data is currently available.
+         */
+        static constexpr int wouldBlock = -1;
+
+        /**
+         * Value returned by \ref NativeHttpEngine::receiveData when the connection reported an error.
+         */
+        static constexpr int receiveFailed = -2;
+
+        /**
+         * Type used to represent a header as a name/value pair.
+         */
+        typedef QPair<QByteArray, QByteArray> Header;
+
+        /**
+         * Type used to represent a list of headers.
+         */
+        typedef QList<Header> HeaderList;
+
+        /**
+         * Enumeration of connection states.
+         */
+        enum class ConnectionState {
+            /**
+             * Indicates the TCP connection is being established.
+             */
+            CONNECTING,
+
+            /**
+             * Indicates the TLS handshake is in progress.
+             */
+            HANDSHAKING,
+
+            /**
+             * Indicates the connection can carry requests.
+             */
+            OPEN
+        };
+
+        /**
+         * Enumeration of response parser states.
+         */
+        enum class ResponseState {
+            /**
+             * Indicates the status line and headers are being received.
+             */
+            HEADERS,
+
+            /**
+             * Indicates a body of known length is being received.
+             */
+            BODY_LENGTH,
+
+            /**
+             * Indicates a chunk size line is expected.
+             */
+            CHUNK_SIZE,
+
+            /**
+             * Indicates chunk data is being received.
+             */
+            CHUNK_DATA,
+
+            /**
+             * Indicates the line ending after chunk data is expected.
+             */
+            CHUNK_DATA_END,
+
+            /**
+             * Indicates the trailer following the last chunk is being received.
+             */
+            CHUNK_TRAILER,
+
+            /**
+             * Indicates the body ends when the remote host closes the connection.
+             */
+            BODY_UNTIL_CLOSE,
+
+            /**
+             * Indicates the response is complete.
+             */
+            COMPLETE
+        };
+
+        /**
+         * Class used to track a single connection.
+         */
+        class Connection {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] engine The engine that owns the connection.
+                 *
+                 * \param[in] key    The pool key for the connection.
+                 */
+                Connection(NativeHttpEngine* engine, const QString& key);
+
+                ~Connection();
+
+                /**
+                 * The engine that owns the connection.
+                 */
+                NativeHttpEngine* engine;
+
+                /**
+                 * The pool key, holding the scheme, host and port.
+                 */
+                QString key;
+
+                /**
+                 * The socket descriptor.  A negative value indicates no socket.
+                 */
+                int socketDescriptor;
+
+                /**
+                 * The TLS state.  A null pointer is used for insecure connections.
+                 */
+                SSL* ssl;
+
+                /**
+                 * The connection state.
+                 */
+                ConnectionState state;
+
+                /**
+                 * The epoll events currently registered for the socket.
+                 */
+                unsigned registeredEvents;
+
+                /**
+                 * The request currently using the connection.  A null pointer indicates an idle connection.
+                 */
+                NativeRequest* request;
+
+                /**
+                 * Received data that has not yet been parsed.
+                 */
+                QByteArray inbound;
+
+                /**
+                 * Data waiting to be sent.
+                 */
+                QByteArray outbound;
+
+                /**
+                 * The number of bytes of the outbound data already sent.
+                 */
+                int outboundOffset;
+
+                /**
+                 * The certificate presented by the remote host during the handshake.
+                 */
+                QSslCertificate peerCertificate;
+
+                /**
+                 * The time the connection became idle, in milliseconds.
+                 */
+                unsigned long long idleSince;
+
+                /**
+                 * The kernel receive timestamp of the most recently read data, in nanoseconds since the epoch.  A
+                 * value of 0 indicates no timestamp is available for the current request.
+                 */
+                unsigned long long receiveTime;
+
+                /**
+                 * Flag indicating the connection has carried a previous request.
+                 */
+                bool reused;
+
+                /**
+                 * Flag indicating the connection has been closed and is waiting to be deleted.
+                 */
+                bool closed;
+        };
+
+        /**
+         * Class used to track a single request.
+         */
+        class NativeRequest:public Request {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] engine         The engine servicing the request.
+                 *
+                 * \param[in] client         The client to be notified of request events.
+                 *
+                 * \param[in] request        The request URL, headers and transfer timeout.
+                 *
+                 * \param[in] verb           The HTTP verb.
+                 *
+                 * \param[in] body           The request body.
+                 *
+                 * \param[in] reportProgress If true, the client is told when the connection is established and
+                 *                           when the response headers arrive.
+                 */
+                NativeRequest(
+                    NativeHttpEngine*      engine,
+                    Client*                client,
+                    const QNetworkRequest& request,
+                    const QByteArray&      verb,
+                    const QByteArray&      body,
+                    bool                   reportProgress
+                );
+
+                ~NativeRequest() override;
+
+                /**
+                 * Method you can use to obtain the HTTP status code of the response.
+                 *
+                 * \return Returns the HTTP status code.  A value of 0 is returned if no response was received.
+                 */
+                int statusCode() const override;
+
+                /**
+                 * Method you can use to obtain a response header.
+                 *
+                 * \param[in] headerName The header name.  The name is matched without regard to case.
+                 *
+                 * \return Returns the header value.  An empty array is returned if the header is not present.
+                 */
+                QByteArray rawHeader(const QByteArray& headerName) const override;
+
+                /**
+                 * Method you can use to obtain the advertised length of the response body.
+                 *
+                 * \return Returns the content length, in bytes.  A negative value is returned if the length is not
+                 *         known.
+                 */
+                long long contentLength() const override;
+
+                /**
+                 * Method you can use to read all currently available response body data.  The data is handed over
+                 * without being copied.
+                 *
+                 * \return Returns the available data.
+                 */
+                QByteArray readAll() override;
+
+                /**
+                 * Method you can use to determine if the request failed.
+                 *
+                 * \return Returns true if the request failed or the server reported an error status.
+                 */
+                bool failed() const override;
+
+                /**
+                 * Method you can use to obtain a description of the failure.
+                 *
+                 * \return Returns a description of the failure.
+                 */
+                QString errorString() const override;
+
+                /**
+                 * Method you can use to obtain the certificate presented by the remote host.
+                 *
+                 * \return Returns the peer certificate.  A null certificate is returned for insecure connections.
+                 */
+                QSslCertificate peerCertificate() const override;
+
+                /**
+                 * Method you can use to determine if a TLS handshake was performed for this request.
+                 *
+                 * \return Returns true if a TLS handshake was performed.  Returns false for insecure connections and
+                 *         for requests sent over a reused connection.
+                 */
+                bool newHandshake() const override;
+
+                /**
+                 * Method you can use to obtain the TLS session ticket issued by the remote host.  The ticket can be
+                 * supplied to later requests through QSslConfiguration::setSessionTicket.
+                 *
+                 * \return Returns the session ticket.  An empty array is returned if no ticket was issued or if the
+                 *         engine maintains its own session cache.
+                 */
+                QByteArray sslSessionTicket() const override;
+
+                /**
+                 * The engine servicing the request.
+                 */
+                NativeHttpEngine* engine;
+
+                /**
+                 * The connection carrying the request.  A null pointer indicates no connection.
+                 */
+                Connection* connection;
+
+                /**
+                 * The current request URL.  Updated when a redirect is followed.
+                 */
+                QUrl url;
+
+                /**
+                 * The current HTTP verb.
+                 */
+                QByteArray verb;
+
+                /**
+                 * The request headers.
+                 */
+                HeaderList requestHeaders;
+
+                /**
+                 * The request body.
+                 */
+                QByteArray requestBody;
+
+                /**
+                 * Flag indicating if the client wants connection and header events.
+                 */
+                bool reportProgress;
+
+                /**
+                 * The time the request can go without progress, in milliseconds.
+                 */
+                unsigned long long transferTimeout;
+
+                /**
+                 * The time of the last progress on this request, in milliseconds.
+                 */
+                unsigned long long lastActivity;
+
+                /**
+                 * The number of redirects that can still be followed.
+                 */
+                unsigned redirectsRemaining;
+
+                /**
+                 * The host this request is waiting to have resolved.  The value is empty if no lookup is pending.
+                 */
+                QString awaitingLookup;
+
+                /**
+                 * Flag indicating the request has already been retried after a pooled connection failed.
+                 */
+                bool retried;
+
+                /**
+                 * Flag indicating any response data has been received on the current connection.
+                 */
+                bool responseStarted;
+
+                /**
+                 * The kernel receive timestamp of the first data of the current response, in nanoseconds since the
+                 * epoch.  A value of 0 indicates no timestamp is available.
+                 */
+                unsigned long long responseReceiveTime;
+
+                /**
+                 * The response parser state.
+                 */
+                ResponseState responseState;
+
+                /**
+                 * The response status code.
+                 */
+                int responseStatusCode;
+
+                /**
+                 * The response reason phrase.
+                 */
+                QByteArray reasonPhrase;
+
+                /**
+                 * The response headers.
+                 */
+                HeaderList responseHeaders;
+
+                /**
+                 * The number of body bytes still expected for the current body or chunk.
+                 */
+                long long bodyRemaining;
+
+                /**
+                 * Flag indicating the connection can be reused once the response is complete.
+                 */
+                bool keepAlive;
+
+                /**
+                 * Flag indicating the response is a redirect that will be followed.  The body is discarded.
+                 */
+                bool redirecting;
+
+                /**
+                 * Body data not yet read by the client.
+                 */
+                QByteArray responseBody;
+
+                /**
+                 * The certificate presented by the remote host.
+                 */
+                QSslCertificate currentPeerCertificate;
+
+                /**
+                 * Flag indicating a TLS handshake was performed for the request.
+                 */
+                bool handshakePerformed;
+
+                /**
+                 * Flag indicating the request failed.
+                 */
+                bool currentFailed;
+
+                /**
+                 * A description of the failure.
+                 */
+                QString currentErrorString;
+        };
+
+        /**
+         * Type used to hold a list of connections.
+         */
+        typedef QList<Connection*> ConnectionList;
+
+        /**
+         * OpenSSL callback that is triggered when a new TLS session is established.
+         *
+         * \param[in] ssl     The TLS state of the connection.
+         *
+         * \param[in] session The new session.
+         *
+         * \return Returns 1 to indicate that the engine has taken a reference to the session.
+         */
+        static int newSessionCallback(SSL* ssl, SSL_SESSION* session);
+
+        /**
+         * Method that obtains the current engine time.
+         *
+         * \return Returns the current engine time, in milliseconds.
+         */
+        unsigned long long currentTime() const;
+
+        /**
+         * Method that dispatches a request on a pooled or new connection.
+         *
+         * \param[in] request     The request to be dispatched.
+         *
+         * \param[in] allowPooled If true, an idle pooled connection may be used.
+         */
+        void beginRequest(NativeRequest* request, bool allowPooled = true);
+
+        /**
+         * Method that opens a new connection for a request.
+         *
+         * \param[in] request The request.
+         *
+         * \param[in] address The address of the remote host.
+         */
+        void connectTo(NativeRequest* request, const QHostAddress& address);
+
+        /**
+         * Method that ties a request to a connection.
+         *
+         * \param[in] request    The request.
+         *
+         * \param[in] connection The connection.
+         */
+        void attach(NativeRequest* request, Connection* connection);
+
+        /**
+         * Method that is called when a non-blocking connect completes.
+         *
+         * \param[in] connection The connection.
+         */
+        void connectCompleted(Connection* connection);
+
+        /**
+         * Method that starts or continues the TLS handshake.
+         *
+         * \param[in] connection The connection.
+         */
+        void continueHandshake(Connection* connection);
+
+        /**
+         * Method that is called when a connection is ready to carry its first request.
+         *
+         * \param[in] connection The connection.
+         */
+        void connectionEstablished(Connection* connection);
+
+        /**
+         * Method that serializes and sends the request tied to a connection.
+         *
+         * \param[in] connection The connection.
+         */
+        void sendRequest(Connection* connection);
+
+        /**
+         * Method that sends as much pending outbound data as the socket will accept.
+         *
+         * \param[in] connection The connection.
+         */
+        void flushOutbound(Connection* connection);
+
+        /**
+         * Method that reads and processes data from a connection.
+         *
+         * \param[in] connection The connection.
+         */
+        void connectionReadable(Connection* connection);
+
+        /**
+         * Method that reads from a connection.
+         *
+         * \param[in]  connection   The connection.
+         *
+         * \param[in]  buffer       The buffer to receive the data.
+         *
+         * \param[in]  size         The size of the buffer, in bytes.
+         *
+         * \param[out] errorMessage A description of the error, populated on failure.
+         *
+         * \return Returns the number of bytes read, 0 if the remote host closed the connection,
+         *         \ref NativeHttpEngine::wouldBlock or \ref NativeHttpEngine::receiveFailed.
+         */
+        int receiveData(Connection* connection, char* buffer, int size, QString& errorMessage);
+
+        /**
+         * Method that peeks at a secure connection's socket to obtain the kernel receive timestamp of the data that
+         * OpenSSL will read next.  The timestamp is left unchanged if no data is waiting.
+         *
+         * \param[in] connection The connection.
+         */
+        void peekReceiveTime(Connection* connection);
+
+        /**
+         * Method that extracts the kernel receive timestamp from a received message.
+         *
+         * \param[in] message The message returned by recvmsg.
+         *
+         * \return Returns the receive timestamp, in nanoseconds since the epoch.  A value of 0 is returned if the
+         *         message carries no timestamp.
+         */
+        static unsigned long long receiveTimestamp(msghdr* message);
+
+        /**
+         * Method that calculates how long ago data with a given kernel receive timestamp arrived.
+         *
+         * \param[in] receiveTime The receive timestamp, in nanoseconds since the epoch.
+         *
+         * \return Returns the time since the data arrived, in nanoseconds.  A value of 0 is returned if the timestamp
+         *         is 0 or lies in the future.
+         */
+        static unsigned long long receiveDelay(unsigned long long receiveTime);
+
+        /**
+         * Method that parses buffered response data.
+         *
+         * \param[in] connection The connection.
+         */
+        void processInbound(Connection* connection);
+
+        /**
+         * Method that parses the response status line and headers, if they have been fully received.
+         *
+         * \param[in] connection The connection.
+         *
+         * \return Returns true if parsing should continue.
+         */
+        bool parseHeaders(Connection* connection);
+
+        /**
+         * Method that hands body data to a request's client.
+         *
+         * \param[in] connection The connection.
+         *
+         * \param[in] data       The body data.
+         *
+         * \return Returns true if the request is still tied to the connection.
+         */
+        bool deliverBody(Connection* connection, const QByteArray& data);
+
+        /**
+         * Method that is called when the response tied to a connection is complete.
+         *
+         * \param[in] connection The connection.
+         */
+        void finishResponse(Connection* connection);
+
+        /**
+         * Method that follows a redirect.
+         *
+         * \param[in] request The request to be redirected.
+         */
+        void followRedirect(NativeRequest* request);
+
+        /**
+         * Method that is called when a connection reports an error or is closed by the remote host.  Requests sent
+         * over a reused connection that never received a response are retried on a new connection.
+         *
+         * \param[in] connection   The connection.
+         *
+         * \param[in] errorMessage A description of the error.
+         */
+        void connectionFailed(Connection* connection, const QString& errorMessage);
+
+        /**
+         * Method that fails a request.
+         *
+         * \param[in] request      The request.
+         *
+         * \param[in] errorMessage A description of the error.
+         */
+        void failRequest(NativeRequest* request, const QString& errorMessage);
+
+        /**
+         * Method that reports a completed request to its client.
+         *
+         * \param[in] request The request.
+         */
+        void reportFinished(NativeRequest* request);
+
+        /**
+         * Method that returns a connection to the pool or closes it.
+         *
+         * \param[in] connection The connection.
+         *
+         * \param[in] reusable   If true, the connection can carry further requests.
+         */
+        void releaseConnection(Connection* connection, bool reusable);
+
+        /**
+         * Method that closes a connection.  The connection is deleted once control returns to the event loop.
+         *
+         * \param[in] connection The connection.
+         */
+        void closeConnection(Connection* connection);
+
+        /**
+         * Method that updates the epoll events registered for a connection.
+         *
+         * \param[in] connection The connection.
+         *
+         * \param[in] events     The desired epoll events.
+         */
+        void updateEvents(Connection* connection, unsigned events);
+
+        /**
+         * Method that starts the sweep timer if it is not already running.
+         */
+        void startSweeping();
+
+        /**
+         * Method that is called when a request is deleted.
+         *
+         * \param[in] request The request.
+         */
+        void requestDestroyed(NativeRequest* request);
+
+        /**
+         * Method that caches a TLS session.
+         *
+         * \param[in] key     The pool key the session belongs to.
+         *
+         * \param[in] session The session.  The engine takes over the caller's reference.
+         */
+        void storeSession(const QString& key, SSL_SESSION* session);
+
+        /**
+         * Method that locates a header in a header list.
+         *
+         * \param[in] headers    The headers to be searched.
+         *
+         * \param[in] headerName The header name, in lower case.
+         *
+         * \return Returns the header value.  An empty array is returned if the header is not present.
+         */
+        static QByteArray findHeader(const HeaderList& headers, const QByteArray& headerName);
+
+        /**
+         * The DNS cache used to resolve hosts.
+         */
+        DnsCache* currentDnsCache;
+
+        /**
+         * The epoll descriptor.
+         */
+        int epollDescriptor;
+
+        /**
+         * The OpenSSL context used for secure connections.
+         */
+        SSL_CTX* sslContext;
+
+        /**
+         * Notifier triggered when the epoll instance has events.
+         */
+        QSocketNotifier* notifier;
+
+        /**
+         * Timer used to dispatch newly started requests.
+         */
+        QTimer* startTimer;
+
+        /**
+         * Timer used to continue reads that exhausted their read budget.
+         */
+        QTimer* pendingReadTimer;
+
+        /**
+         * Timer used to expire stalled requests and idle connections.
+         */
+        QTimer* sweepTimer;
+
+        /**
+         * Timer used to delete closed connections.
+         */
+        QTimer* reapTimer;
+
+        /**
+         * Clock used to measure timeouts.
+         */
+        QElapsedTimer clock;
+
+        /**
+         * Requests waiting to be dispatched.
+         */
+        QList<NativeRequest*> startQueue;
+
+        /**
+         * Requests that have been dispatched and have not finished.
+         */
+        QSet<NativeRequest*> activeRequests;
+
+        /**
+         * Requests waiting for a host lookup, by host name.
+         */
+        QHash<QString, QList<NativeRequest*>> requestsAwaitingLookup;
+
+        /**
+         * Host names of pending lookups, by lookup ID.
+         */
+        QHash<int, QString> hostNamesByLookupId;
+
+        /**
+         * Every open connection.
+         */
+        QSet<Connection*> connections;
+
+        /**
+         * Idle connections, by pool key.  The most recently used connection is last.
+         */
+        QHash<QString, ConnectionList> idleConnectionsByKey;
+
+        /**
+         * Connections that exhausted their read budget with data still available.
+         */
+        ConnectionList pendingReadConnections;
+
+        /**
+         * Closed connections waiting to be deleted.
+         */
+        ConnectionList deadConnections;
+
+        /**
+         * Cached TLS sessions, by pool key.
+         */
+        QHash<QString, SSL_SESSION*> sessionsByKey;
+};
+
+#endif
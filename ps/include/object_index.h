@@ -0,0 +1,357 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref ObjectIndex class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef OBJECT_INDEX_H
+#define OBJECT_INDEX_H
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+#include <cstdint>
+
+#include "monitor.h"
+#include "host_scheme.h"
+#include "customer.h"
+
+class HttpServiceThread;
+
+/**
+ * Class that provides a process-wide index of customers, host/schemes, and monitors by ID.  The index is split into
+ * a fixed number of independently locked shards so that lookups never contend with the service threads or with each
+ * other.  Lookups take only a shared lock on a single shard.
+ *
+ * The index is maintained by the \ref HttpServiceThread instances as objects are added and removed.  As the service
+ * threads apply changes from their command queues, removals by object only take effect while the index still refers
+ * to that object so a late removal never drops a replacement.  All methods are thread safe.
+ */
+class ObjectIndex {
+    public:
+        ObjectIndex();
+
+        ~ObjectIndex();
+
+        /**
+         * Method you can use to add or replace a customer in the index.
+         *
+         * \param[in] customer      The customer to be added.
+         *
+         * \param[in] serviceThread The service thread that owns the customer.
+         */
+        void insertCustomer(Customer* customer, HttpServiceThread* serviceThread);
+
+        /**
+         * Method you can use to remove a customer from the index.
+         *
+         * \param[in] customerId The ID of the customer to be removed.
+         */
+        void removeCustomer(Customer::CustomerId customerId);
+
+        /**
+         * Method you can use to remove a customer from the index if the index still refers to the customer and
+         * service thread.
+         *
+         * \param[in] customer      The customer to be removed.
+         *
+         * \param[in] serviceThread The service thread that owns the customer.
+         */
+        void removeCustomer(Customer* customer, HttpServiceThread* serviceThread);
+
+        /**
+         * Method you can use to obtain a customer by customer ID.
+         *
+         * \param[in] customerId The ID of the customer of interest.
+         *
+         * \return Returns the desired customer.  A null pointer is returned if the customer is not known.
+         */
+        Customer* customer(Customer::CustomerId customerId) const;
+
+        /**
+         * Method you can use to obtain the service thread that owns a customer.
+         *
+         * \param[in] customerId The ID of the customer of interest.
+         *
+         * \return Returns the service thread owning the customer.  A null pointer is returned if the customer is not
+         *         known.
+         */
+        HttpServiceThread* customerServiceThread(Customer::CustomerId customerId) const;
+
+        /**
+         * Method you can use to add or replace a host/scheme in the index.
+         *
+         * \param[in] hostScheme The host/scheme to be added.
+         */
+        void insertHostScheme(HostScheme* hostScheme);
+
+        /**
+         * Method you can use to remove a host/scheme from the index if the index still refers to the host/scheme.
+         *
+         * \param[in] hostScheme The host/scheme to be removed.
+         */
+        void removeHostScheme(HostScheme* hostScheme);
+
+        /**
+         * Method you can use to obtain a host/scheme by host/scheme ID.
+         *
+         * \param[in] hostSchemeId The ID of the host/scheme of interest.
+         *
+         * \return Returns the desired host/scheme.  A null pointer is returned if the host/scheme is not known.
+         */
+        HostScheme* hostScheme(HostScheme::HostSchemeId hostSchemeId) const;
+
+        /**
+         * Method you can use to add or replace a monitor in the index.
+         *
+         * \param[in] monitor The monitor to be added.
+         */
+        void insertMonitor(Monitor* monitor);
+
+        /**
+         * Method you can use to remove a monitor from the index if the index still refers to the monitor.
+         *
+         * \param[in] monitor The monitor to be removed.
+         */
+        void removeMonitor(Monitor* monitor);
+
+        /**
+         * Method you can use to obtain a monitor by monitor ID.
+         *
+         * \param[in] monitorId The ID of the monitor of interest.
+         *
+         * \return Returns the desired monitor.  A null pointer is returned if the monitor is not known.
+         */
+        Monitor* monitor(Monitor::MonitorId monitorId) const;
+
+        /**
+         * Method you can use to determine the number of monitors in the index.
+         *
+         * \return Returns the number of indexed monitors.
+         */
+        unsigned long numberMonitors() const;
+
+    private:
+        /**
+         * The log2 of the number of shards per table.
+         */
+        static constexpr unsigned shardBits = 6;
+
+        /**
+         * The number of shards per table.
+         */
+        static constexpr unsigned numberShards = 1U << shardBits;
+
+        /**
+         * Template class that provides a sharded hash table keyed by 32-bit ID.
+         *
+         * \param T The type of value stored in the table.
+         */
+        template<typename T> class ShardedHash {
+            public:
+                /**
+                 * Method you can use to add or replace a value.
+                 *
+                 * \param[in] id    The ID to store the value under.
+                 *
+                 * \param[in] value The value to be stored.
+                 */
+                inline void insert(std::uint32_t id, const T& value) {
+                    Shard& shard = shards[shardIndex(id)];
+                    QWriteLocker locker(&shard.lock);
+                    shard.values.insert(id, value);
+                }
+
+                /**
+                 * Method you can use to remove a value.
+                 *
+                 * \param[in] id The ID of the value to be removed.
+                 */
+                inline void remove(std::uint32_t id) {
+                    Shard& shard = shards[shardIndex(id)];
+                    QWriteLocker locker(&shard.lock);
+                    shard.values.remove(id);
+                }
+
+                /**
+                 * Method you can use to remove a value if the ID still maps to that value.
+                 *
+                 * \param[in] id    The ID of the value to be removed.
+                 *
+                 * \param[in] value The value expected under the ID.
+                 */
+                inline void remove(std::uint32_t id, const T& value) {
+                    Shard& shard = shards[shardIndex(id)];
+                    QWriteLocker locker(&shard.lock);
+
+                    typename QHash<std::uint32_t, T>::iterator it = shard.values.find(id);
+                    if (it != shard.values.end() && it.value() == value) {
+                        shard.values.erase(it);
+                    }
+                }
+
+                /**
+                 * Method you can use to obtain a value.
+                 *
+                 * \param[in] id The ID of the value of interest.
+                 *
+                 * \return Returns the value.  A default constructed value is returned if the ID is not known.
+                 */
+                inline T value(std::uint32_t id) const {
+                    const Shard& shard = shards[shardIndex(id)];
+                    QReadLocker locker(&shard.lock);
+                    return shard.values.value(id);
+                }
+
+                /**
+                 * Method you can use to determine the number of values in the table.  Shards are locked one at a
+                 * time so the result is approximate while the table is being updated.
+                 *
+                 * \return Returns the number of values.
+                 */
+                inline unsigned long size() const {
+                    unsigned long result = 0;
+                    for (unsigned i=0 ; i<numberShards ; ++i) {
+                        QReadLocker locker(&shards[i].lock);
+                        result += static_cast<unsigned long>(shards[i].values.size());
+                    }
+
+                    return result;
+                }
+
+            private:
+                /**
+                 * A single independently locked shard.
+                 */
+                struct Shard {
+                    /**
+                     * Lock protecting this shard.
+                     */
+                    mutable QReadWriteLock lock;
+
+                    /**
+                     * The values held in this shard.
+                     */
+                    QHash<std::uint32_t, T> values;
+                };
+
+                /**
+                 * Method that selects the shard for an ID.  IDs are assigned sequentially so a multiplicative hash is
+                 * used to keep neighbouring IDs from piling into the same cache lines.
+                 *
+                 * \param[in] id The ID of interest.
+                 *
+                 * \return Returns the zero based shard index.
+                 */
+                static inline unsigned shardIndex(std::uint32_t id) {
+                    return static_cast<std::uint32_t>(id * 0x9E3779B1U) >> (32 - shardBits);
+                }
+
+                /**
+                 * The shards.
+                 */
+                Shard shards[numberShards];
+        };
+
+        /**
+         * Class used to track a customer along with the thread that owns it.
+         */
+        class CustomerEntry {
+            public:
+                constexpr CustomerEntry():currentCustomer(nullptr),currentServiceThread(nullptr) {}
+
+                /**
+                 * Constructor.
+                 *
+                 * \param[in] customer      The customer.
+                 *
+                 * \param[in] serviceThread The service thread that owns the customer.
+                 */
+                constexpr CustomerEntry(
+                        Customer*          customer,
+                        HttpServiceThread* serviceThread
+                    ):currentCustomer(
+                        customer
+                    ),currentServiceThread(
+                        serviceThread
+                    ) {}
+
+                /**
+                 * Method you can use to obtain the customer.
+                 *
+                 * \return Returns the customer.
+                 */
+                inline Customer* customer() const {
+                    return currentCustomer;
+                }
+
+                /**
+                 * Method you can use to obtain the service thread.
+                 *
+                 * \return Returns the service thread that owns the customer.
+                 */
+                inline HttpServiceThread* serviceThread() const {
+                    return currentServiceThread;
+                }
+
+                /**
+                 * Comparison operator.
+                 *
+                 * \param[in] other The instance to compare against.
+                 *
+                 * \return Returns true if both entries refer to the same customer and service thread.
+                 */
+                inline bool operator==(const CustomerEntry& other) const {
+                    return (
+                           currentCustomer == other.currentCustomer
+                        && currentServiceThread == other.currentServiceThread
+                    );
+                }
+
+            private:
+                /**
+                 * The customer.
+                 */
+                Customer* currentCustomer;
+
+                /**
+                 * The service thread that owns the customer.
+                 */
+                HttpServiceThread* currentServiceThread;
+        };
+
+        /**
+         * Customers by customer ID.
+         */
+        ShardedHash<CustomerEntry> customers;
+
+        /**
+         * Host/schemes by host/scheme ID.
+         */
+        ShardedHash<HostScheme*> hostSchemes;
+
+        /**
+         * Monitors by monitor ID.
+         */
+        ShardedHash<Monitor*> monitors;
+};
+
+#endif
@@ -34,10 +34,12 @@
 #include "customer.h"
 #include "host_scheme.h"
 #include "service_thread.h"
+#include "thread_affinity.h"
 
 class QLocalSocket;
 class HttpServiceThread;
 class PingServiceThreadPrivate;
+class DnsCache;
 
 /**
  * Class that manages ping services.
@@ -51,18 +53,24 @@ class PingServiceThread:public ServiceThread {
         /**
          * Constructor.
          *
-         * \param[in] parent Pointer to the parent object.
+         * \param[in] dnsCache The DNS cache used to resolve host names before handing them to the pinger.
+         *
+         * \param[in] parent   Pointer to the parent object.
          */
-        PingServiceThread(QObject* parent = nullptr);
+        PingServiceThread(DnsCache* dnsCache, QObject* parent = nullptr);
 
         ~PingServiceThread() override;
 
         /**
          * Method you can use to connect to the pinger.
          *
-         * \param[in] socketName The name of the local Linux socket.
+         * \param[in] socketName   The name of the local Linux socket.
+         *
+         * \param[in] pingerWindow The maximum number of pinger commands that can be outstanding at once.
+         *
+         * \param[in] sharedMemory If true, the shared memory ring transport will be negotiated with the pinger.
          */
-        void connect(const QString& socketName);
+        void connect(const QString& socketName, unsigned pingerWindow = 1, bool sharedMemory = false);
 
         /**
          * Method you can use to determine the number of hosts tied to this ping server.
@@ -98,13 +106,60 @@ class PingServiceThread:public ServiceThread {
          */
         void removeCustomer(Customer::CustomerId customerId);
 
+        /**
+         * Method you can use to hand a customer's hosts to a different HTTP service thread.  The hosts remain
+         * registered with the pinger.
+         *
+         * \param[in] customerId        The zero based ID of the customer that was moved.
+         *
+         * \param[in] httpServiceThread The service thread now managing the customer.
+         */
+        void moveCustomer(Customer::CustomerId customerId, HttpServiceThread* httpServiceThread);
+
+        /**
+         * Method you can use to pin this thread to a set of CPUs.  The affinity is applied from within this thread.
+         *
+         * \param[in] cpus The CPUs this thread may run on.  An empty list allows the thread to run on any CPU.
+         */
+        void setCpuAffinity(const ThreadAffinity::CpuList& cpus);
+
+        /**
+         * Method you can use to obtain the most recent ping round trip time reported for a host.
+         *
+         * \param[in] hostSchemeId The host/scheme ID of the host.
+         *
+         * \return Returns the most recent round trip time, in microseconds.  A value of 0 is returned if no round
+         *         trip time has been reported.
+         */
+        unsigned long roundTripMicroseconds(HostScheme::HostSchemeId hostSchemeId) const;
+
+        /**
+         * Method you can use to determine the number of pinger commands waiting to be issued.  This method is thread
+         * safe.
+         *
+         * \return Returns the number of pending pinger commands.
+         */
+        unsigned long numberPendingCommands() const;
+
+        /**
+         * Method you can use to determine the number of pinger commands issued but not yet acknowledged by the
+         * pinger.  This method is thread safe.
+         *
+         * \return Returns the number of in-flight pinger commands.
+         */
+        unsigned long numberInFlightCommands() const;
+
     signals:
         /**
          * Signal that is used to perform connections across threads.
          *
-         * \param[in] socketName The socket name to connect to.
+         * \param[in] socketName   The socket name to connect to.
+         *
+         * \param[in] pingerWindow The maximum number of pinger commands that can be outstanding at once.
+         *
+         * \param[in] sharedMemory If true, the shared memory ring transport will be negotiated with the pinger.
          */
-        void connectToPinger(const QString& socketName);
+        void connectToPinger(const QString& socketName, unsigned pingerWindow = 1, bool sharedMemory = false);
 
     public slots:
         /**
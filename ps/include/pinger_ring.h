@@ -0,0 +1,368 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref PingerRing class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef PINGER_RING_H
+#define PINGER_RING_H
+
+#include <QByteArray>
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Class that provides a pair of single-producer/single-consumer rings in shared memory, used to exchange fixed size
+ * binary records with the pinger.  The outbound ring carries commands from the polling server to the pinger.  The
+ * inbound ring carries command responses and ping results from the pinger back to the polling server.
+ *
+ * The shared memory region is an anonymous memory file.  Each ring has an eventfd used by the producer to wake the
+ * consumer.  The memory file and both eventfds are handed to the pinger over the existing local socket using
+ * SCM_RIGHTS.
+ *
+ * The shared memory region starts with a \ref PingerRing::RegionHeader followed by the outbound ring and then the
+ * inbound ring.  Each ring consists of a consumer index and a producer index, on separate cache lines, followed by
+ * \ref PingerRing::capacity records.  Indexes are free-running 64-bit counters.
+ *
+ * An instance must only be used by a single thread.
+ */
+class PingerRing {
+    public:
+        /**
+         * The number of records held by each ring.  Value must be a power of 2.
+         */
+        static constexpr unsigned long capacity = 4096;
+
+        /**
+         * The maximum length of the name field in a record, in bytes.
+         */
+        static constexpr unsigned maximumNameLength = 256;
+
+        /**
+         * The region magic number, "PSPR".
+         */
+        static constexpr std::uint32_t magicNumber = 0x52505350;
+
+        /**
+         * The region layout version.
+         */
+        static constexpr std::uint16_t layoutVersion = 1;
+
+        /**
+         * Enumeration of supported record types.
+         */
+        enum class RecordType : std::uint8_t {
+            /**
+             * Outbound command to add a host.  The name field holds the server name or address.
+             */
+            ADD = 1,
+
+            /**
+             * Outbound command to remove a host.
+             */
+            REMOVE = 2,
+
+            /**
+             * Outbound command to mark a host as defunct.
+             */
+            DEFUNCT = 3,
+
+            /**
+             * Inbound response indicating that a command completed.
+             */
+            OK = 16,
+
+            /**
+             * Inbound response indicating that a command was rejected.  The name field holds the error message.
+             */
+            ERROR = 17,
+
+            /**
+             * Inbound response indicating that a command failed and should be retried.  The name field holds the
+             * error message.
+             */
+            FAILED = 18,
+
+            /**
+             * Inbound report indicating that a host has stopped responding to pings.
+             */
+            NOPING = 19,
+
+            /**
+             * Inbound report of a successful ping.  The value field holds the round trip time, in microseconds.
+             */
+            PING_RESULT = 20
+        };
+
+        /**
+         * The header placed at the start of the shared memory region.
+         */
+        struct RegionHeader {
+            /**
+             * The region magic number.
+             */
+            std::uint32_t magic;
+
+            /**
+             * The region layout version.
+             */
+            std::uint16_t version;
+
+            /**
+             * The size of each record, in bytes.
+             */
+            std::uint16_t recordSize;
+
+            /**
+             * The number of records in each ring.
+             */
+            std::uint32_t capacity;
+
+            /**
+             * Reserved for future use.  Set to zero.
+             */
+            std::uint32_t reserved;
+        } __attribute__((packed));
+
+        /**
+         * A single fixed size record.
+         */
+        struct Record {
+            /**
+             * The record type.
+             */
+            RecordType type;
+
+            /**
+             * Reserved for future use.  Set to zero.
+             */
+            std::uint8_t reserved;
+
+            /**
+             * The number of valid bytes in the name field.
+             */
+            std::uint16_t nameLength;
+
+            /**
+             * The command sequence number.  Responses carry the sequence number of the command they refer to.
+             */
+            std::uint32_t sequenceNumber;
+
+            /**
+             * The host/scheme ID of the host the record refers to.
+             */
+            std::uint32_t hostId;
+
+            /**
+             * A record specific value.
+             */
+            std::uint32_t value;
+
+            /**
+             * The server name, address or error message, not NUL terminated.
+             */
+            char name[maximumNameLength];
+        } __attribute__((packed));
+
+        PingerRing();
+
+        ~PingerRing();
+
+        /**
+         * Method you can use to create the shared memory region and eventfds.  Any previously opened region is closed.
+         *
+         * \return Returns true on success.  Returns false on error.
+         */
+        bool open();
+
+        /**
+         * Method you can use to release the shared memory region and eventfds.
+         */
+        void close();
+
+        /**
+         * Method you can use to determine if the rings are open.
+         *
+         * \return Returns true if the rings are open.  Returns false if the rings are closed.
+         */
+        inline bool isOpen() const {
+            return currentRegion != nullptr;
+        }
+
+        /**
+         * Method you can use to obtain the eventfd signalled when inbound records are available.
+         *
+         * \return Returns the inbound eventfd.  A negative value is returned if the rings are closed.
+         */
+        inline int inboundDescriptor() const {
+            return currentInboundEventDescriptor;
+        }
+
+        /**
+         * Method you can use to send the shared memory region and eventfds to the pinger.  The descriptors are sent,
+         * in the order memory file, outbound eventfd, inbound eventfd, as ancillary data along with a message.
+         *
+         * \param[in] socketDescriptor The descriptor of the local socket connected to the pinger.
+         *
+         * \param[in] message          The message to send with the descriptors.
+         *
+         * \return Returns true on success.  Returns false on error.
+         */
+        bool sendDescriptors(int socketDescriptor, const QByteArray& message) const;
+
+        /**
+         * Method you can use to determine the number of free records in the outbound ring.
+         *
+         * \return Returns the number of records that can be written without blocking.
+         */
+        unsigned long outboundAvailable() const;
+
+        /**
+         * Method you can use to append a record to the outbound ring.  The pinger is not notified until
+         * \ref PingerRing::notifyPinger is called.
+         *
+         * \param[in] record The record to be appended.
+         *
+         * \return Returns true on success.  Returns false if the ring is full.
+         */
+        bool write(const Record& record);
+
+        /**
+         * Method you can use to wake the pinger after records have been written.
+         */
+        void notifyPinger();
+
+        /**
+         * Method you can use to clear the inbound eventfd before draining the inbound ring.
+         */
+        void acknowledgeWakeup();
+
+        /**
+         * Method you can use to read a batch of records from the inbound ring.
+         *
+         * \param[out] records         Array to receive the records.
+         *
+         * \param[in]  maximumRecords  The maximum number of records to read.
+         *
+         * \return Returns the number of records read.
+         */
+        unsigned long read(Record* records, unsigned long maximumRecords);
+
+        /**
+         * Convenience method that builds a record.
+         *
+         * \param[in] type           The record type.
+         *
+         * \param[in] sequenceNumber The command sequence number.
+         *
+         * \param[in] hostId         The host/scheme ID.
+         *
+         * \param[in] name           The name field contents.  Names longer than \ref PingerRing::maximumNameLength
+         *                           are truncated.
+         *
+         * \return Returns the newly built record.
+         */
+        static Record record(
+            RecordType         type,
+            std::uint32_t      sequenceNumber,
+            std::uint32_t      hostId,
+            const QByteArray&  name = QByteArray()
+        );
+
+    private:
+        /**
+         * Mask used to convert an index into a ring position.
+         */
+        static constexpr unsigned long mask = capacity - 1;
+
+        /**
+         * Size of a cache line.  Used to keep the producer and consumer indexes from sharing a cache line.
+         */
+        static constexpr unsigned cacheLineSize = 64;
+
+        /**
+         * The indexes and storage for a single ring.
+         */
+        struct Ring {
+            /**
+             * The consumer index.
+             */
+            alignas(cacheLineSize) std::atomic<std::uint64_t> head;
+
+            /**
+             * The producer index.
+             */
+            alignas(cacheLineSize) std::atomic<std::uint64_t> tail;
+
+            /**
+             * The ring storage.
+             */
+            alignas(cacheLineSize) Record records[capacity];
+        };
+
+        /**
+         * The layout of the shared memory region.
+         */
+        struct Region {
+            /**
+             * The region header.
+             */
+            alignas(cacheLineSize) RegionHeader header;
+
+            /**
+             * The ring carrying commands to the pinger.
+             */
+            Ring outbound;
+
+            /**
+             * The ring carrying responses and results from the pinger.
+             */
+            Ring inbound;
+        };
+
+        /**
+         * Method that writes to an eventfd.
+         *
+         * \param[in] eventDescriptor The eventfd to signal.
+         */
+        static void signalEvent(int eventDescriptor);
+
+        /**
+         * The mapped shared memory region.
+         */
+        Region* currentRegion;
+
+        /**
+         * The shared memory file descriptor.
+         */
+        int currentMemoryDescriptor;
+
+        /**
+         * The eventfd used to wake the pinger.
+         */
+        int currentOutboundEventDescriptor;
+
+        /**
+         * The eventfd used by the pinger to wake us.
+         */
+        int currentInboundEventDescriptor;
+};
+
+#endif
@@ -32,7 +32,11 @@
 #include <QHostAddress>
 #include <QSharedPointer> // DEBUG
 
+#include "log.h"
 #include "monitor.h"
+#include "host_scheme_timer.h"
+#include "thread_affinity.h"
+#include "http_engine.h"
 
 namespace RestApiOutV1 {
     class Server;
@@ -48,6 +52,8 @@ class QNetworkAccessManager;
 class ServiceThreadTracker;
 class DataAggregator;
 class InboundRestApi;
+class StateSnapshot;
+class ResourceSampler;
 
 /**
  * The polling server application class.
@@ -81,28 +87,89 @@ class PollingServer:public QObject {
         /**
          * Method that configures our polling server.
          *
-         * \param[in] inboundApiKey    The inbound API key use to authenticate requests from the database server.
+         * \param[in] inboundApiKey        The inbound API key use to authenticate requests from the database server.
          *
-         * \param[in] outboundApiKey   The API to use to talk to the database controller REST API.
+         * \param[in] outboundApiKey       The API to use to talk to the database controller REST API.
          *
-         * \param[in] databaseServer   The URL of the database controller REST API.
+         * \param[in] databaseServer       The URL of the database controller REST API.
          *
-         * \param[in] inboundPort      The inbound port number.
+         * \param[in] inboundPort          The inbound port number.
          *
-         * \param[in] serverIdentifier A list of network addresses on this machine.
+         * \param[in] serverIdentifier     A list of network addresses on this machine.
          *
-         * \param[in] defaultHeaders   A map of default header key/value pairs.
+         * \param[in] defaultHeaders       A map of default header key/value pairs.
          *
-         * \param[in] pingerString     String used to connect to the pinger.
+         * \param[in] pingerString         String used to connect to the pinger.
+         *
+         * \param[in] pingerWindow         The maximum number of pinger commands that can be outstanding at once.  A
+         *                                 value of 1 selects the original one-command-at-a-time protocol.
+         *
+         * \param[in] pingerSharedMemory   If true, the shared memory ring transport to the pinger will be used when
+         *                                 the pinger supports it.
+         *
+         * \param[in] eventBatchesInFlight The maximum number of event batches that can be in flight at once.
+         *
+         * \param[in] stateSnapshotFile    The path to the warm restart state snapshot.  An empty string disables the
+         *                                 snapshot.
+         *
+         * \param[in] logLevel             The minimum severity level of messages to be logged.
+         *
+         * \param[in] overloadPolicy       The policy applied to host/schemes serviced well after their timing marks.
+         *
+         * \param[in] conditionalRequests  If true, content match monitors will use conditional requests.
+         *
+         * \param[in] headersOnlyFetch     If true, monitors with no content check will complete once the response
+         *                                 headers are received.
+         *
+         * \param[in] latencySpillFile     The path to the file used to spill latency entries while the database
+         *                                 controller is unreachable.  An empty string disables spilling.
+         *
+         * \param[in] latencyReportWindow  The maximum number of latency reports that can be in flight at once.
+         *
+         * \param[in] minimumThreads       The minimum number of HTTP service threads.  A value of 0 uses the number
+         *                                 of logical cores.
+         *
+         * \param[in] maximumThreads       The maximum number of HTTP service threads.  A value of 0 uses the number
+         *                                 of logical cores.
+         *
+         * \param[in] serviceThreadCpus    The CPUs the HTTP service threads are pinned to, one CPU per thread in
+         *                                 turn.  An empty list leaves the threads unpinned.
+         *
+         * \param[in] pingThreadCpus       The CPUs the ping service thread is pinned to.  An empty list leaves the
+         *                                 thread unpinned.
+         *
+         * \param[in] httpEngineBackend    The HTTP engine used to perform monitor checks.
+         *
+         * \param[in] fetchCoalescing      If true, identical fetches started together share a single request.
+         *
+         * \param[in] transitionCycles     The number of polling cycles over which region changes are staged.  A
+         *                                 value of 0 applies region changes immediately.
          */
         void configureServer(
-            const QByteArray&       inboundApiKey,
-            const QByteArray&       outboundApiKey,
-            const QString&          databaseServer,
-            unsigned short          inboundPort,
-            const QString&          serverIdentifier,
-            const Monitor::Headers& defaultHeaders,
-            const QString&          pingerString
+            const QByteArray&               inboundApiKey,
+            const QByteArray&               outboundApiKey,
+            const QString&                  databaseServer,
+            unsigned short                  inboundPort,
+            const QString&                  serverIdentifier,
+            const Monitor::Headers&         defaultHeaders,
+            const QString&                  pingerString,
+            unsigned                        pingerWindow,
+            bool                            pingerSharedMemory,
+            unsigned                        eventBatchesInFlight,
+            const QString&                  stateSnapshotFile,
+            LogLevel                        logLevel,
+            HostSchemeTimer::OverloadPolicy overloadPolicy,
+            bool                            conditionalRequests,
+            bool                            headersOnlyFetch,
+            const QString&                  latencySpillFile,
+            unsigned                        latencyReportWindow,
+            unsigned                        minimumThreads,
+            unsigned                        maximumThreads,
+            const ThreadAffinity::CpuList&  serviceThreadCpus,
+            const ThreadAffinity::CpuList&  pingThreadCpus,
+            HttpEngine::Backend             httpEngineBackend,
+            bool                            fetchCoalescing,
+            unsigned                        transitionCycles
         );
 
         /**
@@ -110,6 +177,13 @@ class PollingServer:public QObject {
          */
         static constexpr unsigned keyLength = 56;
 
+        /**
+         * The number of threads used to service inbound REST API requests.  Customer changes are applied from the
+         * main thread so additional threads keep read requests responsive while large changes are parsed.  Read
+         * requests run concurrently on these threads and rely on the service thread tracker guarding its thread list.
+         */
+        static constexpr unsigned numberInboundRestApiThreads = 4;
+
         /**
          * The filesystem watcher used to monitor the configuration file.
          */
@@ -154,6 +228,16 @@ class PollingServer:public QObject {
          * The inbound REST API manager.
          */
         InboundRestApi* inboundRestApi;
+
+        /**
+         * The warm restart state snapshot.
+         */
+        StateSnapshot* stateSnapshot;
+
+        /**
+         * The background resource sampler.
+         */
+        ResourceSampler* resourceSampler;
 };
 
 #endif
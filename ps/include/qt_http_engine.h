@@ -0,0 +1,196 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref QtHttpEngine class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef QT_HTTP_ENGINE_H
+#define QT_HTTP_ENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QNetworkRequest>
+#include <QSslCertificate>
+
+#include "http_engine.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+/**
+ * HTTP engine that services requests using QNetworkAccessManager.
+ */
+class QtHttpEngine:public HttpEngine {
+    public:
+        /**
+         * The maximum amount of unread response data buffered by the network stack, in bytes.
+         */
+        static constexpr qint64 readBufferSize = 64 * 1024;
+
+        QtHttpEngine();
+
+        ~QtHttpEngine() override;
+
+        /**
+         * Method you can use to obtain the backend implemented by this engine.
+         *
+         * \return Returns \ref HttpEngine::Backend::QT.
+         */
+        Backend backend() const override;
+
+        /**
+         * Method you can use to start a request.  The client is never called from within this method.
+         *
+         * \param[in] client         The client to be notified of request events.
+         *
+         * \param[in] request        The request URL, headers and transfer timeout.
+         *
+         * \param[in] verb           The HTTP verb.
+         *
+         * \param[in] body           The request body.  An empty array indicates no body.
+         *
+         * \param[in] reportProgress If true, the client is told when the connection is established and when the
+         *                           response headers arrive.
+         *
+         * \return Returns the newly created request.  The caller takes ownership of the request.
+         */
+        Request* startRequest(
+            Client*                client,
+            const QNetworkRequest& request,
+            const QByteArray&      verb,
+            const QByteArray&      body,
+            bool                   reportProgress
+        ) override;
+
+    private:
+        /**
+         * Request wrapping a single network reply.
+         */
+        class QtRequest:public Request {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] client         The client to be notified of request events.
+                 *
+                 * \param[in] reply          The network reply.  The request takes ownership of the reply.
+                 *
+                 * \param[in] reportProgress If true, the client is told when the connection is encrypted and when
+                 *                           the response headers arrive.
+                 */
+                QtRequest(Client* client, QNetworkReply* reply, bool reportProgress);
+
+                ~QtRequest() override;
+
+                /**
+                 * Method you can use to obtain the HTTP status code of the response.
+                 *
+                 * \return Returns the HTTP status code.  A value of 0 is returned if no response was received.
+                 */
+                int statusCode() const override;
+
+                /**
+                 * Method you can use to obtain a response header.
+                 *
+                 * \param[in] headerName The header name.  The name is matched without regard to case.
+                 *
+                 * \return Returns the header value.  An empty array is returned if the header is not present.
+                 */
+                QByteArray rawHeader(const QByteArray& headerName) const override;
+
+                /**
+                 * Method you can use to obtain the advertised length of the response body.
+                 *
+                 * \return Returns the content length, in bytes.  A negative value is returned if the length is not
+                 *         known.
+                 */
+                long long contentLength() const override;
+
+                /**
+                 * Method you can use to read all currently available response body data.
+                 *
+                 * \return Returns the available data.
+                 */
+                QByteArray readAll() override;
+
+                /**
+                 * Method you can use to determine if the request failed.
+                 *
+                 * \return Returns true if the reply reported an error.
+                 */
+                bool failed() const override;
+
+                /**
+                 * Method you can use to obtain a description of the failure.
+                 *
+                 * \return Returns the reply's error string.
+                 */
+                QString errorString() const override;
+
+                /**
+                 * Method you can use to obtain the certificate presented by the remote host.
+                 *
+                 * \return Returns the peer certificate.  A null certificate is returned for insecure connections.
+                 */
+                QSslCertificate peerCertificate() const override;
+
+                /**
+                 * Method you can use to determine if a TLS handshake was performed for this request.
+                 *
+                 * \return Returns true if a TLS handshake was performed.  Returns false for insecure connections and
+                 *         for requests sent over a reused connection.
+                 */
+                bool newHandshake() const override;
+
+                /**
+                 * Method you can use to obtain the TLS session ticket issued by the remote host.  The ticket can be
+                 * supplied to later requests through QSslConfiguration::setSessionTicket.
+                 *
+                 * \return Returns the session ticket.  An empty array is returned if no ticket was issued or if the
+                 *         engine maintains its own session cache.
+                 */
+                QByteArray sslSessionTicket() const override;
+
+            private:
+                /**
+                 * The underlying network reply.
+                 */
+                QNetworkReply* reply;
+
+                /**
+                 * Flag indicating the reply reported a completed TLS handshake.
+                 */
+                bool handshakePerformed;
+
+                /**
+                 * Connections from the reply to this request.  The connections are broken before the reply is
+                 * aborted so an abort is never reported to the client.
+                 */
+                QList<QMetaObject::Connection> connections;
+        };
+
+        /**
+         * The network access manager used to service requests.
+         */
+        QNetworkAccessManager* networkAccessManager;
+};
+
+#endif
@@ -23,6 +23,170 @@
 #ifndef RESOURCES_H
 #define RESOURCES_H
 
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QByteArray>
+
+#include <cstdint>
+
+/**
+ * Class that periodically samples system and process resource usage from a background thread.  Values are computed
+ * over short windows and published atomically so they can be read from any thread with no I/O.  Use the functions
+ * below to read the published values.
+ *
+ * Only one instance should exist.
+ */
+class ResourceSampler:public QThread {
+    Q_OBJECT
+
+    public:
+        /**
+         * The sample interval, in milliseconds.  Each published value covers one interval.
+         */
+        static constexpr unsigned long sampleInterval = 1000;
+
+        /**
+         * The link speed to assume for interfaces that do not report a speed, in megabits per second.
+         */
+        static constexpr unsigned long defaultLinkSpeed = 1000;
+
+        /**
+         * Constructor.
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        ResourceSampler(QObject* parent = nullptr);
+
+        ~ResourceSampler() override;
+
+    protected:
+        /**
+         * Method that runs the sampler loop.
+         */
+        void run() override;
+
+    private:
+        /**
+         * Method that takes a single sample and publishes the results.
+         */
+        void sample();
+
+        /**
+         * Method that samples system wide CPU utilization from /proc/stat.
+         *
+         * \return Returns the fractional CPU utilization across all cores since the last sample.
+         */
+        float sampleSystemCpu();
+
+        /**
+         * Method that samples process and per-thread CPU time from /proc/self.
+         *
+         * \param[in]  elapsedSeconds     The time since the last sample, in seconds.
+         *
+         * \param[out] busiestThreadUsage The fraction of a single core used by our busiest thread.
+         *
+         * \return Returns the fraction of all cores used by this process.
+         */
+        float sampleProcessCpu(double elapsedSeconds, float& busiestThreadUsage);
+
+        /**
+         * Method that samples memory utilization from /proc/meminfo.
+         *
+         * \return Returns the fraction of total memory in use.
+         */
+        float sampleMemory();
+
+        /**
+         * Method that samples the resident memory of this process from /proc/self/statm.
+         *
+         * \return Returns the resident memory, in bytes.
+         */
+        unsigned long long sampleResidentMemory();
+
+        /**
+         * Method that samples NIC byte counters from /proc/net/dev.
+         *
+         * \param[in]  elapsedSeconds The time since the last sample, in seconds.
+         *
+         * \param[out] bytesPerSecond The combined receive and transmit rate, in bytes per second.
+         *
+         * \return Returns the fractional utilization of the busier direction relative to the link capacity.
+         */
+        float sampleNetwork(double elapsedSeconds, double& bytesPerSecond);
+
+        /**
+         * Method that reads the link speed of an interface.
+         *
+         * \param[in] interfaceName The name of the interface.
+         *
+         * \return Returns the link speed in megabits per second.
+         */
+        static unsigned long linkSpeed(const QByteArray& interfaceName);
+
+        /**
+         * Mutex used with the wake condition.
+         */
+        QMutex wakeMutex;
+
+        /**
+         * Wait condition used to pace samples and to stop the thread promptly.
+         */
+        QWaitCondition wakeCondition;
+
+        /**
+         * Timer used to measure the time between samples.
+         */
+        QElapsedTimer sampleTimer;
+
+        /**
+         * Clock ticks per second used by /proc CPU times.
+         */
+        long ticksPerSecond;
+
+        /**
+         * The number of cores on this machine.
+         */
+        unsigned numberCores;
+
+        /**
+         * The total system CPU time at the last sample, in ticks.
+         */
+        unsigned long long lastSystemTotal;
+
+        /**
+         * The idle system CPU time at the last sample, in ticks.
+         */
+        unsigned long long lastSystemIdle;
+
+        /**
+         * The process CPU time at the last sample, in ticks.
+         */
+        unsigned long long lastProcessTicks;
+
+        /**
+         * The CPU time for each thread at the last sample, in ticks, by thread ID.
+         */
+        QHash<unsigned long, unsigned long long> lastThreadTicks;
+
+        /**
+         * The total received bytes at the last sample.
+         */
+        unsigned long long lastReceivedBytes;
+
+        /**
+         * The total transmitted bytes at the last sample.
+         */
+        unsigned long long lastTransmittedBytes;
+
+        /**
+         * Cache of link speeds, in megabits per second, by interface name.
+         */
+        QHash<QByteArray, unsigned long> linkSpeeds;
+};
+
 /**
  * Function that returns an estimate of the system CPU utilization.
  *
@@ -37,4 +201,41 @@ float cpuUtilization();
  */
 float memoryUtilization();
 
+/**
+ * Function that returns the resident memory used by this process.
+ *
+ * \return Returns the resident memory, in bytes.
+ */
+unsigned long long residentMemoryBytes();
+
+/**
+ * Function that returns an estimate of the network utilization.
+ *
+ * \return Returns an estimate of the fractional network utilization of the busier direction, relative to the
+ *         combined link capacity of all non-loopback interfaces.
+ */
+float networkUtilization();
+
+/**
+ * Function that returns the current network throughput.
+ *
+ * \return Returns the combined receive and transmit rate of all non-loopback interfaces, in bytes per second.
+ */
+double networkBytesPerSecond();
+
+/**
+ * Function that returns the CPU utilization of this process.
+ *
+ * \return Returns the fraction of all cores used by this process.
+ */
+float processCpuUtilization();
+
+/**
+ * Function that returns the CPU utilization of the busiest thread in this process.
+ *
+ * \return Returns the fraction of a single core used by the busiest thread.  Values near 1 indicate a thread that
+ *         is saturated.
+ */
+float busiestThreadCpuUtilization();
+
 #endif
@@ -0,0 +1,209 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref ResponseBodyProcessor class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef RESPONSE_BODY_PROCESSOR_H
+#define RESPONSE_BODY_PROCESSOR_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QSharedPointer>
+#include <QCryptographicHash>
+
+#include "keyword_matcher.h"
+#include "monitor.h"
+
+/**
+ * Class that processes a response body incrementally as it is received.  Depending on the content check mode, the
+ * class either hashes the body, searches the body for keywords, or buffers the body for smart content matching.  At
+ * most a configured number of body bytes are processed.  Data received beyond that limit, or after a keyword verdict
+ * is known, is counted and discarded.
+ *
+ * For keyword checks the body is not hashed.  The hash is instead built from the monitor ID and whatever match
+ * results the caller adds using \ref ResponseBodyProcessor::addHashData.
+ */
+class ResponseBodyProcessor {
+    public:
+        /**
+         * Type used to represent a monitor ID.
+         */
+        typedef Monitor::MonitorId MonitorId;
+
+        /**
+         * Type used to represent a content check mode.
+         */
+        typedef Monitor::ContentCheckMode ContentCheckMode;
+
+        /**
+         * Type used to represent a shared keyword matcher.
+         */
+        typedef QSharedPointer<const KeywordMatcher> KeywordMatcherPointer;
+
+        /**
+         * Constructor
+         *
+         * \param[in] monitorId        The ID of the monitor receiving the response.  The ID is used to seed the
+         *                             hash.
+         *
+         * \param[in] contentCheckMode The content check mode for the monitor.
+         *
+         * \param[in] keywordMatcher   The matcher used to search for keywords.  A null pointer may be used if the
+         *                             monitor has no keywords.
+         *
+         * \param[in] maximumBodySize  The maximum number of body bytes to process.
+         */
+        ResponseBodyProcessor(
+            MonitorId                    monitorId,
+            ContentCheckMode             contentCheckMode,
+            const KeywordMatcherPointer& keywordMatcher,
+            unsigned long                maximumBodySize
+        );
+
+        ~ResponseBodyProcessor();
+
+        /**
+         * Method you can use to process newly received body data.
+         *
+         * \param[in] data The newly received data.
+         */
+        void addData(const QByteArray& data);
+
+        /**
+         * Method you can use to determine if further body data will be ignored.
+         *
+         * \return Returns true if the body size limit was reached or the keyword verdict is already known.
+         */
+        bool complete() const;
+
+        /**
+         * Method you can use to determine if the body was larger than the body size limit.
+         *
+         * \return Returns true if body data beyond the size limit was discarded.
+         */
+        bool truncated() const;
+
+        /**
+         * Method you can use to obtain the total number of body bytes received, including discarded bytes.
+         *
+         * \return Returns the total number of body bytes received.
+         */
+        unsigned long long bytesReceived() const;
+
+        /**
+         * Method you can use to obtain the number of keywords searched for.
+         *
+         * \return Returns the number of keywords.
+         */
+        unsigned numberKeywords() const;
+
+        /**
+         * Method you can use to determine if a keyword was found.
+         *
+         * \param[in] index The zero based index of the keyword.
+         *
+         * \return Returns true if the keyword was found.
+         */
+        bool keywordFound(unsigned index) const;
+
+        /**
+         * Method you can use to add additional data to the hash after the body has been processed.
+         *
+         * \param[in] data The data to be hashed.
+         */
+        void addHashData(const QByteArray& data);
+
+        /**
+         * Method you can use to obtain the resulting hash.
+         *
+         * \return Returns the hash of the monitor ID, the processed body data and any additional data.
+         */
+        QByteArray hashResult() const;
+
+        /**
+         * Method you can use to obtain the buffered body data.  Data is only buffered for smart content matching.
+         *
+         * \return Returns the buffered body data.
+         */
+        const QByteArray& bufferedData() const;
+
+    private:
+        /**
+         * The content check mode.
+         */
+        ContentCheckMode currentContentCheckMode;
+
+        /**
+         * The matcher used to search for keywords.
+         */
+        KeywordMatcherPointer currentKeywordMatcher;
+
+        /**
+         * The current keyword matcher state.
+         */
+        KeywordMatcher::State currentMatcherState;
+
+        /**
+         * The number of keywords that must be found before the keyword verdict is known.
+         */
+        unsigned currentTargetNumberKeywordsFound;
+
+        /**
+         * The maximum number of body bytes to be processed.
+         */
+        unsigned long currentMaximumBodySize;
+
+        /**
+         * The number of body bytes processed.
+         */
+        unsigned long currentBytesProcessed;
+
+        /**
+         * The total number of body bytes received.
+         */
+        unsigned long long currentBytesReceived;
+
+        /**
+         * Flag indicating that the keyword verdict is known.
+         */
+        bool currentVerdictKnown;
+
+        /**
+         * The running hash.
+         */
+        QCryptographicHash currentHash;
+
+        /**
+         * Buffered body data, used for smart content matching.
+         */
+        QByteArray currentBuffer;
+
+        /**
+         * Flags indicating which keywords were found.
+         */
+        QVector<bool> currentKeywordFound;
+
+        /**
+         * The number of keywords found.
+         */
+        unsigned currentNumberKeywordsFound;
+};
+
+#endif
@@ -27,18 +27,42 @@
 #include <QHash>
 #include <QMultiMap>
 #include <QList>
+#include <QElapsedTimer>
+#include <QReadWriteLock>
 
 #include <cstdint>
 
 #include <customer.h>
 #include <loading_data.h>
+#include <object_index.h>
+#include <metrics.h>
+#include <event_loop_lag_probe.h>
+#include <thread_affinity.h>
+#include <http_engine.h>
 
+class QTimer;
 class DataAggregator;
 class HttpServiceThread;
 class PingServiceThread;
+class DnsCache;
+class StateSnapshot;
 
 /**
  * Class that can be used to track and manage a collection of service threads.
+ *
+ * The tracker periodically rebalances work across the HTTP service threads.  Each pass compares the loading of each
+ * thread over the last interval.  Whole customers are migrated from the thread that is missing its timing marks, or
+ * from the most heavily loaded thread if the load is badly skewed, to the most lightly loaded thread.
+ *
+ * The number of HTTP service threads floats between a configured minimum and maximum.  A thread is added when every
+ * thread is overloaded.  The most lightly loaded thread is retired, after its customers are moved to the remaining
+ * threads, when the load has been low enough to fit into one less thread for several passes.
+ *
+ * Customers, host/schemes, and monitors are located through a shared \ref ObjectIndex so lookups do not need to visit
+ * each service thread.
+ *
+ * The set of HTTP service threads only changes from within the thread that owns the tracker.  The methods that report
+ * loading, lag, shedding, metrics, and state may be called from any thread.
  */
 class ServiceThreadTracker:public QObject {
     Q_OBJECT
@@ -81,8 +105,10 @@ class ServiceThreadTracker:public QObject {
          *
          * \param[in] dataAggregator       The data aggregator used to report latency and events.
          *
-         * \param[in] maximumNumberThreads The maximum number of threads we should allow.  A value of 0 will cause the
-         *                                 number of threads to be based on the number of logical cores.
+         * \param[in] maximumNumberThreads The initial number of threads.  A value of 0 will cause the number of
+         *                                 threads to be based on the number of logical cores.  Use
+         *                                 \ref ServiceThreadTracker::setThreadLimits to allow the pool to grow and
+         *                                 shrink.
          *
          * \param[in] parent               Pointer to the parent object.
          */
@@ -97,9 +123,62 @@ class ServiceThreadTracker:public QObject {
         /**
          * Method you can use to connect to the ping server.
          *
-         * \param[in] socketName The name of the ping server socket.
+         * \param[in] socketName   The name of the ping server socket.
+         *
+         * \param[in] pingerWindow The maximum number of pinger commands that can be outstanding at once.
+         *
+         * \param[in] sharedMemory If true, the shared memory ring transport will be negotiated with the pinger.
+         */
+        void connectToPinger(const QString& socketName, unsigned pingerWindow = 1, bool sharedMemory = false);
+
+        /**
+         * Method you can use to set the range the number of HTTP service threads may vary over.  Threads are added
+         * or retired immediately if the current number of threads is outside the range.
+         *
+         * \param[in] minimumNumberThreads The minimum number of threads.  A value of 0 will use the number of logical
+         *                                 cores.
+         *
+         * \param[in] maximumNumberThreads The maximum number of threads.  A value of 0 will use the number of logical
+         *                                 cores.  The value is raised to the minimum if needed.
+         */
+        void setThreadLimits(unsigned minimumNumberThreads, unsigned maximumNumberThreads);
+
+        /**
+         * Method you can use to pin the service threads to specific CPUs.  Each HTTP service thread is pinned to a
+         * single CPU, taken from the list in turn, to keep each thread's working set in one core's cache.
+         *
+         * \param[in] httpThreadCpus The CPUs used by the HTTP service threads.  An empty list leaves the threads
+         *                           unpinned.
+         *
+         * \param[in] pingThreadCpus The CPUs the ping service thread may run on.  An empty list leaves the thread
+         *                           unpinned.
+         */
+        void setCpuAffinity(
+            const ThreadAffinity::CpuList& httpThreadCpus,
+            const ThreadAffinity::CpuList& pingThreadCpus
+        );
+
+        /**
+         * Method you can use to select the HTTP engine used by the HTTP service threads.
+         *
+         * \param[in] backend The desired HTTP engine backend.
          */
-        void connectToPinger(const QString& socketName);
+        void setHttpEngineBackend(HttpEngine::Backend backend);
+
+        /**
+         * Method you can use to enable or disable coalescing of identical fetches.  Only monitors serviced by the
+         * same HTTP service thread share fetches.
+         *
+         * \param[in] nowEnabled If true, fetch coalescing is enabled.
+         */
+        void setFetchCoalescingEnabled(bool nowEnabled);
+
+        /**
+         * Method you can use to determine the current number of HTTP service threads.
+         *
+         * \return Returns the number of HTTP service threads.
+         */
+        unsigned numberServiceThreads() const;
 
         /**
          * Method you can use to obtain detailed loading data.
@@ -109,6 +188,13 @@ class ServiceThreadTracker:public QObject {
          */
         QMultiMap<int, LoadingData> loadingData() const;
 
+        /**
+         * Method you can use to obtain event loop lag statistics for each HTTP service thread.
+         *
+         * \return Returns a list of lag statistics, one entry per HTTP service thread.
+         */
+        QList<EventLoopLagProbe::LagData> eventLoopLag() const;
+
         /**
          * Method you can use to obtain a monitor service metric for this server.  Returned value is in monitors per
          * second.
@@ -117,6 +203,22 @@ class ServiceThreadTracker:public QObject {
          */
         float monitorsPerSecond() const;
 
+        /**
+         * Method you can use to determine if this server is shedding load.  While shedding, the polling cadence of
+         * lower priority customers is reduced so that high priority customers keep their timing.
+         *
+         * \return Returns the highest load shedding level across the HTTP service threads.  A value of 0 indicates
+         *         no load is being shed.
+         */
+        unsigned sheddingLevel() const;
+
+        /**
+         * Method you can use to determine the number of monitors serviced by this server.
+         *
+         * \return Returns the number of monitors.
+         */
+        unsigned long numberMonitors() const;
+
         /**
          * Method you can use to determine the current server status.
          *
@@ -132,6 +234,37 @@ class ServiceThreadTracker:public QObject {
          */
         void addCustomer(Customer* customer);
 
+        /**
+         * Method you can use to add a large batch of customers, typically on startup or failover.  New customers are
+         * spread across the service threads up front and each service thread receives its share in a single
+         * hand-off.  Customers that are already being serviced are updated as per
+         * \ref ServiceThreadTracker::updateCustomer.
+         *
+         * Customers that use a host/scheme or monitor ID already claimed by a different customer are rejected and
+         * deleted.
+         *
+         * \param[in] customers The customer instances to be added.  This class takes ownership of the instances.
+         *
+         * \return Returns true if every customer was applied.  Returns false if any customer was rejected.
+         */
+        bool addCustomers(const QList<Customer*>& customers);
+
+        /**
+         * Method you can use to add or update a customer.  If the customer is already being serviced, only the
+         * differences between the existing and new customer are applied so unchanged monitors keep their state and
+         * their place in the polling schedule.  Customers whose polling interval or multi-region setting changed are
+         * replaced.
+         *
+         * A customer that uses a host/scheme or monitor ID already claimed by a different customer is rejected and
+         * deleted.  The existing customer, if any, is left unchanged.
+         *
+         * \param[in] customer The customer instance holding the new settings.  This class takes ownership of the
+         *                     instance.
+         *
+         * \return Returns true if the customer was applied.  Returns false if the customer was rejected.
+         */
+        bool updateCustomer(Customer* customer);
+
         /**
          * Method you can use to remove a customer from a service thread.
          *
@@ -188,6 +321,111 @@ class ServiceThreadTracker:public QObject {
          */
         void setPaused(Customer::CustomerId customerId, bool nowPaused);
 
+        /**
+         * Method you can use to set the state snapshot used to restore monitor state across restarts.  Saved state
+         * is applied to customers as they are added.
+         *
+         * \param[in] stateSnapshot The state snapshot.  A null pointer disables restoring state.
+         */
+        void setStateSnapshot(StateSnapshot* stateSnapshot);
+
+        /**
+         * Method you can use to record the restart state of every host/scheme and monitor.
+         *
+         * \param[in] stateSnapshot The snapshot to record state into.
+         */
+        void captureState(StateSnapshot* stateSnapshot);
+
+        /**
+         * Method you can use to determine how long it took this server to become ready to poll.  The value is
+         * measured from the creation of this tracker to the completion of the first bulk load.
+         *
+         * \return Returns the time to ready, in milliseconds.  A negative value is returned if no bulk load has
+         *         completed yet.
+         */
+        long long timeToReady() const;
+
+        /**
+         * Method you can use to determine how long the last bulk load took.
+         *
+         * \return Returns the duration of the last bulk load, in milliseconds.  A negative value is returned if no
+         *         bulk load has completed yet.
+         */
+        long long lastBulkLoadDuration() const;
+
+        /**
+         * Method you can use to obtain request counters and latency histograms summed across all HTTP service
+         * threads.
+         *
+         * \return Returns the summed thread metrics.
+         */
+        ThreadMetrics::Totals threadMetrics() const;
+
+        /**
+         * Method you can use to determine the number of latency entries waiting to be acknowledged by the database
+         * controller.
+         *
+         * \return Returns the latency backlog, in entries.
+         */
+        unsigned long latencyBacklog() const;
+
+        /**
+         * Method you can use to determine the number of latency summaries waiting to be acknowledged by the database
+         * controller.
+         *
+         * \return Returns the number of open, pending and in-flight latency summaries.
+         */
+        unsigned long latencySummaryBacklog() const;
+
+        /**
+         * Method you can use to determine the number of latency entries currently held in the spill file.
+         *
+         * \return Returns the number of spilled latency entries.
+         */
+        unsigned long spilledLatencyEntries() const;
+
+        /**
+         * Method you can use to determine the number of latency entries discarded because the backlog was full.
+         *
+         * \return Returns the number of discarded latency entries.
+         */
+        unsigned long long droppedLatencyEntries() const;
+
+        /**
+         * Method you can use to determine the number of events waiting to be sent to the database controller.
+         *
+         * \return Returns the number of queued events.
+         */
+        unsigned long numberQueuedEvents() const;
+
+        /**
+         * Method you can use to determine the number of event batches currently in flight.
+         *
+         * \return Returns the number of in-flight event batches.
+         */
+        unsigned numberInFlightEventBatches() const;
+
+        /**
+         * Method you can use to determine the number of latency reports currently in flight.
+         *
+         * \return Returns the number of in-flight latency reports.
+         */
+        unsigned numberInFlightLatencyReports() const;
+
+        /**
+         * Method you can use to determine the number of pinger commands waiting to be issued.
+         *
+         * \return Returns the number of pending pinger commands.
+         */
+        unsigned long numberPendingPingerCommands() const;
+
+        /**
+         * Method you can use to determine the number of pinger commands awaiting a response from the pinger.
+         *
+         * \return Returns the number of in-flight pinger commands.
+         */
+        unsigned long numberInFlightPingerCommands() const;
+
         /**
          * Method that converts the current status to a string.
          *
@@ -222,26 +460,334 @@ class ServiceThreadTracker:public QObject {
          */
         void goInactive(bool nowInactive = true);
 
+    private slots:
+        /**
+         * Slot that is triggered periodically to rebalance work across the HTTP service threads.
+         */
+        void rebalance();
+
     private:
         /**
-         * The list of HTTP service threads.
+         * The interval between rebalancing passes, in milliseconds.
+         */
+        static constexpr unsigned rebalanceInterval = 60000;
+
+        /**
+         * The fraction of polls that must miss their timing mark for a thread to be considered overloaded.
+         */
+        static constexpr double overloadedMissedTimingMarkFraction = 0.05;
+
+        /**
+         * The average timing error, in seconds, that late polls must exceed for a thread to be considered overloaded.
+         */
+        static constexpr double overloadedTimingError = 0.020;
+
+        /**
+         * The minimum fraction of an overloaded thread's load that will be moved in a single pass.
+         */
+        static constexpr double overloadedShedFraction = 0.10;
+
+        /**
+         * The load difference between the most and least loaded threads, relative to the most heavily loaded thread,
+         * that triggers rebalancing when no thread is overloaded.
+         */
+        static constexpr double maximumLoadImbalance = 0.25;
+
+        /**
+         * The maximum number of customers migrated in a single pass.
+         */
+        static constexpr unsigned maximumMigrationsPerPass = 16;
+
+        /**
+         * The fraction of the observed per-thread capacity the remaining threads may be loaded to after a thread is
+         * retired.
+         */
+        static constexpr double retireUtilization = 0.5;
+
+        /**
+         * The number of consecutive passes without an overloaded thread required before a thread is retired.
+         */
+        static constexpr unsigned retirePasses = 5;
+
+        /**
+         * The window, in milliseconds, over which the report triggered by a staged region change is sent.
+         */
+        static constexpr unsigned long regionChangeReportWindow = 30000;
+
+        /**
+         * Class used to record the host/scheme and monitor IDs claimed by a customer.
+         */
+        class ClaimedIds {
+            public:
+                /**
+                 * The host/scheme IDs claimed by the customer.
+                 */
+                QList<HostScheme::HostSchemeId> hostSchemeIds;
+
+                /**
+                 * The monitor IDs claimed by the customer.
+                 */
+                QList<Monitor::MonitorId> monitorIds;
+        };
+
+        /**
+         * Method that adds an HTTP service thread to the pool.  The thread is brought to the same region and activity
+         * state as the existing threads.
+         */
+        void addHttpThread();
+
+        /**
+         * Method that retires an HTTP service thread.  The thread's customers are spread across the remaining threads
+         * before the thread is destroyed.
+         *
+         * \param[in] index The index of the thread to be retired.
+         */
+        void retireHttpThread(unsigned index);
+
+        /**
+         * Method that pins an HTTP service thread to its CPU.
+         *
+         * \param[in] index The index of the thread to be pinned.
+         */
+        void applyHttpThreadAffinity(unsigned index);
+
+        /**
+         * Method that moves customers between two HTTP service threads.  Customers are moved largest first, skipping
+         * any customer larger than the remaining excess.
+         *
+         * \param[in] sourceIndex      The index of the thread to move customers from.
+         *
+         * \param[in] destinationIndex The index of the thread to move customers to.
+         *
+         * \param[in] excessRate       The service rate, in host/schemes per second, to be moved.
+         */
+        void migrateCustomers(unsigned sourceIndex, unsigned destinationIndex, double excessRate);
+
+        /**
+         * Method that moves a single customer between two HTTP service threads.
+         *
+         * \param[in] customerId        The ID of the customer to be moved.
+         *
+         * \param[in] sourceThread      The thread currently managing the customer.
+         *
+         * \param[in] destinationThread The thread to move the customer to.
+         *
+         * \return Returns true if the customer was moved.
+         */
+        bool migrateCustomer(
+            Customer::CustomerId customerId,
+            HttpServiceThread*   sourceThread,
+            HttpServiceThread*   destinationThread
+        );
+
+        /**
+         * Method that registers a customer's hosts with the ping service thread.
+         *
+         * \param[in] customer      The customer whose hosts should be pinged.
+         *
+         * \param[in] serviceThread The HTTP service thread managing the customer.
+         */
+        void addPingHosts(Customer* customer, HttpServiceThread* serviceThread);
+
+        /**
+         * Method that hands a customer to a specific HTTP service thread.  The customer is owned by the service
+         * thread once this method returns.
+         *
+         * \param[in] customer      The customer to be added.
+         *
+         * \param[in] serviceThread The HTTP service thread that should manage the customer.
+         */
+        void addCustomer(Customer* customer, HttpServiceThread* serviceThread);
+
+        /**
+         * Method that determines if two descriptions of a customer would result in the same set of pinged hosts.
+         *
+         * \param[in] existingCustomer The customer currently being serviced.
+         *
+         * \param[in] newCustomer      The newly received customer.
+         *
+         * \return Returns true if the ping service thread does not need to be updated.
+         */
+        static bool samePingHosts(const Customer* existingCustomer, const Customer* newCustomer);
+
+        /**
+         * Method that determines if a customer's host/scheme and monitor IDs are free for the customer to use.
+         *
+         * \param[in] customer The customer of interest.
+         *
+         * \return Returns true if no other customer has claimed any of the customer's IDs.
+         */
+        bool idsAvailable(const Customer* customer) const;
+
+        /**
+         * Method that records a customer's host/scheme and monitor IDs as claimed by the customer.  IDs claimed by an
+         * earlier instance of the customer are released first.
+         *
+         * \param[in] customer The customer claiming the IDs.
+         */
+        void claimIds(const Customer* customer);
+
+        /**
+         * Method that releases the host/scheme and monitor IDs claimed by a customer.
+         *
+         * \param[in] customerId The ID of the customer releasing its IDs.
+         */
+        void releaseIds(Customer::CustomerId customerId);
+
+        /**
+         * Method that estimates the service rate of a customer.
+         *
+         * \param[in] customer The customer of interest.
+         *
+         * \return Returns the number of host/schemes per second serviced for the customer.
+         */
+        double customerServiceRate(const Customer* customer) const;
+
+        /**
+         * Index of customers, host/schemes, and monitors across all HTTP service threads.  The threads are destroyed
+         * before the index.
+         */
+        ObjectIndex objectIndex;
+
+        /**
+         * The list of HTTP service threads.  The list is only modified from within the thread that owns the tracker,
+         * while holding \ref httpServiceThreadsLock for write.  Other threads must hold the lock for read while
+         * using the list.
          */
         QList<HttpServiceThread*> httpServiceThreads;
 
+        /**
+         * Lock used to guard \ref httpServiceThreads and \ref retiredThreadMetrics against access from other
+         * threads.
+         */
+        mutable QReadWriteLock httpServiceThreadsLock;
+
         /**
          * The data aggregator.
          */
         DataAggregator* currentDataAggregator;
 
+        /**
+         * The DNS cache shared by all service threads.
+         */
+        DnsCache* dnsCache;
+
         /**
          * The ping service thread.
          */
         PingServiceThread* pingServiceThread;
 
+        /**
+         * Timer used to trigger rebalancing passes.
+         */
+        QTimer* rebalanceTimer;
+
+        /**
+         * The state snapshot used to restore monitor state.
+         */
+        StateSnapshot* currentStateSnapshot;
+
+        /**
+         * Cumulative loading data for each HTTP service thread as of the last rebalancing pass.
+         */
+        QList<LoadingData> lastCumulativeLoadingData;
+
+        /**
+         * Metrics accumulated by HTTP service threads that have been retired.
+         */
+        ThreadMetrics::Totals retiredThreadMetrics;
+
+        /**
+         * The minimum number of HTTP service threads.
+         */
+        unsigned currentMinimumNumberThreads;
+
+        /**
+         * The maximum number of HTTP service threads.
+         */
+        unsigned currentMaximumNumberThreads;
+
+        /**
+         * The CPUs the HTTP service threads are pinned to.
+         */
+        ThreadAffinity::CpuList currentHttpThreadCpus;
+
+        /**
+         * The CPUs the ping service thread is pinned to.
+         */
+        ThreadAffinity::CpuList currentPingThreadCpus;
+
+        /**
+         * The HTTP engine backend used by the HTTP service threads.
+         */
+        HttpEngine::Backend currentHttpEngineBackend;
+
+        /**
+         * Flag indicating if fetch coalescing is enabled.
+         */
+        bool currentFetchCoalescingEnabled;
+
+        /**
+         * The highest service rate, in host/schemes per second, seen on a thread that was meeting its timing marks.
+         */
+        double peakHealthyThreadRate;
+
+        /**
+         * The number of consecutive rebalancing passes without an overloaded thread.
+         */
+        unsigned numberQuietPasses;
+
+        /**
+         * The current region index.
+         */
+        unsigned currentRegionIndex;
+
+        /**
+         * The current number of regions.
+         */
+        unsigned currentNumberRegions;
+
         /**
          * The current server status.
          */
         Status currentStatus;
+
+        /**
+         * Flag indicating the ping service thread has been activated by a region change.
+         */
+        bool pingerActive;
+
+        /**
+         * Timer started when this tracker is created.
+         */
+        QElapsedTimer uptimeTimer;
+
+        /**
+         * The time to ready, in milliseconds.
+         */
+        long long currentTimeToReady;
+
+        /**
+         * The duration of the last bulk load, in milliseconds.
+         */
+        long long currentLastBulkLoadDuration;
+
+        /**
+         * The IDs claimed by each customer, by customer ID.  Ownership is tracked here, rather than through the
+         * object index, as the index briefly holds entries for customers that are being removed.  The claimed IDs
+         * are only used from within the thread that owns the tracker.
+         */
+        QHash<Customer::CustomerId, ClaimedIds> claimedIdsByCustomerId;
+
+        /**
+         * The customer that claimed each host/scheme ID.
+         */
+        QHash<HostScheme::HostSchemeId, Customer::CustomerId> hostSchemeOwners;
+
+        /**
+         * The customer that claimed each monitor ID.
+         */
+        QHash<Monitor::MonitorId, Customer::CustomerId> monitorOwners;
 };
 
 #endif
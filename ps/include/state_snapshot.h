@@ -0,0 +1,363 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref StateSnapshot class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef STATE_SNAPSHOT_H
+#define STATE_SNAPSHOT_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QFile>
+
+#include <cstdint>
+
+#include "monitor.h"
+#include "host_scheme.h"
+#include "customer.h"
+
+class QTimer;
+class ServiceThreadTracker;
+
+/**
+ * Class that maintains an optional, memory-mapped snapshot of the small amount of per-monitor state that is normally
+ * lost when the server restarts.  The snapshot holds the monitor status and last content hash for each monitor and the
+ * SSL expiration timestamp for each host/scheme.
+ *
+ * The snapshot is flushed periodically into a memory-mapped file.  Writes land in the page cache so the snapshot
+ * survives process restarts and deploys without any explicit I/O.  On startup, the snapshot is loaded and applied to
+ * customers as the database controller provides them.  This avoids a burst of status events and certificate reports
+ * after a restart and preserves content baselines.
+ *
+ * This class must be used from the main thread.
+ */
+class StateSnapshot:public QObject {
+    Q_OBJECT
+
+    public:
+        /**
+         * The interval between flushes, in milliseconds.
+         */
+        static constexpr unsigned flushInterval = 30000;
+
+        /**
+         * The maximum age of a snapshot that will be loaded, in seconds.  Older snapshots are ignored.
+         */
+        static constexpr unsigned long long maximumSnapshotAge = 3600;
+
+        /**
+         * Constructor.
+         *
+         * \param[in] serviceThreadTracker The service thread tracker used to collect state.
+         *
+         * \param[in] parent               Pointer to the parent object.
+         */
+        StateSnapshot(ServiceThreadTracker* serviceThreadTracker, QObject* parent = nullptr);
+
+        ~StateSnapshot() override;
+
+        /**
+         * Method you can use to set the snapshot file.  An existing, recent snapshot in the file will be loaded.
+         * Setting the same file again has no effect.
+         *
+         * \param[in] newFilename The path to the snapshot file.  An empty string disables the snapshot.
+         *
+         * \return Returns true on success.  Returns false if the file could not be opened or mapped.
+         */
+        bool setFilename(const QString& newFilename);
+
+        /**
+         * Method you can use to obtain the current snapshot file.
+         *
+         * \return Returns the path to the snapshot file.  An empty string is returned if the snapshot is disabled.
+         */
+        QString filename() const;
+
+        /**
+         * Method you can use to determine if the snapshot is enabled.
+         *
+         * \return Returns true if the snapshot is enabled.
+         */
+        bool isEnabled() const;
+
+        /**
+         * Method you can use to apply saved state to a newly received customer.  The customer must not yet be
+         * managed by a service thread.  Saved state is discarded once applied.
+         *
+         * \param[in] customer The customer to apply saved state to.
+         */
+        void restore(Customer* customer);
+
+        /**
+         * Method that is called by the service threads, while a flush is in progress, to record a monitor's state.
+         *
+         * \param[in] monitor The monitor to be recorded.
+         */
+        void recordMonitor(const Monitor* monitor);
+
+        /**
+         * Method that is called by the service threads, while a flush is in progress, to record a host/scheme's
+         * state.
+         *
+         * \param[in] hostScheme The host/scheme to be recorded.
+         */
+        void recordHostScheme(const HostScheme* hostScheme);
+
+    public slots:
+        /**
+         * Slot you can trigger to flush the current state to the snapshot file.
+         */
+        void flush();
+
+    private:
+        /**
+         * Value used to identify a snapshot file.  Holds "PSS1".
+         */
+        static constexpr std::uint32_t snapshotMagic = 0x31535350;
+
+        /**
+         * The snapshot file format version.
+         */
+        static constexpr std::uint32_t snapshotVersion = 1;
+
+        /**
+         * The maximum content hash length that can be stored.
+         */
+        static constexpr unsigned maximumHashLength = 56;
+
+        /**
+         * The granularity used when growing the snapshot file, in bytes.
+         */
+        static constexpr qint64 fileGrowthQuantum = 65536;
+
+        /**
+         * Structure of the snapshot file header.
+         */
+        struct FileHeader {
+            /**
+             * Value identifying the file.
+             */
+            std::uint32_t magic;
+
+            /**
+             * The file format version.
+             */
+            std::uint32_t version;
+
+            /**
+             * Non-zero if the records are complete.  The value is cleared while a flush is in progress.
+             */
+            std::uint32_t valid;
+
+            /**
+             * The number of monitor records.
+             */
+            std::uint32_t numberMonitors;
+
+            /**
+             * The number of host/scheme records.
+             */
+            std::uint32_t numberHostSchemes;
+
+            /**
+             * Reserved for future use.
+             */
+            std::uint32_t reserved;
+
+            /**
+             * The time the snapshot was written, in seconds since the Unix epoch.
+             */
+            std::uint64_t timestamp;
+        } __attribute__((packed));
+
+        /**
+         * Structure of a monitor record.  Monitor records immediately follow the header.
+         */
+        struct MonitorRecord {
+            /**
+             * The monitor ID.
+             */
+            std::uint32_t monitorId;
+
+            /**
+             * The monitor status code.
+             */
+            std::uint8_t status;
+
+            /**
+             * The number of valid bytes in the hash.
+             */
+            std::uint8_t hashLength;
+
+            /**
+             * Reserved for future use.
+             */
+            std::uint16_t reserved;
+
+            /**
+             * The last content hash.
+             */
+            std::uint8_t hash[maximumHashLength];
+        } __attribute__((packed));
+
+        /**
+         * Structure of a host/scheme record.  Host/scheme records immediately follow the monitor records.
+         */
+        struct HostSchemeRecord {
+            /**
+             * The host/scheme ID.
+             */
+            std::uint32_t hostSchemeId;
+
+            /**
+             * Reserved for future use.
+             */
+            std::uint32_t reserved;
+
+            /**
+             * The SSL expiration timestamp.
+             */
+            std::uint64_t sslExpirationTimestamp;
+        } __attribute__((packed));
+
+        /**
+         * Class used to hold the state of a single monitor.
+         */
+        class MonitorState {
+            public:
+                MonitorState();
+
+                /**
+                 * Constructor.
+                 *
+                 * \param[in] monitorStatus The monitor status.
+                 *
+                 * \param[in] contentHash   The last content hash.
+                 */
+                MonitorState(Monitor::MonitorStatus monitorStatus, const QByteArray& contentHash);
+
+                /**
+                 * Method you can use to obtain the monitor status.
+                 *
+                 * \return Returns the monitor status.
+                 */
+                inline Monitor::MonitorStatus monitorStatus() const {
+                    return currentMonitorStatus;
+                }
+
+                /**
+                 * Method you can use to obtain the last content hash.
+                 *
+                 * \return Returns the last content hash.
+                 */
+                inline const QByteArray& contentHash() const {
+                    return currentContentHash;
+                }
+
+            private:
+                /**
+                 * The monitor status.
+                 */
+                Monitor::MonitorStatus currentMonitorStatus;
+
+                /**
+                 * The last content hash.
+                 */
+                QByteArray currentContentHash;
+        };
+
+        /**
+         * Type used to track monitor state by monitor ID.
+         */
+        typedef QHash<Monitor::MonitorId, MonitorState> MonitorStates;
+
+        /**
+         * Type used to track SSL expiration timestamps by host/scheme ID.
+         */
+        typedef QHash<HostScheme::HostSchemeId, unsigned long long> SslExpirationTimestamps;
+
+        /**
+         * Method that loads a snapshot from the mapped file.
+         */
+        void load();
+
+        /**
+         * Method that maps the snapshot file, growing the file if needed.
+         *
+         * \param[in] size The minimum size of the mapping, in bytes.
+         *
+         * \return Returns true on success.  Returns false on error.
+         */
+        bool mapFile(qint64 size);
+
+        /**
+         * Method that unmaps and closes the snapshot file.
+         */
+        void closeFile();
+
+        /**
+         * The service thread tracker.
+         */
+        ServiceThreadTracker* currentServiceThreadTracker;
+
+        /**
+         * Timer used to trigger periodic flushes.
+         */
+        QTimer* flushTimer;
+
+        /**
+         * The snapshot file.
+         */
+        QFile snapshotFile;
+
+        /**
+         * Pointer to the mapped file data.  A null pointer indicates that the file is not mapped.
+         */
+        uchar* mappedData;
+
+        /**
+         * The size of the mapped region, in bytes.
+         */
+        qint64 mappedSize;
+
+        /**
+         * Monitor state loaded from the snapshot that has not yet been applied.
+         */
+        MonitorStates savedMonitorStates;
+
+        /**
+         * SSL expiration timestamps loaded from the snapshot that have not yet been applied.
+         */
+        SslExpirationTimestamps savedSslExpirationTimestamps;
+
+        /**
+         * Monitor state collected during a flush.
+         */
+        MonitorStates capturedMonitorStates;
+
+        /**
+         * SSL expiration timestamps collected during a flush.
+         */
+        SslExpirationTimestamps capturedSslExpirationTimestamps;
+};
+
+#endif
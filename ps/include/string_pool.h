@@ -0,0 +1,82 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref StringPool class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <QString>
+#include <QByteArray>
+#include <QByteArrayList>
+
+/**
+ * Class that interns strings shared by many monitors, such as paths, user agents, post content and keywords.
+ * Interned values are implicitly shared so identical values held by different customers reference a single buffer.
+ * Values no longer referenced outside of the pool are released as the pool grows.  All methods are thread safe.
+ */
+class StringPool {
+    public:
+        /**
+         * Method you can use to intern a string.
+         *
+         * \param[in] value The value to be interned.
+         *
+         * \return Returns a string sharing its data with any equal string already in the pool.
+         */
+        static QString intern(const QString& value);
+
+        /**
+         * Method you can use to intern a byte array.
+         *
+         * \param[in] value The value to be interned.
+         *
+         * \return Returns a byte array sharing its data with any equal byte array already in the pool.
+         */
+        static QByteArray intern(const QByteArray& value);
+
+        /**
+         * Method you can use to intern a list of byte arrays.  Both the list and each entry are interned.
+         *
+         * \param[in] value The value to be interned.
+         *
+         * \return Returns a list sharing its data with any equal list already in the pool.
+         */
+        static QByteArrayList intern(const QByteArrayList& value);
+
+        /**
+         * Method you can use to determine the number of distinct values held by the pool.
+         *
+         * \return Returns the number of interned values.
+         */
+        static unsigned long numberEntries();
+
+        /**
+         * Method you can use to determine the approximate storage held by the pool.
+         *
+         * \return Returns the number of bytes of string data held by the pool.
+         */
+        static unsigned long long numberBytes();
+
+    private:
+        StringPool() = delete;
+};
+
+#endif
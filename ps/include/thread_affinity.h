@@ -0,0 +1,79 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref ThreadAffinity class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef THREAD_AFFINITY_H
+#define THREAD_AFFINITY_H
+
+#include <QString>
+#include <QList>
+
+/**
+ * Class that parses CPU lists and pins threads to them.
+ *
+ * CPU lists use the same syntax as the Linux cpulist files, a comma separated list of CPU numbers and inclusive
+ * ranges such as "0-3,8".  An entry of the form "nodeN" expands to the CPUs of NUMA node N.
+ */
+class ThreadAffinity {
+    public:
+        /**
+         * Type used to hold a sorted list of CPU numbers.
+         */
+        typedef QList<unsigned> CpuList;
+
+        /**
+         * Method that parses a CPU list.
+         *
+         * \param[in]  specification The CPU list to be parsed.
+         *
+         * \param[out] ok            Optional pointer to a value set to true if the list is valid.
+         *
+         * \return Returns the sorted list of unique CPU numbers.  An empty list is returned if the specification is
+         *         empty or invalid.
+         */
+        static CpuList parse(const QString& specification, bool* ok = nullptr);
+
+        /**
+         * Method that converts a CPU list to a string.
+         *
+         * \param[in] cpus The CPU list to be converted.
+         *
+         * \return Returns the list in cpulist form.
+         */
+        static QString toString(const CpuList& cpus);
+
+        /**
+         * Method that pins the calling thread to a set of CPUs.
+         *
+         * \param[in] cpus The CPUs the calling thread may run on.  An empty list allows the thread to run on any CPU.
+         *
+         * \return Returns true on success.  Returns false if the affinity could not be set.
+         */
+        static bool apply(const CpuList& cpus);
+
+    private:
+        /**
+         * The directory holding the NUMA node descriptions.
+         */
+        static const QString nodeDirectory;
+};
+
+#endif
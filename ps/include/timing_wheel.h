@@ -0,0 +1,317 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref TimingWheel class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <QObject>
+
+#include <cstdint>
+
+class QTimer;
+
+/**
+ * Class that provides a hierarchical timing wheel with millisecond slots.  A single timing wheel is used by each
+ * service thread to schedule all of the thread's work using one timer.
+ *
+ * All methods of this class, other than \ref TimingWheel::currentTime, must be called from the thread that owns the
+ * timing wheel.
+ */
+class TimingWheel:public QObject {
+    Q_OBJECT
+
+    public:
+        class Entry;
+
+        /**
+         * Pure virtual base class for objects that wish to receive timing wheel events.
+         */
+        class Client {
+            public:
+                virtual ~Client() = default;
+
+                /**
+                 * Method that is called when a timing wheel entry expires.  The entry will be unscheduled when this
+                 * method is called.  You can reschedule the entry from within this method.
+                 *
+                 * \param[in] entry       The entry that expired.
+                 *
+                 * \param[in] currentTime The current time, in milliseconds since the Unix epoch.
+                 */
+                virtual void timerExpired(Entry* entry, unsigned long long currentTime) = 0;
+        };
+
+        /**
+         * Class that represents a single scheduled event.  You can derive from this class to associate data with the
+         * event.
+         */
+        class Entry {
+            friend class TimingWheel;
+
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] client The client to be notified when this entry expires.
+                 */
+                Entry(Client* client);
+
+                virtual ~Entry();
+
+                /**
+                 * Method you can use to obtain the client tied to this entry.
+                 *
+                 * \return Returns the client tied to this entry.
+                 */
+                inline Client* client() const {
+                    return currentClient;
+                }
+
+                /**
+                 * Method you can use to obtain the time this entry is, or was last, scheduled to expire.
+                 *
+                 * \return Returns the entry deadline, in milliseconds since the Unix epoch.
+                 */
+                inline unsigned long long deadline() const {
+                    return currentDeadline;
+                }
+
+                /**
+                 * Method you can use to determine if this entry is currently scheduled.
+                 *
+                 * \return Returns true if the entry is scheduled.  Returns false if the entry is not scheduled.
+                 */
+                inline bool isScheduled() const {
+                    return currentLevel != notScheduled;
+                }
+
+            private:
+                /**
+                 * Value used to indicate that an entry is not scheduled.
+                 */
+                static constexpr std::int8_t notScheduled = -1;
+
+                /**
+                 * The client to be notified.
+                 */
+                Client* currentClient;
+
+                /**
+                 * The time this entry is scheduled to expire, in milliseconds since the Unix epoch.
+                 */
+                unsigned long long currentDeadline;
+
+                /**
+                 * The next entry in this entry's slot.
+                 */
+                Entry* next;
+
+                /**
+                 * The previous entry in this entry's slot.
+                 */
+                Entry* previous;
+
+                /**
+                 * The wheel level holding this entry.
+                 */
+                std::int8_t currentLevel;
+
+                /**
+                 * The slot holding this entry.
+                 */
+                std::uint8_t currentSlot;
+        };
+
+        /**
+         * Constructor
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        TimingWheel(QObject* parent = nullptr);
+
+        ~TimingWheel() override;
+
+        /**
+         * Method you can use to obtain the current time as used by the timing wheel.  The value is derived from the
+         * monotonic clock, anchored to the Unix epoch when first called, so it never jumps when the wall clock is
+         * stepped.  This method is thread safe.
+         *
+         * \return Returns the current time in milliseconds since the Unix epoch.
+         */
+        static unsigned long long currentTime();
+
+        /**
+         * Method you can use to schedule, or reschedule, an entry.  Scheduling is O(1).
+         *
+         * \param[in] entry    The entry to be scheduled.  The timing wheel does not take ownership of the entry.
+         *
+         * \param[in] deadline The time when the entry should expire, in milliseconds since the Unix epoch.  Entries
+         *                     with deadlines in the past will expire on the next timer tick.
+         */
+        void schedule(Entry* entry, unsigned long long deadline);
+
+        /**
+         * Method you can use to cancel a scheduled entry.  Cancelling an entry is O(1).  Cancelling an entry that
+         * is not scheduled is harmless.
+         *
+         * \param[in] entry The entry to be cancelled.
+         */
+        void cancel(Entry* entry);
+
+        /**
+         * Method you can use to determine the number of scheduled entries.
+         *
+         * \return Returns the number of scheduled entries.
+         */
+        unsigned long numberScheduledEntries() const;
+
+    private slots:
+        /**
+         * Slot that is triggered by our timer to process expired entries.
+         */
+        void processExpiredEntries();
+
+    private:
+        /**
+         * The number of bits of time represented by each wheel level.
+         */
+        static constexpr unsigned slotBits = 8;
+
+        /**
+         * The number of slots per wheel level.
+         */
+        static constexpr unsigned slotsPerLevel = 1U << slotBits;
+
+        /**
+         * Mask used to extract a slot index.
+         */
+        static constexpr unsigned slotMask = slotsPerLevel - 1;
+
+        /**
+         * The number of wheel levels.  Four levels with 1 mSec resolution cover approximately 49 days.
+         */
+        static constexpr unsigned numberLevels = 4;
+
+        /**
+         * The number of 64-bit words used to track occupied slots in each level.
+         */
+        static constexpr unsigned numberOccupancyWords = slotsPerLevel / 64;
+
+        /**
+         * Pseudo-level used to indicate an entry that is in the list of entries being fired.
+         */
+        static constexpr std::int8_t firingLevel = numberLevels;
+
+        /**
+         * Value indicating that the timer is not armed.
+         */
+        static constexpr unsigned long long timerNotArmed = static_cast<unsigned long long>(-1);
+
+        /**
+         * Method that inserts an entry into the wheel based on its deadline.
+         *
+         * \param[in] entry The entry to be inserted.
+         */
+        void insert(Entry* entry);
+
+        /**
+         * Method that removes an entry from whatever list currently holds it.
+         *
+         * \param[in] entry The entry to be removed.
+         */
+        void unlink(Entry* entry);
+
+        /**
+         * Method that moves all entries in a higher level slot down to lower levels.
+         *
+         * \param[in] level The level to be cascaded.
+         *
+         * \param[in] slot  The slot to be cascaded.
+         */
+        void cascade(unsigned level, unsigned slot);
+
+        /**
+         * Method that locates the next occupied slot in a level.
+         *
+         * \param[in] level The level to be searched.
+         *
+         * \param[in] from  The first slot to be checked.
+         *
+         * \return Returns the next occupied slot.  A negative value is returned if there are no occupied slots at or
+         *         after the provided slot.
+         */
+        int nextOccupiedSlot(unsigned level, unsigned from) const;
+
+        /**
+         * Method that determines when the wheel next needs servicing.
+         *
+         * \return Returns the time when the wheel next needs servicing, in milliseconds since the Unix epoch.
+         */
+        unsigned long long nextWakeTime() const;
+
+        /**
+         * Method that arms the timer for the next wheel event.
+         */
+        void armTimer();
+
+        /**
+         * Timer used to service the wheel.
+         */
+        QTimer* timer;
+
+        /**
+         * The time of the wheel's current slot, in milliseconds since the Unix epoch.
+         */
+        unsigned long long wheelTime;
+
+        /**
+         * The time the timer is currently armed for.
+         */
+        unsigned long long armedWakeTime;
+
+        /**
+         * The number of scheduled entries.
+         */
+        unsigned long numberEntries;
+
+        /**
+         * Flag indicating that we are processing expired entries.
+         */
+        bool processing;
+
+        /**
+         * List of entries currently being fired.
+         */
+        Entry* firingEntries;
+
+        /**
+         * The wheel slots.
+         */
+        Entry* wheelSlots[numberLevels][slotsPerLevel];
+
+        /**
+         * Bit masks indicating which slots are occupied.
+         */
+        std::uint64_t occupiedSlots[numberLevels][numberOccupancyWords];
+};
+
+#endif
@@ -35,17 +35,38 @@ HEADERS = include/metatypes.h \
           include/resources.h \
           include/loading_data.h \
           include/monitor.h \
+          include/keyword_matcher.h \
+          include/response_body_processor.h \
           include/host_scheme.h \
           include/customer.h \
           include/service_thread.h \
           include/service_thread_tracker.h \
+          include/timing_wheel.h \
+          include/dns_cache.h \
+          include/object_index.h \
+          include/state_snapshot.h \
           include/host_scheme_timer.h \
           include/http_service_thread.h \
           include/ping_service_thread.h \
+          include/pinger_ring.h \
+          include/event_batch.h \
           include/event_reporter.h \
           include/certificate_reporter.h \
           include/data_aggregator.h \
+          include/latency_report_encoder.h \
+          include/latency_ring.h \
+          include/latency_spill.h \
+          include/latency_batch.h \
+          include/latency_sketch.h \
+          include/thread_affinity.h \
+          include/metrics.h \
+          include/event_loop_lag_probe.h \
+          include/string_pool.h \
+          include/job_queue.h \
           include/inbound_rest_api.h \
+          include/http_engine.h \
+          include/qt_http_engine.h \
+          include/coalescing_http_engine.h \
 
 ########################################################################################################################
 # Source files
@@ -57,18 +78,38 @@ SOURCES = source/main.cpp \
           source/ps.cpp \
           source/resources.cpp \
           source/monitor.cpp \
+          source/keyword_matcher.cpp \
+          source/response_body_processor.cpp \
           source/host_scheme.cpp \
           source/customer.cpp \
           source/service_thread.cpp \
           source/service_thread_tracker.cpp \
+          source/timing_wheel.cpp \
+          source/dns_cache.cpp \
+          source/object_index.cpp \
+          source/state_snapshot.cpp \
           source/host_scheme_timer.cpp \
           source/http_service_thread.cpp \
           source/ping_service_thread.cpp \
           source/ping_service_thread_private.cpp \
+          source/pinger_ring.cpp \
+          source/event_batch.cpp \
           source/event_reporter.cpp \
           source/certificate_reporter.cpp \
           source/data_aggregator.cpp \
+          source/latency_report_encoder.cpp \
+          source/latency_spill.cpp \
+          source/latency_batch.cpp \
+          source/latency_sketch.cpp \
+          source/thread_affinity.cpp \
+          source/metrics.cpp \
+          source/event_loop_lag_probe.cpp \
+          source/string_pool.cpp \
+          source/job_queue.cpp \
           source/inbound_rest_api.cpp \
+          source/http_engine.cpp \
+          source/qt_http_engine.cpp \
+          source/coalescing_http_engine.cpp \
 
 ########################################################################################################################
 # Private headers
@@ -77,6 +118,16 @@ SOURCES = source/main.cpp \
 INCLUDEPATH += source
 HEADERS += source/ping_service_thread_private.h \
 
+########################################################################################################################
+# Native HTTP engine
+#
+
+linux {
+    HEADERS += include/native_http_engine.h
+    SOURCES += source/native_http_engine.cpp
+    LIBS += -lssl -lcrypto
+}
+
 ########################################################################################################################
 # Libraries
 #
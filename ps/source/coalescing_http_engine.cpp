@@ -0,0 +1,327 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref CoalescingHttpEngine class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QNetworkRequest>
+#include <QSslCertificate>
+
+#include "metrics.h"
+#include "http_engine.h"
+#include "coalescing_http_engine.h"
+
+/***********************************************************************************************************************
+* CoalescingHttpEngine::CoalescedRequest
+*/
+
+CoalescingHttpEngine::CoalescedRequest::CoalescedRequest(
+        HttpEngine::Client*                client,
+        CoalescingHttpEngine::SharedFetch* fetch,
+        bool                               reportProgress
+    ):Request(
+        client
+    ),fetch(
+        fetch
+    ),reportProgress(
+        reportProgress
+    ),readOffset(
+        0
+    ) {
+    fetch->coalescedRequests.append(this);
+}
+
+
+CoalescingHttpEngine::CoalescedRequest::~CoalescedRequest() {
+    fetch->detach(this);
+}
+
+
+int CoalescingHttpEngine::CoalescedRequest::statusCode() const {
+    return fetch->request->statusCode();
+}
+
+
+QByteArray CoalescingHttpEngine::CoalescedRequest::rawHeader(const QByteArray& headerName) const {
+    return fetch->request->rawHeader(headerName);
+}
+
+
+long long CoalescingHttpEngine::CoalescedRequest::contentLength() const {
+    return fetch->request->contentLength();
+}
+
+
+QByteArray CoalescingHttpEngine::CoalescedRequest::readAll() {
+    // Reading from the start of the buffer returns a shallow copy so a fetch serving a single request never copies
+    // the body.
+
+    const QByteArray& buffer = fetch->buffer;
+    QByteArray        result = readOffset == 0 ? buffer : buffer.mid(readOffset);
+
+    readOffset = buffer.size();
+    return result;
+}
+
+
+bool CoalescingHttpEngine::CoalescedRequest::failed() const {
+    return fetch->request->failed();
+}
+
+
+QString CoalescingHttpEngine::CoalescedRequest::errorString() const {
+    return fetch->request->errorString();
+}
+
+
+QSslCertificate CoalescingHttpEngine::CoalescedRequest::peerCertificate() const {
+    return fetch->request->peerCertificate();
+}
+
+
+bool CoalescingHttpEngine::CoalescedRequest::newHandshake() const {
+    return fetch->request->newHandshake();
+}
+
+
+QByteArray CoalescingHttpEngine::CoalescedRequest::sslSessionTicket() const {
+    return fetch->request->sslSessionTicket();
+}
+
+
+unsigned long long CoalescingHttpEngine::CoalescedRequest::elapsedNanoseconds() const {
+    return fetch->request->elapsedNanoseconds();
+}
+
+
+HttpEngine::PhaseTimes CoalescingHttpEngine::CoalescedRequest::phaseTimes() const {
+    return fetch->request->phaseTimes();
+}
+
+/***********************************************************************************************************************
+* CoalescingHttpEngine::SharedFetch
+*/
+
+CoalescingHttpEngine::SharedFetch::SharedFetch(
+        CoalescingHttpEngine* engine,
+        const QByteArray&     key
+    ):engine(
+        engine
+    ),key(
+        key
+    ),request(
+        nullptr
+    ),connected(
+        false
+    ),headersReceived(
+        false
+    ),dispatching(
+        false
+    ) {
+    age.start();
+}
+
+
+CoalescingHttpEngine::SharedFetch::~SharedFetch() {
+    engine->closeFetch(this);
+    delete request;
+}
+
+
+bool CoalescingHttpEngine::SharedFetch::joinable() const {
+    return !headersReceived && age.elapsed() < coalescingWindow;
+}
+
+
+void CoalescingHttpEngine::SharedFetch::detach(CoalescingHttpEngine::CoalescedRequest* coalescedRequest) {
+    coalescedRequests.removeOne(coalescedRequest);
+    if (coalescedRequests.isEmpty() && !dispatching) {
+        delete this;
+    }
+}
+
+
+void CoalescingHttpEngine::SharedFetch::requestConnected(HttpEngine::Request*) {
+    connected = true;
+    dispatch(&Client::requestConnected, true);
+}
+
+
+void CoalescingHttpEngine::SharedFetch::requestHeadersReceived(HttpEngine::Request*) {
+    // A request joining after this point would never see the headers so the fetch is closed to new requests.
+
+    headersReceived = true;
+    engine->closeFetch(this);
+
+    dispatch(&Client::requestHeadersReceived, true);
+}
+
+
+void CoalescingHttpEngine::SharedFetch::requestDataAvailable(HttpEngine::Request* request) {
+    buffer.append(request->readAll());
+
+    if (dispatch(&Client::requestDataAvailable, false)) {
+        // Clients normally read everything they're given so the buffer is released after each pass.
+
+        int                                      bufferSize = buffer.size();
+        QList<CoalescedRequest*>::const_iterator it         = coalescedRequests.constBegin();
+        QList<CoalescedRequest*>::const_iterator end        = coalescedRequests.constEnd();
+        while (it != end && (*it)->readOffset == bufferSize) {
+            ++it;
+        }
+
+        if (it == end) {
+            buffer.clear();
+            for (it = coalescedRequests.constBegin() ; it != end ; ++it) {
+                (*it)->readOffset = 0;
+            }
+        }
+    }
+}
+
+
+void CoalescingHttpEngine::SharedFetch::requestFinished(HttpEngine::Request* request) {
+    buffer.append(request->readAll());
+    engine->closeFetch(this);
+
+    dispatch(&Client::requestFinished, false);
+}
+
+
+bool CoalescingHttpEngine::SharedFetch::dispatch(ClientMethod method, bool progressOnly) {
+    // Clients may delete their requests while we dispatch so we work from a copy of the list and skip requests
+    // that have been detached.
+
+    QList<CoalescedRequest*> recipients = coalescedRequests;
+
+    dispatching = true;
+    for (  QList<CoalescedRequest*>::const_iterator it = recipients.constBegin(), end = recipients.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        CoalescedRequest* coalescedRequest = *it;
+        if (coalescedRequests.contains(coalescedRequest) && (!progressOnly || coalescedRequest->reportProgress)) {
+            (coalescedRequest->client()->*method)(coalescedRequest);
+        }
+    }
+    dispatching = false;
+
+    bool stillExists = !coalescedRequests.isEmpty();
+    if (!stillExists) {
+        delete this;
+    }
+
+    return stillExists;
+}
+
+/***********************************************************************************************************************
+* CoalescingHttpEngine
+*/
+
+CoalescingHttpEngine::CoalescingHttpEngine(HttpEngine* engine, ThreadMetrics* threadMetrics) {
+    currentEngine        = engine;
+    currentThreadMetrics = threadMetrics;
+}
+
+
+CoalescingHttpEngine::~CoalescingHttpEngine() {}
+
+
+void CoalescingHttpEngine::setEngine(HttpEngine* engine) {
+    currentEngine = engine;
+}
+
+
+HttpEngine* CoalescingHttpEngine::engine() const {
+    return currentEngine;
+}
+
+
+HttpEngine::Backend CoalescingHttpEngine::backend() const {
+    return currentEngine->backend();
+}
+
+
+HttpEngine::Request* CoalescingHttpEngine::startRequest(
+        HttpEngine::Client*    client,
+        const QNetworkRequest& request,
+        const QByteArray&      verb,
+        const QByteArray&      body,
+        bool                   reportProgress
+    ) {
+    QByteArray   key   = fetchKey(request, verb, body);
+    SharedFetch* fetch = fetchesByKey.value(key, nullptr);
+
+    if (fetch != nullptr && fetch->joinable()) {
+        currentThreadMetrics->requestCoalesced();
+    } else {
+        // The shared fetch always reports progress since any request that joins it may need the events.  A stale
+        // fetch with the same key is simply replaced; it keeps running for the requests already tied to it.
+
+        fetch = new SharedFetch(this, key);
+        fetchesByKey.insert(key, fetch);
+
+        fetch->request = currentEngine->startRequest(fetch, request, verb, body, true);
+    }
+
+    return new CoalescedRequest(client, fetch, reportProgress);
+}
+
+
+QByteArray CoalescingHttpEngine::fetchKey(
+        const QNetworkRequest& request,
+        const QByteArray&      verb,
+        const QByteArray&      body
+    ) {
+    QByteArray key = verb;
+    key.append(' ');
+    key.append(request.url().toEncoded());
+    key.append('\n');
+    key.append(QByteArray::number(request.transferTimeout()));
+    key.append('\n');
+
+    QList<QByteArray> headerNames = request.rawHeaderList();
+    for (  QList<QByteArray>::const_iterator it = headerNames.constBegin(), end = headerNames.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        key.append(*it);
+        key.append(": ");
+        key.append(request.rawHeader(*it));
+        key.append('\n');
+    }
+
+    // Header lines can not contain a bare newline so the blank line unambiguously separates the body.
+
+    key.append('\n');
+    key.append(body);
+
+    return key;
+}
+
+
+void CoalescingHttpEngine::closeFetch(CoalescingHttpEngine::SharedFetch* fetch) {
+    QHash<QByteArray, SharedFetch*>::iterator it = fetchesByKey.find(fetch->key);
+    if (it != fetchesByKey.end() && it.value() == fetch) {
+        fetchesByKey.erase(it);
+    }
+}
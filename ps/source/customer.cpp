@@ -20,8 +20,6 @@
 
 #include <QObject>
 #include <QString>
-#include <QMutex>
-#include <QMutexLocker>
 
 #include <cstdint>
 
@@ -36,6 +34,8 @@ Customer::Customer(
         bool                 supportsSslExpirationChecking,
         bool                 supportsLatencyMeasurements,
         bool                 supportsMultiRegionTesting,
+        bool                 supportsLatencyPhases,
+        bool                 supportsLatencyAggregation,
         unsigned             pollingInterval,
         HttpServiceThread*   serviceThread
     ):currentServiceThread(
@@ -50,10 +50,17 @@ Customer::Customer(
         supportsLatencyMeasurements
     ),currentSupportsMultiRegionTesting(
         supportsMultiRegionTesting
+    ),currentSupportsLatencyPhases(
+        supportsLatencyPhases
+    ),currentSupportsLatencyAggregation(
+        supportsLatencyAggregation
     ),currentPollingInterval(
         pollingInterval
     ) {
-    currentlyPaused = false;
+    currentlyPaused               = false;
+    currentConfirmationDelay      = defaultConfirmationDelay;
+    currentMaximumRecheckInterval = defaultMaximumRecheckInterval;
+    currentPriority               = Priority::NORMAL;
 
     if (serviceThread != nullptr) {
         serviceThread->customerAdded(this);
@@ -74,14 +81,11 @@ void Customer::addHostScheme(HostScheme* hostScheme) {
 bool Customer::removeHostScheme(HostScheme::HostSchemeId hostSchemeId) {
     bool success;
 
-    hostSchemeMutex.lock();
     HostSchemesByHostSchemeId::iterator it = hostSchemesByHostSchemeId.find(hostSchemeId);
     if (it != hostSchemesByHostSchemeId.end()) {
         HostScheme* hostScheme = it.value();
 
         hostSchemesByHostSchemeId.erase(it);
-        hostSchemeMutex.unlock();
-
         hostScheme->reportExistingMonitors(this, false);
 
         if (currentServiceThread != nullptr) {
@@ -91,7 +95,6 @@ bool Customer::removeHostScheme(HostScheme::HostSchemeId hostSchemeId) {
         delete hostScheme;
         success = true;
     } else {
-        hostSchemeMutex.unlock();
         success = false;
     }
 
@@ -100,13 +103,11 @@ bool Customer::removeHostScheme(HostScheme::HostSchemeId hostSchemeId) {
 
 
 HostScheme* Customer::getHostScheme(HostScheme::HostSchemeId hostSchemeId) const {
-    QMutexLocker locker(&hostSchemeMutex);
     return hostSchemesByHostSchemeId.value(hostSchemeId);
 }
 
 
 Monitor* Customer::getMonitor(Monitor::MonitorId monitorId) const {
-    QMutexLocker locker(&monitorMutex);
     return monitorsByMonitorId.value(monitorId);
 }
 
@@ -166,6 +167,26 @@ void Customer::setSupportsMultiRegionTesting(bool nowSupported) {
 }
 
 
+bool Customer::supportsLatencyPhases() const {
+    return currentSupportsLatencyPhases;
+}
+
+
+void Customer::setSupportsLatencyPhases(bool nowSupported) {
+    currentSupportsLatencyPhases = nowSupported;
+}
+
+
+bool Customer::supportsLatencyAggregation() const {
+    return currentSupportsLatencyAggregation;
+}
+
+
+void Customer::setSupportsLatencyAggregation(bool nowSupported) {
+    currentSupportsLatencyAggregation = nowSupported;
+}
+
+
 unsigned Customer::pollingInterval() const {
     return currentPollingInterval;
 }
@@ -186,22 +207,144 @@ void Customer::setPaused(bool nowPaused) {
 }
 
 
+unsigned Customer::confirmationDelay() const {
+    return currentConfirmationDelay;
+}
+
+
+void Customer::setConfirmationDelay(unsigned newConfirmationDelay) {
+    currentConfirmationDelay = newConfirmationDelay;
+}
+
+
+unsigned Customer::maximumRecheckInterval() const {
+    return currentMaximumRecheckInterval;
+}
+
+
+void Customer::setMaximumRecheckInterval(unsigned newMaximumRecheckInterval) {
+    currentMaximumRecheckInterval = newMaximumRecheckInterval;
+}
+
+
+Customer::Priority Customer::priority() const {
+    return currentPriority;
+}
+
+
+void Customer::setPriority(Priority newPriority) {
+    currentPriority = newPriority;
+}
+
+
+Customer::Priority Customer::toPriority(const QString& name, bool* ok) {
+    Priority result  = Priority::NORMAL;
+    bool     success = true;
+    QString  lower   = name.toLower();
+
+    if (lower == QString("high")) {
+        result = Priority::HIGH;
+    } else if (lower == QString("normal")) {
+        result = Priority::NORMAL;
+    } else if (lower == QString("best_effort")) {
+        result = Priority::BEST_EFFORT;
+    } else {
+        success = false;
+    }
+
+    if (ok != nullptr) {
+        *ok = success;
+    }
+
+    return result;
+}
+
+
+QString Customer::toString(Priority priority) {
+    QString result;
+
+    switch (priority) {
+        case Priority::HIGH:        { result = QString("high");          break; }
+        case Priority::NORMAL:      { result = QString("normal");        break; }
+        case Priority::BEST_EFFORT: { result = QString("best_effort");   break; }
+        default:                    { Q_ASSERT(false);                   break; }
+    }
+
+    return result;
+}
+
+
 unsigned Customer::numberHostSchemes() const {
-    QMutexLocker locker(&hostSchemeMutex);
     return static_cast<unsigned>(hostSchemesByHostSchemeId.size());
 }
 
 
+double Customer::serviceRate(unsigned numberRegions) const {
+    double period = pollingInterval();
+    if (supportsMultiRegionTesting() && numberRegions > 1) {
+        period *= numberRegions;
+    }
+
+    return period > 0 ? numberHostSchemes() / period : 0;
+}
+
+
 unsigned Customer::numberMonitors() const {
-    QMutexLocker locker(&monitorMutex);
     return static_cast<unsigned>(monitorsByMonitorId.size());
 }
 
 
+void Customer::cancelPendingChecks() {
+    for (  HostScheme::MonitorsByMonitorId::const_iterator it  = monitorsByMonitorId.constBegin(),
+                                                           end = monitorsByMonitorId.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        it.value()->cancelCheck();
+    }
+}
+
+
+void Customer::updateFrom(Customer* customer) {
+    currentSupportsPingTesting           = customer->currentSupportsPingTesting;
+    currentSupportsSslExpirationChecking = customer->currentSupportsSslExpirationChecking;
+    currentSupportsLatencyMeasurements   = customer->currentSupportsLatencyMeasurements;
+    currentSupportsLatencyPhases         = customer->currentSupportsLatencyPhases;
+    currentSupportsLatencyAggregation    = customer->currentSupportsLatencyAggregation;
+    currentConfirmationDelay             = customer->currentConfirmationDelay;
+    currentMaximumRecheckInterval        = customer->currentMaximumRecheckInterval;
+    currentPriority                      = customer->currentPriority;
+
+    QList<HostScheme*> existingHostSchemes = hostSchemes();
+    for (  QList<HostScheme*>::const_iterator it  = existingHostSchemes.constBegin(),
+                                              end = existingHostSchemes.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        HostScheme::HostSchemeId hostSchemeId = (*it)->hostSchemeId();
+        if (customer->getHostScheme(hostSchemeId) == nullptr) {
+            removeHostScheme(hostSchemeId);
+        }
+    }
+
+    QList<HostScheme*> newHostSchemes = customer->hostSchemes();
+    for (  QList<HostScheme*>::const_iterator it = newHostSchemes.constBegin(), end = newHostSchemes.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        HostScheme* newHostScheme      = *it;
+        HostScheme* existingHostScheme = getHostScheme(newHostScheme->hostSchemeId());
+        if (existingHostScheme != nullptr) {
+            existingHostScheme->updateFrom(newHostScheme);
+        } else {
+            addHostScheme(newHostScheme);
+        }
+    }
+}
+
+
 void Customer::monitorAdded(Monitor* monitor) {
-    monitorMutex.lock();
     monitorsByMonitorId.insert(monitor->monitorId(), monitor);
-    monitorMutex.unlock();
 
     if (currentServiceThread != nullptr) {
         currentServiceThread->monitorAdded(monitor);
@@ -210,9 +353,7 @@ void Customer::monitorAdded(Monitor* monitor) {
 
 
 void Customer::monitorAboutToBeRemoved(Monitor* monitor) {
-    monitorMutex.lock();
     monitorsByMonitorId.remove(monitor->monitorId());
-    monitorMutex.unlock();
 
     if (currentServiceThread != nullptr) {
         currentServiceThread->monitorAboutToBeRemoved(monitor);
@@ -221,9 +362,7 @@ void Customer::monitorAboutToBeRemoved(Monitor* monitor) {
 
 
 void Customer::hostSchemeAdded(HostScheme* hostScheme) {
-    hostSchemeMutex.lock();
     hostSchemesByHostSchemeId.insert(hostScheme->hostSchemeId(), hostScheme);
-    hostSchemeMutex.unlock();
 
     if (currentServiceThread != nullptr) {
         currentServiceThread->hostSchemeAdded(hostScheme);
@@ -234,11 +373,7 @@ void Customer::hostSchemeAdded(HostScheme* hostScheme) {
 
 
 void Customer::hostSchemeAboutToBeRemoved(HostScheme* hostScheme) {
-    HostScheme::HostSchemeId hostSchemeId = hostScheme->hostSchemeId();
-
-    hostSchemeMutex.lock();
-    hostSchemesByHostSchemeId.remove(hostSchemeId);
-    hostSchemeMutex.unlock();
+    hostSchemesByHostSchemeId.remove(hostScheme->hostSchemeId());
 
     hostScheme->reportExistingMonitors(this, false);
 
@@ -250,8 +385,6 @@ void Customer::hostSchemeAboutToBeRemoved(HostScheme* hostScheme) {
 
 void Customer::reportExistingHostSchemesAndMonitors(HttpServiceThread* serviceThread, bool adding) {
     if (adding) {
-        hostSchemeMutex.lock();
-
         for (  HostSchemesByHostSchemeId::const_iterator hit  = hostSchemesByHostSchemeId.constBegin(),
                                                          hend = hostSchemesByHostSchemeId.constEnd()
              ; hit != hend
@@ -260,9 +393,6 @@ void Customer::reportExistingHostSchemesAndMonitors(HttpServiceThread* serviceTh
             serviceThread->hostSchemeAdded(hit.value());
         }
 
-        hostSchemeMutex.unlock();
-        monitorMutex.lock();
-
         for (  HostScheme::MonitorsByMonitorId::const_iterator mit  = monitorsByMonitorId.constBegin(),
                                                                mend = monitorsByMonitorId.constEnd()
              ; mit != mend
@@ -270,11 +400,7 @@ void Customer::reportExistingHostSchemesAndMonitors(HttpServiceThread* serviceTh
             ) {
             serviceThread->monitorAdded(mit.value());
         }
-
-        monitorMutex.unlock();
     } else {
-        hostSchemeMutex.lock();
-
         for (  HostSchemesByHostSchemeId::const_iterator hit  = hostSchemesByHostSchemeId.constBegin(),
                                                          hend = hostSchemesByHostSchemeId.constEnd()
              ; hit != hend
@@ -283,9 +409,6 @@ void Customer::reportExistingHostSchemesAndMonitors(HttpServiceThread* serviceTh
             serviceThread->hostSchemeAboutToBeRemoved(hit.value());
         }
 
-        hostSchemeMutex.unlock();
-        monitorMutex.lock();
-
         for (  HostScheme::MonitorsByMonitorId::const_iterator it  = monitorsByMonitorId.constBegin(),
                                                                end = monitorsByMonitorId.constEnd()
              ; it != end
@@ -293,7 +416,5 @@ void Customer::reportExistingHostSchemesAndMonitors(HttpServiceThread* serviceTh
             ) {
             serviceThread->monitorAboutToBeRemoved(it.value());
         }
-
-        monitorMutex.unlock();
     }
 }
@@ -27,6 +27,9 @@
 #include <QMutexLocker>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QRandomGenerator>
+#include <QDateTime>
+#include <QHash>
 
 #include <rest_api_out_v1_server.h>
 #include <rest_api_out_v1_inesonic_binary_rest_handler.h>
@@ -34,6 +37,7 @@
 
 #include <cstdint>
 #include <cstring>
+#include <algorithm>
 
 #include "log.h"
 #include "metatypes.h"
@@ -41,6 +45,10 @@
 #include "service_thread_tracker.h"
 #include "event_reporter.h"
 #include "certificate_reporter.h"
+#include "latency_ring.h"
+#include "latency_report_encoder.h"
+#include "latency_spill.h"
+#include "latency_batch.h"
 #include "data_aggregator.h"
 
 const QString  DataAggregator::latencyRecordPath("/latency/record");
@@ -104,7 +112,28 @@ DataAggregator::DataAggregator(
 
 
 DataAggregator::~DataAggregator() {
+    // Unsent entries are kept in the spill file, when there is one, so they can be replayed after a restart.
+
+    if (latencySpill->isEnabled()) {
+        for (  QList<LatencyBatch*>::const_iterator it = inFlightBatches.constBegin(), end = inFlightBatches.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            latencySpill->append((*it)->entries(), (*it)->numberEntries());
+        }
+
+        latencySpill->append(*latencyEntryList, static_cast<unsigned long>(latencyEntryList->size()));
+    }
+
     delete latencyEntryList;
+    delete latencySpill;
+
+    for (  QList<LatencyRing*>::const_iterator it = latencyRings.constBegin(), end = latencyRings.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        delete *it;
+    }
 }
 
 
@@ -138,20 +167,121 @@ void DataAggregator::setServerIdentifier(const QString& newServerIdentifier) {
 }
 
 
+void DataAggregator::setMaximumInFlightEventBatches(unsigned newMaximumInFlightEventBatches) {
+    eventReporter->setMaximumInFlightBatches(newMaximumInFlightEventBatches);
+}
+
+
+void DataAggregator::setMaximumInFlightReports(unsigned newMaximumInFlightReports) {
+    currentMaximumInFlightReports = newMaximumInFlightReports > 0 ? newMaximumInFlightReports : 1;
+}
+
+
+unsigned DataAggregator::numberInFlightReports() const {
+    return currentNumberInFlightReports.load(std::memory_order_relaxed);
+}
+
+
+bool DataAggregator::setLatencySpillFile(const QString& newFilename) {
+    bool success = latencySpill->setFilename(newFilename);
+
+    if (success && inFlightBatches.isEmpty() && latencySpill->size() > 0) {
+        emit triggerReporting(LatencyBatch::jitter(replayDelayMilliseconds));
+    }
+
+    return success;
+}
+
+
+unsigned long DataAggregator::latencySummaryBacklog() const {
+    return currentNumberListedSummaries.load(std::memory_order_relaxed);
+}
+
+
+unsigned long DataAggregator::latencyBacklog() const {
+    unsigned long result = (
+          currentNumberListedEntries.load(std::memory_order_relaxed)
+        + latencySpill->size()
+    );
+
+    ringMutex.lock();
+    for (  QList<LatencyRing*>::const_iterator it = latencyRings.constBegin(), end = latencyRings.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        result += (*it)->size();
+    }
+    ringMutex.unlock();
+
+    QMutexLocker locker(&overflowMutex);
+    result += static_cast<unsigned long>(overflowEntries.size());
+
+    return result;
+}
+
+
+unsigned long DataAggregator::spilledLatencyEntries() const {
+    return latencySpill->size();
+}
+
+
+unsigned long long DataAggregator::droppedLatencyEntries() const {
+    return currentNumberDroppedEntries.load(std::memory_order_relaxed);
+}
+
+
+unsigned long DataAggregator::numberQueuedEvents() const {
+    return eventReporter->numberQueuedEvents();
+}
+
+
+unsigned DataAggregator::numberInFlightEventBatches() const {
+    return eventReporter->numberInFlightBatches();
+}
+
+
+LatencyRing* DataAggregator::createLatencyRing() {
+    LatencyRing* latencyRing = new LatencyRing;
+
+    QMutexLocker locker(&ringMutex);
+    latencyRings.append(latencyRing);
+
+    return latencyRing;
+}
+
+
+void DataAggregator::releaseLatencyRing(LatencyRing* latencyRing) {
+    QMutexLocker locker(&ringMutex);
+    releasedLatencyRings.append(latencyRing);
+}
+
+
 void DataAggregator::recordLatency(
-        DataAggregator::MonitorId           monitorId,
-        unsigned long long                  timestamp,
-        DataAggregator::LatencyMicroseconds latency
+        LatencyRing*                         latencyRing,
+        DataAggregator::MonitorId            monitorId,
+        unsigned long long                   timestamp,
+        DataAggregator::LatencyMicroseconds  latency,
+        const DataAggregator::LatencyPhases& phases,
+        bool                                 aggregated
     ) {
-    QMutexLocker locker(&listMutex);
-    latencyEntryList->append(LatencyEntry(monitorId, timestamp, latency));
+    LatencyEntry entry(monitorId, timestamp, latency, phases, aggregated);
+    if (!latencyRing->append(entry)) {
+        // The ring is full which means we've fallen well behind.  Fall back to the slow path rather than drop the
+        // sample.
 
-    if (inFlightLatencyEntryList == nullptr) {
-        if (static_cast<unsigned>(latencyEntryList->size()) >= maximumNumberPendingEntries) {
-            emit triggerReporting();
-        } else if (!reportTimer->isActive()) {
-            emit triggerReporting(maximumReportDelayMilliseconds);
+        QMutexLocker locker(&overflowMutex);
+        overflowEntries.append(entry);
+    }
+
+    // The flags limit us to a single cross-thread signal per report rather than one per sample.
+
+    if (latencyRing->size() >= maximumNumberPendingEntries) {
+        if (!immediateReportRequested.load(std::memory_order_relaxed)  &&
+            !immediateReportRequested.exchange(true)                      ) {
+            emit triggerReporting(0);
         }
+    } else if (!reportScheduled.load(std::memory_order_relaxed) && !reportScheduled.exchange(true)) {
+        emit triggerReporting(maximumReportDelayMilliseconds);
     }
 }
 
@@ -189,6 +319,11 @@ void DataAggregator::sendReport() {
 }
 
 
+void DataAggregator::sendReportWithin(unsigned long window) {
+    emit triggerReporting(QRandomGenerator::global()->bounded(static_cast<quint32>(window + 1)));
+}
+
+
 void DataAggregator::processReportEvent(
         unsigned long      monitorId,
         unsigned long long timestamp,
@@ -219,90 +354,125 @@ void DataAggregator::processReportSslCertificateExpirationChange(
 }
 
 
-void DataAggregator::processResponse(const QByteArray& binaryData, const QString& contentType) {
-    if (contentType == QString("application/json")) {
-        QJsonDocument jsonDocument = QJsonDocument::fromJson(binaryData);
-        if (jsonDocument.isObject()) {
-            QJsonObject responseObject = jsonDocument.object();
-            QString     status         = responseObject.value("status").toString();
-            if (status == QString("OK")) {
-                unsigned long numberEntries = static_cast<unsigned long>(inFlightLatencyEntryList->size());
-                if (numberEntries > 0) {
-                    logWrite(
-                        QString("Sent %1 latency entries for timestamps %2-%3.")
-                        .arg(inFlightLatencyEntryList->size())
-                        .arg(inFlightLatencyEntryList->first().unixTimestamp())
-                        .arg(inFlightLatencyEntryList->last().unixTimestamp()),
-                        false
-                    );
-                } else {
-                    logWrite(QString("Sent empty latency entry report."), false);
-                }
+void DataAggregator::batchResponseReceived(
+        LatencyBatch* batch,
+        bool          accepted,
+        unsigned      supportedVersion,
+        bool          compressionAccepted
+    ) {
+    unsigned newVersion = (
+          supportedVersion > LatencyReportEncoder::maximumSupportedVersion
+        ? LatencyReportEncoder::maximumSupportedVersion
+        : supportedVersion
+    );
+    if (newVersion != currentReportVersion) {
+        logMessage(
+            LogLevel::INFO,
+            QString("Latency report version changed from %1 to %2.").arg(currentReportVersion).arg(newVersion)
+        );
 
-                delete inFlightLatencyEntryList;
+        currentReportVersion = newVersion;
 
-                QMutexLocker locker(&listMutex);
-                inFlightLatencyEntryList = nullptr;
+        // New samples stop being aggregated as soon as the version drops.  Summaries already taken can't be sent.
 
-                unsigned long currentNumberEntries = static_cast<unsigned>(latencyEntryList->size());
-                if (currentNumberEntries >= maximumNumberPendingEntries) {
-                    emit triggerReporting();
-                } else if (currentNumberEntries > 0) {
-                    emit triggerReporting(maximumReportDelayMilliseconds);
-                }
-            } else {
-                processRequestFailed(QString("Database controller reported \"%1\"").arg(status));
-            }
-        } else {
-            processRequestFailed(QString("Expected JSON object."));
+        if (newVersion < LatencyReportEncoder::firstAggregatedVersion) {
+            discardLatencySummaries();
         }
-    } else {
-        processRequestFailed(QString("Unexpected response content type."));
     }
-}
 
+    currentCompressionAccepted = compressionAccepted;
 
-void DataAggregator::processRequestFailed(const QString& errorString) {
-    logWrite(
-        QString("Latency report failed: %1 -- retrying in %2 seconds.")
-        .arg(errorString)
-        .arg(retryDelaySeconds),
-        false
-    );
+    if (accepted) {
+        inFlightBatches.removeOne(batch);
+        idleBatches.append(batch);
+
+        publishBacklog();
+
+        reportScheduled.store(false);
+        immediateReportRequested.store(false);
 
-    emit triggerRetry(1000 * retryDelaySeconds);
+        // A large backlog is paced out a report at a time rather than sent back to back.
+
+        unsigned long currentNumberEntries = numberPendingEntries();
+        if (replayingBacklog()) {
+            emit triggerReporting(LatencyBatch::jitter(replayDelayMilliseconds));
+        } else if (currentNumberEntries >= maximumNumberPendingEntries) {
+            emit triggerReporting();
+        } else if (currentNumberEntries > 0) {
+            emit triggerReporting(maximumReportDelayMilliseconds);
+        }
+    }
+}
+
+
+void DataAggregator::startReportTimer(unsigned long delay) {
+    if (!reportTimer->isActive() || static_cast<unsigned long>(reportTimer->remainingTime()) > delay) {
+        reportTimer->start(static_cast<int>(delay));
+    }
 }
 
 
 void DataAggregator::startReportingLatencyData() {
-    listMutex.lock();
-    if (inFlightLatencyEntryList == nullptr) {
-        inFlightLatencyEntryList = latencyEntryList;
+    // Clear the flags before draining so that any entry recorded after the drain schedules a new report.
 
-        latencyEntryList = new LatencyEntryList;
-        latencyEntryList->reserve(inFlightLatencyEntryList->size());
+    reportScheduled.store(false);
+    immediateReportRequested.store(false);
 
-        listMutex.unlock();
+    drainLatencyRings();
 
-        sendReport(*inFlightLatencyEntryList);
-    } else {
-        listMutex.unlock();
+    // An empty report is only sent when nothing is in flight.  The report still carries our loading data.
+
+    unsigned window = reportWindow();
+    while (static_cast<unsigned>(inFlightBatches.size()) < window &&
+           (inFlightBatches.isEmpty()     ||
+            latencySpill->size() > 0      ||
+            !latencyEntryList->isEmpty()  ||
+            summariesReportable()           )                      ) {
+        LatencyEntryList   entries;
+        LatencySummaryList summaries;
+        takeReportEntries(entries, summaries);
+
+        unsigned long long sequenceNumber = nextSequenceNumber;
+        ++nextSequenceNumber;
+
+        LatencyBatch* batch = idleBatch();
+        inFlightBatches.append(batch);
+
+        batch->send(entries, summaries, sequenceNumber);
     }
-}
 
+    publishBacklog();
+
+    // Open windows still need to be closed and sent, even if no new samples arrive.
 
-void DataAggregator::startRetry() {
-    if (inFlightLatencyEntryList != nullptr) {
-        sendReport(*inFlightLatencyEntryList);
+    if (!openSummaries.isEmpty()) {
+        startReportTimer(maximumReportDelayMilliseconds);
     }
 }
 
 
 void DataAggregator::configure() {
-    latencyEntryList         = new LatencyEntryList();
-    inFlightLatencyEntryList = nullptr;
+    latencyEntryList = new LatencyEntryList();
+    latencySpill     = new LatencySpill;
+
+    currentNumberListedEntries.store(0);
+    currentNumberListedSummaries.store(0);
+    currentNumberDroppedEntries.store(0);
+
+    nextSummaryCloseTimestamp = 0;
+
+    currentMaximumInFlightReports = defaultMaximumInFlightReports;
+    currentNumberInFlightReports.store(0);
+    currentSessionId              = QRandomGenerator::global()->generate();
+    nextSequenceNumber            = 1;
+
+    reportScheduled.store(false);
+    immediateReportRequested.store(false);
+
+    currentReportVersion       = 0;
+    currentCompressionAccepted = false;
+
     reportTimer              = new QTimer(this);
-    retryTimer               = new QTimer(this);
 
     eventReporter            = new EventReporter(server(), this);
 
@@ -311,16 +481,7 @@ void DataAggregator::configure() {
 
     reportTimer->setSingleShot(true);
     connect(reportTimer, &QTimer::timeout, this, &DataAggregator::startReportingLatencyData);
-    connect(
-        this,
-        &DataAggregator::triggerReporting,
-        reportTimer,
-        static_cast<void (QTimer::*)(int)>(&QTimer::start)
-    );
-
-    retryTimer->setSingleShot(true);
-    connect(retryTimer, &QTimer::timeout, this, &DataAggregator::startRetry);
-    connect(this, &DataAggregator::triggerRetry, retryTimer, static_cast<void (QTimer::*)(int)>(&QTimer::start));
+    connect(this, &DataAggregator::triggerReporting, this, &DataAggregator::startReportTimer);
 
     connect(this, &DataAggregator::reportEventRequested, this, &DataAggregator::processReportEvent);
     connect(
@@ -332,28 +493,395 @@ void DataAggregator::configure() {
 }
 
 
-void DataAggregator::sendReport(const DataAggregator::LatencyEntryList& latencyEntryList) {
-    unsigned long numberLatencyEntries = static_cast<unsigned long>(latencyEntryList.size());
-    QByteArray    message(sizeof(Header) + numberLatencyEntries * sizeof(Entry), '\x00');
+void DataAggregator::drainLatencyRings() {
+    int firstEntry = latencyEntryList->size();
+
+    ringMutex.lock();
+    for (  QList<LatencyRing*>::const_iterator it = latencyRings.constBegin(), end = latencyRings.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        (*it)->drain(*latencyEntryList);
+    }
+
+    for (  QList<LatencyRing*>::const_iterator it  = releasedLatencyRings.constBegin(),
+                                               end = releasedLatencyRings.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        latencyRings.removeOne(*it);
+        delete *it;
+    }
+
+    releasedLatencyRings.clear();
+    ringMutex.unlock();
+
+    QMutexLocker locker(&overflowMutex);
+    if (!overflowEntries.isEmpty()) {
+        logMessage(
+            LogLevel::WARNING,
+            QString("%1 latency entries overflowed the latency rings.").arg(overflowEntries.size())
+        );
+
+        latencyEntryList->append(overflowEntries);
+        overflowEntries.clear();
+    }
+    locker.unlock();
+
+    aggregateLatencyEntries(firstEntry);
+    closeLatencySummaries();
+    limitLatencyEntryList();
+
+    publishBacklog();
+}
+
+
+void DataAggregator::aggregateLatencyEntries(int firstEntry) {
+    if (currentReportVersion >= LatencyReportEncoder::firstAggregatedVersion) {
+        // Entries that are folded into a summary are removed from the list, compacting the list in place.
+
+        LatencyEntry* entries       = latencyEntryList->data();
+        int           numberEntries = latencyEntryList->size();
+        int           destination   = firstEntry;
+
+        for (int source=firstEntry ; source<numberEntries ; ++source) {
+            const LatencyEntry& entry = entries[source];
+            if (entry.aggregated()) {
+                ZoranTimeStamp timestamp   = entry.zoranTimestamp();
+                ZoranTimeStamp windowStart = timestamp - timestamp % aggregationWindowSeconds;
+                std::uint64_t  key         = (static_cast<std::uint64_t>(entry.monitorId()) << 32) | windowStart;
+
+                QHash<std::uint64_t, LatencySummary>::iterator summaryIterator = openSummaries.find(key);
+                if (summaryIterator == openSummaries.end()) {
+                    summaryIterator = openSummaries.insert(key, LatencySummary(entry.monitorId(), windowStart));
+
+                    unsigned long long closeTimestamp = (
+                          LatencyEntry::toUnixTimestamp(windowStart)
+                        + aggregationWindowSeconds
+                        + aggregationGraceSeconds
+                    );
+
+                    if (nextSummaryCloseTimestamp == 0 || closeTimestamp < nextSummaryCloseTimestamp) {
+                        nextSummaryCloseTimestamp = closeTimestamp;
+                    }
+                }
+
+                summaryIterator.value().sketch().record(entry.latencyMicroseconds());
+            } else {
+                if (destination != source) {
+                    entries[destination] = entry;
+                }
+
+                ++destination;
+            }
+        }
+
+        if (destination < numberEntries) {
+            latencyEntryList->resize(destination);
+        }
+    }
+}
+
+
+void DataAggregator::closeLatencySummaries() {
+    unsigned long long now = static_cast<unsigned long long>(QDateTime::currentSecsSinceEpoch());
+    if (!openSummaries.isEmpty() && now >= nextSummaryCloseTimestamp) {
+        nextSummaryCloseTimestamp = 0;
+
+        QHash<std::uint64_t, LatencySummary>::iterator it = openSummaries.begin();
+        while (it != openSummaries.end()) {
+            unsigned long long closeTimestamp = (
+                  LatencyEntry::toUnixTimestamp(it.value().windowStart())
+                + aggregationWindowSeconds
+                + aggregationGraceSeconds
+            );
+
+            if (now >= closeTimestamp) {
+                pendingSummaries.append(it.value());
+                it = openSummaries.erase(it);
+            } else {
+                if (nextSummaryCloseTimestamp == 0 || closeTimestamp < nextSummaryCloseTimestamp) {
+                    nextSummaryCloseTimestamp = closeTimestamp;
+                }
+
+                ++it;
+            }
+        }
+
+        if (pendingSummaries.size() > maximumListedSummaries) {
+            int           excess         = pendingSummaries.size() - maximumListedSummaries;
+            unsigned long droppedSamples = 0;
+            for (int i=0 ; i<excess ; ++i) {
+                droppedSamples += pendingSummaries.at(i).sketch().count();
+            }
+
+            pendingSummaries.remove(0, excess);
+
+            currentNumberDroppedEntries.fetch_add(droppedSamples, std::memory_order_relaxed);
+            logWrite(
+                QString("Latency summary backlog is full, discarded %1 summaries covering %2 latency entries.")
+                .arg(excess)
+                .arg(droppedSamples),
+                true
+            );
+        }
+    }
+}
+
+
+bool DataAggregator::summariesReportable() const {
+    return (
+           currentReportVersion >= LatencyReportEncoder::firstAggregatedVersion
+        && !pendingSummaries.isEmpty()
+    );
+}
+
+
+void DataAggregator::publishBacklog() {
+    unsigned long numberInFlightEntries   = 0;
+    unsigned long numberInFlightSummaries = 0;
+    for (  QList<LatencyBatch*>::const_iterator it = inFlightBatches.constBegin(), end = inFlightBatches.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        numberInFlightEntries   += (*it)->numberEntries();
+        numberInFlightSummaries += (*it)->numberSummaries();
+    }
 
-    std::uint8_t* messageData = reinterpret_cast<std::uint8_t*>(message.data());
-    Header*       header      = reinterpret_cast<Header*>(messageData);
-    Entry*        entry       = reinterpret_cast<Entry*>(messageData + sizeof(Header));
+    currentNumberInFlightReports.store(static_cast<unsigned>(inFlightBatches.size()), std::memory_order_relaxed);
+    currentNumberListedEntries.store(
+        static_cast<unsigned long>(latencyEntryList->size()) + numberInFlightEntries,
+        std::memory_order_relaxed
+    );
+    currentNumberListedSummaries.store(
+        static_cast<unsigned long>(openSummaries.size() + pendingSummaries.size()) + numberInFlightSummaries,
+        std::memory_order_relaxed
+    );
+}
+
+
+void DataAggregator::discardLatencySummaries() {
+    unsigned long numberSummaries = static_cast<unsigned long>(openSummaries.size() + pendingSummaries.size());
+    unsigned long droppedSamples  = 0;
+
+    for (  QHash<std::uint64_t, LatencySummary>::const_iterator it  = openSummaries.constBegin(),
+                                                                end = openSummaries.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        droppedSamples += it.value().sketch().count();
+    }
+
+    for (  LatencySummaryList::const_iterator it = pendingSummaries.constBegin(), end = pendingSummaries.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        droppedSamples += it->sketch().count();
+    }
+
+    for (  QList<LatencyBatch*>::const_iterator it = inFlightBatches.constBegin(), end = inFlightBatches.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        numberSummaries += (*it)->numberSummaries();
+        droppedSamples  += (*it)->discardSummaries();
+    }
+
+    openSummaries.clear();
+    pendingSummaries.clear();
+    nextSummaryCloseTimestamp = 0;
+
+    if (numberSummaries > 0) {
+        currentNumberDroppedEntries.fetch_add(droppedSamples, std::memory_order_relaxed);
+        logMessage(
+            LogLevel::WARNING,
+            QString("Database controller no longer accepts latency summaries, discarded %1 summaries covering %2 "
+                    "latency entries.")
+            .arg(numberSummaries)
+            .arg(droppedSamples)
+        );
+    }
+
+    publishBacklog();
+}
+
+
+void DataAggregator::limitLatencyEntryList() {
+    unsigned long numberEntries = static_cast<unsigned long>(latencyEntryList->size());
+    if (numberEntries > maximumListedEntries) {
+        // The oldest entries go to the back of the spill file, preserving the order entries are reported in.
+
+        unsigned long excess    = numberEntries - maximumListedEntries;
+        unsigned long discarded = latencySpill->append(*latencyEntryList, excess);
+        if (discarded > 0) {
+            currentNumberDroppedEntries.fetch_add(discarded, std::memory_order_relaxed);
+            logWrite(QString("Latency backlog is full, discarded %1 latency entries.").arg(discarded), true);
+        }
+
+        latencyEntryList->remove(0, static_cast<int>(excess));
+    }
+}
+
+
+bool DataAggregator::replayingBacklog() const {
+    return (
+           latencySpill->size() > 0
+        || static_cast<unsigned long>(latencyEntryList->size()) > maximumEntriesPerReport
+        || pendingSummaries.size() > maximumSummariesPerReport
+    );
+}
+
+
+unsigned DataAggregator::reportWindow() const {
+    // Without sequence numbers the database controller can't discard duplicates so we send one report at a time.
+
+    return (
+          currentReportVersion >= LatencyReportEncoder::firstSequencedVersion
+        ? currentMaximumInFlightReports
+        : 1
+    );
+}
+
+
+void DataAggregator::takeReportEntries(
+        DataAggregator::LatencyEntryList&   entries,
+        DataAggregator::LatencySummaryList& summaries
+    ) {
+    if (latencySpill->size() > 0) {
+        // Spilled entries are always older than the entries held in memory so they're replayed first.
+
+        latencySpill->take(entries, maximumEntriesPerReport);
+    } else if (static_cast<unsigned long>(latencyEntryList->size()) > maximumEntriesPerReport) {
+        int numberEntries = static_cast<int>(maximumEntriesPerReport);
+
+        entries = latencyEntryList->mid(0, numberEntries);
+        latencyEntryList->remove(0, numberEntries);
+    } else {
+        entries.swap(*latencyEntryList);
+        latencyEntryList->reserve(entries.size());
+    }
+
+    if (summariesReportable()) {
+        if (pendingSummaries.size() > maximumSummariesPerReport) {
+            summaries = pendingSummaries.mid(0, maximumSummariesPerReport);
+            pendingSummaries.remove(0, maximumSummariesPerReport);
+        } else {
+            summaries.swap(pendingSummaries);
+        }
+    }
+}
+
+
+LatencyBatch* DataAggregator::idleBatch() {
+    LatencyBatch* result;
+
+    if (!idleBatches.isEmpty()) {
+        result = idleBatches.takeLast();
+    } else {
+        result = new LatencyBatch(
+            [this](
+                    const LatencyEntryList&   entries,
+                    const LatencySummaryList& summaries,
+                    unsigned long long        sequenceNumber
+                ) {
+                return buildReport(entries, summaries, sequenceNumber);
+            },
+            server(),
+            this
+        );
+
+        // Queued so that a batch is never reused from within its own response handler.
+        connect(
+            result,
+            &LatencyBatch::responseReceived,
+            this,
+            &DataAggregator::batchResponseReceived,
+            Qt::QueuedConnection
+        );
+    }
+
+    return result;
+}
+
+
+unsigned long DataAggregator::numberPendingEntries() const {
+    unsigned long result = static_cast<unsigned long>(latencyEntryList->size());
+
+    ringMutex.lock();
+    for (  QList<LatencyRing*>::const_iterator it = latencyRings.constBegin(), end = latencyRings.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        result += (*it)->size();
+    }
+    ringMutex.unlock();
+
+    QMutexLocker locker(&overflowMutex);
+    result += static_cast<unsigned long>(overflowEntries.size());
+
+    return result;
+}
+
+
+QByteArray DataAggregator::buildReport(
+        const DataAggregator::LatencyEntryList&   latencyEntryList,
+        const DataAggregator::LatencySummaryList& latencySummaryList,
+        unsigned long long                        sequenceNumber
+    ) {
+    QByteArray message(sizeof(Header), '\x00');
+    Header*    header = reinterpret_cast<Header*>(message.data());
 
     memcpy(header, &headerTemplate, sizeof(Header));
+    header->version           = static_cast<std::uint16_t>(currentReportVersion);
     header->monitorsPerSecond = static_cast<std::uint32_t>(currentServiceThreadTracker->monitorsPerSecond() * 256.0);
     header->cpuLoading        = std::min(65535U, static_cast<unsigned>(cpuUtilization() * 4096.0));
     header->memoryLoading     = std::min(65535U, static_cast<unsigned>(memoryUtilization() * 65536.0));
+    header->networkLoading    = std::min(65535U, static_cast<unsigned>(networkUtilization() * 65536.0));
     header->serverStatusCode  = static_cast<std::uint8_t>(currentServiceThreadTracker->status());
+    header->sheddingLevel     = static_cast<std::uint8_t>(currentServiceThreadTracker->sheddingLevel());
+    header->compression       = noCompression;
 
-    for (unsigned long i=0 ; i<numberLatencyEntries ; ++i) {
-        const LatencyEntry& latencyEntry = latencyEntryList.at(i);
-        entry->monitorId           = latencyEntry.monitorId();
-        entry->timestamp           = latencyEntry.zoranTimestamp();
-        entry->latencyMicroseconds = latencyEntry.latencyMicroseconds();
+    QByteArray body;
+    if (currentReportVersion == 0) {
+        LatencyReportEncoder::encodeFixed(latencyEntryList, body);
+    } else {
+        if (currentReportVersion == 1) {
+            LatencyReportEncoder::encodeCompact(latencyEntryList, body);
+        } else if (currentReportVersion == 2) {
+            LatencyReportEncoder::encodePhased(latencyEntryList, body);
+        } else if (currentReportVersion == 3) {
+            LatencyReportEncoder::encodeSequenced(latencyEntryList, currentSessionId, sequenceNumber, body);
+        } else if (currentReportVersion == 4) {
+            LatencyReportEncoder::encodeAggregated(
+                latencyEntryList,
+                latencySummaryList,
+                aggregationWindowSeconds,
+                currentSessionId,
+                sequenceNumber,
+                body
+            );
+        } else {
+            LatencyReportEncoder::encodeDetailed(
+                latencyEntryList,
+                latencySummaryList,
+                aggregationWindowSeconds,
+                currentSessionId,
+                sequenceNumber,
+                body
+            );
+        }
 
-        ++entry;
+        if (currentCompressionAccepted && body.size() >= minimumCompressionSize) {
+            QByteArray compressedBody = qCompress(body);
+            if (compressedBody.size() < body.size()) {
+                header->compression = deflateCompression;
+                body                = compressedBody;
+            }
+        }
     }
 
-    post(latencyRecordPath, message);
+    // Note that the header pointer is invalid once the body is appended.
+    message.append(body);
+
+    return message;
 }
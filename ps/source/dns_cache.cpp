@@ -0,0 +1,264 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref DnsCache class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include <cstdint>
+
+#include "timing_wheel.h"
+#include "dns_cache.h"
+
+/***********************************************************************************************************************
+* DnsCache::HostEntry
+*/
+
+DnsCache::HostEntry::HostEntry(
+        DnsCache*      dnsCache,
+        const QString& hostName
+    ):TimingWheel::Entry(
+        dnsCache
+    ),hostName(
+        hostName
+    ) {
+    expirationTime = 0;
+    lastUsedTime   = 0;
+    refreshPending = false;
+    lookupRunning  = false;
+}
+
+
+DnsCache::HostEntry::~HostEntry() {}
+
+/***********************************************************************************************************************
+* DnsCache::LookupTask
+*/
+
+class DnsCache::LookupTask:public QRunnable {
+    public:
+        /**
+         * Constructor
+         *
+         * \param[in] dnsCache The DNS cache to receive the results.
+         *
+         * \param[in] hostName The host name to be resolved.
+         */
+        LookupTask(DnsCache* dnsCache, const QString& hostName):currentDnsCache(dnsCache),currentHostName(hostName) {}
+
+        ~LookupTask() override {}
+
+        /**
+         * Method that performs the lookup.
+         */
+        void run() override {
+            // Unlike QHostInfo::lookupHost, QHostInfo::fromName always performs a new lookup and then updates Qt's
+            // internal cache with the result.
+
+            QHostInfo hostInfo = QHostInfo::fromName(currentHostName);
+
+            DnsCache* dnsCache = currentDnsCache;
+            QString   hostName = currentHostName;
+            QMetaObject::invokeMethod(
+                dnsCache,
+                [dnsCache, hostName, hostInfo]() {
+                    dnsCache->lookupCompleted(hostName, hostInfo);
+                }
+            );
+        }
+
+    private:
+        /**
+         * The DNS cache to receive the results.
+         */
+        DnsCache* currentDnsCache;
+
+        /**
+         * The host name to be resolved.
+         */
+        QString currentHostName;
+};
+
+/***********************************************************************************************************************
+* DnsCache
+*/
+
+DnsCache::DnsCache(QObject* parent):QObject(parent) {
+    timingWheel = new TimingWheel(this);
+    lookupThreadPool.setMaxThreadCount(maximumConcurrentLookups);
+}
+
+
+DnsCache::~DnsCache() {
+    lookupThreadPool.waitForDone();
+
+    for (  EntriesByHostName::const_iterator it = entriesByHostName.constBegin(), end = entriesByHostName.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        HostEntry* entry = it.value();
+        timingWheel->cancel(entry);
+        delete entry;
+    }
+}
+
+
+void DnsCache::prefetch(const QString& hostName, unsigned long long pollTime) {
+    bool refreshNeeded = false;
+
+    entryMutex.lock();
+
+    HostEntry* entry = entriesByHostName.value(hostName, nullptr);
+    if (entry == nullptr && QHostAddress(hostName).isNull()) {
+        entry = new HostEntry(this, hostName);
+        entriesByHostName.insert(hostName, entry);
+    }
+
+    if (entry != nullptr) {
+        entry->lastUsedTime = TimingWheel::currentTime();
+        if (!entry->refreshPending && entry->expirationTime <= pollTime) {
+            entry->refreshPending = true;
+            refreshNeeded         = true;
+        }
+    }
+
+    entryMutex.unlock();
+
+    if (refreshNeeded) {
+        // The timing wheel can only be touched from our own thread so we hand the scheduling work off to our thread.
+
+        QMetaObject::invokeMethod(
+            this,
+            [this, hostName, pollTime]() {
+                scheduleRefresh(hostName, pollTime);
+            }
+        );
+    }
+}
+
+
+bool DnsCache::lookup(const QString& hostName, QHostAddress& address) const {
+    bool success;
+
+    QMutexLocker locker(&entryMutex);
+    HostEntry*   entry = entriesByHostName.value(hostName, nullptr);
+    if (entry != nullptr                                         &&
+        !entry->addresses.isEmpty()                              &&
+        entry->expirationTime > TimingWheel::currentTime()          ) {
+        address = entry->addresses.first();
+        success = true;
+    } else {
+        success = false;
+    }
+
+    return success;
+}
+
+
+bool DnsCache::isUnresolvable(const QString& hostName) const {
+    QMutexLocker locker(&entryMutex);
+    HostEntry*   entry = entriesByHostName.value(hostName, nullptr);
+    return (
+           entry != nullptr
+        && entry->addresses.isEmpty()
+        && entry->expirationTime > TimingWheel::currentTime()
+    );
+}
+
+
+unsigned long DnsCache::numberEntries() const {
+    QMutexLocker locker(&entryMutex);
+    return static_cast<unsigned long>(entriesByHostName.size());
+}
+
+
+void DnsCache::timerExpired(TimingWheel::Entry* entry, unsigned long long currentTime) {
+    HostEntry* hostEntry = static_cast<HostEntry*>(entry);
+
+    QMutexLocker locker(&entryMutex);
+    if (hostEntry->refreshPending) {
+        hostEntry->lookupRunning = true;
+        lookupThreadPool.start(new LookupTask(this, hostEntry->hostName));
+    } else if (hostEntry->lastUsedTime + idleTimeout <= currentTime) {
+        entriesByHostName.remove(hostEntry->hostName);
+        delete hostEntry;
+    } else {
+        timingWheel->schedule(hostEntry, hostEntry->lastUsedTime + idleTimeout);
+    }
+}
+
+
+void DnsCache::scheduleRefresh(const QString& hostName, unsigned long long pollTime) {
+    QMutexLocker locker(&entryMutex);
+    HostEntry*   entry = entriesByHostName.value(hostName, nullptr);
+    if (entry != nullptr && entry->refreshPending && !entry->lookupRunning) {
+        // Hosts we've never resolved are resolved immediately.  Other hosts are resolved just before their next poll
+        // so the result is as fresh as possible when it's used.
+
+        unsigned long long refreshTime;
+        if (entry->expirationTime == 0 || pollTime <= prefetchLeadTime) {
+            refreshTime = 0;
+        } else {
+            refreshTime = pollTime - prefetchLeadTime;
+        }
+
+        timingWheel->schedule(entry, refreshTime);
+    }
+}
+
+
+void DnsCache::lookupCompleted(const QString& hostName, const QHostInfo& hostInfo) {
+    bool addressNowChanged = false;
+
+    entryMutex.lock();
+
+    HostEntry* entry = entriesByHostName.value(hostName, nullptr);
+    if (entry != nullptr) {
+        unsigned long long currentTime = TimingWheel::currentTime();
+
+        QList<QHostAddress> newAddresses = hostInfo.addresses();
+        if (hostInfo.error() == QHostInfo::HostInfoError::NoError && !newAddresses.isEmpty()) {
+            addressNowChanged     = !entry->addresses.isEmpty() && !newAddresses.contains(entry->addresses.first());
+            entry->addresses      = newAddresses;
+            entry->expirationTime = currentTime + positiveTimeToLive;
+        } else {
+            entry->addresses.clear();
+            entry->expirationTime = currentTime + negativeTimeToLive;
+        }
+
+        entry->refreshPending = false;
+        entry->lookupRunning  = false;
+
+        timingWheel->schedule(entry, entry->lastUsedTime + idleTimeout);
+    }
+
+    entryMutex.unlock();
+
+    if (addressNowChanged) {
+        emit addressChanged(hostName);
+    }
+}
@@ -0,0 +1,229 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref EventBatch class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QTimer>
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+
+#include <rest_api_out_v1_server.h>
+#include <rest_api_out_v1_inesonic_rest_handler.h>
+
+#include "log.h"
+#include "host_scheme.h"
+#include "monitor.h"
+#include "event_batch.h"
+
+/***********************************************************************************************************************
+* EventBatch::Event
+*/
+
+QJsonObject EventBatch::Event::toJson() const {
+    QJsonObject result;
+
+    result.insert("monitor_id", static_cast<double>(currentMonitorId));
+    result.insert("timestamp", static_cast<double>(currentTimestamp));
+    result.insert("event_type", toString(currentEventType));
+    result.insert("monitor_status", toString(currentMonitorStatus));
+    result.insert("message", currentMessage);
+
+    if (!currentHash.isEmpty()) {
+        result.insert("hash", QString::fromUtf8(currentHash.toBase64()));
+    }
+
+    return result;
+}
+
+
+QString EventBatch::Event::description() const {
+    return QString("%1 @ %2 (status %3), monitor ID %4, \"%5\"")
+           .arg(toString(currentEventType))
+           .arg(currentTimestamp)
+           .arg(toString(currentMonitorStatus))
+           .arg(currentMonitorId)
+           .arg(currentMessage);
+}
+
+/***********************************************************************************************************************
+* EventBatch
+*/
+
+const QString EventBatch::eventReportPath("/event/report");
+
+EventBatch::EventBatch(
+        RestApiOutV1::Server* server,
+        QObject*              parent
+    ):RestApiOutV1::InesonicRestHandler(
+        server,
+        parent
+    ) {
+    retryTimer.setSingleShot(true);
+    connect(&retryTimer, &QTimer::timeout, this, &EventBatch::resend);
+}
+
+
+EventBatch::EventBatch(
+        const QByteArray&     secret,
+        RestApiOutV1::Server* server,
+        QObject*              parent
+    ):RestApiOutV1::InesonicRestHandler(
+        secret,
+        server,
+        parent
+    ) {
+    retryTimer.setSingleShot(true);
+    connect(&retryTimer, &QTimer::timeout, this, &EventBatch::resend);
+}
+
+
+EventBatch::~EventBatch() {}
+
+
+void EventBatch::send(const EventBatch::EventList& events, bool multipleEventPayload) {
+    Q_ASSERT(multipleEventPayload || events.size() == 1);
+
+    currentEvents = events;
+
+    if (multipleEventPayload) {
+        QJsonArray eventArray;
+        for (  EventList::const_iterator it = currentEvents.constBegin(), end = currentEvents.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            eventArray.append(it->toJson());
+        }
+
+        QJsonObject payload;
+        payload.insert("events", eventArray);
+
+        currentPayload = QJsonDocument(payload);
+    } else {
+        currentPayload = QJsonDocument(currentEvents.first().toJson());
+    }
+
+    resend();
+}
+
+
+unsigned long EventBatch::numberEvents() const {
+    return static_cast<unsigned long>(currentEvents.size());
+}
+
+
+void EventBatch::processJsonResponse(const QJsonDocument& jsonData) {
+    bool multipleEventsAccepted = false;
+
+    if (jsonData.isObject()) {
+        QJsonObject responseObject = jsonData.object();
+        if (responseObject.contains("status")) {
+            QString statusString = responseObject.value("status").toString();
+            multipleEventsAccepted = responseObject.value("multiple_events").toBool(false);
+
+            if (statusString == QString("OK")) {
+                if (logEnabled(LogLevel::DEBUG)) {
+                    for (  EventList::const_iterator it = currentEvents.constBegin(), end = currentEvents.constEnd()
+                         ; it != end
+                         ; ++it
+                        ) {
+                        logMessage(LogLevel::DEBUG, QString("Sent event %1").arg(it->description()));
+                    }
+                }
+            } else {
+                logFailures(QString("Server reported \"%1\"").arg(statusString));
+            }
+        } else {
+            logFailures(QString("Unexpected response"));
+        }
+    } else {
+        logFailures(QString("Expected JSON object."));
+    }
+
+    currentEvents.clear();
+    currentPayload = QJsonDocument();
+
+    emit completed(this, multipleEventsAccepted);
+}
+
+
+void EventBatch::processRequestFailed(const QString& errorString) {
+    logMessage(
+        LogLevel::WARNING,
+        QString("Failed to send %1 events starting with monitor ID %2: %3 - Retrying in %4 seconds.")
+        .arg(currentEvents.size())
+        .arg(currentEvents.first().monitorId())
+        .arg(errorString)
+        .arg(retryDelayInSeconds)
+    );
+
+    // The batch is not reported as completed until the retry succeeds so the reporter keeps holding later events
+    // for these monitors.
+    retryTimer.start(1000 * retryDelayInSeconds);
+}
+
+
+void EventBatch::resend() {
+    if (!currentEvents.isEmpty()) {
+        post(eventReportPath, currentPayload);
+    }
+}
+
+
+QString EventBatch::toString(EventBatch::EventType eventType) {
+    QString result;
+
+    switch (eventType) {
+        case EventType::INVALID:         { result = QString("invalid");          break; }
+        case EventType::WORKING:         { result = QString("working");          break; }
+        case EventType::NO_RESPONSE:     { result = QString("no_response");      break; }
+        case EventType::CONTENT_CHANGED: { result = QString("content_changed");  break; }
+        case EventType::KEYWORDS:        { result = QString("keywords");         break; }
+        case EventType::SSL_CERTIFICATE: { result = QString("ssl_certificate");  break; }
+        default:                         { Q_ASSERT(false);                      break; }
+    }
+
+    return result;
+}
+
+
+QString EventBatch::toString(EventBatch::MonitorStatus monitorStatus) {
+    QString result;
+
+    switch (monitorStatus) {
+        case MonitorStatus::UNKNOWN: { result = QString("unknown");  break; }
+        case MonitorStatus::WORKING: { result = QString("working");  break; }
+        case MonitorStatus::FAILED:  { result = QString("failed");   break; }
+        default:                     { Q_ASSERT(false);              break; }
+    }
+
+    return result;
+}
+
+
+void EventBatch::logFailures(const QString& reason) {
+    for (  EventList::const_iterator it = currentEvents.constBegin(), end = currentEvents.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        logMessage(LogLevel::WARNING, QString("Failed to send event %1: %2").arg(it->description(), reason));
+    }
+}
@@ -0,0 +1,129 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref EventLoopLagProbe class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QTimer>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "event_loop_lag_probe.h"
+
+EventLoopLagProbe::EventLoopLagProbe(QObject* parent):QObject(parent) {
+    probeTimer = new QTimer(this);
+    probeTimer->setSingleShot(true);
+    probeTimer->setTimerType(Qt::TimerType::PreciseTimer);
+
+    nextProbeTime.store(0);
+    lastHighLagTime.store(0);
+    numberHighLagSamples.store(0);
+    publishedAverageLag.store(0);
+    publishedMaximumLag.store(0);
+
+    windowStartTime     = 0;
+    windowSumLag        = 0;
+    windowMaximumLag    = 0;
+    windowNumberSamples = 0;
+
+    connect(probeTimer, &QTimer::timeout, this, &EventLoopLagProbe::probe);
+
+    // The probe can be created before it's moved to its thread so the first arming is deferred to the thread's event
+    // loop.
+
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            unsigned long long now = currentTime();
+
+            windowStartTime = now;
+            nextProbeTime.store(now + 1000000ULL * probeIntervalMilliseconds, std::memory_order_relaxed);
+            probeTimer->start(probeIntervalMilliseconds);
+        },
+        Qt::QueuedConnection
+    );
+}
+
+
+EventLoopLagProbe::~EventLoopLagProbe() {}
+
+
+unsigned long long EventLoopLagProbe::currentTime() {
+    return static_cast<unsigned long long>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count()
+    );
+}
+
+
+unsigned long long EventLoopLagProbe::currentLag() const {
+    unsigned long long dueTime = nextProbeTime.load(std::memory_order_relaxed);
+    unsigned long long now     = currentTime();
+
+    return dueTime != 0 && now > dueTime ? now - dueTime : 0;
+}
+
+
+bool EventLoopLagProbe::laggedSince(unsigned long long startTime) const {
+    return lastHighLagTime.load(std::memory_order_relaxed) >= startTime || currentLag() > highLagNanoseconds;
+}
+
+
+EventLoopLagProbe::LagData EventLoopLagProbe::lagData() const {
+    return LagData(
+        publishedAverageLag.load(std::memory_order_relaxed) / 1.0E9,
+        publishedMaximumLag.load(std::memory_order_relaxed) / 1.0E9,
+        numberHighLagSamples.load(std::memory_order_relaxed)
+    );
+}
+
+
+void EventLoopLagProbe::probe() {
+    unsigned long long now     = currentTime();
+    unsigned long long dueTime = nextProbeTime.load(std::memory_order_relaxed);
+    unsigned long long lag     = now > dueTime ? now - dueTime : 0;
+
+    if (lag > highLagNanoseconds) {
+        lastHighLagTime.store(now, std::memory_order_relaxed);
+        numberHighLagSamples.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    windowSumLag += lag;
+    ++windowNumberSamples;
+    if (lag > windowMaximumLag) {
+        windowMaximumLag = lag;
+    }
+
+    if (now - windowStartTime >= windowNanoseconds) {
+        publishedAverageLag.store(windowSumLag / windowNumberSamples, std::memory_order_relaxed);
+        publishedMaximumLag.store(windowMaximumLag, std::memory_order_relaxed);
+
+        windowStartTime     = now;
+        windowSumLag        = 0;
+        windowMaximumLag    = 0;
+        windowNumberSamples = 0;
+    }
+
+    // Measure the next probe from now so a long stall is reported once rather than as a run of late probes.
+
+    nextProbeTime.store(now + 1000000ULL * probeIntervalMilliseconds, std::memory_order_relaxed);
+    probeTimer->start(probeIntervalMilliseconds);
+}
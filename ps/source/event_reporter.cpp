@@ -19,46 +19,83 @@
 ***********************************************************************************************************************/
 
 #include <QObject>
-#include <QTimer>
 #include <QByteArray>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
-#include <QJsonValue>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QSet>
 
 #include <rest_api_out_v1_server.h>
-#include <rest_api_out_v1_inesonic_rest_handler.h>
 
 #include "log.h"
 #include "host_scheme.h"
 #include "monitor.h"
+#include "event_batch.h"
 #include "event_reporter.h"
 
-const QString EventReporter::eventReportPath("/event/report");
-
 EventReporter::EventReporter(
         RestApiOutV1::Server* server,
         QObject*              parent
-    ):RestApiOutV1::InesonicRestHandler(
-        server,
+    ):QObject(
         parent
-    ) {
-    retryTimer.setSingleShot(true);
-    connect(&retryTimer, &QTimer::timeout, this, &EventReporter::resend);
-}
+    ),currentServer(
+        server
+    ),currentMaximumInFlightBatches(
+        defaultMaximumInFlightBatches
+    ),currentNumberInFlightBatches(
+        0
+    ),currentNumberQueuedEvents(
+        0
+    ),currentMultipleEventsAccepted(
+        false
+    ) {}
 
 
 EventReporter::EventReporter(
         const QByteArray&     secret,
         RestApiOutV1::Server* server,
         QObject*              parent
-    ):RestApiOutV1::InesonicRestHandler(
-        secret,
-        server,
+    ):QObject(
         parent
+    ),currentServer(
+        server
+    ),currentSecret(
+        secret
+    ),currentMaximumInFlightBatches(
+        defaultMaximumInFlightBatches
+    ),currentNumberInFlightBatches(
+        0
+    ),currentNumberQueuedEvents(
+        0
+    ),currentMultipleEventsAccepted(
+        false
     ) {}
 
 
+EventReporter::~EventReporter() {}
+
+
+unsigned EventReporter::maximumInFlightBatches() const {
+    return currentMaximumInFlightBatches;
+}
+
+
+void EventReporter::setMaximumInFlightBatches(unsigned newMaximumInFlightBatches) {
+    currentMaximumInFlightBatches = newMaximumInFlightBatches > 0 ? newMaximumInFlightBatches : 1;
+    dispatch();
+}
+
+
+unsigned long EventReporter::numberQueuedEvents() const {
+    return currentNumberQueuedEvents.load(std::memory_order_relaxed);
+}
+
+
+unsigned EventReporter::numberInFlightBatches() const {
+    return currentNumberInFlightBatches.load(std::memory_order_relaxed);
+}
+
+
 void EventReporter::sendEvent(
         EventReporter::MonitorId     monitorId,
         unsigned long long           timestamp,
@@ -67,111 +104,105 @@ void EventReporter::sendEvent(
         const QByteArray&            hash,
         const QString&               message
     ) {
-    bool startSending = pendingMessages.isEmpty();
+    queuedEvents.append(EventBatch::Event(monitorId, timestamp, eventType, monitorStatus, hash, message));
+    dispatch();
+}
 
-    QJsonObject jsonMessage;
-    QString     eventTypeString     = toString(eventType);
-    QString     monitorStatusString = toString(monitorStatus);
 
-    jsonMessage.insert("monitor_id", static_cast<double>(monitorId));
-    jsonMessage.insert("timestamp", static_cast<double>(timestamp));
-    jsonMessage.insert("event_type", eventTypeString);
-    jsonMessage.insert("monitor_status", monitorStatusString);
-    jsonMessage.insert("message", message);
+void EventReporter::batchCompleted(EventBatch* batch, bool multipleEventsAccepted) {
+    if (multipleEventsAccepted != currentMultipleEventsAccepted) {
+        logMessage(
+            LogLevel::INFO,
+            QString("Database controller %1 multi-event reports.")
+            .arg(multipleEventsAccepted ? QString("accepts") : QString("does not accept"))
+        );
 
-    if (!hash.isEmpty()) {
-        jsonMessage.insert("hash", QString::fromUtf8(hash.toBase64()));
+        currentMultipleEventsAccepted = multipleEventsAccepted;
     }
 
-    QString successMessage = QString("Sent event %1 @ %2, (status %3) monitor ID %4, \"%5\"")
-                             .arg(eventTypeString)
-                             .arg(timestamp)
-                             .arg(monitorStatusString)
-                             .arg(monitorId)
-                             .arg(message);
-
-    QString failureMessage = QString("Failed to send event %1 @ %2 (status %3), monitor ID %4, \"%5\"")
-                             .arg(eventTypeString)
-                             .arg(timestamp)
-                             .arg(monitorStatusString)
-                             .arg(monitorId)
-                             .arg(message);
+    QList<MonitorId> monitorIds = monitorIdsByBatch.take(batch);
+    for (  QList<MonitorId>::const_iterator it = monitorIds.constBegin(), end = monitorIds.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        inFlightMonitorIds.remove(*it);
+    }
 
-    pendingMessages.append(Message(QJsonDocument(jsonMessage), successMessage, failureMessage));
+    --currentNumberInFlightBatches;
+    idleBatches.append(batch);
 
-    if (startSending) {
-        post(eventReportPath, pendingMessages.first().message());
-    }
+    dispatch();
 }
 
 
-void EventReporter::processJsonResponse(const QJsonDocument& jsonData) {
-    Message m = pendingMessages.takeFirst();
-
-    if (jsonData.isObject()) {
-        QJsonObject responseObject = jsonData.object();
-        if (responseObject.size() == 1) {
-            QString statusString = responseObject.value("status").toString();
-            if (statusString == QString("OK")) {
-                logWrite(m.successMessage(), false);
+void EventReporter::dispatch() {
+    bool eventsAvailable = true;
+    while (eventsAvailable && !queuedEvents.isEmpty() && currentNumberInFlightBatches < currentMaximumInFlightBatches) {
+        unsigned long batchSize = currentMultipleEventsAccepted ? maximumEventsPerBatch : 1;
+
+        // A monitor's event is only taken if none of its events are in flight and none were passed over earlier in
+        // the queue.  This keeps each monitor's events in order when a batch has to be retried.
+
+        EventBatch::EventList events;
+        EventBatch::EventList remainingEvents;
+        QList<MonitorId>      batchMonitorIds;
+        QSet<MonitorId>       heldMonitorIds;
+
+        for (  EventBatch::EventList::const_iterator it = queuedEvents.constBegin(), end = queuedEvents.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            MonitorId monitorId = it->monitorId();
+            if (static_cast<unsigned long>(events.size()) < batchSize &&
+                !inFlightMonitorIds.contains(monitorId)                &&
+                !heldMonitorIds.contains(monitorId)                       ) {
+                events.append(*it);
+                if (!batchMonitorIds.contains(monitorId)) {
+                    batchMonitorIds.append(monitorId);
+                }
             } else {
-                logWrite(m.failureMessage() + QString(": Server reported \"%1\"").arg(statusString), false);
+                remainingEvents.append(*it);
+                heldMonitorIds.insert(monitorId);
             }
-        } else {
-            logWrite(m.failureMessage() + QString(": Unexpected response"), false);
         }
-    } else {
-        logWrite(m.failureMessage() + QString(": Expected JSON object."), false);
-    }
-
-    resend();
-}
-
-
-void EventReporter::processRequestFailed(const QString& errorString) {
-    const Message& m = pendingMessages.first();
 
-    logWrite(
-        m.failureMessage() + QString(": %1 - Retrying in %2 seconds.").arg(errorString).arg(retryDelayInSeconds),
-        false
-    );
-
-    retryTimer.start(1000 * retryDelayInSeconds);
-}
-
-
-void EventReporter::resend() {
-    if (!pendingMessages.isEmpty()) {
-        post(eventReportPath, pendingMessages.first().message());
-    }
-}
+        eventsAvailable = !events.isEmpty();
+        if (eventsAvailable) {
+            queuedEvents = remainingEvents;
 
+            for (  QList<MonitorId>::const_iterator it = batchMonitorIds.constBegin(), end = batchMonitorIds.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                inFlightMonitorIds.insert(*it);
+            }
 
-QString EventReporter::toString(EventReporter::EventType eventType) {
-    QString result;
+            EventBatch* batch = idleBatch();
+            monitorIdsByBatch.insert(batch, batchMonitorIds);
 
-    switch (eventType) {
-        case EventType::INVALID:         { result = QString("invalid");          break; }
-        case EventType::WORKING:         { result = QString("working");          break; }
-        case EventType::NO_RESPONSE:     { result = QString("no_response");      break; }
-        case EventType::CONTENT_CHANGED: { result = QString("content_changed");  break; }
-        case EventType::KEYWORDS:        { result = QString("keywords");         break; }
-        case EventType::SSL_CERTIFICATE: { result = QString("ssl_certificate");  break; }
-        default:                         { Q_ASSERT(false);                      break; }
+            ++currentNumberInFlightBatches;
+            batch->send(events, currentMultipleEventsAccepted);
+        }
     }
 
-    return result;
+    currentNumberQueuedEvents.store(static_cast<unsigned long>(queuedEvents.size()), std::memory_order_relaxed);
 }
 
 
-QString EventReporter::toString(EventReporter::MonitorStatus monitorStatus) {
-    QString result;
+EventBatch* EventReporter::idleBatch() {
+    EventBatch* result;
+
+    if (!idleBatches.isEmpty()) {
+        result = idleBatches.takeLast();
+    } else {
+        if (currentSecret.isEmpty()) {
+            result = new EventBatch(currentServer, this);
+        } else {
+            result = new EventBatch(currentSecret, currentServer, this);
+        }
 
-    switch (monitorStatus) {
-        case MonitorStatus::UNKNOWN: { result = QString("unknown");  break; }
-        case MonitorStatus::WORKING: { result = QString("working");  break; }
-        case MonitorStatus::FAILED:  { result = QString("failed");   break; }
-        default:                     { Q_ASSERT(false);              break; }
+        // Queued so that a batch is never reused from within its own response handler.
+        connect(result, &EventBatch::completed, this, &EventReporter::batchCompleted, Qt::QueuedConnection);
     }
 
     return result;
@@ -21,13 +21,15 @@
 #include <QObject>
 #include <QString>
 #include <QList>
-#include <QNetworkAccessManager>
-#include <QMutex>
-#include <QMutexLocker>
+#include <QByteArray>
+#include <QSslConfiguration>
 
 #include <cstdint>
+#include <algorithm>
 
 #include "monitor.h"
+#include "http_engine.h"
+#include "timing_wheel.h"
 #include "host_scheme.h"
 #include "customer.h"
 
@@ -47,53 +49,47 @@ HostScheme::HostScheme(
     }
 
     currentSslExpirationTimestamp = invalidSslExpirationTimestamp;
-    currentNetworkAccessManager   = nullptr;
-    nonResponsiveMonitorsIterator = nonResponsiveMonitors.end();
+    currentHttpEngine             = nullptr;
+    currentSslSessionGeneration   = 0;
 
-    connect(this, &HostScheme::startCheckRequested, this, &HostScheme::serviceNextMonitor);
+    resetSslState();
+    nonResponsiveMonitorsIterator = nonResponsiveMonitors.end();
 }
 
 
 HostScheme::~HostScheme() {}
 
 
-QNetworkAccessManager* HostScheme::networkAccessManager() const {
-    return currentNetworkAccessManager;
+HttpEngine* HostScheme::httpEngine() const {
+    return currentHttpEngine;
 }
 
 
-void HostScheme::setNetworkAccessManager(QNetworkAccessManager* newNetworkAccessManager) {
-    currentNetworkAccessManager = newNetworkAccessManager;
+void HostScheme::setHttpEngine(HttpEngine* newHttpEngine) {
+    currentHttpEngine = newHttpEngine;
 }
 
 
 void HostScheme::addMonitor(Monitor* monitor) {
     monitor->moveToThread(thread());
     monitor->setParent(this);
+    monitor->invalidateRequestTemplate();
     monitorAdded(monitor);
 }
 
 
 bool HostScheme::removeMonitor(Monitor::MonitorId monitorId) {
-    bool success;
+    bool     success;
+    Monitor* monitor = monitorsByMonitorId.value(monitorId);
 
-    monitorMutex.lock();
-    MonitorsByMonitorId::iterator it = monitorsByMonitorId.find(monitorId);
-    if (it != monitorsByMonitorId.end()) {
-        Monitor* monitor = it.value();
+    if (monitor != nullptr) {
+        // Going through monitorAboutToBeRemoved keeps our round-robin iterators valid and notifies the customer.
 
-        monitorsByMonitorId.erase(it);
-        monitorMutex.unlock();
-
-        Customer* customer = static_cast<Customer*>(parent());
-        if (customer != nullptr) {
-            customer->monitorAboutToBeRemoved(monitor);
-        }
+        monitorAboutToBeRemoved(monitor);
 
         delete monitor;
         success = true;
     } else {
-        monitorMutex.unlock();
         success = false;
     }
 
@@ -133,6 +129,14 @@ const QUrl& HostScheme::url() const {
 
 void HostScheme::setUrl(const QUrl& newUrl) {
     currentUrl = newUrl;
+
+    for (  MonitorsByMonitorId::const_iterator it  = monitorsByMonitorId.constBegin(),
+                                               end = monitorsByMonitorId.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        it.value()->invalidateRequestTemplate();
+    }
 }
 
 
@@ -146,14 +150,93 @@ void HostScheme::setSslExpirationTimestamp(unsigned long long newSslExpirationTi
 }
 
 
-void HostScheme::startCheckFromDifferentThread() {
-    emit startCheckRequested();
+bool HostScheme::certificateCheckNeeded(bool newHandshake, unsigned long long timestamp) {
+    bool result = newHandshake || timestamp >= lastCertificateCheckTimestamp + certificateRecheckInterval;
+    if (result) {
+        lastCertificateCheckTimestamp = timestamp;
+    }
+
+    return result;
+}
+
+
+const QSslConfiguration& HostScheme::sslConfiguration() const {
+    return currentSslConfiguration;
+}
+
+
+unsigned HostScheme::sslSessionGeneration() const {
+    return currentSslSessionGeneration;
+}
+
+
+void HostScheme::updateSslSession(const QByteArray& sessionTicket) {
+    if (!sessionTicket.isEmpty() && sessionTicket != currentSslConfiguration.sessionTicket()) {
+        currentSslConfiguration.setSessionTicket(sessionTicket);
+
+        ++currentSslSessionGeneration;
+        if (currentSslSessionGeneration == 0) {
+            currentSslSessionGeneration = 1;
+        }
+    }
+}
+
+
+void HostScheme::updateFrom(HostScheme* hostScheme) {
+    if (hostScheme->url() != currentUrl) {
+        if (hostScheme->url().host() != currentUrl.host()) {
+            currentSslExpirationTimestamp = invalidSslExpirationTimestamp;
+            resetSslState();
+        }
+
+        setUrl(hostScheme->url());
+    }
+
+    QList<Monitor*> existingMonitors = monitors();
+    for (  QList<Monitor*>::const_iterator it = existingMonitors.constBegin(), end = existingMonitors.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        Monitor::MonitorId monitorId = (*it)->monitorId();
+        if (hostScheme->getMonitor(monitorId) == nullptr) {
+            removeMonitor(monitorId);
+        }
+    }
+
+    QList<Monitor*> newMonitors = hostScheme->monitors();
+    for (  QList<Monitor*>::const_iterator it = newMonitors.constBegin(), end = newMonitors.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        Monitor* newMonitor      = *it;
+        Monitor* existingMonitor = getMonitor(newMonitor->monitorId());
+        if (existingMonitor != nullptr) {
+            existingMonitor->updateFrom(newMonitor);
+        } else {
+            addMonitor(newMonitor);
+        }
+    }
 }
 
 
-void HostScheme::serviceNextMonitor() {
-    monitorMutex.lock();
+void HostScheme::resetNonResponsiveMonitors() {
+    nonResponsiveMonitors.clear();
+    for (  MonitorsByMonitorId::const_iterator it  = monitorsByMonitorId.constBegin(),
+                                               end = monitorsByMonitorId.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        Monitor* monitor = it.value();
+        if (monitor->monitorStatus() != Monitor::MonitorStatus::WORKING) {
+            nonResponsiveMonitors.insert(monitor, RecheckState());
+        }
+    }
 
+    nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
+}
+
+
+HostScheme::RecheckOutcome HostScheme::serviceNextMonitor() {
     if (monitorIterator == monitorsByMonitorId.end()) {
         monitorIterator = monitorsByMonitorId.begin();
     }
@@ -165,87 +248,57 @@ void HostScheme::serviceNextMonitor() {
         monitorIterator = monitorsByMonitorId.begin();
     }
 
+    RecheckOutcome outcome;
+    Monitor*       nonResponsiveMonitor;
     if (!nonResponsiveMonitors.isEmpty()) {
-        if (nonResponsiveMonitorsIterator == nonResponsiveMonitors.end()) {
-            nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
-        }
-
-        Monitor* nonResponsiveMonitor = *nonResponsiveMonitorsIterator;
-
-        ++nonResponsiveMonitorsIterator;
-        if (nonResponsiveMonitorsIterator == nonResponsiveMonitors.end()) {
-            nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
-        }
-
-        monitorMutex.unlock();
-        monitor->startCheck();
-        if (monitor != nonResponsiveMonitor) {
-            nonResponsiveMonitor->startCheck();
-        }
+        nonResponsiveMonitor = dueNonResponsiveMonitor(TimingWheel::currentTime());
+        outcome              = nonResponsiveMonitor != nullptr ? RecheckOutcome::PERFORMED : RecheckOutcome::DEFERRED;
     } else {
-        monitorMutex.unlock();
-        monitor->startCheck();
+        nonResponsiveMonitor = nullptr;
+        outcome              = RecheckOutcome::NONE;
+    }
+
+    monitor->startCheck();
+    if (nonResponsiveMonitor != nullptr && nonResponsiveMonitor != monitor) {
+        nonResponsiveMonitor->startCheck();
     }
+
+    return outcome;
 }
 
 
 void HostScheme::monitorNonResponsive(Monitor* monitor) {
-    QMutexLocker locker(&monitorMutex);
-    if (nonResponsiveMonitors.isEmpty()) {
-        nonResponsiveMonitors.insert(monitor);
-        nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
-    } else {
-        nonResponsiveMonitors.insert(monitor);
-    }
+    // The failure has just been observed so the first recheck confirms it after the confirmation delay.
+
+    addNonResponsiveMonitor(monitor, RecheckState(TimingWheel::currentTime() + recheckDelay(0)));
 }
 
 
 void HostScheme::monitorNowResponsive(Monitor *monitor) {
-    monitorMutex.lock();
-    if (nonResponsiveMonitorsIterator != nonResponsiveMonitors.end() && *nonResponsiveMonitorsIterator == monitor) {
-        nonResponsiveMonitorsIterator = nonResponsiveMonitors.erase(nonResponsiveMonitorsIterator);
-        if (nonResponsiveMonitorsIterator == nonResponsiveMonitors.end() && !nonResponsiveMonitors.isEmpty()) {
-            nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
-        }
-    } else {
-        nonResponsiveMonitors.remove(monitor);
-    }
+    removeNonResponsiveMonitor(monitor);
 
     if (!nonResponsiveMonitors.isEmpty()) {
-        Monitor* nextMonitorToTest = *nonResponsiveMonitors.begin();
-
-        ++nonResponsiveMonitorsIterator;
-        if (nonResponsiveMonitorsIterator == nonResponsiveMonitors.end()) {
-            nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
+        Monitor* nextMonitorToTest = dueNonResponsiveMonitor(TimingWheel::currentTime());
+        if (nextMonitorToTest != nullptr) {
+            nextMonitorToTest->startCheck();
         }
-
-        monitorMutex.unlock();
-
-        nextMonitorToTest->startCheck();
-    } else {
-        monitorMutex.unlock();
     }
 }
 
 
 void HostScheme::monitorAdded(Monitor* monitor) {
-    monitorMutex.lock();
-
     bool isFirstMonitor = monitorsByMonitorId.isEmpty();
     monitorsByMonitorId.insert(monitor->monitorId(), monitor);
 
-    bool isFirstNonResponsiveMonitor = nonResponsiveMonitors.isEmpty();
-    nonResponsiveMonitors.insert(monitor);
-
     if (isFirstMonitor) {
         monitorIterator = monitorsByMonitorId.begin();
     }
 
-    if (isFirstNonResponsiveMonitor) {
-        nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
-    }
+    // Monitors that are known to be working, such as migrated monitors, are not retested as non-responsive.
 
-    monitorMutex.unlock();
+    if (monitor->monitorStatus() != Monitor::MonitorStatus::WORKING) {
+        addNonResponsiveMonitor(monitor, RecheckState());
+    }
 
     Customer* customer = static_cast<Customer*>(parent());
     if (customer != nullptr) {
@@ -257,8 +310,6 @@ void HostScheme::monitorAdded(Monitor* monitor) {
 void HostScheme::monitorAboutToBeRemoved(Monitor* monitor) {
     Monitor::MonitorId monitorId = monitor->monitorId();
 
-    monitorMutex.lock();
-
     MonitorsByMonitorId::iterator it = monitorsByMonitorId.find(monitorId);
     if (it == monitorIterator) {
         monitorIterator = monitorsByMonitorId.erase(it);
@@ -269,27 +320,87 @@ void HostScheme::monitorAboutToBeRemoved(Monitor* monitor) {
         monitorsByMonitorId.erase(it);
     }
 
-    if (nonResponsiveMonitorsIterator != nonResponsiveMonitors.end() && *nonResponsiveMonitorsIterator == monitor) {
-        nonResponsiveMonitorsIterator = nonResponsiveMonitors.erase(nonResponsiveMonitorsIterator);
-        if (nonResponsiveMonitorsIterator == nonResponsiveMonitors.end() && !nonResponsiveMonitors.isEmpty()) {
+    removeNonResponsiveMonitor(monitor);
+
+    Customer* customer = static_cast<Customer*>(parent());
+    if (customer != nullptr) {
+        customer->monitorAboutToBeRemoved(monitor);
+    }
+}
+
+
+Monitor* HostScheme::dueNonResponsiveMonitor(unsigned long long currentTime) {
+    Monitor* result    = nullptr;
+    int      remaining = nonResponsiveMonitors.size();
+
+    while (result == nullptr && remaining > 0) {
+        if (nonResponsiveMonitorsIterator == nonResponsiveMonitors.end()) {
             nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
         }
-    } else {
-        nonResponsiveMonitors.remove(monitor);
+
+        RecheckState& recheckState = nonResponsiveMonitorsIterator.value();
+        if (recheckState.nextRecheckTime <= currentTime) {
+            result = nonResponsiveMonitorsIterator.key();
+
+            ++recheckState.numberRechecks;
+            recheckState.nextRecheckTime = currentTime + recheckDelay(recheckState.numberRechecks);
+        }
+
+        ++nonResponsiveMonitorsIterator;
+        --remaining;
     }
 
-    monitorMutex.unlock();
+    return result;
+}
 
-    Customer* customer = static_cast<Customer*>(parent());
+
+unsigned long long HostScheme::recheckDelay(unsigned numberRechecks) const {
+    unsigned long long confirmationDelay;
+    unsigned long long maximumRecheckInterval;
+
+    const Customer* customer = static_cast<const Customer*>(parent());
     if (customer != nullptr) {
-        customer->monitorAboutToBeRemoved(monitor);
+        confirmationDelay      = customer->confirmationDelay();
+        maximumRecheckInterval = customer->maximumRecheckInterval();
+    } else {
+        confirmationDelay      = Customer::defaultConfirmationDelay;
+        maximumRecheckInterval = Customer::defaultMaximumRecheckInterval;
     }
+
+    // The shift is bounded so the delay can't overflow; the ceiling is far smaller anyway.
+
+    unsigned long long delay = confirmationDelay << std::min(numberRechecks, 31U);
+    return 1000ULL * std::min(delay, maximumRecheckInterval);
 }
 
 
-void HostScheme::reportExistingMonitors(Customer* customer, bool adding) {
-    QMutexLocker locker(&monitorMutex);
+void HostScheme::addNonResponsiveMonitor(Monitor* monitor, const RecheckState& recheckState) {
+    NonResponsiveMonitors::iterator it = nonResponsiveMonitors.find(monitor);
+    if (it != nonResponsiveMonitors.end()) {
+        it.value() = recheckState;
+    } else {
+        // Inserting may rehash the table which invalidates our iterator.
 
+        nonResponsiveMonitors.insert(monitor, recheckState);
+        nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
+    }
+}
+
+
+void HostScheme::removeNonResponsiveMonitor(Monitor* monitor) {
+    if (nonResponsiveMonitorsIterator != nonResponsiveMonitors.end() &&
+        nonResponsiveMonitorsIterator.key() == monitor                    ) {
+        nonResponsiveMonitorsIterator = nonResponsiveMonitors.erase(nonResponsiveMonitorsIterator);
+        if (nonResponsiveMonitorsIterator == nonResponsiveMonitors.end() && !nonResponsiveMonitors.isEmpty()) {
+            nonResponsiveMonitorsIterator = nonResponsiveMonitors.begin();
+        }
+    } else {
+        nonResponsiveMonitors.remove(monitor);
+    }
+}
+
+
+void HostScheme::reportExistingMonitors(Customer* customer, bool adding) {
     if (adding) {
         for (  MonitorsByMonitorId::const_iterator it  = monitorsByMonitorId.constBegin(),
                                                    end = monitorsByMonitorId.constEnd()
@@ -308,3 +419,29 @@ void HostScheme::reportExistingMonitors(Customer* customer, bool adding) {
         }
     }
 }
+
+
+void HostScheme::resetSslState() {
+    lastCertificateCheckTimestamp = 0;
+    currentSslConfiguration       = initialSslConfiguration();
+
+    ++currentSslSessionGeneration;
+    if (currentSslSessionGeneration == 0) {
+        currentSslSessionGeneration = 1;
+    }
+}
+
+
+const QSslConfiguration& HostScheme::initialSslConfiguration() {
+    // Built on first use, after the SSL backend is available.  Host/schemes share the configuration until their
+    // first ticket arrives.
+
+    static const QSslConfiguration configuration = []() {
+        QSslConfiguration result = QSslConfiguration::defaultConfiguration();
+        result.setSslOption(QSsl::SslOption::SslOptionDisableSessionPersistence, false);
+
+        return result;
+    }();
+
+    return configuration;
+}
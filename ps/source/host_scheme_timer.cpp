@@ -18,30 +18,69 @@
 * This header implements the \ref HostSchemeTimer class.
 ***********************************************************************************************************************/
 
-#include <QThread>
-#include <QTimer>
-#include <QDateTime>
+#include <QObject>
 #include <QHash>
 #include <QMutexLocker>
 #include <QMutex>
+#include <QString>
 
 #include <cstdint>
+#include <atomic>
 
 #include "log.h"
 #include "monitor.h"
 #include "bit_functions.h"
 #include "loading_data.h"
+#include "timing_wheel.h"
+#include "dns_cache.h"
 #include "host_scheme_timer.h"
 
+/***********************************************************************************************************************
+* HostSchemeTimer::HostSchemeEntry
+*/
+
+HostSchemeTimer::HostSchemeEntry::HostSchemeEntry(
+        HostSchemeTimer* hostSchemeTimer,
+        HostScheme*      hostScheme
+    ):TimingWheel::Entry(
+        hostSchemeTimer
+    ),currentHostScheme(
+        hostScheme
+    ),currentPhase(
+        bitReverse32(hostScheme->hostSchemeId())
+    ),currentDeferred(
+        false
+    ),currentCycleCount(
+        0
+    ) {}
+
+
+HostSchemeTimer::HostSchemeEntry::~HostSchemeEntry() {}
+
+/***********************************************************************************************************************
+* HostSchemeTimer
+*/
+
+std::atomic<HostSchemeTimer::OverloadPolicy> HostSchemeTimer::currentOverloadPolicy(OverloadPolicy::SPREAD);
+std::atomic<unsigned>                        HostSchemeTimer::currentRegionTransitionCycles(0);
+
 HostSchemeTimer::HostSchemeTimer(
-        bool     multiRegion,
-        int      period,
-        unsigned regionIndex,
-        unsigned numberRegions,
-        bool     startActive,
-        QObject* parent
+        bool         multiRegion,
+        int          period,
+        unsigned     regionIndex,
+        unsigned     numberRegions,
+        bool         startActive,
+        TimingWheel* timingWheel,
+        DnsCache*    dnsCache,
+        QObject*     parent
     ):QObject(
         parent
+    ),currentTimingWheel(
+        timingWheel
+    ),currentDnsCache(
+        dnsCache
+    ),currentActive(
+        startActive
     ),currentMultiRegion(
         multiRegion
     ),currentAggregatePeriodSeconds(
@@ -53,14 +92,29 @@ HostSchemeTimer::HostSchemeTimer(
     ),currentNumberRegions(
         numberRegions
     ) {
-    monitorIterator = monitorsByMonitorId.end();
-    serviceTimer    = new QTimer(this);
-    serviceTimer->setSingleShot(true);
-
     numberMissedTimingWindows          = 0;
     sumMillisecondsMissedTimingMarks   = 0;
-    nextTimingMarkReset                = 0;
-    forceTimerResync                   = false;
+    numberRechecksWindow               = 0;
+    numberDeferredRechecksWindow       = 0;
+    numberShedPollsWindow              = 0;
+    nextTimingMarkReset                = TimingWheel::currentTime() + missedTimingMarkResetInterval;
+    sheddingWindowEnd                  = TimingWheel::currentTime() + sheddingWindowMilliseconds;
+    sheddingWindowPolls                = 0;
+    sheddingWindowLatePolls            = 0;
+    numberOverloadedWindows            = 0;
+    numberHealthyWindows               = 0;
+    spreadCursor                       = 0;
+    totalNumberPolls                   = 0;
+    totalNumberMissedTimingMarks       = 0;
+    totalMillisecondsMissedTimingMarks = 0;
+    totalNumberRechecks                = 0;
+    totalNumberDeferredRechecks        = 0;
+    totalNumberShedPolls               = 0;
+    currentSheddingLevel               = 0;
+    currentNumberEntries               = 0;
+    transitionStartOffset              = 0;
+    transitionStartTime                = 0;
+    transitionEndTime                  = 0;
 
     if (numberRegions == 0) {
         regionTimeOffsetMilliseconds = 0;
@@ -76,54 +130,121 @@ HostSchemeTimer::HostSchemeTimer(
         .arg(regionTimeOffsetMilliseconds),
         false
     );
+}
 
-    connect(serviceTimer, &QTimer::timeout, this, &HostSchemeTimer::startNextHostScheme);
-    connect(this, &HostSchemeTimer::start, this, &HostSchemeTimer::startTimer);
-    connect(this, &HostSchemeTimer::stop, serviceTimer, &QTimer::stop);
 
-    if (startActive) {
-        startTimer();
+HostSchemeTimer::~HostSchemeTimer() {
+    for (  EntriesByHostSchemeId::const_iterator it  = entriesByHostSchemeId.constBegin(),
+                                                 end = entriesByHostSchemeId.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        HostSchemeEntry* entry = it.value();
+        currentTimingWheel->cancel(entry);
+        delete entry;
     }
 }
 
 
-HostSchemeTimer::~HostSchemeTimer() {}
-
-
 float HostSchemeTimer::monitorsPerSecond() const {
-    return (1000.0 * hostSchemesByTimeOrder.size()) / currentPeriodMilliseconds;
+    return (1000.0 * currentNumberEntries.load(std::memory_order_relaxed)) / currentPeriodMilliseconds;
 }
 
 
 LoadingData HostSchemeTimer::loadingData() const {
-    QMutexLocker locker(&hostSchemeMutex);
     return currentLoadingData;
 }
 
 
-void HostSchemeTimer::addHostScheme(HostScheme* hostScheme) {
-    QMutexLocker locker(&hostSchemeMutex);
+LoadingData HostSchemeTimer::cumulativeLoadingData() const {
+    unsigned long      numberPolls             = totalNumberPolls.load(std::memory_order_relaxed);
+    unsigned long      numberMissedTimingMarks = totalNumberMissedTimingMarks.load(std::memory_order_relaxed);
+    unsigned long long millisecondsMissed      = totalMillisecondsMissedTimingMarks.load(std::memory_order_relaxed);
+    unsigned long      numberRechecks          = totalNumberRechecks.load(std::memory_order_relaxed);
+    unsigned long      numberDeferredRechecks  = totalNumberDeferredRechecks.load(std::memory_order_relaxed);
+    unsigned long      numberShedPolls         = totalNumberShedPolls.load(std::memory_order_relaxed);
+
+    double averageTimingError;
+    if (numberMissedTimingMarks > 0) {
+        averageTimingError = millisecondsMissed / (1000.0 * numberMissedTimingMarks);
+    } else {
+        averageTimingError = 0;
+    }
+
+    return LoadingData(
+        numberPolls,
+        numberMissedTimingMarks,
+        averageTimingError,
+        numberRechecks,
+        numberDeferredRechecks,
+        numberShedPolls,
+        currentSheddingLevel.load(std::memory_order_relaxed)
+    );
+}
+
+
+unsigned HostSchemeTimer::sheddingLevel() const {
+    return currentSheddingLevel.load(std::memory_order_relaxed);
+}
+
 
-    hostSchemesByTimeOrder.insert(bitReverse32(hostScheme->hostSchemeId()), QPointer<HostScheme>(hostScheme));
+unsigned HostSchemeTimer::cadenceDivisor(Customer::Priority priority, unsigned sheddingLevel) {
+    unsigned result;
 
-    if (!serviceTimer->isActive()) {
-        hostSchemeIterator = hostSchemesByTimeOrder.begin();
-        emit start();
+    switch (priority) {
+        case Customer::Priority::HIGH:        { result = 1;                               break; }
+        case Customer::Priority::NORMAL:      { result = sheddingLevel >= 2 ? 2 : 1;      break; }
+        case Customer::Priority::BEST_EFFORT: { result = 1U << sheddingLevel;             break; }
+        default:                              { Q_ASSERT(false); result = 1;              break; }
     }
+
+    return result;
+}
+
+
+void HostSchemeTimer::addHostScheme(HostScheme* hostScheme) {
+    HostSchemeEntry* entry = new HostSchemeEntry(this, hostScheme);
+
+    hostSchemeMutex.lock();
+    HostSchemeEntry* oldEntry = entriesByHostSchemeId.value(hostScheme->hostSchemeId(), nullptr);
+    entriesByHostSchemeId.insert(hostScheme->hostSchemeId(), entry);
+    currentNumberEntries.store(static_cast<unsigned long>(entriesByHostSchemeId.size()), std::memory_order_relaxed);
+    hostSchemeMutex.unlock();
+
+    // The timing wheel can only be touched from our own thread so we hand the scheduling work off to our thread.
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, entry, oldEntry]() {
+            if (oldEntry != nullptr) {
+                currentTimingWheel->cancel(oldEntry);
+                delete oldEntry;
+            }
+
+            if (schedulingEnabled()) {
+                scheduleEntry(entry, TimingWheel::currentTime());
+            }
+        }
+    );
 }
 
 
 bool HostSchemeTimer::removeHostScheme(HostScheme::HostSchemeId hostSchemeId) {
     bool success;
 
-    QMutexLocker locker(&hostSchemeMutex);
-    HostSchemesByTimeOrder::iterator it = hostSchemesByTimeOrder.find(bitReverse32(hostSchemeId));
-    if (it != hostSchemesByTimeOrder.end()) {
-        if (hostSchemeIterator == it) {
-            hostSchemeIterator = hostSchemesByTimeOrder.erase(it);
-        } else {
-            hostSchemesByTimeOrder.erase(it);
-        }
+    hostSchemeMutex.lock();
+    HostSchemeEntry* entry = entriesByHostSchemeId.take(hostSchemeId);
+    currentNumberEntries.store(static_cast<unsigned long>(entriesByHostSchemeId.size()), std::memory_order_relaxed);
+    hostSchemeMutex.unlock();
+
+    if (entry != nullptr) {
+        QMetaObject::invokeMethod(
+            this,
+            [this, entry]() {
+                currentTimingWheel->cancel(entry);
+                delete entry;
+            }
+        );
 
         success = true;
     } else {
@@ -135,14 +256,172 @@ bool HostSchemeTimer::removeHostScheme(HostScheme::HostSchemeId hostSchemeId) {
 
 
 QPointer<HostScheme> HostSchemeTimer::getHostScheme(HostScheme::HostSchemeId hostSchemeId) const {
-    QMutexLocker locker(&hostSchemeMutex);
-    return hostSchemesByTimeOrder.value(bitReverse32(hostSchemeId));
+    QPointer<HostScheme> result;
+
+    QMutexLocker     locker(&hostSchemeMutex);
+    HostSchemeEntry* entry = entriesByHostSchemeId.value(hostSchemeId, nullptr);
+    if (entry != nullptr) {
+        result = entry->hostScheme();
+    }
+
+    return result;
+}
+
+
+void HostSchemeTimer::setOverloadPolicy(HostSchemeTimer::OverloadPolicy newOverloadPolicy) {
+    currentOverloadPolicy.store(newOverloadPolicy, std::memory_order_relaxed);
+}
+
+
+HostSchemeTimer::OverloadPolicy HostSchemeTimer::overloadPolicy() {
+    return currentOverloadPolicy.load(std::memory_order_relaxed);
+}
+
+
+HostSchemeTimer::OverloadPolicy HostSchemeTimer::toOverloadPolicy(const QString& name, bool* ok) {
+    OverloadPolicy result  = OverloadPolicy::SPREAD;
+    bool           success = true;
+    QString        lower   = name.toLower();
+
+    if (lower == QString("spread")) {
+        result = OverloadPolicy::SPREAD;
+    } else if (lower == QString("skip")) {
+        result = OverloadPolicy::SKIP;
+    } else if (lower == QString("shed")) {
+        result = OverloadPolicy::SHED;
+    } else {
+        success = false;
+    }
+
+    if (ok != nullptr) {
+        *ok = success;
+    }
+
+    return result;
+}
+
+
+void HostSchemeTimer::setRegionTransitionCycles(unsigned numberCycles) {
+    currentRegionTransitionCycles.store(numberCycles, std::memory_order_relaxed);
+}
+
+
+unsigned HostSchemeTimer::regionTransitionCycles() {
+    return currentRegionTransitionCycles.load(std::memory_order_relaxed);
 }
 
 
 void HostSchemeTimer::updateRegionData(unsigned regionIndex, unsigned numberRegions) {
+    QMetaObject::invokeMethod(
+        this,
+        [this, regionIndex, numberRegions]() {
+            applyRegionData(regionIndex, numberRegions);
+        }
+    );
+}
+
+
+void HostSchemeTimer::goInactive() {
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            currentActive = false;
+            scheduleAll(false);
+        }
+    );
+}
+
+
+void HostSchemeTimer::goActive() {
+    QMetaObject::invokeMethod(
+        this,
+        [this]() {
+            currentActive = true;
+            scheduleAll(true);
+        }
+    );
+}
+
+
+void HostSchemeTimer::timerExpired(TimingWheel::Entry* entry, unsigned long long currentTime) {
+    HostSchemeEntry*     hostSchemeEntry = static_cast<HostSchemeEntry*>(entry);
+    QPointer<HostScheme> hostScheme      = hostSchemeEntry->hostScheme();
+    unsigned long long   deadline        = hostSchemeEntry->deadline();
+    bool                 serviceNow      = true;
+
+    if (hostSchemeEntry->deferred()) {
+        // Lateness was already accounted for when the entry was deferred.
+        hostSchemeEntry->setDeferred(false);
+    } else {
+        if (currentTime > deadline) {
+            unsigned long long missedBy = currentTime - deadline;
+            if (missedBy > 1) {
+                ++numberMissedTimingWindows;
+                sumMillisecondsMissedTimingMarks += missedBy;
+
+                totalNumberMissedTimingMarks.fetch_add(1, std::memory_order_relaxed);
+                totalMillisecondsMissedTimingMarks.fetch_add(missedBy, std::memory_order_relaxed);
+
+                if (missedBy > overloadThresholdMilliseconds) {
+                    ++sheddingWindowLatePolls;
+
+                    // While shedding, late high priority host/schemes are serviced immediately rather than queued
+                    // behind, or skipped along with, everyone else.
+
+                    bool protectedHostScheme = (
+                           currentSheddingLevel.load(std::memory_order_relaxed) > 0
+                        && !hostScheme.isNull()
+                        && priorityOf(hostScheme) == Customer::Priority::HIGH
+                    );
+
+                    if (!protectedHostScheme) {
+                        serviceNow = applyOverloadPolicy(hostSchemeEntry, currentTime);
+                    }
+                }
+            }
+        }
+
+        ++sheddingWindowPolls;
+        totalNumberPolls.fetch_add(1, std::memory_order_relaxed);
+
+        if (serviceNow && !hostScheme.isNull()) {
+            serviceNow = !shedPoll(hostSchemeEntry, hostScheme, currentTime);
+        }
+    }
+
+    if (currentTime > nextTimingMarkReset) {
+        updateLoadingData(currentTime);
+    }
+
+    if (currentTime >= sheddingWindowEnd) {
+        updateSheddingLevel(currentTime);
+    }
+
+    if (serviceNow && !hostScheme.isNull()) {
+        if (schedulingEnabled()) {
+            scheduleEntry(hostSchemeEntry, currentTime);
+        }
+
+        HostScheme::RecheckOutcome recheckOutcome = hostScheme->serviceNextMonitor();
+        if (recheckOutcome == HostScheme::RecheckOutcome::PERFORMED) {
+            ++numberRechecksWindow;
+            totalNumberRechecks.fetch_add(1, std::memory_order_relaxed);
+        } else if (recheckOutcome == HostScheme::RecheckOutcome::DEFERRED) {
+            ++numberDeferredRechecksWindow;
+            totalNumberDeferredRechecks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+void HostSchemeTimer::applyRegionData(unsigned regionIndex, unsigned numberRegions) {
+    unsigned long long currentTime   = TimingWheel::currentTime();
+    bool               wasScheduling = schedulingEnabled();
+    unsigned long long oldOffset     = wasScheduling ? regionOffset(currentTime) : 0;
+
     currentRegionIndex   = regionIndex;
     currentNumberRegions = numberRegions;
+    currentActive        = true;
 
     currentPeriodMilliseconds = (
           1000
@@ -164,122 +443,262 @@ void HostSchemeTimer::updateRegionData(unsigned regionIndex, unsigned numberRegi
         false
     );
 
-    hostSchemeMutex.lock();
-    if (serviceTimer->isActive()) {
-        forceTimerResync = true;
+    numberMissedTimingWindows        = 0;
+    sumMillisecondsMissedTimingMarks = 0;
+    nextTimingMarkReset              = currentTime + missedTimingMarkResetInterval;
+
+    // Rescheduling every host/scheme at once moves every thread on every polling server at the same instant.  When
+    // staged, the scheduled entries are left alone and each picks up the sliding offset when it next fires.
+
+    unsigned numberCycles = currentRegionTransitionCycles.load(std::memory_order_relaxed);
+    if (numberCycles > 0 && wasScheduling && schedulingEnabled()) {
+        transitionStartOffset = oldOffset % currentPeriodMilliseconds;
+        transitionStartTime   = currentTime;
+        transitionEndTime     = currentTime + static_cast<unsigned long long>(numberCycles) * currentPeriodMilliseconds;
+    } else {
+        transitionEndTime = 0;
+        scheduleAll(schedulingEnabled());
     }
+}
 
-    bool workAvailable = !hostSchemesByTimeOrder.isEmpty();
-    hostSchemeMutex.unlock();
 
-    if (workAvailable) {
-        emit start();
+void HostSchemeTimer::scheduleAll(bool nowActive) {
+    unsigned long long currentTime = TimingWheel::currentTime();
+
+    QMutexLocker locker(&hostSchemeMutex);
+    for (  EntriesByHostSchemeId::const_iterator it  = entriesByHostSchemeId.constBegin(),
+                                                 end = entriesByHostSchemeId.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        HostSchemeEntry* entry = it.value();
+        if (nowActive) {
+            scheduleEntry(entry, currentTime);
+        } else {
+            currentTimingWheel->cancel(entry);
+        }
     }
 }
 
 
-void HostSchemeTimer::goInactive() {
-    emit stop();
+void HostSchemeTimer::scheduleEntry(HostSchemeEntry* entry, unsigned long long currentTime) {
+    entry->setDeferred(false);
+
+    // Each host/scheme fires at a fixed offset into the polling period based on the bit reversed host/scheme ID.
+    // This spreads host/schemes across the period no matter how the IDs were allocated.  The region offset shifts
+    // the entire cycle so that regions poll a multi-region host/scheme at evenly spaced times.
+
+    double             timeFraction = static_cast<double>(entry->phase()) / 4294967296.0;
+    unsigned long long timeOffset   = static_cast<unsigned long long>(currentPeriodMilliseconds * timeFraction + 0.5);
+    unsigned long long cycleOffset  = (regionOffset(currentTime) + timeOffset) % currentPeriodMilliseconds;
+    unsigned long long cycleStart   = currentPeriodMilliseconds * (currentTime / currentPeriodMilliseconds);
+    unsigned long long nextEvent    = cycleStart + cycleOffset;
+
+    if (nextEvent <= currentTime) {
+        nextEvent += currentPeriodMilliseconds;
+    }
+
+    // While the offset slides forward, an entry's next mark can land just after the poll that was just serviced.
+    // Holding the entry to roughly one period keeps it from being polled twice in quick succession.
+
+    if (currentTime < transitionEndTime && nextEvent < currentTime + currentPeriodMilliseconds / 2) {
+        nextEvent += currentPeriodMilliseconds;
+    }
+
+    currentTimingWheel->schedule(entry, nextEvent);
+
+    if (currentDnsCache != nullptr) {
+        QPointer<HostScheme> hostScheme = entry->hostScheme();
+        if (!hostScheme.isNull()) {
+            currentDnsCache->prefetch(hostScheme->url().host(), nextEvent);
+        }
+    }
 }
 
 
-void HostSchemeTimer::goActive() {
-    emit start();
+unsigned long long HostSchemeTimer::regionOffset(unsigned long long currentTime) const {
+    unsigned long long result;
+
+    if (currentTime >= transitionEndTime) {
+        result = regionTimeOffsetMilliseconds;
+    } else {
+        // The offset moves in whichever direction reaches the new offset soonest.
+
+        long long period = static_cast<long long>(currentPeriodMilliseconds);
+        long long delta  = (
+              static_cast<long long>(regionTimeOffsetMilliseconds)
+            - static_cast<long long>(transitionStartOffset)
+        );
+
+        if (delta > period / 2) {
+            delta -= period;
+        } else if (delta < -period / 2) {
+            delta += period;
+        }
+
+        double    fraction = (
+              static_cast<double>(currentTime - transitionStartTime)
+            / static_cast<double>(transitionEndTime - transitionStartTime)
+        );
+        long long offset   = static_cast<long long>(transitionStartOffset) + static_cast<long long>(delta * fraction);
+
+        if (offset < 0) {
+            offset += period;
+        }
+
+        result = static_cast<unsigned long long>(offset) % currentPeriodMilliseconds;
+    }
+
+    return result;
 }
 
 
-void HostSchemeTimer::startNextHostScheme() {
-    hostSchemeMutex.lock();
-    HostSchemesByTimeOrder::iterator end               = hostSchemesByTimeOrder.end();
-    unsigned                         numberHostSchemes = static_cast<unsigned>(hostSchemesByTimeOrder.size());
-
-    // There's a corner case where we have end up pointing to the end of the host/scheme list.  This can happen
-    // either when we deleted the last host/scheme in the map or when the map goes empty.  If that happens, we force
-    // our timing to resync or we go idle depending on whether we have any host/schemes to be serviced.
-
-    if (hostSchemeIterator == end || forceTimerResync) {
-        forceTimerResync = false;
-        if (numberHostSchemes > 0) {
-            hostSchemeMutex.unlock();
-            restartTimingCycle();
-        } else {
-            hostSchemeMutex.unlock();
+bool HostSchemeTimer::applyOverloadPolicy(HostSchemeEntry* entry, unsigned long long currentTime) {
+    bool           result;
+    OverloadPolicy policy = currentOverloadPolicy.load(std::memory_order_relaxed);
+
+    if (policy == OverloadPolicy::SKIP || (policy == OverloadPolicy::SHED && currentMultiRegion)) {
+        if (schedulingEnabled()) {
+            scheduleEntry(entry, currentTime);
         }
+
+        result = false;
     } else {
-        QPointer<HostScheme> hostScheme = hostSchemeIterator.value();
+        // Space late host/schemes at the nominal spacing between polls so a stall drains as a steady stream.
 
-        ++hostSchemeIterator;
-        if (hostSchemeIterator == end) {
-            hostSchemeMutex.unlock();
-            restartTimingCycle();
-        } else {
-            hostSchemeMutex.unlock();
-            scheduleNextHostScheme();
+        unsigned long      numberEntries = currentNumberEntries.load(std::memory_order_relaxed);
+        unsigned long long spacing       = numberEntries > 0 ? currentPeriodMilliseconds / numberEntries : 1;
+        if (spacing == 0) {
+            spacing = 1;
         }
 
-        hostScheme->serviceNextMonitor();
+        if (spreadCursor <= currentTime) {
+            spreadCursor = currentTime + spacing;
+            result       = true;
+        } else {
+            entry->setDeferred(true);
+            currentTimingWheel->schedule(entry, spreadCursor);
+
+            spreadCursor += spacing;
+            result        = false;
+        }
     }
+
+    return result;
 }
 
 
-void HostSchemeTimer::startTimer() {
-    if (currentNumberRegions > 0 && !hostSchemesByTimeOrder.isEmpty()) {
-        numberMissedTimingWindows          = 0;
-        sumMillisecondsMissedTimingMarks   = 0;
-        nextTimingMarkReset                = QDateTime::currentMSecsSinceEpoch() + missedTimingMarkResetInterval;
+bool HostSchemeTimer::shedPoll(HostSchemeEntry* entry, HostScheme* hostScheme, unsigned long long currentTime) {
+    bool     result        = false;
+    unsigned sheddingLevel = currentSheddingLevel.load(std::memory_order_relaxed);
+
+    if (sheddingLevel > 0) {
+        unsigned divisor = cadenceDivisor(priorityOf(hostScheme), sheddingLevel);
+        if (divisor > 1 && entry->countCycle() % divisor != 0) {
+            if (schedulingEnabled()) {
+                scheduleEntry(entry, currentTime);
+            }
+
+            ++numberShedPollsWindow;
+            totalNumberShedPolls.fetch_add(1, std::memory_order_relaxed);
+
+            result = true;
+        }
+    }
+
+    return result;
+}
+
 
-        restartTimingCycle();
+Customer::Priority HostSchemeTimer::priorityOf(const HostScheme* hostScheme) {
+    Customer::Priority result   = Customer::Priority::NORMAL;
+    Customer*          customer = hostScheme->customer();
+    if (customer != nullptr) {
+        result = customer->priority();
     }
+
+    return result;
 }
 
 
-void HostSchemeTimer::restartTimingCycle() {
-    hostSchemeIterator = hostSchemesByTimeOrder.begin();
+void HostSchemeTimer::updateSheddingLevel(unsigned long long currentTime) {
+    // Windows with too few polls say little about our timing so they neither raise nor lower the level.
+
+    if (sheddingWindowPolls >= minimumSheddingWindowPolls) {
+        double lateFraction = static_cast<double>(sheddingWindowLatePolls) / sheddingWindowPolls;
+        if (lateFraction >= sheddingEngageFraction) {
+            ++numberOverloadedWindows;
+            numberHealthyWindows = 0;
+        } else if (lateFraction <= sheddingReleaseFraction) {
+            ++numberHealthyWindows;
+            numberOverloadedWindows = 0;
+        } else {
+            numberOverloadedWindows = 0;
+            numberHealthyWindows    = 0;
+        }
+
+        unsigned oldSheddingLevel = currentSheddingLevel.load(std::memory_order_relaxed);
+        unsigned newSheddingLevel = oldSheddingLevel;
+        if (numberOverloadedWindows >= sheddingWindowsPerStep && oldSheddingLevel < maximumSheddingLevel) {
+            newSheddingLevel        = oldSheddingLevel + 1;
+            numberOverloadedWindows = 0;
+        } else if (numberHealthyWindows >= sheddingWindowsPerStep && oldSheddingLevel > 0) {
+            newSheddingLevel     = oldSheddingLevel - 1;
+            numberHealthyWindows = 0;
+        }
+
+        if (newSheddingLevel != oldSheddingLevel) {
+            currentSheddingLevel.store(newSheddingLevel, std::memory_order_relaxed);
 
-    unsigned long long currentTime = QDateTime::currentMSecsSinceEpoch();
-    unsigned long long cycleIndex  = currentTime / currentPeriodMilliseconds;
+            logWrite(
+                QString("Host/Scheme Timer, period %1 mSec, load shedding level %2 -> %3, %4% of polls late")
+                .arg(currentPeriodMilliseconds)
+                .arg(oldSheddingLevel)
+                .arg(newSheddingLevel)
+                .arg(100.0 * lateFraction, 0, 'f', 1),
+                newSheddingLevel > oldSheddingLevel
+            );
 
-    pollingCycleStartTime = currentPeriodMilliseconds * (cycleIndex + 1) + regionTimeOffsetMilliseconds;
+            emit sheddingLevelChanged(newSheddingLevel);
+        }
+    }
 
-    scheduleNextHostScheme();
+    sheddingWindowPolls     = 0;
+    sheddingWindowLatePolls = 0;
+    sheddingWindowEnd       = currentTime + sheddingWindowMilliseconds;
 }
 
 
-void HostSchemeTimer::scheduleNextHostScheme() {
-    double             timeFraction = static_cast<double>(hostSchemeIterator.key()) / 4294967296.0;
-    unsigned long long timeOffset   = static_cast<unsigned long>(currentPeriodMilliseconds * timeFraction + 0.5);
-    unsigned long long nextEvent    = pollingCycleStartTime + timeOffset;
-    unsigned long long currentTime  = QDateTime::currentMSecsSinceEpoch();
+bool HostSchemeTimer::schedulingEnabled() const {
+    return currentActive && currentNumberRegions > 0 && currentPeriodMilliseconds > 0;
+}
+
 
-    if (nextEvent > currentTime) {
-        serviceTimer->start(nextEvent - currentTime);
+void HostSchemeTimer::updateLoadingData(unsigned long long currentTime) {
+    double averageMissedTimingMarks;
+    if (numberMissedTimingWindows > 0) {
+        averageMissedTimingMarks = sumMillisecondsMissedTimingMarks / (1000.0 * numberMissedTimingWindows);
     } else {
-        unsigned long long missedBy = currentTime - nextEvent;
-        if (missedBy > 1) {
-            ++numberMissedTimingWindows;
-            sumMillisecondsMissedTimingMarks += missedBy;
-        }
-
-        serviceTimer->start(0);
+        averageMissedTimingMarks = 0;
     }
 
-    if (currentTime > nextTimingMarkReset) {
-        QMutexLocker locker(&hostSchemeMutex);
-        double averageMissedTimingMarks;
-        if (numberMissedTimingWindows > 0) {
-            averageMissedTimingMarks = sumMillisecondsMissedTimingMarks / (1000.0 * numberMissedTimingWindows);
-        } else {
-            averageMissedTimingMarks = 0;
-        }
+    currentLoadingData = LoadingData(
+        currentNumberEntries.load(std::memory_order_relaxed),
+        numberMissedTimingWindows,
+        averageMissedTimingMarks,
+        numberRechecksWindow,
+        numberDeferredRechecksWindow,
+        numberShedPollsWindow,
+        currentSheddingLevel.load(std::memory_order_relaxed)
+    );
 
-        currentLoadingData = LoadingData(
-            static_cast<unsigned long>(hostSchemesByTimeOrder.size()),
-            numberMissedTimingWindows,
-            averageMissedTimingMarks
-        );
+    numberMissedTimingWindows        = 0;
+    sumMillisecondsMissedTimingMarks = 0;
+    numberRechecksWindow             = 0;
+    numberDeferredRechecksWindow     = 0;
+    numberShedPollsWindow            = 0;
 
-        numberMissedTimingWindows        = 0;
-        sumMillisecondsMissedTimingMarks = 0;
-        nextTimingMarkReset              += missedTimingMarkResetInterval;
+    while (nextTimingMarkReset < currentTime) {
+        nextTimingMarkReset += missedTimingMarkResetInterval;
     }
 }
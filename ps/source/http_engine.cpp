@@ -0,0 +1,165 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref HttpEngine class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include "dns_cache.h"
+#include "qt_http_engine.h"
+
+#if (defined(Q_OS_LINUX))
+
+    #include "native_http_engine.h"
+
+#endif
+
+#include "http_engine.h"
+
+/***********************************************************************************************************************
+* HttpEngine::Request
+*/
+
+HttpEngine::Request::Request(HttpEngine::Client* client) {
+    currentClient = client;
+    currentTimer.start();
+}
+
+
+HttpEngine::Request::~Request() {}
+
+
+unsigned long long HttpEngine::Request::elapsedNanoseconds() const {
+    return static_cast<unsigned long long>(currentTimer.nsecsElapsed());
+}
+
+
+HttpEngine::PhaseTimes HttpEngine::Request::phaseTimes() const {
+    return currentPhaseTimes;
+}
+
+
+void HttpEngine::Request::recordResolved() {
+    recordPhase(currentPhaseTimes.resolvedNanoseconds);
+}
+
+
+void HttpEngine::Request::recordConnected() {
+    recordPhase(currentPhaseTimes.connectedNanoseconds);
+}
+
+
+void HttpEngine::Request::recordHandshake() {
+    recordPhase(currentPhaseTimes.handshakeNanoseconds);
+}
+
+
+void HttpEngine::Request::recordFirstByte(unsigned long long receiveDelayNanoseconds) {
+    recordPhase(currentPhaseTimes.firstByteNanoseconds, receiveDelayNanoseconds);
+}
+
+
+void HttpEngine::Request::recordCompleted(unsigned long long receiveDelayNanoseconds) {
+    recordPhase(currentPhaseTimes.completedNanoseconds, receiveDelayNanoseconds);
+}
+
+/***********************************************************************************************************************
+* HttpEngine
+*/
+
+const QByteArray HttpEngine::getVerb("GET");
+const QByteArray HttpEngine::headVerb("HEAD");
+const QByteArray HttpEngine::postVerb("POST");
+const QByteArray HttpEngine::putVerb("PUT");
+const QByteArray HttpEngine::deleteVerb("DELETE");
+const QByteArray HttpEngine::optionsVerb("OPTIONS");
+const QByteArray HttpEngine::patchVerb("PATCH");
+
+HttpEngine* HttpEngine::create(HttpEngine::Backend backend, DnsCache* dnsCache) {
+    HttpEngine* result = nullptr;
+
+    switch (backend) {
+        case Backend::QT: {
+            result = new QtHttpEngine;
+            break;
+        }
+
+        case Backend::NATIVE: {
+            #if (defined(Q_OS_LINUX))
+
+                NativeHttpEngine* engine = new NativeHttpEngine(dnsCache);
+                if (engine->isValid()) {
+                    result = engine;
+                } else {
+                    delete engine;
+                }
+
+            #else
+
+                Q_UNUSED(dnsCache);
+
+            #endif
+
+            break;
+        }
+
+        default: {
+            Q_ASSERT(false);
+            break;
+        }
+    }
+
+    return result;
+}
+
+
+QString HttpEngine::toString(HttpEngine::Backend backend) {
+    QString result;
+
+    switch (backend) {
+        case Backend::QT:     { result = QString("qt");      break; }
+        case Backend::NATIVE: { result = QString("native");  break; }
+        default:              { Q_ASSERT(false);             break; }
+    }
+
+    return result;
+}
+
+
+HttpEngine::Backend HttpEngine::toBackend(const QString& name, bool* ok) {
+    Backend result  = Backend::QT;
+    bool    success = true;
+    QString lower   = name.toLower();
+
+    if (lower == QString("qt")) {
+        result = Backend::QT;
+    } else if (lower == QString("native")) {
+        result = Backend::NATIVE;
+    } else {
+        success = false;
+    }
+
+    if (ok != nullptr) {
+        *ok = success;
+    }
+
+    return result;
+}
@@ -19,29 +19,49 @@
 ***********************************************************************************************************************/
 
 #include <QThread>
-#include <QNetworkAccessManager>
 #include <QSharedPointer>
 #include <QHash>
 #include <QMultiMap>
+#include <QList>
 #include <QMutex>
 #include <QMutexLocker>
 
 #include <cstdint>
+#include <algorithm>
 
+#include "log.h"
 #include "customer.h"
 #include "data_aggregator.h"
 #include "loading_data.h"
 #include "host_scheme_timer.h"
+#include "timing_wheel.h"
+#include "event_loop_lag_probe.h"
+#include "object_index.h"
+#include "state_snapshot.h"
 #include "service_thread.h"
+#include "thread_affinity.h"
+#include "http_engine.h"
+#include "coalescing_http_engine.h"
 #include "http_service_thread.h"
 
-HttpServiceThread::HttpServiceThread(DataAggregator* dataAggregator, QObject* parent):ServiceThread(parent) {
+HttpServiceThread::HttpServiceThread(
+        DataAggregator* dataAggregator,
+        DnsCache*       dnsCache,
+        ObjectIndex*    objectIndex,
+        QObject*        parent
+    ):ServiceThread(
+        parent
+    ) {
     currentDataAggregator = dataAggregator;
+    currentDnsCache       = dnsCache;
+    currentObjectIndex    = objectIndex;
+    currentLatencyRing    = dataAggregator->createLatencyRing();
 
-    networkAccessManager = new QNetworkAccessManager;
-    networkAccessManager->setRedirectPolicy(QNetworkRequest::RedirectPolicy::NoLessSafeRedirectPolicy);
-    networkAccessManager->setStrictTransportSecurityEnabled(true);
-    networkAccessManager->moveToThread(this);
+    timingWheel = new TimingWheel;
+    timingWheel->moveToThread(this);
+
+    currentEventLoopLagProbe = new EventLoopLagProbe;
+    currentEventLoopLagProbe->moveToThread(this);
 
     currentThreadObject = new QObject;
     currentThreadObject->moveToThread(this);
@@ -50,87 +70,387 @@ HttpServiceThread::HttpServiceThread(DataAggregator* dataAggregator, QObject* pa
     currentNumberRegions        = 0;
     currentActive               = false;
     currentHostSchemesPerSecond = 0;
+    currentSheddingLevel        = 0;
+    bulkLoadInProgress          = false;
+    commandsScheduled           = false;
+    qtHttpEngine                = nullptr;
+    nativeHttpEngine            = nullptr;
+    coalescingHttpEngine        = nullptr;
+    fetchCoalescingEnabled      = false;
 
     start();
+
+    // Engines create sockets and timers so they must be created from within the thread that uses them.
+
+    QMetaObject::invokeMethod(
+        currentThreadObject,
+        [this]() {
+            qtHttpEngine = HttpEngine::create(HttpEngine::Backend::QT, currentDnsCache);
+        },
+        Qt::BlockingQueuedConnection
+    );
+
+    selectedHttpEngine = qtHttpEngine;
+    currentHttpEngine  = qtHttpEngine;
 }
 
 
 HttpServiceThread::~HttpServiceThread() {
+    // Deleting a monitor aborts its pending request so the customers are deleted ahead of the HTTP engines, from
+    // within this thread.
+
+    QMetaObject::invokeMethod(
+        currentThreadObject,
+        [this]() {
+            processCommands();
+
+            for (  CustomersByCustomerId::const_iterator it  = customersByCustomerId.constBegin(),
+                                                         end = customersByCustomerId.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                delete it.value();
+            }
+
+            customersByCustomerId.clear();
+
+            delete coalescingHttpEngine;
+            delete nativeHttpEngine;
+            delete qtHttpEngine;
+        },
+        Qt::BlockingQueuedConnection
+    );
+
     quit();
     wait();
 
     delete currentThreadObject;
-    delete networkAccessManager;
+    delete timingWheel;
+    delete currentEventLoopLagProbe;
 
-    for (  CustomersByCustomerId::const_iterator it  = customersByCustomerId.constBegin(),
-                                                 end = customersByCustomerId.constEnd()
-         ; it != end
-         ; ++it
-        ) {
-        delete it.value();
-    }
+    currentDataAggregator->releaseLatencyRing(currentLatencyRing);
 }
 
 
 float HttpServiceThread::hostSchemesPerSecond() const {
-    return currentHostSchemesPerSecond;
+    return currentHostSchemesPerSecond.load(std::memory_order_relaxed);
+}
+
+
+unsigned HttpServiceThread::sheddingLevel() const {
+    return currentSheddingLevel.load(std::memory_order_relaxed);
 }
 
 
-QMultiMap<int, LoadingData> HttpServiceThread::loadingData() const {
+QMultiMap<int, LoadingData> HttpServiceThread::loadingData() {
     QMultiMap<int, LoadingData> result;
-    for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
-                                                       end = hostSchemeTimers.constEnd()
-         ; it != end
-         ; ++it
-        ) {
-        HostSchemeTimer* hostSchemeTimer = it.value();
-        result.insert(it.key(), hostSchemeTimer->loadingData());
-    }
+
+    executeCommand(
+        [this, &result]() {
+            for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
+                                                               end = hostSchemeTimers.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                HostSchemeTimer* hostSchemeTimer = it.value();
+                result.insert(it.key(), hostSchemeTimer->loadingData());
+            }
+        }
+    );
 
     return result;
 }
 
 
-void HttpServiceThread::addCustomer(Customer* customer) {
-    customer->currentServiceThread = this;
-    customerAdded(customer);
+LoadingData HttpServiceThread::cumulativeLoadingData() {
+    unsigned long numberPolls             = 0;
+    unsigned long numberMissedTimingMarks = 0;
+    double        sumTimingError          = 0;
+    unsigned long numberRechecks          = 0;
+    unsigned long numberDeferredRechecks  = 0;
+
+    executeCommand(
+        [&]() {
+            for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
+                                                               end = hostSchemeTimers.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                LoadingData timerLoadingData = it.value()->cumulativeLoadingData();
+
+                numberPolls             += timerLoadingData.numberPolledHostSchemes();
+                numberMissedTimingMarks += timerLoadingData.numberMissedTimingMarks();
+                sumTimingError          += (
+                    timerLoadingData.averageTimingError() * timerLoadingData.numberMissedTimingMarks()
+                );
+                numberRechecks          += timerLoadingData.numberRechecks();
+                numberDeferredRechecks  += timerLoadingData.numberDeferredRechecks();
+            }
+        }
+    );
+
+    return LoadingData(
+        numberPolls,
+        numberMissedTimingMarks,
+        numberMissedTimingMarks > 0 ? sumTimingError / numberMissedTimingMarks : 0,
+        numberRechecks,
+        numberDeferredRechecks
+    );
 }
 
 
-bool HttpServiceThread::removeCustomer(Customer::CustomerId customerId) {
-    bool success;
+void HttpServiceThread::addCustomer(Customer* customer) {
+    // The customer is indexed before the command is queued so that later requests for the customer are routed to
+    // this thread, and ordered behind the add, while the add is still pending.
+
+    if (customer->thread() != this) {
+        customer->moveToThread(this);
+    }
 
-    customerMutex.lock();
-    CustomersByCustomerId::iterator it = customersByCustomerId.find(customerId);
-    if (it != customersByCustomerId.end()) {
-        Customer* customer = it.value();
+    currentObjectIndex->insertCustomer(customer, this);
+    postCommand(
+        [this, customer]() {
+            registerCustomer(customer);
+        }
+    );
+}
 
-        customersByCustomerId.erase(it);
-        customerMutex.unlock();
 
-        customer->reportExistingHostSchemesAndMonitors(this, false);
+void HttpServiceThread::addCustomers(const QList<Customer*>& customers) {
+    // QObject::moveToThread can only push an object from its current thread so the customers are moved here.  Each
+    // move carries the customer's host/schemes and monitors with it.
 
-        delete customer;
-        success = true;
-    } else {
-        customerMutex.unlock();
-        success = false;
+    for (QList<Customer*>::const_iterator it=customers.constBegin(),end=customers.constEnd() ; it!=end ; ++it) {
+        Customer* customer = *it;
+        customer->moveToThread(this);
+        currentObjectIndex->insertCustomer(customer, this);
     }
 
+    executeCommand(
+        [this, &customers]() {
+            bulkLoadInProgress = true;
+
+            for (QList<Customer*>::const_iterator it=customers.constBegin(),end=customers.constEnd() ; it!=end ; ++it) {
+                registerCustomer(*it);
+            }
+
+            bulkLoadInProgress = false;
+            updateServiceMetrics();
+        }
+    );
+}
+
+
+void HttpServiceThread::removeCustomer(Customer::CustomerId customerId) {
+    // A customer re-added under the same ID is indexed before our command runs.  The removal from within the thread
+    // only drops index entries that still refer to this customer's objects.
+
+    currentObjectIndex->removeCustomer(customerId);
+    postCommand(
+        [this, customerId]() {
+            Customer* customer = customersByCustomerId.value(customerId);
+            if (customer != nullptr) {
+                customerAboutToBeRemoved(customer);
+                delete customer;
+            }
+        }
+    );
+}
+
+
+bool HttpServiceThread::updateCustomer(Customer* customer) {
+    bool     success      = false;
+    QThread* callerThread = QThread::currentThread();
+
+    // The existing customer adopts objects from the new customer so both must live in our thread.  If the update
+    // fails, the new customer is pushed back to the caller's thread before we return.
+
+    customer->moveToThread(this);
+
+    executeCommand(
+        [this, customer, callerThread, &success]() {
+            Customer* existingCustomer = getCustomer(customer->customerId());
+            if (existingCustomer != nullptr) {
+                existingCustomer->updateFrom(customer);
+                delete customer;
+
+                success = true;
+            } else {
+                customer->moveToThread(callerThread);
+            }
+        }
+    );
+
+    return success;
+}
+
+
+bool HttpServiceThread::migrateCustomer(Customer::CustomerId customerId, HttpServiceThread* newServiceThread) {
+    bool success = false;
+
+    // QObject::moveToThread can only push an object from the object's current thread so the migration is performed
+    // within our thread.  Running here also guarantees that our host/scheme timers drop the customer's host/schemes
+    // before the timing wheel can fire for them again.
+
+    executeCommand(
+        [this, customerId, newServiceThread, &success]() {
+            Customer* customer = getCustomer(customerId);
+            if (customer != nullptr) {
+                customerAboutToBeRemoved(customer);
+                customer->cancelPendingChecks();
+                newServiceThread->addCustomer(customer);
+
+                success = true;
+            }
+        }
+    );
+
     return success;
 }
 
 
+void HttpServiceThread::captureState(StateSnapshot* stateSnapshot) {
+    executeCommand(
+        [this, stateSnapshot]() {
+            for (  CustomersByCustomerId::const_iterator customerIterator    = customersByCustomerId.constBegin(),
+                                                         customerEndIterator = customersByCustomerId.constEnd()
+                 ; customerIterator != customerEndIterator
+                 ; ++customerIterator
+                ) {
+                QList<HostScheme*> hostSchemes = customerIterator.value()->hostSchemes();
+                for (  QList<HostScheme*>::const_iterator hostSchemeIterator    = hostSchemes.constBegin(),
+                                                          hostSchemeEndIterator = hostSchemes.constEnd()
+                     ; hostSchemeIterator != hostSchemeEndIterator
+                     ; ++hostSchemeIterator
+                    ) {
+                    const HostScheme* hostScheme = *hostSchemeIterator;
+                    stateSnapshot->recordHostScheme(hostScheme);
+
+                    QList<Monitor*> monitors = hostScheme->monitors();
+                    for (  QList<Monitor*>::const_iterator monitorIterator    = monitors.constBegin(),
+                                                           monitorEndIterator = monitors.constEnd()
+                         ; monitorIterator != monitorEndIterator
+                         ; ++monitorIterator
+                        ) {
+                        stateSnapshot->recordMonitor(*monitorIterator);
+                    }
+                }
+            }
+        }
+    );
+}
+
+
+void HttpServiceThread::setCpuAffinity(const ThreadAffinity::CpuList& cpus) {
+    postCommand(
+        [cpus]() {
+            if (!ThreadAffinity::apply(cpus)) {
+                logWrite(
+                    QString("Could not pin HTTP service thread to CPUs %1").arg(ThreadAffinity::toString(cpus)),
+                    true
+                );
+            }
+        }
+    );
+}
+
+
+void HttpServiceThread::setHttpEngineBackend(HttpEngine::Backend backend) {
+    postCommand(
+        [this, backend]() {
+            selectedHttpEngine = qtHttpEngine;
+            if (backend == HttpEngine::Backend::NATIVE) {
+                if (nativeHttpEngine == nullptr) {
+                    nativeHttpEngine = HttpEngine::create(backend, currentDnsCache);
+                }
+
+                if (nativeHttpEngine != nullptr) {
+                    selectedHttpEngine = nativeHttpEngine;
+                } else {
+                    logWrite(QString("Native HTTP engine is not available, using the Qt HTTP engine."), true);
+                }
+            }
+
+            applyHttpEngine();
+        }
+    );
+}
+
+
+void HttpServiceThread::setFetchCoalescingEnabled(bool nowEnabled) {
+    postCommand(
+        [this, nowEnabled]() {
+            fetchCoalescingEnabled = nowEnabled;
+            applyHttpEngine();
+        }
+    );
+}
+
+
+void HttpServiceThread::setPaused(Customer::CustomerId customerId, bool nowPaused) {
+    postCommand(
+        [this, customerId, nowPaused]() {
+            Customer* customer = customersByCustomerId.value(customerId);
+            if (customer != nullptr) {
+                customer->setPaused(nowPaused);
+            }
+        }
+    );
+}
+
+
+bool HttpServiceThread::paused(Customer::CustomerId customerId) {
+    bool result = false;
+
+    executeCommand(
+        [this, customerId, &result]() {
+            Customer* customer = customersByCustomerId.value(customerId);
+            result = customer != nullptr && customer->paused();
+        }
+    );
+
+    return result;
+}
+
+
+QList<Customer*> HttpServiceThread::customers() {
+    QList<Customer*> result;
+
+    executeCommand(
+        [this, &result]() {
+            result = customersByCustomerId.values();
+        }
+    );
+
+    return result;
+}
+
+
+QHash<Customer::CustomerId, double> HttpServiceThread::customerServiceRates(unsigned numberRegions) {
+    QHash<Customer::CustomerId, double> result;
+
+    executeCommand(
+        [this, numberRegions, &result]() {
+            for (  CustomersByCustomerId::const_iterator it  = customersByCustomerId.constBegin(),
+                                                         end = customersByCustomerId.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                result.insert(it.key(), it.value()->serviceRate(numberRegions));
+            }
+        }
+    );
+
+    return result;
+}
+
+
 Customer* HttpServiceThread::getCustomer(Customer::CustomerId customerId) const {
-    QMutexLocker locker(&customerMutex);
     return customersByCustomerId.value(customerId);
 }
 
 
 HostScheme* HttpServiceThread::getHostScheme(HostScheme::HostSchemeId hostSchemeId) const {
-    QMutexLocker locker(&hostSchemeMutex);
-
     QMap<int, HostSchemeTimer*>::const_iterator it     = hostSchemeTimers.constBegin();
     QMap<int, HostSchemeTimer*>::const_iterator end    = hostSchemeTimers.constEnd();
     HostScheme*                                 result = nullptr;
@@ -145,83 +465,188 @@ HostScheme* HttpServiceThread::getHostScheme(HostScheme::HostSchemeId hostScheme
 
 
 Monitor* HttpServiceThread::getMonitor(Monitor::MonitorId monitorId) const {
-    QMutexLocker locker(&monitorMutex);
     return monitorsByMonitorId.value(monitorId);
 }
 
 
 void HttpServiceThread::checkNow(QPointer<HostScheme> hostScheme) {
-    QMutexLocker locker(&hostSchemeMutex);
-    if (!hostScheme.isNull()) {
-        hostScheme->startCheckFromDifferentThread();
-    }
+    postCommand(
+        [hostScheme]() {
+            if (!hostScheme.isNull()) {
+                hostScheme->serviceNextMonitor();
+            }
+        }
+    );
 }
 
 
 void HttpServiceThread::updateRegionData(unsigned regionIndex, unsigned numberRegions) {
-    currentRegionIndex   = regionIndex;
-    currentNumberRegions = numberRegions;
-    currentActive        = true;
-
-    for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
-                                                       end = hostSchemeTimers.constEnd()
-         ; it != end
-         ; ++it
-        ) {
-        HostSchemeTimer* hostSchemeTimer = it.value();
-        hostSchemeTimer->updateRegionData(regionIndex, numberRegions);
-    }
+    postCommand(
+        [this, regionIndex, numberRegions]() {
+            currentRegionIndex   = regionIndex;
+            currentNumberRegions = numberRegions;
+            currentActive        = true;
+
+            for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
+                                                               end = hostSchemeTimers.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                HostSchemeTimer* hostSchemeTimer = it.value();
+                hostSchemeTimer->updateRegionData(regionIndex, numberRegions);
+            }
+        }
+    );
 }
 
 
 void HttpServiceThread::goInactive() {
-    currentActive = false;
+    postCommand(
+        [this]() {
+            currentActive = false;
+
+            for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
+                                                               end = hostSchemeTimers.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                HostSchemeTimer* hostSchemeTimer = it.value();
+                hostSchemeTimer->goInactive();
+            }
+        }
+    );
+}
 
-    for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
-                                                       end = hostSchemeTimers.constEnd()
-         ; it != end
-         ; ++it
-        ) {
-        HostSchemeTimer* hostSchemeTimer = it.value();
-        hostSchemeTimer->goInactive();
+
+void HttpServiceThread::goActive() {
+    postCommand(
+        [this]() {
+            currentActive = true;
+
+            for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
+                                                               end = hostSchemeTimers.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                HostSchemeTimer* hostSchemeTimer = it.value();
+                hostSchemeTimer->goActive();
+            }
+        }
+    );
+}
+
+
+void HttpServiceThread::run() {
+    exec();
+}
+
+
+void HttpServiceThread::postCommand(const Command& command) {
+    QMutexLocker locker(&commandMutex);
+
+    pendingCommands.append(command);
+    if (!commandsScheduled) {
+        commandsScheduled = true;
+        QMetaObject::invokeMethod(
+            currentThreadObject,
+            [this]() {
+                processCommands();
+            },
+            Qt::QueuedConnection
+        );
     }
 }
 
 
-void HttpServiceThread::goActive() {
-    currentActive = true;
-    for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
-                                                       end = hostSchemeTimers.constEnd()
-         ; it != end
-         ; ++it
-        ) {
-        HostSchemeTimer* hostSchemeTimer = it.value();
-        hostSchemeTimer->goActive();
+void HttpServiceThread::executeCommand(const Command& command) {
+    // Draining the queue first keeps blocking commands ordered behind every command posted before them.
 
+    QMetaObject::invokeMethod(
+        currentThreadObject,
+        [this, &command]() {
+            processCommands();
+            command();
+        },
+        Qt::BlockingQueuedConnection
+    );
+}
+
+
+void HttpServiceThread::processCommands() {
+    commandMutex.lock();
+
+    QList<Command> commands;
+    commands.swap(pendingCommands);
+    commandsScheduled = false;
+
+    commandMutex.unlock();
+
+    if (!commands.isEmpty()) {
+        bulkLoadInProgress = true;
+
+        for (QList<Command>::const_iterator it=commands.constBegin(),end=commands.constEnd() ; it!=end ; ++it) {
+            (*it)();
+        }
+
+        bulkLoadInProgress = false;
+        updateServiceMetrics();
     }
 }
 
 
-void HttpServiceThread::run() {
-    exec();
+void HttpServiceThread::registerCustomer(Customer* customer) {
+    customer->currentServiceThread = this;
+    customerAdded(customer);
 }
 
 
 void HttpServiceThread::monitorAdded(Monitor* monitor) {
-    QMutexLocker locker(&monitorMutex);
     monitorsByMonitorId.insert(monitor->monitorId(), monitor);
+    currentObjectIndex->insertMonitor(monitor);
 }
 
 
 void HttpServiceThread::monitorAboutToBeRemoved(Monitor* monitor) {
-    QMutexLocker locker(&monitorMutex);
     monitorsByMonitorId.remove(monitor->monitorId());
+    currentObjectIndex->removeMonitor(monitor);
 }
 
 
-void HttpServiceThread::hostSchemeAdded(HostScheme* hostScheme) {
-    hostSchemeMutex.lock();
+void HttpServiceThread::applyHttpEngine() {
+    HttpEngine* httpEngine = selectedHttpEngine;
+    if (fetchCoalescingEnabled) {
+        if (coalescingHttpEngine == nullptr) {
+            coalescingHttpEngine = new CoalescingHttpEngine(selectedHttpEngine, &currentThreadMetrics);
+        } else {
+            coalescingHttpEngine->setEngine(selectedHttpEngine);
+        }
+
+        httpEngine = coalescingHttpEngine;
+    }
+
+    if (httpEngine != currentHttpEngine) {
+        // Host/schemes added after the engine is swapped pick up the new engine in hostSchemeAdded.
+
+        currentHttpEngine = httpEngine;
+        for (  CustomersByCustomerId::const_iterator it  = customersByCustomerId.constBegin(),
+                                                     end = customersByCustomerId.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            QList<HostScheme*> hostSchemes = it.value()->hostSchemes();
+            for (  QList<HostScheme*>::const_iterator hostSchemeIterator = hostSchemes.constBegin(),
+                                                      hostSchemeEnd      = hostSchemes.constEnd()
+                 ; hostSchemeIterator != hostSchemeEnd
+                 ; ++hostSchemeIterator
+                ) {
+                (*hostSchemeIterator)->setHttpEngine(httpEngine);
+            }
+        }
+    }
+}
+
 
+void HttpServiceThread::hostSchemeAdded(HostScheme* hostScheme) {
     Customer*                             customer              = hostScheme->customer();
     unsigned                              pollingInterval       = customer->pollingInterval();
     bool                                  multiRegion           = customer->supportsMultiRegionTesting();
@@ -237,24 +662,36 @@ void HttpServiceThread::hostSchemeAdded(HostScheme* hostScheme) {
             pollingInterval,
             currentRegionIndex,
             currentNumberRegions,
-            currentActive
+            currentActive,
+            timingWheel,
+            currentDnsCache
         );
 
         hostSchemeTimer->moveToThread(this);
         hostSchemeTimers.insert(signedPollingInterval, hostSchemeTimer);
+
+        connect(
+            hostSchemeTimer,
+            &HostSchemeTimer::sheddingLevelChanged,
+            currentThreadObject,
+            [this]() {
+                updateSheddingLevel();
+            }
+        );
     }
 
-    hostScheme->setNetworkAccessManager(networkAccessManager);
+    hostScheme->setHttpEngine(currentHttpEngine);
     hostSchemeTimer->addHostScheme(hostScheme);
 
-    hostSchemeMutex.unlock();
-    updateServiceMetrics();
+    currentObjectIndex->insertHostScheme(hostScheme);
+
+    if (!bulkLoadInProgress) {
+        updateServiceMetrics();
+    }
 }
 
 
 void HttpServiceThread::hostSchemeAboutToBeRemoved(HostScheme* hostScheme) {
-    hostSchemeMutex.lock();
-
     Customer*                             customer              = hostScheme->customer();
     unsigned                              pollingInterval       = customer->pollingInterval();
     bool                                  multiRegion           = customer->supportsMultiRegionTesting();
@@ -266,32 +703,31 @@ void HttpServiceThread::hostSchemeAboutToBeRemoved(HostScheme* hostScheme) {
         hostSchemeTimer->removeHostScheme(hostScheme->hostSchemeId());
     }
 
-    hostSchemeMutex.unlock();
+    currentObjectIndex->removeHostScheme(hostScheme);
 
-    updateServiceMetrics();
+    if (!bulkLoadInProgress) {
+        updateServiceMetrics();
+    }
 }
 
 
 void HttpServiceThread::customerAdded(Customer* customer) {
-    QMutexLocker locker(&customerMutex);
-    customersByCustomerId.insert(customer->customerId(), customer);
-    customer->moveToThread(this);
+    // The customer is indexed by the thread that handed it to us, see addCustomer.
 
+    customersByCustomerId.insert(customer->customerId(), customer);
     customer->reportExistingHostSchemesAndMonitors(this, true);
 }
 
 
 void HttpServiceThread::customerAboutToBeRemoved(Customer* customer) {
-    QMutexLocker locker(&customerMutex);
     customersByCustomerId.remove(customer->customerId());
+    currentObjectIndex->removeCustomer(customer, this);
 
     customer->reportExistingHostSchemesAndMonitors(this, false);
 }
 
 
 void HttpServiceThread::updateServiceMetrics() {
-    QMutexLocker locker(&monitorMutex);
-
     float newHostSchemesPerSecond = 0;
     for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
                                                        end = hostSchemeTimers.constEnd()
@@ -301,5 +737,19 @@ void HttpServiceThread::updateServiceMetrics() {
         newHostSchemesPerSecond += it.value()->monitorsPerSecond();
     }
 
-    currentHostSchemesPerSecond = newHostSchemesPerSecond;
+    currentHostSchemesPerSecond.store(newHostSchemesPerSecond, std::memory_order_relaxed);
+}
+
+
+void HttpServiceThread::updateSheddingLevel() {
+    unsigned newSheddingLevel = 0;
+    for (  QMap<int, HostSchemeTimer*>::const_iterator it  = hostSchemeTimers.constBegin(),
+                                                       end = hostSchemeTimers.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        newSheddingLevel = std::max(newSheddingLevel, it.value()->sheddingLevel());
+    }
+
+    currentSheddingLevel.store(newSheddingLevel, std::memory_order_relaxed);
 }
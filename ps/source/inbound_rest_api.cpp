@@ -24,13 +24,18 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonValue>
+#include <QThread>
 
 #include <rest_api_in_v1_json_response.h>
 #include <rest_api_in_v1_inesonic_rest_handler.h>
 
 #include "service_thread_tracker.h"
 #include "resources.h"
+#include "string_pool.h"
 #include "loading_data.h"
+#include "metrics.h"
+#include "event_loop_lag_probe.h"
+#include "job_queue.h"
 #include "inbound_rest_api.h"
 
 /***********************************************************************************************************************
@@ -39,11 +44,14 @@
 
 InboundRestApi::StateActive::StateActive(
         const QByteArray&     secret,
-        ServiceThreadTracker* serviceThreadTracker
+        ServiceThreadTracker* serviceThreadTracker,
+        JobQueue*             jobQueue
     ):RestApiInV1::InesonicRestHandler(
         secret
     ),currentServiceThreadTracker(
         serviceThreadTracker
+    ),currentJobQueue(
+        jobQueue
     ) {}
 
 
@@ -55,7 +63,12 @@ RestApiInV1::JsonResponse InboundRestApi::StateActive::processAuthenticatedReque
         const QJsonDocument& /* request */,
         unsigned             /* threadId */
     ) {
-    currentServiceThreadTracker->goActive();
+    currentJobQueue->submit(
+        [this]() {
+            currentServiceThreadTracker->goActive();
+            return true;
+        }
+    );
 
     QJsonObject responseObject;
     responseObject.insert("status", "OK");
@@ -69,11 +82,14 @@ RestApiInV1::JsonResponse InboundRestApi::StateActive::processAuthenticatedReque
 
 InboundRestApi::StateInactive::StateInactive(
         const QByteArray&     secret,
-        ServiceThreadTracker* serviceThreadTracker
+        ServiceThreadTracker* serviceThreadTracker,
+        JobQueue*             jobQueue
     ):RestApiInV1::InesonicRestHandler(
         secret
     ),currentServiceThreadTracker(
         serviceThreadTracker
+    ),currentJobQueue(
+        jobQueue
     ) {}
 
 
@@ -85,7 +101,12 @@ RestApiInV1::JsonResponse InboundRestApi::StateInactive::processAuthenticatedReq
         const QJsonDocument& /* request */,
         unsigned             /* threadId */
     ) {
-    currentServiceThreadTracker->goInactive();
+    currentJobQueue->submit(
+        [this]() {
+            currentServiceThreadTracker->goInactive();
+            return true;
+        }
+    );
 
     QJsonObject responseObject;
     responseObject.insert("status", "OK");
@@ -99,11 +120,14 @@ RestApiInV1::JsonResponse InboundRestApi::StateInactive::processAuthenticatedReq
 
 InboundRestApi::RegionChange::RegionChange(
         const QByteArray&     secret,
-        ServiceThreadTracker* serviceThreadTracker
+        ServiceThreadTracker* serviceThreadTracker,
+        JobQueue*             jobQueue
     ):RestApiInV1::InesonicRestHandler(
         secret
     ),currentServiceThreadTracker(
         serviceThreadTracker
+    ),currentJobQueue(
+        jobQueue
     ) {}
 
 
@@ -126,9 +150,15 @@ RestApiInV1::JsonResponse InboundRestApi::RegionChange::processAuthenticatedRequ
             int numberRegions = requestObject.value("number_regions").toInt(-1);
 
             if (numberRegions > 0 && regionIndex >= 0 && regionIndex < numberRegions) {
-                currentServiceThreadTracker->updateRegionData(
-                    static_cast<unsigned>(regionIndex),
-                    static_cast<unsigned>(numberRegions)
+                currentJobQueue->submit(
+                    [this, regionIndex, numberRegions]() {
+                        currentServiceThreadTracker->updateRegionData(
+                            static_cast<unsigned>(regionIndex),
+                            static_cast<unsigned>(numberRegions)
+                        );
+
+                        return true;
+                    }
                 );
 
                 responseObject.insert("status", "OK");
@@ -174,6 +204,31 @@ RestApiInV1::JsonResponse InboundRestApi::LoadingGet::processAuthenticatedReques
     QJsonObject loadingObject;
     loadingObject.insert("cpu", cpuUtilization());
     loadingObject.insert("memory", memoryUtilization());
+    loadingObject.insert("network", networkUtilization());
+    loadingObject.insert("network_bytes_per_second", networkBytesPerSecond());
+    loadingObject.insert("process_cpu", processCpuUtilization());
+    loadingObject.insert("busiest_thread_cpu", busiestThreadCpuUtilization());
+
+    unsigned long      numberMonitors = currentServiceThreadTracker->numberMonitors();
+    unsigned long long residentBytes  = residentMemoryBytes();
+    loadingObject.insert("monitors", static_cast<double>(numberMonitors));
+    loadingObject.insert("resident_memory", static_cast<double>(residentBytes));
+    loadingObject.insert(
+        "memory_per_monitor",
+        numberMonitors > 0 ? static_cast<double>(residentBytes) / numberMonitors : QJsonValue()
+    );
+    loadingObject.insert("interned_strings", static_cast<double>(StringPool::numberEntries()));
+    loadingObject.insert("interned_bytes", static_cast<double>(StringPool::numberBytes()));
+
+    long long timeToReady          = currentServiceThreadTracker->timeToReady();
+    long long lastBulkLoadDuration = currentServiceThreadTracker->lastBulkLoadDuration();
+    if (timeToReady >= 0) {
+        loadingObject.insert("time_to_ready", timeToReady / 1000.0);
+        loadingObject.insert("last_bulk_load", lastBulkLoadDuration / 1000.0);
+    } else {
+        loadingObject.insert("time_to_ready", QJsonValue());
+        loadingObject.insert("last_bulk_load", QJsonValue());
+    }
 
     QMultiMap<int, LoadingData>        loadingData = currentServiceThreadTracker->loadingData();
     QMap<unsigned, QList<LoadingData>> singleRegionLoadingData;
@@ -196,6 +251,23 @@ RestApiInV1::JsonResponse InboundRestApi::LoadingGet::processAuthenticatedReques
     loadingObject.insert("single_region", generateResponse(singleRegionLoadingData));
     loadingObject.insert("multi_region", generateResponse(multiRegionLoadingData));
 
+    QJsonArray                        lagArray;
+    QList<EventLoopLagProbe::LagData> lagData = currentServiceThreadTracker->eventLoopLag();
+    for (  QList<EventLoopLagProbe::LagData>::const_iterator it = lagData.constBegin(), end = lagData.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        QJsonObject lagObject;
+        lagObject.insert("average", it->averageLag());
+        lagObject.insert("maximum", it->maximumLag());
+        lagObject.insert("high_lag_samples", static_cast<double>(it->numberHighLagSamples()));
+
+        lagArray.append(lagObject);
+    }
+
+    loadingObject.insert("event_loop_lag", lagArray);
+    loadingObject.insert("shedding_level", static_cast<int>(currentServiceThreadTracker->sheddingLevel()));
+
     responseObject.insert("data", loadingObject);
 
     return RestApiInV1::JsonResponse(responseObject);
@@ -224,6 +296,10 @@ QJsonObject InboundRestApi::LoadingGet::generateResponse(const QMap<unsigned, QL
             loadingDataObject.insert("polled_host_schemes", static_cast<double>(data.numberPolledHostSchemes()));
             loadingDataObject.insert("missed_timing_marks", static_cast<double>(data.numberMissedTimingMarks()));
             loadingDataObject.insert("average_timing_error", data.averageTimingError());
+            loadingDataObject.insert("rechecks", static_cast<double>(data.numberRechecks()));
+            loadingDataObject.insert("deferred_rechecks", static_cast<double>(data.numberDeferredRechecks()));
+            loadingDataObject.insert("shed_polls", static_cast<double>(data.numberShedPolls()));
+            loadingDataObject.insert("shedding_level", static_cast<int>(data.sheddingLevel()));
 
             array.append(loadingDataObject);
         }
@@ -234,17 +310,182 @@ QJsonObject InboundRestApi::LoadingGet::generateResponse(const QMap<unsigned, QL
     return result;
 }
 
+/***********************************************************************************************************************
+* InboundRestApi::MetricsGet
+*/
+
+InboundRestApi::MetricsGet::MetricsGet(
+        const QByteArray&     secret,
+        ServiceThreadTracker* serviceThreadTracker,
+        JobQueue*             jobQueue
+    ):RestApiInV1::InesonicRestHandler(
+        secret
+    ),currentServiceThreadTracker(
+        serviceThreadTracker
+    ),currentJobQueue(
+        jobQueue
+    ) {}
+
+
+InboundRestApi::MetricsGet::~MetricsGet() {}
+
+
+RestApiInV1::JsonResponse InboundRestApi::MetricsGet::processAuthenticatedRequest(
+        const QString&       /* path */,
+        const QJsonDocument& /* request */,
+        unsigned             /* threadId */
+    ) {
+    ThreadMetrics::Totals totals = currentServiceThreadTracker->threadMetrics();
+
+    QJsonObject countersObject;
+    countersObject.insert("requests_started", static_cast<double>(totals.requestsStarted));
+    countersObject.insert("requests_succeeded", static_cast<double>(totals.requestsSucceeded));
+    countersObject.insert("requests_failed", static_cast<double>(totals.requestsFailed));
+    countersObject.insert("latency_samples_excluded", static_cast<double>(totals.latencySamplesExcluded));
+    countersObject.insert("responses_not_modified", static_cast<double>(totals.responsesNotModified));
+    countersObject.insert("requests_coalesced", static_cast<double>(totals.requestsCoalesced));
+    countersObject.insert(
+        "latency_entries_dropped",
+        static_cast<double>(currentServiceThreadTracker->droppedLatencyEntries())
+    );
+
+    QJsonObject gaugesObject;
+    gaugesObject.insert("replies_in_flight", static_cast<double>(totals.repliesInFlight));
+    gaugesObject.insert("service_threads", static_cast<double>(currentServiceThreadTracker->numberServiceThreads()));
+    gaugesObject.insert("latency_backlog", static_cast<double>(currentServiceThreadTracker->latencyBacklog()));
+    gaugesObject.insert(
+        "latency_summaries",
+        static_cast<double>(currentServiceThreadTracker->latencySummaryBacklog())
+    );
+    gaugesObject.insert("latency_spilled", static_cast<double>(currentServiceThreadTracker->spilledLatencyEntries()));
+    gaugesObject.insert("queued_events", static_cast<double>(currentServiceThreadTracker->numberQueuedEvents()));
+    gaugesObject.insert(
+        "in_flight_event_batches",
+        static_cast<double>(currentServiceThreadTracker->numberInFlightEventBatches())
+    );
+    gaugesObject.insert(
+        "in_flight_latency_reports",
+        static_cast<double>(currentServiceThreadTracker->numberInFlightLatencyReports())
+    );
+    gaugesObject.insert(
+        "pending_pinger_commands",
+        static_cast<double>(currentServiceThreadTracker->numberPendingPingerCommands())
+    );
+    gaugesObject.insert(
+        "in_flight_pinger_commands",
+        static_cast<double>(currentServiceThreadTracker->numberInFlightPingerCommands())
+    );
+    gaugesObject.insert("pending_jobs", static_cast<double>(currentJobQueue->numberPendingJobs()));
+    double                            maximumLag = 0;
+    QList<EventLoopLagProbe::LagData> lagData    = currentServiceThreadTracker->eventLoopLag();
+    for (  QList<EventLoopLagProbe::LagData>::const_iterator it = lagData.constBegin(), end = lagData.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        if (it->maximumLag() > maximumLag) {
+            maximumLag = it->maximumLag();
+        }
+    }
+
+    gaugesObject.insert("event_loop_lag_maximum", maximumLag);
+
+    unsigned long numberMonitors = currentServiceThreadTracker->numberMonitors();
+    gaugesObject.insert("monitors", static_cast<double>(numberMonitors));
+    gaugesObject.insert("resident_memory", static_cast<double>(residentMemoryBytes()));
+    if (numberMonitors > 0) {
+        gaugesObject.insert("memory_per_monitor", static_cast<double>(residentMemoryBytes()) / numberMonitors);
+    }
+    gaugesObject.insert("cpu", cpuUtilization());
+    gaugesObject.insert("memory", memoryUtilization());
+    gaugesObject.insert("network", networkUtilization());
+
+    unsigned long long polledHostSchemes = 0;
+    unsigned long long missedTimingMarks = 0;
+    double             weightedError     = 0;
+    unsigned long long rechecks          = 0;
+    unsigned long long deferredRechecks  = 0;
+    unsigned long long shedPolls         = 0;
+
+    QMultiMap<int, LoadingData> loadingData = currentServiceThreadTracker->loadingData();
+    for (  QMultiMap<int, LoadingData>::const_iterator it = loadingData.constBegin(), end = loadingData.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        const LoadingData& data = it.value();
+
+        polledHostSchemes += data.numberPolledHostSchemes();
+        missedTimingMarks += data.numberMissedTimingMarks();
+        weightedError     += data.averageTimingError() * data.numberPolledHostSchemes();
+        rechecks          += data.numberRechecks();
+        deferredRechecks  += data.numberDeferredRechecks();
+        shedPolls         += data.numberShedPolls();
+    }
+
+    QJsonObject schedulerObject;
+    schedulerObject.insert("polled_host_schemes", static_cast<double>(polledHostSchemes));
+    schedulerObject.insert("missed_timing_marks", static_cast<double>(missedTimingMarks));
+    schedulerObject.insert("average_timing_error", polledHostSchemes > 0 ? weightedError / polledHostSchemes : 0.0);
+    schedulerObject.insert("rechecks", static_cast<double>(rechecks));
+    schedulerObject.insert("deferred_rechecks", static_cast<double>(deferredRechecks));
+    schedulerObject.insert("shed_polls", static_cast<double>(shedPolls));
+    schedulerObject.insert("shedding_level", static_cast<int>(currentServiceThreadTracker->sheddingLevel()));
+
+    QJsonObject metricsObject;
+    metricsObject.insert("counters", countersObject);
+    metricsObject.insert("gauges", gaugesObject);
+    metricsObject.insert("scheduler", schedulerObject);
+    metricsObject.insert("latency", generateHistogram(totals.latency));
+
+    QJsonObject responseObject;
+    responseObject.insert("status", "OK");
+    responseObject.insert("data", metricsObject);
+
+    return RestApiInV1::JsonResponse(responseObject);
+}
+
+
+QJsonObject InboundRestApi::MetricsGet::generateHistogram(const LatencyHistogram::Counts& counts) {
+    QJsonArray bucketsArray;
+
+    unsigned numberBuckets = static_cast<unsigned>(counts.size());
+    for (unsigned i=0 ; i<numberBuckets ; ++i) {
+        std::uint64_t count = counts.at(i);
+        if (count != 0) {
+            QJsonArray bucketArray;
+            bucketArray.append(static_cast<double>(LatencyHistogram::lowerBound(i)));
+            bucketArray.append(static_cast<double>(LatencyHistogram::upperBound(i)));
+            bucketArray.append(static_cast<double>(count));
+
+            bucketsArray.append(bucketArray);
+        }
+    }
+
+    QJsonObject result;
+    result.insert("count", static_cast<double>(LatencyHistogram::totalCount(counts)));
+    result.insert("p50", static_cast<double>(LatencyHistogram::percentile(counts, 0.50)));
+    result.insert("p90", static_cast<double>(LatencyHistogram::percentile(counts, 0.90)));
+    result.insert("p99", static_cast<double>(LatencyHistogram::percentile(counts, 0.99)));
+    result.insert("p999", static_cast<double>(LatencyHistogram::percentile(counts, 0.999)));
+    result.insert("max", static_cast<double>(LatencyHistogram::percentile(counts, 1.0)));
+    result.insert("buckets", bucketsArray);
+
+    return result;
+}
+
 /***********************************************************************************************************************
 * InboundRestApi::CustomerAdd
 */
 
 InboundRestApi::CustomerAdd::CustomerAdd(
         const QByteArray&     secret,
-        ServiceThreadTracker* serviceThreadTracker
+        ServiceThreadTracker* serviceThreadTracker,
+        JobQueue*             jobQueue
     ):RestApiInV1::InesonicRestHandler(
         secret
     ),currentServiceThreadTracker(
         serviceThreadTracker
+    ),currentJobQueue(
+        jobQueue
     ) {}
 
 
@@ -296,24 +537,44 @@ RestApiInV1::JsonResponse InboundRestApi::CustomerAdd::processAuthenticatedReque
             ++customerIterator;
         }
 
+        QJsonObject responseObject;
         if (success) {
+            // The customers are created in this handler's thread and must be pushed to the thread that applies the
+            // job, see QObject::moveToThread.
+
+            QThread* jobThread = currentJobQueue->thread();
             for (  QList<Customer*>::const_iterator customerIterator = customers.constBegin(),
                                                     customerEndIterator = customers.constEnd()
                  ; customerIterator != customerEndIterator
                  ; ++customerIterator
                 ) {
-                Customer* customer = *customerIterator;
-
-                currentServiceThreadTracker->removeCustomer(customer->customerId());
-                currentServiceThreadTracker->addCustomer(customer);
+                (*customerIterator)->moveToThread(jobThread);
             }
+
+            JobQueue::JobId jobId = currentJobQueue->submit(
+                [this, customers]() {
+                    bool success = true;
+                    for (  QList<Customer*>::const_iterator customerIterator = customers.constBegin(),
+                                                            customerEndIterator = customers.constEnd()
+                         ; customerIterator != customerEndIterator
+                         ; ++customerIterator
+                        ) {
+                        if (!currentServiceThreadTracker->updateCustomer(*customerIterator)) {
+                            success = false;
+                        }
+                    }
+
+                    return success;
+                }
+            );
+
+            responseObject.insert("job_id", static_cast<double>(jobId));
         } else {
             for (QList<Customer*>::const_iterator it=customers.constBegin(),end=customers.constEnd() ; it!=end ; ++it) {
                 delete *it;
             }
         }
 
-        QJsonObject responseObject;
         responseObject.insert("status", statusString);
         response = RestApiInV1::JsonResponse(responseObject);
     }
@@ -335,12 +596,30 @@ Customer* InboundRestApi::CustomerAdd::generateCustomer(
         if (hostSchemesValue.isObject()) {
             int pollingIntervalInt = jsonObject.value("polling_interval").toInt(-1);
 
-            if (pollingIntervalInt >= 20) {
+            int confirmationDelayInt = jsonObject.value("confirmation_delay").toInt(
+                Customer::defaultConfirmationDelay
+            );
+            int maximumRecheckIntervalInt = jsonObject.value("maximum_recheck_interval").toInt(
+                Customer::defaultMaximumRecheckInterval
+            );
+
+            bool               priorityValid = true;
+            Customer::Priority priority      = Customer::Priority::NORMAL;
+            if (jsonObject.contains("priority")) {
+                priority = Customer::toPriority(jsonObject.value("priority").toString(), &priorityValid);
+            }
+
+            if (pollingIntervalInt >= 20         &&
+                confirmationDelayInt >= 0        &&
+                maximumRecheckIntervalInt >= 0   &&
+                priorityValid                       ) {
                 unsigned pollingInterval              = static_cast<unsigned>(pollingIntervalInt);
                 bool     supportsPingTesting          = jsonObject.value("ping").toBool(false);
                 bool     supportsSslExpirationTesting = jsonObject.value("ssl_expiration").toBool(false);
                 bool     supportsLatencyMeasurements  = jsonObject.value("latency").toBool(false);
                 bool     supportsMultiRegionTesting   = jsonObject.value("multi_region").toBool(false);
+                bool     supportsLatencyPhases        = jsonObject.value("latency_phases").toBool(false);
+                bool     supportsLatencyAggregation   = jsonObject.value("latency_aggregation").toBool(false);
 
                 result = new Customer(
                     customerId,
@@ -348,9 +627,15 @@ Customer* InboundRestApi::CustomerAdd::generateCustomer(
                     supportsSslExpirationTesting,
                     supportsLatencyMeasurements,
                     supportsMultiRegionTesting,
+                    supportsLatencyPhases,
+                    supportsLatencyAggregation,
                     pollingInterval
                 );
 
+                result->setConfirmationDelay(static_cast<unsigned>(confirmationDelayInt));
+                result->setMaximumRecheckInterval(static_cast<unsigned>(maximumRecheckIntervalInt));
+                result->setPriority(priority);
+
                 QJsonObject                 hostSchemesObject      = hostSchemesValue.toObject();
                 QJsonObject::const_iterator hostSchemesIterator    = hostSchemesObject.constBegin();
                 QJsonObject::const_iterator hostSchemesEndIterator = hostSchemesObject.constEnd();
@@ -384,7 +669,7 @@ Customer* InboundRestApi::CustomerAdd::generateCustomer(
                 }
             } else {
                 success      = false;
-                statusString = QString("failed, invalid polling interval, customer %1")
+                statusString = QString("failed, invalid polling interval, recheck or priority settings, customer %1")
                                .arg(customerId);
             }
         } else {
@@ -480,6 +765,7 @@ Monitor* InboundRestApi::CustomerAdd::generateMonitor(
     Monitor::KeywordList      keywords;
     QString                   userAgent;
     QByteArray                postContent;
+    unsigned long             maximumBodySize  = Monitor::defaultMaximumBodySize;
 
     if (jsonData.contains("uri")) {
         QJsonValue uriValue = jsonData.value("uri");
@@ -620,6 +906,18 @@ Monitor* InboundRestApi::CustomerAdd::generateMonitor(
         ++numberFields;
     }
 
+    if (jsonData.contains("maximum_body_size")) {
+        double maximumBodySizeValue = jsonData.value("maximum_body_size").toDouble(-1);
+        if (maximumBodySizeValue >= 1 && maximumBodySizeValue <= 0xFFFFFFFF) {
+            maximumBodySize = static_cast<unsigned long>(maximumBodySizeValue);
+        } else {
+            success      = false;
+            statusString = QString("failed, invalid maximum_body_size, monitor ID %1").arg(monitorId);
+        }
+
+        ++numberFields;
+    }
+
     if (numberFields != static_cast<unsigned>(jsonData.size())) {
         success      = false;
         statusString = QString("failed, unexpected entries, monitor ID %1").arg(monitorId);
@@ -634,8 +932,367 @@ Monitor* InboundRestApi::CustomerAdd::generateMonitor(
             keywords,
             contentType,
             userAgent,
-            postContent
+            postContent,
+            maximumBodySize
+        );
+    }
+
+    return result;
+}
+
+/***********************************************************************************************************************
+* InboundRestApi::CustomerBulkAdd
+*/
+
+InboundRestApi::CustomerBulkAdd::CustomerBulkAdd(
+        const QByteArray&     secret,
+        ServiceThreadTracker* serviceThreadTracker,
+        JobQueue*             jobQueue
+    ):RestApiInV1::InesonicRestHandler(
+        secret
+    ),currentServiceThreadTracker(
+        serviceThreadTracker
+    ),currentJobQueue(
+        jobQueue
+    ) {}
+
+
+InboundRestApi::CustomerBulkAdd::~CustomerBulkAdd() {}
+
+
+RestApiInV1::JsonResponse InboundRestApi::CustomerBulkAdd::processAuthenticatedRequest(
+        const QString&       /* path */,
+        const QJsonDocument& request,
+        unsigned             /* threadId */
+    ) {
+    RestApiInV1::JsonResponse response(StatusCode::BAD_REQUEST);
+
+    if (request.isObject()) {
+        QString     statusString("OK");
+        bool        success        = true;
+        QJsonObject requestObject  = request.object();
+        QJsonValue  customersValue = requestObject.value("customers");
+
+        QList<Customer*> customers;
+        if (requestObject.size() == 1 && customersValue.isArray()) {
+            QJsonArray                 customersArray       = customersValue.toArray();
+            QJsonArray::const_iterator customersIterator    = customersArray.constBegin();
+            QJsonArray::const_iterator customersEndIterator = customersArray.constEnd();
+
+            customers.reserve(customersArray.size());
+            while (success && customersIterator != customersEndIterator) {
+                if (customersIterator->isArray()) {
+                    Customer* customer = generateCustomer(success, statusString, customersIterator->toArray());
+                    if (customer != nullptr) {
+                        customers.append(customer);
+                    }
+                } else {
+                    success      = false;
+                    statusString = QString("failed, expected array for customer entry");
+                }
+
+                ++customersIterator;
+            }
+        } else {
+            success      = false;
+            statusString = QString("failed, expected customers array");
+        }
+
+        QJsonObject responseObject;
+        if (success) {
+            // See CustomerAdd for why the customers are moved before the job is queued.
+
+            QThread* jobThread = currentJobQueue->thread();
+            for (QList<Customer*>::const_iterator it=customers.constBegin(),end=customers.constEnd() ; it!=end ; ++it) {
+                (*it)->moveToThread(jobThread);
+            }
+
+            JobQueue::JobId jobId = currentJobQueue->submit(
+                [this, customers]() {
+                    return currentServiceThreadTracker->addCustomers(customers);
+                }
+            );
+
+            responseObject.insert("job_id", static_cast<double>(jobId));
+        } else {
+            for (QList<Customer*>::const_iterator it=customers.constBegin(),end=customers.constEnd() ; it!=end ; ++it) {
+                delete *it;
+            }
+        }
+
+        responseObject.insert("status", statusString);
+        response = RestApiInV1::JsonResponse(responseObject);
+    }
+
+    return response;
+}
+
+
+Customer* InboundRestApi::CustomerBulkAdd::generateCustomer(
+        bool&             success,
+        QString&          statusString,
+        const QJsonArray& jsonArray
+    ) {
+    Customer* result = nullptr;
+
+    if (jsonArray.size() == 4 || jsonArray.size() == 6 || jsonArray.size() == 7) {
+        double             customerIdValue           = jsonArray.at(0).toDouble(-1);
+        double             flagsValue                = jsonArray.at(1).toDouble(-1);
+        int                pollingIntervalInt        = jsonArray.at(2).toInt(-1);
+        QJsonValue         hostSchemesValue          = jsonArray.at(3);
+        int                confirmationDelayInt      = Customer::defaultConfirmationDelay;
+        int                maximumRecheckIntervalInt = Customer::defaultMaximumRecheckInterval;
+        bool               priorityValid             = true;
+        Customer::Priority priority                  = Customer::Priority::NORMAL;
+
+        if (jsonArray.size() >= 6) {
+            confirmationDelayInt      = jsonArray.at(4).toInt(-1);
+            maximumRecheckIntervalInt = jsonArray.at(5).toInt(-1);
+        }
+
+        if (jsonArray.size() == 7) {
+            priority = Customer::toPriority(jsonArray.at(6).toString(), &priorityValid);
+        }
+
+        if (customerIdValue >= 1 && customerIdValue <= 0xFFFFFFFF) {
+            Customer::CustomerId customerId = static_cast<Customer::CustomerId>(customerIdValue);
+
+            if (flagsValue >= 0                  &&
+                flagsValue <= 0xFF               &&
+                pollingIntervalInt >= 20         &&
+                hostSchemesValue.isArray()       &&
+                confirmationDelayInt >= 0        &&
+                maximumRecheckIntervalInt >= 0   &&
+                priorityValid                       ) {
+                unsigned flags = static_cast<unsigned>(flagsValue);
+
+                result = new Customer(
+                    customerId,
+                    (flags & pingFlag) != 0,
+                    (flags & sslExpirationFlag) != 0,
+                    (flags & latencyFlag) != 0,
+                    (flags & multiRegionFlag) != 0,
+                    (flags & latencyPhasesFlag) != 0,
+                    (flags & latencyAggregationFlag) != 0,
+                    static_cast<unsigned>(pollingIntervalInt)
+                );
+
+                result->setConfirmationDelay(static_cast<unsigned>(confirmationDelayInt));
+                result->setMaximumRecheckInterval(static_cast<unsigned>(maximumRecheckIntervalInt));
+                result->setPriority(priority);
+
+                QJsonArray                 hostSchemesArray       = hostSchemesValue.toArray();
+                QJsonArray::const_iterator hostSchemesIterator    = hostSchemesArray.constBegin();
+                QJsonArray::const_iterator hostSchemesEndIterator = hostSchemesArray.constEnd();
+                while (success && hostSchemesIterator != hostSchemesEndIterator) {
+                    if (hostSchemesIterator->isArray()) {
+                        HostScheme* hostScheme = generateHostScheme(
+                            success,
+                            statusString,
+                            hostSchemesIterator->toArray()
+                        );
+
+                        if (hostScheme != nullptr) {
+                            result->addHostScheme(hostScheme);
+                        }
+                    } else {
+                        success      = false;
+                        statusString = QString("failed, expected array for host/scheme entry, customer %1")
+                                       .arg(customerId);
+                    }
+
+                    ++hostSchemesIterator;
+                }
+            } else {
+                success      = false;
+                statusString = QString("failed, invalid customer entry, customer %1").arg(customerId);
+            }
+        } else {
+            success      = false;
+            statusString = QString("failed, invalid customer ID");
+        }
+    } else {
+        success      = false;
+        statusString = QString("failed, customer entries must hold 4, 6 or 7 values");
+    }
+
+    return result;
+}
+
+
+HostScheme* InboundRestApi::CustomerBulkAdd::generateHostScheme(
+        bool&             success,
+        QString&          statusString,
+        const QJsonArray& jsonArray
+    ) {
+    HostScheme* result = nullptr;
+
+    if (jsonArray.size() == 3) {
+        double     hostSchemeIdValue = jsonArray.at(0).toDouble(-1);
+        QUrl       url(jsonArray.at(1).toString());
+        QJsonValue monitorsValue     = jsonArray.at(2);
+
+        if (hostSchemeIdValue >= 1 && hostSchemeIdValue <= 0xFFFFFFFF) {
+            HostScheme::HostSchemeId hostSchemeId = static_cast<HostScheme::HostSchemeId>(hostSchemeIdValue);
+
+            if (url.isValid() && monitorsValue.isArray()) {
+                result = new HostScheme(hostSchemeId, url);
+
+                QJsonArray                 monitorsArray       = monitorsValue.toArray();
+                QJsonArray::const_iterator monitorsIterator    = monitorsArray.constBegin();
+                QJsonArray::const_iterator monitorsEndIterator = monitorsArray.constEnd();
+                while (success && monitorsIterator != monitorsEndIterator) {
+                    if (monitorsIterator->isArray()) {
+                        Monitor* monitor = generateMonitor(success, statusString, monitorsIterator->toArray());
+                        if (monitor != nullptr) {
+                            result->addMonitor(monitor);
+                        }
+                    } else {
+                        success      = false;
+                        statusString = QString("failed, expected array for monitor entry, host/scheme %1")
+                                       .arg(hostSchemeId);
+                    }
+
+                    ++monitorsIterator;
+                }
+            } else {
+                success      = false;
+                statusString = QString("failed, invalid host/scheme entry, host/scheme %1").arg(hostSchemeId);
+            }
+        } else {
+            success      = false;
+            statusString = QString("failed, invalid host/scheme ID");
+        }
+    } else {
+        success      = false;
+        statusString = QString("failed, host/scheme entries must hold 3 values");
+    }
+
+    return result;
+}
+
+
+Monitor* InboundRestApi::CustomerBulkAdd::generateMonitor(
+        bool&             success,
+        QString&          statusString,
+        const QJsonArray& jsonArray
+    ) {
+    Monitor* result = nullptr;
+
+    unsigned                  numberFields     = static_cast<unsigned>(jsonArray.size());
+    Monitor::MonitorId        monitorId        = 0;
+    Monitor::Method           method           = Monitor::Method::GET;
+    Monitor::ContentCheckMode contentCheckMode = Monitor::ContentCheckMode::NO_CHECK;
+    Monitor::ContentType      contentType      = Monitor::ContentType::TEXT;
+    QString                   uriString;
+    Monitor::KeywordList      keywords;
+    QString                   userAgent;
+    QByteArray                postContent;
+    unsigned long             maximumBodySize  = Monitor::defaultMaximumBodySize;
+
+    if (numberFields >= 2 && numberFields <= 9) {
+        double monitorIdValue = jsonArray.at(0).toDouble(-1);
+        if (monitorIdValue >= 1 && monitorIdValue <= 0xFFFFFFFF && jsonArray.at(1).isString()) {
+            monitorId = static_cast<Monitor::MonitorId>(monitorIdValue);
+            uriString = jsonArray.at(1).toString();
+        } else {
+            success      = false;
+            statusString = QString("failed, invalid monitor ID or URI");
+        }
+
+        if (success && numberFields > 2) {
+            method = Monitor::toMethod(jsonArray.at(2).toString(), &success);
+        }
+
+        if (success && numberFields > 3) {
+            contentCheckMode = Monitor::toContentCheckMode(jsonArray.at(3).toString(), &success);
+        }
+
+        if (success && numberFields > 4) {
+            contentType = Monitor::toContentType(jsonArray.at(4).toString(), &success);
+        }
+
+        if (success && numberFields > 5) {
+            QJsonValue keywordsValue = jsonArray.at(5);
+            if (keywordsValue.isArray()) {
+                QJsonArray                 keywordsArray       = keywordsValue.toArray();
+                QJsonArray::const_iterator keywordsIterator    = keywordsArray.constBegin();
+                QJsonArray::const_iterator keywordsEndIterator = keywordsArray.constEnd();
+
+                keywords.reserve(keywordsArray.size());
+                while (success && keywordsIterator != keywordsEndIterator) {
+                    keywords.append(decodeBase64(success, *keywordsIterator));
+                    ++keywordsIterator;
+                }
+            } else {
+                success = false;
+            }
+        }
+
+        if (success && numberFields > 6) {
+            QJsonValue userAgentValue = jsonArray.at(6);
+            if (userAgentValue.isString()) {
+                userAgent = userAgentValue.toString();
+            } else {
+                success = false;
+            }
+        }
+
+        if (success && numberFields > 7) {
+            postContent = decodeBase64(success, jsonArray.at(7));
+        }
+
+        if (success && numberFields > 8) {
+            double maximumBodySizeValue = jsonArray.at(8).toDouble(-1);
+            if (maximumBodySizeValue >= 1 && maximumBodySizeValue <= 0xFFFFFFFF) {
+                maximumBodySize = static_cast<unsigned long>(maximumBodySizeValue);
+            } else {
+                success = false;
+            }
+        }
+
+        if (!success && monitorId != 0) {
+            statusString = QString("failed, invalid monitor entry, monitor ID %1").arg(monitorId);
+        }
+    } else {
+        success      = false;
+        statusString = QString("failed, monitor entries must hold 2 to 9 values");
+    }
+
+    if (success) {
+        result = new Monitor(
+            monitorId,
+            uriString,
+            method,
+            contentCheckMode,
+            keywords,
+            contentType,
+            userAgent,
+            postContent,
+            maximumBodySize
+        );
+    }
+
+    return result;
+}
+
+
+QByteArray InboundRestApi::CustomerBulkAdd::decodeBase64(bool& success, const QJsonValue& value) {
+    QByteArray result;
+
+    if (value.isString()) {
+        QByteArray::FromBase64Result base64Result = QByteArray::fromBase64Encoding(
+            value.toString().toUtf8(),
+            QByteArray::Base64Option::AbortOnBase64DecodingErrors
         );
+
+        if (base64Result) {
+            result = *base64Result;
+        } else {
+            success = false;
+        }
+    } else {
+        success = false;
     }
 
     return result;
@@ -647,11 +1304,14 @@ Monitor* InboundRestApi::CustomerAdd::generateMonitor(
 
 InboundRestApi::CustomerRemove::CustomerRemove(
         const QByteArray&     secret,
-        ServiceThreadTracker* serviceThreadTracker
+        ServiceThreadTracker* serviceThreadTracker,
+        JobQueue*             jobQueue
     ):RestApiInV1::InesonicRestHandler(
         secret
     ),currentServiceThreadTracker(
         serviceThreadTracker
+    ),currentJobQueue(
+        jobQueue
     ) {}
 
 
@@ -672,8 +1332,12 @@ RestApiInV1::JsonResponse InboundRestApi::CustomerRemove::processAuthenticatedRe
 
             double customerId = requestObject.value("customer_id").toDouble(-1);
             if (customerId >= 1 && customerId <= 0xFFFFFFFF) {
-                bool success = currentServiceThreadTracker->removeCustomer(
-                    static_cast<Customer::CustomerId>(customerId)
+                bool success = currentJobQueue->execute(
+                    [this, customerId]() {
+                        return currentServiceThreadTracker->removeCustomer(
+                            static_cast<Customer::CustomerId>(customerId)
+                        );
+                    }
                 );
 
                 if (success) {
@@ -698,11 +1362,14 @@ RestApiInV1::JsonResponse InboundRestApi::CustomerRemove::processAuthenticatedRe
 
 InboundRestApi::CustomerPause::CustomerPause(
         const QByteArray&     secret,
-        ServiceThreadTracker* serviceThreadTracker
+        ServiceThreadTracker* serviceThreadTracker,
+        JobQueue*             jobQueue
     ):RestApiInV1::InesonicRestHandler(
         secret
     ),currentServiceThreadTracker(
         serviceThreadTracker
+    ),currentJobQueue(
+        jobQueue
     ) {}
 
 
@@ -724,9 +1391,15 @@ RestApiInV1::JsonResponse InboundRestApi::CustomerPause::processAuthenticatedReq
             bool   nowPaused  = requestObject.value("pause").toBool();
             double customerId = requestObject.value("customer_id").toDouble(-1);
             if (customerId >= 1 && customerId <= 0xFFFFFFFF) {
-                currentServiceThreadTracker->setPaused(
-                    static_cast<Customer::CustomerId>(customerId),
-                    nowPaused
+                currentJobQueue->execute(
+                    [this, customerId, nowPaused]() {
+                        currentServiceThreadTracker->setPaused(
+                            static_cast<Customer::CustomerId>(customerId),
+                            nowPaused
+                        );
+
+                        return true;
+                    }
                 );
 
                 responseObject.insert("status", "OK");
@@ -741,6 +1414,64 @@ RestApiInV1::JsonResponse InboundRestApi::CustomerPause::processAuthenticatedReq
     return response;
 }
 
+/***********************************************************************************************************************
+* InboundRestApi::JobStatusGet
+*/
+
+InboundRestApi::JobStatusGet::JobStatusGet(
+        const QByteArray& secret,
+        JobQueue*         jobQueue
+    ):RestApiInV1::InesonicRestHandler(
+        secret
+    ),currentJobQueue(
+        jobQueue
+    ) {}
+
+
+InboundRestApi::JobStatusGet::~JobStatusGet() {}
+
+
+RestApiInV1::JsonResponse InboundRestApi::JobStatusGet::processAuthenticatedRequest(
+        const QString&       /* path */,
+        const QJsonDocument& request,
+        unsigned             /* threadId */
+    ) {
+    RestApiInV1::JsonResponse response(StatusCode::BAD_REQUEST);
+
+    if (request.isObject()) {
+        QJsonObject requestObject = request.object();
+        if (requestObject.contains("job_id") && requestObject.size() == 1) {
+            QJsonObject responseObject;
+
+            double jobId = requestObject.value("job_id").toDouble(-1);
+            if (jobId >= 1 && jobId <= 0xFFFFFFFF) {
+                bool                succeeded = false;
+                JobQueue::JobStatus jobStatus = currentJobQueue->status(
+                    static_cast<JobQueue::JobId>(jobId),
+                    &succeeded
+                );
+
+                if (jobStatus != JobQueue::JobStatus::UNKNOWN) {
+                    responseObject.insert("status", "OK");
+                    responseObject.insert("job_status", JobQueue::toString(jobStatus));
+
+                    if (jobStatus == JobQueue::JobStatus::COMPLETED) {
+                        responseObject.insert("job_result", succeeded ? "succeeded" : "failed");
+                    }
+                } else {
+                    responseObject.insert("status", "failed, unknown job ID");
+                }
+            } else {
+                responseObject.insert("status", "failed, invalid job ID");
+            }
+
+            response = RestApiInV1::JsonResponse(responseObject);
+        }
+    }
+
+    return response;
+}
+
 /***********************************************************************************************************************
 * InboundRestApi
 */
@@ -749,9 +1480,12 @@ const QString InboundRestApi::stateActivePath("/state/active");
 const QString InboundRestApi::stateInactivePath("/state/inactive");
 const QString InboundRestApi::regionChangePath("/region/change");
 const QString InboundRestApi::loadingGetPath("/loading/get");
+const QString InboundRestApi::metricsGetPath("/metrics");
 const QString InboundRestApi::customerAddPath("/customer/add");
+const QString InboundRestApi::customerBulkAddPath("/customer/bulk_add");
 const QString InboundRestApi::customerRemovePath("/customer/remove");
 const QString InboundRestApi::customerPausePath("/customer/pause");
+const QString InboundRestApi::jobStatusPath("/job/status");
 
 InboundRestApi::InboundRestApi(
         RestApiInV1::Server*  restApiServer,
@@ -762,33 +1496,53 @@ InboundRestApi::InboundRestApi(
         parent
     ),stateActive(
         secret,
-        serviceThreadTracker
+        serviceThreadTracker,
+        &jobQueue
     ),stateInactive(
         secret,
-        serviceThreadTracker
+        serviceThreadTracker,
+        &jobQueue
     ),regionChange(
         secret,
-        serviceThreadTracker
+        serviceThreadTracker,
+        &jobQueue
     ),loadingGet(
         secret,
         serviceThreadTracker
+    ),metricsGet(
+        secret,
+        serviceThreadTracker,
+        &jobQueue
     ),customerAdd(
         secret,
-        serviceThreadTracker
+        serviceThreadTracker,
+        &jobQueue
+    ),customerBulkAdd(
+        secret,
+        serviceThreadTracker,
+        &jobQueue
     ),customerRemove(
         secret,
-        serviceThreadTracker
+        serviceThreadTracker,
+        &jobQueue
     ),customerPause(
         secret,
-        serviceThreadTracker
+        serviceThreadTracker,
+        &jobQueue
+    ),jobStatusGet(
+        secret,
+        &jobQueue
     ) {
     restApiServer->registerHandler(&stateActive, RestApiInV1::Handler::Method::POST, stateActivePath);
     restApiServer->registerHandler(&stateInactive, RestApiInV1::Handler::Method::POST, stateInactivePath);
     restApiServer->registerHandler(&regionChange, RestApiInV1::Handler::Method::POST, regionChangePath);
     restApiServer->registerHandler(&loadingGet, RestApiInV1::Handler::Method::POST, loadingGetPath);
+    restApiServer->registerHandler(&metricsGet, RestApiInV1::Handler::Method::POST, metricsGetPath);
     restApiServer->registerHandler(&customerAdd, RestApiInV1::Handler::Method::POST, customerAddPath);
+    restApiServer->registerHandler(&customerBulkAdd, RestApiInV1::Handler::Method::POST, customerBulkAddPath);
     restApiServer->registerHandler(&customerRemove, RestApiInV1::Handler::Method::POST, customerRemovePath);
     restApiServer->registerHandler(&customerPause, RestApiInV1::Handler::Method::POST, customerPausePath);
+    restApiServer->registerHandler(&jobStatusGet, RestApiInV1::Handler::Method::POST, jobStatusPath);
 }
 
 
@@ -800,7 +1554,10 @@ void InboundRestApi::setSecret(const QByteArray& newSecret) {
     stateInactive.setSecret(newSecret);
     regionChange.setSecret(newSecret);
     loadingGet.setSecret(newSecret);
+    metricsGet.setSecret(newSecret);
     customerAdd.setSecret(newSecret);
+    customerBulkAdd.setSecret(newSecret);
     customerRemove.setSecret(newSecret);
     customerPause.setSecret(newSecret);
+    jobStatusGet.setSecret(newSecret);
 }
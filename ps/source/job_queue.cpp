@@ -0,0 +1,139 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref JobQueue class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <cstdint>
+#include <functional>
+
+#include "job_queue.h"
+
+JobQueue::JobQueue(QObject* parent):QObject(parent) {
+    lastJobId                = 0;
+    currentNumberPendingJobs = 0;
+}
+
+
+JobQueue::~JobQueue() {}
+
+
+JobQueue::JobId JobQueue::submit(const Job& job) {
+    jobMutex.lock();
+
+    ++lastJobId;
+    if (lastJobId == 0) {
+        lastJobId = 1;
+    }
+
+    JobId jobId = lastJobId;
+    jobRecords.insert(jobId, JobRecord(JobStatus::QUEUED));
+    ++currentNumberPendingJobs;
+
+    jobMutex.unlock();
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, jobId, job]() {
+            runJob(jobId, job);
+        },
+        Qt::QueuedConnection
+    );
+
+    return jobId;
+}
+
+
+bool JobQueue::execute(const Job& job) {
+    bool result;
+
+    if (QThread::currentThread() == thread()) {
+        result = job();
+    } else {
+        // Events posted to one receiver are delivered in order so this job runs after every earlier submission.
+
+        QMetaObject::invokeMethod(
+            this,
+            [&job, &result]() {
+                result = job();
+            },
+            Qt::BlockingQueuedConnection
+        );
+    }
+
+    return result;
+}
+
+
+JobQueue::JobStatus JobQueue::status(JobId jobId, bool* succeeded) const {
+    QMutexLocker locker(&jobMutex);
+
+    JobRecord record = jobRecords.value(jobId);
+    if (succeeded != nullptr && record.status == JobStatus::COMPLETED) {
+        *succeeded = record.succeeded;
+    }
+
+    return record.status;
+}
+
+
+unsigned long JobQueue::numberPendingJobs() const {
+    QMutexLocker locker(&jobMutex);
+    return currentNumberPendingJobs;
+}
+
+
+QString JobQueue::toString(JobStatus jobStatus) {
+    QString result;
+
+    switch (jobStatus) {
+        case JobStatus::UNKNOWN:   { result = QString("unknown");     break; }
+        case JobStatus::QUEUED:    { result = QString("queued");      break; }
+        case JobStatus::RUNNING:   { result = QString("running");     break; }
+        case JobStatus::COMPLETED: { result = QString("completed");   break; }
+        default:                   { Q_ASSERT(false);                 break; }
+    }
+
+    return result;
+}
+
+
+void JobQueue::runJob(JobId jobId, const Job& job) {
+    jobMutex.lock();
+    jobRecords.insert(jobId, JobRecord(JobStatus::RUNNING));
+    jobMutex.unlock();
+
+    bool succeeded = job();
+
+    QMutexLocker locker(&jobMutex);
+
+    jobRecords.insert(jobId, JobRecord(JobStatus::COMPLETED, succeeded));
+    --currentNumberPendingJobs;
+
+    completedJobIds.append(jobId);
+    while (static_cast<unsigned>(completedJobIds.size()) > maximumRetainedJobs) {
+        jobRecords.remove(completedJobIds.takeFirst());
+    }
+}
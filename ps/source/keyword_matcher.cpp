@@ -0,0 +1,206 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref KeywordMatcher class.
+***********************************************************************************************************************/
+
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QVector>
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "keyword_matcher.h"
+
+constexpr KeywordMatcher::State KeywordMatcher::startState;
+constexpr KeywordMatcher::State KeywordMatcher::noState;
+
+KeywordMatcher::KeywordMatcher(const KeywordMatcher::KeywordList& keywords) {
+    currentNumberKeywords = static_cast<unsigned>(keywords.size());
+
+    // Assign a class to every byte value that appears in a keyword.  Class 0 is shared by all other byte values.
+
+    std::memset(byteClasses, 0, sizeof(byteClasses));
+    currentNumberClasses = 1;
+
+    for (KeywordList::const_iterator it=keywords.constBegin(),end=keywords.constEnd() ; it!=end ; ++it) {
+        const std::uint8_t* keywordData   = reinterpret_cast<const std::uint8_t*>(it->constData());
+        unsigned long       keywordLength = static_cast<unsigned long>(it->size());
+        for (unsigned long i=0 ; i<keywordLength ; ++i) {
+            std::uint8_t byte = keywordData[i];
+            if (byteClasses[byte] == 0) {
+                byteClasses[byte] = static_cast<std::uint16_t>(currentNumberClasses);
+                ++currentNumberClasses;
+            }
+        }
+    }
+
+    // Build the trie.  Missing edges are marked with noState until the failure links are resolved.
+
+    QVector<QVector<std::uint32_t>> stateOutputs(1);
+    transitions.fill(noState, static_cast<int>(currentNumberClasses));
+
+    for (unsigned keywordIndex=0 ; keywordIndex<currentNumberKeywords ; ++keywordIndex) {
+        const QByteArray&   keyword       = keywords.at(keywordIndex);
+        const std::uint8_t* keywordData   = reinterpret_cast<const std::uint8_t*>(keyword.constData());
+        unsigned long       keywordLength = static_cast<unsigned long>(keyword.size());
+
+        State state = startState;
+        for (unsigned long i=0 ; i<keywordLength ; ++i) {
+            unsigned index = state * currentNumberClasses + byteClasses[keywordData[i]];
+            State    next  = transitions.at(index);
+            if (next == noState) {
+                next = static_cast<State>(stateOutputs.size());
+                transitions[index] = next;
+
+                stateOutputs.append(QVector<std::uint32_t>());
+                transitions.resize(transitions.size() + static_cast<int>(currentNumberClasses));
+                std::fill(transitions.end() - currentNumberClasses, transitions.end(), noState);
+            }
+
+            state = next;
+        }
+
+        // Empty keywords end at the start state.  They are reported through markEmptyKeywords rather than through
+        // the outputs so the scan loop never needs to check the start state.
+
+        if (keywordLength > 0) {
+            stateOutputs[state].append(keywordIndex);
+        }
+    }
+
+    // Resolve failure links breadth first, converting the trie into a DFA.  Because states are visited in order of
+    // depth, the failure state of every state is fully resolved before it is used.
+
+    unsigned       numberStates = static_cast<unsigned>(stateOutputs.size());
+    QVector<State> failure(static_cast<int>(numberStates), startState);
+    QVector<State> queue;
+    queue.reserve(static_cast<int>(numberStates));
+
+    for (unsigned byteClass=0 ; byteClass<currentNumberClasses ; ++byteClass) {
+        State next = transitions.at(byteClass);
+        if (next == noState) {
+            transitions[byteClass] = startState;
+        } else {
+            failure[next] = startState;
+            queue.append(next);
+        }
+    }
+
+    int queueIndex = 0;
+    while (queueIndex < queue.size()) {
+        State state        = queue.at(queueIndex);
+        State failureState = failure.at(state);
+        ++queueIndex;
+
+        stateOutputs[state].append(stateOutputs.at(failureState));
+
+        for (unsigned byteClass=0 ; byteClass<currentNumberClasses ; ++byteClass) {
+            unsigned index    = state * currentNumberClasses + byteClass;
+            State    next     = transitions.at(index);
+            State    fallback = transitions.at(failureState * currentNumberClasses + byteClass);
+
+            if (next == noState) {
+                transitions[index] = fallback;
+            } else {
+                failure[next] = fallback;
+                queue.append(next);
+            }
+        }
+    }
+
+    // Flatten the outputs.
+
+    outputOffsets.reserve(static_cast<int>(numberStates + 1));
+    for (unsigned state=0 ; state<numberStates ; ++state) {
+        outputOffsets.append(static_cast<std::uint32_t>(outputs.size()));
+        outputs.append(stateOutputs.at(state));
+    }
+
+    outputOffsets.append(static_cast<std::uint32_t>(outputs.size()));
+}
+
+
+KeywordMatcher::~KeywordMatcher() {}
+
+
+unsigned KeywordMatcher::numberKeywords() const {
+    return currentNumberKeywords;
+}
+
+
+unsigned KeywordMatcher::numberStates() const {
+    return static_cast<unsigned>(outputOffsets.size() - 1);
+}
+
+
+void KeywordMatcher::markEmptyKeywords(QVector<bool>& found, unsigned& numberFound) const {
+    // The start state has no outputs so any keyword that can never be reached by a transition must be empty.
+
+    QVector<bool> reachable(static_cast<int>(currentNumberKeywords), false);
+    for (  QVector<std::uint32_t>::const_iterator it = outputs.constBegin(), end = outputs.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        reachable[static_cast<int>(*it)] = true;
+    }
+
+    for (unsigned i=0 ; i<currentNumberKeywords ; ++i) {
+        if (!reachable.at(i) && !found.at(i)) {
+            found[i] = true;
+            ++numberFound;
+        }
+    }
+}
+
+
+KeywordMatcher::State KeywordMatcher::scan(
+        KeywordMatcher::State state,
+        const char*           data,
+        unsigned long         length,
+        QVector<bool>&        found,
+        unsigned&             numberFound,
+        unsigned              targetNumberFound
+    ) const {
+    const std::uint8_t*  bytes          = reinterpret_cast<const std::uint8_t*>(data);
+    const State*         transitionData = transitions.constData();
+    const std::uint32_t* offsetData     = outputOffsets.constData();
+    const std::uint32_t* outputData     = outputs.constData();
+
+    unsigned long i = 0;
+    while (i < length && numberFound < targetNumberFound) {
+        state = transitionData[state * currentNumberClasses + byteClasses[bytes[i]]];
+
+        std::uint32_t outputIndex = offsetData[state];
+        std::uint32_t outputEnd   = offsetData[state + 1];
+        while (outputIndex < outputEnd) {
+            std::uint32_t keywordIndex = outputData[outputIndex];
+            if (!found.at(keywordIndex)) {
+                found[keywordIndex] = true;
+                ++numberFound;
+            }
+
+            ++outputIndex;
+        }
+
+        ++i;
+    }
+
+    return state;
+}
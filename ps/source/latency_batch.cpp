@@ -0,0 +1,229 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref LatencyBatch class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QTimer>
+#include <QString>
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+
+#include <rest_api_out_v1_server.h>
+#include <rest_api_out_v1_inesonic_binary_rest_handler.h>
+
+#include <algorithm>
+
+#include "log.h"
+#include "data_aggregator.h"
+#include "latency_batch.h"
+
+LatencyBatch::LatencyBatch(
+        const LatencyBatch::ReportBuilder& reportBuilder,
+        RestApiOutV1::Server*              server,
+        QObject*                           parent
+    ):RestApiOutV1::InesonicBinaryRestHandler(
+        server,
+        parent
+    ),currentReportBuilder(
+        reportBuilder
+    ),currentSequenceNumber(
+        0
+    ),currentNumberFailures(
+        0
+    ) {
+    retryTimer.setSingleShot(true);
+    connect(&retryTimer, &QTimer::timeout, this, &LatencyBatch::resend);
+}
+
+
+LatencyBatch::LatencyBatch(
+        const LatencyBatch::ReportBuilder& reportBuilder,
+        const QByteArray&                  secret,
+        RestApiOutV1::Server*              server,
+        QObject*                           parent
+    ):RestApiOutV1::InesonicBinaryRestHandler(
+        secret,
+        server,
+        parent
+    ),currentReportBuilder(
+        reportBuilder
+    ),currentSequenceNumber(
+        0
+    ),currentNumberFailures(
+        0
+    ) {
+    retryTimer.setSingleShot(true);
+    connect(&retryTimer, &QTimer::timeout, this, &LatencyBatch::resend);
+}
+
+
+LatencyBatch::~LatencyBatch() {}
+
+
+void LatencyBatch::send(
+        const DataAggregator::LatencyEntryList&   entries,
+        const DataAggregator::LatencySummaryList& summaries,
+        unsigned long long                        sequenceNumber
+    ) {
+    currentEntries        = entries;
+    currentSummaries      = summaries;
+    currentSequenceNumber = sequenceNumber;
+    currentNumberFailures = 0;
+
+    resend();
+}
+
+
+const DataAggregator::LatencyEntryList& LatencyBatch::entries() const {
+    return currentEntries;
+}
+
+
+unsigned long LatencyBatch::numberEntries() const {
+    return static_cast<unsigned long>(currentEntries.size());
+}
+
+
+unsigned long LatencyBatch::numberSummaries() const {
+    return static_cast<unsigned long>(currentSummaries.size());
+}
+
+
+unsigned long LatencyBatch::discardSummaries() {
+    unsigned long result = 0;
+    for (  DataAggregator::LatencySummaryList::const_iterator it  = currentSummaries.constBegin(),
+                                                              end = currentSummaries.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        result += it->sketch().count();
+    }
+
+    currentSummaries.clear();
+    return result;
+}
+
+
+unsigned long long LatencyBatch::sequenceNumber() const {
+    return currentSequenceNumber;
+}
+
+
+unsigned long LatencyBatch::jitter(unsigned long delay) {
+    return delay / 2 + QRandomGenerator::global()->bounded(static_cast<quint32>(delay / 2 + 1));
+}
+
+
+void LatencyBatch::processResponse(const QByteArray& binaryData, const QString& contentType) {
+    if (contentType == QString("application/json")) {
+        QJsonDocument jsonDocument = QJsonDocument::fromJson(binaryData);
+        if (jsonDocument.isObject()) {
+            QJsonObject responseObject = jsonDocument.object();
+            QString     status         = responseObject.value("status").toString();
+
+            // The database controller advertises the newest report version it accepts.  Older controllers don't
+            // include the field so we fall back to version 0.
+
+            unsigned supportedVersion = static_cast<unsigned>(
+                std::max(0, responseObject.value("latency_version").toInt(0))
+            );
+            bool compressionAccepted = responseObject.value("latency_compression").toBool(false);
+
+            bool accepted = (status == QString("OK"));
+            if (accepted) {
+                if (logEnabled(LogLevel::DEBUG)) {
+                    if (!currentSummaries.isEmpty()) {
+                        logMessage(
+                            LogLevel::DEBUG,
+                            QString("Sent %1 latency entries and %2 latency summaries, sequence %3.")
+                            .arg(currentEntries.size())
+                            .arg(currentSummaries.size())
+                            .arg(currentSequenceNumber)
+                        );
+                    } else if (!currentEntries.isEmpty()) {
+                        logMessage(
+                            LogLevel::DEBUG,
+                            QString("Sent %1 latency entries for timestamps %2-%3, sequence %4.")
+                            .arg(currentEntries.size())
+                            .arg(currentEntries.first().unixTimestamp())
+                            .arg(currentEntries.last().unixTimestamp())
+                            .arg(currentSequenceNumber)
+                        );
+                    } else {
+                        logMessage(
+                            LogLevel::DEBUG,
+                            QString("Sent empty latency entry report, sequence %1.").arg(currentSequenceNumber)
+                        );
+                    }
+                }
+
+                currentEntries.clear();
+                currentSummaries.clear();
+            } else {
+                scheduleRetry(QString("Database controller reported \"%1\"").arg(status));
+            }
+
+            emit responseReceived(this, accepted, supportedVersion, compressionAccepted);
+        } else {
+            scheduleRetry(QString("Expected JSON object."));
+        }
+    } else {
+        scheduleRetry(QString("Unexpected response content type."));
+    }
+}
+
+
+void LatencyBatch::processRequestFailed(const QString& errorString) {
+    scheduleRetry(errorString);
+}
+
+
+void LatencyBatch::resend() {
+    post(
+        DataAggregator::latencyRecordPath,
+        currentReportBuilder(currentEntries, currentSummaries, currentSequenceNumber)
+    );
+}
+
+
+void LatencyBatch::scheduleRetry(const QString& reason) {
+    unsigned long delay = minimumRetryDelaySeconds;
+    for (unsigned i=0 ; i<currentNumberFailures && delay < maximumRetryDelaySeconds ; ++i) {
+        delay *= 2;
+    }
+
+    if (delay > maximumRetryDelaySeconds) {
+        delay = maximumRetryDelaySeconds;
+    }
+
+    delay = jitter(1000 * delay);
+    ++currentNumberFailures;
+
+    logMessage(
+        LogLevel::WARNING,
+        QString("Latency report %1 failed: %2 -- retrying in %3 seconds.")
+        .arg(currentSequenceNumber)
+        .arg(reason)
+        .arg((delay + 500) / 1000)
+    );
+
+    retryTimer.start(static_cast<int>(delay));
+}
@@ -0,0 +1,255 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref LatencyReportEncoder class.
+***********************************************************************************************************************/
+
+#include <QByteArray>
+
+#include <cstdint>
+#include <algorithm>
+
+#include "data_aggregator.h"
+#include "latency_sketch.h"
+#include "latency_report_encoder.h"
+
+void LatencyReportEncoder::encodeFixed(
+        const LatencyReportEncoder::LatencyEntryList& latencyEntryList,
+        QByteArray&                                   buffer
+    ) {
+    unsigned long numberLatencyEntries = static_cast<unsigned long>(latencyEntryList.size());
+    unsigned long startingSize         = static_cast<unsigned long>(buffer.size());
+
+    buffer.resize(static_cast<int>(startingSize + numberLatencyEntries * sizeof(FixedEntry)));
+    FixedEntry* entry = reinterpret_cast<FixedEntry*>(buffer.data() + startingSize);
+
+    for (unsigned long i=0 ; i<numberLatencyEntries ; ++i) {
+        const DataAggregator::LatencyEntry& latencyEntry = latencyEntryList.at(i);
+        entry->monitorId           = latencyEntry.monitorId();
+        entry->timestamp           = latencyEntry.zoranTimestamp();
+        entry->latencyMicroseconds = latencyEntry.latencyMicroseconds();
+
+        ++entry;
+    }
+}
+
+
+void LatencyReportEncoder::encodeCompact(
+        const LatencyReportEncoder::LatencyEntryList& latencyEntryList,
+        QByteArray&                                   buffer
+    ) {
+    encodeSorted(latencyEntryList, buffer, PhaseEncoding::NONE);
+}
+
+
+void LatencyReportEncoder::encodePhased(
+        const LatencyReportEncoder::LatencyEntryList& latencyEntryList,
+        QByteArray&                                   buffer
+    ) {
+    encodeSorted(latencyEntryList, buffer, PhaseEncoding::FOUR_PHASES);
+}
+
+
+void LatencyReportEncoder::encodeSequenced(
+        const LatencyReportEncoder::LatencyEntryList& latencyEntryList,
+        std::uint32_t                                 sessionId,
+        std::uint64_t                                 sequenceNumber,
+        QByteArray&                                   buffer
+    ) {
+    appendVarint(buffer, sessionId);
+    appendVarint(buffer, sequenceNumber);
+
+    encodeSorted(latencyEntryList, buffer, PhaseEncoding::FOUR_PHASES);
+}
+
+
+void LatencyReportEncoder::encodeAggregated(
+        const LatencyReportEncoder::LatencyEntryList&   latencyEntryList,
+        const LatencyReportEncoder::LatencySummaryList& latencySummaryList,
+        unsigned                                        windowSeconds,
+        std::uint32_t                                   sessionId,
+        std::uint64_t                                   sequenceNumber,
+        QByteArray&                                     buffer
+    ) {
+    encodeSequenced(latencyEntryList, sessionId, sequenceNumber, buffer);
+    encodeSummaries(latencySummaryList, windowSeconds, buffer);
+}
+
+
+void LatencyReportEncoder::encodeDetailed(
+        const LatencyReportEncoder::LatencyEntryList&   latencyEntryList,
+        const LatencyReportEncoder::LatencySummaryList& latencySummaryList,
+        unsigned                                        windowSeconds,
+        std::uint32_t                                   sessionId,
+        std::uint64_t                                   sequenceNumber,
+        QByteArray&                                     buffer
+    ) {
+    appendVarint(buffer, sessionId);
+    appendVarint(buffer, sequenceNumber);
+
+    encodeSorted(latencyEntryList, buffer, PhaseEncoding::FIVE_PHASES);
+    encodeSummaries(latencySummaryList, windowSeconds, buffer);
+}
+
+
+void LatencyReportEncoder::encodeSorted(
+        const LatencyReportEncoder::LatencyEntryList& latencyEntryList,
+        QByteArray&                                   buffer,
+        LatencyReportEncoder::PhaseEncoding           phaseEncoding
+    ) {
+    LatencyEntryList sortedEntries = latencyEntryList;
+    std::sort(
+        sortedEntries.begin(),
+        sortedEntries.end(),
+        [](const DataAggregator::LatencyEntry& a, const DataAggregator::LatencyEntry& b) {
+            return (
+                   a.monitorId() < b.monitorId()
+                || (a.monitorId() == b.monitorId() && a.zoranTimestamp() < b.zoranTimestamp())
+            );
+        }
+    );
+
+    unsigned long numberEntries = static_cast<unsigned long>(sortedEntries.size());
+    std::uint32_t baseTimestamp = 0;
+    if (numberEntries > 0) {
+        baseTimestamp = sortedEntries.first().zoranTimestamp();
+        for (unsigned long i=1 ; i<numberEntries ; ++i) {
+            baseTimestamp = std::min(baseTimestamp, sortedEntries.at(i).zoranTimestamp());
+        }
+    }
+
+    // Most entries encode to 4 or 5 bytes so this avoids repeated reallocation.
+    buffer.reserve(static_cast<int>(buffer.size() + 16 + 6 * numberEntries));
+
+    appendVarint(buffer, numberEntries);
+    appendVarint(buffer, baseTimestamp);
+
+    DataAggregator::MonitorId lastMonitorId = 0;
+    unsigned long             index         = 0;
+    while (index < numberEntries) {
+        DataAggregator::MonitorId monitorId = sortedEntries.at(index).monitorId();
+
+        unsigned long groupEnd = index + 1;
+        while (groupEnd < numberEntries && sortedEntries.at(groupEnd).monitorId() == monitorId) {
+            ++groupEnd;
+        }
+
+        appendVarint(buffer, monitorId - lastMonitorId);
+        appendVarint(buffer, groupEnd - index);
+
+        std::uint32_t lastTimestamp = baseTimestamp;
+        while (index < groupEnd) {
+            const DataAggregator::LatencyEntry& entry = sortedEntries.at(index);
+
+            appendVarint(buffer, entry.zoranTimestamp() - lastTimestamp);
+
+            if (phaseEncoding != PhaseEncoding::NONE) {
+                const DataAggregator::LatencyPhases& phases = entry.phases();
+                if (phases.isValid()) {
+                    appendVarint(buffer, (static_cast<std::uint64_t>(entry.latencyMicroseconds()) << 1) | 1);
+                    appendVarint(buffer, phases.dnsMicroseconds());
+
+                    if (phaseEncoding == PhaseEncoding::FIVE_PHASES) {
+                        appendVarint(buffer, phases.connectMicroseconds());
+                        appendVarint(buffer, phases.tlsMicroseconds());
+                    } else {
+                        appendVarint(
+                            buffer,
+                            static_cast<std::uint64_t>(phases.connectMicroseconds()) + phases.tlsMicroseconds()
+                        );
+                    }
+
+                    appendVarint(buffer, phases.firstByteMicroseconds());
+                    appendVarint(buffer, phases.transferMicroseconds());
+                } else {
+                    appendVarint(buffer, static_cast<std::uint64_t>(entry.latencyMicroseconds()) << 1);
+                }
+            } else {
+                appendVarint(buffer, entry.latencyMicroseconds());
+            }
+
+            lastTimestamp = entry.zoranTimestamp();
+            ++index;
+        }
+
+        lastMonitorId = monitorId;
+    }
+}
+
+
+void LatencyReportEncoder::encodeSummaries(
+        const LatencyReportEncoder::LatencySummaryList& latencySummaryList,
+        unsigned                                        windowSeconds,
+        QByteArray&                                     buffer
+    ) {
+    LatencySummaryList sortedSummaries = latencySummaryList;
+    std::sort(
+        sortedSummaries.begin(),
+        sortedSummaries.end(),
+        [](const DataAggregator::LatencySummary& a, const DataAggregator::LatencySummary& b) {
+            return (
+                   a.monitorId() < b.monitorId()
+                || (a.monitorId() == b.monitorId() && a.windowStart() < b.windowStart())
+            );
+        }
+    );
+
+    unsigned long numberSummaries = static_cast<unsigned long>(sortedSummaries.size());
+    std::uint32_t baseTimestamp   = 0;
+    if (numberSummaries > 0) {
+        baseTimestamp = sortedSummaries.first().windowStart();
+        for (unsigned long i=1 ; i<numberSummaries ; ++i) {
+            baseTimestamp = std::min(baseTimestamp, sortedSummaries.at(i).windowStart());
+        }
+    }
+
+    appendVarint(buffer, numberSummaries);
+    appendVarint(buffer, windowSeconds);
+    appendVarint(buffer, baseTimestamp);
+
+    DataAggregator::MonitorId lastMonitorId = 0;
+    for (  LatencySummaryList::const_iterator it = sortedSummaries.constBegin(), end = sortedSummaries.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        const LatencySketch& sketch = it->sketch();
+
+        appendVarint(buffer, it->monitorId() - lastMonitorId);
+        appendVarint(buffer, it->windowStart() - baseTimestamp);
+        appendVarint(buffer, sketch.count());
+        appendVarint(buffer, sketch.minimum());
+        appendVarint(buffer, sketch.maximum());
+        appendVarint(buffer, sketch.sum());
+
+        const LatencySketch::Buckets& buckets = sketch.buckets();
+        appendVarint(buffer, static_cast<std::uint64_t>(buckets.size()));
+
+        std::uint16_t lastIndex = 0;
+        for (  LatencySketch::Buckets::const_iterator bucketIterator    = buckets.constBegin(),
+                                                      bucketEndIterator = buckets.constEnd()
+             ; bucketIterator != bucketEndIterator
+             ; ++bucketIterator
+            ) {
+            appendVarint(buffer, bucketIterator->index() - lastIndex);
+            appendVarint(buffer, bucketIterator->count());
+
+            lastIndex = bucketIterator->index();
+        }
+
+        lastMonitorId = it->monitorId();
+    }
+}
@@ -0,0 +1,64 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref LatencySketch class.
+***********************************************************************************************************************/
+
+#include <QVector>
+
+#include <cstdint>
+#include <algorithm>
+
+#include "metrics.h"
+#include "latency_sketch.h"
+
+LatencySketch::LatencySketch() {
+    currentCount   = 0;
+    currentMinimum = 0;
+    currentMaximum = 0;
+    currentSum     = 0;
+}
+
+
+void LatencySketch::record(std::uint32_t microseconds) {
+    if (currentCount == 0 || microseconds < currentMinimum) {
+        currentMinimum = microseconds;
+    }
+
+    if (microseconds > currentMaximum) {
+        currentMaximum = microseconds;
+    }
+
+    ++currentCount;
+    currentSum += microseconds;
+
+    std::uint16_t     index = static_cast<std::uint16_t>(LatencyHistogram::bucketIndex(microseconds));
+    Buckets::iterator it    = std::lower_bound(
+        currentBuckets.begin(),
+        currentBuckets.end(),
+        index,
+        [](const Bucket& bucket, std::uint16_t value) {
+            return bucket.index() < value;
+        }
+    );
+
+    if (it != currentBuckets.end() && it->index() == index) {
+        it->increment();
+    } else {
+        currentBuckets.insert(it, Bucket(index, 1));
+    }
+}
@@ -0,0 +1,373 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref LatencySpill class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QFile>
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "log.h"
+#include "data_aggregator.h"
+#include "latency_spill.h"
+
+LatencySpill::LatencySpill() {
+    mappedData = nullptr;
+    mappedSize = 0;
+
+    currentSize.store(0);
+}
+
+
+LatencySpill::~LatencySpill() {
+    closeFile();
+}
+
+
+bool LatencySpill::setFilename(const QString& newFilename) {
+    bool success = true;
+
+    if (newFilename != spillFile.fileName() || (!newFilename.isEmpty() && !spillFile.isOpen())) {
+        closeFile();
+
+        if (!newFilename.isEmpty()) {
+            spillFile.setFileName(newFilename);
+            success = spillFile.open(QFile::OpenModeFlag::ReadWrite);
+            if (success) {
+                qint64 fileSize = spillFile.size();
+
+                success = mapFile(fileSize > fileGrowthQuantum ? fileSize : fileGrowthQuantum);
+                if (success                                                 &&
+                    fileSize >= static_cast<qint64>(sizeof(FileHeader))     &&
+                    fileHeader()->magic == spillMagic                       &&
+                    fileHeader()->version == legacySpillVersion                ) {
+                    success = upgradeLegacyFile();
+                }
+
+                if (success) {
+                    FileHeader* header = fileHeader();
+                    if (fileSize < static_cast<qint64>(sizeof(FileHeader)) ||
+                        header->magic != spillMagic                          ||
+                        header->version != spillVersion                      ||
+                        header->head > header->tail                          ||
+                        header->tail > capacity()                               ) {
+                        header->magic   = spillMagic;
+                        header->version = spillVersion;
+                        header->head    = 0;
+                        header->tail    = 0;
+                    } else if (header->tail > header->head) {
+                        logWrite(
+                            QString("Replaying %1 latency entries from spill file %2")
+                            .arg(header->tail - header->head)
+                            .arg(newFilename),
+                            false
+                        );
+                    }
+
+                    currentSize.store(static_cast<unsigned long>(header->tail - header->head));
+                } else {
+                    logWrite(QString("Could not map latency spill file %1").arg(newFilename), true);
+                    closeFile();
+                }
+            } else {
+                logWrite(QString("Could not open latency spill file %1").arg(newFilename), true);
+                spillFile.setFileName(QString());
+            }
+        }
+    }
+
+    return success;
+}
+
+
+QString LatencySpill::filename() const {
+    return spillFile.isOpen() ? spillFile.fileName() : QString();
+}
+
+
+bool LatencySpill::isEnabled() const {
+    return mappedData != nullptr;
+}
+
+
+unsigned long LatencySpill::size() const {
+    return currentSize.load(std::memory_order_relaxed);
+}
+
+
+unsigned long LatencySpill::append(const DataAggregator::LatencyEntryList& entries, unsigned long numberEntries) {
+    unsigned long discarded = 0;
+
+    if (mappedData != nullptr && numberEntries > 0) {
+        // When more entries arrive than the file can hold, the oldest are discarded first.
+
+        unsigned long firstEntry = 0;
+        if (numberEntries > maximumEntries) {
+            firstEntry    = numberEntries - maximumEntries;
+            discarded     = firstEntry;
+            numberEntries = maximumEntries;
+        }
+
+        FileHeader*        header         = fileHeader();
+        unsigned long long numberRecorded = header->tail - header->head;
+        if (numberRecorded + numberEntries > maximumEntries) {
+            unsigned long long excess = numberRecorded + numberEntries - maximumEntries;
+
+            header->head += excess;
+            discarded    += static_cast<unsigned long>(excess);
+        }
+
+        if (reserve(numberEntries)) {
+            header = fileHeader(); // The file may have been remapped.
+
+            EntryRecord* entryRecord = record(header->tail);
+            for (unsigned long i=firstEntry ; i<firstEntry + numberEntries ; ++i) {
+                const DataAggregator::LatencyEntry&  entry  = entries.at(static_cast<int>(i));
+                const DataAggregator::LatencyPhases& phases = entry.phases();
+
+                entryRecord->monitorId   = entry.monitorId();
+                entryRecord->timestamp   = entry.zoranTimestamp();
+                entryRecord->latency     = entry.latencyMicroseconds();
+                entryRecord->phasesValid = phases.isValid() ? 1 : 0;
+                entryRecord->dns         = phases.dnsMicroseconds();
+                entryRecord->connect     = phases.connectMicroseconds();
+                entryRecord->tls         = phases.tlsMicroseconds();
+                entryRecord->firstByte   = phases.firstByteMicroseconds();
+                entryRecord->transfer    = phases.transferMicroseconds();
+
+                ++entryRecord;
+            }
+
+            header->tail += numberEntries;
+        } else {
+            discarded += numberEntries;
+        }
+
+        if (mappedData != nullptr) {
+            header = fileHeader();
+            currentSize.store(static_cast<unsigned long>(header->tail - header->head), std::memory_order_relaxed);
+        } else {
+            currentSize.store(0, std::memory_order_relaxed);
+        }
+    } else {
+        discarded = numberEntries;
+    }
+
+    return discarded;
+}
+
+
+void LatencySpill::take(DataAggregator::LatencyEntryList& entries, unsigned long maximumNumberEntries) {
+    if (mappedData != nullptr) {
+        FileHeader*        header        = fileHeader();
+        unsigned long long numberRecords = std::min(
+            static_cast<unsigned long long>(maximumNumberEntries),
+            header->tail - header->head
+        );
+
+        entries.reserve(entries.size() + static_cast<int>(numberRecords));
+
+        const EntryRecord* entryRecord = record(header->head);
+        for (unsigned long long i=0 ; i<numberRecords ; ++i) {
+            entries.append(
+                DataAggregator::LatencyEntry(
+                    entryRecord->monitorId,
+                    DataAggregator::LatencyEntry::toUnixTimestamp(entryRecord->timestamp),
+                    entryRecord->latency,
+                      entryRecord->phasesValid != 0
+                    ? DataAggregator::LatencyPhases(
+                          entryRecord->dns,
+                          entryRecord->connect,
+                          entryRecord->tls,
+                          entryRecord->firstByte,
+                          entryRecord->transfer
+                      )
+                    : DataAggregator::LatencyPhases()
+                )
+            );
+
+            ++entryRecord;
+        }
+
+        header->head += numberRecords;
+        if (header->head == header->tail) {
+            header->head = 0;
+            header->tail = 0;
+
+            // Give the disk space back once the backlog has been replayed.
+
+            if (mappedSize > fileGrowthQuantum && !mapFile(fileGrowthQuantum)) {
+                logWrite(QString("Could not shrink latency spill file %1").arg(spillFile.fileName()), true);
+            }
+        }
+
+        if (mappedData != nullptr) {
+            header = fileHeader();
+            currentSize.store(static_cast<unsigned long>(header->tail - header->head), std::memory_order_relaxed);
+        } else {
+            currentSize.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+LatencySpill::FileHeader* LatencySpill::fileHeader() const {
+    return reinterpret_cast<FileHeader*>(mappedData);
+}
+
+
+unsigned long long LatencySpill::capacity() const {
+    return static_cast<unsigned long long>(mappedSize - sizeof(FileHeader)) / sizeof(EntryRecord);
+}
+
+
+LatencySpill::EntryRecord* LatencySpill::record(unsigned long long index) const {
+    return reinterpret_cast<EntryRecord*>(mappedData + sizeof(FileHeader)) + index;
+}
+
+
+bool LatencySpill::reserve(unsigned long long numberRecords) {
+    bool        success = true;
+    FileHeader* header  = fileHeader();
+
+    if (header->tail + numberRecords > capacity()) {
+        unsigned long long numberLive = header->tail - header->head;
+        if (header->head >= numberLive) {
+            std::memmove(record(0), record(header->head), numberLive * sizeof(EntryRecord));
+
+            header->head = 0;
+            header->tail = numberLive;
+        }
+
+        if (header->tail + numberRecords > capacity()) {
+            success = mapFile(
+                static_cast<qint64>(sizeof(FileHeader) + (header->tail + numberRecords) * sizeof(EntryRecord))
+            );
+
+            if (!success) {
+                logWrite(QString("Could not grow latency spill file %1").arg(spillFile.fileName()), true);
+            }
+        }
+    }
+
+    return success;
+}
+
+
+bool LatencySpill::upgradeLegacyFile() {
+    bool               success        = true;
+    FileHeader*        header         = fileHeader();
+    unsigned long long legacyCapacity = (
+          static_cast<unsigned long long>(mappedSize - sizeof(FileHeader))
+        / sizeof(LegacyEntryRecord)
+    );
+
+    // A damaged file is left unchanged so it will be discarded.
+
+    if (header->head <= header->tail && header->tail <= legacyCapacity) {
+        unsigned long long numberRecords = header->tail - header->head;
+        LegacyEntryRecord* legacyRecords = reinterpret_cast<LegacyEntryRecord*>(mappedData + sizeof(FileHeader));
+
+        std::memmove(legacyRecords, legacyRecords + header->head, numberRecords * sizeof(LegacyEntryRecord));
+
+        header->head = 0;
+        header->tail = 0;
+
+        success = reserve(numberRecords);
+        if (success) {
+            // Records are converted in place from last to first.  Converted records are larger so each only
+            // overwrites legacy records that have already been converted.
+
+            header        = fileHeader();
+            legacyRecords = reinterpret_cast<LegacyEntryRecord*>(mappedData + sizeof(FileHeader));
+
+            for (unsigned long long i=numberRecords ; i>0 ; --i) {
+                LegacyEntryRecord legacyRecord = legacyRecords[i - 1];
+                EntryRecord*      entryRecord  = record(i - 1);
+
+                entryRecord->monitorId   = legacyRecord.monitorId;
+                entryRecord->timestamp   = legacyRecord.timestamp;
+                entryRecord->latency     = legacyRecord.latency;
+                entryRecord->phasesValid = legacyRecord.phasesValid;
+                entryRecord->dns         = legacyRecord.dns;
+                entryRecord->connect     = legacyRecord.connect;
+                entryRecord->tls         = 0;
+                entryRecord->firstByte   = legacyRecord.firstByte;
+                entryRecord->transfer    = legacyRecord.transfer;
+            }
+
+            header->version = spillVersion;
+            header->tail    = numberRecords;
+
+            logWrite(
+                QString("Converted %1 latency entries in spill file %2 to version %3")
+                .arg(numberRecords)
+                .arg(spillFile.fileName())
+                .arg(spillVersion),
+                false
+            );
+        }
+    }
+
+    return success;
+}
+
+
+bool LatencySpill::mapFile(qint64 size) {
+    if (mappedData != nullptr) {
+        spillFile.unmap(mappedData);
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+
+    qint64 fileSize = ((size + fileGrowthQuantum - 1) / fileGrowthQuantum) * fileGrowthQuantum;
+    bool   success  = true;
+    if (spillFile.size() != fileSize) {
+        success = spillFile.resize(fileSize);
+    }
+
+    if (success) {
+        mappedData = spillFile.map(0, fileSize);
+        if (mappedData != nullptr) {
+            mappedSize = fileSize;
+        } else {
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+
+void LatencySpill::closeFile() {
+    if (mappedData != nullptr) {
+        spillFile.unmap(mappedData);
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+
+    if (spillFile.isOpen()) {
+        spillFile.close();
+    }
+
+    spillFile.setFileName(QString());
+    currentSize.store(0);
+}
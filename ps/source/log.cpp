@@ -15,32 +15,564 @@
 ********************************************************************************************************************//**
 * \file
 *
-* This header implements the \ref Monitor class.
+* This header implements the \ref logWrite function and related logging functions.
 ***********************************************************************************************************************/
 
 #include <QString>
 #include <QByteArray>
 #include <QDateTime>
+#include <QThread>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QWaitCondition>
+#include <QHash>
+#include <QList>
 
+#include <atomic>
+#include <memory>
+#include <algorithm>
 #include <iostream>
 
 #include "log.h"
 
-QMutex loggingMutex;
+/***********************************************************************************************************************
+* LogRing
+*/
+
+/**
+ * Class that provides a per-thread, lock-free, single-producer/single-consumer ring of pending log entries.  The
+ * owning thread is the only producer.  The log writer thread is the only consumer.
+ */
+class LogRing {
+    public:
+        /**
+         * A single pending log entry.  The timestamp is captured by the producer.  Formatting is deferred to the
+         * writer thread.
+         */
+        struct Entry {
+            /**
+             * The time the entry was logged, in milliseconds since the epoch.
+             */
+            qint64 timestamp;
+
+            /**
+             * The entry severity level.
+             */
+            LogLevel level;
+
+            /**
+             * The log message.
+             */
+            QString message;
+        };
+
+        /**
+         * The number of entries held by each ring.  Value must be a power of 2.
+         */
+        static constexpr unsigned long capacity = 4096;
+
+        LogRing():orphaned(false),dropped(0),head(0),tail(0) {}
+
+        ~LogRing() = default;
+
+        /**
+         * Method you can use to append an entry to the ring.  This method must only be called by the producer
+         * thread and never blocks.
+         *
+         * \param[in] timestamp The entry timestamp.
+         *
+         * \param[in] level     The entry severity level.
+         *
+         * \param[in] message   The log message.
+         *
+         * \return Returns true on success.  Returns false if the ring is full.
+         */
+        inline bool append(qint64 timestamp, LogLevel level, const QString& message) {
+            bool          success;
+            unsigned long currentTail = tail.load(std::memory_order_relaxed);
+            unsigned long currentHead = head.load(std::memory_order_acquire);
+
+            if (currentTail - currentHead < capacity) {
+                Entry& entry = entries[currentTail & mask];
+                entry.timestamp = timestamp;
+                entry.level     = level;
+                entry.message   = message;
+
+                tail.store(currentTail + 1, std::memory_order_release);
+                success = true;
+            } else {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                success = false;
+            }
+
+            return success;
+        }
+
+        /**
+         * Method you can use to move all entries in the ring to a list.  This method must only be called by the
+         * consumer thread.
+         *
+         * \param[in,out] list The list to receive the entries.  Entries are appended to the list.
+         *
+         * \return Returns true if the ring was empty.
+         */
+        inline bool drain(QList<Entry>& list) {
+            unsigned long currentHead = head.load(std::memory_order_relaxed);
+            unsigned long currentTail = tail.load(std::memory_order_acquire);
+
+            for (unsigned long index=currentHead ; index!=currentTail ; ++index) {
+                Entry& entry = entries[index & mask];
+                list.append(entry);
+                entry.message = QString();
+            }
+
+            head.store(currentTail, std::memory_order_release);
+            return currentHead == currentTail;
+        }
+
+        /**
+         * Flag set when the owning thread exits.  Orphaned rings are released once drained.
+         */
+        std::atomic<bool> orphaned;
+
+        /**
+         * The number of entries dropped because the ring was full.
+         */
+        std::atomic<unsigned long> dropped;
+
+    private:
+        /**
+         * Mask used to convert an index into a ring position.
+         */
+        static constexpr unsigned long mask = capacity - 1;
+
+        /**
+         * Size of a cache line.  Used to keep the producer and consumer indexes from sharing a cache line.
+         */
+        static constexpr unsigned cacheLineSize = 64;
+
+        /**
+         * The consumer index.
+         */
+        alignas(cacheLineSize) std::atomic<unsigned long> head;
+
+        /**
+         * The producer index.
+         */
+        alignas(cacheLineSize) std::atomic<unsigned long> tail;
+
+        /**
+         * The ring storage.
+         */
+        Entry entries[capacity];
+};
+
+/***********************************************************************************************************************
+* LogWriter
+*/
+
+/**
+ * Class that drains the per-thread log rings and writes the entries.  Repeated messages are rate limited.
+ */
+class LogWriter:public QThread {
+    public:
+        /**
+         * The interval between drains, in milliseconds.
+         */
+        static constexpr unsigned long drainInterval = 100;
+
+        /**
+         * The rate limiting window, in milliseconds.
+         */
+        static constexpr qint64 repeatWindow = 10000;
+
+        /**
+         * The number of identical messages written per window before further repeats are suppressed.
+         */
+        static constexpr unsigned maximumRepeats = 5;
+
+        LogWriter();
+
+        ~LogWriter() override;
+
+        /**
+         * Method that returns the global log writer, starting it if needed.
+         *
+         * \return Returns the global log writer.
+         */
+        static LogWriter& instance();
+
+        /**
+         * Method that returns the calling thread's log ring, creating and registering it if needed.
+         *
+         * \return Returns the calling thread's log ring.
+         */
+        LogRing* threadRing();
+
+        /**
+         * Method that wakes the writer thread early.  This method never blocks.
+         */
+        void wake();
+
+        /**
+         * Method that blocks until every entry queued before the call has been written.
+         */
+        void flush();
+
+    protected:
+        /**
+         * Method that runs the writer loop.
+         */
+        void run() override;
+
+    private:
+        /**
+         * Class used to track repeats of a message within the current rate limiting window.
+         */
+        struct RepeatTracker {
+            /**
+             * The start of the current window, in milliseconds since the epoch.
+             */
+            qint64 windowStart;
+
+            /**
+             * The number of times the message was seen in the current window.
+             */
+            unsigned long count;
+
+            /**
+             * The severity level of the message.
+             */
+            LogLevel level;
+        };
+
+        /**
+         * Class that ties a log ring to the lifetime of its owning thread.
+         */
+        class RingHolder {
+            public:
+                RingHolder();
+
+                ~RingHolder();
+
+                /**
+                 * The ring owned by this thread.
+                 */
+                std::shared_ptr<LogRing> ring;
+        };
+
+        /**
+         * Method that drains all rings and writes the entries.
+         *
+         * \param[in] final If true, all pending rate limiting summaries are written.
+         */
+        void drain(bool final);
+
+        /**
+         * Method that writes a single formatted entry.
+         *
+         * \param[in] timestamp The entry timestamp.
+         *
+         * \param[in] level     The entry severity level.
+         *
+         * \param[in] message   The log message.
+         */
+        static void writeEntry(qint64 timestamp, LogLevel level, const QString& message);
+
+        /**
+         * Mutex used to protect the list of rings.  Only taken when a thread first logs and when draining.
+         */
+        QMutex ringsMutex;
+
+        /**
+         * The registered rings.
+         */
+        QList<std::shared_ptr<LogRing>> rings;
+
+        /**
+         * Mutex used with the wake and flush conditions.
+         */
+        QMutex wakeMutex;
+
+        /**
+         * Condition used to wake the writer.
+         */
+        QWaitCondition wakeCondition;
+
+        /**
+         * Condition used to report completed flushes.
+         */
+        QWaitCondition flushedCondition;
+
+        /**
+         * The number of flushes requested.
+         */
+        unsigned long long flushesRequested;
+
+        /**
+         * The number of flushes completed.
+         */
+        unsigned long long flushesCompleted;
+
+        /**
+         * Repeat tracking by message.
+         */
+        QHash<QString, RepeatTracker> repeats;
+};
+
+
+static std::atomic<int> minimumLogLevel(static_cast<int>(LogLevel::INFO));
+
+LogWriter::RingHolder::RingHolder():ring(new LogRing) {}
+
+
+LogWriter::RingHolder::~RingHolder() {
+    ring->orphaned.store(true, std::memory_order_release);
+}
+
+
+LogWriter::LogWriter() {
+    flushesRequested = 0;
+    flushesCompleted = 0;
+
+    start();
+}
+
+
+LogWriter::~LogWriter() {
+    requestInterruption();
+    wake();
+    wait();
+}
+
+
+LogWriter& LogWriter::instance() {
+    static LogWriter writer;
+    return writer;
+}
+
+
+LogRing* LogWriter::threadRing() {
+    static thread_local RingHolder ringHolder;
+    static thread_local bool       registered = false;
+
+    if (!registered) {
+        ringsMutex.lock();
+        rings.append(ringHolder.ring);
+        ringsMutex.unlock();
+
+        registered = true;
+    }
+
+    return ringHolder.ring.get();
+}
+
+
+void LogWriter::wake() {
+    // We intentionally do not take the wake mutex here so producers never block.  A missed wake-up only delays the
+    // entry until the next drain interval.
+
+    wakeCondition.wakeAll();
+}
+
+
+void LogWriter::flush() {
+    QMutexLocker locker(&wakeMutex);
+
+    unsigned long long flushNumber = ++flushesRequested;
+    wakeCondition.wakeAll();
+
+    while (flushesCompleted < flushNumber && isRunning()) {
+        flushedCondition.wait(&wakeMutex, drainInterval);
+    }
+}
+
+
+void LogWriter::run() {
+    bool done = false;
+    do {
+        wakeMutex.lock();
+        if (!isInterruptionRequested() && flushesCompleted == flushesRequested) {
+            wakeCondition.wait(&wakeMutex, drainInterval);
+        }
+
+        unsigned long long flushNumber = flushesRequested;
+        done = isInterruptionRequested();
+        wakeMutex.unlock();
+
+        drain(done);
+
+        wakeMutex.lock();
+        flushesCompleted = flushNumber;
+        flushedCondition.wakeAll();
+        wakeMutex.unlock();
+    } while (!done);
+}
+
+
+void LogWriter::drain(bool final) {
+    QList<LogRing::Entry> entries;
+    unsigned long         numberDropped = 0;
+
+    ringsMutex.lock();
+    QList<std::shared_ptr<LogRing>>::iterator it = rings.begin();
+    while (it != rings.end()) {
+        LogRing* ring     = it->get();
+        bool     orphaned = ring->orphaned.load(std::memory_order_acquire);
+        bool     empty    = ring->drain(entries);
+
+        numberDropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+
+        if (orphaned && empty) {
+            it = rings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    ringsMutex.unlock();
+
+    std::stable_sort(
+        entries.begin(),
+        entries.end(),
+        [](const LogRing::Entry& a, const LogRing::Entry& b) {
+            return a.timestamp < b.timestamp;
+        }
+    );
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    QHash<QString, RepeatTracker>::iterator repeatIterator = repeats.begin();
+    while (repeatIterator != repeats.end()) {
+        const RepeatTracker& tracker = repeatIterator.value();
+        if (final || now - tracker.windowStart >= repeatWindow) {
+            if (tracker.count > maximumRepeats) {
+                writeEntry(
+                    now,
+                    tracker.level,
+                    QString("Suppressed %1 repeats of \"%2\"")
+                    .arg(tracker.count - maximumRepeats)
+                    .arg(repeatIterator.key())
+                );
+            }
+
+            repeatIterator = repeats.erase(repeatIterator);
+        } else {
+            ++repeatIterator;
+        }
+    }
+
+    for (QList<LogRing::Entry>::const_iterator it=entries.constBegin(),end=entries.constEnd() ; it!=end ; ++it) {
+        QHash<QString, RepeatTracker>::iterator trackerIterator = repeats.find(it->message);
+        if (trackerIterator == repeats.end()) {
+            RepeatTracker tracker;
+            tracker.windowStart = it->timestamp;
+            tracker.count       = 1;
+            tracker.level       = it->level;
+
+            repeats.insert(it->message, tracker);
+            writeEntry(it->timestamp, it->level, it->message);
+        } else {
+            RepeatTracker& tracker = trackerIterator.value();
+            ++tracker.count;
+
+            if (tracker.count <= maximumRepeats) {
+                writeEntry(it->timestamp, it->level, it->message);
+            }
+        }
+    }
+
+    if (numberDropped > 0) {
+        writeEntry(now, LogLevel::WARNING, QString("%1 log messages dropped, log buffers full.").arg(numberDropped));
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+}
+
+
+void LogWriter::writeEntry(qint64 timestamp, LogLevel level, const QString& message) {
+    QString dateTime = QDateTime::fromMSecsSinceEpoch(timestamp).toString(Qt::DateFormat::ISODate);
+
+    switch (level) {
+        case LogLevel::DEBUG: {
+            std::cout << QString("%1: - %2").arg(dateTime, message).toLocal8Bit().data() << '\n';
+            break;
+        }
+
+        case LogLevel::INFO: {
+            std::cout << QString("%1: %2").arg(dateTime, message).toLocal8Bit().data() << '\n';
+            break;
+        }
+
+        case LogLevel::WARNING: {
+            std::cerr << QString("%1: ** %2").arg(dateTime, message).toLocal8Bit().data() << '\n';
+            break;
+        }
+
+        case LogLevel::ERROR:
+        default: {
+            std::cerr << QString("%1: *** %2").arg(dateTime, message).toLocal8Bit().data() << '\n';
+            break;
+        }
+    }
+}
+
+/***********************************************************************************************************************
+* Functions
+*/
 
 void logWrite(const QString& message, bool error) {
-    QMutexLocker mutexLocker(&loggingMutex);
+    logMessage(error ? LogLevel::ERROR : LogLevel::INFO, message);
+}
+
 
-    QString dateTime = QDateTime::currentDateTime().toString(Qt::DateFormat::ISODate);
+void logMessage(LogLevel level, const QString& message) {
+    if (logEnabled(level)) {
+        LogWriter& writer = LogWriter::instance();
+        writer.threadRing()->append(QDateTime::currentMSecsSinceEpoch(), level, message);
 
-    if (error) {
-        QString logEntry = QString("%1: *** %2").arg(dateTime, message);
-        std::cerr << logEntry.toLocal8Bit().data() << std::endl;
+        if (level == LogLevel::ERROR) {
+            writer.wake();
+        }
+    }
+}
+
+
+bool logEnabled(LogLevel level) {
+    return static_cast<int>(level) >= minimumLogLevel.load(std::memory_order_relaxed);
+}
+
+
+void setLogLevel(LogLevel level) {
+    minimumLogLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+
+LogLevel toLogLevel(const QString& name, bool* ok) {
+    LogLevel result  = LogLevel::INFO;
+    bool     isValid = true;
+    QString  lower   = name.trimmed().toLower();
+
+    if (lower == QString("debug")) {
+        result = LogLevel::DEBUG;
+    } else if (lower == QString("info")) {
+        result = LogLevel::INFO;
+    } else if (lower == QString("warning")) {
+        result = LogLevel::WARNING;
+    } else if (lower == QString("error")) {
+        result = LogLevel::ERROR;
     } else {
-        QString logEntry = QString("%1: %2").arg(dateTime, message);
-        std::cout << logEntry.toLocal8Bit().data() << std::endl;
+        isValid = false;
+    }
 
+    if (ok != nullptr) {
+        *ok = isValid;
     }
+
+    return result;
+}
+
+
+void logFlush() {
+    LogWriter::instance().flush();
 }
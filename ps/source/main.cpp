@@ -45,5 +45,7 @@ int main(int argumentCount, char* argumentValues[]) {
         exitStatus = 1;
     }
 
+    logFlush();
+
     return exitStatus;
 }
@@ -0,0 +1,145 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref LatencyHistogram and \ref ThreadMetrics classes.
+***********************************************************************************************************************/
+
+#include <QVector>
+
+#include <atomic>
+#include <cstdint>
+
+#include "metrics.h"
+
+/***********************************************************************************************************************
+* LatencyHistogram
+*/
+
+LatencyHistogram::LatencyHistogram() {
+    for (unsigned i=0 ; i<numberBuckets ; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+
+void LatencyHistogram::addTo(Counts& counts) const {
+    if (static_cast<unsigned>(counts.size()) != numberBuckets) {
+        counts.resize(numberBuckets);
+    }
+
+    for (unsigned i=0 ; i<numberBuckets ; ++i) {
+        counts[i] += buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+
+unsigned long long LatencyHistogram::lowerBound(unsigned index) {
+    unsigned long long result;
+
+    constexpr unsigned halfSubBuckets = 1U << (subBucketBits - 1);
+    if (index < 2 * halfSubBuckets) {
+        result = index;
+    } else {
+        unsigned shift    = index / halfSubBuckets - 1;
+        unsigned subIndex = index - shift * halfSubBuckets;
+
+        result = static_cast<unsigned long long>(subIndex) << shift;
+    }
+
+    return result;
+}
+
+
+unsigned long long LatencyHistogram::upperBound(unsigned index) {
+    unsigned long long result;
+
+    constexpr unsigned halfSubBuckets = 1U << (subBucketBits - 1);
+    if (index < 2 * halfSubBuckets) {
+        result = index;
+    } else {
+        unsigned shift    = index / halfSubBuckets - 1;
+        unsigned subIndex = index - shift * halfSubBuckets;
+
+        result = (static_cast<unsigned long long>(subIndex + 1) << shift) - 1;
+    }
+
+    return result;
+}
+
+
+unsigned long long LatencyHistogram::totalCount(const Counts& counts) {
+    unsigned long long result = 0;
+    for (Counts::const_iterator it=counts.constBegin(),end=counts.constEnd() ; it!=end ; ++it) {
+        result += *it;
+    }
+
+    return result;
+}
+
+
+unsigned long long LatencyHistogram::percentile(const Counts& counts, double fraction) {
+    unsigned long long result = 0;
+    unsigned long long total  = totalCount(counts);
+
+    if (total > 0) {
+        unsigned long long target = static_cast<unsigned long long>(fraction * total + 0.5);
+        if (target < 1) {
+            target = 1;
+        } else if (target > total) {
+            target = total;
+        }
+
+        unsigned long long seen          = 0;
+        unsigned           index         = 0;
+        unsigned           numberEntries = static_cast<unsigned>(counts.size());
+        while (seen < target && index < numberEntries) {
+            seen += counts.at(index);
+            ++index;
+        }
+
+        result = upperBound(index - 1);
+    }
+
+    return result;
+}
+
+/***********************************************************************************************************************
+* ThreadMetrics
+*/
+
+ThreadMetrics::ThreadMetrics() {
+    currentRequestsStarted.store(0, std::memory_order_relaxed);
+    currentRequestsSucceeded.store(0, std::memory_order_relaxed);
+    currentRequestsFailed.store(0, std::memory_order_relaxed);
+    currentLatencySamplesExcluded.store(0, std::memory_order_relaxed);
+    currentResponsesNotModified.store(0, std::memory_order_relaxed);
+    currentRequestsCoalesced.store(0, std::memory_order_relaxed);
+    currentRepliesInFlight.store(0, std::memory_order_relaxed);
+}
+
+
+void ThreadMetrics::addTo(Totals& totals) const {
+    totals.requestsStarted        += currentRequestsStarted.load(std::memory_order_relaxed);
+    totals.requestsSucceeded      += currentRequestsSucceeded.load(std::memory_order_relaxed);
+    totals.requestsFailed         += currentRequestsFailed.load(std::memory_order_relaxed);
+    totals.latencySamplesExcluded += currentLatencySamplesExcluded.load(std::memory_order_relaxed);
+    totals.responsesNotModified   += currentResponsesNotModified.load(std::memory_order_relaxed);
+    totals.requestsCoalesced      += currentRequestsCoalesced.load(std::memory_order_relaxed);
+    totals.repliesInFlight        += currentRepliesInFlight.load(std::memory_order_relaxed);
+
+    currentLatency.addTo(totals.latency);
+}
@@ -23,24 +23,28 @@
 #include <QMap>
 #include <QWeakPointer>
 #include <QByteArray>
-#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QMutex>
 #include <QDateTime>
-#include <QCryptographicHash>
-#include <QNetworkAccessManager>
 #include <QNetworkRequest>
-#include <QNetworkReply>
-#include <QSslConfiguration>
 #include <QSslCertificate>
 
 #include <cstdint>
 #include <chrono>
+#include <atomic>
+#include <algorithm>
 
 #include <html_scrubber_hasher.h>
 
 #include "customer.h"
 #include "host_scheme.h"
+#include "http_engine.h"
 #include "data_aggregator.h"
 #include "http_service_thread.h"
+#include "event_loop_lag_probe.h"
+#include "keyword_matcher.h"
+#include "string_pool.h"
+#include "response_body_processor.h"
 #include "monitor.h"
 
 const QByteArray Monitor::defaultUserAgent("InesonicBot");
@@ -48,10 +52,18 @@ const QByteArray Monitor::defaultUserAgentHeaderString("user-agent");
 const QByteArray Monitor::textPlainContentType("text/plain");
 const QByteArray Monitor::applicationJsonContentType("application/json");
 const QByteArray Monitor::applicationXmlContentType("application/xml");
-const QByteArray Monitor::optionsVerb("OPTIONS");
-const QByteArray Monitor::patchVerb("PATCH");
-
-QMap<QByteArray, QByteArray> Monitor::currentDefaultHeaders;
+const QByteArray Monitor::entityTagHeader("ETag");
+const QByteArray Monitor::lastModifiedHeader("Last-Modified");
+const QByteArray Monitor::ifNoneMatchHeader("If-None-Match");
+const QByteArray Monitor::ifModifiedSinceHeader("If-Modified-Since");
+
+QMutex                                    Monitor::defaultHeadersMutex;
+QSharedPointer<const Monitor::RawHeaders> Monitor::currentDefaultHeaders;
+std::atomic<unsigned>                     Monitor::currentDefaultHeadersGeneration(1);
+QMutex                                    Monitor::keywordMatchersMutex;
+Monitor::KeywordMatchersByKeywords        Monitor::keywordMatchersByKeywords;
+std::atomic<bool>                         Monitor::currentConditionalRequestsEnabled(false);
+std::atomic<bool>                         Monitor::currentHeadersOnlyFetchEnabled(false);
 
 Monitor::Monitor(
         Monitor::MonitorId        monitorId,
@@ -62,38 +74,51 @@ Monitor::Monitor(
         Monitor::ContentType      contentType,
         const QString&            userAgent,
         const QByteArray&         postContent,
+        unsigned long             maximumBodySize,
         HostScheme*               hostScheme
     ):currentMonitorId(
         monitorId
     ),currentPath(
-        path
+        StringPool::intern(path)
     ),currentMethod(
         method
     ),currentContentCheckMode(
         contentCheckMode
     ),currentKeywords(
-        keywords
+        StringPool::intern(keywords)
     ),currentContentType(
         contentType
     ),currentUserAgent(
-        userAgent.toUtf8()
+        StringPool::intern(userAgent.toUtf8())
     ),currentPostContent(
-        postContent
+        StringPool::intern(postContent)
+    ),currentMaximumBodySize(
+        maximumBodySize
     ) {
-    currentMonitorStatus = MonitorStatus::UNKNOWN;
-    pendingReply         = nullptr;
+    currentMonitorStatus      = MonitorStatus::UNKNOWN;
+    pendingRequest            = nullptr;
+    bodyProcessor             = nullptr;
+    requestTemplateGeneration = 0;
+    sslSessionGeneration      = 0;
+    validatorTimestamp        = 0;
+    conditionalRequestPending = false;
+    headersOnlyCheck          = false;
+    checkCompletedAtHeaders   = false;
+
+    currentKeywordMatcher = sharedKeywordMatcher(currentKeywords);
 
     if (hostScheme != nullptr) {
         moveToThread(hostScheme->thread());
         setParent(hostScheme);
         hostScheme->monitorAdded(this);
     }
-
-    connect(this, &Monitor::startCheckRequested, this, &Monitor::startCheck);
 }
 
 
-Monitor::~Monitor() {}
+Monitor::~Monitor() {
+    delete pendingRequest;
+    delete bodyProcessor;
+}
 
 
 Monitor::MonitorStatus Monitor::monitorStatus() const {
@@ -101,6 +126,17 @@ Monitor::MonitorStatus Monitor::monitorStatus() const {
 }
 
 
+const QByteArray& Monitor::contentHash() const {
+    return lastHash;
+}
+
+
+void Monitor::restoreState(Monitor::MonitorStatus monitorStatus, const QByteArray& contentHash) {
+    currentMonitorStatus = monitorStatus;
+    lastHash             = contentHash;
+}
+
+
 Monitor::MonitorId Monitor::monitorId() const {
     return currentMonitorId;
 }
@@ -122,7 +158,8 @@ const QString& Monitor::path() const {
 
 
 void Monitor::setPath(const QString& newPath) {
-    currentPath = newPath;
+    currentPath = StringPool::intern(newPath);
+    invalidateRequestTemplate();
 }
 
 
@@ -133,6 +170,7 @@ Monitor::Method Monitor::method() const {
 
 void Monitor::setMethod(Monitor::Method newMethod) {
     currentMethod = newMethod;
+    invalidateRequestTemplate();
 }
 
 
@@ -143,6 +181,7 @@ Monitor::ContentCheckMode Monitor::contentCheckMode() const {
 
 void Monitor::setContentCheckMode(Monitor::ContentCheckMode newContentCheckMode) {
     currentContentCheckMode = newContentCheckMode;
+    clearValidators();
 }
 
 
@@ -152,7 +191,11 @@ const Monitor::KeywordList& Monitor::keywords() const {
 
 
 void Monitor::setKeywords(const Monitor::KeywordList& newKeywordList) {
-    currentKeywords = newKeywordList;
+    currentKeywords = StringPool::intern(newKeywordList);
+
+    // A pending request keeps its own reference to the old matcher so it's safe to replace the matcher here.
+
+    currentKeywordMatcher = sharedKeywordMatcher(currentKeywords);
 }
 
 
@@ -163,6 +206,7 @@ Monitor::ContentType Monitor::contentType() const {
 
 void Monitor::setContentType(Monitor::ContentType newContentType) {
     currentContentType = newContentType;
+    invalidateRequestTemplate();
 }
 
 
@@ -172,7 +216,8 @@ QString Monitor::userAgent() const {
 
 
 void Monitor::setUserAgent(const QString& newUserAgent) {
-    currentUserAgent = newUserAgent.toUtf8();
+    currentUserAgent = StringPool::intern(newUserAgent.toUtf8());
+    invalidateRequestTemplate();
 }
 
 
@@ -182,7 +227,62 @@ const QByteArray& Monitor::postContent() const {
 
 
 void Monitor::setPostContent(const QByteArray& newPostContent) {
-    currentPostContent = newPostContent;
+    currentPostContent = StringPool::intern(newPostContent);
+    invalidateRequestTemplate();
+}
+
+
+unsigned long Monitor::maximumBodySize() const {
+    return currentMaximumBodySize;
+}
+
+
+void Monitor::setMaximumBodySize(unsigned long newMaximumBodySize) {
+    currentMaximumBodySize = newMaximumBodySize;
+    clearValidators();
+}
+
+
+bool Monitor::updateFrom(const Monitor* monitor) {
+    bool contentChanged = (
+           monitor->currentPath != currentPath
+        || monitor->currentMethod != currentMethod
+        || monitor->currentContentCheckMode != currentContentCheckMode
+        || monitor->currentContentType != currentContentType
+        || monitor->currentUserAgent != currentUserAgent
+        || monitor->currentPostContent != currentPostContent
+    );
+
+    bool changed = (
+           contentChanged
+        || monitor->currentKeywords != currentKeywords
+        || monitor->currentMaximumBodySize != currentMaximumBodySize
+    );
+
+    if (contentChanged) {
+        currentPath             = monitor->currentPath;
+        currentMethod           = monitor->currentMethod;
+        currentContentCheckMode = monitor->currentContentCheckMode;
+        currentContentType      = monitor->currentContentType;
+        currentUserAgent        = monitor->currentUserAgent;
+        currentPostContent      = monitor->currentPostContent;
+
+        lastHash.clear();
+        clearValidators();
+        invalidateRequestTemplate();
+    }
+
+    if (monitor->currentKeywords != currentKeywords) {
+        setKeywords(monitor->currentKeywords);
+    }
+
+    if (monitor->currentMaximumBodySize != currentMaximumBodySize) {
+        lastHash.clear();
+        clearValidators();
+        currentMaximumBodySize = monitor->currentMaximumBodySize;
+    }
+
+    return changed;
 }
 
 
@@ -318,173 +418,339 @@ Monitor::ContentType Monitor::toContentType(const QString& str, bool* ok) {
 }
 
 
-void Monitor::startCheckFromDifferentThread() {
-    emit startCheckRequested();
-}
+void Monitor::setDefaultHeaders(const Headers& headers) {
+    RawHeaders* rawHeaders = new RawHeaders;
+    for (Headers::const_iterator it=headers.constBegin(),end=headers.constEnd() ; it!=end ; ++it) {
+        rawHeaders->insert(it.key().toLatin1(), it.value().toLatin1());
+    }
 
+    defaultHeadersMutex.lock();
+    currentDefaultHeaders.reset(rawHeaders);
+    defaultHeadersMutex.unlock();
 
-void Monitor::setDefaultHeaders(const Headers& headers) {
-    currentDefaultHeaders.clear();
+    // Bumping the generation after the headers are replaced causes every monitor to rebuild its request template on
+    // its next check.  Generation 0 is reserved to mark an invalid template.
 
-    for (Headers::const_iterator it=headers.constBegin(),end=headers.constEnd() ; it!=end ; ++it) {
-        currentDefaultHeaders.insert(it.key().toLatin1(), it.value().toLatin1());
+    if (++currentDefaultHeadersGeneration == 0) {
+        ++currentDefaultHeadersGeneration;
     }
 }
 
 
 Monitor::Headers Monitor::defaultHeaders() {
+    defaultHeadersMutex.lock();
+    QSharedPointer<const RawHeaders> rawHeaders = currentDefaultHeaders;
+    defaultHeadersMutex.unlock();
+
     Headers result;
-    for (  QMap<QByteArray, QByteArray>:: const_iterator it  = currentDefaultHeaders.constBegin(),
-                                                         end = currentDefaultHeaders.constEnd()
-         ; it != end
-         ; ++it
-        ) {
-        result.insert(QString::fromLatin1(it.key()), QString::fromLatin1(it.value()));
+    if (!rawHeaders.isNull()) {
+        for (  RawHeaders::const_iterator it = rawHeaders->constBegin(), end = rawHeaders->constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            result.insert(QString::fromLatin1(it.key()), QString::fromLatin1(it.value()));
+        }
     }
 
     return result;
 }
 
 
+void Monitor::setConditionalRequestsEnabled(bool nowEnabled) {
+    currentConditionalRequestsEnabled.store(nowEnabled, std::memory_order_relaxed);
+}
+
+
+bool Monitor::conditionalRequestsEnabled() {
+    return currentConditionalRequestsEnabled.load(std::memory_order_relaxed);
+}
+
+
+void Monitor::setHeadersOnlyFetchEnabled(bool nowEnabled) {
+    currentHeadersOnlyFetchEnabled.store(nowEnabled, std::memory_order_relaxed);
+}
+
+
+bool Monitor::headersOnlyFetchEnabled() {
+    return currentHeadersOnlyFetchEnabled.load(std::memory_order_relaxed);
+}
+
+
+QSharedPointer<const KeywordMatcher> Monitor::sharedKeywordMatcher(const KeywordList& keywords) {
+    QSharedPointer<const KeywordMatcher> result;
+
+    if (!keywords.isEmpty()) {
+        QMutexLocker locker(&keywordMatchersMutex);
+
+        result = keywordMatchersByKeywords.value(keywords).toStrongRef();
+        if (result.isNull()) {
+            // Drop entries whose matchers have been released so the table tracks only live keyword lists.
+
+            KeywordMatchersByKeywords::iterator it = keywordMatchersByKeywords.begin();
+            while (it != keywordMatchersByKeywords.end()) {
+                if (it.value().isNull()) {
+                    it = keywordMatchersByKeywords.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            result.reset(new KeywordMatcher(keywords));
+            keywordMatchersByKeywords.insert(keywords, result.toWeakRef());
+        }
+    }
+
+    return result;
+}
+
+
+void Monitor::invalidateRequestTemplate() {
+    requestTemplateGeneration = 0;
+}
+
+
 void Monitor::startCheck() {
-    if (pendingReply == nullptr) {
+    if (pendingRequest == nullptr) {
         HostScheme* hostScheme = static_cast<HostScheme*>(parent());
         if (hostScheme != nullptr) {
             Customer* customer = static_cast<Customer*>(hostScheme->parent());
             if (!customer->paused()) {
-                QUrl url = hostScheme->url();
-                url.setPath(currentPath);
-
-                if (currentMethod == Method::GET     ||
-                    currentMethod == Method::HEAD    ||
-                    currentMethod == Method::DELETE  ||
-                    currentMethod == Method::OPTIONS    ) {
-                    QNetworkRequest request(url);
-
-                    const QByteArray* userAgent = &defaultUserAgent;
-
-                    for (  QMap<QByteArray, QByteArray>::const_iterator it  = currentDefaultHeaders.constBegin(),
-                                                                        end = currentDefaultHeaders.constEnd()
-                         ; it != end
-                         ; ++it
-                        ) {
-                        if (it.key() == defaultUserAgentHeaderString) {
-                            userAgent = &it.value();
-                        } else {
-                            request.setRawHeader(it.key(), it.value());
-                        }
-                    }
+                if (requestTemplateGeneration != currentDefaultHeadersGeneration.load(std::memory_order_relaxed)) {
+                    buildRequestTemplate(hostScheme);
+                }
 
-                    request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, *userAgent);
-                    request.setHeader(QNetworkRequest::KnownHeaders::ContentLengthHeader, 0);
-
-                    startTimestamp = QDateTime::currentSecsSinceEpoch();
-                    elapsedTimer.start();
-                    if (currentMethod == Method::GET) {
-                        pendingReply = hostScheme->networkAccessManager()->get(request);
-                    } else if (currentMethod == Method::HEAD) {
-                        pendingReply = hostScheme->networkAccessManager()->head(request);
-                    } else if (currentMethod == Method::DELETE) {
-                        pendingReply = hostScheme->networkAccessManager()->deleteResource(request);
-                    } else {
-                        Q_ASSERT(currentMethod == Method::OPTIONS);
-                        pendingReply = hostScheme->networkAccessManager()->sendCustomRequest(request, optionsVerb);
-                    }
-                } else {
-                    Q_ASSERT(
-                           currentMethod == Method::POST
-                        || currentMethod == Method::PUT
-                        || currentMethod == Method::PATCH
+                // Sharing the host/scheme's configuration lets new connections resume the last TLS session.
+
+                if (sslSessionGeneration != hostScheme->sslSessionGeneration()) {
+                    currentRequestTemplate.setSslConfiguration(hostScheme->sslConfiguration());
+                    sslSessionGeneration = hostScheme->sslSessionGeneration();
+                }
+
+                HttpEngine* httpEngine = hostScheme->httpEngine();
+
+                const QByteArray* verb = nullptr;
+                switch (currentMethod) {
+                    case Method::GET:     { verb = &HttpEngine::getVerb;      break; }
+                    case Method::HEAD:    { verb = &HttpEngine::headVerb;     break; }
+                    case Method::POST:    { verb = &HttpEngine::postVerb;     break; }
+                    case Method::PUT:     { verb = &HttpEngine::putVerb;      break; }
+                    case Method::DELETE:  { verb = &HttpEngine::deleteVerb;   break; }
+                    case Method::OPTIONS: { verb = &HttpEngine::optionsVerb;  break; }
+                    case Method::PATCH:   { verb = &HttpEngine::patchVerb;    break; }
+                    default:              { Q_ASSERT(false);                  break; }
+                }
+
+                bool sendsBody = (
+                       currentMethod == Method::POST
+                    || currentMethod == Method::PUT
+                    || currentMethod == Method::PATCH
+                );
+
+                startTimestamp = QDateTime::currentSecsSinceEpoch();
+
+                conditionalRequestPending = conditionalRequestAllowed(startTimestamp);
+                checkCompletedAtHeaders   = false;
+                headersOnlyCheck          = (
+                       currentContentCheckMode == ContentCheckMode::NO_CHECK
+                    && currentHeadersOnlyFetchEnabled.load(std::memory_order_relaxed)
+                );
+
+                // The HTTP engine times the request phases itself so header events are only needed to complete a
+                // headers-only fetch.
+
+                bool reportProgress = headersOnlyCheck;
+
+                if (currentContentCheckMode != ContentCheckMode::NO_CHECK) {
+                    bodyProcessor = new ResponseBodyProcessor(
+                        currentMonitorId,
+                        currentContentCheckMode,
+                        currentKeywordMatcher,
+                        currentMaximumBodySize
                     );
+                }
 
-                    QNetworkRequest request(url);
-
-                    const QByteArray* userAgent = &defaultUserAgent;
-                    for (  QMap<QByteArray, QByteArray>::const_iterator it  = currentDefaultHeaders.constBegin(),
-                                                                        end = currentDefaultHeaders.constEnd()
-                         ; it != end
-                         ; ++it
-                        ) {
-                        if (it.key() == defaultUserAgentHeaderString) {
-                            userAgent = &it.value();
-                        } else {
-                            request.setRawHeader(it.key(), it.value());
-                        }
-                    }
+                lagProbeStartTime = EventLoopLagProbe::currentTime();
 
-                    if (currentUserAgent.isEmpty()) {
-                        request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, *userAgent);
-                    } else {
-                        request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, currentUserAgent);
+                if (conditionalRequestPending) {
+                    QNetworkRequest request = currentRequestTemplate;
+                    if (!validatorEntityTag.isEmpty()) {
+                        request.setRawHeader(ifNoneMatchHeader, validatorEntityTag);
                     }
 
-                    const QByteArray* contentType = nullptr;
-                    switch (currentContentType) {
-                        case ContentType::TEXT: { contentType = &textPlainContentType;        break; }
-                        case ContentType::JSON: { contentType = &applicationJsonContentType;  break; }
-                        case ContentType::XML:  { contentType = &applicationXmlContentType;   break; }
-                        default:                { Q_ASSERT(false);                            break; }
+                    if (!validatorLastModified.isEmpty()) {
+                        request.setRawHeader(ifModifiedSinceHeader, validatorLastModified);
                     }
 
-                    request.setHeader(QNetworkRequest::KnownHeaders::ContentTypeHeader, *contentType);
-                    request.setHeader(QNetworkRequest::KnownHeaders::ContentLengthHeader, currentPostContent.size());
-                    request.setTransferTimeout(transferTimeout);
-
-                    startTimestamp = QDateTime::currentSecsSinceEpoch();
-                    elapsedTimer.start();
-                    if (currentMethod == Method::POST) {
-                        pendingReply = hostScheme->networkAccessManager()->post(request, currentPostContent);
-                    } else if (currentMethod == Method::PUT) {
-                        pendingReply = hostScheme->networkAccessManager()->put(request, currentPostContent);
-                    } else {
-                        Q_ASSERT(currentMethod == Method::PATCH);
-                        pendingReply = hostScheme->networkAccessManager()->sendCustomRequest(
-                            request,
-                            patchVerb,
-                            currentPostContent
-                        );
-                    }
+                    pendingRequest = httpEngine->startRequest(this, request, *verb, QByteArray(), reportProgress);
+                } else {
+                    pendingRequest = httpEngine->startRequest(
+                        this,
+                        currentRequestTemplate,
+                        *verb,
+                        sendsBody ? currentPostContent : QByteArray(),
+                        reportProgress
+                    );
                 }
 
-                pendingReply->setParent(this);
-                connect(pendingReply, &QNetworkReply::finished, this, &Monitor::responseReceived);
+                static_cast<HttpServiceThread*>(thread())->threadMetrics()->requestStarted();
             }
         } else {
             lastHash.clear();
+            clearValidators();
         }
     }
 }
 
 
 void Monitor::abort() {
-    if (pendingReply != nullptr) {
-        delete pendingReply;
+    if (pendingRequest != nullptr) {
+        if (!checkCompletedAtHeaders) {
+            static_cast<HttpServiceThread*>(thread())->threadMetrics()->requestAbandoned();
+        }
+
+        delete pendingRequest;
+        pendingRequest = nullptr;
     }
 
+    delete bodyProcessor;
+    bodyProcessor = nullptr;
+
     currentMonitorStatus = MonitorStatus::UNKNOWN;
 }
 
 
-void Monitor::responseReceived() {
-    unsigned long long          elapsedNanoseconds = elapsedTimer.nsecsElapsed();
-    QNetworkReply::NetworkError networkError       = pendingReply->error();
+void Monitor::cancelCheck() {
+    if (pendingRequest != nullptr) {
+        if (!checkCompletedAtHeaders) {
+            static_cast<HttpServiceThread*>(thread())->threadMetrics()->requestAbandoned();
+        }
 
-    pendingReply->deleteLater();
+        delete pendingRequest;
+        pendingRequest = nullptr;
+    }
+
+    delete bodyProcessor;
+    bodyProcessor = nullptr;
+}
 
-    if (networkError == QNetworkReply::NetworkError::NoError) {
-        QSslConfiguration sslConfiguration = pendingReply->sslConfiguration();
-        processValidResponse(elapsedNanoseconds, sslConfiguration);
+
+void Monitor::requestConnected(HttpEngine::Request*) {}
+
+
+void Monitor::requestHeadersReceived(HttpEngine::Request* request) {
+    // Error responses are left to complete normally so the HTTP engine can supply the error description.
+
+    int statusCode = request->statusCode();
+    if (headersOnlyCheck && !checkCompletedAtHeaders && statusCode > 0 && statusCode < firstErrorStatusCode) {
+        unsigned long long elapsedNanoseconds = request->phaseTimes().firstByteNanoseconds;
+        if (elapsedNanoseconds == 0) {
+            elapsedNanoseconds = request->elapsedNanoseconds();
+        }
+
+        bool latencyValid = recordRequestSucceeded(elapsedNanoseconds);
+
+        checkCompletedAtHeaders = true;
+        processValidResponse(elapsedNanoseconds, request, latencyValid);
+
+        // Aborting closes the connection so we only abort when the rest of the body is likely to cost more than
+        // reconnecting on the next check.  Smaller bodies are drained and discarded by readResponseData.
+
+        long long contentLength = request->contentLength();
+        if (contentLength < 0 || contentLength > maximumDrainedBodySize) {
+            delete pendingRequest;
+
+            pendingRequest          = nullptr;
+            checkCompletedAtHeaders = false;
+        }
+    }
+}
+
+
+void Monitor::requestDataAvailable(HttpEngine::Request*) {
+    readResponseData();
+}
+
+
+void Monitor::requestFinished(HttpEngine::Request* request) {
+    unsigned long long elapsedNanoseconds = request->phaseTimes().completedNanoseconds;
+    ThreadMetrics*     threadMetrics      = static_cast<HttpServiceThread*>(thread())->threadMetrics();
+
+    if (elapsedNanoseconds == 0) {
+        elapsedNanoseconds = request->elapsedNanoseconds();
+    }
+
+    // Headers-only checks are completed when the headers arrive; after that we're only draining the body.
+
+    if (!checkCompletedAtHeaders) {
+        if (!request->failed()) {
+            bool latencyValid = recordRequestSucceeded(elapsedNanoseconds);
+
+            readResponseData();
+
+            // A 304 response to a conditional request means the content behind our last hash is unchanged so there's
+            // nothing to check.
+
+            if (conditionalRequestPending && request->statusCode() == notModifiedStatusCode) {
+                threadMetrics->responseNotModified();
+
+                delete bodyProcessor;
+                bodyProcessor = nullptr;
+            } else {
+                updateValidators();
+            }
+
+            processValidResponse(elapsedNanoseconds, request, latencyValid);
+        } else {
+            threadMetrics->requestFailed();
+            processErrorResponse();
+        }
+    }
+
+    delete bodyProcessor;
+    bodyProcessor = nullptr;
+
+    delete pendingRequest;
+
+    pendingRequest          = nullptr;
+    checkCompletedAtHeaders = false;
+}
+
+
+void Monitor::readResponseData() {
+    // Data is always read, even if it will be discarded, so the HTTP engine's read buffer never fills.
+
+    QByteArray data = pendingRequest->readAll();
+    if (bodyProcessor != nullptr) {
+        bodyProcessor->addData(data);
+    }
+}
+
+
+bool Monitor::recordRequestSucceeded(unsigned long long elapsedTimeNanoseconds) {
+    // If this thread's event loop was saturated while the request was in flight, our backlog may have been charged
+    // to the customer.  The native engine takes the response times from kernel receive timestamps so lag after the
+    // data arrives is not counted, but lag can still delay the steps we drive ourselves, such as sending the request
+    // once the connection is up, and the Qt engine only timestamps events when they're delivered.  Lag can not be
+    // separated from the remote host's time so affected samples are dropped rather than corrected.
+
+    HttpServiceThread* serviceThread = static_cast<HttpServiceThread*>(thread());
+    ThreadMetrics*     threadMetrics = serviceThread->threadMetrics();
+    bool               latencyValid  = !serviceThread->eventLoopLagProbe()->laggedSince(lagProbeStartTime);
+
+    if (latencyValid) {
+        threadMetrics->requestSucceeded((elapsedTimeNanoseconds + 500) / 1000);
     } else {
-        processErrorResponse();
+        threadMetrics->requestSucceededWithoutLatency();
     }
 
-    pendingReply = nullptr;
+    return latencyValid;
 }
 
 
 void Monitor::processValidResponse(
-        unsigned long long       elapsedTimeNanoseconds,
-        const QSslConfiguration& sslConfiguration
+        unsigned long long   elapsedTimeNanoseconds,
+        HttpEngine::Request* request,
+        bool                 latencyValid
     ) {
     HttpServiceThread* serviceThread  = static_cast<HttpServiceThread*>(thread());
     DataAggregator*    dataAggregator = serviceThread->dataAggregator();
@@ -502,39 +768,82 @@ void Monitor::processValidResponse(
 
     currentMonitorStatus = MonitorStatus::WORKING;
 
-    if (currentContentCheckMode != ContentCheckMode::NO_CHECK) {
-        QByteArray receivedData = pendingReply->readAll();
-
+    if (bodyProcessor != nullptr) {
         if (currentContentCheckMode == ContentCheckMode::CONTENT_MATCH) {
-            checkContentChange(receivedData);
+            checkContentChange(*bodyProcessor);
         } else if (currentContentCheckMode == ContentCheckMode::ANY_KEYWORDS) {
-            checkAnyKeywordMatch(receivedData);
+            checkAnyKeywordMatch(*bodyProcessor);
         } else if (currentContentCheckMode == ContentCheckMode::ALL_KEYWORDS) {
-            checkAllKeywordMatch(receivedData);
+            checkAllKeywordMatch(*bodyProcessor);
         } else if (currentContentCheckMode == ContentCheckMode::SMART_CONTENT_MATCH) {
-            checkContentChangeSmart(receivedData);
+            checkContentChangeSmart(*bodyProcessor);
         } else {
             Q_ASSERT(false); // Unexpected content check mode.
         }
     }
 
     Customer* customer = hostScheme()->customer();
-    if (customer->supportsLatencyMeasurements()) {
+    if (latencyValid && customer->supportsLatencyMeasurements()) {
         unsigned long elapsedTimeMicroseconds = static_cast<unsigned long>((elapsedTimeNanoseconds + 500) / 1000);
         if (elapsedTimeMicroseconds <= maximumAllowedLatencyMicroseconds) {
-            dataAggregator->recordLatency(currentMonitorId, startTimestamp, elapsedTimeMicroseconds);
+            DataAggregator::LatencyPhases phases;
+            if (customer->supportsLatencyPhases()) {
+                // Phases the engine did not observe, such as DNS and connection setup on a reused connection, are
+                // reported as 0 with their time folded into the next phase that was observed.  Without response
+                // headers, which should not happen, the remainder of the request is treated as waiting.  Times are
+                // clamped to the total since the engine mixes socket and event loop timestamps.
+
+                HttpEngine::PhaseTimes phaseTimes    = request->phaseTimes();
+                unsigned long long     total         = elapsedTimeNanoseconds;
+                unsigned long long     resolvedTime  = std::min(phaseTimes.resolvedNanoseconds, total);
+                unsigned long long     connectedTime = std::min(
+                    std::max(phaseTimes.connectedNanoseconds, resolvedTime),
+                    total
+                );
+                unsigned long long     handshakeTime = std::min(
+                    std::max(phaseTimes.handshakeNanoseconds, connectedTime),
+                    total
+                );
+                unsigned long long     headersTime   = (
+                      phaseTimes.firstByteNanoseconds != 0
+                    ? std::min(std::max(phaseTimes.firstByteNanoseconds, handshakeTime), total)
+                    : total
+                );
+
+                phases = DataAggregator::LatencyPhases(
+                    toMicroseconds(resolvedTime),
+                    toMicroseconds(connectedTime - resolvedTime),
+                    toMicroseconds(handshakeTime - connectedTime),
+                    toMicroseconds(headersTime - handshakeTime),
+                    toMicroseconds(total - headersTime)
+                );
+            }
+
+            dataAggregator->recordLatency(
+                serviceThread->latencyRing(),
+                currentMonitorId,
+                startTimestamp,
+                elapsedTimeMicroseconds,
+                phases,
+                customer->supportsLatencyAggregation()
+            );
         }
     }
 
-    if (!sslConfiguration.isNull()) {
-        QSslCertificate   certificate = sslConfiguration.peerCertificate();
+    // The certificate can only change when a new TLS session is negotiated so reused connections skip the
+    // inspection, apart from an occasional check in case a handshake went unreported.
 
-        if (!certificate.isNull()) {
-            QDateTime certificateExpirationDateTime = certificate.expiryDate();
+    HostScheme* hostScheme = static_cast<HostScheme*>(parent());
+    if (hostScheme != nullptr) {
+        bool newHandshake = request->newHandshake();
+        if (newHandshake) {
+            hostScheme->updateSslSession(request->sslSessionTicket());
+        }
 
-            HostScheme* hostScheme = static_cast<HostScheme*>(parent());
-            if (hostScheme != nullptr) {
-                unsigned long long newExpirationTimestamp = certificateExpirationDateTime.toSecsSinceEpoch();
+        if (hostScheme->certificateCheckNeeded(newHandshake, startTimestamp)) {
+            QSslCertificate peerCertificate = request->peerCertificate();
+            if (!peerCertificate.isNull()) {
+                unsigned long long newExpirationTimestamp = peerCertificate.expiryDate().toSecsSinceEpoch();
                 unsigned long long oldExpirationTimestamp = hostScheme->sslExpirationTimestamp();
 
                 if (oldExpirationTimestamp != newExpirationTimestamp) {
@@ -552,7 +861,7 @@ void Monitor::processValidResponse(
 
 void Monitor::processErrorResponse() {
     if (currentMonitorStatus != MonitorStatus::FAILED) {
-        QString            errorMessage   = pendingReply->errorString();
+        QString            errorMessage   = pendingRequest->errorString();
 
         HttpServiceThread* serviceThread  = static_cast<HttpServiceThread*>(thread());
         DataAggregator*    dataAggregator = serviceThread->dataAggregator();
@@ -573,15 +882,121 @@ void Monitor::processErrorResponse() {
 }
 
 
-void Monitor::checkContentChange(const QByteArray& receivedData) {
-    QCryptographicHash hash(QCryptographicHash::Algorithm::Sha256);
-    hash.addData(reinterpret_cast<const char*>(&currentMonitorId), sizeof(MonitorId));
-    hash.addData(receivedData);
+void Monitor::buildRequestTemplate(const HostScheme* hostScheme) {
+    // The generation is read before the headers so a concurrent header change forces another rebuild.
+
+    unsigned generation = currentDefaultHeadersGeneration.load();
+
+    defaultHeadersMutex.lock();
+    QSharedPointer<const RawHeaders> rawHeaders = currentDefaultHeaders;
+    defaultHeadersMutex.unlock();
 
+    QUrl url = hostScheme->url();
+    url.setPath(currentPath);
+
+    QNetworkRequest request(url);
+
+    const QByteArray* userAgent = &defaultUserAgent;
+    if (!rawHeaders.isNull()) {
+        for (  RawHeaders::const_iterator it = rawHeaders->constBegin(), end = rawHeaders->constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            if (it.key() == defaultUserAgentHeaderString) {
+                userAgent = &it.value();
+            } else {
+                request.setRawHeader(it.key(), it.value());
+            }
+        }
+    }
+
+    if (currentMethod == Method::GET     ||
+        currentMethod == Method::HEAD    ||
+        currentMethod == Method::DELETE  ||
+        currentMethod == Method::OPTIONS    ) {
+        request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, *userAgent);
+        request.setHeader(QNetworkRequest::KnownHeaders::ContentLengthHeader, 0);
+    } else {
+        Q_ASSERT(
+               currentMethod == Method::POST
+            || currentMethod == Method::PUT
+            || currentMethod == Method::PATCH
+        );
+
+        if (currentUserAgent.isEmpty()) {
+            request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, *userAgent);
+        } else {
+            request.setHeader(QNetworkRequest::KnownHeaders::UserAgentHeader, currentUserAgent);
+        }
+
+        const QByteArray* contentType = nullptr;
+        switch (currentContentType) {
+            case ContentType::TEXT: { contentType = &textPlainContentType;        break; }
+            case ContentType::JSON: { contentType = &applicationJsonContentType;  break; }
+            case ContentType::XML:  { contentType = &applicationXmlContentType;   break; }
+            default:                { Q_ASSERT(false);                            break; }
+        }
+
+        request.setHeader(QNetworkRequest::KnownHeaders::ContentTypeHeader, *contentType);
+        request.setHeader(QNetworkRequest::KnownHeaders::ContentLengthHeader, currentPostContent.size());
+        request.setTransferTimeout(transferTimeout);
+    }
+
+    currentRequestTemplate    = request;
+    requestTemplateGeneration = generation;
+    sslSessionGeneration      = 0;
+
+    // Validators describe the response to the old request which may differ from the response to the new one.
+
+    clearValidators();
+}
+
+
+bool Monitor::conditionalRequestAllowed(unsigned long long now) const {
+    return (
+           currentConditionalRequestsEnabled.load(std::memory_order_relaxed)
+        && currentMethod == Method::GET
+        && (   currentContentCheckMode == ContentCheckMode::CONTENT_MATCH
+            || currentContentCheckMode == ContentCheckMode::SMART_CONTENT_MATCH
+           )
+        && !lastHash.isEmpty()
+        && (!validatorEntityTag.isEmpty() || !validatorLastModified.isEmpty())
+        && now < validatorTimestamp + conditionalRefreshSeconds
+    );
+}
+
+
+void Monitor::updateValidators() {
+    bool conditionalMonitor = (
+           currentConditionalRequestsEnabled.load(std::memory_order_relaxed)
+        && currentMethod == Method::GET
+        && (   currentContentCheckMode == ContentCheckMode::CONTENT_MATCH
+            || currentContentCheckMode == ContentCheckMode::SMART_CONTENT_MATCH
+           )
+    );
+
+    if (conditionalMonitor) {
+        validatorEntityTag    = pendingRequest->rawHeader(entityTagHeader);
+        validatorLastModified = pendingRequest->rawHeader(lastModifiedHeader);
+        validatorTimestamp    = startTimestamp;
+    } else {
+        clearValidators();
+    }
+}
+
+
+void Monitor::clearValidators() {
+    validatorEntityTag.clear();
+    validatorLastModified.clear();
+    validatorTimestamp = 0;
+}
+
+
+void Monitor::checkContentChange(const ResponseBodyProcessor& bodyProcessor) {
     if (lastHash.isEmpty()) {
-        lastHash = hash.result();
+        lastHash = bodyProcessor.hashResult();
     } else {
-        QByteArray thisHash = hash.result();
+        QByteArray thisHash = bodyProcessor.hashResult();
         if (lastHash != thisHash) {
             HttpServiceThread* serviceThread  = static_cast<HttpServiceThread*>(thread());
             DataAggregator*    dataAggregator = serviceThread->dataAggregator();
@@ -600,25 +1015,20 @@ void Monitor::checkContentChange(const QByteArray& receivedData) {
 }
 
 
-void Monitor::checkAnyKeywordMatch(const QByteArray& receivedData) {
-    unsigned numberKeywords = static_cast<unsigned>(currentKeywords.size());
+void Monitor::checkAnyKeywordMatch(ResponseBodyProcessor& bodyProcessor) {
+    unsigned numberKeywords = bodyProcessor.numberKeywords();
     if (numberKeywords > 0) {
-        QCryptographicHash hash(QCryptographicHash::Algorithm::Sha256);
-        hash.addData(reinterpret_cast<const char*>(&currentMonitorId), sizeof(MonitorId));
-        hash.addData(receivedData);
-
         bool     success = false;
         unsigned i       = 0;
         do {
-            const QByteArray& keyword = currentKeywords.at(i);
-            success = receivedData.contains(keyword);
+            success = bodyProcessor.keywordFound(i);
             if (success) {
-                hash.addData(keyword);
+                bodyProcessor.addHashData(currentKeywords.at(i));
             }
             ++i;
         } while (!success && i < numberKeywords);
 
-        QByteArray thisHash = hash.result();
+        QByteArray thisHash = bodyProcessor.hashResult();
 
         if (!success && lastHash != thisHash) {
             HttpServiceThread* serviceThread  = static_cast<HttpServiceThread*>(thread());
@@ -638,28 +1048,23 @@ void Monitor::checkAnyKeywordMatch(const QByteArray& receivedData) {
 }
 
 
-void Monitor::checkAllKeywordMatch(const QByteArray& receivedData) {
-    unsigned numberKeywords = static_cast<unsigned>(currentKeywords.size());
+void Monitor::checkAllKeywordMatch(ResponseBodyProcessor& bodyProcessor) {
+    unsigned numberKeywords = bodyProcessor.numberKeywords();
     if (numberKeywords > 0) {
-        QCryptographicHash hash(QCryptographicHash::Algorithm::Sha256);
-        hash.addData(reinterpret_cast<const char*>(&currentMonitorId), sizeof(MonitorId));
-        hash.addData(receivedData);
-
         bool     success = true;
         QString  missingKeyword;
         unsigned i       = 0;
         do {
-            const QByteArray& keyword = currentKeywords.at(i);
-            success = receivedData.contains(keyword);
+            success = bodyProcessor.keywordFound(i);
             if (success) {
-                hash.addData(keyword);
+                bodyProcessor.addHashData(currentKeywords.at(i));
                 ++i;
             } else {
                 missingKeyword = QString::fromUtf8(currentKeywords.at(i));
             }
         } while (success && i < numberKeywords);
 
-        QByteArray thisHash = hash.result();
+        QByteArray thisHash = bodyProcessor.hashResult();
 
         if (!success && lastHash != thisHash) {
             HttpServiceThread* serviceThread  = static_cast<HttpServiceThread*>(thread());
@@ -680,8 +1085,8 @@ void Monitor::checkAllKeywordMatch(const QByteArray& receivedData) {
 }
 
 
-void Monitor::checkContentChangeSmart(const QByteArray& receivedData) {
-    HtmlScrubber::Hasher hasher(receivedData, HtmlScrubber::Hasher::Algorithm::Sha256);
+void Monitor::checkContentChangeSmart(const ResponseBodyProcessor& bodyProcessor) {
+    HtmlScrubber::Hasher hasher(bodyProcessor.bufferedData(), HtmlScrubber::Hasher::Algorithm::Sha256);
     hasher.scrubAndHash();
     hasher.addData(reinterpret_cast<const char*>(&currentMonitorId), sizeof(MonitorId));
 
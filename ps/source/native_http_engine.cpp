@@ -0,0 +1,1599 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref NativeHttpEngine class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QUrl>
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QAbstractSocket>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QNetworkRequest>
+#include <QSslCertificate>
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "log.h"
+#include "dns_cache.h"
+#include "http_engine.h"
+#include "native_http_engine.h"
+
+/***********************************************************************************************************************
+* NativeHttpEngine::Connection
+*/
+
+NativeHttpEngine::Connection::Connection(
+        NativeHttpEngine* engine,
+        const QString&    key
+    ):engine(
+        engine
+    ),key(
+        key
+    ) {
+    socketDescriptor = -1;
+    ssl              = nullptr;
+    state            = ConnectionState::CONNECTING;
+    registeredEvents = 0;
+    request          = nullptr;
+    outboundOffset   = 0;
+    idleSince        = 0;
+    receiveTime      = 0;
+    reused           = false;
+    closed           = false;
+}
+
+
+NativeHttpEngine::Connection::~Connection() {}
+
+/***********************************************************************************************************************
+* NativeHttpEngine::NativeRequest
+*/
+
+NativeHttpEngine::NativeRequest::NativeRequest(
+        NativeHttpEngine*      engine,
+        HttpEngine::Client*    client,
+        const QNetworkRequest& request,
+        const QByteArray&      verb,
+        const QByteArray&      body,
+        bool                   reportProgress
+    ):Request(
+        client
+    ),engine(
+        engine
+    ),url(
+        request.url()
+    ),verb(
+        verb
+    ),requestBody(
+        body
+    ),reportProgress(
+        reportProgress
+    ) {
+    QList<QByteArray> headerNames = request.rawHeaderList();
+    for (  QList<QByteArray>::const_iterator it = headerNames.constBegin(), end = headerNames.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        requestHeaders.append(Header(*it, request.rawHeader(*it)));
+    }
+
+    int timeout = request.transferTimeout();
+
+    connection          = nullptr;
+    transferTimeout     = timeout > 0 ? static_cast<unsigned long long>(timeout) : defaultTransferTimeout;
+    lastActivity        = 0;
+    redirectsRemaining  = maximumRedirects;
+    retried             = false;
+    responseStarted     = false;
+    responseReceiveTime = 0;
+    responseState       = ResponseState::HEADERS;
+    responseStatusCode  = 0;
+    bodyRemaining       = 0;
+    keepAlive           = false;
+    redirecting         = false;
+    handshakePerformed  = false;
+    currentFailed       = false;
+}
+
+
+NativeHttpEngine::NativeRequest::~NativeRequest() {
+    engine->requestDestroyed(this);
+}
+
+
+int NativeHttpEngine::NativeRequest::statusCode() const {
+    return responseStatusCode;
+}
+
+
+QByteArray NativeHttpEngine::NativeRequest::rawHeader(const QByteArray& headerName) const {
+    return findHeader(responseHeaders, headerName.toLower());
+}
+
+
+long long NativeHttpEngine::NativeRequest::contentLength() const {
+    bool      contentLengthKnown;
+    long long result = findHeader(responseHeaders, QByteArray("content-length")).toLongLong(&contentLengthKnown);
+
+    return contentLengthKnown ? result : -1;
+}
+
+
+QByteArray NativeHttpEngine::NativeRequest::readAll() {
+    QByteArray result;
+    result.swap(responseBody);
+
+    return result;
+}
+
+
+bool NativeHttpEngine::NativeRequest::failed() const {
+    return currentFailed;
+}
+
+
+QString NativeHttpEngine::NativeRequest::errorString() const {
+    return currentErrorString;
+}
+
+
+QSslCertificate NativeHttpEngine::NativeRequest::peerCertificate() const {
+    return currentPeerCertificate;
+}
+
+
+bool NativeHttpEngine::NativeRequest::newHandshake() const {
+    return handshakePerformed;
+}
+
+
+QByteArray NativeHttpEngine::NativeRequest::sslSessionTicket() const {
+    // Sessions are cached by the engine, keyed by scheme, host and port.
+    return QByteArray();
+}
+
+/***********************************************************************************************************************
+* NativeHttpEngine
+*/
+
+NativeHttpEngine::NativeHttpEngine(DnsCache* dnsCache, QObject* parent):QObject(parent) {
+    currentDnsCache = dnsCache;
+    notifier        = nullptr;
+
+    // OpenSSL writes to the socket itself so we can't pass MSG_NOSIGNAL on every write.  A write to a connection the
+    // remote host has reset must report EPIPE rather than terminate the process.
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    epollDescriptor = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollDescriptor >= 0) {
+        notifier = new QSocketNotifier(epollDescriptor, QSocketNotifier::Type::Read, this);
+        connect(notifier, SIGNAL(activated(int)), this, SLOT(processEvents()));
+    } else {
+        logWrite(
+            QString("Could not create epoll instance: %1").arg(QString::fromLocal8Bit(std::strerror(errno))),
+            true
+        );
+    }
+
+    sslContext = SSL_CTX_new(TLS_client_method());
+    if (sslContext != nullptr) {
+        SSL_CTX_set_min_proto_version(sslContext, TLS1_2_VERSION);
+        SSL_CTX_set_default_verify_paths(sslContext);
+        SSL_CTX_set_verify(sslContext, SSL_VERIFY_PEER, nullptr);
+        SSL_CTX_set_mode(sslContext, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+        // Sessions are cached by the engine, keyed by host, so each connection can offer the session last
+        // negotiated with its host.
+
+        SSL_CTX_set_session_cache_mode(sslContext, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(sslContext, &NativeHttpEngine::newSessionCallback);
+    } else {
+        logWrite(QString("Could not create TLS context for the native HTTP engine."), true);
+    }
+
+    startTimer = new QTimer(this);
+    startTimer->setSingleShot(true);
+    startTimer->setInterval(0);
+
+    pendingReadTimer = new QTimer(this);
+    pendingReadTimer->setSingleShot(true);
+    pendingReadTimer->setInterval(0);
+
+    reapTimer = new QTimer(this);
+    reapTimer->setSingleShot(true);
+    reapTimer->setInterval(0);
+
+    sweepTimer = new QTimer(this);
+    sweepTimer->setInterval(sweepInterval);
+
+    connect(startTimer, &QTimer::timeout, this, &NativeHttpEngine::processStartQueue);
+    connect(pendingReadTimer, &QTimer::timeout, this, &NativeHttpEngine::processPendingReads);
+    connect(reapTimer, &QTimer::timeout, this, &NativeHttpEngine::reapConnections);
+    connect(sweepTimer, &QTimer::timeout, this, &NativeHttpEngine::sweep);
+
+    clock.start();
+}
+
+
+NativeHttpEngine::~NativeHttpEngine() {
+    for (  QHash<int, QString>::const_iterator it  = hostNamesByLookupId.constBegin(),
+                                               end = hostNamesByLookupId.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        QHostInfo::abortHostLookup(it.key());
+    }
+
+    ConnectionList openConnections = connections.values();
+    for (  ConnectionList::const_iterator it = openConnections.constBegin(), end = openConnections.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        closeConnection(*it);
+    }
+
+    reapConnections();
+
+    for (  QHash<QString, SSL_SESSION*>::const_iterator it = sessionsByKey.constBegin(), end = sessionsByKey.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        SSL_SESSION_free(it.value());
+    }
+
+    if (sslContext != nullptr) {
+        SSL_CTX_free(sslContext);
+    }
+
+    delete notifier;
+
+    if (epollDescriptor >= 0) {
+        ::close(epollDescriptor);
+    }
+}
+
+
+bool NativeHttpEngine::isValid() const {
+    return epollDescriptor >= 0 && sslContext != nullptr;
+}
+
+
+HttpEngine::Backend NativeHttpEngine::backend() const {
+    return Backend::NATIVE;
+}
+
+
+HttpEngine::Request* NativeHttpEngine::startRequest(
+        HttpEngine::Client*    client,
+        const QNetworkRequest& request,
+        const QByteArray&      verb,
+        const QByteArray&      body,
+        bool                   reportProgress
+    ) {
+    NativeRequest* result = new NativeRequest(this, client, request, verb, body, reportProgress);
+
+    // Dispatch is deferred so failures, such as an unsupported scheme, are never reported before the caller has the
+    // request.
+
+    result->lastActivity = currentTime();
+    activeRequests.insert(result);
+    startQueue.append(result);
+
+    startTimer->start();
+    startSweeping();
+
+    return result;
+}
+
+
+void NativeHttpEngine::processEvents() {
+    struct epoll_event events[maximumEvents];
+
+    int numberEvents = ::epoll_wait(epollDescriptor, events, maximumEvents, 0);
+    for (int i=0 ; i<numberEvents ; ++i) {
+        Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+        unsigned    triggered  = events[i].events;
+
+        // Connections closed while processing an earlier event are not deleted until we return to the event loop.
+
+        if (!connection->closed) {
+            switch (connection->state) {
+                case ConnectionState::CONNECTING: {
+                    connectCompleted(connection);
+                    break;
+                }
+
+                case ConnectionState::HANDSHAKING: {
+                    continueHandshake(connection);
+                    break;
+                }
+
+                case ConnectionState::OPEN: {
+                    if ((triggered & EPOLLOUT) != 0 && !connection->outbound.isEmpty()) {
+                        flushOutbound(connection);
+                    }
+
+                    if (!connection->closed && (triggered & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) != 0) {
+                        connectionReadable(connection);
+                    }
+
+                    break;
+                }
+
+                default: {
+                    Q_ASSERT(false);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+void NativeHttpEngine::processStartQueue() {
+    while (!startQueue.isEmpty()) {
+        beginRequest(startQueue.takeFirst());
+    }
+}
+
+
+void NativeHttpEngine::processPendingReads() {
+    while (!pendingReadConnections.isEmpty()) {
+        Connection* connection = pendingReadConnections.takeFirst();
+        if (!connection->closed) {
+            connectionReadable(connection);
+        }
+    }
+}
+
+
+void NativeHttpEngine::hostLookedUp(const QHostInfo& hostInfo) {
+    QString hostName = hostNamesByLookupId.take(hostInfo.lookupId());
+
+    QHostAddress address;
+    bool         resolved = hostInfo.error() == QHostInfo::HostInfoError::NoError && !hostInfo.addresses().isEmpty();
+    if (resolved) {
+        address = hostInfo.addresses().first();
+    }
+
+    // The waiting list is consumed one entry at a time because a client may delete other waiting requests from
+    // within a callback.
+
+    QHash<QString, QList<NativeRequest*>>::iterator it = requestsAwaitingLookup.find(hostName);
+    while (it != requestsAwaitingLookup.end() && !it.value().isEmpty()) {
+        NativeRequest* request = it.value().takeFirst();
+        request->awaitingLookup.clear();
+
+        if (resolved) {
+            request->recordResolved();
+            connectTo(request, address);
+        } else {
+            failRequest(request, QString("Host %1 not found").arg(hostName));
+        }
+
+        it = requestsAwaitingLookup.find(hostName);
+    }
+
+    requestsAwaitingLookup.remove(hostName);
+}
+
+
+void NativeHttpEngine::sweep() {
+    unsigned long long now = currentTime();
+
+    QList<NativeRequest*> expiredRequests;
+    for (  QSet<NativeRequest*>::const_iterator it = activeRequests.constBegin(), end = activeRequests.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        NativeRequest* request = *it;
+        if (now > request->lastActivity + request->transferTimeout) {
+            expiredRequests.append(request);
+        }
+    }
+
+    for (  QList<NativeRequest*>::const_iterator it = expiredRequests.constBegin(), end = expiredRequests.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        if (activeRequests.contains(*it)) {
+            startQueue.removeOne(*it);
+            failRequest(*it, QString("Socket operation timed out"));
+        }
+    }
+
+    ConnectionList expiredConnections;
+    for (  QHash<QString, ConnectionList>::const_iterator it  = idleConnectionsByKey.constBegin(),
+                                                          end = idleConnectionsByKey.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        const ConnectionList& idleConnections = it.value();
+        for (  ConnectionList::const_iterator connectionIterator = idleConnections.constBegin(),
+                                              connectionEnd      = idleConnections.constEnd()
+             ; connectionIterator != connectionEnd
+             ; ++connectionIterator
+            ) {
+            if (now > (*connectionIterator)->idleSince + idleConnectionTimeout) {
+                expiredConnections.append(*connectionIterator);
+            }
+        }
+    }
+
+    for (  ConnectionList::const_iterator it = expiredConnections.constBegin(), end = expiredConnections.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        closeConnection(*it);
+    }
+
+    if (activeRequests.isEmpty() && idleConnectionsByKey.isEmpty()) {
+        sweepTimer->stop();
+    }
+}
+
+
+void NativeHttpEngine::reapConnections() {
+    ConnectionList reaped;
+    reaped.swap(deadConnections);
+
+    for (ConnectionList::const_iterator it=reaped.constBegin(),end=reaped.constEnd() ; it!=end ; ++it) {
+        delete *it;
+    }
+}
+
+
+int NativeHttpEngine::newSessionCallback(SSL* ssl, SSL_SESSION* session) {
+    Connection* connection = static_cast<Connection*>(SSL_get_app_data(ssl));
+    connection->engine->storeSession(connection->key, session);
+
+    return 1;
+}
+
+
+unsigned long long NativeHttpEngine::currentTime() const {
+    return static_cast<unsigned long long>(clock.elapsed());
+}
+
+
+void NativeHttpEngine::beginRequest(NativeHttpEngine::NativeRequest* request, bool allowPooled) {
+    QString scheme = request->url.scheme().toLower();
+    bool    secure = (scheme == QString("https"));
+
+    if (!secure && scheme != QString("http")) {
+        failRequest(request, QString("Protocol \"%1\" is unknown").arg(scheme));
+    } else {
+        QString hostName = request->url.host();
+        QString key      = QString("%1://%2:%3").arg(scheme, hostName).arg(request->url.port(secure ? 443 : 80));
+
+        request->lastActivity        = currentTime();
+        request->responseStarted     = false;
+        request->responseReceiveTime = 0;
+        request->responseState       = ResponseState::HEADERS;
+
+        QHash<QString, ConnectionList>::iterator it = idleConnectionsByKey.find(key);
+        if (allowPooled && it != idleConnectionsByKey.end()) {
+            Connection* connection = it.value().takeLast();
+            if (it.value().isEmpty()) {
+                idleConnectionsByKey.erase(it);
+            }
+
+            attach(request, connection);
+            sendRequest(connection);
+        } else {
+            QHostAddress address;
+            if (address.setAddress(hostName)) {
+                connectTo(request, address);
+            } else if (currentDnsCache != nullptr && currentDnsCache->lookup(hostName, address)) {
+                request->recordResolved();
+                connectTo(request, address);
+            } else if (currentDnsCache != nullptr && currentDnsCache->isUnresolvable(hostName)) {
+                failRequest(request, QString("Host %1 not found").arg(hostName));
+            } else {
+                QList<NativeRequest*>& waitingRequests = requestsAwaitingLookup[hostName];
+                if (waitingRequests.isEmpty()) {
+                    int lookupId = QHostInfo::lookupHost(hostName, this, SLOT(hostLookedUp(QHostInfo)));
+                    hostNamesByLookupId.insert(lookupId, hostName);
+                }
+
+                waitingRequests.append(request);
+                request->awaitingLookup = hostName;
+            }
+        }
+    }
+}
+
+
+void NativeHttpEngine::connectTo(NativeHttpEngine::NativeRequest* request, const QHostAddress& address) {
+    QString scheme = request->url.scheme().toLower();
+    bool    secure = (scheme == QString("https"));
+    quint16 port   = static_cast<quint16>(request->url.port(secure ? 443 : 80));
+
+    struct sockaddr_storage socketAddress;
+    socklen_t               socketAddressLength;
+
+    std::memset(&socketAddress, 0, sizeof(socketAddress));
+    if (address.protocol() == QAbstractSocket::NetworkLayerProtocol::IPv6Protocol) {
+        struct sockaddr_in6* ipv6Address = reinterpret_cast<struct sockaddr_in6*>(&socketAddress);
+        Q_IPV6ADDR           ipv6        = address.toIPv6Address();
+
+        ipv6Address->sin6_family = AF_INET6;
+        ipv6Address->sin6_port   = htons(port);
+        std::memcpy(&ipv6Address->sin6_addr, &ipv6, sizeof(ipv6Address->sin6_addr));
+
+        socketAddressLength = sizeof(struct sockaddr_in6);
+    } else {
+        struct sockaddr_in* ipv4Address = reinterpret_cast<struct sockaddr_in*>(&socketAddress);
+
+        ipv4Address->sin_family      = AF_INET;
+        ipv4Address->sin_port        = htons(port);
+        ipv4Address->sin_addr.s_addr = htonl(address.toIPv4Address());
+
+        socketAddressLength = sizeof(struct sockaddr_in);
+    }
+
+    int socketDescriptor = ::socket(socketAddress.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socketDescriptor < 0) {
+        failRequest(request, QString::fromLocal8Bit(std::strerror(errno)));
+    } else {
+        int noDelay = 1;
+        ::setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        // Kernel receive timestamps let us time the response from when the data arrived, rather than when the event
+        // loop got to it.  If the option is not supported we simply fall back to the time the data is read.
+
+        int timestamping = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        ::setsockopt(socketDescriptor, SOL_SOCKET, SO_TIMESTAMPING, &timestamping, sizeof(timestamping));
+
+        int status = ::connect(
+            socketDescriptor,
+            reinterpret_cast<struct sockaddr*>(&socketAddress),
+            socketAddressLength
+        );
+
+        if (status != 0 && errno != EINPROGRESS) {
+            QString errorMessage = QString::fromLocal8Bit(std::strerror(errno));
+            ::close(socketDescriptor);
+
+            failRequest(request, errorMessage);
+        } else {
+            Connection* connection = new Connection(
+                this,
+                QString("%1://%2:%3").arg(scheme, request->url.host()).arg(port)
+            );
+
+            connection->socketDescriptor = socketDescriptor;
+            connection->state            = ConnectionState::CONNECTING;
+            connections.insert(connection);
+
+            struct epoll_event event;
+            event.events   = EPOLLOUT;
+            event.data.ptr = connection;
+            ::epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, socketDescriptor, &event);
+
+            connection->registeredEvents = EPOLLOUT;
+
+            attach(request, connection);
+        }
+    }
+}
+
+
+void NativeHttpEngine::attach(NativeHttpEngine::NativeRequest* request, NativeHttpEngine::Connection* connection) {
+    request->connection             = connection;
+    request->currentPeerCertificate = connection->peerCertificate;
+    connection->request             = request;
+    connection->receiveTime         = 0;
+}
+
+
+void NativeHttpEngine::connectCompleted(NativeHttpEngine::Connection* connection) {
+    int       socketError       = 0;
+    socklen_t socketErrorLength = sizeof(socketError);
+
+    ::getsockopt(connection->socketDescriptor, SOL_SOCKET, SO_ERROR, &socketError, &socketErrorLength);
+    if (socketError != 0) {
+        connectionFailed(connection, QString::fromLocal8Bit(std::strerror(socketError)));
+    } else {
+        connection->request->lastActivity = currentTime();
+        connection->request->recordConnected();
+
+        if (connection->key.startsWith(QString("https:"))) {
+            NativeRequest* request  = connection->request;
+            QByteArray     hostName = request->url.host(QUrl::ComponentFormattingOption::FullyEncoded).toUtf8();
+
+            connection->ssl   = SSL_new(sslContext);
+            connection->state = ConnectionState::HANDSHAKING;
+
+            SSL_set_fd(connection->ssl, connection->socketDescriptor);
+            SSL_set_app_data(connection->ssl, connection);
+
+            QHostAddress address;
+            if (address.setAddress(request->url.host())) {
+                X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(connection->ssl), hostName.constData());
+            } else {
+                SSL_set_tlsext_host_name(connection->ssl, hostName.constData());
+                SSL_set1_host(connection->ssl, hostName.constData());
+            }
+
+            SSL_SESSION* session = sessionsByKey.value(connection->key);
+            if (session != nullptr) {
+                SSL_set_session(connection->ssl, session);
+            }
+
+            continueHandshake(connection);
+        } else {
+            connectionEstablished(connection);
+        }
+    }
+}
+
+
+void NativeHttpEngine::continueHandshake(NativeHttpEngine::Connection* connection) {
+    int status = SSL_connect(connection->ssl);
+    if (status == 1) {
+        #if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+
+            X509* certificate = SSL_get1_peer_certificate(connection->ssl);
+
+        #else
+
+            X509* certificate = SSL_get_peer_certificate(connection->ssl);
+
+        #endif
+
+        if (certificate != nullptr) {
+            int length = i2d_X509(certificate, nullptr);
+            if (length > 0) {
+                QByteArray     der(length, '\0');
+                unsigned char* p = reinterpret_cast<unsigned char*>(der.data());
+
+                i2d_X509(certificate, &p);
+                connection->peerCertificate = QSslCertificate(der, QSsl::EncodingFormat::Der);
+            }
+
+            X509_free(certificate);
+        }
+
+        connection->request->currentPeerCertificate = connection->peerCertificate;
+        connection->request->handshakePerformed     = true;
+        connection->request->recordHandshake();
+
+        connectionEstablished(connection);
+    } else {
+        int error = SSL_get_error(connection->ssl, status);
+        if (error == SSL_ERROR_WANT_READ) {
+            updateEvents(connection, EPOLLIN);
+        } else if (error == SSL_ERROR_WANT_WRITE) {
+            updateEvents(connection, EPOLLOUT);
+        } else {
+            long    verifyResult = SSL_get_verify_result(connection->ssl);
+            QString reason;
+
+            if (verifyResult != X509_V_OK) {
+                reason = QString::fromUtf8(X509_verify_cert_error_string(verifyResult));
+            } else {
+                unsigned long errorCode = ERR_get_error();
+                reason = (
+                      errorCode != 0
+                    ? QString::fromUtf8(ERR_reason_error_string(errorCode))
+                    : QString("The remote host closed the connection")
+                );
+            }
+
+            ERR_clear_error();
+            failRequest(connection->request, QString("SSL handshake failed: %1").arg(reason));
+        }
+    }
+}
+
+
+void NativeHttpEngine::connectionEstablished(NativeHttpEngine::Connection* connection) {
+    NativeRequest* request = connection->request;
+
+    connection->state = ConnectionState::OPEN;
+    request->lastActivity = currentTime();
+
+    if (request->reportProgress) {
+        request->client()->requestConnected(request);
+    }
+
+    if (connection->request == request) {
+        sendRequest(connection);
+    }
+}
+
+
+void NativeHttpEngine::sendRequest(NativeHttpEngine::Connection* connection) {
+    NativeRequest* request = connection->request;
+
+    QByteArray target = request->url.toEncoded(
+        QUrl::RemoveScheme | QUrl::RemoveAuthority | QUrl::RemoveFragment
+    );
+    if (target.isEmpty()) {
+        target = QByteArray("/");
+    }
+
+    QByteArray host = request->url.host(QUrl::ComponentFormattingOption::FullyEncoded).toUtf8();
+    if (host.contains(':')) {
+        host = QByteArray("[") + host + QByteArray("]");
+    }
+
+    if (request->url.port() >= 0) {
+        host += QByteArray(":") + QByteArray::number(request->url.port());
+    }
+
+    QByteArray& message = connection->outbound;
+    message.clear();
+    message.reserve(256 + request->requestBody.size());
+
+    message += request->verb;
+    message += ' ';
+    message += target;
+    message += " HTTP/1.1\r\nHost: ";
+    message += host;
+    message += "\r\n";
+
+    for (  HeaderList::const_iterator it  = request->requestHeaders.constBegin(),
+                                      end = request->requestHeaders.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        QByteArray name = it->first.toLower();
+        if (name != "host" && name != "connection") {
+            message += it->first;
+            message += ": ";
+            message += it->second;
+            message += "\r\n";
+        }
+    }
+
+    message += "\r\n";
+    message += request->requestBody;
+
+    connection->outboundOffset = 0;
+    flushOutbound(connection);
+}
+
+
+void NativeHttpEngine::flushOutbound(NativeHttpEngine::Connection* connection) {
+    bool blocked = false;
+    while (!blocked && connection->outboundOffset < connection->outbound.size()) {
+        const char* data = connection->outbound.constData() + connection->outboundOffset;
+        int         size = connection->outbound.size() - connection->outboundOffset;
+        int         sent;
+
+        if (connection->ssl != nullptr) {
+            sent = SSL_write(connection->ssl, data, size);
+            if (sent <= 0) {
+                int error = SSL_get_error(connection->ssl, sent);
+                if (error == SSL_ERROR_WANT_WRITE || error == SSL_ERROR_WANT_READ) {
+                    blocked = true;
+                } else {
+                    ERR_clear_error();
+                    connectionFailed(connection, QString("Remote host closed connection"));
+                    return;
+                }
+            }
+        } else {
+            sent = static_cast<int>(
+                ::send(connection->socketDescriptor, data, static_cast<size_t>(size), MSG_NOSIGNAL)
+            );
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    blocked = true;
+                } else if (errno != EINTR) {
+                    connectionFailed(connection, QString::fromLocal8Bit(std::strerror(errno)));
+                    return;
+                }
+            }
+        }
+
+        if (sent > 0) {
+            connection->outboundOffset += sent;
+        }
+    }
+
+    if (blocked) {
+        updateEvents(connection, EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+    } else {
+        connection->outbound.clear();
+        connection->outboundOffset = 0;
+
+        updateEvents(connection, EPOLLIN | EPOLLRDHUP);
+    }
+}
+
+
+void NativeHttpEngine::connectionReadable(NativeHttpEngine::Connection* connection) {
+    NativeRequest* request = connection->request;
+
+    if (request == nullptr) {
+        // An idle connection is readable when the remote host closes it.  TLS connections may also receive session
+        // tickets after the handshake which OpenSSL consumes without returning any data.
+
+        char    byte;
+        QString errorMessage;
+        if (receiveData(connection, &byte, 1, errorMessage) != wouldBlock) {
+            closeConnection(connection);
+        }
+    } else {
+        int  budget  = readBudget;
+        bool blocked = false;
+        while (!blocked && budget > 0 && connection->request == request && !connection->closed) {
+            // Bodies are read directly into the request's buffer when there's nothing left to parse so the data is
+            // handed to the client without being copied.
+
+            bool direct = (
+                   connection->inbound.isEmpty()
+                && !request->redirecting
+                && (   request->responseState == ResponseState::BODY_LENGTH
+                    || request->responseState == ResponseState::BODY_UNTIL_CLOSE
+                   )
+            );
+
+            int size = readChunkSize;
+            if (direct && request->responseState == ResponseState::BODY_LENGTH) {
+                size = static_cast<int>(std::min(static_cast<long long>(size), request->bodyRemaining));
+            }
+
+            QByteArray& buffer = direct ? request->responseBody : connection->inbound;
+            int         offset = buffer.size();
+            QString     errorMessage;
+
+            // OpenSSL reads from the socket itself so we peek to obtain the timestamp.  Data OpenSSL has already
+            // buffered is covered by the last timestamp we peeked.
+
+            if (connection->ssl != nullptr && SSL_pending(connection->ssl) == 0) {
+                peekReceiveTime(connection);
+            }
+
+            buffer.resize(offset + size);
+            int bytesRead = receiveData(connection, buffer.data() + offset, size, errorMessage);
+            buffer.resize(offset + std::max(bytesRead, 0));
+
+            if (bytesRead > 0) {
+                if (!request->responseStarted) {
+                    request->responseReceiveTime = connection->receiveTime;
+                }
+
+                budget                   -= bytesRead;
+                request->lastActivity    =  currentTime();
+                request->responseStarted =  true;
+
+                if (direct) {
+                    if (request->responseState == ResponseState::BODY_LENGTH) {
+                        request->bodyRemaining -= bytesRead;
+                    }
+
+                    if (deliverBody(connection, QByteArray())                 &&
+                        request->responseState == ResponseState::BODY_LENGTH &&
+                        request->bodyRemaining == 0                             ) {
+                        finishResponse(connection);
+                    }
+                } else {
+                    processInbound(connection);
+                }
+            } else if (bytesRead == 0) {
+                if (request->responseState == ResponseState::BODY_UNTIL_CLOSE) {
+                    request->keepAlive = false;
+                    finishResponse(connection);
+                } else {
+                    connectionFailed(connection, QString("Remote host closed connection"));
+                }
+            } else if (bytesRead == wouldBlock) {
+                blocked = true;
+            } else {
+                connectionFailed(connection, errorMessage);
+            }
+        }
+
+        if (!blocked && budget <= 0 && connection->request == request && !connection->closed) {
+            pendingReadConnections.append(connection);
+            pendingReadTimer->start();
+        }
+    }
+}
+
+
+int NativeHttpEngine::receiveData(
+        NativeHttpEngine::Connection* connection,
+        char*                         buffer,
+        int                           size,
+        QString&                      errorMessage
+    ) {
+    int result;
+
+    if (connection->ssl != nullptr) {
+        result = SSL_read(connection->ssl, buffer, size);
+        if (result <= 0) {
+            int error = SSL_get_error(connection->ssl, result);
+            if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+                result = wouldBlock;
+            } else if (error == SSL_ERROR_ZERO_RETURN || (error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0)) {
+                // Many servers close the socket without sending a TLS close notify.
+
+                result = 0;
+            } else {
+                unsigned long errorCode = ERR_get_error();
+
+                errorMessage = (
+                      errorCode != 0
+                    ? QString::fromUtf8(ERR_reason_error_string(errorCode))
+                    : QString::fromLocal8Bit(std::strerror(errno))
+                );
+
+                result = receiveFailed;
+            }
+
+            ERR_clear_error();
+        }
+    } else {
+        struct iovec  vector;
+        struct msghdr message;
+        char          control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+        vector.iov_base = buffer;
+        vector.iov_len  = static_cast<size_t>(size);
+
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov        = &vector;
+        message.msg_iovlen     = 1;
+        message.msg_control    = control;
+        message.msg_controllen = sizeof(control);
+
+        do {
+            result = static_cast<int>(::recvmsg(connection->socketDescriptor, &message, 0));
+        } while (result < 0 && errno == EINTR);
+
+        if (result > 0) {
+            unsigned long long timestamp = receiveTimestamp(&message);
+            if (timestamp != 0) {
+                connection->receiveTime = timestamp;
+            }
+        } else if (result < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                result = wouldBlock;
+            } else {
+                errorMessage = QString::fromLocal8Bit(std::strerror(errno));
+                result       = receiveFailed;
+            }
+        }
+    }
+
+    return result;
+}
+
+
+void NativeHttpEngine::peekReceiveTime(NativeHttpEngine::Connection* connection) {
+    char          byte;
+    struct iovec  vector;
+    struct msghdr message;
+    char          control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+    vector.iov_base = &byte;
+    vector.iov_len  = 1;
+
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov        = &vector;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    if (::recvmsg(connection->socketDescriptor, &message, MSG_PEEK | MSG_DONTWAIT) > 0) {
+        unsigned long long timestamp = receiveTimestamp(&message);
+        if (timestamp != 0) {
+            connection->receiveTime = timestamp;
+        }
+    }
+}
+
+
+unsigned long long NativeHttpEngine::receiveTimestamp(msghdr* message) {
+    unsigned long long result = 0;
+
+    for (struct cmsghdr* header = CMSG_FIRSTHDR(message) ; header != nullptr ; header = CMSG_NXTHDR(message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_TIMESTAMPING) {
+            struct scm_timestamping timestamps;
+            std::memcpy(&timestamps, CMSG_DATA(header), sizeof(timestamps));
+
+            // The software receive timestamp is always reported in the first slot.
+
+            result = (
+                  static_cast<unsigned long long>(timestamps.ts[0].tv_sec) * 1000000000ULL
+                + static_cast<unsigned long long>(timestamps.ts[0].tv_nsec)
+            );
+        }
+    }
+
+    return result;
+}
+
+
+unsigned long long NativeHttpEngine::receiveDelay(unsigned long long receiveTime) {
+    unsigned long long result = 0;
+
+    if (receiveTime != 0) {
+        struct timespec now;
+        ::clock_gettime(CLOCK_REALTIME, &now);
+
+        unsigned long long nowNanoseconds = (
+              static_cast<unsigned long long>(now.tv_sec) * 1000000000ULL
+            + static_cast<unsigned long long>(now.tv_nsec)
+        );
+
+        if (nowNanoseconds > receiveTime) {
+            result = nowNanoseconds - receiveTime;
+        }
+    }
+
+    return result;
+}
+
+
+void NativeHttpEngine::processInbound(NativeHttpEngine::Connection* connection) {
+    NativeRequest* request = connection->request;
+    QByteArray&    inbound = connection->inbound;
+
+    bool proceed = true;
+    while (proceed && connection->request == request && !connection->closed) {
+        switch (request->responseState) {
+            case ResponseState::HEADERS: {
+                proceed = parseHeaders(connection);
+                break;
+            }
+
+            case ResponseState::BODY_LENGTH: {
+                int length = static_cast<int>(std::min(static_cast<long long>(inbound.size()), request->bodyRemaining));
+
+                proceed = length > 0;
+                if (proceed) {
+                    request->bodyRemaining -= length;
+
+                    QByteArray data = inbound.left(length);
+                    inbound.remove(0, length);
+
+                    if (deliverBody(connection, data) && request->bodyRemaining == 0) {
+                        finishResponse(connection);
+                        proceed = false;
+                    }
+                }
+
+                break;
+            }
+
+            case ResponseState::CHUNK_SIZE: {
+                int lineEnd = inbound.indexOf("\r\n");
+                proceed = lineEnd >= 0;
+                if (proceed) {
+                    QByteArray line = inbound.left(lineEnd);
+                    inbound.remove(0, lineEnd + 2);
+
+                    int extension = line.indexOf(';');
+                    if (extension >= 0) {
+                        line.truncate(extension);
+                    }
+
+                    bool      valid;
+                    long long chunkSize = line.trimmed().toLongLong(&valid, 16);
+                    if (!valid || chunkSize < 0) {
+                        failRequest(request, QString("Invalid chunked response body"));
+                        proceed = false;
+                    } else if (chunkSize == 0) {
+                        request->responseState = ResponseState::CHUNK_TRAILER;
+                    } else {
+                        request->bodyRemaining = chunkSize;
+                        request->responseState = ResponseState::CHUNK_DATA;
+                    }
+                } else if (inbound.size() > maximumHeaderSize) {
+                    failRequest(request, QString("Invalid chunked response body"));
+                }
+
+                break;
+            }
+
+            case ResponseState::CHUNK_DATA: {
+                int length = static_cast<int>(std::min(static_cast<long long>(inbound.size()), request->bodyRemaining));
+
+                proceed = length > 0;
+                if (proceed) {
+                    request->bodyRemaining -= length;
+                    if (request->bodyRemaining == 0) {
+                        request->responseState = ResponseState::CHUNK_DATA_END;
+                    }
+
+                    QByteArray data = inbound.left(length);
+                    inbound.remove(0, length);
+
+                    proceed = deliverBody(connection, data);
+                }
+
+                break;
+            }
+
+            case ResponseState::CHUNK_DATA_END: {
+                proceed = inbound.size() >= 2;
+                if (proceed) {
+                    if (inbound.startsWith("\r\n")) {
+                        inbound.remove(0, 2);
+                        request->responseState = ResponseState::CHUNK_SIZE;
+                    } else {
+                        failRequest(request, QString("Invalid chunked response body"));
+                        proceed = false;
+                    }
+                }
+
+                break;
+            }
+
+            case ResponseState::CHUNK_TRAILER: {
+                int lineEnd = inbound.indexOf("\r\n");
+                proceed = lineEnd >= 0;
+                if (proceed) {
+                    inbound.remove(0, lineEnd + 2);
+                    if (lineEnd == 0) {
+                        finishResponse(connection);
+                        proceed = false;
+                    }
+                } else if (inbound.size() > maximumHeaderSize) {
+                    failRequest(request, QString("Invalid chunked response body"));
+                }
+
+                break;
+            }
+
+            case ResponseState::BODY_UNTIL_CLOSE: {
+                proceed = false;
+                if (!inbound.isEmpty()) {
+                    QByteArray data;
+                    data.swap(inbound);
+
+                    deliverBody(connection, data);
+                }
+
+                break;
+            }
+
+            case ResponseState::COMPLETE: {
+                proceed = false;
+                break;
+            }
+
+            default: {
+                Q_ASSERT(false);
+                proceed = false;
+                break;
+            }
+        }
+    }
+}
+
+
+bool NativeHttpEngine::parseHeaders(NativeHttpEngine::Connection* connection) {
+    NativeRequest* request   = connection->request;
+    QByteArray&    inbound   = connection->inbound;
+    int            headerEnd = inbound.indexOf("\r\n\r\n");
+    bool           result    = false;
+
+    if (headerEnd < 0) {
+        if (inbound.size() > maximumHeaderSize) {
+            failRequest(request, QString("Response headers are too large"));
+        }
+    } else {
+        QList<QByteArray> lines = inbound.left(headerEnd).split('\n');
+        inbound.remove(0, headerEnd + 4);
+
+        QByteArray statusLine = lines.takeFirst().trimmed();
+        int        firstSpace = statusLine.indexOf(' ');
+        int        lastSpace  = statusLine.indexOf(' ', firstSpace + 1);
+        bool       valid      = statusLine.startsWith("HTTP/") && firstSpace > 0;
+        int        code       = 0;
+
+        if (valid) {
+            code = statusLine.mid(
+                firstSpace + 1,
+                lastSpace > firstSpace ? lastSpace - firstSpace - 1 : -1
+            ).toInt(&valid);
+        }
+
+        if (!valid || code < 100 || code > 999) {
+            failRequest(request, QString("Invalid response from remote host"));
+        } else if (code < 200) {
+            // Interim responses, such as 100 Continue, are followed by the final response.
+
+            result = true;
+        } else {
+            request->responseStatusCode = code;
+            request->reasonPhrase       = lastSpace > firstSpace ? statusLine.mid(lastSpace + 1) : QByteArray();
+
+            request->responseHeaders.clear();
+            for (QList<QByteArray>::const_iterator it=lines.constBegin(),end=lines.constEnd() ; it!=end ; ++it) {
+                int colon = it->indexOf(':');
+                if (colon > 0) {
+                    request->responseHeaders.append(
+                        Header(it->left(colon).trimmed().toLower(), it->mid(colon + 1).trimmed())
+                    );
+                }
+            }
+
+            QByteArray connectionHeader = findHeader(request->responseHeaders, QByteArray("connection")).toLower();
+            if (statusLine.startsWith("HTTP/1.0")) {
+                request->keepAlive = connectionHeader.contains("keep-alive");
+            } else {
+                request->keepAlive = !connectionHeader.contains("close");
+            }
+
+            bool      contentLengthKnown;
+            long long contentLength = findHeader(request->responseHeaders, QByteArray("content-length"))
+                                      .toLongLong(&contentLengthKnown);
+
+            bool noBody = (
+                   request->verb == headVerb
+                || code == 204
+                || code == 304
+                || (contentLengthKnown && contentLength == 0)
+            );
+
+            if (noBody) {
+                request->responseState = ResponseState::COMPLETE;
+            } else if (findHeader(request->responseHeaders, QByteArray("transfer-encoding")).toLower()
+                       .contains("chunked")) {
+                request->responseState = ResponseState::CHUNK_SIZE;
+            } else if (contentLengthKnown && contentLength > 0) {
+                request->responseState = ResponseState::BODY_LENGTH;
+                request->bodyRemaining = contentLength;
+            } else {
+                request->responseState = ResponseState::BODY_UNTIL_CLOSE;
+            }
+
+            request->redirecting = (
+                   (code == 301 || code == 302 || code == 303 || code == 307 || code == 308)
+                && !findHeader(request->responseHeaders, QByteArray("location")).isEmpty()
+            );
+
+            if (!request->redirecting) {
+                request->recordFirstByte(receiveDelay(request->responseReceiveTime));
+            }
+
+            bool stillAttached = true;
+            if (!request->redirecting && request->reportProgress) {
+                request->client()->requestHeadersReceived(request);
+                stillAttached = (connection->request == request && !connection->closed);
+            }
+
+            if (stillAttached) {
+                if (request->responseState == ResponseState::COMPLETE) {
+                    finishResponse(connection);
+                } else {
+                    result = true;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+
+bool NativeHttpEngine::deliverBody(NativeHttpEngine::Connection* connection, const QByteArray& data) {
+    NativeRequest* request = connection->request;
+
+    if (request->redirecting) {
+        request->responseBody.clear();
+    } else {
+        if (!data.isEmpty()) {
+            request->responseBody += data;
+        }
+
+        if (!request->responseBody.isEmpty()) {
+            request->client()->requestDataAvailable(request);
+        }
+    }
+
+    return connection->request == request && !connection->closed;
+}
+
+
+void NativeHttpEngine::finishResponse(NativeHttpEngine::Connection* connection) {
+    NativeRequest* request  = connection->request;
+    bool           reusable = (
+           request->keepAlive
+        && request->responseState != ResponseState::BODY_UNTIL_CLOSE
+        && connection->inbound.isEmpty()
+    );
+
+    request->responseState = ResponseState::COMPLETE;
+    request->connection    = nullptr;
+
+    if (!request->redirecting) {
+        request->recordCompleted(receiveDelay(connection->receiveTime));
+    }
+
+    releaseConnection(connection, reusable);
+
+    if (request->redirecting) {
+        followRedirect(request);
+    } else {
+        if (request->responseStatusCode >= 400) {
+            request->currentFailed      = true;
+            request->currentErrorString = QString("Error transferring %1 - server replied: %2")
+                                          .arg(request->url.toString(), QString::fromLatin1(request->reasonPhrase));
+        }
+
+        reportFinished(request);
+    }
+}
+
+
+void NativeHttpEngine::followRedirect(NativeHttpEngine::NativeRequest* request) {
+    QUrl target = request->url.resolved(
+        QUrl::fromEncoded(findHeader(request->responseHeaders, QByteArray("location")))
+    );
+
+    QString fromScheme = request->url.scheme().toLower();
+    QString toScheme   = target.scheme().toLower();
+
+    if (request->redirectsRemaining == 0) {
+        failRequest(request, QString("Too many redirects"));
+    } else if (fromScheme == QString("https") && toScheme != QString("https")) {
+        failRequest(request, QString("Insecure redirect"));
+    } else {
+        --request->redirectsRemaining;
+
+        // Browsers, and QNetworkAccessManager, change a redirected POST to a GET for 301 and 302 responses as well as
+        // for 303 responses.
+
+        int code = request->responseStatusCode;
+        if (code == 303 || ((code == 301 || code == 302) && request->verb == postVerb)) {
+            if (request->verb != headVerb) {
+                request->verb = getVerb;
+            }
+
+            request->requestBody.clear();
+
+            HeaderList::iterator it = request->requestHeaders.begin();
+            while (it != request->requestHeaders.end()) {
+                QByteArray name = it->first.toLower();
+                if (name == "content-type" || name == "content-length") {
+                    it = request->requestHeaders.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        request->url                = target;
+        request->redirecting        = false;
+        request->responseStatusCode = 0;
+        request->retried            = false;
+        request->responseHeaders.clear();
+        request->responseBody.clear();
+
+        beginRequest(request);
+    }
+}
+
+
+void NativeHttpEngine::connectionFailed(NativeHttpEngine::Connection* connection, const QString& errorMessage) {
+    NativeRequest* request = connection->request;
+
+    if (request == nullptr) {
+        closeConnection(connection);
+    } else if (connection->reused && !request->responseStarted && !request->retried) {
+        // The remote host likely closed the pooled connection while it was idle.
+
+        request->retried    = true;
+        request->connection = nullptr;
+        connection->request = nullptr;
+
+        closeConnection(connection);
+        beginRequest(request, false);
+    } else {
+        failRequest(request, errorMessage);
+    }
+}
+
+
+void NativeHttpEngine::failRequest(NativeHttpEngine::NativeRequest* request, const QString& errorMessage) {
+    if (!request->awaitingLookup.isEmpty()) {
+        QHash<QString, QList<NativeRequest*>>::iterator it = requestsAwaitingLookup.find(request->awaitingLookup);
+        if (it != requestsAwaitingLookup.end()) {
+            it.value().removeOne(request);
+        }
+
+        request->awaitingLookup.clear();
+    }
+
+    Connection* connection = request->connection;
+    if (connection != nullptr) {
+        request->connection = nullptr;
+        connection->request = nullptr;
+
+        closeConnection(connection);
+    }
+
+    request->currentFailed      = true;
+    request->currentErrorString = errorMessage;
+    request->responseState      = ResponseState::COMPLETE;
+    request->responseBody.clear();
+
+    reportFinished(request);
+}
+
+
+void NativeHttpEngine::reportFinished(NativeHttpEngine::NativeRequest* request) {
+    activeRequests.remove(request);
+    request->client()->requestFinished(request);
+}
+
+
+void NativeHttpEngine::releaseConnection(NativeHttpEngine::Connection* connection, bool reusable) {
+    connection->request = nullptr;
+
+    if (reusable && !connection->closed) {
+        ConnectionList& idleConnections = idleConnectionsByKey[connection->key];
+        if (idleConnections.size() < maximumIdleConnectionsPerHost) {
+            connection->reused    = true;
+            connection->idleSince = currentTime();
+            idleConnections.append(connection);
+
+            updateEvents(connection, EPOLLIN | EPOLLRDHUP);
+            startSweeping();
+        } else {
+            closeConnection(connection);
+        }
+    } else {
+        closeConnection(connection);
+    }
+}
+
+
+void NativeHttpEngine::closeConnection(NativeHttpEngine::Connection* connection) {
+    if (!connection->closed) {
+        connection->closed = true;
+
+        QHash<QString, ConnectionList>::iterator it = idleConnectionsByKey.find(connection->key);
+        if (it != idleConnectionsByKey.end()) {
+            it.value().removeOne(connection);
+            if (it.value().isEmpty()) {
+                idleConnectionsByKey.erase(it);
+            }
+        }
+
+        pendingReadConnections.removeAll(connection);
+        connections.remove(connection);
+
+        ::epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, connection->socketDescriptor, nullptr);
+
+        if (connection->ssl != nullptr) {
+            SSL_free(connection->ssl);
+            connection->ssl = nullptr;
+        }
+
+        ::close(connection->socketDescriptor);
+        connection->socketDescriptor = -1;
+
+        deadConnections.append(connection);
+        reapTimer->start();
+    }
+}
+
+
+void NativeHttpEngine::updateEvents(NativeHttpEngine::Connection* connection, unsigned events) {
+    if (connection->registeredEvents != events) {
+        struct epoll_event event;
+        event.events   = events;
+        event.data.ptr = connection;
+
+        ::epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, connection->socketDescriptor, &event);
+        connection->registeredEvents = events;
+    }
+}
+
+
+void NativeHttpEngine::startSweeping() {
+    if (!sweepTimer->isActive()) {
+        sweepTimer->start();
+    }
+}
+
+
+void NativeHttpEngine::requestDestroyed(NativeHttpEngine::NativeRequest* request) {
+    startQueue.removeOne(request);
+    activeRequests.remove(request);
+
+    if (!request->awaitingLookup.isEmpty()) {
+        QHash<QString, QList<NativeRequest*>>::iterator it = requestsAwaitingLookup.find(request->awaitingLookup);
+        if (it != requestsAwaitingLookup.end()) {
+            it.value().removeOne(request);
+        }
+    }
+
+    // A request deleted mid-response leaves unread data on its connection so the connection can't be reused.
+
+    Connection* connection = request->connection;
+    if (connection != nullptr) {
+        request->connection = nullptr;
+        connection->request = nullptr;
+
+        closeConnection(connection);
+    }
+}
+
+
+void NativeHttpEngine::storeSession(const QString& key, SSL_SESSION* session) {
+    QHash<QString, SSL_SESSION*>::iterator it = sessionsByKey.find(key);
+    if (it != sessionsByKey.end()) {
+        SSL_SESSION_free(it.value());
+        it.value() = session;
+    } else {
+        if (sessionsByKey.size() >= maximumCachedSessions) {
+            // Sessions are only an optimization so an arbitrary session is discarded to make room.
+
+            QHash<QString, SSL_SESSION*>::iterator evicted = sessionsByKey.begin();
+            SSL_SESSION_free(evicted.value());
+            sessionsByKey.erase(evicted);
+        }
+
+        sessionsByKey.insert(key, session);
+    }
+}
+
+
+QByteArray NativeHttpEngine::findHeader(const NativeHttpEngine::HeaderList& headers, const QByteArray& headerName) {
+    QByteArray result;
+
+    HeaderList::const_iterator it  = headers.constBegin();
+    HeaderList::const_iterator end = headers.constEnd();
+    while (it != end && it->first != headerName) {
+        ++it;
+    }
+
+    if (it != end) {
+        result = it->second;
+    }
+
+    return result;
+}
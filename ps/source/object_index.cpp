@@ -0,0 +1,94 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref ObjectIndex class.
+***********************************************************************************************************************/
+
+#include <QHash>
+#include <QReadWriteLock>
+
+#include <cstdint>
+
+#include "monitor.h"
+#include "host_scheme.h"
+#include "customer.h"
+#include "object_index.h"
+
+ObjectIndex::ObjectIndex() {}
+
+
+ObjectIndex::~ObjectIndex() {}
+
+
+void ObjectIndex::insertCustomer(Customer* customer, HttpServiceThread* serviceThread) {
+    customers.insert(customer->customerId(), CustomerEntry(customer, serviceThread));
+}
+
+
+void ObjectIndex::removeCustomer(Customer::CustomerId customerId) {
+    customers.remove(customerId);
+}
+
+
+void ObjectIndex::removeCustomer(Customer* customer, HttpServiceThread* serviceThread) {
+    customers.remove(customer->customerId(), CustomerEntry(customer, serviceThread));
+}
+
+
+Customer* ObjectIndex::customer(Customer::CustomerId customerId) const {
+    return customers.value(customerId).customer();
+}
+
+
+HttpServiceThread* ObjectIndex::customerServiceThread(Customer::CustomerId customerId) const {
+    return customers.value(customerId).serviceThread();
+}
+
+
+void ObjectIndex::insertHostScheme(HostScheme* hostScheme) {
+    hostSchemes.insert(hostScheme->hostSchemeId(), hostScheme);
+}
+
+
+void ObjectIndex::removeHostScheme(HostScheme* hostScheme) {
+    hostSchemes.remove(hostScheme->hostSchemeId(), hostScheme);
+}
+
+
+HostScheme* ObjectIndex::hostScheme(HostScheme::HostSchemeId hostSchemeId) const {
+    return hostSchemes.value(hostSchemeId);
+}
+
+
+void ObjectIndex::insertMonitor(Monitor* monitor) {
+    monitors.insert(monitor->monitorId(), monitor);
+}
+
+
+void ObjectIndex::removeMonitor(Monitor* monitor) {
+    monitors.remove(monitor->monitorId(), monitor);
+}
+
+
+Monitor* ObjectIndex::monitor(Monitor::MonitorId monitorId) const {
+    return monitors.value(monitorId);
+}
+
+
+unsigned long ObjectIndex::numberMonitors() const {
+    return monitors.size();
+}
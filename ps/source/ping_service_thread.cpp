@@ -37,24 +37,32 @@
 #include "customer.h"
 #include "data_aggregator.h"
 #include "service_thread.h"
+#include "thread_affinity.h"
 #include "http_service_thread.h"
 #include "ping_service_thread_private.h"
 #include "ping_service_thread.h"
 
-PingServiceThread::PingServiceThread(QObject* parent):ServiceThread(parent) {
-    impl = new PingServiceThreadPrivate;
+PingServiceThread::PingServiceThread(DnsCache* dnsCache, QObject* parent):ServiceThread(parent) {
+    impl = new PingServiceThreadPrivate(dnsCache);
     QObject::connect(this, &PingServiceThread::connectToPinger, impl, &PingServiceThreadPrivate::connectToPinger);
+
+    // QObject::moveToThread can only push an object from the object's current thread so the move is done here.
+
+    impl->moveToThread(this);
+    start();
 }
 
 
 PingServiceThread::~PingServiceThread() {
     quit();
     wait();
+
+    delete impl;
 }
 
 
-void PingServiceThread::connect(const QString& socketName) {
-    emit connectToPinger(socketName);
+void PingServiceThread::connect(const QString& socketName, unsigned pingerWindow, bool sharedMemory) {
+    emit connectToPinger(socketName, pingerWindow, sharedMemory);
 }
 
 
@@ -73,6 +81,42 @@ void PingServiceThread::removeCustomer(Customer::CustomerId customerId) {
 }
 
 
+void PingServiceThread::moveCustomer(Customer::CustomerId customerId, HttpServiceThread* httpServiceThread) {
+    impl->moveCustomer(customerId, httpServiceThread);
+}
+
+
+void PingServiceThread::setCpuAffinity(const ThreadAffinity::CpuList& cpus) {
+    QMetaObject::invokeMethod(
+        impl,
+        [cpus]() {
+            if (!ThreadAffinity::apply(cpus)) {
+                logWrite(
+                    QString("Could not pin ping service thread to CPUs %1").arg(ThreadAffinity::toString(cpus)),
+                    true
+                );
+            }
+        },
+        Qt::QueuedConnection
+    );
+}
+
+
+unsigned long PingServiceThread::roundTripMicroseconds(HostScheme::HostSchemeId hostSchemeId) const {
+    return impl->roundTripMicroseconds(hostSchemeId);
+}
+
+
+unsigned long PingServiceThread::numberPendingCommands() const {
+    return impl->numberPendingCommands();
+}
+
+
+unsigned long PingServiceThread::numberInFlightCommands() const {
+    return impl->numberInFlightCommands();
+}
+
+
 void PingServiceThread::goInactive() {
     impl->goInactive();
 }
@@ -84,6 +128,5 @@ void PingServiceThread::goActive() {
 
 
 void PingServiceThread::run() {
-    impl->moveToThread(this);
     exec();
 }
@@ -24,9 +24,11 @@
 #include <QMutex>
 #include <QMutexLocker>
 #include <QLocalSocket>
+#include <QSocketNotifier>
 #include <QTimer>
 #include <QHash>
 #include <QList>
+#include <QHostAddress>
 
 #include <cstdint>
 #include <netdb.h>
@@ -36,19 +38,51 @@
 #include "data_aggregator.h"
 #include "service_thread.h"
 #include "http_service_thread.h"
+#include "dns_cache.h"
+#include "pinger_ring.h"
 #include "ping_service_thread_private.h"
 
 
-PingServiceThreadPrivate::PingServiceThreadPrivate(QObject* parent):QObject(parent) {
+PingServiceThreadPrivate::PingServiceThreadPrivate(
+        DnsCache* dnsCache,
+        QObject*  parent
+    ):QObject(
+        parent
+    ),currentDnsCache(
+        dnsCache
+    ) {
+    activeMode          = true;
+    currentPingerWindow = 1;
+    nextSequenceNumber  = 0;
+    requeuedCommands    = 0;
+    issueScheduled      = false;
+    retryPending        = false;
+
+    ringNotifier         = nullptr;
+    currentSharedMemory  = false;
+    ringActive           = false;
+    ringHandshakePending = false;
+
     retryTimer = new QTimer(this);
     retryTimer->setSingleShot(true);
-    connect(retryTimer, &QTimer::timeout, this, &PingServiceThreadPrivate::issueNextCommand);
+    connect(retryTimer, &QTimer::timeout, this, &PingServiceThreadPrivate::retryCommands);
 
     socket = new QLocalSocket(this);
     connect(socket, &QLocalSocket::readyRead, this, &PingServiceThreadPrivate::readyRead);
     connect(socket, &QLocalSocket::readChannelFinished, this, &PingServiceThreadPrivate::readChannelFinished);
-
-    connect(this, &PingServiceThreadPrivate::startNextCommand, this, &PingServiceThreadPrivate::issueNextCommand);
+    connect(socket, &QLocalSocket::connected, this, &PingServiceThreadPrivate::socketConnected);
+
+    connect(
+        this,
+        &PingServiceThreadPrivate::startNextCommand,
+        this,
+        &PingServiceThreadPrivate::issueNextCommand,
+        Qt::QueuedConnection
+    );
+
+    if (dnsCache != nullptr) {
+        connect(dnsCache, &DnsCache::addressChanged, this, &PingServiceThreadPrivate::hostAddressChanged);
+    }
 }
 
 
@@ -84,8 +118,9 @@ void PingServiceThreadPrivate::addHost(
             );
         }
 
-        issueCommand(CommandEntry(CommandEntry::Command::ADD, hostScheme->hostSchemeId(), hostScheme->url().host()));
-
+        issueCommand(
+            CommandEntry(CommandEntry::Command::ADD, hostScheme->hostSchemeId(), serverName(hostScheme->url().host()))
+        );
     }
 }
 
@@ -110,11 +145,66 @@ void PingServiceThreadPrivate::removeCustomer(Customer::CustomerId customerId) {
 }
 
 
-void PingServiceThreadPrivate::connectToPinger(const QString& socketName) {
+void PingServiceThreadPrivate::moveCustomer(Customer::CustomerId customerId, HttpServiceThread* httpServiceThread) {
+    QMutexLocker locker(&hostSchemeMutex);
+
+    HostSchemeIdsByCustomerId::const_iterator cit = hostSchemeIdsByCustomerId.constFind(customerId);
+    if (cit != hostSchemeIdsByCustomerId.constEnd()) {
+        const QSet<HostScheme::HostSchemeId>& hostSchemeIds = cit.value();
+        for (  QSet<HostScheme::HostSchemeId>::const_iterator hit  = hostSchemeIds.constBegin(),
+                                                              hend = hostSchemeIds.constEnd()
+             ; hit != hend
+             ; ++hit
+            ) {
+            HostDataByHostSchemeId::iterator it = hostDataByHostSchemeId.find(*hit);
+            if (it != hostDataByHostSchemeId.end()) {
+                it.value().setHttpServiceThread(httpServiceThread);
+            }
+        }
+    }
+}
+
+
+unsigned long PingServiceThreadPrivate::roundTripMicroseconds(HostScheme::HostSchemeId hostSchemeId) const {
+    QMutexLocker locker(&hostSchemeMutex);
+
+    HostDataByHostSchemeId::const_iterator it = hostDataByHostSchemeId.constFind(hostSchemeId);
+    return it != hostDataByHostSchemeId.constEnd() ? it.value().roundTripMicroseconds() : 0;
+}
+
+
+unsigned long PingServiceThreadPrivate::numberPendingCommands() const {
+    QMutexLocker locker(&commandMutex);
+    return static_cast<unsigned long>(pendingCommands.size());
+}
+
+
+unsigned long PingServiceThreadPrivate::numberInFlightCommands() const {
+    QMutexLocker locker(&commandMutex);
+
+    unsigned long result = 0;
+    for (  InFlightBatches::const_iterator it = inFlightBatches.constBegin(), end = inFlightBatches.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        result += static_cast<unsigned long>(it->entries().size());
+    }
+
+    return result;
+}
+
+
+void PingServiceThreadPrivate::connectToPinger(const QString& socketName, unsigned pingerWindow, bool sharedMemory) {
+    commandMutex.lock();
+    currentPingerWindow = pingerWindow > 0 ? pingerWindow : 1;
+    commandMutex.unlock();
+
+    currentSharedMemory = sharedMemory;
+
     socket->connectToServer(socketName, QLocalSocket::OpenModeFlag::ReadWrite);
     if (socket->state() != QLocalSocket::LocalSocketState::UnconnectedState) {
         currentSocketName = socketName;
-        logWrite("Connecting to pinger");
+        logWrite(QString("Connecting to pinger, command window %1").arg(pingerWindow));
     } else {
         logWrite("Failed to connect to pinger.");
     }
@@ -123,6 +213,7 @@ void PingServiceThreadPrivate::connectToPinger(const QString& socketName) {
 
 void PingServiceThreadPrivate::goInactive() {
     QMutexLocker locker(&hostSchemeMutex);
+    activeMode = false;
 
     for (  HostDataByHostSchemeId::const_iterator it  = hostDataByHostSchemeId.constBegin(),
                                                   end = hostDataByHostSchemeId.constEnd()
@@ -136,122 +227,263 @@ void PingServiceThreadPrivate::goInactive() {
 
 void PingServiceThreadPrivate::goActive() {
     QMutexLocker locker(&hostSchemeMutex);
+    activeMode = true;
 
     for (  HostDataByHostSchemeId::const_iterator it  = hostDataByHostSchemeId.constBegin(),
                                                   end = hostDataByHostSchemeId.constEnd()
          ; it != end
          ; ++it
         ) {
-        issueCommand(CommandEntry(CommandEntry::Command::ADD, it.key(), it.value().hostScheme()->url().host()));
+        issueCommand(
+            CommandEntry(CommandEntry::Command::ADD, it.key(), serverName(it.value().hostScheme()->url().host()))
+        );
     }
 }
 
 
 void PingServiceThreadPrivate::readyRead() {
-    if (socket->canReadLine()) {
+    bool issueMore = false;
+
+    while (socket->canReadLine()) {
         char line[maximumLineLength + 1];
         qint64 bytesRead = socket->readLine(line, maximumLineLength);
         if (bytesRead >= 0) {
             QString received = QString::fromUtf8(line).trimmed();
-            if (received == QString("OK")) {
-                commandMutex.lock();
-                pendingCommands.removeFirst();
-                commandMutex.unlock();
-
-                issueNextCommand();
-            } else if (received.startsWith("NOPING ")) {
-                // Handle noping message
-            } else if (received.startsWith("ERROR ")) {
-                logWrite(
-                    QString("Pinger reported error, command \"%1\", response \"%2\", ignoring.")
-                    .arg(commandString(pendingCommands.first()))
-                    .arg(received),
-                    true
-                );
-
-                commandMutex.lock();
-                pendingCommands.removeFirst();
-                commandMutex.unlock();
-
-                issueNextCommand();
-            } else if (received.startsWith("failed")) {
-                logWrite(
-                    QString("Pinger reported error, command \"%1\", response \"%2\", will retry.")
-                    .arg(commandString(pendingCommands.first()))
-                    .arg(received),
-                    true
-                );
-
-                retryTimer->start(pingerRetryDelay);
+            if (received.startsWith("NOPING ")) {
+                bool                     isNumber;
+                HostScheme::HostSchemeId hostSchemeId = received.section(QChar(' '), 1, 1).toUInt(&isNumber);
+                if (isNumber) {
+                    QMutexLocker locker(&hostSchemeMutex);
+                    noPing(hostSchemeId);
+                }
+            } else if (ringHandshakePending) {
+                ringHandshakePending = false;
+
+                if (received == QString("OK")) {
+                    ringNotifier = new QSocketNotifier(ring.inboundDescriptor(), QSocketNotifier::Type::Read, this);
+                    connect(ringNotifier, SIGNAL(activated(int)), this, SLOT(ringRecordsAvailable()));
+
+                    ringActive = true;
+                    logWrite(QString("Using shared memory transport to pinger."));
+                } else {
+                    logWrite(
+                        QString("Pinger declined shared memory transport, response \"%1\", using socket.")
+                        .arg(received),
+                        true
+                    );
+
+                    ring.close();
+                }
+
+                issueMore = true;
+            } else {
+                QMutexLocker locker(&commandMutex);
+
+                int batchIndex = responseBatch(received);
+                if (batchIndex >= 0 && handleResponse(batchIndex, received)) {
+                    issueMore = true;
+                }
             }
         }
     }
+
+    if (issueMore) {
+        issueNextCommand();
+    }
 }
 
 
 void PingServiceThreadPrivate::readChannelFinished() {
     logWrite(QString("Pinger disconnected unexpectedly."), true);
+
+    stopRing();
+
+    QMutexLocker locker(&commandMutex);
+
+    while (!inFlightBatches.isEmpty()) {
+        requeueBatch(0);
+    }
+
+    retryPending = true;
     retryTimer->start(pingerRetryDelay);
 }
 
 
+void PingServiceThreadPrivate::socketConnected() {
+    if (currentSharedMemory) {
+        startRingHandshake();
+    }
+}
+
+
+void PingServiceThreadPrivate::ringRecordsAvailable() {
+    PingerRing::Record records[maximumRingBatch];
+    unsigned long      numberRecords;
+    bool               issueMore = false;
+
+    ring.acknowledgeWakeup();
+
+    do {
+        numberRecords = ring.read(records, maximumRingBatch);
+
+        commandMutex.lock();
+        for (unsigned long i=0 ; i<numberRecords ; ++i) {
+            const PingerRing::Record& record = records[i];
+            if (record.type == PingerRing::RecordType::OK     ||
+                record.type == PingerRing::RecordType::ERROR  ||
+                record.type == PingerRing::RecordType::FAILED    ) {
+                int index = batchIndex(record.sequenceNumber);
+                if (index >= 0) {
+                    QString message = QString::fromUtf8(record.name, record.nameLength);
+                    QString response;
+
+                    if (record.type == PingerRing::RecordType::OK) {
+                        response = QString("OK");
+                    } else if (record.type == PingerRing::RecordType::ERROR) {
+                        response = QString("ERROR %1").arg(message);
+                    } else {
+                        response = QString("failed %1").arg(message);
+                    }
+
+                    if (handleResponse(index, response)) {
+                        issueMore = true;
+                    }
+                } else {
+                    logWrite(
+                        QString("Pinger response for unknown command %1, ignoring.").arg(record.sequenceNumber),
+                        true
+                    );
+                }
+            }
+        }
+        commandMutex.unlock();
+
+        hostSchemeMutex.lock();
+        for (unsigned long i=0 ; i<numberRecords ; ++i) {
+            const PingerRing::Record& record = records[i];
+            if (record.type == PingerRing::RecordType::NOPING) {
+                noPing(record.hostId);
+            } else if (record.type == PingerRing::RecordType::PING_RESULT) {
+                HostDataByHostSchemeId::iterator it = hostDataByHostSchemeId.find(record.hostId);
+                if (it != hostDataByHostSchemeId.end()) {
+                    it.value().setRoundTripMicroseconds(record.value);
+                }
+            }
+        }
+        hostSchemeMutex.unlock();
+    } while (numberRecords == maximumRingBatch);
+
+    if (issueMore) {
+        issueNextCommand();
+    }
+}
+
+
 void PingServiceThreadPrivate::issueNextCommand() {
     if (socket->state() == QLocalSocket::LocalSocketState::ConnectedState) {
         QMutexLocker locker(&commandMutex);
+        issueScheduled = false;
 
-        if (!pendingCommands.isEmpty()) {
-            const CommandEntry& nextCommand = pendingCommands.first();
-
-            QString cmd = commandString(nextCommand);
-            logWrite(QString("Issuing pinger command \"%1\"").arg(cmd));
+        if (!retryPending && !ringHandshakePending) {
+            if (ringActive) {
+                issueRingCommands();
+            } else {
+                issueSocketCommands();
+            }
 
-            cmd += "\n";
-            socket->write(cmd.toUtf8());
+            requeuedCommands = 0;
         }
     } else {
         if (socket->state() == QLocalSocket::LocalSocketState::UnconnectedState) {
             socket->connectToServer(currentSocketName, QLocalSocket::OpenModeFlag::ReadWrite);
         }
 
+        QMutexLocker locker(&commandMutex);
+        issueScheduled = false;
+        retryPending   = true;
         retryTimer->start(pingerRetryDelay);
     }
 }
 
 
+void PingServiceThreadPrivate::retryCommands() {
+    commandMutex.lock();
+    retryPending = false;
+    commandMutex.unlock();
+
+    issueNextCommand();
+}
+
+
+void PingServiceThreadPrivate::hostAddressChanged(const QString& hostName) {
+    QMutexLocker locker(&hostSchemeMutex);
+
+    if (activeMode) {
+        QString newServerName = serverName(hostName);
+        for (  HostDataByHostSchemeId::const_iterator it  = hostDataByHostSchemeId.constBegin(),
+                                                      end = hostDataByHostSchemeId.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            if (it.value().url().host() == hostName) {
+                issueCommand(CommandEntry(CommandEntry::Command::REMOVE, it.key()));
+                issueCommand(CommandEntry(CommandEntry::Command::ADD, it.key(), newServerName));
+            }
+        }
+    }
+}
+
+
 void PingServiceThreadPrivate::issueCommand(const CommandEntry& commandEntry) {
     QMutexLocker locker(&commandMutex);
 
-    if (pendingCommands.isEmpty()) {
-        pendingCommands.append(commandEntry);
+    pendingCommands.append(commandEntry);
+    if (!issueScheduled && !retryPending) {
+        issueScheduled = true;
         emit startNextCommand();
-    } else {
-        pendingCommands.append(commandEntry);
     }
 }
 
 
-QString PingServiceThreadPrivate::commandString(const CommandEntry& commandEntry) {
-    QString result;
+QString PingServiceThreadPrivate::commandString(const CommandBatch& commandBatch) const {
+    QString                    result;
+    const QList<CommandEntry>& entries = commandBatch.entries();
 
-    switch (commandEntry.command()) {
+    if (currentPingerWindow > 1) {
+        result = QString("%1 ").arg(commandBatch.sequenceNumber());
+    }
+
+    switch (commandBatch.command()) {
         case CommandEntry::Command::ADD: {
-            result = QString("A %1 %2").arg(commandEntry.hostId()).arg(commandEntry.serverName());
+            result += QString("A");
+            for (QList<CommandEntry>::const_iterator it=entries.constBegin(),end=entries.constEnd() ; it!=end ; ++it) {
+                result += QString(" %1 %2").arg(it->hostId()).arg(it->serverName());
+            }
+
             break;
         }
 
         case CommandEntry::Command::REMOVE: {
-            result = QString("R %1").arg(commandEntry.hostId());
+            result += QString("R");
+            for (QList<CommandEntry>::const_iterator it=entries.constBegin(),end=entries.constEnd() ; it!=end ; ++it) {
+                result += QString(" %1").arg(it->hostId());
+            }
+
             break;
         }
 
         case CommandEntry::Command::DEFUNCT: {
-            result = QString("D %1").arg(commandEntry.hostId());
+            result += QString("D");
+            for (QList<CommandEntry>::const_iterator it=entries.constBegin(),end=entries.constEnd() ; it!=end ; ++it) {
+                result += QString(" %1").arg(it->hostId());
+            }
+
             break;
         }
 
         default: {
             logWrite(
-                QString("Unexpected pinger command %1.").arg(static_cast<unsigned>(commandEntry.command())),
+                QString("Unexpected pinger command %1.").arg(static_cast<unsigned>(commandBatch.command())),
                 true
             );
 
@@ -261,3 +493,225 @@ QString PingServiceThreadPrivate::commandString(const CommandEntry& commandEntry
 
     return result;
 }
+
+
+int PingServiceThreadPrivate::responseBatch(QString& response) const {
+    int result = inFlightBatches.isEmpty() ? -1 : 0;
+
+    if (currentPingerWindow > 1) {
+        int spaceIndex = response.indexOf(QChar(' '));
+        if (spaceIndex > 0) {
+            bool          isNumber;
+            std::uint32_t sequenceNumber = response.left(spaceIndex).toUInt(&isNumber);
+            if (isNumber) {
+                response = response.mid(spaceIndex + 1).trimmed();
+                result   = batchIndex(sequenceNumber);
+
+                if (result < 0) {
+                    logWrite(QString("Pinger response for unknown command %1, ignoring.").arg(sequenceNumber), true);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+
+int PingServiceThreadPrivate::batchIndex(std::uint32_t sequenceNumber) const {
+    int result         = -1;
+    int numberInFlight = inFlightBatches.size();
+    int index          = 0;
+
+    while (result < 0 && index < numberInFlight) {
+        if (inFlightBatches.at(index).sequenceNumber() == sequenceNumber) {
+            result = index;
+        } else {
+            ++index;
+        }
+    }
+
+    return result;
+}
+
+
+bool PingServiceThreadPrivate::handleResponse(int batchIndex, const QString& response) {
+    bool result = false;
+
+    if (response == QString("OK")) {
+        inFlightBatches.removeAt(batchIndex);
+        result = true;
+    } else if (response.startsWith("ERROR ")) {
+        logWrite(
+            QString("Pinger reported error, command \"%1\", response \"%2\", ignoring.")
+            .arg(commandString(inFlightBatches.at(batchIndex)))
+            .arg(response),
+            true
+        );
+
+        inFlightBatches.removeAt(batchIndex);
+        result = true;
+    } else if (response.startsWith("failed")) {
+        logWrite(
+            QString("Pinger reported error, command \"%1\", response \"%2\", will retry.")
+            .arg(commandString(inFlightBatches.at(batchIndex)))
+            .arg(response),
+            true
+        );
+
+        requeueBatch(batchIndex);
+        if (!retryPending) {
+            retryPending = true;
+            retryTimer->start(pingerRetryDelay);
+        }
+    }
+
+    return result;
+}
+
+
+void PingServiceThreadPrivate::noPing(HostScheme::HostSchemeId hostSchemeId) {
+    HostDataByHostSchemeId::const_iterator it = hostDataByHostSchemeId.constFind(hostSchemeId);
+    if (it != hostDataByHostSchemeId.constEnd()) {
+        const HostData& hostData = it.value();
+        if (hostData.httpServiceThread() != nullptr && !hostData.hostScheme().isNull()) {
+            hostData.httpServiceThread()->checkNow(hostData.hostScheme());
+        }
+    }
+}
+
+
+void PingServiceThreadPrivate::issueSocketCommands() {
+    unsigned   batchLimit = currentPingerWindow > 1 ? maximumBatchHosts : 1;
+    QByteArray data;
+
+    while (!pendingCommands.isEmpty() && static_cast<unsigned>(inFlightBatches.size()) < currentPingerWindow) {
+        CommandBatch batch(nextSequenceNumber++, pendingCommands.takeFirst());
+        while (!pendingCommands.isEmpty()                                &&
+               static_cast<unsigned>(batch.entries().size()) < batchLimit &&
+               pendingCommands.first().command() == batch.command()       ) {
+            batch.append(pendingCommands.takeFirst());
+        }
+
+        QString cmd = commandString(batch);
+        if (logEnabled(LogLevel::DEBUG)) {
+            logMessage(LogLevel::DEBUG, QString("Issuing pinger command \"%1\"").arg(cmd));
+        }
+
+        data += cmd.toUtf8();
+        data += '\n';
+
+        inFlightBatches.append(batch);
+    }
+
+    if (!data.isEmpty()) {
+        socket->write(data);
+    }
+}
+
+
+void PingServiceThreadPrivate::issueRingCommands() {
+    unsigned long available     = ring.outboundAvailable();
+    unsigned long numberWritten = 0;
+
+    while (!pendingCommands.isEmpty() && numberWritten < available) {
+        CommandBatch        batch(nextSequenceNumber++, pendingCommands.takeFirst());
+        const CommandEntry& entry = batch.entries().first();
+
+        ring.write(
+            PingerRing::record(
+                ringRecordType(entry.command()),
+                batch.sequenceNumber(),
+                entry.hostId(),
+                entry.serverName().toUtf8()
+            )
+        );
+
+        inFlightBatches.append(batch);
+        ++numberWritten;
+    }
+
+    if (numberWritten > 0) {
+        ring.notifyPinger();
+    }
+}
+
+
+void PingServiceThreadPrivate::startRingHandshake() {
+    stopRing();
+
+    if (ring.open() && ring.sendDescriptors(static_cast<int>(socket->socketDescriptor()), QByteArray("S\n"))) {
+        ringHandshakePending = true;
+    } else {
+        logWrite(QString("Could not offer shared memory transport to pinger, using socket."), true);
+        ring.close();
+    }
+}
+
+
+void PingServiceThreadPrivate::stopRing() {
+    if (ringNotifier != nullptr) {
+        delete ringNotifier;
+        ringNotifier = nullptr;
+    }
+
+    ring.close();
+
+    ringActive           = false;
+    ringHandshakePending = false;
+}
+
+
+PingerRing::RecordType PingServiceThreadPrivate::ringRecordType(CommandEntry::Command command) {
+    PingerRing::RecordType result;
+
+    switch (command) {
+        case CommandEntry::Command::ADD: {
+            result = PingerRing::RecordType::ADD;
+            break;
+        }
+
+        case CommandEntry::Command::REMOVE: {
+            result = PingerRing::RecordType::REMOVE;
+            break;
+        }
+
+        case CommandEntry::Command::DEFUNCT: {
+            result = PingerRing::RecordType::DEFUNCT;
+            break;
+        }
+
+        default: {
+            logWrite(QString("Unexpected pinger command %1.").arg(static_cast<unsigned>(command)), true);
+            result = PingerRing::RecordType::REMOVE;
+            break;
+        }
+    }
+
+    return result;
+}
+
+
+void PingServiceThreadPrivate::requeueBatch(int batchIndex) {
+    const QList<CommandEntry>& entries = inFlightBatches.at(batchIndex).entries();
+    for (QList<CommandEntry>::const_iterator it=entries.constBegin(),end=entries.constEnd() ; it!=end ; ++it) {
+        pendingCommands.insert(requeuedCommands, *it);
+        ++requeuedCommands;
+    }
+
+    inFlightBatches.removeAt(batchIndex);
+}
+
+
+QString PingServiceThreadPrivate::serverName(const QString& hostName) const {
+    QString      result;
+    QHostAddress address;
+
+    if (currentDnsCache != nullptr && currentDnsCache->lookup(hostName, address)) {
+        result = address.toString();
+    } else {
+        result = hostName;
+    }
+
+    return result;
+}
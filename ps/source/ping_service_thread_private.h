@@ -32,14 +32,19 @@
 #include <QStringList>
 #include <QMutex>
 
+#include <cstdint>
+
 #include "customer.h"
 #include "host_scheme.h"
 #include "service_thread.h"
+#include "pinger_ring.h"
 
 class QLocalSocket;
+class QSocketNotifier;
 class QTimer;
 
 class HttpServiceThread;
+class DnsCache;
 
 /**
  * Class that communicates with the pinger server.
@@ -51,9 +56,11 @@ class PingServiceThreadPrivate:public QObject {
         /**
          * Constructor.
          *
-         * \param[in] parent Pointer to the parent object.
+         * \param[in] dnsCache The DNS cache used to resolve host names before handing them to the pinger.
+         *
+         * \param[in] parent   Pointer to the parent object.
          */
-        PingServiceThreadPrivate(QObject* parent = nullptr);
+        PingServiceThreadPrivate(DnsCache* dnsCache, QObject* parent = nullptr);
 
         ~PingServiceThreadPrivate() override;
 
@@ -89,6 +96,42 @@ class PingServiceThreadPrivate:public QObject {
          */
         void removeCustomer(Customer::CustomerId customerId);
 
+        /**
+         * Method you can use to hand a customer's hosts to a different HTTP service thread.  The hosts remain
+         * registered with the pinger.
+         *
+         * \param[in] customerId        The zero based ID of the customer that was moved.
+         *
+         * \param[in] httpServiceThread The service thread now managing the customer.
+         */
+        void moveCustomer(Customer::CustomerId customerId, HttpServiceThread* httpServiceThread);
+
+        /**
+         * Method you can use to obtain the most recent ping round trip time reported for a host.
+         *
+         * \param[in] hostSchemeId The host/scheme ID of the host.
+         *
+         * \return Returns the most recent round trip time, in microseconds.  A value of 0 is returned if no round
+         *         trip time has been reported.
+         */
+        unsigned long roundTripMicroseconds(HostScheme::HostSchemeId hostSchemeId) const;
+
+        /**
+         * Method you can use to determine the number of pinger commands waiting to be issued.  This method is thread
+         * safe.
+         *
+         * \return Returns the number of pending pinger commands.
+         */
+        unsigned long numberPendingCommands() const;
+
+        /**
+         * Method you can use to determine the number of pinger commands issued but not yet acknowledged by the
+         * pinger.  This method is thread safe.
+         *
+         * \return Returns the number of in-flight pinger commands.
+         */
+        unsigned long numberInFlightCommands() const;
+
     signals:
         /**
          * Signal that causes the next command to be started.
@@ -99,9 +142,15 @@ class PingServiceThreadPrivate:public QObject {
         /**
          * Slot you can use to connect to the pinger.
          *
-         * \param[in] socketName The name of the socket to connect to.
+         * \param[in] socketName   The name of the socket to connect to.
+         *
+         * \param[in] pingerWindow The maximum number of command lines that can be outstanding at once.  A value of 1
+         *                         selects the original protocol with one host per command and no correlation IDs.
+         *
+         * \param[in] sharedMemory If true, the shared memory ring transport will be negotiated with the pinger each
+         *                         time we connect.  The socket transport is used if negotiation fails.
          */
-        void connectToPinger(const QString& socketName);
+        void connectToPinger(const QString& socketName, unsigned pingerWindow = 1, bool sharedMemory = false);
 
         /**
          * Slot you can trigger to command this thread to go inactive.
@@ -125,10 +174,33 @@ class PingServiceThreadPrivate:public QObject {
         void readChannelFinished();
 
         /**
-         * Slot that issues the next command to the pinger.
+         * Slot that is triggered when the local socket connects to the pinger.
+         */
+        void socketConnected();
+
+        /**
+         * Slot that is triggered when the pinger signals that inbound ring records are available.
+         */
+        void ringRecordsAvailable();
+
+        /**
+         * Slot that issues as many pending commands to the pinger as the command window allows.
          */
         void issueNextCommand();
 
+        /**
+         * Slot that is triggered when the retry timer expires.  Resumes issuing commands after a failure.
+         */
+        void retryCommands();
+
+        /**
+         * Slot that is triggered when the DNS cache reports a new address for a host.  Hosts using the old address
+         * are re-added to the pinger.
+         *
+         * \param[in] hostName The host name whose address changed.
+         */
+        void hostAddressChanged(const QString& hostName);
+
     private:
         /**
          * The maximum allowed received message length, in bytes.
@@ -140,6 +212,17 @@ class PingServiceThreadPrivate:public QObject {
          */
         static constexpr unsigned pingerRetryDelay = 10000;
 
+        /**
+         * The maximum number of hosts carried by a single batched command line.  Only used when the command window
+         * is larger than 1.
+         */
+        static constexpr unsigned maximumBatchHosts = 64;
+
+        /**
+         * The maximum number of inbound ring records processed per pass.
+         */
+        static constexpr unsigned maximumRingBatch = 64;
+
         /**
          * Class used to track the status for this host.
          */
@@ -164,6 +247,8 @@ class PingServiceThreadPrivate:public QObject {
                         hostScheme
                     ),currentHttpServiceThread(
                         httpServiceThread
+                    ),currentRoundTrip(
+                        0
                     ) {}
 
                 /**
@@ -179,6 +264,8 @@ class PingServiceThreadPrivate:public QObject {
                         other.currentHostScheme
                     ),currentHttpServiceThread(
                         other.currentHttpServiceThread
+                    ),currentRoundTrip(
+                        other.currentRoundTrip
                     ) {}
 
                 ~HostData() = default;
@@ -210,6 +297,33 @@ class PingServiceThreadPrivate:public QObject {
                     return currentHttpServiceThread;
                 }
 
+                /**
+                 * Method you can use to change the HTTP service thread that is tracking the host/scheme.
+                 *
+                 * \param[in] newHttpServiceThread The new HTTP service thread.
+                 */
+                inline void setHttpServiceThread(HttpServiceThread* newHttpServiceThread) {
+                    currentHttpServiceThread = newHttpServiceThread;
+                }
+
+                /**
+                 * Method you can use to get the most recent ping round trip time for this host.
+                 *
+                 * \return Returns the round trip time, in microseconds.  A value of 0 indicates no reported value.
+                 */
+                inline unsigned long roundTripMicroseconds() const {
+                    return currentRoundTrip;
+                }
+
+                /**
+                 * Method you can use to update the most recent ping round trip time for this host.
+                 *
+                 * \param[in] newRoundTrip The new round trip time, in microseconds.
+                 */
+                inline void setRoundTripMicroseconds(unsigned long newRoundTrip) {
+                    currentRoundTrip = newRoundTrip;
+                }
+
                 /**
                  * Assignment operator.
                  *
@@ -221,6 +335,7 @@ class PingServiceThreadPrivate:public QObject {
                     currentUrl               = other.currentUrl;
                     currentHostScheme        = other.currentHostScheme;
                     currentHttpServiceThread = other.currentHttpServiceThread;
+                    currentRoundTrip         = other.currentRoundTrip;
 
                     return *this;
                 }
@@ -240,6 +355,11 @@ class PingServiceThreadPrivate:public QObject {
                  * The HTTP service thread tracking this host/scheme.
                  */
                 HttpServiceThread* currentHttpServiceThread;
+
+                /**
+                 * The most recent ping round trip time, in microseconds.
+                 */
+                unsigned long currentRoundTrip;
         };
 
         /**
@@ -394,11 +514,125 @@ class PingServiceThreadPrivate:public QObject {
                 QString currentServerName;
         };
 
+        /**
+         * Class that represents a group of commands sent to the pinger as a single command line.  All entries in a
+         * batch share the same command.
+         */
+        class CommandBatch {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] sequenceNumber The sequence number used to correlate the pinger's response.
+                 *
+                 * \param[in] firstEntry     The first command entry in this batch.
+                 */
+                inline CommandBatch(
+                        std::uint32_t       sequenceNumber,
+                        const CommandEntry& firstEntry
+                    ):currentSequenceNumber(
+                        sequenceNumber
+                    ),currentCommand(
+                        firstEntry.command()
+                    ) {
+                    currentEntries.append(firstEntry);
+                }
+
+                /**
+                 * Copy constructor.
+                 *
+                 * \param[in] other The instance to assign to this instance.
+                 */
+                inline CommandBatch(
+                        const CommandBatch& other
+                    ):currentSequenceNumber(
+                        other.currentSequenceNumber
+                    ),currentCommand(
+                        other.currentCommand
+                    ),currentEntries(
+                        other.currentEntries
+                    ) {}
+
+                ~CommandBatch() {}
+
+                /**
+                 * Method you can use to obtain the sequence number of this batch.
+                 *
+                 * \return Returns the sequence number.
+                 */
+                inline std::uint32_t sequenceNumber() const {
+                    return currentSequenceNumber;
+                }
+
+                /**
+                 * Method you can use to obtain the command shared by every entry in this batch.
+                 *
+                 * \return Returns the command value.
+                 */
+                inline CommandEntry::Command command() const {
+                    return currentCommand;
+                }
+
+                /**
+                 * Method you can use to obtain the entries in this batch.
+                 *
+                 * \return Returns the list of entries, in issue order.
+                 */
+                inline const QList<CommandEntry>& entries() const {
+                    return currentEntries;
+                }
+
+                /**
+                 * Method you can use to add an entry to this batch.  The entry must use the same command as the batch.
+                 *
+                 * \param[in] entry The entry to be added.
+                 */
+                inline void append(const CommandEntry& entry) {
+                    currentEntries.append(entry);
+                }
+
+                /**
+                 * Assignment operator
+                 *
+                 * \param[in] other The instance to assign to this instance.
+                 *
+                 * \return Returns a reference to this instance.
+                 */
+                CommandBatch& operator=(const CommandBatch& other) {
+                    currentSequenceNumber = other.currentSequenceNumber;
+                    currentCommand        = other.currentCommand;
+                    currentEntries        = other.currentEntries;
+
+                    return *this;
+                }
+
+            private:
+                /**
+                 * The batch sequence number.
+                 */
+                std::uint32_t currentSequenceNumber;
+
+                /**
+                 * The command shared by every entry.
+                 */
+                CommandEntry::Command currentCommand;
+
+                /**
+                 * The batched entries.
+                 */
+                QList<CommandEntry> currentEntries;
+        };
+
         /**
          * Type used to track pending commands.
          */
         typedef QList<CommandEntry> PendingCommands;
 
+        /**
+         * Type used to track command lines sent to the pinger that have not yet been acknowledged.
+         */
+        typedef QList<CommandBatch> InFlightBatches;
+
         /**
          * Type used to track hosts managed by each customer.
          */
@@ -417,13 +651,108 @@ class PingServiceThreadPrivate:public QObject {
         void issueCommand(const CommandEntry& commandEntry);
 
         /**
-         * Method that converts a command entry to a pinger command string.
+         * Method that converts a command batch to a pinger command string.  The batch sequence number is prepended
+         * when the command window is larger than 1.
+         *
+         * \param[in] commandBatch The batch to be converted.
+         *
+         * \return Returns the batch converted to a string.
+         */
+        QString commandString(const CommandBatch& commandBatch) const;
+
+        /**
+         * Method that locates the in-flight batch a pinger response refers to.  The correlation ID, if present, is
+         * stripped from the response.  Responses without a correlation ID refer to the oldest in-flight batch.
+         * This method expects the command mutex to be locked.
          *
-         * \param[in] commandEntry The entry to be converted.
+         * \param[in,out] response The received response.
          *
-         * \return Returns the entry converted to a string.
+         * \return Returns the index of the batch in the in-flight list.  A negative value is returned if no batch
+         *         matches the response.
          */
-        static QString commandString(const CommandEntry& commandEntry);
+        int responseBatch(QString& response) const;
+
+        /**
+         * Method that locates an in-flight batch by sequence number.  This method expects the command mutex to be
+         * locked.
+         *
+         * \param[in] sequenceNumber The sequence number of the desired batch.
+         *
+         * \return Returns the index of the batch in the in-flight list.  A negative value is returned if no batch
+         *         has the requested sequence number.
+         */
+        int batchIndex(std::uint32_t sequenceNumber) const;
+
+        /**
+         * Method that processes a pinger response to an in-flight batch.  This method expects the command mutex to
+         * be locked.
+         *
+         * \param[in] batchIndex The index of the batch in the in-flight list.
+         *
+         * \param[in] response   The response, with any correlation ID removed.
+         *
+         * \return Returns true if the batch was retired and more commands can be issued.  Returns false if the
+         *         batch is being retried or the response was not recognized.
+         */
+        bool handleResponse(int batchIndex, const QString& response);
+
+        /**
+         * Method that is called when the pinger reports that a host has stopped responding to pings.  The host's
+         * host/scheme is checked immediately.  This method expects the host/scheme mutex to be locked.
+         *
+         * \param[in] hostSchemeId The host/scheme ID of the host.
+         */
+        void noPing(HostScheme::HostSchemeId hostSchemeId);
+
+        /**
+         * Method that issues pending commands as text lines over the local socket.  This method expects the
+         * command mutex to be locked.
+         */
+        void issueSocketCommands();
+
+        /**
+         * Method that issues pending commands as records over the outbound ring.  This method expects the command
+         * mutex to be locked.
+         */
+        void issueRingCommands();
+
+        /**
+         * Method that creates the shared memory rings and offers them to the pinger.
+         */
+        void startRingHandshake();
+
+        /**
+         * Method that stops using the shared memory rings and releases them.
+         */
+        void stopRing();
+
+        /**
+         * Method that converts a command to a ring record type.
+         *
+         * \param[in] command The command to be converted.
+         *
+         * \return Returns the matching ring record type.
+         */
+        static PingerRing::RecordType ringRecordType(CommandEntry::Command command);
+
+        /**
+         * Method that places an in-flight batch back on the pending command list so that it is re-issued on the next
+         * retry.  Batches are re-queued ahead of newer pending commands, preserving their original order.  This
+         * method expects the command mutex to be locked.
+         *
+         * \param[in] batchIndex The index of the batch in the in-flight list.
+         */
+        void requeueBatch(int batchIndex);
+
+        /**
+         * Method that determines the server name to send to the pinger for a host.
+         *
+         * \param[in] hostName The host name.
+         *
+         * \return Returns the cached address for the host, if available.  Returns the host name if no address is
+         *         cached.
+         */
+        QString serverName(const QString& hostName) const;
 
         /**
          * The socket name of the socket to connect to.
@@ -440,6 +769,31 @@ class PingServiceThreadPrivate:public QObject {
          */
         QTimer* retryTimer;
 
+        /**
+         * The shared memory rings used by the ring transport.
+         */
+        PingerRing ring;
+
+        /**
+         * Notifier triggered when the pinger signals the inbound ring.
+         */
+        QSocketNotifier* ringNotifier;
+
+        /**
+         * Flag indicating if the shared memory ring transport should be negotiated.
+         */
+        bool currentSharedMemory;
+
+        /**
+         * Flag indicating that the shared memory ring transport is in use.
+         */
+        bool ringActive;
+
+        /**
+         * Flag indicating that we are waiting for the pinger to accept the shared memory rings.
+         */
+        bool ringHandshakePending;
+
         /**
          * Mutex used to keep our commands in a thread-safe manner.
          */
@@ -450,6 +804,36 @@ class PingServiceThreadPrivate:public QObject {
          */
         PendingCommands pendingCommands;
 
+        /**
+         * Value used to track command lines waiting for a pinger response.
+         */
+        InFlightBatches inFlightBatches;
+
+        /**
+         * The maximum number of command lines that can be in flight at once.
+         */
+        unsigned currentPingerWindow;
+
+        /**
+         * The sequence number to assign to the next command line.
+         */
+        std::uint32_t nextSequenceNumber;
+
+        /**
+         * The number of re-queued commands at the front of the pending command list.
+         */
+        int requeuedCommands;
+
+        /**
+         * Flag indicating that an issue pass has already been scheduled.
+         */
+        bool issueScheduled;
+
+        /**
+         * Flag indicating that we are waiting for the retry timer before issuing more commands.
+         */
+        bool retryPending;
+
         /**
          * Mutex used to keep our host/scheme structures thread safe.
          */
@@ -469,6 +853,11 @@ class PingServiceThreadPrivate:public QObject {
          * Flag indicating if the ping threads should be inactive.
          */
         bool activeMode;
+
+        /**
+         * The DNS cache used to resolve host names.
+         */
+        DnsCache* currentDnsCache;
 };
 
 #endif
@@ -0,0 +1,278 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref PingerRing class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QByteArray>
+
+#include <new>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "log.h"
+#include "pinger_ring.h"
+
+PingerRing::PingerRing() {
+    currentRegion                  = nullptr;
+    currentMemoryDescriptor        = -1;
+    currentOutboundEventDescriptor = -1;
+    currentInboundEventDescriptor  = -1;
+}
+
+
+PingerRing::~PingerRing() {
+    close();
+}
+
+
+bool PingerRing::open() {
+    close();
+
+    bool success = false;
+
+    currentMemoryDescriptor = memfd_create("ps_pinger_ring", MFD_CLOEXEC);
+    if (currentMemoryDescriptor >= 0) {
+        if (ftruncate(currentMemoryDescriptor, sizeof(Region)) == 0) {
+            void* region = mmap(
+                nullptr,
+                sizeof(Region),
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED,
+                currentMemoryDescriptor,
+                0
+            );
+
+            if (region != MAP_FAILED) {
+                currentOutboundEventDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+                currentInboundEventDescriptor  = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+                if (currentOutboundEventDescriptor >= 0 && currentInboundEventDescriptor >= 0) {
+                    currentRegion = new(region) Region;
+
+                    currentRegion->header.magic      = magicNumber;
+                    currentRegion->header.version    = layoutVersion;
+                    currentRegion->header.recordSize = sizeof(Record);
+                    currentRegion->header.capacity   = static_cast<std::uint32_t>(capacity);
+                    currentRegion->header.reserved   = 0;
+
+                    currentRegion->outbound.head.store(0, std::memory_order_relaxed);
+                    currentRegion->outbound.tail.store(0, std::memory_order_relaxed);
+                    currentRegion->inbound.head.store(0, std::memory_order_relaxed);
+                    currentRegion->inbound.tail.store(0, std::memory_order_release);
+
+                    success = true;
+                } else {
+                    munmap(region, sizeof(Region));
+                    logWrite(QString("Could not create pinger ring eventfds: %1").arg(std::strerror(errno)), true);
+                }
+            } else {
+                logWrite(QString("Could not map pinger ring: %1").arg(std::strerror(errno)), true);
+            }
+        } else {
+            logWrite(QString("Could not size pinger ring: %1").arg(std::strerror(errno)), true);
+        }
+    } else {
+        logWrite(QString("Could not create pinger ring: %1").arg(std::strerror(errno)), true);
+    }
+
+    if (!success) {
+        close();
+    }
+
+    return success;
+}
+
+
+void PingerRing::close() {
+    if (currentRegion != nullptr) {
+        currentRegion->~Region();
+        munmap(currentRegion, sizeof(Region));
+        currentRegion = nullptr;
+    }
+
+    if (currentMemoryDescriptor >= 0) {
+        ::close(currentMemoryDescriptor);
+        currentMemoryDescriptor = -1;
+    }
+
+    if (currentOutboundEventDescriptor >= 0) {
+        ::close(currentOutboundEventDescriptor);
+        currentOutboundEventDescriptor = -1;
+    }
+
+    if (currentInboundEventDescriptor >= 0) {
+        ::close(currentInboundEventDescriptor);
+        currentInboundEventDescriptor = -1;
+    }
+}
+
+
+bool PingerRing::sendDescriptors(int socketDescriptor, const QByteArray& message) const {
+    bool success = false;
+
+    if (currentRegion != nullptr) {
+        int descriptors[3] = { currentMemoryDescriptor, currentOutboundEventDescriptor, currentInboundEventDescriptor };
+
+        char control[CMSG_SPACE(sizeof(descriptors))];
+        std::memset(control, 0, sizeof(control));
+
+        struct iovec ioVector;
+        ioVector.iov_base = const_cast<char*>(message.constData());
+        ioVector.iov_len  = static_cast<std::size_t>(message.size());
+
+        struct msghdr messageHeader;
+        std::memset(&messageHeader, 0, sizeof(messageHeader));
+        messageHeader.msg_iov        = &ioVector;
+        messageHeader.msg_iovlen     = 1;
+        messageHeader.msg_control    = control;
+        messageHeader.msg_controllen = sizeof(control);
+
+        struct cmsghdr* controlHeader = CMSG_FIRSTHDR(&messageHeader);
+        controlHeader->cmsg_level = SOL_SOCKET;
+        controlHeader->cmsg_type  = SCM_RIGHTS;
+        controlHeader->cmsg_len   = CMSG_LEN(sizeof(descriptors));
+        std::memcpy(CMSG_DATA(controlHeader), descriptors, sizeof(descriptors));
+
+        ssize_t bytesSent = sendmsg(socketDescriptor, &messageHeader, MSG_NOSIGNAL);
+        if (bytesSent == static_cast<ssize_t>(message.size())) {
+            success = true;
+        } else {
+            logWrite(QString("Could not send pinger ring descriptors: %1").arg(std::strerror(errno)), true);
+        }
+    }
+
+    return success;
+}
+
+
+unsigned long PingerRing::outboundAvailable() const {
+    unsigned long result;
+
+    if (currentRegion != nullptr) {
+        std::uint64_t currentTail = currentRegion->outbound.tail.load(std::memory_order_relaxed);
+        std::uint64_t currentHead = currentRegion->outbound.head.load(std::memory_order_acquire);
+        result = capacity - static_cast<unsigned long>(currentTail - currentHead);
+    } else {
+        result = 0;
+    }
+
+    return result;
+}
+
+
+bool PingerRing::write(const Record& record) {
+    bool success;
+
+    if (currentRegion != nullptr) {
+        std::uint64_t currentTail = currentRegion->outbound.tail.load(std::memory_order_relaxed);
+        std::uint64_t currentHead = currentRegion->outbound.head.load(std::memory_order_acquire);
+
+        if (currentTail - currentHead < capacity) {
+            currentRegion->outbound.records[currentTail & mask] = record;
+            currentRegion->outbound.tail.store(currentTail + 1, std::memory_order_release);
+
+            success = true;
+        } else {
+            success = false;
+        }
+    } else {
+        success = false;
+    }
+
+    return success;
+}
+
+
+void PingerRing::notifyPinger() {
+    signalEvent(currentOutboundEventDescriptor);
+}
+
+
+void PingerRing::acknowledgeWakeup() {
+    if (currentInboundEventDescriptor >= 0) {
+        eventfd_t counter;
+        eventfd_read(currentInboundEventDescriptor, &counter);
+    }
+}
+
+
+unsigned long PingerRing::read(Record* records, unsigned long maximumRecords) {
+    unsigned long count;
+
+    if (currentRegion != nullptr) {
+        std::uint64_t currentHead = currentRegion->inbound.head.load(std::memory_order_relaxed);
+        std::uint64_t currentTail = currentRegion->inbound.tail.load(std::memory_order_acquire);
+
+        count = static_cast<unsigned long>(currentTail - currentHead);
+        if (count > maximumRecords) {
+            count = maximumRecords;
+        }
+
+        for (unsigned long i=0 ; i<count ; ++i) {
+            records[i] = currentRegion->inbound.records[(currentHead + i) & mask];
+        }
+
+        currentRegion->inbound.head.store(currentHead + count, std::memory_order_release);
+    } else {
+        count = 0;
+    }
+
+    return count;
+}
+
+
+PingerRing::Record PingerRing::record(
+        RecordType         type,
+        std::uint32_t      sequenceNumber,
+        std::uint32_t      hostId,
+        const QByteArray&  name
+    ) {
+    Record result;
+    std::memset(&result, 0, sizeof(result));
+
+    unsigned nameLength = static_cast<unsigned>(name.size());
+    if (nameLength > maximumNameLength) {
+        nameLength = maximumNameLength;
+    }
+
+    result.type           = type;
+    result.nameLength     = static_cast<std::uint16_t>(nameLength);
+    result.sequenceNumber = sequenceNumber;
+    result.hostId         = hostId;
+    std::memcpy(result.name, name.constData(), nameLength);
+
+    return result;
+}
+
+
+void PingerRing::signalEvent(int eventDescriptor) {
+    if (eventDescriptor >= 0) {
+        eventfd_write(eventDescriptor, 1);
+    }
+}
@@ -30,6 +30,7 @@
 #include <QNetworkInterface>
 
 #include <cstring>
+#include <algorithm>
 
 #include <crypto_helpers.h>
 
@@ -42,10 +43,15 @@
 #include "resources.h"
 #include "monitor.h"
 #include "host_scheme.h"
+#include "host_scheme_timer.h"
 #include "customer.h"
 #include "data_aggregator.h"
+#include "event_reporter.h"
 #include "service_thread_tracker.h"
 #include "inbound_rest_api.h"
+#include "state_snapshot.h"
+#include "thread_affinity.h"
+#include "http_engine.h"
 #include "ps.h"
 
 PollingServer::PollingServer(
@@ -57,9 +63,12 @@ PollingServer::PollingServer(
     currentConfigurationFilename = configurationFilename;
     fileSystemWatcher            = new QFileSystemWatcher(QStringList() << configurationFilename, this);
 
+    resourceSampler = new ResourceSampler(this);
+    resourceSampler->start();
+
     currentNetworkAccessManager = new QNetworkAccessManager(this);
 
-    inboundRestApiServer  = new RestApiInV1::Server(1, this);
+    inboundRestApiServer  = new RestApiInV1::Server(numberInboundRestApiThreads, this);
     inboundRestApiServer->setLoggingFunction(&logWrite);
 
     timeDeltaHandler = new RestApiInV1::TimeDeltaHandler;
@@ -80,6 +89,9 @@ PollingServer::PollingServer(
     serviceThreadTracker = new ServiceThreadTracker(dataAggregator, 0, this);
     dataAggregator->setServiceThreadTracker(serviceThreadTracker);
 
+    stateSnapshot = new StateSnapshot(serviceThreadTracker, this);
+    serviceThreadTracker->setStateSnapshot(stateSnapshot);
+
     inboundRestApi = new InboundRestApi(inboundRestApiServer, serviceThreadTracker, QByteArray(), this);
 
     connect(fileSystemWatcher, &QFileSystemWatcher::fileChanged, this, &PollingServer::configurationFileChanged);
@@ -88,6 +100,7 @@ PollingServer::PollingServer(
 
 
 PollingServer::~PollingServer() {
+    stateSnapshot->flush();
 }
 
 
@@ -115,6 +128,27 @@ void PollingServer::configurationFileChanged(const QString& /* filePath */) {
                                                : QJsonValue(QJsonObject());
 
             QString    pingerString          = jsonObject.value("pinger").toString("Pinger");
+            int        pingerWindow          = jsonObject.value("pinger_window").toInt(1);
+            QString    pingerTransport       = jsonObject.value("pinger_transport").toString("socket");
+            int        eventBatchesInFlight  = jsonObject.value("event_batches_in_flight").toInt(
+                EventReporter::defaultMaximumInFlightBatches
+            );
+            QString    stateSnapshotFile     = jsonObject.value("state_snapshot").toString();
+            QString    logLevelString        = jsonObject.value("log_level").toString("info");
+            QString    overloadPolicyString  = jsonObject.value("overload_policy").toString("spread");
+            bool       conditionalRequests   = jsonObject.value("conditional_requests").toBool(false);
+            bool       headersOnlyFetch      = jsonObject.value("headers_only_fetch").toBool(false);
+            QString    latencySpillFile      = jsonObject.value("latency_spill_file").toString();
+            int        latencyReportWindow   = jsonObject.value("latency_reports_in_flight").toInt(
+                DataAggregator::defaultMaximumInFlightReports
+            );
+            int        minimumServiceThreads = jsonObject.value("minimum_service_threads").toInt(0);
+            int        maximumServiceThreads = jsonObject.value("maximum_service_threads").toInt(0);
+            QString    serviceThreadCpuList  = jsonObject.value("service_thread_cpus").toString();
+            QString    pingThreadCpuList     = jsonObject.value("ping_thread_cpus").toString();
+            QString    httpEngineString      = jsonObject.value("http_engine").toString("qt");
+            bool       fetchCoalescing       = jsonObject.value("coalesce_fetches").toBool(false);
+            int        regionTransitions     = jsonObject.value("region_transition_cycles").toInt(0);
 
             QByteArray::FromBase64Result inboundKey = QByteArray::fromBase64Encoding(
                 encodedInboundApiKey.toUtf8(),
@@ -153,6 +187,48 @@ void PollingServer::configurationFileChanged(const QString& /* filePath */) {
                                         }
                                     }
 
+                                    bool     logLevelValid;
+                                    LogLevel logLevel = toLogLevel(logLevelString, &logLevelValid);
+                                    if (!logLevelValid) {
+                                        logWrite(QString("Invalid log level, using info."), true);
+                                    }
+
+                                    bool                            overloadPolicyValid;
+                                    HostSchemeTimer::OverloadPolicy overloadPolicy = HostSchemeTimer::toOverloadPolicy(
+                                        overloadPolicyString,
+                                        &overloadPolicyValid
+                                    );
+                                    if (!overloadPolicyValid) {
+                                        logWrite(QString("Invalid overload policy, using spread."), true);
+                                    }
+
+                                    bool                    serviceThreadCpusValid;
+                                    ThreadAffinity::CpuList serviceThreadCpus = ThreadAffinity::parse(
+                                        serviceThreadCpuList,
+                                        &serviceThreadCpusValid
+                                    );
+                                    if (!serviceThreadCpusValid) {
+                                        logWrite(QString("Invalid service thread CPU list, not pinning."), true);
+                                    }
+
+                                    bool                    pingThreadCpusValid;
+                                    ThreadAffinity::CpuList pingThreadCpus = ThreadAffinity::parse(
+                                        pingThreadCpuList,
+                                        &pingThreadCpusValid
+                                    );
+                                    if (!pingThreadCpusValid) {
+                                        logWrite(QString("Invalid ping thread CPU list, not pinning."), true);
+                                    }
+
+                                    bool                httpEngineValid;
+                                    HttpEngine::Backend httpEngineBackend = HttpEngine::toBackend(
+                                        httpEngineString,
+                                        &httpEngineValid
+                                    );
+                                    if (!httpEngineValid) {
+                                        logWrite(QString("Invalid HTTP engine, using qt."), true);
+                                    }
+
                                     if (success) {
                                         configureServer(
                                             inboundApiKey,
@@ -161,7 +237,24 @@ void PollingServer::configurationFileChanged(const QString& /* filePath */) {
                                             static_cast<unsigned short>(inboundPort),
                                             serverIdentifier,
                                             headers,
-                                            pingerString
+                                            pingerString,
+                                            static_cast<unsigned>(std::max(1, pingerWindow)),
+                                            pingerTransport == QString("shared_memory"),
+                                            static_cast<unsigned>(std::max(1, eventBatchesInFlight)),
+                                            stateSnapshotFile,
+                                            logLevel,
+                                            overloadPolicy,
+                                            conditionalRequests,
+                                            headersOnlyFetch,
+                                            latencySpillFile,
+                                            static_cast<unsigned>(std::max(1, latencyReportWindow)),
+                                            static_cast<unsigned>(std::max(0, minimumServiceThreads)),
+                                            static_cast<unsigned>(std::max(0, maximumServiceThreads)),
+                                            serviceThreadCpus,
+                                            pingThreadCpus,
+                                            httpEngineBackend,
+                                            fetchCoalescing,
+                                            static_cast<unsigned>(std::max(0, regionTransitions))
                                         );
                                     } else {
                                         logWrite(QString("Invalid header data."), true);
@@ -208,14 +301,33 @@ void PollingServer::configurationFileChanged(const QString& /* filePath */) {
 
 
 void PollingServer::configureServer(
-        const QByteArray&       inboundApiKey,
-        const QByteArray&       outboundApiKey,
-        const QString&          databaseServer,
-        unsigned short          inboundPort,
-        const QString&          serverIdentifier,
-        const Monitor::Headers& defaultHeaders,
-        const QString&          pingerString
+        const QByteArray&               inboundApiKey,
+        const QByteArray&               outboundApiKey,
+        const QString&                  databaseServer,
+        unsigned short                  inboundPort,
+        const QString&                  serverIdentifier,
+        const Monitor::Headers&         defaultHeaders,
+        const QString&                  pingerString,
+        unsigned                        pingerWindow,
+        bool                            pingerSharedMemory,
+        unsigned                        eventBatchesInFlight,
+        const QString&                  stateSnapshotFile,
+        LogLevel                        logLevel,
+        HostSchemeTimer::OverloadPolicy overloadPolicy,
+        bool                            conditionalRequests,
+        bool                            headersOnlyFetch,
+        const QString&                  latencySpillFile,
+        unsigned                        latencyReportWindow,
+        unsigned                        minimumThreads,
+        unsigned                        maximumThreads,
+        const ThreadAffinity::CpuList&  serviceThreadCpus,
+        const ThreadAffinity::CpuList&  pingThreadCpus,
+        HttpEngine::Backend             httpEngineBackend,
+        bool                            fetchCoalescing,
+        unsigned                        transitionCycles
     ) {
+    setLogLevel(logLevel);
+
     inboundRestApiServer->reconfigure(RestApiInV1::Server::defaultHostAddress, inboundPort);
     inboundRestApi->setSecret(inboundApiKey);
 
@@ -223,7 +335,20 @@ void PollingServer::configureServer(
     outboundRestApiServer->setDefaultSecret(outboundApiKey);
 
     dataAggregator->setServerIdentifier(serverIdentifier);
-    serviceThreadTracker->connectToPinger(pingerString);
+    dataAggregator->setMaximumInFlightEventBatches(eventBatchesInFlight);
+    dataAggregator->setLatencySpillFile(latencySpillFile);
+    dataAggregator->setMaximumInFlightReports(latencyReportWindow);
+    serviceThreadTracker->connectToPinger(pingerString, pingerWindow, pingerSharedMemory);
+    serviceThreadTracker->setThreadLimits(minimumThreads, maximumThreads);
+    serviceThreadTracker->setCpuAffinity(serviceThreadCpus, pingThreadCpus);
+    serviceThreadTracker->setHttpEngineBackend(httpEngineBackend);
+    serviceThreadTracker->setFetchCoalescingEnabled(fetchCoalescing);
 
     Monitor::setDefaultHeaders(defaultHeaders);
+    HostSchemeTimer::setOverloadPolicy(overloadPolicy);
+    HostSchemeTimer::setRegionTransitionCycles(transitionCycles);
+    Monitor::setConditionalRequestsEnabled(conditionalRequests);
+    Monitor::setHeadersOnlyFetchEnabled(headersOnlyFetch);
+
+    stateSnapshot->setFilename(stateSnapshotFile);
 }
@@ -0,0 +1,224 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref QtHttpEngine class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QVariant>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QSslConfiguration>
+#include <QSslCertificate>
+
+#include "http_engine.h"
+#include "qt_http_engine.h"
+
+/***********************************************************************************************************************
+* QtHttpEngine::QtRequest
+*/
+
+QtHttpEngine::QtRequest::QtRequest(
+        HttpEngine::Client* client,
+        QNetworkReply*      reply,
+        bool                reportProgress
+    ):Request(
+        client
+    ),reply(
+        reply
+    ),handshakePerformed(
+        false
+    ) {
+    // Limiting the read buffer causes the network stack to stop reading from the socket until the client consumes
+    // the data so a large body is never held in memory in its entirety.
+
+    reply->setReadBufferSize(readBufferSize);
+
+    connections.append(
+        QObject::connect(
+            reply,
+            &QNetworkReply::readyRead,
+            [this]() {
+                this->client()->requestDataAvailable(this);
+            }
+        )
+    );
+
+    connections.append(
+        QObject::connect(
+            reply,
+            &QNetworkReply::finished,
+            [this]() {
+                this->client()->requestFinished(this);
+            }
+        )
+    );
+
+    // QNetworkAccessManager does not report TCP connect completion so the TLS handshake is the only connection event
+    // we can observe.  It is recorded as the connection time so connection setup, including the handshake, is
+    // reported as a single phase.  The reply only reports the handshake on new connections so we always track it to
+    // avoid inspecting the peer certificate on reused connections.
+
+    connections.append(
+        QObject::connect(
+            reply,
+            &QNetworkReply::encrypted,
+            [this, reportProgress]() {
+                handshakePerformed = true;
+                recordConnected();
+
+                if (reportProgress) {
+                    this->client()->requestConnected(this);
+                }
+            }
+        )
+    );
+
+    connections.append(
+        QObject::connect(
+            reply,
+            &QNetworkReply::metaDataChanged,
+            [this, reportProgress]() {
+                recordFirstByte();
+
+                if (reportProgress) {
+                    this->client()->requestHeadersReceived(this);
+                }
+            }
+        )
+    );
+}
+
+
+QtHttpEngine::QtRequest::~QtRequest() {
+    for (  QList<QMetaObject::Connection>::const_iterator it = connections.constBegin(), end = connections.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        QObject::disconnect(*it);
+    }
+
+    // The request may be deleted from within one of the reply's signals so the reply is released from the event
+    // loop.
+
+    reply->abort();
+    reply->deleteLater();
+}
+
+
+int QtHttpEngine::QtRequest::statusCode() const {
+    return reply->attribute(QNetworkRequest::Attribute::HttpStatusCodeAttribute).toInt();
+}
+
+
+QByteArray QtHttpEngine::QtRequest::rawHeader(const QByteArray& headerName) const {
+    return reply->rawHeader(headerName);
+}
+
+
+long long QtHttpEngine::QtRequest::contentLength() const {
+    bool      contentLengthKnown;
+    qlonglong contentLength = reply->header(QNetworkRequest::KnownHeaders::ContentLengthHeader)
+                              .toLongLong(&contentLengthKnown);
+
+    return contentLengthKnown ? contentLength : -1;
+}
+
+
+QByteArray QtHttpEngine::QtRequest::readAll() {
+    return reply->readAll();
+}
+
+
+bool QtHttpEngine::QtRequest::failed() const {
+    return reply->error() != QNetworkReply::NetworkError::NoError;
+}
+
+
+QString QtHttpEngine::QtRequest::errorString() const {
+    return reply->errorString();
+}
+
+
+QSslCertificate QtHttpEngine::QtRequest::peerCertificate() const {
+    return reply->sslConfiguration().peerCertificate();
+}
+
+
+bool QtHttpEngine::QtRequest::newHandshake() const {
+    return handshakePerformed;
+}
+
+
+QByteArray QtHttpEngine::QtRequest::sslSessionTicket() const {
+    return reply->sslConfiguration().sessionTicket();
+}
+
+/***********************************************************************************************************************
+* QtHttpEngine
+*/
+
+QtHttpEngine::QtHttpEngine() {
+    networkAccessManager = new QNetworkAccessManager;
+    networkAccessManager->setRedirectPolicy(QNetworkRequest::RedirectPolicy::NoLessSafeRedirectPolicy);
+    networkAccessManager->setStrictTransportSecurityEnabled(true);
+}
+
+
+QtHttpEngine::~QtHttpEngine() {
+    delete networkAccessManager;
+}
+
+
+HttpEngine::Backend QtHttpEngine::backend() const {
+    return Backend::QT;
+}
+
+
+HttpEngine::Request* QtHttpEngine::startRequest(
+        HttpEngine::Client*    client,
+        const QNetworkRequest& request,
+        const QByteArray&      verb,
+        const QByteArray&      body,
+        bool                   reportProgress
+    ) {
+    // The dedicated methods are used for the standard verbs as QNetworkAccessManager treats custom verbs as opaque
+    // and would, for example, expect a body in response to a custom HEAD request.
+
+    QNetworkReply* reply;
+    if (verb == getVerb) {
+        reply = networkAccessManager->get(request);
+    } else if (verb == headVerb) {
+        reply = networkAccessManager->head(request);
+    } else if (verb == deleteVerb) {
+        reply = networkAccessManager->deleteResource(request);
+    } else if (verb == postVerb) {
+        reply = networkAccessManager->post(request, body);
+    } else if (verb == putVerb) {
+        reply = networkAccessManager->put(request, body);
+    } else if (body.isEmpty()) {
+        reply = networkAccessManager->sendCustomRequest(request, verb);
+    } else {
+        reply = networkAccessManager->sendCustomRequest(request, verb, body);
+    }
+
+    return new QtRequest(client, reply, reportProgress);
+}
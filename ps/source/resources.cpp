@@ -20,79 +20,362 @@
 
 #include <QtGlobal>
 #include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
 #include <QFile>
+#include <QDir>
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+#include <unistd.h>
 
-#include <cstdlib>
 #include "resources.h"
 
 static const QByteArray memoryTotalHeader("MemTotal:");
 static const QByteArray memoryAvailableHeader("MemAvailable:");
+static const QByteArray loopbackInterfaceName("lo");
 
-static unsigned numberCores = 0;
+static std::atomic<float>  publishedCpuUtilization(0);
+static std::atomic<float>  publishedMemoryUtilization(0);
+static std::atomic<float>  publishedNetworkUtilization(0);
+static std::atomic<double> publishedNetworkBytesPerSecond(0);
+static std::atomic<float>  publishedProcessCpuUtilization(0);
+static std::atomic<float>  publishedBusiestThreadCpuUtilization(0);
 
-float cpuUtilization() {
-    float  result;
+static std::atomic<unsigned long long> publishedResidentMemoryBytes(0);
 
-    double loadAverage[3];
-    int    numberSamples = getloadavg(loadAverage, 3);
-    if (numberSamples > 0) {
-        if (numberCores == 0) {
-            numberCores = static_cast<unsigned>(QThread::idealThreadCount());
-        }
+/**
+ * Function that reads the full contents of a small file, such as a /proc entry.
+ *
+ * \param[in] filename The file to be read.
+ *
+ * \return Returns the file contents.  An empty array is returned on error.
+ */
+static QByteArray readSmallFile(const QString& filename) {
+    QByteArray result;
+
+    QFile file(filename);
+    if (file.open(QFile::OpenModeFlag::ReadOnly)) {
+        result = file.readAll();
+        file.close();
+    }
+
+    return result;
+}
 
-        double loading = loadAverage[numberSamples - 1];
-        result = loading / numberCores;
-        if (result > 1.0) {
-            result = 1.0;
+
+/**
+ * Function that extracts the user plus system CPU time from the contents of a /proc stat entry.
+ *
+ * \param[in] contents The stat entry contents.
+ *
+ * \return Returns the CPU time, in clock ticks.
+ */
+static unsigned long long statCpuTicks(const QByteArray& contents) {
+    unsigned long long result = 0;
+
+    // The command name can contain spaces so we parse from the last closing parenthesis.  The user and system times
+    // are fields 14 and 15 which are at positions 11 and 12 after the command name.
+
+    int commandEnd = contents.lastIndexOf(')');
+    if (commandEnd >= 0) {
+        QList<QByteArray> fields = contents.mid(commandEnd + 1).simplified().split(' ');
+        if (fields.size() > 12) {
+            result = fields.at(11).toULongLong() + fields.at(12).toULongLong();
         }
-    } else {
-        result = 0;
     }
 
     return result;
 }
 
+/***********************************************************************************************************************
+* ResourceSampler
+*/
+
+ResourceSampler::ResourceSampler(QObject* parent):QThread(parent) {
+    ticksPerSecond       = sysconf(_SC_CLK_TCK);
+    numberCores          = static_cast<unsigned>(std::max(1, QThread::idealThreadCount()));
+    lastSystemTotal      = 0;
+    lastSystemIdle       = 0;
+    lastProcessTicks     = 0;
+    lastReceivedBytes    = 0;
+    lastTransmittedBytes = 0;
+
+    if (ticksPerSecond <= 0) {
+        ticksPerSecond = 100;
+    }
+}
+
+
+ResourceSampler::~ResourceSampler() {
+    requestInterruption();
+
+    wakeMutex.lock();
+    wakeCondition.wakeAll();
+    wakeMutex.unlock();
+
+    wait();
+}
+
+
+void ResourceSampler::run() {
+    sampleTimer.start();
+    sample();
+
+    while (!isInterruptionRequested()) {
+        wakeMutex.lock();
+        if (!isInterruptionRequested()) {
+            wakeCondition.wait(&wakeMutex, sampleInterval);
+        }
+        wakeMutex.unlock();
+
+        if (!isInterruptionRequested()) {
+            sample();
+        }
+    }
+}
+
+
+void ResourceSampler::sample() {
+    double elapsedSeconds = sampleTimer.restart() / 1000.0;
+
+    float  busiestThreadUsage = 0;
+    double bytesPerSecond     = 0;
+
+    float systemCpu  = sampleSystemCpu();
+    float processCpu = sampleProcessCpu(elapsedSeconds, busiestThreadUsage);
+    float memory     = sampleMemory();
+    float network    = sampleNetwork(elapsedSeconds, bytesPerSecond);
+
+    unsigned long long residentBytes = sampleResidentMemory();
+
+    publishedCpuUtilization.store(systemCpu, std::memory_order_relaxed);
+    publishedProcessCpuUtilization.store(processCpu, std::memory_order_relaxed);
+    publishedBusiestThreadCpuUtilization.store(busiestThreadUsage, std::memory_order_relaxed);
+    publishedMemoryUtilization.store(memory, std::memory_order_relaxed);
+    publishedNetworkUtilization.store(network, std::memory_order_relaxed);
+    publishedNetworkBytesPerSecond.store(bytesPerSecond, std::memory_order_relaxed);
+    publishedResidentMemoryBytes.store(residentBytes, std::memory_order_relaxed);
+}
+
 
 #if (defined(Q_OS_LINUX))
 
-    float memoryUtilization() {
-        float result;
+    float ResourceSampler::sampleSystemCpu() {
+        float result = 0;
+
+        QByteArray contents = readSmallFile("/proc/stat");
+        int        lineEnd  = contents.indexOf('\n');
+        QByteArray line     = contents.left(lineEnd).simplified();
+
+        if (line.startsWith("cpu ")) {
+            QList<QByteArray> fields = line.split(' ');
+            if (fields.size() > 8) {
+                unsigned long long total = 0;
+                for (unsigned i=1 ; i<=8 ; ++i) {
+                    total += fields.at(i).toULongLong();
+                }
+
+                unsigned long long idle = fields.at(4).toULongLong() + fields.at(5).toULongLong();
+
+                if (lastSystemTotal != 0 && total > lastSystemTotal) {
+                    unsigned long long totalDelta = total - lastSystemTotal;
+                    unsigned long long idleDelta  = idle >= lastSystemIdle ? idle - lastSystemIdle : 0;
+
+                    result = 1.0F - static_cast<float>(idleDelta) / static_cast<float>(totalDelta);
+                    if (result < 0) {
+                        result = 0;
+                    }
+                }
+
+                lastSystemTotal = total;
+                lastSystemIdle  = idle;
+            }
+        }
+
+        return result;
+    }
+
+
+    float ResourceSampler::sampleProcessCpu(double elapsedSeconds, float& busiestThreadUsage) {
+        float  result          = 0;
+        double ticksInInterval = elapsedSeconds * ticksPerSecond;
+
+        busiestThreadUsage = 0;
+
+        unsigned long long processTicks = statCpuTicks(readSmallFile("/proc/self/stat"));
+        if (lastProcessTicks != 0 && ticksInInterval > 0 && processTicks >= lastProcessTicks) {
+            result = static_cast<float>((processTicks - lastProcessTicks) / (ticksInInterval * numberCores));
+        }
+
+        lastProcessTicks = processTicks;
+
+        QHash<unsigned long, unsigned long long> threadTicks;
+        QStringList threadIds = QDir("/proc/self/task").entryList(QDir::Filter::Dirs | QDir::Filter::NoDotAndDotDot);
+        for (QStringList::const_iterator it=threadIds.constBegin(),end=threadIds.constEnd() ; it!=end ; ++it) {
+            bool          ok;
+            unsigned long threadId = it->toULong(&ok);
+            if (ok) {
+                unsigned long long ticks = statCpuTicks(readSmallFile(QString("/proc/self/task/%1/stat").arg(*it)));
+                threadTicks.insert(threadId, ticks);
+
+                QHash<unsigned long, unsigned long long>::const_iterator lastIterator = lastThreadTicks.constFind(
+                    threadId
+                );
+
+                if (lastIterator != lastThreadTicks.constEnd() &&
+                    ticksInInterval > 0                        &&
+                    ticks >= lastIterator.value()                 ) {
+                    float usage = static_cast<float>((ticks - lastIterator.value()) / ticksInInterval);
+                    if (usage > busiestThreadUsage) {
+                        busiestThreadUsage = usage;
+                    }
+                }
+            }
+        }
+
+        lastThreadTicks.swap(threadTicks);
 
-        QFile memoryInformation("/proc/meminfo");
-        bool  success = memoryInformation.open(QFile::OpenModeFlag::ReadOnly);
+        return result;
+    }
+
+
+    float ResourceSampler::sampleMemory() {
+        float result = 0;
+
+        QByteArray        contents = readSmallFile("/proc/meminfo");
+        QList<QByteArray> lines    = contents.split('\n');
 
-        QString memoryAvailable;
-        QString memoryTotal;
+        unsigned long long available      = 0;
+        unsigned long long total          = 0;
+        bool               foundAvailable = false;
+        bool               foundTotal     = false;
 
-        while (success && (memoryAvailable.isEmpty() || memoryTotal.isEmpty())) {
-            QByteArray line = memoryInformation.readLine();
-            if (!line.isEmpty()) {
-                if (line.startsWith(memoryTotalHeader)) {
-                    memoryTotal = QString::fromLocal8Bit(line);
-                } else if (line.startsWith(memoryAvailableHeader)) {
-                    memoryAvailable = QString::fromLocal8Bit(line);
+        QList<QByteArray>::const_iterator it  = lines.constBegin();
+        QList<QByteArray>::const_iterator end = lines.constEnd();
+        while ((!foundAvailable || !foundTotal) && it != end) {
+            const QByteArray& line = *it;
+            if (line.startsWith(memoryTotalHeader)) {
+                QList<QByteArray> fields = line.simplified().split(' ');
+                if (fields.size() >= 2) {
+                    total      = fields.at(1).toULongLong();
+                    foundTotal = true;
+                }
+            } else if (line.startsWith(memoryAvailableHeader)) {
+                QList<QByteArray> fields = line.simplified().split(' ');
+                if (fields.size() >= 2) {
+                    available      = fields.at(1).toULongLong();
+                    foundAvailable = true;
                 }
-            } else {
-                success = false;
             }
+
+            ++it;
+        }
+
+        if (foundAvailable && foundTotal && total > 0) {
+            result = 1.0F - static_cast<float>(static_cast<double>(available) / static_cast<double>(total));
         }
 
-        QStringList memoryAvailableParts = memoryAvailable.split(QChar(' '), Qt::SplitBehaviorFlags::SkipEmptyParts);
-        QStringList memoryTotalParts     = memoryTotal.split(QChar(' '), Qt::SplitBehaviorFlags::SkipEmptyParts);
+        return result;
+    }
+
+
+    unsigned long long ResourceSampler::sampleResidentMemory() {
+        unsigned long long result = 0;
+
+        QList<QByteArray> fields = readSmallFile("/proc/self/statm").simplified().split(' ');
+        if (fields.size() >= 2) {
+            result = fields.at(1).toULongLong() * static_cast<unsigned long long>(sysconf(_SC_PAGESIZE));
+        }
+
+        return result;
+    }
+
+
+    float ResourceSampler::sampleNetwork(double elapsedSeconds, double& bytesPerSecond) {
+        float result = 0;
+
+        bytesPerSecond = 0;
+
+        QByteArray        contents = readSmallFile("/proc/net/dev");
+        QList<QByteArray> lines    = contents.split('\n');
+
+        unsigned long long receivedBytes    = 0;
+        unsigned long long transmittedBytes = 0;
+        unsigned long long linkCapacity     = 0;
+
+        for (QList<QByteArray>::const_iterator it=lines.constBegin(),end=lines.constEnd() ; it!=end ; ++it) {
+            int separator = it->indexOf(':');
+            if (separator > 0) {
+                QByteArray interfaceName = it->left(separator).trimmed();
+                if (interfaceName != loopbackInterfaceName) {
+                    QList<QByteArray> fields = it->mid(separator + 1).simplified().split(' ');
+                    if (fields.size() > 8) {
+                        receivedBytes    += fields.at(0).toULongLong();
+                        transmittedBytes += fields.at(8).toULongLong();
+
+                        QHash<QByteArray, unsigned long>::const_iterator speedIterator = linkSpeeds.constFind(
+                            interfaceName
+                        );
+
+                        unsigned long speed;
+                        if (speedIterator != linkSpeeds.constEnd()) {
+                            speed = speedIterator.value();
+                        } else {
+                            speed = linkSpeed(interfaceName);
+                            linkSpeeds.insert(interfaceName, speed);
+                        }
+
+                        linkCapacity += speed * 125000ULL;
+                    }
+                }
+            }
+        }
 
-        if (memoryAvailableParts.size() == 3 && memoryTotalParts.size() == 3) {
-            bool               okAvailable;
-            bool               okTotal;
-            unsigned long long available = memoryAvailableParts.at(1).toULongLong(&okAvailable);
-            unsigned long long total     = memoryTotalParts.at(1).toULongLong(&okTotal);
+        bool primed = lastReceivedBytes != 0 || lastTransmittedBytes != 0;
+        if (primed                                    &&
+            elapsedSeconds > 0                        &&
+            receivedBytes >= lastReceivedBytes        &&
+            transmittedBytes >= lastTransmittedBytes     ) {
+            double receiveRate  = (receivedBytes - lastReceivedBytes) / elapsedSeconds;
+            double transmitRate = (transmittedBytes - lastTransmittedBytes) / elapsedSeconds;
 
-            if (okAvailable && okTotal) {
-                result = 1.0 - (static_cast<double>(available) / static_cast<double>(total));
-            } else {
-                result = 0;
+            bytesPerSecond = receiveRate + transmitRate;
+            if (linkCapacity > 0) {
+                result = static_cast<float>(std::max(receiveRate, transmitRate) / linkCapacity);
+                if (result > 1.0F) {
+                    result = 1.0F;
+                }
             }
-        } else {
-            result = 0;
+        }
+
+        lastReceivedBytes    = receivedBytes;
+        lastTransmittedBytes = transmittedBytes;
+
+        return result;
+    }
+
+
+    unsigned long ResourceSampler::linkSpeed(const QByteArray& interfaceName) {
+        unsigned long result = defaultLinkSpeed;
+
+        QByteArray contents = readSmallFile(
+            QString("/sys/class/net/%1/speed").arg(QString::fromLocal8Bit(interfaceName))
+        ).trimmed();
+
+        bool ok;
+        long speed = contents.toLong(&ok);
+        if (ok && speed > 0) {
+            result = static_cast<unsigned long>(speed);
         }
 
         return result;
@@ -100,12 +383,77 @@ float cpuUtilization() {
 
 #elif (defined(Q_OS_DARWIN))
 
-    float memoryUtilization() {
+    float ResourceSampler::sampleSystemCpu() {
+        return 0;
+    }
+
+
+    float ResourceSampler::sampleProcessCpu(double, float& busiestThreadUsage) {
+        busiestThreadUsage = 0;
+        return 0;
+    }
+
+
+    float ResourceSampler::sampleMemory() {
+        return 0;
+    }
+
+
+    unsigned long long ResourceSampler::sampleResidentMemory() {
+        return 0;
+    }
+
+
+    float ResourceSampler::sampleNetwork(double, double& bytesPerSecond) {
+        bytesPerSecond = 0;
         return 0;
     }
 
+
+    unsigned long ResourceSampler::linkSpeed(const QByteArray&) {
+        return defaultLinkSpeed;
+    }
+
 #else
 
     #error Unsupported platform
 
 #endif
+
+/***********************************************************************************************************************
+* Functions
+*/
+
+float cpuUtilization() {
+    return publishedCpuUtilization.load(std::memory_order_relaxed);
+}
+
+
+float memoryUtilization() {
+    return publishedMemoryUtilization.load(std::memory_order_relaxed);
+}
+
+
+unsigned long long residentMemoryBytes() {
+    return publishedResidentMemoryBytes.load(std::memory_order_relaxed);
+}
+
+
+float networkUtilization() {
+    return publishedNetworkUtilization.load(std::memory_order_relaxed);
+}
+
+
+double networkBytesPerSecond() {
+    return publishedNetworkBytesPerSecond.load(std::memory_order_relaxed);
+}
+
+
+float processCpuUtilization() {
+    return publishedProcessCpuUtilization.load(std::memory_order_relaxed);
+}
+
+
+float busiestThreadCpuUtilization() {
+    return publishedBusiestThreadCpuUtilization.load(std::memory_order_relaxed);
+}
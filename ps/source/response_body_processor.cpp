@@ -0,0 +1,145 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref ResponseBodyProcessor class.
+***********************************************************************************************************************/
+
+#include <QByteArray>
+#include <QVector>
+#include <QSharedPointer>
+#include <QCryptographicHash>
+
+#include "keyword_matcher.h"
+#include "monitor.h"
+#include "response_body_processor.h"
+
+ResponseBodyProcessor::ResponseBodyProcessor(
+        ResponseBodyProcessor::MonitorId                    monitorId,
+        ResponseBodyProcessor::ContentCheckMode             contentCheckMode,
+        const ResponseBodyProcessor::KeywordMatcherPointer& keywordMatcher,
+        unsigned long                                       maximumBodySize
+    ):currentContentCheckMode(
+        contentCheckMode
+    ),currentKeywordMatcher(
+        keywordMatcher
+    ),currentMatcherState(
+        KeywordMatcher::startState
+    ),currentTargetNumberKeywordsFound(
+        0
+    ),currentMaximumBodySize(
+        maximumBodySize
+    ),currentBytesProcessed(
+        0
+    ),currentBytesReceived(
+        0
+    ),currentVerdictKnown(
+        false
+    ),currentHash(
+        QCryptographicHash::Algorithm::Sha256
+    ),currentNumberKeywordsFound(
+        0
+    ) {
+    currentHash.addData(reinterpret_cast<const char*>(&monitorId), sizeof(MonitorId));
+
+    if (!currentKeywordMatcher.isNull()) {
+        unsigned numberKeywords = currentKeywordMatcher->numberKeywords();
+        currentKeywordFound.fill(false, static_cast<int>(numberKeywords));
+
+        if (currentContentCheckMode == ContentCheckMode::ANY_KEYWORDS) {
+            currentTargetNumberKeywordsFound = numberKeywords > 0 ? 1 : 0;
+        } else {
+            currentTargetNumberKeywordsFound = numberKeywords;
+        }
+
+        currentKeywordMatcher->markEmptyKeywords(currentKeywordFound, currentNumberKeywordsFound);
+    }
+}
+
+
+ResponseBodyProcessor::~ResponseBodyProcessor() {}
+
+
+void ResponseBodyProcessor::addData(const QByteArray& data) {
+    currentBytesReceived += static_cast<unsigned long long>(data.size());
+
+    if (!complete()) {
+        unsigned long remaining = currentMaximumBodySize - currentBytesProcessed;
+        unsigned long length    = static_cast<unsigned long>(data.size());
+        if (length > remaining) {
+            length = remaining;
+        }
+
+        if (currentContentCheckMode == ContentCheckMode::CONTENT_MATCH) {
+            currentHash.addData(data.constData(), static_cast<int>(length));
+        } else if (currentContentCheckMode == ContentCheckMode::SMART_CONTENT_MATCH) {
+            currentBuffer.append(data.constData(), static_cast<int>(length));
+        } else if (!currentKeywordMatcher.isNull()) {
+            currentMatcherState = currentKeywordMatcher->scan(
+                currentMatcherState,
+                data.constData(),
+                length,
+                currentKeywordFound,
+                currentNumberKeywordsFound,
+                currentTargetNumberKeywordsFound
+            );
+
+            currentVerdictKnown = (currentNumberKeywordsFound >= currentTargetNumberKeywordsFound);
+        }
+
+        currentBytesProcessed += length;
+    }
+}
+
+
+bool ResponseBodyProcessor::complete() const {
+    return currentVerdictKnown || currentBytesProcessed >= currentMaximumBodySize;
+}
+
+
+bool ResponseBodyProcessor::truncated() const {
+    return currentBytesReceived > currentBytesProcessed && !currentVerdictKnown;
+}
+
+
+unsigned long long ResponseBodyProcessor::bytesReceived() const {
+    return currentBytesReceived;
+}
+
+
+unsigned ResponseBodyProcessor::numberKeywords() const {
+    return static_cast<unsigned>(currentKeywordFound.size());
+}
+
+
+bool ResponseBodyProcessor::keywordFound(unsigned index) const {
+    return currentKeywordFound.at(index);
+}
+
+
+void ResponseBodyProcessor::addHashData(const QByteArray& data) {
+    currentHash.addData(data);
+}
+
+
+QByteArray ResponseBodyProcessor::hashResult() const {
+    return currentHash.result();
+}
+
+
+const QByteArray& ResponseBodyProcessor::bufferedData() const {
+    return currentBuffer;
+}
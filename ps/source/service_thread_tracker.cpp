@@ -19,21 +19,34 @@
 ***********************************************************************************************************************/
 
 #include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
 #include <QSharedPointer>
 #include <QHash>
 #include <QMultiMap>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
 
 #include <cstdint>
-#include <iostream>
+#include <algorithm>
 
+#include "log.h"
 #include "customer.h"
 #include "loading_data.h"
 #include "data_aggregator.h"
 #include "service_thread.h"
 #include "http_service_thread.h"
+#include "event_loop_lag_probe.h"
 #include "ping_service_thread.h"
+#include "dns_cache.h"
+#include "object_index.h"
+#include "state_snapshot.h"
+#include "thread_affinity.h"
+#include "host_scheme_timer.h"
 #include "service_thread_tracker.h"
 
 ServiceThreadTracker::ServiceThreadTracker(
@@ -49,26 +62,154 @@ ServiceThreadTracker::ServiceThreadTracker(
         maximumNumberThreads = static_cast<unsigned>(QThread::idealThreadCount());
     }
 
-    pingServiceThread = new PingServiceThread(this);
+    currentStatus                 = Status::INACTIVE;
+    pingerActive                  = false;
+    currentRegionIndex            = 0;
+    currentNumberRegions          = 0;
+    currentTimeToReady            = -1;
+    currentStateSnapshot          = nullptr;
+    currentLastBulkLoadDuration   = -1;
+    currentMinimumNumberThreads   = std::max(1U, maximumNumberThreads);
+    currentMaximumNumberThreads   = currentMinimumNumberThreads;
+    peakHealthyThreadRate         = 0;
+    numberQuietPasses             = 0;
+    currentHttpEngineBackend      = HttpEngine::Backend::QT;
+    currentFetchCoalescingEnabled = false;
+
+    dnsCache          = new DnsCache(this);
+    pingServiceThread = new PingServiceThread(dnsCache, this);
+
+    for (unsigned i=0 ; i<currentMinimumNumberThreads ; ++i) {
+        addHttpThread();
+    }
 
-    unsigned numberHttpThreads = std::max(1U, maximumNumberThreads);
-    for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
-        httpServiceThreads.append(new HttpServiceThread(dataAggregator, this));
+    uptimeTimer.start();
+
+    rebalanceTimer = new QTimer(this);
+    connect(rebalanceTimer, &QTimer::timeout, this, &ServiceThreadTracker::rebalance);
+    rebalanceTimer->start(rebalanceInterval);
+}
+
+
+ServiceThreadTracker::~ServiceThreadTracker() {
+    // The service threads use the DNS cache so they must be stopped before the cache is destroyed.
+
+    qDeleteAll(httpServiceThreads);
+    delete pingServiceThread;
+}
+
+
+void ServiceThreadTracker::connectToPinger(const QString& socketName, unsigned pingerWindow, bool sharedMemory) {
+    pingServiceThread->connectToPinger(socketName, pingerWindow, sharedMemory);
+}
+
+
+void ServiceThreadTracker::setThreadLimits(unsigned minimumNumberThreads, unsigned maximumNumberThreads) {
+    unsigned idealNumberThreads = static_cast<unsigned>(std::max(1, QThread::idealThreadCount()));
+    unsigned newMinimum         = minimumNumberThreads == 0 ? idealNumberThreads : minimumNumberThreads;
+    unsigned newMaximum         = maximumNumberThreads == 0 ? idealNumberThreads : maximumNumberThreads;
+
+    if (newMaximum < newMinimum) {
+        newMaximum = newMinimum;
+    }
+
+    if (newMinimum != currentMinimumNumberThreads || newMaximum != currentMaximumNumberThreads) {
+        currentMinimumNumberThreads = newMinimum;
+        currentMaximumNumberThreads = newMaximum;
+
+        logWrite(QString("HTTP service threads limited to %1 - %2").arg(newMinimum).arg(newMaximum));
+
+        while (static_cast<unsigned>(httpServiceThreads.size()) < currentMinimumNumberThreads) {
+            addHttpThread();
+        }
+
+        while (static_cast<unsigned>(httpServiceThreads.size()) > currentMaximumNumberThreads) {
+            unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
+            unsigned leastLoadedIndex  = 0;
+            for (unsigned i=1 ; i<numberHttpThreads ; ++i) {
+                if (httpServiceThreads.at(i)->hostSchemesPerSecond()                 <
+                    httpServiceThreads.at(leastLoadedIndex)->hostSchemesPerSecond()    ) {
+                    leastLoadedIndex = i;
+                }
+            }
+
+            retireHttpThread(leastLoadedIndex);
+        }
+    }
+}
+
+
+void ServiceThreadTracker::setCpuAffinity(
+        const ThreadAffinity::CpuList& httpThreadCpus,
+        const ThreadAffinity::CpuList& pingThreadCpus
+    ) {
+    if (httpThreadCpus != currentHttpThreadCpus) {
+        currentHttpThreadCpus = httpThreadCpus;
+
+        unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
+        for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+            if (currentHttpThreadCpus.isEmpty()) {
+                httpServiceThreads.at(i)->setCpuAffinity(ThreadAffinity::CpuList());
+            } else {
+                applyHttpThreadAffinity(i);
+            }
+        }
+
+        logWrite(
+            QString("HTTP service thread CPUs: %1")
+            .arg(httpThreadCpus.isEmpty() ? QString("any") : ThreadAffinity::toString(httpThreadCpus))
+        );
+    }
+
+    if (pingThreadCpus != currentPingThreadCpus) {
+        currentPingThreadCpus = pingThreadCpus;
+        pingServiceThread->setCpuAffinity(pingThreadCpus);
+
+        logWrite(
+            QString("Ping service thread CPUs: %1")
+            .arg(pingThreadCpus.isEmpty() ? QString("any") : ThreadAffinity::toString(pingThreadCpus))
+        );
     }
+}
+
+
+void ServiceThreadTracker::setHttpEngineBackend(HttpEngine::Backend backend) {
+    if (backend != currentHttpEngineBackend) {
+        currentHttpEngineBackend = backend;
+
+        unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
+        for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+            httpServiceThreads.at(i)->setHttpEngineBackend(backend);
+        }
 
-    currentStatus = Status::INACTIVE;
+        logWrite(QString("HTTP engine: %1").arg(HttpEngine::toString(backend)));
+    }
 }
 
 
-ServiceThreadTracker::~ServiceThreadTracker() {}
+void ServiceThreadTracker::setFetchCoalescingEnabled(bool nowEnabled) {
+    if (nowEnabled != currentFetchCoalescingEnabled) {
+        currentFetchCoalescingEnabled = nowEnabled;
 
+        unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
+        for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+            httpServiceThreads.at(i)->setFetchCoalescingEnabled(nowEnabled);
+        }
 
-void ServiceThreadTracker::connectToPinger(const QString& socketName) {
-    pingServiceThread->connectToPinger(socketName);
+        logWrite(QString("Fetch coalescing %1").arg(nowEnabled ? "enabled" : "disabled"));
+    }
+}
+
+
+unsigned ServiceThreadTracker::numberServiceThreads() const {
+    QReadLocker locker(&httpServiceThreadsLock);
+    return static_cast<unsigned>(httpServiceThreads.size());
 }
 
 
 QMultiMap<int, LoadingData> ServiceThreadTracker::loadingData() const {
+    QReadLocker locker(&httpServiceThreadsLock);
+
     QMultiMap<int, LoadingData> result;
 
     unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
@@ -81,7 +222,23 @@ QMultiMap<int, LoadingData> ServiceThreadTracker::loadingData() const {
 }
 
 
+QList<EventLoopLagProbe::LagData> ServiceThreadTracker::eventLoopLag() const {
+    QReadLocker locker(&httpServiceThreadsLock);
+
+    QList<EventLoopLagProbe::LagData> result;
+
+    unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
+    for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+        result.append(httpServiceThreads.at(i)->eventLoopLagProbe()->lagData());
+    }
+
+    return result;
+}
+
+
 float ServiceThreadTracker::monitorsPerSecond() const {
+    QReadLocker locker(&httpServiceThreadsLock);
+
     float    result            = 0;
     unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
     for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
@@ -93,12 +250,34 @@ float ServiceThreadTracker::monitorsPerSecond() const {
 }
 
 
+unsigned ServiceThreadTracker::sheddingLevel() const {
+    QReadLocker locker(&httpServiceThreadsLock);
+
+    unsigned result            = 0;
+    unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
+    for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+        result = std::max(result, httpServiceThreads.at(i)->sheddingLevel());
+    }
+
+    return result;
+}
+
+
+unsigned long ServiceThreadTracker::numberMonitors() const {
+    return objectIndex.numberMonitors();
+}
+
+
 ServiceThreadTracker::Status ServiceThreadTracker::status() const {
     return currentStatus;
 }
 
 
 void ServiceThreadTracker::addCustomer(Customer* customer) {
+    if (currentStateSnapshot != nullptr) {
+        currentStateSnapshot->restore(customer);
+    }
+
     HttpServiceThread* bestHttpThread        = httpServiceThreads.at(0);
     float              bestMonitorsPerSecond = bestHttpThread->hostSchemesPerSecond();
 
@@ -112,117 +291,324 @@ void ServiceThreadTracker::addCustomer(Customer* customer) {
         }
     }
 
-    bestHttpThread->addCustomer(customer);
+    addCustomer(customer, bestHttpThread);
+}
 
-    if (customer->supportsPingTesting()) {
-        Customer::CustomerId customerId  = customer->customerId();
-        QList<HostScheme*>   hostSchemes = customer->hostSchemes();
-        for (  QList<HostScheme*>::const_iterator it = hostSchemes.constBegin(), end = hostSchemes.constEnd()
-             ; it != end
-             ; ++it
-            ) {
-            HostScheme*     hostScheme = *it;
-            pingServiceThread->addHost(
-                customerId,
-                hostScheme->url(),
-                QPointer<HostScheme>(hostScheme),
-                bestHttpThread
+
+void ServiceThreadTracker::addCustomer(Customer* customer, HttpServiceThread* serviceThread) {
+    // The customer belongs to the service thread once handed off so everything we need from it is read first.
+
+    logWrite(
+        QString(
+            "Added customer %1, ping: %2, ssl: %3, latency: %4, mult-region: %5, latency-phases: %6, "
+            "latency-aggregation: %7, polling-interval: %8 sec, paused: %9, hosts: %10, monitors: %11, "
+            "confirmation-delay: %12 sec, maximum-recheck-interval: %13 sec, priority: %14"
+        ).arg(customer->customerId())
+         .arg(customer->supportsPingTesting() ? "true" : "false")
+         .arg(customer->supportsSslExpirationChecking() ? "true" : "false")
+         .arg(customer->supportsLatencyMeasurements() ? "true" : "false")
+         .arg(customer->supportsMultiRegionTesting() ? "true" : "false")
+         .arg(customer->supportsLatencyPhases() ? "true" : "false")
+         .arg(customer->supportsLatencyAggregation() ? "true" : "false")
+         .arg(customer->pollingInterval())
+         .arg(customer->paused() ? "true" : "false")
+         .arg(customer->numberHostSchemes())
+         .arg(customer->numberMonitors())
+         .arg(customer->confirmationDelay())
+         .arg(customer->maximumRecheckInterval())
+         .arg(Customer::toString(customer->priority()))
+    );
+
+    claimIds(customer);
+    addPingHosts(customer, serviceThread);
+    serviceThread->addCustomer(customer);
+}
+
+
+bool ServiceThreadTracker::addCustomers(const QList<Customer*>& customers) {
+    bool          success = true;
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+
+    // Customers are assigned to threads using the estimated rate of each customer as the threads' own service
+    // metrics are not updated until each thread's batch is registered.
+
+    unsigned                  numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
+    QVector<double>           threadRates(numberHttpThreads);
+    QVector<QList<Customer*>> customersByThread(numberHttpThreads);
+    for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+        threadRates[i] = httpServiceThreads.at(i)->hostSchemesPerSecond();
+    }
+
+    unsigned long numberMonitors = 0;
+    for (QList<Customer*>::const_iterator it=customers.constBegin(),end=customers.constEnd() ; it!=end ; ++it) {
+        Customer* customer = *it;
+        numberMonitors += customer->numberMonitors();
+
+        if (objectIndex.customer(customer->customerId()) != nullptr) {
+            if (!updateCustomer(customer)) {
+                success = false;
+            }
+        } else if (!idsAvailable(customer)) {
+            logWrite(
+                QString("Rejected customer %1, host/scheme or monitor IDs are claimed by another customer")
+                .arg(customer->customerId()),
+                true
             );
+
+            delete customer;
+            success = false;
+        } else {
+            unsigned bestIndex = 0;
+            for (unsigned i=1 ; i<numberHttpThreads ; ++i) {
+                if (threadRates.at(i) < threadRates.at(bestIndex)) {
+                    bestIndex = i;
+                }
+            }
+
+            if (currentStateSnapshot != nullptr) {
+                currentStateSnapshot->restore(customer);
+            }
+
+            claimIds(customer);
+
+            threadRates[bestIndex] += customerServiceRate(customer);
+            customersByThread[bestIndex].append(customer);
+        }
+    }
+
+    for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+        const QList<Customer*>& threadCustomers = customersByThread.at(i);
+        if (!threadCustomers.isEmpty()) {
+            HttpServiceThread* serviceThread = httpServiceThreads.at(i);
+            serviceThread->addCustomers(threadCustomers);
+
+            for (  QList<Customer*>::const_iterator it = threadCustomers.constBegin(), end = threadCustomers.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                addPingHosts(*it, serviceThread);
+            }
         }
     }
 
-    std::cout << "Added customer " << customer->customerId() << ", "
-              << "ping: " << (customer->supportsPingTesting() ? "true" : "false" ) << ", "
-              << "ssl: " << (customer->supportsSslExpirationChecking() ? "true" : "false" ) << ", "
-              << "latency: " << (customer->supportsLatencyMeasurements() ? "true" : "false") << ", "
-              << "mult-region: " << (customer->supportsMultiRegionTesting() ? "true" : "false") << ", "
-              << "polling-interval: " << customer->pollingInterval() << " sec, "
-              << "paused: " << (customer->paused() ? "true, " : "false, ")
-              << "hosts: " << customer->numberHostSchemes() << ", "
-              << "monitors: " << customer->numberMonitors() << std::endl;
+    currentLastBulkLoadDuration = loadTimer.elapsed();
+    if (currentTimeToReady < 0) {
+        currentTimeToReady = uptimeTimer.elapsed();
+    }
+
+    logWrite(
+        QString("Bulk loaded %1 customers, monitors: %2, duration: %3 msec, time-to-ready: %4 msec")
+        .arg(customers.size())
+        .arg(numberMonitors)
+        .arg(currentLastBulkLoadDuration)
+        .arg(currentTimeToReady)
+    );
+
+    return success;
+}
+
+
+bool ServiceThreadTracker::updateCustomer(Customer* customer) {
+    Customer::CustomerId customerId = customer->customerId();
+    bool                 success    = idsAvailable(customer);
+
+    if (!success) {
+        logWrite(
+            QString("Rejected customer %1, host/scheme or monitor IDs are claimed by another customer").arg(customerId),
+            true
+        );
+
+        delete customer;
+    } else {
+        if (currentStateSnapshot != nullptr) {
+            currentStateSnapshot->restore(customer);
+        }
+
+        Customer*          existingCustomer = objectIndex.customer(customerId);
+        HttpServiceThread* serviceThread    = objectIndex.customerServiceThread(customerId);
+
+        bool updated = false;
+        if (existingCustomer != nullptr                                                           &&
+            existingCustomer->pollingInterval() == customer->pollingInterval()                    &&
+            existingCustomer->supportsMultiRegionTesting() == customer->supportsMultiRegionTesting()
+           ) {
+            bool pingHostsUnchanged = samePingHosts(existingCustomer, customer);
+
+            // The new customer is consumed by a successful update so its IDs are claimed up front.  A failed update
+            // falls through to the replacement below, which claims them again.
+
+            claimIds(customer);
+            updated = serviceThread->updateCustomer(customer);
+            if (updated) {
+                if (!pingHostsUnchanged) {
+                    pingServiceThread->removeCustomer(customerId);
+                    addPingHosts(existingCustomer, serviceThread);
+                }
+
+                logWrite(
+                    QString("Updated customer %1, ping-hosts: %2, hosts: %3, monitors: %4")
+                    .arg(customerId)
+                    .arg(pingHostsUnchanged ? "unchanged" : "updated")
+                    .arg(existingCustomer->numberHostSchemes())
+                    .arg(existingCustomer->numberMonitors())
+                );
+            }
+        }
+
+        if (!updated) {
+            // Replacing the customer within the same thread keeps the removal and the add in that thread's command
+            // queue, in order.
+
+            removeCustomer(customerId);
+            if (serviceThread != nullptr) {
+                addCustomer(customer, serviceThread);
+            } else {
+                addCustomer(customer);
+            }
+        }
+    }
+
+    return success;
 }
 
 
 bool ServiceThreadTracker::removeCustomer(Customer::CustomerId customerId) {
-    bool     success           = false;
-    unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
-    unsigned index             = 0;
+    bool               success       = false;
+    HttpServiceThread* serviceThread = objectIndex.customerServiceThread(customerId);
 
-    while (!success && index < numberHttpThreads) {
-        HttpServiceThread* serviceThread = httpServiceThreads.at(index);
-        success = serviceThread->removeCustomer(customerId);
-        ++index;
+    if (serviceThread != nullptr) {
+        serviceThread->removeCustomer(customerId);
+        success = true;
     }
 
+    releaseIds(customerId);
     pingServiceThread->removeCustomer(customerId);
 
-    std::cout << "Removed customer " << customerId << std::endl;
+    logWrite(QString("Removed customer %1").arg(customerId));
 
     return success;
 }
 
 
 Customer* ServiceThreadTracker::getCustomer(Customer::CustomerId customerId) const {
-    Customer* customer          = nullptr;
-    unsigned  numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
-    unsigned  index             = 0;
+    return objectIndex.customer(customerId);
+}
 
-    while (customer == nullptr && index < numberHttpThreads) {
-        HttpServiceThread* serviceThread = httpServiceThreads.at(index);
-        customer = serviceThread->getCustomer(customerId);
-        ++index;
-    }
 
-    return customer;
+HostScheme* ServiceThreadTracker::getHostScheme(HostScheme::HostSchemeId hostSchemeId) const {
+    return objectIndex.hostScheme(hostSchemeId);
 }
 
 
-HostScheme* ServiceThreadTracker::getHostScheme(HostScheme::HostSchemeId hostSchemeId) const {
-    HostScheme* hostScheme        = nullptr;
-    unsigned    numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
-    unsigned    index             = 0;
+Monitor* ServiceThreadTracker::getMonitor(Monitor::MonitorId monitorId) const {
+    return objectIndex.monitor(monitorId);
+}
 
-    while (hostScheme == nullptr && index < numberHttpThreads) {
-        HttpServiceThread* serviceThread = httpServiceThreads.at(index);
-        hostScheme = serviceThread->getHostScheme(hostSchemeId);
-        ++index;
+
+bool ServiceThreadTracker::paused(Customer::CustomerId customerId) const {
+    bool               result        = false;
+    HttpServiceThread* serviceThread = objectIndex.customerServiceThread(customerId);
+    if (serviceThread != nullptr) {
+        result = serviceThread->paused(customerId);
     }
 
-    return hostScheme;
+    return result;
 }
 
 
-Monitor* ServiceThreadTracker::getMonitor(Monitor::MonitorId monitorId) const {
-    Monitor* monitor           = nullptr;
-    unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
-    unsigned index             = 0;
+void ServiceThreadTracker::setPaused(Customer::CustomerId customerId, bool nowPaused) {
+    HttpServiceThread* serviceThread = objectIndex.customerServiceThread(customerId);
+    if (serviceThread != nullptr) {
+        serviceThread->setPaused(customerId, nowPaused);
+    }
+}
+
+
+void ServiceThreadTracker::setStateSnapshot(StateSnapshot* stateSnapshot) {
+    currentStateSnapshot = stateSnapshot;
+}
+
+
+void ServiceThreadTracker::captureState(StateSnapshot* stateSnapshot) {
+    QReadLocker locker(&httpServiceThreadsLock);
 
-    while (monitor == nullptr && index < numberHttpThreads) {
-        HttpServiceThread* serviceThread = httpServiceThreads.at(index);
-        monitor = serviceThread->getMonitor(monitorId);
-        ++index;
+    for (  QList<HttpServiceThread*>::const_iterator it  = httpServiceThreads.constBegin(),
+                                                     end = httpServiceThreads.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        (*it)->captureState(stateSnapshot);
     }
+}
+
 
-    return monitor;
+long long ServiceThreadTracker::timeToReady() const {
+    return currentTimeToReady;
 }
 
 
-bool ServiceThreadTracker::paused(Customer::CustomerId customerId) const {
-    bool      result   = false;
-    Customer* customer = getCustomer(customerId);
-    if (customer != nullptr) {
-        result = customer->paused();
+long long ServiceThreadTracker::lastBulkLoadDuration() const {
+    return currentLastBulkLoadDuration;
+}
+
+
+ThreadMetrics::Totals ServiceThreadTracker::threadMetrics() const {
+    QReadLocker locker(&httpServiceThreadsLock);
+
+    ThreadMetrics::Totals result = retiredThreadMetrics;
+
+    unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
+    for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+        httpServiceThreads.at(i)->threadMetrics()->addTo(result);
     }
 
     return result;
 }
 
 
-void ServiceThreadTracker::setPaused(Customer::CustomerId customerId, bool nowPaused) {
-    Customer* customer = getCustomer(customerId);
-    if (customer != nullptr) {
-        customer->setPaused(nowPaused);
-    }
+unsigned long ServiceThreadTracker::latencyBacklog() const {
+    return currentDataAggregator->latencyBacklog();
+}
+
+
+unsigned long ServiceThreadTracker::latencySummaryBacklog() const {
+    return currentDataAggregator->latencySummaryBacklog();
+}
+
+
+unsigned long ServiceThreadTracker::spilledLatencyEntries() const {
+    return currentDataAggregator->spilledLatencyEntries();
+}
+
+
+unsigned long long ServiceThreadTracker::droppedLatencyEntries() const {
+    return currentDataAggregator->droppedLatencyEntries();
+}
+
+
+unsigned long ServiceThreadTracker::numberQueuedEvents() const {
+    return currentDataAggregator->numberQueuedEvents();
+}
+
+
+unsigned ServiceThreadTracker::numberInFlightEventBatches() const {
+    return currentDataAggregator->numberInFlightEventBatches();
+}
+
+
+unsigned ServiceThreadTracker::numberInFlightLatencyReports() const {
+    return currentDataAggregator->numberInFlightReports();
+}
+
+
+unsigned long ServiceThreadTracker::numberPendingPingerCommands() const {
+    return pingServiceThread->numberPendingCommands();
+}
+
+
+unsigned long ServiceThreadTracker::numberInFlightPingerCommands() const {
+    return pingServiceThread->numberInFlightCommands();
 }
 
 
@@ -244,24 +630,43 @@ QString ServiceThreadTracker::toString(Status status) {
 }
 
 void ServiceThreadTracker::updateRegionData(unsigned regionIndex, unsigned numberRegions) {
+    currentRegionIndex   = regionIndex;
+    currentNumberRegions = numberRegions;
+
     unsigned numberHttpThreads = static_cast<unsigned>(httpServiceThreads.size());
     for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
         HttpServiceThread* serviceThread = httpServiceThreads.at(i);
         serviceThread->updateRegionData(regionIndex, numberRegions);
     }
 
-    pingServiceThread->goActive();
+    // The region does not affect pinging so, when staged, an already active pinger keeps its hosts rather than
+    // having every host re-added.  The report is spread over a window so a fleet rebalance does not reach the
+    // database controller as a single burst.
+
+    bool staged = HostSchemeTimer::regionTransitionCycles() > 0;
+    if (!staged || !pingerActive) {
+        pingServiceThread->goActive();
+        pingerActive = true;
+    }
 
-    std::cout << "Changing region to " << regionIndex << " / " << numberRegions << std::endl;
+    logWrite(
+        QString("Changing region to %1 / %2%3")
+        .arg(regionIndex)
+        .arg(numberRegions)
+        .arg(staged ? QString(", staged") : QString())
+    );
 
     if (currentStatus != Status::ACTIVE) {
-        std::cout << "-------------------------------------------------------------------------------" << std::endl
-                  << toString(currentStatus).toLocal8Bit().data() << " -> ACTIVE (Region Change)" << std::endl
-                  << "-------------------------------------------------------------------------------" << std::endl;
+        logWrite(QString("Status change: %1 -> ACTIVE (Region Change)").arg(toString(currentStatus)));
     }
 
     currentStatus = Status::ACTIVE;
-    currentDataAggregator->sendReport();
+
+    if (staged) {
+        currentDataAggregator->sendReportWithin(regionChangeReportWindow);
+    } else {
+        currentDataAggregator->sendReport();
+    }
 }
 
 
@@ -277,13 +682,12 @@ void ServiceThreadTracker::goActive(bool nowActive) {
     }
 
     pingServiceThread->goInactive();
+    pingerActive = false;
 
     Status newStatus = nowActive ? Status::ACTIVE : Status::INACTIVE;
-    if (newStatus != currentStatus)
-    std::cout << "-------------------------------------------------------------------------------" << std::endl
-              << toString(currentStatus).toLocal8Bit().data() << " -> "
-                 << toString(newStatus).toLocal8Bit().data() << std::endl
-              << "-------------------------------------------------------------------------------" << std::endl;
+    if (newStatus != currentStatus) {
+        logWrite(QString("Status change: %1 -> %2").arg(toString(currentStatus), toString(newStatus)));
+    }
 
     currentStatus = newStatus;
 
@@ -294,3 +698,386 @@ void ServiceThreadTracker::goActive(bool nowActive) {
 void ServiceThreadTracker::goInactive(bool nowInactive) {
     goActive(!nowInactive);
 }
+
+
+void ServiceThreadTracker::rebalance() {
+    unsigned numberHttpThreads    = static_cast<unsigned>(httpServiceThreads.size());
+    int      sourceIndex          = -1;
+    bool     sourceOverloaded     = false;
+    double   sourceMissedFraction = 0;
+    double   sourceRate           = 0;
+    int      destinationIndex     = -1;
+    double   destinationRate      = 0;
+    double   totalRate            = 0;
+
+    for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+        HttpServiceThread* serviceThread = httpServiceThreads.at(i);
+        LoadingData        current       = serviceThread->cumulativeLoadingData();
+        LoadingData        last          = lastCumulativeLoadingData.at(i);
+
+        lastCumulativeLoadingData[i] = current;
+
+        unsigned long numberPolls    = current.numberPolledHostSchemes() - last.numberPolledHostSchemes();
+        unsigned long numberMissed   = current.numberMissedTimingMarks() - last.numberMissedTimingMarks();
+        double        sumTimingError = (
+              current.averageTimingError() * current.numberMissedTimingMarks()
+            - last.averageTimingError() * last.numberMissedTimingMarks()
+        );
+
+        double missedFraction = numberPolls > 0 ? static_cast<double>(numberMissed) / numberPolls : 0;
+        double timingError    = numberMissed > 0 ? sumTimingError / numberMissed : 0;
+        double rate           = serviceThread->hostSchemesPerSecond();
+        bool   overloaded     = (
+               missedFraction >= overloadedMissedTimingMarkFraction
+            && timingError >= overloadedTimingError
+        );
+
+        totalRate += rate;
+        if (numberPolls > 0 && missedFraction < overloadedMissedTimingMarkFraction && rate > peakHealthyThreadRate) {
+            peakHealthyThreadRate = rate;
+        }
+
+        if (overloaded) {
+            if (!sourceOverloaded || missedFraction > sourceMissedFraction) {
+                sourceIndex          = static_cast<int>(i);
+                sourceOverloaded     = true;
+                sourceMissedFraction = missedFraction;
+                sourceRate           = rate;
+            }
+        } else {
+            if (!sourceOverloaded && (sourceIndex < 0 || rate > sourceRate)) {
+                sourceIndex = static_cast<int>(i);
+                sourceRate  = rate;
+            }
+
+            if (destinationIndex < 0 || rate < destinationRate) {
+                destinationIndex = static_cast<int>(i);
+                destinationRate  = rate;
+            }
+        }
+    }
+
+    numberQuietPasses = sourceOverloaded ? 0 : numberQuietPasses + 1;
+
+    if (sourceOverloaded && destinationIndex < 0 && numberHttpThreads < currentMaximumNumberThreads) {
+        // Every thread is overloaded so the overloaded thread sheds load onto a new thread.
+
+        addHttpThread();
+
+        destinationIndex = static_cast<int>(numberHttpThreads);
+        destinationRate  = 0;
+
+        logWrite(QString("All HTTP service threads overloaded, added thread %1").arg(destinationIndex));
+    } else if (!sourceOverloaded                                                                   &&
+               numberQuietPasses >= retirePasses                                                   &&
+               numberHttpThreads > currentMinimumNumberThreads                                     &&
+               peakHealthyThreadRate > 0                                                           &&
+               totalRate <= retireUtilization * peakHealthyThreadRate * (numberHttpThreads - 1)    ) {
+        logWrite(
+            QString("HTTP service load %1 host/schemes per second fits fewer threads, retiring thread %2")
+            .arg(totalRate)
+            .arg(destinationIndex)
+        );
+
+        retireHttpThread(static_cast<unsigned>(destinationIndex));
+
+        numberQuietPasses = 0;
+        sourceIndex       = -1;
+    }
+
+    if (sourceIndex >= 0 && destinationIndex >= 0 && sourceIndex != destinationIndex) {
+        double excessRate;
+        if (sourceOverloaded) {
+            excessRate = std::max((sourceRate - destinationRate) / 2.0, sourceRate * overloadedShedFraction);
+        } else if (sourceRate - destinationRate > maximumLoadImbalance * sourceRate) {
+            excessRate = (sourceRate - destinationRate) / 2.0;
+        } else {
+            excessRate = 0;
+        }
+
+        if (excessRate > 0) {
+            migrateCustomers(static_cast<unsigned>(sourceIndex), static_cast<unsigned>(destinationIndex), excessRate);
+        }
+    }
+}
+
+
+void ServiceThreadTracker::migrateCustomers(unsigned sourceIndex, unsigned destinationIndex, double excessRate) {
+    HttpServiceThread* sourceThread      = httpServiceThreads.at(sourceIndex);
+    HttpServiceThread* destinationThread = httpServiceThreads.at(destinationIndex);
+
+    // The customers belong to the source thread so their rates are taken there.
+
+    QMultiMap<double, Customer::CustomerId> customerIdsByServiceRate;
+    QHash<Customer::CustomerId, double>     serviceRates = sourceThread->customerServiceRates(currentNumberRegions);
+    for (  QHash<Customer::CustomerId, double>::const_iterator it  = serviceRates.constBegin(),
+                                                               end = serviceRates.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        customerIdsByServiceRate.insert(it.value(), it.key());
+    }
+
+    unsigned                                                numberMigrated = 0;
+    QMultiMap<double, Customer::CustomerId>::const_iterator it             = customerIdsByServiceRate.constEnd();
+    QMultiMap<double, Customer::CustomerId>::const_iterator begin          = customerIdsByServiceRate.constBegin();
+    while (it != begin && numberMigrated < maximumMigrationsPerPass && excessRate > 0) {
+        --it;
+
+        double serviceRate = it.key();
+        if (serviceRate > 0 && serviceRate <= excessRate) {
+            if (migrateCustomer(it.value(), sourceThread, destinationThread)) {
+                excessRate -= serviceRate;
+                ++numberMigrated;
+            }
+        }
+    }
+
+    if (numberMigrated > 0) {
+        logWrite(
+            QString("Migrated %1 customers from thread %2 to thread %3")
+            .arg(numberMigrated)
+            .arg(sourceIndex)
+            .arg(destinationIndex)
+        );
+    }
+}
+
+
+bool ServiceThreadTracker::migrateCustomer(
+        Customer::CustomerId customerId,
+        HttpServiceThread*   sourceThread,
+        HttpServiceThread*   destinationThread
+    ) {
+    bool success = sourceThread->migrateCustomer(customerId, destinationThread);
+    if (success) {
+        // The pinger reports unreachable hosts to the thread servicing them so the hosts need to follow the customer.
+        pingServiceThread->moveCustomer(customerId, destinationThread);
+    }
+
+    return success;
+}
+
+
+void ServiceThreadTracker::addHttpThread() {
+    HttpServiceThread* serviceThread = new HttpServiceThread(currentDataAggregator, dnsCache, &objectIndex, this);
+
+    httpServiceThreadsLock.lockForWrite();
+    httpServiceThreads.append(serviceThread);
+    httpServiceThreadsLock.unlock();
+
+    lastCumulativeLoadingData.append(LoadingData());
+
+    if (currentNumberRegions > 0) {
+        serviceThread->updateRegionData(currentRegionIndex, currentNumberRegions);
+    }
+
+    if (currentStatus == Status::ACTIVE) {
+        serviceThread->goActive();
+    } else {
+        serviceThread->goInactive();
+    }
+
+    if (!currentHttpThreadCpus.isEmpty()) {
+        applyHttpThreadAffinity(static_cast<unsigned>(httpServiceThreads.size() - 1));
+    }
+
+    if (currentHttpEngineBackend != HttpEngine::Backend::QT) {
+        serviceThread->setHttpEngineBackend(currentHttpEngineBackend);
+    }
+
+    if (currentFetchCoalescingEnabled) {
+        serviceThread->setFetchCoalescingEnabled(true);
+    }
+}
+
+
+void ServiceThreadTracker::retireHttpThread(unsigned index) {
+    // The retired thread stays in the list until its customers are gone so other threads never see its counters
+    // missing from both the list and the retired totals.
+
+    QList<HttpServiceThread*> remainingThreads = httpServiceThreads;
+    HttpServiceThread*        retiredThread    = remainingThreads.takeAt(static_cast<int>(index));
+    lastCumulativeLoadingData.removeAt(static_cast<int>(index));
+
+    // Customers are assigned using their estimated rates, as in addCustomers, since the threads' own service
+    // metrics lag the migrations.  The customers belong to the retired thread so their rates are taken there.
+
+    unsigned        numberHttpThreads = static_cast<unsigned>(remainingThreads.size());
+    QVector<double> threadRates(numberHttpThreads);
+    for (unsigned i=0 ; i<numberHttpThreads ; ++i) {
+        threadRates[i] = remainingThreads.at(i)->hostSchemesPerSecond();
+    }
+
+    unsigned                            numberMigrated = 0;
+    QHash<Customer::CustomerId, double> serviceRates   = retiredThread->customerServiceRates(currentNumberRegions);
+    for (  QHash<Customer::CustomerId, double>::const_iterator it  = serviceRates.constBegin(),
+                                                               end = serviceRates.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        unsigned bestIndex = 0;
+        for (unsigned i=1 ; i<numberHttpThreads ; ++i) {
+            if (threadRates.at(i) < threadRates.at(bestIndex)) {
+                bestIndex = i;
+            }
+        }
+
+        if (migrateCustomer(it.key(), retiredThread, remainingThreads.at(bestIndex))) {
+            threadRates[bestIndex] += it.value();
+            ++numberMigrated;
+        }
+    }
+
+    // The retired thread's counters are kept so the totals reported by the metrics endpoint never go backwards.
+    // Nothing is in flight once the thread's customers are gone.  Other threads only touch the retired thread while
+    // holding the lock for read so, once it's out of the list, nothing else can reach it.
+
+    httpServiceThreadsLock.lockForWrite();
+
+    httpServiceThreads.removeAt(static_cast<int>(index));
+    retiredThread->threadMetrics()->addTo(retiredThreadMetrics);
+    retiredThreadMetrics.repliesInFlight = 0;
+
+    httpServiceThreadsLock.unlock();
+
+    delete retiredThread;
+
+    if (!currentHttpThreadCpus.isEmpty()) {
+        for (unsigned i=index ; i<numberHttpThreads ; ++i) {
+            applyHttpThreadAffinity(i);
+        }
+    }
+
+    logWrite(
+        QString("Retired HTTP service thread %1, migrated %2 customers, %3 threads remain")
+        .arg(index)
+        .arg(numberMigrated)
+        .arg(numberHttpThreads)
+    );
+}
+
+
+void ServiceThreadTracker::applyHttpThreadAffinity(unsigned index) {
+    unsigned cpu = currentHttpThreadCpus.at(static_cast<int>(index % currentHttpThreadCpus.size()));
+    httpServiceThreads.at(static_cast<int>(index))->setCpuAffinity(ThreadAffinity::CpuList() << cpu);
+}
+
+
+void ServiceThreadTracker::addPingHosts(Customer* customer, HttpServiceThread* serviceThread) {
+    if (customer->supportsPingTesting()) {
+        Customer::CustomerId customerId  = customer->customerId();
+        QList<HostScheme*>   hostSchemes = customer->hostSchemes();
+        for (  QList<HostScheme*>::const_iterator it = hostSchemes.constBegin(), end = hostSchemes.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            HostScheme*     hostScheme = *it;
+            pingServiceThread->addHost(
+                customerId,
+                hostScheme->url(),
+                QPointer<HostScheme>(hostScheme),
+                serviceThread
+            );
+        }
+    }
+}
+
+
+bool ServiceThreadTracker::samePingHosts(const Customer* existingCustomer, const Customer* newCustomer) {
+    bool result;
+
+    if (!existingCustomer->supportsPingTesting() && !newCustomer->supportsPingTesting()) {
+        result = true;
+    } else if (existingCustomer->supportsPingTesting() != newCustomer->supportsPingTesting() ||
+               existingCustomer->numberHostSchemes() != newCustomer->numberHostSchemes()
+              ) {
+        result = false;
+    } else {
+        QList<HostScheme*>                 hostSchemes = newCustomer->hostSchemes();
+        QList<HostScheme*>::const_iterator it          = hostSchemes.constBegin();
+        QList<HostScheme*>::const_iterator end         = hostSchemes.constEnd();
+
+        result = true;
+        while (result && it != end) {
+            const HostScheme* newHostScheme      = *it;
+            const HostScheme* existingHostScheme = existingCustomer->getHostScheme(newHostScheme->hostSchemeId());
+            result = existingHostScheme != nullptr && existingHostScheme->url() == newHostScheme->url();
+            ++it;
+        }
+    }
+
+    return result;
+}
+
+
+bool ServiceThreadTracker::idsAvailable(const Customer* customer) const {
+    Customer::CustomerId customerId = customer->customerId();
+    bool                 result     = true;
+
+    QList<HostScheme*>                 hostSchemes           = customer->hostSchemes();
+    QList<HostScheme*>::const_iterator hostSchemeIterator    = hostSchemes.constBegin();
+    QList<HostScheme*>::const_iterator hostSchemeEndIterator = hostSchemes.constEnd();
+    while (result && hostSchemeIterator != hostSchemeEndIterator) {
+        result = hostSchemeOwners.value((*hostSchemeIterator)->hostSchemeId(), customerId) == customerId;
+        ++hostSchemeIterator;
+    }
+
+    QList<Monitor*>                 monitors           = customer->monitors();
+    QList<Monitor*>::const_iterator monitorIterator    = monitors.constBegin();
+    QList<Monitor*>::const_iterator monitorEndIterator = monitors.constEnd();
+    while (result && monitorIterator != monitorEndIterator) {
+        result = monitorOwners.value((*monitorIterator)->monitorId(), customerId) == customerId;
+        ++monitorIterator;
+    }
+
+    return result;
+}
+
+
+void ServiceThreadTracker::claimIds(const Customer* customer) {
+    Customer::CustomerId customerId = customer->customerId();
+    releaseIds(customerId);
+
+    ClaimedIds& claimedIds = claimedIdsByCustomerId[customerId];
+
+    QList<HostScheme*> hostSchemes = customer->hostSchemes();
+    for (QList<HostScheme*>::const_iterator it=hostSchemes.constBegin(),end=hostSchemes.constEnd() ; it!=end ; ++it) {
+        HostScheme::HostSchemeId hostSchemeId = (*it)->hostSchemeId();
+        hostSchemeOwners.insert(hostSchemeId, customerId);
+        claimedIds.hostSchemeIds.append(hostSchemeId);
+    }
+
+    QList<Monitor*> monitors = customer->monitors();
+    for (QList<Monitor*>::const_iterator it=monitors.constBegin(),end=monitors.constEnd() ; it!=end ; ++it) {
+        Monitor::MonitorId monitorId = (*it)->monitorId();
+        monitorOwners.insert(monitorId, customerId);
+        claimedIds.monitorIds.append(monitorId);
+    }
+}
+
+
+void ServiceThreadTracker::releaseIds(Customer::CustomerId customerId) {
+    ClaimedIds claimedIds = claimedIdsByCustomerId.take(customerId);
+
+    for (  QList<HostScheme::HostSchemeId>::const_iterator it  = claimedIds.hostSchemeIds.constBegin(),
+                                                           end = claimedIds.hostSchemeIds.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        hostSchemeOwners.remove(*it);
+    }
+
+    for (  QList<Monitor::MonitorId>::const_iterator it  = claimedIds.monitorIds.constBegin(),
+                                                     end = claimedIds.monitorIds.constEnd()
+         ; it != end
+         ; ++it
+        ) {
+        monitorOwners.remove(*it);
+    }
+}
+
+
+double ServiceThreadTracker::customerServiceRate(const Customer* customer) const {
+    return customer->serviceRate(currentNumberRegions);
+}
@@ -0,0 +1,390 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref StateSnapshot class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QFile>
+#include <QTimer>
+#include <QDateTime>
+
+#include <cstdint>
+#include <cstring>
+
+#include "log.h"
+#include "monitor.h"
+#include "host_scheme.h"
+#include "customer.h"
+#include "service_thread_tracker.h"
+#include "state_snapshot.h"
+
+/***********************************************************************************************************************
+* StateSnapshot::MonitorState
+*/
+
+StateSnapshot::MonitorState::MonitorState() {
+    currentMonitorStatus = Monitor::MonitorStatus::UNKNOWN;
+}
+
+
+StateSnapshot::MonitorState::MonitorState(
+        Monitor::MonitorStatus monitorStatus,
+        const QByteArray&      contentHash
+    ):currentMonitorStatus(
+        monitorStatus
+    ),currentContentHash(
+        contentHash
+    ) {}
+
+/***********************************************************************************************************************
+* StateSnapshot
+*/
+
+StateSnapshot::StateSnapshot(
+        ServiceThreadTracker* serviceThreadTracker,
+        QObject*              parent
+    ):QObject(
+        parent
+    ),currentServiceThreadTracker(
+        serviceThreadTracker
+    ) {
+    mappedData = nullptr;
+    mappedSize = 0;
+
+    flushTimer = new QTimer(this);
+    connect(flushTimer, &QTimer::timeout, this, &StateSnapshot::flush);
+}
+
+
+StateSnapshot::~StateSnapshot() {
+    closeFile();
+}
+
+
+bool StateSnapshot::setFilename(const QString& newFilename) {
+    bool success = true;
+
+    if (newFilename != snapshotFile.fileName() || (!newFilename.isEmpty() && !snapshotFile.isOpen())) {
+        closeFile();
+
+        if (!newFilename.isEmpty()) {
+            snapshotFile.setFileName(newFilename);
+            success = snapshotFile.open(QFile::OpenModeFlag::ReadWrite);
+            if (success) {
+                if (snapshotFile.size() >= static_cast<qint64>(sizeof(FileHeader))) {
+                    success = mapFile(snapshotFile.size());
+                    if (success) {
+                        load();
+                    }
+                }
+
+                if (success) {
+                    flushTimer->start(flushInterval);
+                } else {
+                    logWrite(QString("Could not map state snapshot %1").arg(newFilename), true);
+                    closeFile();
+                }
+            } else {
+                logWrite(QString("Could not open state snapshot %1").arg(newFilename), true);
+                snapshotFile.setFileName(QString());
+            }
+        }
+    }
+
+    return success;
+}
+
+
+QString StateSnapshot::filename() const {
+    return snapshotFile.isOpen() ? snapshotFile.fileName() : QString();
+}
+
+
+bool StateSnapshot::isEnabled() const {
+    return snapshotFile.isOpen();
+}
+
+
+void StateSnapshot::restore(Customer* customer) {
+    if (!savedMonitorStates.isEmpty() || !savedSslExpirationTimestamps.isEmpty()) {
+        QList<HostScheme*> hostSchemes = customer->hostSchemes();
+        for (  QList<HostScheme*>::const_iterator hostSchemeIterator    = hostSchemes.constBegin(),
+                                                  hostSchemeEndIterator = hostSchemes.constEnd()
+             ; hostSchemeIterator != hostSchemeEndIterator
+             ; ++hostSchemeIterator
+            ) {
+            HostScheme* hostScheme = *hostSchemeIterator;
+
+            SslExpirationTimestamps::iterator sslIterator = savedSslExpirationTimestamps.find(
+                hostScheme->hostSchemeId()
+            );
+            if (sslIterator != savedSslExpirationTimestamps.end()) {
+                hostScheme->setSslExpirationTimestamp(sslIterator.value());
+                savedSslExpirationTimestamps.erase(sslIterator);
+            }
+
+            bool            restoredMonitors = false;
+            QList<Monitor*> monitors         = hostScheme->monitors();
+            for (  QList<Monitor*>::const_iterator monitorIterator    = monitors.constBegin(),
+                                                   monitorEndIterator = monitors.constEnd()
+                 ; monitorIterator != monitorEndIterator
+                 ; ++monitorIterator
+                ) {
+                Monitor*                monitor       = *monitorIterator;
+                MonitorStates::iterator stateIterator = savedMonitorStates.find(monitor->monitorId());
+                if (stateIterator != savedMonitorStates.end()) {
+                    const MonitorState& state = stateIterator.value();
+                    monitor->restoreState(state.monitorStatus(), state.contentHash());
+                    savedMonitorStates.erase(stateIterator);
+
+                    restoredMonitors = true;
+                }
+            }
+
+            if (restoredMonitors) {
+                hostScheme->resetNonResponsiveMonitors();
+            }
+        }
+    }
+}
+
+
+void StateSnapshot::recordMonitor(const Monitor* monitor) {
+    capturedMonitorStates.insert(
+        monitor->monitorId(),
+        MonitorState(monitor->monitorStatus(), monitor->contentHash())
+    );
+}
+
+
+void StateSnapshot::recordHostScheme(const HostScheme* hostScheme) {
+    unsigned long long sslExpirationTimestamp = hostScheme->sslExpirationTimestamp();
+    if (sslExpirationTimestamp != HostScheme::invalidSslExpirationTimestamp) {
+        capturedSslExpirationTimestamps.insert(hostScheme->hostSchemeId(), sslExpirationTimestamp);
+    }
+}
+
+
+void StateSnapshot::flush() {
+    if (snapshotFile.isOpen()) {
+        capturedMonitorStates.clear();
+        capturedSslExpirationTimestamps.clear();
+
+        currentServiceThreadTracker->captureState(this);
+
+        // State that was loaded but not yet claimed by a customer is carried forward so that a flush shortly after
+        // startup does not discard it.
+
+        for (  MonitorStates::const_iterator it  = savedMonitorStates.constBegin(),
+                                             end = savedMonitorStates.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            if (!capturedMonitorStates.contains(it.key())) {
+                capturedMonitorStates.insert(it.key(), it.value());
+            }
+        }
+
+        for (  SslExpirationTimestamps::const_iterator it  = savedSslExpirationTimestamps.constBegin(),
+                                                       end = savedSslExpirationTimestamps.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            if (!capturedSslExpirationTimestamps.contains(it.key())) {
+                capturedSslExpirationTimestamps.insert(it.key(), it.value());
+            }
+        }
+
+        std::uint32_t numberMonitors    = static_cast<std::uint32_t>(capturedMonitorStates.size());
+        std::uint32_t numberHostSchemes = static_cast<std::uint32_t>(capturedSslExpirationTimestamps.size());
+        qint64        requiredSize      =   sizeof(FileHeader)
+                                          + numberMonitors * sizeof(MonitorRecord)
+                                          + numberHostSchemes * sizeof(HostSchemeRecord);
+
+        bool success = requiredSize <= mappedSize || mapFile(requiredSize);
+        if (success) {
+            FileHeader* header = reinterpret_cast<FileHeader*>(mappedData);
+
+            // The header is marked invalid while the records are rewritten so a restart part way through a flush
+            // will ignore the snapshot rather than load a mix of old and new records.
+
+            header->valid = 0;
+
+            MonitorRecord* monitorRecord = reinterpret_cast<MonitorRecord*>(mappedData + sizeof(FileHeader));
+            for (  MonitorStates::const_iterator it  = capturedMonitorStates.constBegin(),
+                                                 end = capturedMonitorStates.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                const MonitorState& state      = it.value();
+                const QByteArray&   hash       = state.contentHash();
+                unsigned            hashLength = static_cast<unsigned>(hash.size());
+
+                // Hashes that do not fit are dropped.  The monitor will simply establish a new baseline.
+
+                if (hashLength > maximumHashLength) {
+                    hashLength = 0;
+                }
+
+                monitorRecord->monitorId  = it.key();
+                monitorRecord->status     = static_cast<std::uint8_t>(state.monitorStatus());
+                monitorRecord->hashLength = static_cast<std::uint8_t>(hashLength);
+                monitorRecord->reserved   = 0;
+                std::memcpy(monitorRecord->hash, hash.constData(), hashLength);
+                std::memset(monitorRecord->hash + hashLength, 0, maximumHashLength - hashLength);
+
+                ++monitorRecord;
+            }
+
+            HostSchemeRecord* hostSchemeRecord = reinterpret_cast<HostSchemeRecord*>(monitorRecord);
+            for (  SslExpirationTimestamps::const_iterator it  = capturedSslExpirationTimestamps.constBegin(),
+                                                           end = capturedSslExpirationTimestamps.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                hostSchemeRecord->hostSchemeId           = it.key();
+                hostSchemeRecord->reserved               = 0;
+                hostSchemeRecord->sslExpirationTimestamp = it.value();
+
+                ++hostSchemeRecord;
+            }
+
+            header->magic             = snapshotMagic;
+            header->version           = snapshotVersion;
+            header->numberMonitors    = numberMonitors;
+            header->numberHostSchemes = numberHostSchemes;
+            header->reserved          = 0;
+            header->timestamp         = static_cast<std::uint64_t>(QDateTime::currentSecsSinceEpoch());
+            header->valid             = 1;
+        } else {
+            logWrite(QString("Could not grow state snapshot %1").arg(snapshotFile.fileName()), true);
+        }
+
+        capturedMonitorStates.clear();
+        capturedSslExpirationTimestamps.clear();
+    }
+}
+
+
+void StateSnapshot::load() {
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(mappedData);
+
+    qint64 requiredSize =   sizeof(FileHeader)
+                          + header->numberMonitors * sizeof(MonitorRecord)
+                          + header->numberHostSchemes * sizeof(HostSchemeRecord);
+
+    unsigned long long currentTime = static_cast<unsigned long long>(QDateTime::currentSecsSinceEpoch());
+
+    if (header->magic == snapshotMagic     &&
+        header->version == snapshotVersion &&
+        header->valid != 0                 &&
+        requiredSize <= mappedSize         &&
+        header->timestamp + maximumSnapshotAge >= currentTime
+       ) {
+        savedMonitorStates.clear();
+        savedSslExpirationTimestamps.clear();
+
+        savedMonitorStates.reserve(static_cast<int>(header->numberMonitors));
+        const MonitorRecord* monitorRecord = reinterpret_cast<const MonitorRecord*>(mappedData + sizeof(FileHeader));
+        for (std::uint32_t i=0 ; i<header->numberMonitors ; ++i) {
+            if (monitorRecord->status == static_cast<std::uint8_t>(Monitor::MonitorStatus::WORKING) ||
+                monitorRecord->status == static_cast<std::uint8_t>(Monitor::MonitorStatus::FAILED)     ) {
+                unsigned hashLength = monitorRecord->hashLength;
+                if (hashLength > maximumHashLength) {
+                    hashLength = maximumHashLength;
+                }
+
+                savedMonitorStates.insert(
+                    monitorRecord->monitorId,
+                    MonitorState(
+                        static_cast<Monitor::MonitorStatus>(monitorRecord->status),
+                        QByteArray(reinterpret_cast<const char*>(monitorRecord->hash), hashLength)
+                    )
+                );
+            }
+
+            ++monitorRecord;
+        }
+
+        const HostSchemeRecord* hostSchemeRecord = reinterpret_cast<const HostSchemeRecord*>(monitorRecord);
+        for (std::uint32_t i=0 ; i<header->numberHostSchemes ; ++i) {
+            savedSslExpirationTimestamps.insert(
+                hostSchemeRecord->hostSchemeId,
+                hostSchemeRecord->sslExpirationTimestamp
+            );
+
+            ++hostSchemeRecord;
+        }
+
+        logWrite(
+            QString("Loaded state snapshot, %1 monitors, %2 host/schemes.")
+            .arg(savedMonitorStates.size())
+            .arg(savedSslExpirationTimestamps.size()),
+            false
+        );
+    } else {
+        logWrite(QString("Ignoring stale or incomplete state snapshot."), false);
+    }
+}
+
+
+bool StateSnapshot::mapFile(qint64 size) {
+    if (mappedData != nullptr) {
+        snapshotFile.unmap(mappedData);
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+
+    qint64 fileSize = snapshotFile.size();
+    bool   success  = true;
+    if (fileSize < size) {
+        fileSize = ((size + fileGrowthQuantum - 1) / fileGrowthQuantum) * fileGrowthQuantum;
+        success  = snapshotFile.resize(fileSize);
+    }
+
+    if (success) {
+        mappedData = snapshotFile.map(0, fileSize);
+        if (mappedData != nullptr) {
+            mappedSize = fileSize;
+        } else {
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+
+void StateSnapshot::closeFile() {
+    flushTimer->stop();
+
+    if (mappedData != nullptr) {
+        snapshotFile.unmap(mappedData);
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+
+    if (snapshotFile.isOpen()) {
+        snapshotFile.close();
+    }
+
+    snapshotFile.setFileName(QString());
+}
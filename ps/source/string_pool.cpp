@@ -0,0 +1,232 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref StringPool class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "string_pool.h"
+
+/***********************************************************************************************************************
+* InternedSet
+*/
+
+/**
+ * Template class that holds one set of interned values.
+ *
+ * \param T The type of value held by the pool.
+ */
+template<typename T> class InternedSet {
+    public:
+        /**
+         * The minimum number of entries that triggers a purge of unreferenced values.
+         */
+        static constexpr int minimumPurgeSize = 1024;
+
+        InternedSet():purgeSize(minimumPurgeSize),currentNumberBytes(0) {}
+
+        /**
+         * Method that interns a value.  The caller must hold the pool mutex.
+         *
+         * \param[in] value The value to be interned.
+         *
+         * \return Returns the interned value.
+         */
+        T intern(const T& value) {
+            T result;
+
+            typename QSet<T>::const_iterator it = values.constFind(value);
+            if (it != values.constEnd()) {
+                result = *it;
+            } else {
+                if (values.size() >= purgeSize) {
+                    purge();
+                }
+
+                values.insert(value);
+                currentNumberBytes += storage(value);
+
+                result = value;
+            }
+
+            return result;
+        }
+
+        /**
+         * Method that returns the number of interned values.
+         *
+         * \return Returns the number of interned values.
+         */
+        inline unsigned long size() const {
+            return static_cast<unsigned long>(values.size());
+        }
+
+        /**
+         * Method that returns the storage held by the pool.
+         *
+         * \return Returns the number of bytes held by the pool.
+         */
+        inline unsigned long long numberBytes() const {
+            return currentNumberBytes;
+        }
+
+    private:
+        /**
+         * Method that releases values referenced only by the pool.  The purge threshold is doubled relative to the
+         * surviving entries so purges are amortized over insertions.
+         */
+        void purge() {
+            typename QSet<T>::iterator it = values.begin();
+            while (it != values.end()) {
+                if (it->isDetached()) {
+                    currentNumberBytes -= storage(*it);
+                    it = values.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            purgeSize = values.size() >= minimumPurgeSize / 2 ? 2 * values.size() : minimumPurgeSize;
+        }
+
+        /**
+         * Method that estimates the storage used by a value.
+         *
+         * \param[in] value The value of interest.
+         *
+         * \return Returns the approximate number of bytes held by the value.
+         */
+        static unsigned long long storage(const QString& value) {
+            return sizeof(QChar) * static_cast<unsigned long long>(value.size());
+        }
+
+        /**
+         * Method that estimates the storage used by a value.
+         *
+         * \param[in] value The value of interest.
+         *
+         * \return Returns the approximate number of bytes held by the value.
+         */
+        static unsigned long long storage(const QByteArray& value) {
+            return static_cast<unsigned long long>(value.size());
+        }
+
+        /**
+         * Method that estimates the storage used by a value.  The entries are counted by their own pool.
+         *
+         * \param[in] value The value of interest.
+         *
+         * \return Returns the approximate number of bytes held by the value.
+         */
+        static unsigned long long storage(const QByteArrayList& value) {
+            return sizeof(void*) * static_cast<unsigned long long>(value.size());
+        }
+
+        /**
+         * The interned values.
+         */
+        QSet<T> values;
+
+        /**
+         * The pool size that triggers the next purge.
+         */
+        int purgeSize;
+
+        /**
+         * The approximate number of bytes held by the pool.
+         */
+        unsigned long long currentNumberBytes;
+};
+
+/***********************************************************************************************************************
+* Globals
+*/
+
+static QMutex               poolMutex;
+static InternedSet<QString>        stringPool;
+static InternedSet<QByteArray>     byteArrayPool;
+static InternedSet<QByteArrayList> byteArrayListPool;
+
+/***********************************************************************************************************************
+* StringPool
+*/
+
+QString StringPool::intern(const QString& value) {
+    QString result;
+
+    if (value.isEmpty()) {
+        result = value;
+    } else {
+        QMutexLocker locker(&poolMutex);
+        result = stringPool.intern(value);
+    }
+
+    return result;
+}
+
+
+QByteArray StringPool::intern(const QByteArray& value) {
+    QByteArray result;
+
+    if (value.isEmpty()) {
+        result = value;
+    } else {
+        QMutexLocker locker(&poolMutex);
+        result = byteArrayPool.intern(value);
+    }
+
+    return result;
+}
+
+
+QByteArrayList StringPool::intern(const QByteArrayList& value) {
+    QByteArrayList result;
+
+    if (value.isEmpty()) {
+        result = value;
+    } else {
+        QMutexLocker locker(&poolMutex);
+
+        QByteArrayList entries;
+        entries.reserve(value.size());
+        for (QByteArrayList::const_iterator it=value.constBegin(),end=value.constEnd() ; it!=end ; ++it) {
+            entries.append(it->isEmpty() ? *it : byteArrayPool.intern(*it));
+        }
+
+        result = byteArrayListPool.intern(entries);
+    }
+
+    return result;
+}
+
+
+unsigned long StringPool::numberEntries() {
+    QMutexLocker locker(&poolMutex);
+    return stringPool.size() + byteArrayPool.size() + byteArrayListPool.size();
+}
+
+
+unsigned long long StringPool::numberBytes() {
+    QMutexLocker locker(&poolMutex);
+    return stringPool.numberBytes() + byteArrayPool.numberBytes() + byteArrayListPool.numberBytes();
+}
@@ -0,0 +1,163 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref ThreadAffinity class.
+***********************************************************************************************************************/
+
+#include <QtGlobal>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QFile>
+
+#include <algorithm>
+
+#if (defined(Q_OS_LINUX))
+
+    #include <pthread.h>
+    #include <sched.h>
+
+#endif
+
+#include "thread_affinity.h"
+
+const QString ThreadAffinity::nodeDirectory("/sys/devices/system/node");
+
+ThreadAffinity::CpuList ThreadAffinity::parse(const QString& specification, bool* ok) {
+    CpuList result;
+    bool    success = true;
+
+    QStringList entries = specification.split(QChar(','), Qt::SkipEmptyParts);
+    for (  QStringList::const_iterator it = entries.constBegin(), end = entries.constEnd()
+         ; success && it != end
+         ; ++it
+        ) {
+        QString entry = it->trimmed();
+        if (entry.startsWith(QString("node"))) {
+            unsigned nodeIndex = entry.mid(4).toUInt(&success);
+            if (success) {
+                QFile file(QString("%1/node%2/cpulist").arg(nodeDirectory).arg(nodeIndex));
+                success = file.open(QFile::OpenModeFlag::ReadOnly);
+                if (success) {
+                    QString cpuList = QString::fromUtf8(file.readAll()).trimmed();
+                    file.close();
+
+                    // A node's cpulist never refers to another node so the recursion is at most one level deep.
+
+                    CpuList nodeCpus = parse(cpuList, &success);
+                    result.append(nodeCpus);
+                }
+            }
+        } else {
+            int dashIndex = entry.indexOf(QChar('-'));
+            if (dashIndex < 0) {
+                unsigned cpu = entry.toUInt(&success);
+                if (success) {
+                    result.append(cpu);
+                }
+            } else {
+                bool     lastOk;
+                unsigned first = entry.left(dashIndex).trimmed().toUInt(&success);
+                unsigned last  = entry.mid(dashIndex + 1).trimmed().toUInt(&lastOk);
+
+                success = success && lastOk && first <= last;
+                if (success) {
+                    for (unsigned cpu=first ; cpu<=last ; ++cpu) {
+                        result.append(cpu);
+                    }
+                }
+            }
+        }
+    }
+
+    if (success) {
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    } else {
+        result.clear();
+    }
+
+    if (ok != nullptr) {
+        *ok = success;
+    }
+
+    return result;
+}
+
+
+QString ThreadAffinity::toString(const CpuList& cpus) {
+    QStringList entries;
+
+    CpuList::const_iterator it  = cpus.constBegin();
+    CpuList::const_iterator end = cpus.constEnd();
+    while (it != end) {
+        unsigned first = *it;
+        unsigned last  = first;
+
+        ++it;
+        while (it != end && *it == last + 1) {
+            last = *it;
+            ++it;
+        }
+
+        if (first == last) {
+            entries.append(QString::number(first));
+        } else {
+            entries.append(QString("%1-%2").arg(first).arg(last));
+        }
+    }
+
+    return entries.join(QChar(','));
+}
+
+
+#if (defined(Q_OS_LINUX))
+
+    bool ThreadAffinity::apply(const CpuList& cpus) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+
+        if (cpus.isEmpty()) {
+            // The kernel restricts the mask to the CPUs available to the process.
+
+            for (unsigned cpu=0 ; cpu<CPU_SETSIZE ; ++cpu) {
+                CPU_SET(cpu, &cpuSet);
+            }
+        } else {
+            for (CpuList::const_iterator it=cpus.constBegin(),end=cpus.constEnd() ; it!=end ; ++it) {
+                if (*it < CPU_SETSIZE) {
+                    CPU_SET(*it, &cpuSet);
+                }
+            }
+        }
+
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) == 0;
+    }
+
+#elif (defined(Q_OS_DARWIN))
+
+    bool ThreadAffinity::apply(const CpuList&) {
+        // Darwin only supports affinity hints between threads, not pinning to specific CPUs.
+        return false;
+    }
+
+#else
+
+    #error Unsupported platform
+
+#endif
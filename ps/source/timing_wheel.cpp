@@ -0,0 +1,328 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref TimingWheel class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QTimer>
+#include <QDateTime>
+
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "timing_wheel.h"
+
+/***********************************************************************************************************************
+* TimingWheel::Entry
+*/
+
+TimingWheel::Entry::Entry(Client* client) {
+    currentClient   = client;
+    currentDeadline = 0;
+    next            = nullptr;
+    previous        = nullptr;
+    currentLevel    = notScheduled;
+    currentSlot     = 0;
+}
+
+
+TimingWheel::Entry::~Entry() {}
+
+/***********************************************************************************************************************
+* TimingWheel
+*/
+
+TimingWheel::TimingWheel(QObject* parent):QObject(parent) {
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::TimerType::PreciseTimer);
+
+    wheelTime     = currentTime();
+    armedWakeTime = timerNotArmed;
+    numberEntries = 0;
+    processing    = false;
+    firingEntries = nullptr;
+
+    std::memset(wheelSlots, 0, sizeof(wheelSlots));
+    std::memset(occupiedSlots, 0, sizeof(occupiedSlots));
+
+    connect(timer, &QTimer::timeout, this, &TimingWheel::processExpiredEntries);
+}
+
+
+TimingWheel::~TimingWheel() {}
+
+
+unsigned long long TimingWheel::currentTime() {
+    // The monotonic clock is slewed, but never stepped, by NTP.  Anchoring it to the wall clock once keeps phases
+    // aligned across regions while keeping deadlines immune to clock steps.
+
+    static const long long epochOffset = (
+          QDateTime::currentMSecsSinceEpoch()
+        - std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now().time_since_epoch()
+          ).count()
+    );
+
+    long long monotonicTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+
+    return static_cast<unsigned long long>(monotonicTime + epochOffset);
+}
+
+
+void TimingWheel::schedule(Entry* entry, unsigned long long deadline) {
+    if (entry->isScheduled()) {
+        unlink(entry);
+    } else {
+        if (numberEntries == 0 && !processing) {
+            wheelTime = currentTime();
+        }
+
+        ++numberEntries;
+    }
+
+    entry->currentDeadline = deadline;
+    insert(entry);
+
+    if (!processing && (armedWakeTime == timerNotArmed || deadline < armedWakeTime)) {
+        armTimer();
+    }
+}
+
+
+void TimingWheel::cancel(Entry* entry) {
+    if (entry->isScheduled()) {
+        unlink(entry);
+        entry->currentLevel = Entry::notScheduled;
+        --numberEntries;
+
+        if (numberEntries == 0 && !processing) {
+            timer->stop();
+            armedWakeTime = timerNotArmed;
+        }
+    }
+}
+
+
+unsigned long TimingWheel::numberScheduledEntries() const {
+    return numberEntries;
+}
+
+
+void TimingWheel::processExpiredEntries() {
+    unsigned long long now = currentTime();
+
+    processing    = true;
+    armedWakeTime = timerNotArmed;
+
+    while (wheelTime <= now) {
+        unsigned index = static_cast<unsigned>(wheelTime & slotMask);
+
+        if (index == 0) {
+            unsigned level = 1;
+            bool     done  = false;
+            while (!done && level < numberLevels) {
+                unsigned levelIndex = static_cast<unsigned>((wheelTime >> (slotBits * level)) & slotMask);
+                cascade(level, levelIndex);
+
+                done = (levelIndex != 0);
+                ++level;
+            }
+        }
+
+        Entry* entry = wheelSlots[0][index];
+        if (entry != nullptr) {
+            // Splice the entire slot onto the front of the firing list.
+
+            Entry* last = entry;
+            while (last->next != nullptr) {
+                last->currentLevel = firingLevel;
+                last = last->next;
+            }
+
+            last->currentLevel = firingLevel;
+            last->next         = firingEntries;
+            if (firingEntries != nullptr) {
+                firingEntries->previous = last;
+            }
+
+            firingEntries = entry;
+            entry->previous = nullptr;
+
+            wheelSlots[0][index] = nullptr;
+            occupiedSlots[0][index / 64] &= ~(1ULL << (index % 64));
+        }
+
+        int                nextSlot = nextOccupiedSlot(0, index + 1);
+        unsigned long long nextTime;
+        if (nextSlot >= 0) {
+            nextTime = wheelTime - index + static_cast<unsigned>(nextSlot);
+        } else {
+            nextTime = (wheelTime | slotMask) + 1;
+        }
+
+        wheelTime = std::min(nextTime, now + 1);
+    }
+
+    while (firingEntries != nullptr) {
+        Entry* entry = firingEntries;
+        unlink(entry);
+        entry->currentLevel = Entry::notScheduled;
+        --numberEntries;
+
+        entry->currentClient->timerExpired(entry, now);
+    }
+
+    processing = false;
+    armTimer();
+}
+
+
+void TimingWheel::insert(Entry* entry) {
+    unsigned long long deadline = std::max(entry->currentDeadline, wheelTime);
+    unsigned long long delta    = deadline - wheelTime;
+
+    unsigned level = 0;
+    while (level + 1 < numberLevels && delta >= (1ULL << (slotBits * (level + 1)))) {
+        ++level;
+    }
+
+    if (delta >= (1ULL << (slotBits * numberLevels))) {
+        // Entries beyond the range of the wheel are parked in the farthest slot and will be re-inserted when that
+        // slot cascades.
+        deadline = wheelTime + (1ULL << (slotBits * numberLevels)) - 1;
+    }
+
+    unsigned slot = static_cast<unsigned>((deadline >> (slotBits * level)) & slotMask);
+
+    entry->currentLevel = static_cast<std::int8_t>(level);
+    entry->currentSlot  = static_cast<std::uint8_t>(slot);
+    entry->previous     = nullptr;
+    entry->next         = wheelSlots[level][slot];
+
+    if (entry->next != nullptr) {
+        entry->next->previous = entry;
+    }
+
+    wheelSlots[level][slot] = entry;
+    occupiedSlots[level][slot / 64] |= (1ULL << (slot % 64));
+}
+
+
+void TimingWheel::unlink(Entry* entry) {
+    if (entry->next != nullptr) {
+        entry->next->previous = entry->previous;
+    }
+
+    if (entry->previous != nullptr) {
+        entry->previous->next = entry->next;
+    } else if (entry->currentLevel == firingLevel) {
+        firingEntries = entry->next;
+    } else {
+        unsigned level = static_cast<unsigned>(entry->currentLevel);
+        unsigned slot  = entry->currentSlot;
+
+        wheelSlots[level][slot] = entry->next;
+        if (entry->next == nullptr) {
+            occupiedSlots[level][slot / 64] &= ~(1ULL << (slot % 64));
+        }
+    }
+
+    entry->next     = nullptr;
+    entry->previous = nullptr;
+}
+
+
+void TimingWheel::cascade(unsigned level, unsigned slot) {
+    Entry* entry = wheelSlots[level][slot];
+
+    wheelSlots[level][slot] = nullptr;
+    occupiedSlots[level][slot / 64] &= ~(1ULL << (slot % 64));
+
+    while (entry != nullptr) {
+        Entry* next = entry->next;
+        insert(entry);
+        entry = next;
+    }
+}
+
+
+int TimingWheel::nextOccupiedSlot(unsigned level, unsigned from) const {
+    int result = -1;
+
+    if (from < slotsPerLevel) {
+        unsigned      word = from / 64;
+        std::uint64_t bits = occupiedSlots[level][word] & (~0ULL << (from % 64));
+
+        while (result < 0 && word < numberOccupancyWords) {
+            if (bits != 0) {
+                result = static_cast<int>(64 * word + __builtin_ctzll(bits));
+            } else {
+                ++word;
+                if (word < numberOccupancyWords) {
+                    bits = occupiedSlots[level][word];
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+
+unsigned long long TimingWheel::nextWakeTime() const {
+    unsigned long long result;
+
+    unsigned index    = static_cast<unsigned>(wheelTime & slotMask);
+    int      nextSlot = nextOccupiedSlot(0, index);
+    if (index == 0) {
+        // We're sitting on a cascade boundary that has not been processed yet.
+        result = wheelTime;
+    } else if (nextSlot >= 0) {
+        result = wheelTime - index + static_cast<unsigned>(nextSlot);
+    } else {
+        // Nothing pending in the lowest level, wake at the next cascade boundary.
+        result = (wheelTime | slotMask) + 1;
+    }
+
+    return result;
+}
+
+
+void TimingWheel::armTimer() {
+    if (numberEntries == 0) {
+        timer->stop();
+        armedWakeTime = timerNotArmed;
+    } else {
+        unsigned long long wakeTime = nextWakeTime();
+        unsigned long long now      = currentTime();
+        unsigned long long delay    = wakeTime > now ? wakeTime - now : 0;
+
+        if (delay > static_cast<unsigned long long>(std::numeric_limits<int>::max())) {
+            delay = static_cast<unsigned long long>(std::numeric_limits<int>::max());
+        }
+
+        armedWakeTime = wakeTime;
+        timer->start(static_cast<int>(delay));
+    }
+}
@@ -0,0 +1,197 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref CustomerGenerator class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef CUSTOMER_GENERATOR_H
+#define CUSTOMER_GENERATOR_H
+
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <rest_api_out_v1_server.h>
+#include <rest_api_out_v1_inesonic_rest_handler.h>
+
+/**
+ * Class that loads synthetic customers into the polling server under test through the inbound REST API and then
+ * activates the server.  Every customer owns a single host/scheme pointing at the mock target.  Monitors rotate
+ * through the no-check, content match, any keyword, all keyword and smart content match modes so each response
+ * processing path is exercised.
+ */
+class CustomerGenerator:public RestApiOutV1::InesonicRestHandler {
+    Q_OBJECT
+
+    public:
+        /**
+         * The maximum number of customers sent in a single request.
+         */
+        static constexpr unsigned customersPerRequest = 100;
+
+        /**
+         * Constructor
+         *
+         * \param[in] server              The outbound REST API server connected to the polling server under test.
+         *
+         * \param[in] targetUrl           The scheme, host and port of the mock target.
+         *
+         * \param[in] numberCustomers     The number of customers to generate.
+         *
+         * \param[in] monitorsPerCustomer The number of monitors per customer.
+         *
+         * \param[in] pollingInterval     The customer polling interval, in seconds.
+         *
+         * \param[in] parent              Pointer to the parent object.
+         */
+        CustomerGenerator(
+            RestApiOutV1::Server* server,
+            const QUrl&           targetUrl,
+            unsigned              numberCustomers,
+            unsigned              monitorsPerCustomer,
+            unsigned              pollingInterval,
+            QObject*              parent = nullptr
+        );
+
+        ~CustomerGenerator() override;
+
+        /**
+         * Method you can use to obtain the total number of monitors generated.
+         *
+         * \return Returns the total number of monitors.
+         */
+        unsigned long numberMonitors() const;
+
+    signals:
+        /**
+         * Signal that is emitted once every customer has been added and the server has been activated.
+         */
+        void ready();
+
+        /**
+         * Signal that is emitted if the polling server rejects a request.
+         *
+         * \param[in] reason A description of the failure.
+         */
+        void failed(const QString& reason);
+
+    public slots:
+        /**
+         * Slot you can use to start loading customers.
+         */
+        void start();
+
+    protected:
+        /**
+         * Method that is triggered whenever we receive a response from the polling server.
+         *
+         * \param[in] jsonData The JSON response.
+         */
+        void processJsonResponse(const QJsonDocument& jsonData) override;
+
+        /**
+         * Method that is triggered whenever a request fails.
+         *
+         * \param[in] errorString A string describing the error.
+         */
+        void processRequestFailed(const QString& errorString) override;
+
+    private:
+        /**
+         * Enumeration of loading steps.
+         */
+        enum class Step {
+            /**
+             * Indicates we're assigning the server to a single region.
+             */
+            REGION,
+
+            /**
+             * Indicates we're adding customers.
+             */
+            CUSTOMERS,
+
+            /**
+             * Indicates we're activating the server.
+             */
+            ACTIVATE,
+
+            /**
+             * Indicates we're finished.
+             */
+            DONE
+        };
+
+        /**
+         * Method that sends the request for the current step.
+         */
+        void sendRequest();
+
+        /**
+         * Method that generates the JSON description of a single customer.
+         *
+         * \param[in] customerId The customer ID.
+         *
+         * \return Returns the customer description.
+         */
+        QJsonObject generateCustomer(unsigned customerId) const;
+
+        /**
+         * Method that generates the JSON description of a single monitor.
+         *
+         * \param[in] monitorIndex The zero based index of the monitor within its customer.
+         *
+         * \return Returns the monitor description.
+         */
+        static QJsonObject generateMonitor(unsigned monitorIndex);
+
+        /**
+         * The scheme, host, and port of the mock target.
+         */
+        QUrl currentTargetUrl;
+
+        /**
+         * The number of customers to generate.
+         */
+        unsigned currentNumberCustomers;
+
+        /**
+         * The number of monitors per customer.
+         */
+        unsigned currentMonitorsPerCustomer;
+
+        /**
+         * The customer polling interval, in seconds.
+         */
+        unsigned currentPollingInterval;
+
+        /**
+         * The current loading step.
+         */
+        Step currentStep;
+
+        /**
+         * The next customer ID to be sent.
+         */
+        unsigned nextCustomerId;
+};
+
+#endif
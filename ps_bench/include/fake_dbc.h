@@ -0,0 +1,107 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref FakeDbc class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef FAKE_DBC_H
+#define FAKE_DBC_H
+
+#include <QObject>
+#include <QByteArray>
+
+#include "http_responder.h"
+
+class QTcpSocket;
+
+/**
+ * Stand-in for the database controller.  The class accepts and discards latency and event reports so the polling
+ * server under test can report at full rate without a real database behind it.  Requests are not authenticated.
+ */
+class FakeDbc:public HttpResponder {
+    Q_OBJECT
+
+    public:
+        /**
+         * Constructor
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        FakeDbc(QObject* parent = nullptr);
+
+        ~FakeDbc() override;
+
+        /**
+         * Method you can use to obtain the number of latency reports received.
+         *
+         * \return Returns the number of latency reports received.
+         */
+        unsigned long long numberLatencyReports() const;
+
+        /**
+         * Method you can use to obtain the total size of the latency reports received.
+         *
+         * \return Returns the total latency report size, in bytes.
+         */
+        unsigned long long latencyReportBytes() const;
+
+        /**
+         * Method you can use to obtain the number of event reports received.
+         *
+         * \return Returns the number of event reports received.
+         */
+        unsigned long long numberEventReports() const;
+
+    protected:
+        /**
+         * Method that is called for each complete request.
+         *
+         * \param[in] socket The socket the request was received on.
+         *
+         * \param[in] method The request method.
+         *
+         * \param[in] path   The request path.
+         *
+         * \param[in] body   The request body.
+         */
+        void processRequest(
+            QTcpSocket*       socket,
+            const QByteArray& method,
+            const QByteArray& path,
+            const QByteArray& body
+        ) override;
+
+    private:
+        /**
+         * The number of latency reports received.
+         */
+        unsigned long long currentNumberLatencyReports;
+
+        /**
+         * The total size of the latency reports received, in bytes.
+         */
+        unsigned long long currentLatencyReportBytes;
+
+        /**
+         * The number of event reports received.
+         */
+        unsigned long long currentNumberEventReports;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref HttpResponder class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef HTTP_RESPONDER_H
+#define HTTP_RESPONDER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QTcpServer>
+#include <QSslCertificate>
+#include <QSslKey>
+
+class QTcpSocket;
+
+/**
+ * Minimal HTTP/1.1 server used by the benchmark harness.  The class parses request lines, the Content-Length header
+ * and request bodies and keeps connections alive so the polling server can reuse them.  Derived classes decide how
+ * each request is answered.
+ */
+class HttpResponder:public QTcpServer {
+    Q_OBJECT
+
+    public:
+        /**
+         * Constructor
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        HttpResponder(QObject* parent = nullptr);
+
+        ~HttpResponder() override;
+
+        /**
+         * Method you can use to enable HTTPS.  Connections accepted after this call will be encrypted.
+         *
+         * \param[in] certificateFile The PEM encoded certificate file.
+         *
+         * \param[in] keyFile         The PEM encoded private key file.
+         *
+         * \return Returns true on success.  Returns false if either file could not be read.
+         */
+        bool setCertificate(const QString& certificateFile, const QString& keyFile);
+
+        /**
+         * Method you can use to determine if HTTPS is enabled.
+         *
+         * \return Returns true if HTTPS is enabled.
+         */
+        bool sslEnabled() const;
+
+        /**
+         * Method you can use to obtain the number of requests received so far.
+         *
+         * \return Returns the number of requests received.
+         */
+        unsigned long long numberRequests() const;
+
+    protected:
+        /**
+         * Method that is called for each new connection.
+         *
+         * \param[in] socketDescriptor The native socket descriptor for the accepted connection.
+         */
+        void incomingConnection(qintptr socketDescriptor) override;
+
+        /**
+         * Method that is called for each complete request.  Derived classes must eventually call
+         * \ref HttpResponder::sendResponse on the supplied socket.
+         *
+         * \param[in] socket The socket the request was received on.
+         *
+         * \param[in] method The request method.
+         *
+         * \param[in] path   The request path.
+         *
+         * \param[in] body   The request body.
+         */
+        virtual void processRequest(
+            QTcpSocket*       socket,
+            const QByteArray& method,
+            const QByteArray& path,
+            const QByteArray& body
+        ) = 0;
+
+        /**
+         * Method you can use to send a response.
+         *
+         * \param[in] socket      The socket to send the response on.
+         *
+         * \param[in] statusCode  The HTTP status code.
+         *
+         * \param[in] contentType The response content type.
+         *
+         * \param[in] body        The response body.
+         */
+        static void sendResponse(
+            QTcpSocket*       socket,
+            unsigned          statusCode,
+            const QByteArray& contentType,
+            const QByteArray& body
+        );
+
+    private slots:
+        /**
+         * Slot that is triggered when data is available on a connection.
+         */
+        void dataAvailable();
+
+        /**
+         * Slot that is triggered when a connection is closed.
+         */
+        void connectionClosed();
+
+    private:
+        /**
+         * Method that processes every complete request held in a connection's buffer.
+         *
+         * \param[in]     socket The socket the data was received on.
+         *
+         * \param[in,out] buffer The buffered data.  Processed requests are removed.
+         */
+        void processBuffer(QTcpSocket* socket, QByteArray& buffer);
+
+        /**
+         * The certificate used for HTTPS connections.
+         */
+        QSslCertificate currentCertificate;
+
+        /**
+         * The private key used for HTTPS connections.
+         */
+        QSslKey currentKey;
+
+        /**
+         * Unprocessed data received on each connection.
+         */
+        QHash<QTcpSocket*, QByteArray> currentBuffers;
+
+        /**
+         * The number of requests received so far.
+         */
+        unsigned long long currentNumberRequests;
+};
+
+#endif
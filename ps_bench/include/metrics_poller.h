@@ -0,0 +1,277 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref MetricsPoller class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef METRICS_POLLER_H
+#define METRICS_POLLER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+
+#include <rest_api_out_v1_server.h>
+#include <rest_api_out_v1_inesonic_rest_handler.h>
+
+/**
+ * Class that periodically samples the metrics endpoint of the polling server under test.
+ */
+class MetricsPoller:public RestApiOutV1::InesonicRestHandler {
+    Q_OBJECT
+
+    public:
+        /**
+         * Class holding a single metrics sample.
+         */
+        class Sample {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] elapsedSeconds     The time since sampling started, in seconds.
+                 *
+                 * \param[in] requestsStarted    The number of polls started by the server.
+                 *
+                 * \param[in] requestsFailed     The number of polls that failed.
+                 *
+                 * \param[in] averageTimingError The average timing error reported by the server, in seconds.
+                 *
+                 * \param[in] cpuSeconds         The CPU time consumed by the server since sampling started, in
+                 *                               seconds.
+                 *
+                 * \param[in] memoryPerMonitor   The resident memory per monitor, in bytes.
+                 */
+                Sample(
+                    double             elapsedSeconds = 0,
+                    unsigned long long requestsStarted = 0,
+                    unsigned long long requestsFailed = 0,
+                    double             averageTimingError = 0,
+                    double             cpuSeconds = 0,
+                    double             memoryPerMonitor = 0
+                ):currentElapsedSeconds(
+                    elapsedSeconds
+                ),currentRequestsStarted(
+                    requestsStarted
+                ),currentRequestsFailed(
+                    requestsFailed
+                ),currentAverageTimingError(
+                    averageTimingError
+                ),currentCpuSeconds(
+                    cpuSeconds
+                ),currentMemoryPerMonitor(
+                    memoryPerMonitor
+                ) {}
+
+                /**
+                 * Method you can use to obtain the time since sampling started.
+                 *
+                 * \return Returns the elapsed time, in seconds.
+                 */
+                inline double elapsedSeconds() const {
+                    return currentElapsedSeconds;
+                }
+
+                /**
+                 * Method you can use to obtain the number of polls started by the server.
+                 *
+                 * \return Returns the number of polls started.
+                 */
+                inline unsigned long long requestsStarted() const {
+                    return currentRequestsStarted;
+                }
+
+                /**
+                 * Method you can use to obtain the number of polls that failed.
+                 *
+                 * \return Returns the number of failed polls.
+                 */
+                inline unsigned long long requestsFailed() const {
+                    return currentRequestsFailed;
+                }
+
+                /**
+                 * Method you can use to obtain the average timing error reported by the server.
+                 *
+                 * \return Returns the average timing error, in seconds.
+                 */
+                inline double averageTimingError() const {
+                    return currentAverageTimingError;
+                }
+
+                /**
+                 * Method you can use to obtain the CPU time consumed by the server since sampling started.
+                 *
+                 * \return Returns the CPU time, in seconds.
+                 */
+                inline double cpuSeconds() const {
+                    return currentCpuSeconds;
+                }
+
+                /**
+                 * Method you can use to obtain the resident memory per monitor.
+                 *
+                 * \return Returns the memory per monitor, in bytes.
+                 */
+                inline double memoryPerMonitor() const {
+                    return currentMemoryPerMonitor;
+                }
+
+            private:
+                /**
+                 * The time since sampling started, in seconds.
+                 */
+                double currentElapsedSeconds;
+
+                /**
+                 * The number of polls started.
+                 */
+                unsigned long long currentRequestsStarted;
+
+                /**
+                 * The number of failed polls.
+                 */
+                unsigned long long currentRequestsFailed;
+
+                /**
+                 * The average timing error, in seconds.
+                 */
+                double currentAverageTimingError;
+
+                /**
+                 * The CPU time consumed, in seconds.
+                 */
+                double currentCpuSeconds;
+
+                /**
+                 * The resident memory per monitor, in bytes.
+                 */
+                double currentMemoryPerMonitor;
+        };
+
+        /**
+         * Constructor
+         *
+         * \param[in] server                The outbound REST API server connected to the polling server under test.
+         *
+         * \param[in] sampleIntervalSeconds The time between samples, in seconds.
+         *
+         * \param[in] processId             The process ID of the polling server.  When the server runs locally the
+         *                                  CPU time is read from /proc.  A value of 0 estimates the CPU time from the
+         *                                  reported system CPU utilization instead.
+         *
+         * \param[in] parent                Pointer to the parent object.
+         */
+        MetricsPoller(
+            RestApiOutV1::Server* server,
+            unsigned              sampleIntervalSeconds,
+            long long             processId,
+            QObject*              parent = nullptr
+        );
+
+        ~MetricsPoller() override;
+
+    signals:
+        /**
+         * Signal that is emitted each time a sample is received.
+         *
+         * \param[in] sample The new sample.
+         */
+        void sampleReceived(const MetricsPoller::Sample& sample);
+
+        /**
+         * Signal that is emitted if a metrics request fails.
+         *
+         * \param[in] reason A description of the failure.
+         */
+        void failed(const QString& reason);
+
+    public slots:
+        /**
+         * Slot you can use to start sampling.
+         */
+        void start();
+
+        /**
+         * Slot you can use to stop sampling.
+         */
+        void stop();
+
+    protected:
+        /**
+         * Method that is triggered whenever we receive a response from the polling server.
+         *
+         * \param[in] jsonData The JSON response.
+         */
+        void processJsonResponse(const QJsonDocument& jsonData) override;
+
+        /**
+         * Method that is triggered whenever a request fails.
+         *
+         * \param[in] errorString A string describing the error.
+         */
+        void processRequestFailed(const QString& errorString) override;
+
+    private slots:
+        /**
+         * Slot that requests a new sample.
+         */
+        void requestSample();
+
+    private:
+        /**
+         * Method that reads the CPU time consumed by the polling server process.
+         *
+         * \return Returns the CPU time, in seconds.  A negative value is returned if the time could not be read.
+         */
+        double processCpuSeconds() const;
+
+        /**
+         * The time between samples, in seconds.
+         */
+        unsigned currentSampleIntervalSeconds;
+
+        /**
+         * The polling server process ID.
+         */
+        long long currentProcessId;
+
+        /**
+         * Timer used to trigger samples.
+         */
+        QTimer sampleTimer;
+
+        /**
+         * Timer used to measure the time since sampling started.
+         */
+        QElapsedTimer elapsedTimer;
+
+        /**
+         * The previous sample.
+         */
+        Sample lastSample;
+
+        /**
+         * The process CPU time when sampling started, in seconds.
+         */
+        double startingCpuSeconds;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref MicroBenchmarks class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef MICRO_BENCHMARKS_H
+#define MICRO_BENCHMARKS_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+
+#include <functional>
+
+#include "data_aggregator.h"
+
+class ResponseBodyProcessor;
+
+/**
+ * Microbenchmarks for the CPU bound paths of the polling server: latency report serialization, keyword matching
+ * and response body hashing.  Each benchmark uses the same polling server code that services live requests.
+ */
+class MicroBenchmarks {
+    public:
+        /**
+         * Class holding the result of a single benchmark.
+         */
+        class Result {
+            public:
+                /**
+                 * Constructor
+                 *
+                 * \param[in] name                    The benchmark name.
+                 *
+                 * \param[in] iterations              The number of iterations run.
+                 *
+                 * \param[in] nanosecondsPerIteration The average time per iteration, in nanoseconds.
+                 *
+                 * \param[in] bytesPerIteration       The number of bytes processed or produced per iteration.
+                 */
+                Result(
+                    const QString&     name = QString(),
+                    unsigned long long iterations = 0,
+                    double             nanosecondsPerIteration = 0,
+                    unsigned long long bytesPerIteration = 0
+                ):currentName(
+                    name
+                ),currentIterations(
+                    iterations
+                ),currentNanosecondsPerIteration(
+                    nanosecondsPerIteration
+                ),currentBytesPerIteration(
+                    bytesPerIteration
+                ) {}
+
+                /**
+                 * Method you can use to obtain the benchmark name.
+                 *
+                 * \return Returns the benchmark name.
+                 */
+                inline const QString& name() const {
+                    return currentName;
+                }
+
+                /**
+                 * Method you can use to obtain the number of iterations run.
+                 *
+                 * \return Returns the number of iterations.
+                 */
+                inline unsigned long long iterations() const {
+                    return currentIterations;
+                }
+
+                /**
+                 * Method you can use to obtain the average time per iteration.
+                 *
+                 * \return Returns the average time per iteration, in nanoseconds.
+                 */
+                inline double nanosecondsPerIteration() const {
+                    return currentNanosecondsPerIteration;
+                }
+
+                /**
+                 * Method you can use to obtain the number of bytes processed or produced per iteration.
+                 *
+                 * \return Returns the number of bytes per iteration.
+                 */
+                inline unsigned long long bytesPerIteration() const {
+                    return currentBytesPerIteration;
+                }
+
+            private:
+                /**
+                 * The benchmark name.
+                 */
+                QString currentName;
+
+                /**
+                 * The number of iterations run.
+                 */
+                unsigned long long currentIterations;
+
+                /**
+                 * The average time per iteration, in nanoseconds.
+                 */
+                double currentNanosecondsPerIteration;
+
+                /**
+                 * The number of bytes per iteration.
+                 */
+                unsigned long long currentBytesPerIteration;
+        };
+
+        /**
+         * Method that runs every microbenchmark.
+         *
+         * \param[in] numberEntries  The number of latency entries per report.
+         *
+         * \param[in] bodySize       The size of the response bodies to be matched and hashed, in bytes.
+         *
+         * \param[in] minimumSeconds The minimum time to spend on each benchmark, in seconds.
+         *
+         * \return Returns the benchmark results.
+         */
+        static QList<Result> run(unsigned long numberEntries, unsigned long bodySize, double minimumSeconds);
+
+    private:
+        /**
+         * The size of the chunks response bodies are fed to the body processor in, mimicking socket reads.
+         */
+        static constexpr int readChunkSize = 16384;
+
+        /**
+         * Method that times a function.  The function is called repeatedly until the minimum time has elapsed.
+         *
+         * \param[in] name           The benchmark name.
+         *
+         * \param[in] minimumSeconds The minimum time to spend on the benchmark, in seconds.
+         *
+         * \param[in] function       The function to be timed.  The function returns the number of bytes it
+         *                           processed or produced.
+         *
+         * \return Returns the benchmark result.
+         */
+        static Result measure(
+            const QString&                              name,
+            double                                      minimumSeconds,
+            const std::function<unsigned long long()>& function
+        );
+
+        /**
+         * Method that generates a synthetic list of latency entries resembling one reporting period.
+         *
+         * \param[in] numberEntries The number of entries to generate.
+         *
+         * \return Returns the generated entries.
+         */
+        static DataAggregator::LatencyEntryList generateLatencyEntries(unsigned long numberEntries);
+
+        /**
+         * Method that feeds a body to a body processor in socket sized chunks.
+         *
+         * \param[in] bodyProcessor The body processor.
+         *
+         * \param[in] body          The body to be fed.
+         */
+        static void feedBody(ResponseBodyProcessor& bodyProcessor, const QByteArray& body);
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref MockTarget class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project polling_server */
+
+#ifndef MOCK_TARGET_H
+#define MOCK_TARGET_H
+
+#include <QObject>
+#include <QByteArray>
+
+#include "http_responder.h"
+
+class QTcpSocket;
+
+/**
+ * Mock customer site polled by the polling server under test.  Every request is answered with the same HTML body
+ * after a configurable delay.
+ */
+class MockTarget:public HttpResponder {
+    Q_OBJECT
+
+    public:
+        /**
+         * Keyword that is always present in the generated body.
+         */
+        static const QByteArray presentKeyword;
+
+        /**
+         * Keyword that never appears in the generated body.
+         */
+        static const QByteArray absentKeyword;
+
+        /**
+         * Constructor
+         *
+         * \param[in] latencyMilliseconds The delay before each response is sent, in milliseconds.
+         *
+         * \param[in] bodySize            The approximate size of the generated body, in bytes.
+         *
+         * \param[in] parent              Pointer to the parent object.
+         */
+        MockTarget(unsigned latencyMilliseconds, unsigned long bodySize, QObject* parent = nullptr);
+
+        ~MockTarget() override;
+
+        /**
+         * Method you can use to generate an HTML body of a given size.  The body contains
+         * \ref MockTarget::presentKeyword roughly half way through.
+         *
+         * \param[in] bodySize The approximate size of the body, in bytes.
+         *
+         * \return Returns the generated body.
+         */
+        static QByteArray generateBody(unsigned long bodySize);
+
+    protected:
+        /**
+         * Method that is called for each complete request.
+         *
+         * \param[in] socket The socket the request was received on.
+         *
+         * \param[in] method The request method.
+         *
+         * \param[in] path   The request path.
+         *
+         * \param[in] body   The request body.
+         */
+        void processRequest(
+            QTcpSocket*       socket,
+            const QByteArray& method,
+            const QByteArray& path,
+            const QByteArray& body
+        ) override;
+
+    private:
+        /**
+         * The response delay, in milliseconds.
+         */
+        unsigned currentLatencyMilliseconds;
+
+        /**
+         * The response body.
+         */
+        QByteArray currentBody;
+};
+
+#endif
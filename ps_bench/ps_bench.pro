@@ -0,0 +1,93 @@
+##-*-makefile-*-########################################################################################################
+# Copyright 2021 - 2023 Inesonic, LLC
+#
+# GNU Public License, Version 3:
+#   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+#   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+#   version.
+#   
+#   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+#   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+#   details.
+#   
+#   You should have received a copy of the GNU General Public License along with this program.  If not, see
+#   <https://www.gnu.org/licenses/>.
+########################################################################################################################
+
+########################################################################################################################
+# Basic build characteristics
+#
+
+TEMPLATE = app
+QT += core network
+CONFIG += console
+CONFIG += c++14
+
+########################################################################################################################
+# Headers
+#
+
+INCLUDEPATH += include
+HEADERS = include/http_responder.h \
+          include/mock_target.h \
+          include/fake_dbc.h \
+          include/customer_generator.h \
+          include/metrics_poller.h \
+          include/micro_benchmarks.h \
+
+########################################################################################################################
+# Source files
+#
+
+SOURCES = source/main.cpp \
+          source/http_responder.cpp \
+          source/mock_target.cpp \
+          source/fake_dbc.cpp \
+          source/customer_generator.cpp \
+          source/metrics_poller.cpp \
+          source/micro_benchmarks.cpp \
+
+########################################################################################################################
+# Polling server components exercised by the microbenchmarks
+#
+
+PS_DIRECTORY = $${PWD}/../ps
+
+INCLUDEPATH += $${PS_DIRECTORY}/include
+SOURCES += $${PS_DIRECTORY}/source/keyword_matcher.cpp \
+           $${PS_DIRECTORY}/source/response_body_processor.cpp \
+           $${PS_DIRECTORY}/source/latency_report_encoder.cpp \
+
+########################################################################################################################
+# Libraries
+#
+
+INCLUDEPATH += $${INEREST_API_OUT_V1_INCLUDE}
+INCLUDEPATH += $${INEREST_API_IN_V1_INCLUDE}
+INCLUDEPATH += $${INECRYPTO_INCLUDE}
+INCLUDEPATH += $${INEXTEA_INCLUDE}
+INCLUDEPATH += $${INEHTML_SCRUBBER_INCLUDE}
+
+LIBS += -L$${INEREST_API_OUT_V1_LIBDIR} -linerest_api_out_v1
+LIBS += -L$${INECRYPTO_LIBDIR} -linecrypto
+LIBS += -L$${INEXTEA_LIBDIR} -linextea
+LIBS += -L$${INEHTML_SCRUBBER_LIBDIR} -linehtml_scrubber
+
+########################################################################################################################
+# Locate build intermediate and output products
+#
+
+TARGET = ps_bench
+
+CONFIG(debug, debug|release) {
+    unix:DESTDIR = build/debug
+    win32:DESTDIR = build/Debug
+} else {
+    unix:DESTDIR = build/release
+    win32:DESTDIR = build/Release
+}
+
+OBJECTS_DIR = $${DESTDIR}/objects
+MOC_DIR = $${DESTDIR}/moc
+RCC_DIR = $${DESTDIR}/rcc
+UI_DIR = $${DESTDIR}/ui
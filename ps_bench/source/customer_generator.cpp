@@ -0,0 +1,222 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref CustomerGenerator class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <rest_api_out_v1_server.h>
+#include <rest_api_out_v1_inesonic_rest_handler.h>
+
+#include "mock_target.h"
+#include "customer_generator.h"
+
+CustomerGenerator::CustomerGenerator(
+        RestApiOutV1::Server* server,
+        const QUrl&           targetUrl,
+        unsigned              numberCustomers,
+        unsigned              monitorsPerCustomer,
+        unsigned              pollingInterval,
+        QObject*              parent
+    ):RestApiOutV1::InesonicRestHandler(
+        server,
+        parent
+    ),currentTargetUrl(
+        targetUrl
+    ),currentNumberCustomers(
+        numberCustomers
+    ),currentMonitorsPerCustomer(
+        monitorsPerCustomer
+    ),currentPollingInterval(
+        pollingInterval
+    ),currentStep(
+        Step::DONE
+    ),nextCustomerId(
+        1
+    ) {}
+
+
+CustomerGenerator::~CustomerGenerator() {}
+
+
+unsigned long CustomerGenerator::numberMonitors() const {
+    return static_cast<unsigned long>(currentNumberCustomers) * currentMonitorsPerCustomer;
+}
+
+
+void CustomerGenerator::start() {
+    currentStep    = Step::REGION;
+    nextCustomerId = 1;
+
+    sendRequest();
+}
+
+
+void CustomerGenerator::processJsonResponse(const QJsonDocument& jsonData) {
+    QString status = jsonData.object().value("status").toString();
+    if (status == QString("OK")) {
+        switch (currentStep) {
+            case Step::REGION: {
+                currentStep = currentNumberCustomers > 0 ? Step::CUSTOMERS : Step::ACTIVATE;
+                break;
+            }
+
+            case Step::CUSTOMERS: {
+                if (nextCustomerId > currentNumberCustomers) {
+                    currentStep = Step::ACTIVATE;
+                }
+
+                break;
+            }
+
+            case Step::ACTIVATE: {
+                currentStep = Step::DONE;
+                break;
+            }
+
+            case Step::DONE: {
+                break;
+            }
+        }
+
+        if (currentStep == Step::DONE) {
+            emit ready();
+        } else {
+            sendRequest();
+        }
+    } else {
+        currentStep = Step::DONE;
+        emit failed(status);
+    }
+}
+
+
+void CustomerGenerator::processRequestFailed(const QString& errorString) {
+    currentStep = Step::DONE;
+    emit failed(errorString);
+}
+
+
+void CustomerGenerator::sendRequest() {
+    switch (currentStep) {
+        case Step::REGION: {
+            QJsonObject message;
+            message.insert("region_index", 0);
+            message.insert("number_regions", 1);
+
+            post(QString("/region/change"), QJsonDocument(message));
+            break;
+        }
+
+        case Step::CUSTOMERS: {
+            QJsonObject message;
+            unsigned    count = 0;
+            while (count < customersPerRequest && nextCustomerId <= currentNumberCustomers) {
+                message.insert(QString::number(nextCustomerId), generateCustomer(nextCustomerId));
+
+                ++nextCustomerId;
+                ++count;
+            }
+
+            post(QString("/customer/add"), QJsonDocument(message));
+            break;
+        }
+
+        case Step::ACTIVATE: {
+            post(QString("/state/active"), QJsonDocument(QJsonObject()));
+            break;
+        }
+
+        case Step::DONE: {
+            break;
+        }
+    }
+}
+
+
+QJsonObject CustomerGenerator::generateCustomer(unsigned customerId) const {
+    QJsonObject monitors;
+    unsigned    firstMonitorId = (customerId - 1) * currentMonitorsPerCustomer + 1;
+    for (unsigned monitorIndex=0 ; monitorIndex<currentMonitorsPerCustomer ; ++monitorIndex) {
+        monitors.insert(QString::number(firstMonitorId + monitorIndex), generateMonitor(monitorIndex));
+    }
+
+    QJsonObject hostScheme;
+    hostScheme.insert("url", currentTargetUrl.toString());
+    hostScheme.insert("monitors", monitors);
+
+    QJsonObject hostSchemes;
+    hostSchemes.insert(QString::number(customerId), hostScheme);
+
+    QJsonObject customer;
+    customer.insert("polling_interval", static_cast<int>(currentPollingInterval));
+    customer.insert("ping", false);
+    customer.insert("ssl_expiration", currentTargetUrl.scheme() == QString("https"));
+    customer.insert("latency", true);
+    customer.insert("multi_region", false);
+    customer.insert("latency_phases", true);
+    customer.insert("host_schemes", hostSchemes);
+
+    return customer;
+}
+
+
+QJsonObject CustomerGenerator::generateMonitor(unsigned monitorIndex) {
+    static const QString presentKeyword = QString::fromLatin1(MockTarget::presentKeyword.toBase64());
+    static const QString absentKeyword  = QString::fromLatin1(MockTarget::absentKeyword.toBase64());
+
+    QJsonObject monitor;
+    monitor.insert("uri", QString("/page/%1").arg(monitorIndex));
+    monitor.insert("method", "get");
+
+    switch (monitorIndex % 5) {
+        case 0: {
+            monitor.insert("content_check_mode", "no_check");
+            break;
+        }
+
+        case 1: {
+            monitor.insert("content_check_mode", "content_match");
+            break;
+        }
+
+        case 2: {
+            monitor.insert("content_check_mode", "any_keywords");
+            monitor.insert("keywords", QJsonArray() << presentKeyword << absentKeyword);
+            break;
+        }
+
+        case 3: {
+            monitor.insert("content_check_mode", "all_keywords");
+            monitor.insert("keywords", QJsonArray() << presentKeyword);
+            break;
+        }
+
+        case 4: {
+            monitor.insert("content_check_mode", "smart_content_match");
+            break;
+        }
+    }
+
+    return monitor;
+}
@@ -0,0 +1,84 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref FakeDbc class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+
+#include "latency_report_encoder.h"
+#include "http_responder.h"
+#include "fake_dbc.h"
+
+FakeDbc::FakeDbc(QObject* parent):HttpResponder(parent) {
+    currentNumberLatencyReports = 0;
+    currentLatencyReportBytes   = 0;
+    currentNumberEventReports   = 0;
+}
+
+
+FakeDbc::~FakeDbc() {}
+
+
+unsigned long long FakeDbc::numberLatencyReports() const {
+    return currentNumberLatencyReports;
+}
+
+
+unsigned long long FakeDbc::latencyReportBytes() const {
+    return currentLatencyReportBytes;
+}
+
+
+unsigned long long FakeDbc::numberEventReports() const {
+    return currentNumberEventReports;
+}
+
+
+void FakeDbc::processRequest(
+        QTcpSocket*       socket,
+        const QByteArray& /* method */,
+        const QByteArray& path,
+        const QByteArray& body
+    ) {
+    QJsonObject responseObject;
+    responseObject.insert("status", "OK");
+
+    if (path == "/td") {
+        responseObject.insert("time_delta", 0);
+    } else if (path == "/latency/record") {
+        ++currentNumberLatencyReports;
+        currentLatencyReportBytes += static_cast<unsigned long long>(body.size());
+
+        responseObject.insert("latency_version", static_cast<int>(LatencyReportEncoder::maximumSupportedVersion));
+        responseObject.insert("latency_compression", true);
+    } else if (path == "/event/report") {
+        ++currentNumberEventReports;
+        responseObject.insert("multiple_events", true);
+    }
+
+    sendResponse(
+        socket,
+        200,
+        QByteArray("application/json"),
+        QJsonDocument(responseObject).toJson(QJsonDocument::JsonFormat::Compact)
+    );
+}
@@ -0,0 +1,165 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref HttpResponder class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QSslSocket>
+#include <QSslCertificate>
+#include <QSslKey>
+
+#include "http_responder.h"
+
+HttpResponder::HttpResponder(QObject* parent):QTcpServer(parent) {
+    currentNumberRequests = 0;
+}
+
+
+HttpResponder::~HttpResponder() {}
+
+
+bool HttpResponder::setCertificate(const QString& certificateFile, const QString& keyFile) {
+    bool  success = false;
+    QFile certificate(certificateFile);
+    QFile key(keyFile);
+
+    if (certificate.open(QFile::OpenModeFlag::ReadOnly) && key.open(QFile::OpenModeFlag::ReadOnly)) {
+        currentCertificate = QSslCertificate(certificate.readAll(), QSsl::EncodingFormat::Pem);
+        currentKey         = QSslKey(key.readAll(), QSsl::KeyAlgorithm::Rsa, QSsl::EncodingFormat::Pem);
+        success            = !currentCertificate.isNull() && !currentKey.isNull();
+    }
+
+    return success;
+}
+
+
+bool HttpResponder::sslEnabled() const {
+    return !currentCertificate.isNull();
+}
+
+
+unsigned long long HttpResponder::numberRequests() const {
+    return currentNumberRequests;
+}
+
+
+void HttpResponder::incomingConnection(qintptr socketDescriptor) {
+    QTcpSocket* socket;
+    if (sslEnabled()) {
+        QSslSocket* sslSocket = new QSslSocket(this);
+        sslSocket->setLocalCertificate(currentCertificate);
+        sslSocket->setPrivateKey(currentKey);
+        sslSocket->setSocketDescriptor(socketDescriptor);
+        sslSocket->startServerEncryption();
+
+        socket = sslSocket;
+    } else {
+        socket = new QTcpSocket(this);
+        socket->setSocketDescriptor(socketDescriptor);
+    }
+
+    currentBuffers.insert(socket, QByteArray());
+
+    connect(socket, &QTcpSocket::readyRead, this, &HttpResponder::dataAvailable);
+    connect(socket, &QTcpSocket::disconnected, this, &HttpResponder::connectionClosed);
+}
+
+
+void HttpResponder::sendResponse(
+        QTcpSocket*       socket,
+        unsigned          statusCode,
+        const QByteArray& contentType,
+        const QByteArray& body
+    ) {
+    QByteArray reasonPhrase = statusCode == 200 ? QByteArray("OK") : QByteArray("Error");
+    QByteArray response     = QByteArray("HTTP/1.1 ") + QByteArray::number(statusCode) + " " + reasonPhrase + "\r\n";
+
+    response += "Content-Type: " + contentType + "\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: keep-alive\r\n\r\n";
+    response += body;
+
+    socket->write(response);
+}
+
+
+void HttpResponder::dataAvailable() {
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket != nullptr) {
+        QByteArray& buffer = currentBuffers[socket];
+        buffer.append(socket->readAll());
+        processBuffer(socket, buffer);
+    }
+}
+
+
+void HttpResponder::connectionClosed() {
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket != nullptr) {
+        currentBuffers.remove(socket);
+        socket->deleteLater();
+    }
+}
+
+
+void HttpResponder::processBuffer(QTcpSocket* socket, QByteArray& buffer) {
+    bool complete = true;
+    while (complete) {
+        int headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd >= 0) {
+            QList<QByteArray> lines         = buffer.left(headerEnd).split('\n');
+            QList<QByteArray> requestLine   = lines.first().trimmed().split(' ');
+            unsigned long     contentLength = 0;
+
+            for (  QList<QByteArray>::const_iterator it = lines.constBegin() + 1, end = lines.constEnd()
+                 ; it != end
+                 ; ++it
+                ) {
+                int colon = it->indexOf(':');
+                if (colon > 0 && it->left(colon).trimmed().toLower() == "content-length") {
+                    contentLength = it->mid(colon + 1).trimmed().toULong();
+                }
+            }
+
+            int requestLength = headerEnd + 4 + static_cast<int>(contentLength);
+            if (buffer.size() >= requestLength) {
+                QByteArray body = buffer.mid(headerEnd + 4, static_cast<int>(contentLength));
+                buffer.remove(0, requestLength);
+
+                ++currentNumberRequests;
+
+                if (requestLine.size() >= 2) {
+                    processRequest(socket, requestLine.at(0), requestLine.at(1), body);
+                } else {
+                    sendResponse(socket, 400, QByteArray("text/plain"), QByteArray());
+                }
+            } else {
+                complete = false;
+            }
+        } else {
+            complete = false;
+        }
+    }
+}
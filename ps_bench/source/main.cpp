@@ -0,0 +1,250 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This file contains the main entry point for the polling server benchmark harness.
+***********************************************************************************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QUrl>
+#include <QTimer>
+#include <QTextStream>
+#include <QHostAddress>
+#include <QNetworkAccessManager>
+
+#include <rest_api_out_v1_server.h>
+
+#include "mock_target.h"
+#include "fake_dbc.h"
+#include "customer_generator.h"
+#include "metrics_poller.h"
+#include "micro_benchmarks.h"
+
+/**
+ * Function that prints a line describing the load between two metrics samples.
+ *
+ * \param[in] stream The stream to write to.
+ *
+ * \param[in] label  Label placed at the start of the line.
+ *
+ * \param[in] start  The earlier sample.
+ *
+ * \param[in] end    The later sample.
+ */
+static void printLoad(
+        QTextStream&                 stream,
+        const QString&               label,
+        const MetricsPoller::Sample& start,
+        const MetricsPoller::Sample& end
+    ) {
+    double             seconds = end.elapsedSeconds() - start.elapsedSeconds();
+    unsigned long long polls   = end.requestsStarted() - start.requestsStarted();
+    unsigned long long failed  = end.requestsFailed() - start.requestsFailed();
+    double             cpu     = end.cpuSeconds() - start.cpuSeconds();
+
+    stream << QString("%1 %2 s: %3 polls/s, timing error %4 ms, CPU %5 us/poll, %6 bytes/monitor, %7 failed")
+              .arg(label)
+              .arg(end.elapsedSeconds(), 7, 'f', 1)
+              .arg(seconds > 0 ? polls / seconds : 0.0, 0, 'f', 1)
+              .arg(end.averageTimingError() * 1000.0, 0, 'f', 2)
+              .arg(polls > 0 ? cpu * 1.0E6 / polls : 0.0, 0, 'f', 1)
+              .arg(end.memoryPerMonitor(), 0, 'f', 0)
+              .arg(failed)
+           << Qt::endl;
+}
+
+
+int main(int argumentCount, char* argumentValues[]) {
+    QCoreApplication application(argumentCount, argumentValues);
+    QCoreApplication::setApplicationName("Inesonic Polling Server Benchmark");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Drives a polling server with synthetic customers polling a local mock target and reports the sustained "
+        "load.  The polling server's database_server setting should point at the fake database controller started "
+        "by this tool."
+    );
+    parser.addHelpOption();
+
+    QCommandLineOption serverOption("server", "Polling server inbound REST API URL.", "url", "http://127.0.0.1:8080");
+    QCommandLineOption keyOption("key", "Polling server inbound API key, base64 encoded.", "key");
+    QCommandLineOption targetPortOption("target-port", "Mock target port.", "port", "8100");
+    QCommandLineOption dbcPortOption("dbc-port", "Fake database controller port.", "port", "8200");
+    QCommandLineOption customersOption("customers", "Number of customers.", "count", "100");
+    QCommandLineOption monitorsOption("monitors", "Monitors per customer.", "count", "5");
+    QCommandLineOption intervalOption("interval", "Customer polling interval, in seconds.", "seconds", "60");
+    QCommandLineOption latencyOption("latency", "Mock target response delay, in milliseconds.", "ms", "50");
+    QCommandLineOption bodySizeOption("body-size", "Mock target body size, in bytes.", "bytes", "16384");
+    QCommandLineOption certificateOption("certificate", "PEM certificate, enables HTTPS on the mock target.", "file");
+    QCommandLineOption privateKeyOption("private-key", "PEM private key for the mock target.", "file");
+    QCommandLineOption durationOption("duration", "Test duration, in seconds.", "seconds", "300");
+    QCommandLineOption sampleOption("sample-interval", "Time between metrics samples, in seconds.", "seconds", "10");
+    QCommandLineOption pidOption("pid", "Polling server process ID, used to measure CPU time.", "pid", "0");
+    QCommandLineOption microOption("micro", "Run the microbenchmarks instead of the load test.");
+    QCommandLineOption entriesOption("entries", "Latency entries per microbenchmark report.", "count", "10000");
+    QCommandLineOption secondsOption("micro-seconds", "Minimum time per microbenchmark, in seconds.", "seconds", "1");
+
+    parser.addOptions(
+        {
+            serverOption, keyOption, targetPortOption, dbcPortOption, customersOption, monitorsOption,
+            intervalOption, latencyOption, bodySizeOption, certificateOption, privateKeyOption, durationOption,
+            sampleOption, pidOption, microOption, entriesOption, secondsOption
+        }
+    );
+    parser.process(application);
+
+    QTextStream stream(stdout);
+    int         exitStatus = 0;
+
+    if (parser.isSet(microOption)) {
+        QList<MicroBenchmarks::Result> results = MicroBenchmarks::run(
+            parser.value(entriesOption).toULong(),
+            parser.value(bodySizeOption).toULong(),
+            parser.value(secondsOption).toDouble()
+        );
+
+        for (  QList<MicroBenchmarks::Result>::const_iterator it = results.constBegin(), end = results.constEnd()
+             ; it != end
+             ; ++it
+            ) {
+            double nanoseconds = it->nanosecondsPerIteration();
+            stream << QString("%1: %2 us/iteration, %3 bytes, %4 MB/s, %5 iterations")
+                      .arg(it->name(), -36)
+                      .arg(nanoseconds / 1000.0, 10, 'f', 2)
+                      .arg(it->bytesPerIteration())
+                      .arg(nanoseconds > 0 ? it->bytesPerIteration() * 1000.0 / nanoseconds : 0.0, 0, 'f', 1)
+                      .arg(it->iterations())
+                   << Qt::endl;
+        }
+    } else {
+        QByteArray::FromBase64Result key = QByteArray::fromBase64Encoding(
+            parser.value(keyOption).toUtf8(),
+            QByteArray::Base64Option::Base64Encoding
+        );
+
+        if (!key || key->isEmpty()) {
+            stream << "A valid --key is required." << Qt::endl;
+            return 1;
+        }
+
+        MockTarget target(parser.value(latencyOption).toUInt(), parser.value(bodySizeOption).toULong());
+        if (parser.isSet(certificateOption)) {
+            if (!target.setCertificate(parser.value(certificateOption), parser.value(privateKeyOption))) {
+                stream << "Could not load the mock target certificate or private key." << Qt::endl;
+                return 1;
+            }
+        }
+
+        FakeDbc fakeDbc;
+        if (!target.listen(QHostAddress::LocalHost, static_cast<quint16>(parser.value(targetPortOption).toUInt())) ||
+            !fakeDbc.listen(QHostAddress::LocalHost, static_cast<quint16>(parser.value(dbcPortOption).toUInt()))    ) {
+            stream << "Could not listen on the mock target or fake database controller port." << Qt::endl;
+            return 1;
+        }
+
+        QNetworkAccessManager networkAccessManager;
+        RestApiOutV1::Server  server(
+            &networkAccessManager,
+            QUrl(parser.value(serverOption)),
+            RestApiOutV1::Server::defaultTimeDeltaSlug
+        );
+        server.setDefaultSecret(*key);
+
+        QUrl targetUrl;
+        targetUrl.setScheme(target.sslEnabled() ? QString("https") : QString("http"));
+        targetUrl.setHost(QString("127.0.0.1"));
+        targetUrl.setPort(target.serverPort());
+
+        CustomerGenerator customerGenerator(
+            &server,
+            targetUrl,
+            parser.value(customersOption).toUInt(),
+            parser.value(monitorsOption).toUInt(),
+            parser.value(intervalOption).toUInt()
+        );
+
+        MetricsPoller metricsPoller(
+            &server,
+            parser.value(sampleOption).toUInt(),
+            parser.value(pidOption).toLongLong()
+        );
+
+        QList<MetricsPoller::Sample> samples;
+
+        QObject::connect(
+            &customerGenerator,
+            &CustomerGenerator::ready,
+            [&]() {
+                stream << QString("Loaded %1 monitors.").arg(customerGenerator.numberMonitors()) << Qt::endl;
+
+                metricsPoller.start();
+                QTimer::singleShot(parser.value(durationOption).toInt() * 1000, &application, &QCoreApplication::quit);
+            }
+        );
+
+        QObject::connect(
+            &metricsPoller,
+            &MetricsPoller::sampleReceived,
+            [&](const MetricsPoller::Sample& sample) {
+                if (!samples.isEmpty()) {
+                    printLoad(stream, QString("sample"), samples.last(), sample);
+                }
+
+                samples.append(sample);
+            }
+        );
+
+        QObject::connect(
+            &customerGenerator,
+            &CustomerGenerator::failed,
+            [&](const QString& reason) {
+                stream << QString("Customer setup failed: %1").arg(reason) << Qt::endl;
+                application.exit(1);
+            }
+        );
+
+        QObject::connect(
+            &metricsPoller,
+            &MetricsPoller::failed,
+            [&](const QString& reason) {
+                stream << QString("Metrics request failed: %1").arg(reason) << Qt::endl;
+            }
+        );
+
+        customerGenerator.start();
+        exitStatus = application.exec();
+
+        metricsPoller.stop();
+        if (samples.size() >= 2) {
+            printLoad(stream, QString("total "), samples.first(), samples.last());
+        }
+
+        stream << QString("Fake database controller received %1 latency reports (%2 bytes) and %3 event reports.")
+                  .arg(fakeDbc.numberLatencyReports())
+                  .arg(fakeDbc.latencyReportBytes())
+                  .arg(fakeDbc.numberEventReports())
+               << Qt::endl;
+    }
+
+    return exitStatus;
+}
@@ -0,0 +1,147 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref MetricsPoller class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QString>
+#include <QFile>
+#include <QList>
+#include <QByteArray>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <unistd.h>
+
+#include <rest_api_out_v1_server.h>
+#include <rest_api_out_v1_inesonic_rest_handler.h>
+
+#include "metrics_poller.h"
+
+MetricsPoller::MetricsPoller(
+        RestApiOutV1::Server* server,
+        unsigned              sampleIntervalSeconds,
+        long long             processId,
+        QObject*              parent
+    ):RestApiOutV1::InesonicRestHandler(
+        server,
+        parent
+    ),currentSampleIntervalSeconds(
+        sampleIntervalSeconds
+    ),currentProcessId(
+        processId
+    ),startingCpuSeconds(
+        0
+    ) {
+    connect(&sampleTimer, &QTimer::timeout, this, &MetricsPoller::requestSample);
+}
+
+
+MetricsPoller::~MetricsPoller() {}
+
+
+void MetricsPoller::start() {
+    lastSample         = Sample();
+    startingCpuSeconds = processCpuSeconds();
+
+    elapsedTimer.start();
+    sampleTimer.start(static_cast<int>(currentSampleIntervalSeconds * 1000));
+
+    requestSample();
+}
+
+
+void MetricsPoller::stop() {
+    sampleTimer.stop();
+}
+
+
+void MetricsPoller::processJsonResponse(const QJsonDocument& jsonData) {
+    QJsonObject responseObject = jsonData.object();
+    if (responseObject.value("status").toString() == QString("OK")) {
+        QJsonObject data      = responseObject.value("data").toObject();
+        QJsonObject counters  = data.value("counters").toObject();
+        QJsonObject gauges    = data.value("gauges").toObject();
+        QJsonObject scheduler = data.value("scheduler").toObject();
+
+        double elapsedSeconds = elapsedTimer.nsecsElapsed() / 1.0E9;
+        double cpuSeconds     = processCpuSeconds();
+        if (cpuSeconds >= 0) {
+            cpuSeconds -= startingCpuSeconds;
+        } else {
+            // Without access to the process we estimate from the system utilization which also includes any other
+            // load on the machine, including this harness.
+
+            double intervalSeconds = elapsedSeconds - lastSample.elapsedSeconds();
+            cpuSeconds = (
+                  lastSample.cpuSeconds()
+                + gauges.value("cpu").toDouble() * QThread::idealThreadCount() * intervalSeconds
+            );
+        }
+
+        lastSample = Sample(
+            elapsedSeconds,
+            static_cast<unsigned long long>(counters.value("requests_started").toDouble()),
+            static_cast<unsigned long long>(counters.value("requests_failed").toDouble()),
+            scheduler.value("average_timing_error").toDouble(),
+            cpuSeconds,
+            gauges.value("memory_per_monitor").toDouble()
+        );
+
+        emit sampleReceived(lastSample);
+    } else {
+        emit failed(responseObject.value("status").toString());
+    }
+}
+
+
+void MetricsPoller::processRequestFailed(const QString& errorString) {
+    emit failed(errorString);
+}
+
+
+void MetricsPoller::requestSample() {
+    post(QString("/metrics"), QJsonDocument(QJsonObject()));
+}
+
+
+double MetricsPoller::processCpuSeconds() const {
+    double result = -1;
+
+    if (currentProcessId > 0) {
+        QFile statFile(QString("/proc/%1/stat").arg(currentProcessId));
+        if (statFile.open(QFile::OpenModeFlag::ReadOnly)) {
+            QByteArray statData = statFile.readAll();
+
+            // The command name may contain spaces so we parse the fields that follow the closing parenthesis.  utime
+            // and stime are fields 14 and 15, or the 12th and 13th fields after the parenthesis.
+
+            int               commandEnd = statData.lastIndexOf(')');
+            QList<QByteArray> fields     = statData.mid(commandEnd + 2).split(' ');
+            if (commandEnd > 0 && fields.size() > 12) {
+                unsigned long long ticks = fields.at(11).toULongLong() + fields.at(12).toULongLong();
+                result = static_cast<double>(ticks) / sysconf(_SC_CLK_TCK);
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,253 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref MicroBenchmarks class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QList>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+#include <functional>
+#include <algorithm>
+
+#include <html_scrubber_hasher.h>
+
+#include "data_aggregator.h"
+#include "latency_report_encoder.h"
+#include "keyword_matcher.h"
+#include "response_body_processor.h"
+#include "mock_target.h"
+#include "micro_benchmarks.h"
+
+QList<MicroBenchmarks::Result> MicroBenchmarks::run(
+        unsigned long numberEntries,
+        unsigned long bodySize,
+        double        minimumSeconds
+    ) {
+    QList<Result> results;
+
+    DataAggregator::LatencyEntryList latencyEntries = generateLatencyEntries(numberEntries);
+    results.append(
+        measure(
+            QString("latency report, version 0"),
+            minimumSeconds,
+            [&latencyEntries]() {
+                QByteArray body;
+                LatencyReportEncoder::encodeFixed(latencyEntries, body);
+                return static_cast<unsigned long long>(body.size());
+            }
+        )
+    );
+
+    results.append(
+        measure(
+            QString("latency report, version 1"),
+            minimumSeconds,
+            [&latencyEntries]() {
+                QByteArray body;
+                LatencyReportEncoder::encodeCompact(latencyEntries, body);
+                return static_cast<unsigned long long>(body.size());
+            }
+        )
+    );
+
+    results.append(
+        measure(
+            QString("latency report, version 2"),
+            minimumSeconds,
+            [&latencyEntries]() {
+                QByteArray body;
+                LatencyReportEncoder::encodePhased(latencyEntries, body);
+                return static_cast<unsigned long long>(body.size());
+            }
+        )
+    );
+
+    results.append(
+        measure(
+            QString("latency report, version 2, deflate"),
+            minimumSeconds,
+            [&latencyEntries]() {
+                QByteArray body;
+                LatencyReportEncoder::encodePhased(latencyEntries, body);
+                return static_cast<unsigned long long>(qCompress(body).size());
+            }
+        )
+    );
+
+    QByteArray body = MockTarget::generateBody(bodySize);
+
+    ResponseBodyProcessor::KeywordMatcherPointer keywordMatcher(
+        new KeywordMatcher(QByteArrayList() << MockTarget::presentKeyword << MockTarget::absentKeyword)
+    );
+    results.append(
+        measure(
+            QString("keywords, any, found"),
+            minimumSeconds,
+            [&body, &keywordMatcher]() {
+                ResponseBodyProcessor bodyProcessor(
+                    1,
+                    ResponseBodyProcessor::ContentCheckMode::ANY_KEYWORDS,
+                    keywordMatcher,
+                    Monitor::defaultMaximumBodySize
+                );
+
+                feedBody(bodyProcessor, body);
+                return bodyProcessor.bytesReceived();
+            }
+        )
+    );
+
+    // Requiring a keyword that is never present forces the matcher to scan the entire body.
+
+    results.append(
+        measure(
+            QString("keywords, all, missing"),
+            minimumSeconds,
+            [&body, &keywordMatcher]() {
+                ResponseBodyProcessor bodyProcessor(
+                    1,
+                    ResponseBodyProcessor::ContentCheckMode::ALL_KEYWORDS,
+                    keywordMatcher,
+                    Monitor::defaultMaximumBodySize
+                );
+
+                feedBody(bodyProcessor, body);
+                return bodyProcessor.bytesReceived();
+            }
+        )
+    );
+
+    results.append(
+        measure(
+            QString("content match, SHA-256"),
+            minimumSeconds,
+            [&body]() {
+                ResponseBodyProcessor bodyProcessor(
+                    1,
+                    ResponseBodyProcessor::ContentCheckMode::CONTENT_MATCH,
+                    ResponseBodyProcessor::KeywordMatcherPointer(),
+                    Monitor::defaultMaximumBodySize
+                );
+
+                feedBody(bodyProcessor, body);
+                bodyProcessor.hashResult();
+
+                return bodyProcessor.bytesReceived();
+            }
+        )
+    );
+
+    results.append(
+        measure(
+            QString("smart content match, HTML scrubber"),
+            minimumSeconds,
+            [&body]() {
+                ResponseBodyProcessor bodyProcessor(
+                    1,
+                    ResponseBodyProcessor::ContentCheckMode::SMART_CONTENT_MATCH,
+                    ResponseBodyProcessor::KeywordMatcherPointer(),
+                    Monitor::defaultMaximumBodySize
+                );
+
+                feedBody(bodyProcessor, body);
+
+                HtmlScrubber::Hasher hasher(bodyProcessor.bufferedData(), HtmlScrubber::Hasher::Algorithm::Sha256);
+                hasher.scrubAndHash();
+                hasher.result();
+
+                return bodyProcessor.bytesReceived();
+            }
+        )
+    );
+
+    return results;
+}
+
+
+MicroBenchmarks::Result MicroBenchmarks::measure(
+        const QString&                              name,
+        double                                      minimumSeconds,
+        const std::function<unsigned long long()>& function
+    ) {
+    unsigned long long minimumNanoseconds = static_cast<unsigned long long>(minimumSeconds * 1.0E9);
+    unsigned long long iterations         = 0;
+    unsigned long long bytes              = 0;
+    unsigned long long elapsedNanoseconds = 0;
+
+    function(); // Warm up caches and allocators before timing.
+
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        bytes += function();
+        ++iterations;
+
+        elapsedNanoseconds = static_cast<unsigned long long>(timer.nsecsElapsed());
+    } while (elapsedNanoseconds < minimumNanoseconds);
+
+    return Result(
+        name,
+        iterations,
+        static_cast<double>(elapsedNanoseconds) / iterations,
+        bytes / iterations
+    );
+}
+
+
+DataAggregator::LatencyEntryList MicroBenchmarks::generateLatencyEntries(unsigned long numberEntries) {
+    static constexpr unsigned long long baseTimestamp = 1672531200; // Start of 2023
+
+    // Roughly four samples per monitor, taken 15 seconds apart, in the order they'd be recorded.
+
+    unsigned long numberMonitors = std::max(1UL, numberEntries / 4);
+
+    DataAggregator::LatencyEntryList result;
+    result.reserve(static_cast<int>(numberEntries));
+    for (unsigned long i=0 ; i<numberEntries ; ++i) {
+        DataAggregator::MonitorId           monitorId = static_cast<DataAggregator::MonitorId>(i % numberMonitors + 1);
+        unsigned long long                  timestamp = baseTimestamp + (i / numberMonitors) * 15;
+        DataAggregator::LatencyMicroseconds latency   = static_cast<DataAggregator::LatencyMicroseconds>(
+            20000 + (i * 7919) % 200000
+        );
+
+        result.append(
+            DataAggregator::LatencyEntry(
+                monitorId,
+                timestamp,
+                latency,
+                DataAggregator::LatencyPhases(latency / 10, latency / 10, latency / 10, latency / 2, latency / 5)
+            )
+        );
+    }
+
+    return result;
+}
+
+
+void MicroBenchmarks::feedBody(ResponseBodyProcessor& bodyProcessor, const QByteArray& body) {
+    int offset = 0;
+    int size   = body.size();
+    while (offset < size) {
+        bodyProcessor.addData(body.mid(offset, readChunkSize));
+        offset += readChunkSize;
+    }
+}
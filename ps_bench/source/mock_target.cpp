@@ -0,0 +1,91 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2021 - 2023 Inesonic, LLC.
+*
+* GNU Public License, Version 3:
+*   This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+*   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later
+*   version.
+*   
+*   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+*   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+*   details.
+*   
+*   You should have received a copy of the GNU General Public License along with this program.  If not, see
+*   <https://www.gnu.org/licenses/>.
+********************************************************************************************************************//**
+* \file
+*
+* This header implements the \ref MockTarget class.
+***********************************************************************************************************************/
+
+#include <QObject>
+#include <QByteArray>
+#include <QTimer>
+#include <QTcpSocket>
+
+#include "http_responder.h"
+#include "mock_target.h"
+
+const QByteArray MockTarget::presentKeyword("speedsentry");
+const QByteArray MockTarget::absentKeyword("ps_bench_missing_keyword");
+
+MockTarget::MockTarget(
+        unsigned      latencyMilliseconds,
+        unsigned long bodySize,
+        QObject*      parent
+    ):HttpResponder(
+        parent
+    ),currentLatencyMilliseconds(
+        latencyMilliseconds
+    ),currentBody(
+        generateBody(bodySize)
+    ) {}
+
+
+MockTarget::~MockTarget() {}
+
+
+QByteArray MockTarget::generateBody(unsigned long bodySize) {
+    static const QByteArray prefix("<html><head><title>ps_bench</title></head><body>\n");
+    static const QByteArray suffix("</body></html>\n");
+    static const QByteArray paragraph("<p>The quick brown fox jumps over the lazy dog.</p>\n");
+
+    QByteArray result = prefix;
+    result.reserve(static_cast<int>(bodySize + paragraph.size() + presentKeyword.size() + suffix.size()));
+
+    unsigned long halfSize = bodySize / 2;
+    while (static_cast<unsigned long>(result.size()) < halfSize) {
+        result += paragraph;
+    }
+
+    result += "<p>" + presentKeyword + "</p>\n";
+
+    while (static_cast<unsigned long>(result.size() + suffix.size()) < bodySize) {
+        result += paragraph;
+    }
+
+    result += suffix;
+    return result;
+}
+
+
+void MockTarget::processRequest(
+        QTcpSocket*       socket,
+        const QByteArray& /* method */,
+        const QByteArray& /* path */,
+        const QByteArray& /* body */
+    ) {
+    if (currentLatencyMilliseconds == 0) {
+        sendResponse(socket, 200, QByteArray("text/html"), currentBody);
+    } else {
+        // Using the socket as the context object drops the response if the connection closes before it's sent.
+        QTimer::singleShot(
+            static_cast<int>(currentLatencyMilliseconds),
+            Qt::TimerType::PreciseTimer,
+            socket,
+            [this, socket]() {
+                sendResponse(socket, 200, QByteArray("text/html"), currentBody);
+            }
+        );
+    }
+}
@@ -15,4 +15,5 @@
 ########################################################################################################################
 
 TEMPLATE = subdirs
-SUBDIRS = ps
+SUBDIRS = ps \
+          ps_bench